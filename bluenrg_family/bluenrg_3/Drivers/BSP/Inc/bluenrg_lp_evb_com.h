@@ -82,6 +82,8 @@ void BSP_COM_IRQHandler(void);
 void BSP_COM_RxDataUserCb(uint8_t * pRxDataBuff, uint16_t nDataSize);
 uint8_t BSP_COM_TxFifoNotEmpty(void);
 uint8_t BSP_COM_UARTBusy(void);
+void BSP_COM_Flush(void);
+uint32_t BSP_COM_GetTxDropped(void);
 
 #ifdef __ICCARM__
 uint8_t __io_getcharNonBlocking(uint8_t *data);
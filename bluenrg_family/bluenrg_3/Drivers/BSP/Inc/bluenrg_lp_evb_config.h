@@ -64,6 +64,24 @@
   * @}
   */ 
 
+/** @defgroup BLUENRGLP_EVB_Error_Codes Error Codes
+  * @{
+  */
+#define BSP_ERROR_NONE                     0
+#define BSP_ERROR_WRONG_PARAM             -2
+#define BSP_ERROR_BUSY                    -3
+#define BSP_ERROR_BUS_FAILURE             -4
+#define BSP_ERROR_TIMEOUT                 -5
+#define BSP_ERROR_COMPONENT_FAILURE       -6
+
+/* Number of polling loops after which a blocking bus transfer is aborted */
+#ifndef BSP_BUS_TIMEOUT
+#define BSP_BUS_TIMEOUT                   60000
+#endif
+/**
+  * @}
+  */
+
 /* BlueNRG-LP Development platform: STEVAL-IDB011V1 */
 #include "system_BlueNRG_LP.h"
 
@@ -64,6 +64,12 @@ void BSP_I2C_DeInit(void);
 int32_t BSP_I2C_Write(void *handle, uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize);
 int32_t BSP_I2C_Read(void *handle, uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize);
 
+int32_t BSP_I2C_WriteAsync(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, void (*Callback)(int32_t status));
+int32_t BSP_I2C_ReadAsync(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, void (*Callback)(int32_t status));
+uint8_t BSP_I2C_IsBusy(void);
+void BSP_I2C_Abort(void);
+void BSP_I2C_IRQHandler(void);
+
 /**
   * @}
   */
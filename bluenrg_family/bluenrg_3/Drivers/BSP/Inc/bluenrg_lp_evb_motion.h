@@ -0,0 +1,140 @@
+/** 
+  ******************************************************************************
+  * @file    bluenrg_lp_evb_motion.h
+  * @author  RF Application Team
+  * @brief   This file contains definitions to stream the FIFO of the inertial
+  *          module LSM6DSOX available on BlueNRGLP-EVB Kit.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT(c) 2019 STMicroelectronics</center></h2>
+  *
+  * Redistribution and use in source and binary forms, with or without modification,
+  * are permitted provided that the following conditions are met:
+  *   1. Redistributions of source code must retain the above copyright notice,
+  *      this list of conditions and the following disclaimer.
+  *   2. Redistributions in binary form must reproduce the above copyright notice,
+  *      this list of conditions and the following disclaimer in the documentation
+  *      and/or other materials provided with the distribution.
+  *   3. Neither the name of STMicroelectronics nor the names of its contributors
+  *      may be used to endorse or promote products derived from this software
+  *      without specific prior written permission.
+  *
+  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __BLUENRG_LP_EVB_MOTION_H
+#define __BLUENRG_LP_EVB_MOTION_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/** @addtogroup BSP
+  * @{
+  */
+
+/** @addtogroup BSP_BLUENRGLP_MOTION BSP BlueNRG-LP motion FIFO
+  * @{
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "bluenrg_lp_evb_config.h"
+
+
+/** @addtogroup BSP_BLUENRGLP_MOTION_Exported_Types
+  * @{
+  */
+
+/* Number of FIFO words (7 bytes each) read by a single SPI DMA transfer */
+#ifndef BSP_MOTION_BURST_WORDS
+#define BSP_MOTION_BURST_WORDS      32
+#endif
+
+#define BSP_MOTION_ACC              0
+#define BSP_MOTION_GYRO             1
+
+/**
+ * @brief  Sample decoded from the FIFO
+ */
+typedef struct
+{
+  uint8_t  sensor;              /* BSP_MOTION_ACC or BSP_MOTION_GYRO */
+  uint32_t timestamp;           /* Last timestamp batched before the sample (LSB 25 us) */
+  int16_t  data[3];             /* Raw X, Y, Z */
+} BSP_MOTION_Sample_t;
+
+/**
+ * @brief  Called from BSP_MOTION_Tick() with the samples of a burst.
+ *         The samples are valid only during the call: e.g. the application
+ *         copies them in the value of a characteristic to be notified.
+ */
+typedef void (* BSP_MOTION_BatchCb_t) (const BSP_MOTION_Sample_t *pSamples, uint16_t nSamples);
+
+typedef struct
+{
+  lsm6dsox_odr_xl_t acc_odr;            /* Accelerometer output data rate */
+  lsm6dsox_bdr_xl_t acc_batch;          /* Accelerometer batch rate, LSM6DSOX_XL_NOT_BATCHED to disable */
+  lsm6dsox_odr_g_t  gyro_odr;           /* Gyroscope output data rate */
+  lsm6dsox_bdr_gy_t gyro_batch;         /* Gyroscope batch rate, LSM6DSOX_GY_NOT_BATCHED to disable */
+  uint16_t          watermark;          /* FIFO words (samples and timestamps) that raise INT1, max 511 */
+  BSP_MOTION_BatchCb_t BatchCb;         /* Batch callback */
+} BSP_MOTION_Config_t;
+
+/**
+ * @brief  Statistics of the FIFO streaming
+ */
+typedef struct
+{
+  uint32_t samples;             /* Samples passed to the batch callback */
+  uint32_t bursts;              /* SPI DMA bursts */
+  uint32_t overruns;            /* FIFO overruns detected (samples lost) */
+  uint32_t errors;              /* Failed SPI transfers */
+} BSP_MOTION_Stats_t;
+
+/**
+  * @}
+  */
+
+/** @addtogroup BSP_BLUENRGLP_MOTION_Exported_Functions
+  * @{
+  */
+
+int32_t BSP_MOTION_Start(const BSP_MOTION_Config_t *pConfig);
+int32_t BSP_MOTION_Stop(void);
+void BSP_MOTION_Tick(void);
+uint8_t BSP_MOTION_IsBusy(void);
+void BSP_MOTION_IRQHandler(void);
+void BSP_MOTION_GetStats(BSP_MOTION_Stats_t *pStats);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BLUENRG_LP_EVB_MOTION_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -55,6 +55,14 @@
    
 
 
+/* DMA channels used by BSP_SPI_WriteAsync() and BSP_SPI_ReadAsync() */
+#ifndef BSP_SPI_TX_DMA_CH
+#define BSP_SPI_TX_DMA_CH          LL_DMA_CHANNEL_7
+#endif
+#ifndef BSP_SPI_RX_DMA_CH
+#define BSP_SPI_RX_DMA_CH          LL_DMA_CHANNEL_8
+#endif
+
 /** @addtogroup BSP_BLUENRGLP_SPI_Exported_Functions
   * @{
   */
@@ -64,6 +72,12 @@ void BSP_SPI_DeInit(void);
 int32_t BSP_SPI_Write(void *handle, uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize);
 int32_t BSP_SPI_Read(void *handle, uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize);
 
+int32_t BSP_SPI_WriteAsync(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, void (*Callback)(int32_t status));
+int32_t BSP_SPI_ReadAsync(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, void (*Callback)(int32_t status));
+uint8_t BSP_SPI_IsBusy(void);
+void BSP_SPI_Abort(void);
+void BSP_SPI_DMA_IRQHandler(void);
+
 void BSP_SPI_GpioInt_Init(void);
 
 /**
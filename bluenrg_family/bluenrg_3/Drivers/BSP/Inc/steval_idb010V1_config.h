@@ -141,6 +141,7 @@ typedef enum
 #define BSP_I2C                                   I2C1
 #define BSP_I2C_CLK_ENABLE()                      LL_APB1_EnableClock(LL_APB1_PERIPH_I2C1)
 #define BSP_I2C_CLK_DISABLE()                     LL_APB1_DisableClock(LL_APB1_PERIPH_I2C1)
+#define BSP_I2C_IRQn                              I2C1_IRQn
 
 #define BSP_I2C_DATA_PIN                          LL_GPIO_PIN_1
 #define BSP_I2C_DATA_GPIO_PORT                    GPIOA
@@ -185,6 +186,8 @@ typedef enum
 #define BSP_SPI_CLK_DISABLE()                     LL_APB1_DisableClock(LL_APB1_PERIPH_SPI1)
 #define BSP_SPI_CLK_POLARITY                      LL_SPI_POLARITY_HIGH
 #define BSP_SPI_CLK_PHASE                         LL_SPI_PHASE_2EDGE
+#define BSP_SPI_TX_DMA_REQ                        LL_DMAMUX_REQ_SPI1_TX
+#define BSP_SPI_RX_DMA_REQ                        LL_DMAMUX_REQ_SPI1_RX
 
 #define BSP_SPI_MISO_PIN                          LL_GPIO_PIN_14
 #define BSP_SPI_MISO_GPIO_PORT                    GPIOA
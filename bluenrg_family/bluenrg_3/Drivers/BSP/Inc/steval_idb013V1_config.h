@@ -143,6 +143,7 @@ typedef enum
 #define BSP_I2C                                   I2C1
 #define BSP_I2C_CLK_ENABLE()                      LL_APB1_EnableClock(LL_APB1_PERIPH_I2C1)
 #define BSP_I2C_CLK_DISABLE()                     LL_APB1_DisableClock(LL_APB1_PERIPH_I2C1)
+#define BSP_I2C_IRQn                              I2C1_IRQn
 
 #define BSP_I2C_DATA_PIN                          LL_GPIO_PIN_7
 #define BSP_I2C_DATA_GPIO_PORT                    GPIOB
@@ -51,6 +51,24 @@
 #define READ_DATA_SIZE      1024
 #define READ_BUFFER_IS_EMPTY() (Read_ptr_in == Read_ptr_out)
 
+/* Size of the TX buffer of BSP_COM_Write(), drained by the UART interrupt.
+ * The buffer is used only if the UART IRQ is configured by BSP_COM_Init():
+ * otherwise BSP_COM_Write() waits for the UART TX FIFO. */
+#ifndef WRITE_DATA_SIZE
+#define WRITE_DATA_SIZE     (READ_DATA_SIZE/4)
+#endif
+#define WRITE_BUFFER_IS_EMPTY() (Write_ptr_in == Write_ptr_out)
+#define WRITE_BUFFER_IS_FULL()  (((Write_ptr_in + 1) % WRITE_DATA_SIZE) == Write_ptr_out)
+
+/* Uncomment to drop the bytes that do not fit in the TX buffer (counted by
+ * BSP_COM_GetTxDropped()) instead of waiting for the UART to send the buffer */
+//#define BSP_COM_TX_DROP_ON_OVERFLOW
+
+#define ATOMIC_SECTION_BEGIN() uint32_t uwPRIMASK_Bit = __get_PRIMASK(); \
+                                __disable_irq(); \
+/* Must be called in the same or in a lower scope of ATOMIC_SECTION_BEGIN */
+#define ATOMIC_SECTION_END() __set_PRIMASK(uwPRIMASK_Bit)
+
 /**
  * @}
  */
@@ -87,6 +105,12 @@ static uint8_t  Read_Buffer[READ_DATA_SIZE];
 static uint32_t Read_ptr_in = 0;
 static uint32_t Read_ptr_out = 0;
 
+static uint8_t  Write_Buffer[WRITE_DATA_SIZE];
+static volatile uint32_t Write_ptr_in = 0;
+static volatile uint32_t Write_ptr_out = 0;
+static uint8_t  Write_Buffered = FALSE;
+static uint32_t Write_Dropped = 0;
+
 /**
  * @}
  */
@@ -97,6 +121,7 @@ static uint32_t Read_ptr_out = 0;
  */
 static void Read_Buffer_Push(uint8_t byte);
 static uint8_t Read_Buffer_Pop(uint8_t *byte);
+static void Write_Buffer_Send(void);
 
 /**
  * @}
@@ -111,7 +136,9 @@ static uint8_t Read_Buffer_Pop(uint8_t *byte);
 /**
   * @brief  Configures the UART interface.
   * @param  pRxDataCb user callback for handling the data received
-  *         if NULL: the UART IRQ is not configured.
+  *         if NULL: the UART IRQ is not configured and BSP_COM_Write() waits
+  *         for the UART. Otherwise BSP_COM_IRQHandler() must be called from
+  *         the UART IRQ handler and it also sends the TX buffer.
   * @retval None
   */
 void BSP_COM_Init(BSP_COM_RxDataCb_t pRxDataCb)
@@ -154,6 +181,11 @@ void BSP_COM_Init(BSP_COM_RxDataCb_t pRxDataCb)
     /* Record the user callback for handling the RX data */
     BSP_COM_RxDataCb.RxDataUserCb = pRxDataCb;
 
+    /* BSP_COM_Write() uses the TX buffer, sent by BSP_COM_IRQHandler() */
+    Write_ptr_in = Write_ptr_out = 0;
+    Write_Dropped = 0;
+    Write_Buffered = TRUE;
+
     /* Enable the RX not empty interrupt */
     LL_USART_EnableIT_RXNE(BSP_UART);
 
@@ -176,8 +208,13 @@ void BSP_COM_Init(BSP_COM_RxDataCb_t pRxDataCb)
   */
 void BSP_COM_DeInit(void)
 {
+  /* Send the data still in the TX buffer */
+  BSP_COM_Flush();
+  Write_Buffered = FALSE;
+
   /* Disable the UART interrupts */
   LL_USART_DisableIT_RXNE(BSP_UART);
+  LL_USART_DisableIT_TXFT(BSP_UART);
   NVIC_DisableIRQ(BSP_UART_IRQn);
 
   /* Disable the UART peripheral */
@@ -201,20 +238,78 @@ void BSP_COM_DeInit(void)
 
 /**
   * @brief  Send N bytes through the UART port.
+  *         If the UART IRQ is configured, the bytes are copied in the TX buffer
+  *         and the function returns without waiting for the UART, unless the
+  *         buffer is full (see BSP_COM_TX_DROP_ON_OVERFLOW).
   * @param  pBuff: pBuff. 
   * @param  nBuffSize: nBuffSize. 
   * @retval None
   */
 void BSP_COM_Write(uint8_t *pBuff, uint8_t nBuffSize)
 {
-  for (uint8_t i = 0; i < nBuffSize; i++) {
+  uint8_t i = 0;
+
+  if(Write_Buffered == FALSE) {
+    for (i = 0; i < nBuffSize; i++) {
+
+      /* Wait for TX FIFO not full flag to be raised */
+      while (LL_USART_IsActiveFlag_TXE(BSP_UART) == 0);
 
-    /* Wait for TX FIFO not full flag to be raised */
-    while (LL_USART_IsActiveFlag_TXE(BSP_UART) == 0);
+      /* Send the byte to the UART */
+      LL_USART_TransmitData8(BSP_UART, pBuff[i]);
+    }
+    return;
+  }
 
-    /* Send the byte to the UART */
-    LL_USART_TransmitData8(BSP_UART, pBuff[i]);
+  while(i < nBuffSize) {
+    ATOMIC_SECTION_BEGIN();
+    while((i < nBuffSize) && !WRITE_BUFFER_IS_FULL()) {
+      Write_Buffer[Write_ptr_in] = pBuff[i++];
+      Write_ptr_in = (Write_ptr_in + 1) % WRITE_DATA_SIZE;
+    }
+    /* Also makes room when called with the UART IRQ masked */
+    Write_Buffer_Send();
+    ATOMIC_SECTION_END();
+
+#ifdef BSP_COM_TX_DROP_ON_OVERFLOW
+    if(i < nBuffSize) {
+      Write_Dropped += nBuffSize - i;
+      break;
+    }
+#endif
+  }
+}
+
+
+/**
+  * @brief  Wait until the TX buffer and the UART have sent all the data.
+  *         The interrupts are disabled meanwhile, so it can be used in the
+  *         error handlers before a reset.
+  * @param  None
+  * @retval None
+  */
+void BSP_COM_Flush(void)
+{
+  ATOMIC_SECTION_BEGIN();
+  if(Write_Buffered) {
+    while(!WRITE_BUFFER_IS_EMPTY()) {
+      Write_Buffer_Send();
+    }
   }
+  while(LL_USART_IsEnabled(BSP_UART) && (LL_USART_IsActiveFlag_TC(BSP_UART) == 0));
+  ATOMIC_SECTION_END();
+}
+
+
+/**
+  * @brief  Get the number of bytes dropped because the TX buffer was full.
+  *         Always 0 if BSP_COM_TX_DROP_ON_OVERFLOW is not defined.
+  * @param  None
+  * @retval Number of bytes dropped since BSP_COM_Init()
+  */
+uint32_t BSP_COM_GetTxDropped(void)
+{
+  return Write_Dropped;
 }
 
 
@@ -252,6 +347,11 @@ uint8_t BSP_COM_Read(uint8_t *pData)
 void BSP_COM_IRQHandler(void)
 {
   uint8_t read_data; 
+
+  /* TX FIFO below the threshold: send the TX buffer */
+  if(LL_USART_IsEnabledIT_TXFT(BSP_UART) && LL_USART_IsActiveFlag_TXFT(BSP_UART)) {
+    Write_Buffer_Send();
+  }
   
   /* If the user callback is not NULL */
   if(BSP_COM_RxDataCb.RxDataUserCb != NULL) {
@@ -288,7 +388,7 @@ void BSP_COM_RxDataUserCb(uint8_t * pRxDataBuff, uint16_t nDataSize)
  */
 uint8_t BSP_COM_TxFifoNotEmpty(void)
 {
-  return (LL_USART_IsActiveFlag_TXFE(BSP_UART) == RESET);
+  return (LL_USART_IsActiveFlag_TXFE(BSP_UART) == RESET) || !WRITE_BUFFER_IS_EMPTY();
 }
 
 /**
@@ -298,7 +398,8 @@ uint8_t BSP_COM_TxFifoNotEmpty(void)
 uint8_t BSP_COM_UARTBusy(void)
 {
   if ((LL_USART_IsActiveFlag_TXE_TXFNF(BSP_UART) == RESET) ||
-      (LL_USART_IsActiveFlag_TC(BSP_UART) == RESET))
+      (LL_USART_IsActiveFlag_TC(BSP_UART) == RESET) ||
+      !WRITE_BUFFER_IS_EMPTY())
     return TRUE;
   
   return FALSE;
@@ -351,6 +452,25 @@ static uint8_t Read_Buffer_Pop(uint8_t *byte)
   return 1;
 }
 
+/**
+ * @brief  Move the TX buffer to the UART TX FIFO, as long as the FIFO is not
+ *         full. The TX FIFO threshold interrupt is enabled while the buffer
+ *         is not empty. To be called with the UART IRQ masked or from it.
+ * @retval None
+ */
+static void Write_Buffer_Send(void)
+{
+  while(!WRITE_BUFFER_IS_EMPTY() && LL_USART_IsActiveFlag_TXE_TXFNF(BSP_UART)) {
+    LL_USART_TransmitData8(BSP_UART, Write_Buffer[Write_ptr_out]);
+    Write_ptr_out = (Write_ptr_out + 1) % WRITE_DATA_SIZE;
+  }
+
+  if(WRITE_BUFFER_IS_EMPTY())
+    LL_USART_DisableIT_TXFT(BSP_UART);
+  else
+    LL_USART_EnableIT_TXFT(BSP_UART);
+}
+
 
 
 #ifdef __ICCARM__
@@ -367,12 +487,16 @@ size_t __write(int handle, const unsigned char * buffer, size_t size)
   if (buffer == 0) {
     // This means that we should flush internal buffers.
     //spin until TX complete (TX is idle)
+    BSP_COM_Flush();
     return 0;
   }
 
-  while(size--) {
-    BSP_COM_Write((uint8_t *)buffer++, 1);
-    ++nChars;
+  while(size) {
+    uint8_t len = (size > 255) ? 255 : size;
+    BSP_COM_Write((uint8_t *)buffer, len);
+    buffer += len;
+    size -= len;
+    nChars += len;
   }
 
   return nChars;
@@ -485,8 +609,8 @@ int _lseek(int32_t file, int32_t ptr, int32_t dir)
 
 int _write(int fd, char *str, int len)
 {
-  for(int i=0;i<len;i++) {
-	BSP_COM_Write( (uint8_t *)&str[i], 1);
+  for(int i=0;i<len;i+=255) {
+	BSP_COM_Write( (uint8_t *)&str[i], (len-i > 255) ? 255 : len-i);
   }
   return len;
   
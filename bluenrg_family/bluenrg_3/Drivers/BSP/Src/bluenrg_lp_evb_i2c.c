@@ -50,6 +50,41 @@
   */ 
 
 
+/** @defgroup BSP_BLUENRGLP_I2C_Private_Variables Private Variables
+  * @{
+  */
+
+#define ATOMIC_SECTION_BEGIN() uint32_t uwPRIMASK_Bit = __get_PRIMASK(); \
+                                __disable_irq(); \
+/* Must be called in the same or in a lower scope of ATOMIC_SECTION_BEGIN */
+#define ATOMIC_SECTION_END() __set_PRIMASK(uwPRIMASK_Bit)
+
+/* State of the transfer started by I2C_Start() or I2C_Transfer() */
+#define I2C_STATE_IDLE          0
+#define I2C_STATE_REG           1  /* Waiting to send the register address */
+#define I2C_STATE_RESTART       2  /* Read: waiting for the end of the register address */
+#define I2C_STATE_DATA          3  /* Sending or receiving the data */
+#define I2C_STATE_POLLING       4  /* Blocking transfer, the interrupt is not used */
+
+static volatile uint8_t i2cState = I2C_STATE_IDLE;
+static uint8_t i2cReg;
+static uint8_t i2cRead;
+static uint8_t *i2cBuff;
+static uint16_t i2cSize;
+static volatile uint16_t i2cCount;
+static volatile int32_t i2cStatus;
+static void (*i2cCallback)(int32_t status);
+
+static int32_t I2C_Start(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, uint8_t read, void (*Callback)(int32_t status));
+static void I2C_Stop(uint8_t reset);
+static int32_t I2C_WaitFlag(uint32_t Flag);
+static int32_t I2C_Transfer(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, uint8_t read);
+
+/**
+  * @}
+  */ 
+
+
 /** @defgroup BSP_BLUENRGLP_I2C_Exported_Functions Exported Functions
   * @{
   */ 
@@ -119,6 +154,10 @@ void BSP_I2C_Init(void)
   */
 void BSP_I2C_DeInit(void)
 {
+  /* Stop the ongoing transfer, if any */
+  NVIC_DisableIRQ(BSP_I2C_IRQn);
+  I2C_Stop(0);
+
   /* Disable I2C transfer complete/error interrupts */
   LL_I2C_ClearFlag_TXE(BSP_I2C);
   LL_I2C_ClearFlag_NACK(BSP_I2C);
@@ -152,81 +191,378 @@ void BSP_I2C_DeInit(void)
 
 /**
   * @brief  I2C write function used for the LPS22HH pressure sensor.
+  *         The register address and the data go through the I2C by polling,
+  *         the interrupt is not used.
   * @param  handle: handle. 
   * @param  Reg: Reg. 
   * @param  pBuff: pBuff. 
   * @param  nBuffSize: nBuffSize. 
-  * @retval None
+  * @retval BSP_ERROR_NONE, BSP_ERROR_BUSY if an asynchronous transfer is ongoing,
+  *         BSP_ERROR_BUS_FAILURE on NACK, bus error or arbitration lost,
+  *         BSP_ERROR_TIMEOUT if a byte is not transferred within BSP_BUS_TIMEOUT loops
   */
 int32_t BSP_I2C_Write(void *handle, uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize)
 {
-  /* Initialize the handle transfer */
-  LL_I2C_HandleTransfer(BSP_I2C, LPS22HH_I2C_ADD_L, LL_I2C_ADDRSLAVE_7BIT, nBuffSize+1, LL_I2C_MODE_AUTOEND, LL_I2C_GENERATE_START_WRITE);
-
-  /* Wait for the TX Empty flag */
-  while(LL_I2C_IsActiveFlag_TXE(BSP_I2C) == 0); /* TODO: add a SW timeout */
-  
-  /* Get the received byte from the RX FIFO */
-  LL_I2C_TransmitData8(BSP_I2C, (Reg | 0x80)); // |0x80 auto-increment
-  
-  /* Wait for the TX Empty flag */
-  while(LL_I2C_IsActiveFlag_TXE(BSP_I2C) == 0); /* TODO: add a SW timeout */
-  
-  for(uint16_t i = 0; i < nBuffSize; i++) {
-    /* Wait for the TX flag */
-    while(LL_I2C_IsActiveFlag_TXIS(BSP_I2C) == 0); /* TODO: add a SW timeout */
-
-    /* Fill the TX FIFO with data */
-    LL_I2C_TransmitData8(BSP_I2C, pBuff[i]);
-  }
-
-  /* Wait for the Transfer Complete flag */
-//  while(LL_I2C_IsActiveFlag_TC(BSP_I2C) == 0);
-
-  return 0;
+  return I2C_Transfer(Reg, pBuff, nBuffSize, 0);
 }
 
 
 /**
   * @brief  I2C read function used for the LPS22HH pressure sensor.
+  *         The register address and the data go through the I2C by polling,
+  *         the interrupt is not used.
   * @param  handle: handle. 
   * @param  Reg: Reg. 
   * @param  pBuff: pBuff. 
   * @param  nBuffSize: nBuffSize. 
-  * @retval None
+  * @retval BSP_ERROR_NONE, BSP_ERROR_BUSY if an asynchronous transfer is ongoing,
+  *         BSP_ERROR_BUS_FAILURE on NACK, bus error or arbitration lost,
+  *         BSP_ERROR_TIMEOUT if a byte is not transferred within BSP_BUS_TIMEOUT loops
   */
 int32_t BSP_I2C_Read(void *handle, uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize)
 {
-  /* Initialize the handle transfer */
-  LL_I2C_HandleTransfer(BSP_I2C, LPS22HH_I2C_ADD_L, LL_I2C_ADDRSLAVE_7BIT, 1, LL_I2C_MODE_AUTOEND, LL_I2C_GENERATE_START_WRITE);
-  
-  /* Wait for the TX Empty flag */
-  while(LL_I2C_IsActiveFlag_TXE(BSP_I2C) == 0); /* TODO: add a SW timeout */
-  
-  /* Get the received byte from the RX FIFO */
-  LL_I2C_TransmitData8(BSP_I2C, (Reg | 0x80)); // |0x80 auto-increment
-  
-  /* Wait for the TX Empty flag */
-  while(LL_I2C_IsActiveFlag_TXE(BSP_I2C) == 0); /* TODO: add a SW timeout */
-  
-  /* Wait for the Transfer Complete flag */
-//  while(LL_I2C_IsActiveFlag_TC(BSP_I2C) == 0);  
-  
-  /* Initialize the handle transfer */
-  LL_I2C_HandleTransfer(BSP_I2C, LPS22HH_I2C_ADD_L, LL_I2C_ADDRSLAVE_7BIT, nBuffSize, LL_I2C_MODE_AUTOEND, LL_I2C_GENERATE_START_READ);
+  return I2C_Transfer(Reg, pBuff, nBuffSize, 1);
+}
+
 
-  for(uint16_t i = 0; i < nBuffSize; i++) {
-    /* Wait for the RX Not Empty flag */
-    while(LL_I2C_IsActiveFlag_RXNE(BSP_I2C) == 0); /* TODO: add a SW timeout */
+/**
+  * @brief  Start a non-blocking write of nBuffSize bytes to the LPS22HH,
+  *         from register Reg (auto-increment).
+  *         BSP_I2C_IRQHandler() must be called from the I2C interrupt handler.
+  * @param  Reg: first register.
+  * @param  pBuff: data to write. It must be valid until the end of the transfer.
+  * @param  nBuffSize: number of bytes, from 1 to 254.
+  * @param  Callback: called from the I2C interrupt at the end of the transfer
+  *         with its status (BSP_ERROR_NONE or BSP_ERROR_BUS_FAILURE). It can be NULL.
+  * @retval BSP_ERROR_NONE if the transfer has been started,
+  *         BSP_ERROR_BUSY if a transfer is ongoing, BSP_ERROR_WRONG_PARAM
+  */
+int32_t BSP_I2C_WriteAsync(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, void (*Callback)(int32_t status))
+{
+  int32_t ret;
+
+  NVIC_SetPriority(BSP_I2C_IRQn, IRQ_LOW_PRIORITY);
+  NVIC_EnableIRQ(BSP_I2C_IRQn);
+
+  ret = I2C_Start(Reg, pBuff, nBuffSize, 0, Callback);
 
-    /* Get the received byte from the RX FIFO */
-    pBuff[i] = LL_I2C_ReceiveData8(BSP_I2C);
+  return ret;
+}
+
+
+/**
+  * @brief  Start a non-blocking read of nBuffSize bytes from the LPS22HH,
+  *         from register Reg (auto-increment).
+  *         BSP_I2C_IRQHandler() must be called from the I2C interrupt handler.
+  * @param  Reg: first register.
+  * @param  pBuff: buffer for the data. It is filled until the end of the transfer.
+  * @param  nBuffSize: number of bytes, from 1 to 255.
+  * @param  Callback: called from the I2C interrupt at the end of the transfer
+  *         with its status (BSP_ERROR_NONE or BSP_ERROR_BUS_FAILURE). It can be NULL.
+  * @retval BSP_ERROR_NONE if the transfer has been started,
+  *         BSP_ERROR_BUSY if a transfer is ongoing, BSP_ERROR_WRONG_PARAM
+  */
+int32_t BSP_I2C_ReadAsync(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, void (*Callback)(int32_t status))
+{
+  int32_t ret;
+
+  NVIC_SetPriority(BSP_I2C_IRQn, IRQ_LOW_PRIORITY);
+  NVIC_EnableIRQ(BSP_I2C_IRQn);
+
+  ret = I2C_Start(Reg, pBuff, nBuffSize, 1, Callback);
+
+  return ret;
+}
+
+
+/**
+  * @brief  Tell if an I2C transfer is ongoing.
+  * @param  None
+  * @retval 1 if a transfer is ongoing, 0 otherwise.
+  */
+uint8_t BSP_I2C_IsBusy(void)
+{
+  return (i2cState != I2C_STATE_IDLE);
+}
+
+
+/**
+  * @brief  Abort the ongoing I2C transfer, if any. The callback is not called.
+  *         The I2C peripheral is reset (PE cleared), so the slave sees the
+  *         bus released.
+  * @param  None
+  * @retval None
+  */
+void BSP_I2C_Abort(void)
+{
+  if(i2cState != I2C_STATE_IDLE)
+    I2C_Stop(1);
+}
+
+
+/**
+  * @brief  This function handles the I2C interrupt request of the transfers
+  *         started with BSP_I2C_WriteAsync() and BSP_I2C_ReadAsync().
+  *         To be called from the I2C1 interrupt handler of the application.
+  * @param  None
+  * @retval None
+  */
+void BSP_I2C_IRQHandler(void)
+{
+  int32_t status;
+  void (*callback)(int32_t status);
+
+  if((i2cState == I2C_STATE_IDLE) || (i2cState == I2C_STATE_POLLING))
+    return;
+
+  /* Bus error or arbitration lost: no STOP follows, end the transfer now */
+  if(LL_I2C_IsActiveFlag_BERR(BSP_I2C) || LL_I2C_IsActiveFlag_ARLO(BSP_I2C) || LL_I2C_IsActiveFlag_OVR(BSP_I2C)) {
+    callback = i2cCallback;
+    I2C_Stop(1);
+    if(callback != NULL)
+      callback(BSP_ERROR_BUS_FAILURE);
+    return;
+  }
+
+  /* Address or data not acknowledged: the STOP is sent by the peripheral */
+  if(LL_I2C_IsActiveFlag_NACK(BSP_I2C)) {
+    LL_I2C_ClearFlag_NACK(BSP_I2C);
+    i2cStatus = BSP_ERROR_BUS_FAILURE;
+  }
+
+  if(LL_I2C_IsActiveFlag_TXIS(BSP_I2C)) {
+    if(i2cState == I2C_STATE_REG) {
+      LL_I2C_TransmitData8(BSP_I2C, (i2cReg | 0x80)); // |0x80 auto-increment
+      i2cState = i2cRead ? I2C_STATE_RESTART : I2C_STATE_DATA;
+    }
+    else if(i2cCount < i2cSize) {
+      LL_I2C_TransmitData8(BSP_I2C, i2cBuff[i2cCount++]);
+    }
+  }
+
+  if(LL_I2C_IsActiveFlag_RXNE(BSP_I2C)) {
+    if(i2cCount < i2cSize) {
+      i2cBuff[i2cCount++] = LL_I2C_ReceiveData8(BSP_I2C);
+    }
+    else {
+      LL_I2C_ReceiveData8(BSP_I2C);
+    }
   }
 
-  /* Wait for the Transfer Complete flag */
-//    while(LL_I2C_IsActiveFlag_TC(BSP_I2C) == 0);
+  /* Register address sent: restart in read mode */
+  if(LL_I2C_IsActiveFlag_TC(BSP_I2C) && (i2cState == I2C_STATE_RESTART)) {
+    i2cState = I2C_STATE_DATA;
+    LL_I2C_HandleTransfer(BSP_I2C, LPS22HH_I2C_ADD_L, LL_I2C_ADDRSLAVE_7BIT, i2cSize, LL_I2C_MODE_AUTOEND, LL_I2C_GENERATE_RESTART_7BIT_READ);
+  }
+
+  if(LL_I2C_IsActiveFlag_STOP(BSP_I2C)) {
+    LL_I2C_ClearFlag_STOP(BSP_I2C);
+
+    /* NACK of the last byte sent, set after the check above */
+    if(LL_I2C_IsActiveFlag_NACK(BSP_I2C)) {
+      LL_I2C_ClearFlag_NACK(BSP_I2C);
+      i2cStatus = BSP_ERROR_BUS_FAILURE;
+    }
+
+    status = i2cStatus;
+    if((status == BSP_ERROR_NONE) && (i2cCount < i2cSize))
+      status = BSP_ERROR_BUS_FAILURE;
+
+    callback = i2cCallback;
+    I2C_Stop(0);
+    if(callback != NULL)
+      callback(status);
+  }
+}
+
+
+/**
+  * @}
+  */ 
+
+
+/** @defgroup BSP_BLUENRGLP_I2C_Private_Functions Private Functions
+  * @{
+  */ 
+
+/**
+  * @brief  Start a transfer of the interrupt state machine.
+  * @param  Reg: first register.
+  * @param  pBuff: data buffer.
+  * @param  nBuffSize: number of bytes.
+  * @param  read: 1 for a read, 0 for a write.
+  * @param  Callback: end of transfer callback, or NULL.
+  * @retval BSP_ERROR_NONE, BSP_ERROR_BUSY or BSP_ERROR_WRONG_PARAM
+  */
+static int32_t I2C_Start(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, uint8_t read, void (*Callback)(int32_t status))
+{
+  /* NBYTES is 8 bits wide, and a write also sends the register address */
+  if((pBuff == NULL) || (nBuffSize == 0) || (nBuffSize > (read ? 255 : 254)))
+    return BSP_ERROR_WRONG_PARAM;
+
+  ATOMIC_SECTION_BEGIN();
+  if(i2cState != I2C_STATE_IDLE) {
+    ATOMIC_SECTION_END();
+    return BSP_ERROR_BUSY;
+  }
+  i2cState = I2C_STATE_REG;
+  ATOMIC_SECTION_END();
+
+  i2cReg = Reg;
+  i2cBuff = pBuff;
+  i2cSize = nBuffSize;
+  i2cCount = 0;
+  i2cRead = read;
+  i2cCallback = Callback;
+  i2cStatus = BSP_ERROR_NONE;
+
+  LL_I2C_ClearFlag_NACK(BSP_I2C);
+  LL_I2C_ClearFlag_STOP(BSP_I2C);
+  LL_I2C_ClearFlag_BERR(BSP_I2C);
+  LL_I2C_ClearFlag_ARLO(BSP_I2C);
+  LL_I2C_ClearFlag_OVR(BSP_I2C);
+
+  /* Enable I2C transfer complete/error interrupts */
+  LL_I2C_EnableIT_TX(BSP_I2C);
+  LL_I2C_EnableIT_RX(BSP_I2C);
+  LL_I2C_EnableIT_TC(BSP_I2C);
+  LL_I2C_EnableIT_NACK(BSP_I2C);
+  LL_I2C_EnableIT_ERR(BSP_I2C);
+  LL_I2C_EnableIT_STOP(BSP_I2C);
+
+  if(read) {
+    /* Register address only, then restart (see BSP_I2C_IRQHandler()) */
+    LL_I2C_HandleTransfer(BSP_I2C, LPS22HH_I2C_ADD_L, LL_I2C_ADDRSLAVE_7BIT, 1, LL_I2C_MODE_SOFTEND, LL_I2C_GENERATE_START_WRITE);
+  }
+  else {
+    LL_I2C_HandleTransfer(BSP_I2C, LPS22HH_I2C_ADD_L, LL_I2C_ADDRSLAVE_7BIT, nBuffSize+1, LL_I2C_MODE_AUTOEND, LL_I2C_GENERATE_START_WRITE);
+  }
+
+  return BSP_ERROR_NONE;
+}
+
+
+/**
+  * @brief  End the transfer: disable the interrupts.
+  * @param  reset: 1 to reset the peripheral (error or abort).
+  * @retval None
+  */
+static void I2C_Stop(uint8_t reset)
+{
+  LL_I2C_DisableIT_TX(BSP_I2C);
+  LL_I2C_DisableIT_RX(BSP_I2C);
+  LL_I2C_DisableIT_TC(BSP_I2C);
+  LL_I2C_DisableIT_NACK(BSP_I2C);
+  LL_I2C_DisableIT_ERR(BSP_I2C);
+  LL_I2C_DisableIT_STOP(BSP_I2C);
+
+  if(reset) {
+    /* Software reset: release the bus and clear the flags.
+       PE must be kept low for at least 3 APB clock cycles */
+    LL_I2C_Disable(BSP_I2C);
+    while(LL_I2C_IsEnabled(BSP_I2C));
+    __NOP(); __NOP(); __NOP();
+    LL_I2C_Enable(BSP_I2C);
+  }
+
+  i2cCallback = NULL;
+  i2cState = I2C_STATE_IDLE;
+}
+
+
+/**
+  * @brief  Wait for an I2C flag by polling.
+  * @param  Flag: I2C_ISR flag.
+  * @retval BSP_ERROR_NONE, BSP_ERROR_BUS_FAILURE on NACK, bus error or
+  *         arbitration lost, or BSP_ERROR_TIMEOUT after BSP_BUS_TIMEOUT loops
+  */
+static int32_t I2C_WaitFlag(uint32_t Flag)
+{
+  uint32_t loop = 0;
+
+  while(loop++ < BSP_BUS_TIMEOUT) {
+    if(LL_I2C_IsActiveFlag_NACK(BSP_I2C) || LL_I2C_IsActiveFlag_BERR(BSP_I2C) || LL_I2C_IsActiveFlag_ARLO(BSP_I2C))
+      return BSP_ERROR_BUS_FAILURE;
+    if(READ_BIT(BSP_I2C->ISR, Flag) == Flag)
+      return BSP_ERROR_NONE;
+  }
+
+  return BSP_ERROR_TIMEOUT;
+}
+
+
+/**
+  * @brief  Blocking transfer: the register address and the data go through the
+  *         I2C by polling, each byte within BSP_BUS_TIMEOUT loops.
+  * @param  Reg: first register.
+  * @param  pBuff: data buffer.
+  * @param  nBuffSize: number of bytes.
+  * @param  read: 1 for a read, 0 for a write.
+  * @retval BSP_ERROR_NONE, BSP_ERROR_BUSY, BSP_ERROR_WRONG_PARAM,
+  *         BSP_ERROR_BUS_FAILURE or BSP_ERROR_TIMEOUT
+  */
+static int32_t I2C_Transfer(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, uint8_t read)
+{
+  int32_t ret;
+
+  /* NBYTES is 8 bits wide, and a write also sends the register address */
+  if((pBuff == NULL) || (nBuffSize == 0) || (nBuffSize > (read ? 255 : 254)))
+    return BSP_ERROR_WRONG_PARAM;
+
+  ATOMIC_SECTION_BEGIN();
+  if(i2cState != I2C_STATE_IDLE) {
+    ATOMIC_SECTION_END();
+    return BSP_ERROR_BUSY;
+  }
+  i2cState = I2C_STATE_POLLING;
+  ATOMIC_SECTION_END();
+
+  LL_I2C_ClearFlag_NACK(BSP_I2C);
+  LL_I2C_ClearFlag_STOP(BSP_I2C);
+  LL_I2C_ClearFlag_BERR(BSP_I2C);
+  LL_I2C_ClearFlag_ARLO(BSP_I2C);
+
+  /* Register address, then the data to write or a restart to read them */
+  LL_I2C_HandleTransfer(BSP_I2C, LPS22HH_I2C_ADD_L, LL_I2C_ADDRSLAVE_7BIT, read ? 1 : nBuffSize+1,
+                        read ? LL_I2C_MODE_SOFTEND : LL_I2C_MODE_AUTOEND, LL_I2C_GENERATE_START_WRITE);
+
+  ret = I2C_WaitFlag(I2C_ISR_TXIS);
+  if(ret == BSP_ERROR_NONE)
+    LL_I2C_TransmitData8(BSP_I2C, (Reg | 0x80)); // |0x80 auto-increment
+
+  if(read) {
+    if(ret == BSP_ERROR_NONE)
+      ret = I2C_WaitFlag(I2C_ISR_TC);
+    if(ret == BSP_ERROR_NONE)
+      LL_I2C_HandleTransfer(BSP_I2C, LPS22HH_I2C_ADD_L, LL_I2C_ADDRSLAVE_7BIT, nBuffSize, LL_I2C_MODE_AUTOEND, LL_I2C_GENERATE_RESTART_7BIT_READ);
+    for(uint16_t i = 0; (i < nBuffSize) && (ret == BSP_ERROR_NONE); i++) {
+      ret = I2C_WaitFlag(I2C_ISR_RXNE);
+      if(ret == BSP_ERROR_NONE)
+        pBuff[i] = LL_I2C_ReceiveData8(BSP_I2C);
+    }
+  }
+  else {
+    for(uint16_t i = 0; (i < nBuffSize) && (ret == BSP_ERROR_NONE); i++) {
+      ret = I2C_WaitFlag(I2C_ISR_TXIS);
+      if(ret == BSP_ERROR_NONE)
+        LL_I2C_TransmitData8(BSP_I2C, pBuff[i]);
+    }
+  }
+
+  /* STOP sent at the end of the last byte */
+  if(ret == BSP_ERROR_NONE)
+    ret = I2C_WaitFlag(I2C_ISR_STOPF);
+
+  if(ret == BSP_ERROR_NONE) {
+    LL_I2C_ClearFlag_STOP(BSP_I2C);
+    i2cState = I2C_STATE_IDLE;
+  }
+  else {
+    /* The peripheral reset releases the bus and clears the error flags */
+    I2C_Stop(1);
+  }
 
-  return 0;
+  return ret;
 }
 
 
@@ -0,0 +1,376 @@
+/**
+  ******************************************************************************
+  * @file    bluenrg_lp_evb_motion.c
+  * @author  RF Application Team
+  * @brief   This file provides a service streaming the FIFO of the inertial
+  *          module LSM6DSOX available on BlueNRGLP-EVB Kit: batching of the
+  *          accelerometer and gyroscope, watermark interrupt on INT1, burst
+  *          read of the FIFO by SPI DMA and decoding of the samples.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT(c) 2019 STMicroelectronics</center></h2>
+  *
+  * Redistribution and use in source and binary forms, with or without modification,
+  * are permitted provided that the following conditions are met:
+  *   1. Redistributions of source code must retain the above copyright notice,
+  *      this list of conditions and the following disclaimer.
+  *   2. Redistributions in binary form must reproduce the above copyright notice,
+  *      this list of conditions and the following disclaimer in the documentation
+  *      and/or other materials provided with the distribution.
+  *   3. Neither the name of STMicroelectronics nor the names of its contributors
+  *      may be used to endorse or promote products derived from this software
+  *      without specific prior written permission.
+  *
+  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "bluenrg_lp_evb_motion.h"
+#include "bluenrg_lp_evb_spi.h"
+#include "rf_driver_ll_exti.h"
+
+#include "lsm6dsox_reg.h"
+
+
+/** @addtogroup BSP
+  * @{
+  */ 
+
+/** @defgroup BSP_BLUENRGLP_MOTION BSP BlueNRG-LP motion FIFO
+  * @{
+  */ 
+
+
+/** @defgroup BSP_BLUENRGLP_MOTION_Private_Variables Private Variables
+  * @{
+  */
+
+/* Size of a FIFO word: tag followed by 6 bytes of data */
+#define FIFO_WORD_SIZE          7
+
+#define MOTION_STATE_IDLE       0  /* Not started */
+#define MOTION_STATE_WAIT       1  /* Waiting for the watermark */
+#define MOTION_STATE_READ       2  /* SPI DMA burst ongoing */
+#define MOTION_STATE_DECODE     3  /* Burst done, to be decoded by BSP_MOTION_Tick() */
+
+static lsm6dsox_ctx_t motionCtx = {BSP_SPI_Write, BSP_SPI_Read, NULL};
+
+static volatile uint8_t motionState = MOTION_STATE_IDLE;
+static volatile uint8_t motionPending;
+static volatile int32_t motionReadStatus;
+static BSP_MOTION_BatchCb_t motionBatchCb;
+static uint16_t motionLevel;
+static uint16_t motionWords;
+static uint32_t motionTimestamp;
+static BSP_MOTION_Stats_t motionStats;
+
+static uint8_t motionRaw[BSP_MOTION_BURST_WORDS*FIFO_WORD_SIZE];
+static BSP_MOTION_Sample_t motionSamples[BSP_MOTION_BURST_WORDS];
+
+static void Motion_ReadDone(int32_t status);
+static void Motion_Decode(void);
+
+/**
+  * @}
+  */ 
+
+
+/** @defgroup BSP_BLUENRGLP_MOTION_Exported_Functions Exported Functions
+  * @{
+  */ 
+
+
+/**
+  * @brief  Configure the batching of the LSM6DSOX FIFO and start the streaming.
+  *         The FIFO is in stream mode, its watermark is routed to INT1.
+  *         BSP_SPI_Init() must have been called. The INT1 pin is configured
+  *         with BSP_SPI_GpioInt_Init(): BSP_MOTION_IRQHandler() must be called
+  *         from its EXTI handler and BSP_SPI_DMA_IRQHandler() from the DMA one.
+  * @param  pConfig: configuration.
+  * @retval BSP_ERROR_NONE, BSP_ERROR_WRONG_PARAM, BSP_ERROR_BUSY if already
+  *         started, BSP_ERROR_COMPONENT_FAILURE if the sensor is not found or
+  *         the SPI error code.
+  */
+int32_t BSP_MOTION_Start(const BSP_MOTION_Config_t *pConfig)
+{
+  lsm6dsox_pin_int1_route_t int1_route;
+  uint8_t id;
+  int32_t ret;
+
+  if((pConfig == NULL) || (pConfig->watermark == 0) || (pConfig->watermark > 511))
+    return BSP_ERROR_WRONG_PARAM;
+
+  if(motionState != MOTION_STATE_IDLE)
+    return BSP_ERROR_BUSY;
+
+  ret = lsm6dsox_device_id_get(&motionCtx, &id);
+  if((ret == BSP_ERROR_NONE) && (id != LSM6DSOX_ID))
+    return BSP_ERROR_COMPONENT_FAILURE;
+
+  /* Empty the FIFO, then configure the batching */
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_block_data_update_set(&motionCtx, PROPERTY_ENABLE);
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_fifo_mode_set(&motionCtx, LSM6DSOX_BYPASS_MODE);
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_fifo_watermark_set(&motionCtx, pConfig->watermark);
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_fifo_xl_batch_set(&motionCtx, pConfig->acc_batch);
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_fifo_gy_batch_set(&motionCtx, pConfig->gyro_batch);
+
+  /* A timestamp word is batched with each set of samples */
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_fifo_timestamp_decimation_set(&motionCtx, LSM6DSOX_DEC_1);
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_timestamp_set(&motionCtx, PROPERTY_ENABLE);
+
+  /* FIFO watermark on INT1 */
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_pin_int1_route_get(&motionCtx, &int1_route);
+  if(ret == BSP_ERROR_NONE) {
+    int1_route.int1_ctrl.int1_fifo_th = PROPERTY_ENABLE;
+    ret = lsm6dsox_pin_int1_route_set(&motionCtx, &int1_route);
+  }
+
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_xl_data_rate_set(&motionCtx, pConfig->acc_odr);
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_gy_data_rate_set(&motionCtx, pConfig->gyro_odr);
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_fifo_mode_set(&motionCtx, LSM6DSOX_STREAM_MODE);
+
+  if(ret != BSP_ERROR_NONE)
+    return ret;
+
+  motionBatchCb = pConfig->BatchCb;
+  motionTimestamp = 0;
+  motionPending = FALSE;
+  motionState = MOTION_STATE_WAIT;
+
+  BSP_SPI_GpioInt_Init();
+
+  return BSP_ERROR_NONE;
+}
+
+
+/**
+  * @brief  Stop the streaming: the sensors are powered down and the FIFO
+  *         is emptied. The samples not yet passed to the callback are lost.
+  * @param  None
+  * @retval BSP_ERROR_NONE or the SPI error code.
+  */
+int32_t BSP_MOTION_Stop(void)
+{
+  lsm6dsox_pin_int1_route_t int1_route;
+  int32_t ret;
+
+  if(motionState == MOTION_STATE_IDLE)
+    return BSP_ERROR_NONE;
+
+  LL_EXTI_DisableIT(BSP_SENSOR1_INT_EXTI_LINE);
+  if(motionState == MOTION_STATE_READ)
+    BSP_SPI_Abort();
+  motionState = MOTION_STATE_IDLE;
+  motionPending = FALSE;
+
+  ret = lsm6dsox_pin_int1_route_get(&motionCtx, &int1_route);
+  if(ret == BSP_ERROR_NONE) {
+    int1_route.int1_ctrl.int1_fifo_th = PROPERTY_DISABLE;
+    ret = lsm6dsox_pin_int1_route_set(&motionCtx, &int1_route);
+  }
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_xl_data_rate_set(&motionCtx, LSM6DSOX_XL_ODR_OFF);
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_gy_data_rate_set(&motionCtx, LSM6DSOX_GY_ODR_OFF);
+  if(ret == BSP_ERROR_NONE)
+    ret = lsm6dsox_fifo_mode_set(&motionCtx, LSM6DSOX_BYPASS_MODE);
+
+  return ret;
+}
+
+
+/**
+  * @brief  Streaming state machine, to be called in the main loop.
+  *         On watermark, the FIFO level is read and up to BSP_MOTION_BURST_WORDS
+  *         words are read in a single SPI DMA transfer. When the transfer is
+  *         done, the words are decoded and passed to the batch callback. The
+  *         FIFO is drained until it is empty, so that INT1 can rise again.
+  * @param  None
+  * @retval None
+  */
+void BSP_MOTION_Tick(void)
+{
+  uint8_t status[2];
+
+  if(motionState == MOTION_STATE_DECODE) {
+    Motion_Decode();
+    motionState = MOTION_STATE_WAIT;
+    if((motionLevel > motionWords) || LL_GPIO_IsInputPinSet(BSP_SENSOR1_INT_GPIO_PORT, BSP_SENSOR1_INT_PIN))
+      motionPending = TRUE;
+  }
+
+  if((motionState != MOTION_STATE_WAIT) || (motionPending == FALSE))
+    return;
+
+  motionPending = FALSE;
+
+  /* FIFO_STATUS1 and FIFO_STATUS2: number of words and overrun */
+  if(lsm6dsox_read_reg(&motionCtx, LSM6DSOX_FIFO_STATUS1, status, 2) != BSP_ERROR_NONE) {
+    motionStats.errors++;
+    motionPending = TRUE;
+    return;
+  }
+  motionLevel = ((uint16_t)((lsm6dsox_fifo_status2_t *)&status[1])->diff_fifo << 8) + status[0];
+  if(((lsm6dsox_fifo_status2_t *)&status[1])->over_run_latched)
+    motionStats.overruns++;
+
+  if(motionLevel == 0)
+    return;
+
+  motionWords = (motionLevel > BSP_MOTION_BURST_WORDS) ? BSP_MOTION_BURST_WORDS : motionLevel;
+
+  /* With IF_INC (default) the address wraps from FIFO_DATA_OUT_Z_H back to
+     FIFO_DATA_OUT_TAG: all the words are read in a single transfer */
+  motionState = MOTION_STATE_READ;
+  if(BSP_SPI_ReadAsync(LSM6DSOX_FIFO_DATA_OUT_TAG, motionRaw, motionWords*FIFO_WORD_SIZE, Motion_ReadDone) != BSP_ERROR_NONE) {
+    /* SPI busy or error: retry at next call */
+    motionState = MOTION_STATE_WAIT;
+    motionPending = TRUE;
+  }
+}
+
+
+/**
+  * @brief  Tell if the streaming needs the CPU (or the DMA) before the
+  *         next watermark. The application must not enter a low power mode
+  *         that stops the SPI and the DMA while it returns TRUE.
+  * @param  None
+  * @retval TRUE if busy, FALSE otherwise.
+  */
+uint8_t BSP_MOTION_IsBusy(void)
+{
+  return (motionState == MOTION_STATE_READ) || (motionState == MOTION_STATE_DECODE) || motionPending;
+}
+
+
+/**
+  * @brief  This function handles the watermark interrupt (INT1 of the LSM6DSOX).
+  *         To be called from the EXTI interrupt handler of BSP_SENSOR1_INT_PIN.
+  * @param  None
+  * @retval None
+  */
+void BSP_MOTION_IRQHandler(void)
+{
+  if(LL_EXTI_IsInterruptPending(BSP_SENSOR1_INT_EXTI_LINE)) {
+    LL_EXTI_ClearInterrupt(BSP_SENSOR1_INT_EXTI_LINE);
+    if(motionState != MOTION_STATE_IDLE)
+      motionPending = TRUE;
+  }
+}
+
+
+/**
+  * @brief  Get the statistics of the streaming.
+  * @param  pStats: filled with the statistics since the reset.
+  * @retval None
+  */
+void BSP_MOTION_GetStats(BSP_MOTION_Stats_t *pStats)
+{
+  *pStats = motionStats;
+}
+
+
+/**
+  * @}
+  */ 
+
+
+/** @defgroup BSP_BLUENRGLP_MOTION_Private_Functions Private Functions
+  * @{
+  */ 
+
+/**
+  * @brief  End of the SPI DMA burst (DMA interrupt).
+  * @param  status: status of the transfer.
+  * @retval None
+  */
+static void Motion_ReadDone(int32_t status)
+{
+  motionReadStatus = status;
+  motionState = MOTION_STATE_DECODE;
+}
+
+/**
+  * @brief  Decode the FIFO words of the last burst and pass the samples to
+  *         the batch callback. The timestamp words update the timestamp of
+  *         the samples that follow; the other tags are skipped.
+  * @param  None
+  * @retval None
+  */
+static void Motion_Decode(void)
+{
+  uint8_t *word;
+  uint16_t count = 0;
+
+  if(motionReadStatus != BSP_ERROR_NONE) {
+    motionStats.errors++;
+    return;
+  }
+  motionStats.bursts++;
+
+  for(uint16_t i = 0; i < motionWords; i++) {
+    word = &motionRaw[i*FIFO_WORD_SIZE];
+
+    /* TAG_SENSOR in bits [7:3] of FIFO_DATA_OUT_TAG */
+    switch(word[0] >> 3) {
+    case LSM6DSOX_TIMESTAMP_TAG:
+      motionTimestamp = (uint32_t)word[1] | ((uint32_t)word[2] << 8) |
+                        ((uint32_t)word[3] << 16) | ((uint32_t)word[4] << 24);
+      break;
+    case LSM6DSOX_XL_NC_TAG:
+    case LSM6DSOX_GYRO_NC_TAG:
+      motionSamples[count].sensor = ((word[0] >> 3) == LSM6DSOX_XL_NC_TAG) ? BSP_MOTION_ACC : BSP_MOTION_GYRO;
+      motionSamples[count].timestamp = motionTimestamp;
+      motionSamples[count].data[0] = (int16_t)((uint16_t)word[1] | ((uint16_t)word[2] << 8));
+      motionSamples[count].data[1] = (int16_t)((uint16_t)word[3] | ((uint16_t)word[4] << 8));
+      motionSamples[count].data[2] = (int16_t)((uint16_t)word[5] | ((uint16_t)word[6] << 8));
+      count++;
+      break;
+    default:
+      break;
+    }
+  }
+
+  motionStats.samples += count;
+  if((count > 0) && (motionBatchCb != NULL))
+    motionBatchCb(motionSamples, count);
+}
+
+
+/**
+  * @}
+  */ 
+
+
+/**
+  * @}
+  */  
+    
+/**
+  * @}
+  */  
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -37,6 +37,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "bluenrg_lp_evb_spi.h"
 #include "rf_driver_ll_spi.h"
+#include "rf_driver_ll_dma.h"
 
 #include "lsm6dsox_reg.h"
 
@@ -50,6 +51,40 @@
   */ 
 
 
+/** @defgroup BSP_BLUENRGLP_SPI_Private_Variables Private Variables
+  * @{
+  */
+
+#define ATOMIC_SECTION_BEGIN() uint32_t uwPRIMASK_Bit = __get_PRIMASK(); \
+                                __disable_irq(); \
+/* Must be called in the same or in a lower scope of ATOMIC_SECTION_BEGIN */
+#define ATOMIC_SECTION_END() __set_PRIMASK(uwPRIMASK_Bit)
+
+/* DMA1 ISR/IFCR have 4 bits per channel, as channel 1 */
+#define SPI_DMA_FLAGS(ch, flag)           ((flag) << (((ch) - 1U) * 4U))
+#define SPI_DMA_IS_ACTIVE_FLAG(ch, flag)  ((DMA1->ISR & SPI_DMA_FLAGS(ch, flag)) != 0U)
+/* Flags of both channels, in a single write */
+#define SPI_DMA_CLEAR_FLAGS()             WRITE_REG(DMA1->IFCR, SPI_DMA_FLAGS(BSP_SPI_RX_DMA_CH, DMA_IFCR_CGIF1) | \
+                                                                SPI_DMA_FLAGS(BSP_SPI_TX_DMA_CH, DMA_IFCR_CGIF1))
+
+#define SPI_STATE_IDLE          0
+#define SPI_STATE_BUSY          1
+
+static volatile uint8_t spiState = SPI_STATE_IDLE;
+static void (*spiCallback)(int32_t status);
+/* Dummy byte sent while reading, and received while writing */
+static uint8_t spiDummy;
+
+static int32_t SPI_Start(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, uint8_t read, void (*Callback)(int32_t status));
+static void SPI_Stop(void);
+static int32_t SPI_TransferByte(uint8_t TxData, uint8_t *pRxData);
+static int32_t SPI_Transfer(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, uint8_t read);
+
+/**
+  * @}
+  */ 
+
+
 /** @defgroup BSP_BLUENRGLP_SPI_Exported_Functions Exported Functions
   * @{
   */ 
@@ -110,6 +145,18 @@ void BSP_SPI_Init(void)
   /* Configure the SPI RX FIFO threshold to 1 byte */
   LL_SPI_SetRxFIFOThreshold(BSP_SPI, LL_SPI_RX_FIFO_TH_QUARTER);
 
+  /* Configure the DMA channels of BSP_SPI_WriteAsync()/BSP_SPI_ReadAsync():
+   * byte transfers, addresses and memory increment set at each transfer */
+  LL_AHB_EnableClock(LL_AHB_PERIPH_DMA);
+  LL_DMA_ConfigTransfer(DMA1, BSP_SPI_TX_DMA_CH, LL_DMA_DIRECTION_MEMORY_TO_PERIPH | LL_DMA_MODE_NORMAL |
+                       LL_DMA_PERIPH_NOINCREMENT | LL_DMA_MEMORY_INCREMENT |
+                       LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE | LL_DMA_PRIORITY_MEDIUM);
+  LL_DMA_SetPeriphRequest(DMA1, BSP_SPI_TX_DMA_CH, BSP_SPI_TX_DMA_REQ);
+  LL_DMA_ConfigTransfer(DMA1, BSP_SPI_RX_DMA_CH, LL_DMA_DIRECTION_PERIPH_TO_MEMORY | LL_DMA_MODE_NORMAL |
+                       LL_DMA_PERIPH_NOINCREMENT | LL_DMA_MEMORY_INCREMENT |
+                       LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE | LL_DMA_PRIORITY_HIGH);
+  LL_DMA_SetPeriphRequest(DMA1, BSP_SPI_RX_DMA_CH, BSP_SPI_RX_DMA_REQ);
+
   /* Enable the SPI */
   LL_SPI_Enable(BSP_SPI);
   
@@ -123,6 +170,9 @@ void BSP_SPI_Init(void)
   */
 void BSP_SPI_DeInit(void)
 {
+  /* Stop the ongoing transfer, if any */
+  BSP_SPI_Abort();
+
   /* Disable the SPI interrupts */
   LL_SPI_DisableIT_TXE(BSP_SPI);
   LL_SPI_DisableIT_RXNE(BSP_SPI);
@@ -158,96 +208,33 @@ void BSP_SPI_DeInit(void)
 
 /**
   * @brief  SPI write function used for the inertial module LSM6DSO.
+  *         The data are written to the SPI FIFO by polling, the DMA is not used.
   * @param  handle: handle. 
   * @param  Reg: Reg. 
   * @param  pBuff: pBuff. 
   * @param  nBuffSize: nBuffSize. 
-  * @retval None
+  * @retval BSP_ERROR_NONE, BSP_ERROR_BUSY if an asynchronous transfer is ongoing,
+  *         BSP_ERROR_TIMEOUT if a byte is not transferred within BSP_BUS_TIMEOUT loops
   */
 int32_t BSP_SPI_Write(void *handle, uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize)
 {
-  /* Open the SPI communication by drive low the CS pin */
-  LL_GPIO_ResetOutputPin(BSP_SPI_CS_SENSOR1_GPIO_PORT, BSP_SPI_CS_SENSOR1_PIN);
-  
-  while(LL_SPI_IsActiveFlag_TXE(BSP_SPI) == 0); /* TODO: add a SW timeout */
-  
-  /* Send the register address */
-  LL_SPI_TransmitData8(BSP_SPI, Reg);
-  
-  /* Wait for the TX flag */
-  while(LL_SPI_IsActiveFlag_RXNE(BSP_SPI) == 0); /* TODO: add a SW timeout */
-  
-  /* Read the available data */
-  LL_SPI_ReceiveData8(BSP_SPI);
-  
-  for(uint16_t i = 0; i < nBuffSize; i++) {
-    /* Wait for the TX flag */
-    while(LL_SPI_IsActiveFlag_TXE(BSP_SPI) == 0); /* TODO: add a SW timeout */
-    
-    /* Send the data available */
-    LL_SPI_TransmitData8(BSP_SPI, pBuff[i]);
-    
-    /* Wait for the TX flag */
-    while(LL_SPI_IsActiveFlag_RXNE(BSP_SPI) == 0); /* TODO: add a SW timeout */
-    
-    /* Read the available data */
-    LL_SPI_ReceiveData8(BSP_SPI);
-  }
-  
-  /* Wait for the Busy flag */
-  while(LL_SPI_IsActiveFlag_BSY(BSP_SPI) == 1);
-  
-  /* Close the SPI communication by drive high the CS pin */
-  LL_GPIO_SetOutputPin(BSP_SPI_CS_SENSOR1_GPIO_PORT, BSP_SPI_CS_SENSOR1_PIN);
-  
-  return 0;
+  return SPI_Transfer(Reg, pBuff, nBuffSize, 0);
 }
 
 
 /**
   * @brief  SPI read function used for the inertial module LSM6DSO.
+  *         The data are read from the SPI FIFO by polling, the DMA is not used.
   * @param  handle: handle. 
   * @param  Reg: Reg. 
   * @param  pBuff: pBuff. 
   * @param  nBuffSize: nBuffSize. 
-  * @retval None
+  * @retval BSP_ERROR_NONE, BSP_ERROR_BUSY if an asynchronous transfer is ongoing,
+  *         BSP_ERROR_TIMEOUT if a byte is not transferred within BSP_BUS_TIMEOUT loops
   */
 int32_t BSP_SPI_Read(void *handle, uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize)
 {
-  /* Open the SPI communication by drive low the CS pin */
-  LL_GPIO_ResetOutputPin(BSP_SPI_CS_SENSOR1_GPIO_PORT, BSP_SPI_CS_SENSOR1_PIN);
-  
-  while(LL_SPI_IsActiveFlag_TXE(BSP_SPI) == 0); /* TODO: add a SW timeout */
-  
-  LL_SPI_TransmitData8(BSP_SPI, (Reg | 0x80) );
-  
-  /* Wait for the TX flag */
-  while(LL_SPI_IsActiveFlag_RXNE(BSP_SPI) == 0); /* TODO: add a SW timeout */
-  
-  /* Read the available data */
-  LL_SPI_ReceiveData8(BSP_SPI);
-  
-  for(uint16_t i = 0; i < nBuffSize; i++) {
-    /* Wait for the TX flag */
-    while(LL_SPI_IsActiveFlag_TXE(BSP_SPI) == 0); /* TODO: add a SW timeout */
-    
-    /* Send the data available */
-    LL_SPI_TransmitData8(BSP_SPI, 0xFF);
-    
-    /* Wait for the TX flag */
-    while(LL_SPI_IsActiveFlag_RXNE(BSP_SPI) == 0); /* TODO: add a SW timeout */
-    
-    /* Read the available data */
-    pBuff[i] = LL_SPI_ReceiveData8(BSP_SPI);
-  }
-  
-  /* Wait for the Busy flag */
-  while(LL_SPI_IsActiveFlag_BSY(BSP_SPI) == 1);
-  
-  /* Close the SPI communication by drive high the CS pin */
-  LL_GPIO_SetOutputPin(BSP_SPI_CS_SENSOR1_GPIO_PORT, BSP_SPI_CS_SENSOR1_PIN);
-  
-  return 0;
+  return SPI_Transfer(Reg, pBuff, nBuffSize, 1);
 }
 
 
@@ -275,6 +262,304 @@ void BSP_SPI_GpioInt_Init(void)
   
 }
 
+
+/**
+  * @brief  Start a non-blocking write of nBuffSize bytes to the LSM6DSO, from
+  *         register Reg. The register address is sent by polling, the data by DMA
+  *         (channels BSP_SPI_TX_DMA_CH and BSP_SPI_RX_DMA_CH).
+  *         BSP_SPI_DMA_IRQHandler() must be called from the DMA interrupt handler.
+  * @param  Reg: first register.
+  * @param  pBuff: data to write. It must be valid until the end of the transfer.
+  * @param  nBuffSize: number of bytes.
+  * @param  Callback: called from the DMA interrupt at the end of the transfer
+  *         with its status (BSP_ERROR_NONE or BSP_ERROR_BUS_FAILURE). It can be NULL.
+  * @retval BSP_ERROR_NONE if the transfer has been started,
+  *         BSP_ERROR_BUSY if a transfer is ongoing, BSP_ERROR_WRONG_PARAM,
+  *         BSP_ERROR_TIMEOUT if the register address cannot be sent
+  */
+int32_t BSP_SPI_WriteAsync(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, void (*Callback)(int32_t status))
+{
+  NVIC_SetPriority(DMA_IRQn, IRQ_LOW_PRIORITY);
+  NVIC_EnableIRQ(DMA_IRQn);
+
+  return SPI_Start(Reg, pBuff, nBuffSize, 0, Callback);
+}
+
+
+/**
+  * @brief  Start a non-blocking read of nBuffSize bytes from the LSM6DSO, from
+  *         register Reg. The register address is sent by polling, the data by DMA
+  *         (channels BSP_SPI_TX_DMA_CH and BSP_SPI_RX_DMA_CH).
+  *         BSP_SPI_DMA_IRQHandler() must be called from the DMA interrupt handler.
+  * @param  Reg: first register.
+  * @param  pBuff: buffer for the data. It is filled until the end of the transfer.
+  * @param  nBuffSize: number of bytes.
+  * @param  Callback: called from the DMA interrupt at the end of the transfer
+  *         with its status (BSP_ERROR_NONE or BSP_ERROR_BUS_FAILURE). It can be NULL.
+  * @retval BSP_ERROR_NONE if the transfer has been started,
+  *         BSP_ERROR_BUSY if a transfer is ongoing, BSP_ERROR_WRONG_PARAM,
+  *         BSP_ERROR_TIMEOUT if the register address cannot be sent
+  */
+int32_t BSP_SPI_ReadAsync(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, void (*Callback)(int32_t status))
+{
+  NVIC_SetPriority(DMA_IRQn, IRQ_LOW_PRIORITY);
+  NVIC_EnableIRQ(DMA_IRQn);
+
+  return SPI_Start(Reg, pBuff, nBuffSize, 1, Callback);
+}
+
+
+/**
+  * @brief  Tell if an SPI transfer is ongoing.
+  * @param  None
+  * @retval 1 if a transfer is ongoing, 0 otherwise.
+  */
+uint8_t BSP_SPI_IsBusy(void)
+{
+  return (spiState != SPI_STATE_IDLE);
+}
+
+
+/**
+  * @brief  Abort the ongoing SPI transfer, if any. The callback is not called.
+  * @param  None
+  * @retval None
+  */
+void BSP_SPI_Abort(void)
+{
+  if(spiState != SPI_STATE_IDLE)
+    SPI_Stop();
+}
+
+
+/**
+  * @brief  This function handles the DMA channels of the transfers started with
+  *         BSP_SPI_WriteAsync() and BSP_SPI_ReadAsync().
+  *         To be called from the DMA interrupt handler of the application,
+  *         the flags of the other channels are not modified.
+  * @param  None
+  * @retval None
+  */
+void BSP_SPI_DMA_IRQHandler(void)
+{
+  int32_t status;
+  void (*callback)(int32_t status);
+  uint32_t loop = 0;
+
+  if(spiState == SPI_STATE_IDLE)
+    return;
+
+  if(SPI_DMA_IS_ACTIVE_FLAG(BSP_SPI_RX_DMA_CH, DMA_ISR_TEIF1) || SPI_DMA_IS_ACTIVE_FLAG(BSP_SPI_TX_DMA_CH, DMA_ISR_TEIF1)) {
+    status = BSP_ERROR_BUS_FAILURE;
+  }
+  else if(SPI_DMA_IS_ACTIVE_FLAG(BSP_SPI_RX_DMA_CH, DMA_ISR_TCIF1)) {
+    /* Last byte received: wait the end of the SPI clock before releasing CS */
+    while(LL_SPI_IsActiveFlag_BSY(BSP_SPI) && (loop++ < BSP_BUS_TIMEOUT));
+    status = BSP_ERROR_NONE;
+  }
+  else {
+    return;
+  }
+
+  callback = spiCallback;
+  SPI_Stop();
+  if(callback != NULL)
+    callback(status);
+}
+
+
+/**
+  * @}
+  */ 
+
+
+/** @defgroup BSP_BLUENRGLP_SPI_Private_Functions Private Functions
+  * @{
+  */ 
+
+/**
+  * @brief  Send the register address and start the DMA transfer of the data.
+  * @param  Reg: first register.
+  * @param  pBuff: data buffer.
+  * @param  nBuffSize: number of bytes.
+  * @param  read: 1 for a read, 0 for a write.
+  * @param  Callback: end of transfer callback, or NULL.
+  * @retval BSP_ERROR_NONE, BSP_ERROR_BUSY, BSP_ERROR_WRONG_PARAM or BSP_ERROR_TIMEOUT
+  */
+static int32_t SPI_Start(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, uint8_t read, void (*Callback)(int32_t status))
+{
+  uint8_t data;
+
+  if((pBuff == NULL) || (nBuffSize == 0))
+    return BSP_ERROR_WRONG_PARAM;
+
+  ATOMIC_SECTION_BEGIN();
+  if(spiState != SPI_STATE_IDLE) {
+    ATOMIC_SECTION_END();
+    return BSP_ERROR_BUSY;
+  }
+  spiState = SPI_STATE_BUSY;
+  ATOMIC_SECTION_END();
+
+  spiCallback = Callback;
+
+  /* Open the SPI communication by drive low the CS pin */
+  LL_GPIO_ResetOutputPin(BSP_SPI_CS_SENSOR1_GPIO_PORT, BSP_SPI_CS_SENSOR1_PIN);
+
+  /* Send the register address */
+  if(SPI_TransferByte(read ? (Reg | 0x80) : Reg, &data) != BSP_ERROR_NONE) {
+    SPI_Stop();
+    return BSP_ERROR_TIMEOUT;
+  }
+
+  /* The RX channel stores the data read or discards what is received while
+     writing, the TX channel sends the data to write or dummy bytes while reading */
+  spiDummy = 0xFF;
+  if(read) {
+    LL_DMA_ConfigAddresses(DMA1, BSP_SPI_RX_DMA_CH, LL_SPI_DMA_GetRegAddr(BSP_SPI), (uint32_t)pBuff, LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+    LL_DMA_SetMemoryIncMode(DMA1, BSP_SPI_RX_DMA_CH, LL_DMA_MEMORY_INCREMENT);
+    LL_DMA_ConfigAddresses(DMA1, BSP_SPI_TX_DMA_CH, (uint32_t)&spiDummy, LL_SPI_DMA_GetRegAddr(BSP_SPI), LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+    LL_DMA_SetMemoryIncMode(DMA1, BSP_SPI_TX_DMA_CH, LL_DMA_MEMORY_NOINCREMENT);
+  }
+  else {
+    LL_DMA_ConfigAddresses(DMA1, BSP_SPI_RX_DMA_CH, LL_SPI_DMA_GetRegAddr(BSP_SPI), (uint32_t)&spiDummy, LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+    LL_DMA_SetMemoryIncMode(DMA1, BSP_SPI_RX_DMA_CH, LL_DMA_MEMORY_NOINCREMENT);
+    LL_DMA_ConfigAddresses(DMA1, BSP_SPI_TX_DMA_CH, (uint32_t)pBuff, LL_SPI_DMA_GetRegAddr(BSP_SPI), LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+    LL_DMA_SetMemoryIncMode(DMA1, BSP_SPI_TX_DMA_CH, LL_DMA_MEMORY_INCREMENT);
+  }
+  LL_DMA_SetDataLength(DMA1, BSP_SPI_RX_DMA_CH, nBuffSize);
+  LL_DMA_SetDataLength(DMA1, BSP_SPI_TX_DMA_CH, nBuffSize);
+
+  SPI_DMA_CLEAR_FLAGS();
+  LL_DMA_EnableIT_TC(DMA1, BSP_SPI_RX_DMA_CH);
+  LL_DMA_EnableIT_TE(DMA1, BSP_SPI_RX_DMA_CH);
+  LL_DMA_EnableIT_TE(DMA1, BSP_SPI_TX_DMA_CH);
+
+  /* RX request first, so that no received byte is lost */
+  LL_SPI_EnableDMAReq_RX(BSP_SPI);
+  LL_DMA_EnableChannel(DMA1, BSP_SPI_RX_DMA_CH);
+  LL_DMA_EnableChannel(DMA1, BSP_SPI_TX_DMA_CH);
+  LL_SPI_EnableDMAReq_TX(BSP_SPI);
+
+  return BSP_ERROR_NONE;
+}
+
+
+/**
+  * @brief  End the transfer: stop the DMA channels and release CS.
+  * @param  None
+  * @retval None
+  */
+static void SPI_Stop(void)
+{
+  uint32_t loop = 0;
+
+  LL_SPI_DisableDMAReq_TX(BSP_SPI);
+  LL_DMA_DisableChannel(DMA1, BSP_SPI_TX_DMA_CH);
+  LL_DMA_DisableChannel(DMA1, BSP_SPI_RX_DMA_CH);
+  LL_SPI_DisableDMAReq_RX(BSP_SPI);
+
+  LL_DMA_DisableIT_TC(DMA1, BSP_SPI_RX_DMA_CH);
+  LL_DMA_DisableIT_TE(DMA1, BSP_SPI_RX_DMA_CH);
+  LL_DMA_DisableIT_TE(DMA1, BSP_SPI_TX_DMA_CH);
+  SPI_DMA_CLEAR_FLAGS();
+
+  /* On abort, let the bytes already in the TX FIFO go out and flush the RX FIFO */
+  while(LL_SPI_IsActiveFlag_BSY(BSP_SPI) && (loop++ < BSP_BUS_TIMEOUT));
+  while(LL_SPI_IsActiveFlag_RXNE(BSP_SPI) && (loop++ < BSP_BUS_TIMEOUT)) {
+    LL_SPI_ReceiveData8(BSP_SPI);
+  }
+
+  /* Close the SPI communication by drive high the CS pin */
+  LL_GPIO_SetOutputPin(BSP_SPI_CS_SENSOR1_GPIO_PORT, BSP_SPI_CS_SENSOR1_PIN);
+
+  spiCallback = NULL;
+  spiState = SPI_STATE_IDLE;
+}
+
+
+/**
+  * @brief  Send a byte and read the byte received, by polling the SPI FIFO.
+  * @param  TxData: byte to send.
+  * @param  pRxData: byte received.
+  * @retval BSP_ERROR_NONE, or BSP_ERROR_TIMEOUT after BSP_BUS_TIMEOUT loops
+  */
+static int32_t SPI_TransferByte(uint8_t TxData, uint8_t *pRxData)
+{
+  uint32_t loop = 0;
+
+  /* Wait for the TX flag */
+  while(LL_SPI_IsActiveFlag_TXE(BSP_SPI) == 0 && loop++ < BSP_BUS_TIMEOUT);
+
+  /* Send the data available */
+  LL_SPI_TransmitData8(BSP_SPI, TxData);
+
+  /* Wait for the RX flag */
+  while(LL_SPI_IsActiveFlag_RXNE(BSP_SPI) == 0 && loop++ < BSP_BUS_TIMEOUT);
+
+  if(loop >= BSP_BUS_TIMEOUT)
+    return BSP_ERROR_TIMEOUT;
+
+  /* Read the available data */
+  *pRxData = LL_SPI_ReceiveData8(BSP_SPI);
+
+  return BSP_ERROR_NONE;
+}
+
+
+/**
+  * @brief  Blocking transfer: the register address and the data go through the
+  *         SPI FIFO by polling.
+  * @param  Reg: first register.
+  * @param  pBuff: data buffer.
+  * @param  nBuffSize: number of bytes.
+  * @param  read: 1 for a read, 0 for a write.
+  * @retval BSP_ERROR_NONE, BSP_ERROR_BUSY or BSP_ERROR_TIMEOUT
+  */
+static int32_t SPI_Transfer(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, uint8_t read)
+{
+  uint32_t loop = 0;
+  uint8_t data;
+  int32_t ret;
+
+  ATOMIC_SECTION_BEGIN();
+  if(spiState != SPI_STATE_IDLE) {
+    ATOMIC_SECTION_END();
+    return BSP_ERROR_BUSY;
+  }
+  spiState = SPI_STATE_BUSY;
+  ATOMIC_SECTION_END();
+
+  /* Open the SPI communication by drive low the CS pin */
+  LL_GPIO_ResetOutputPin(BSP_SPI_CS_SENSOR1_GPIO_PORT, BSP_SPI_CS_SENSOR1_PIN);
+
+  /* Send the register address */
+  ret = SPI_TransferByte(read ? (Reg | 0x80) : Reg, &data);
+
+  for(uint16_t i = 0; (i < nBuffSize) && (ret == BSP_ERROR_NONE); i++) {
+    if(read)
+      ret = SPI_TransferByte(0xFF, &pBuff[i]);
+    else
+      ret = SPI_TransferByte(pBuff[i], &data);
+  }
+
+  /* Wait for the Busy flag */
+  while(LL_SPI_IsActiveFlag_BSY(BSP_SPI) == 1 && loop++ < BSP_BUS_TIMEOUT);
+
+  /* Flush the RX FIFO, not empty after a timeout */
+  while(LL_SPI_IsActiveFlag_RXNE(BSP_SPI) && loop++ < BSP_BUS_TIMEOUT) {
+    LL_SPI_ReceiveData8(BSP_SPI);
+  }
+
+  /* Close the SPI communication by drive high the CS pin */
+  LL_GPIO_SetOutputPin(BSP_SPI_CS_SENSOR1_GPIO_PORT, BSP_SPI_CS_SENSOR1_PIN);
+
+  spiState = SPI_STATE_IDLE;
+
+  return ret;
+}
+
+
 /**
   * @}
   */ 
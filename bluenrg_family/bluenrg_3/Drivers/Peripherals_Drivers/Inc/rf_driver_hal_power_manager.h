@@ -668,4 +668,141 @@ PowerSaveLevels App_PowerSaveLevel_Check(PowerSaveLevels level);
 void HAL_PWR_MNGR_DeepstopWdgState(FunctionalState state);
 
 
+/**
+  * @brief Power save level voter, registered with @ref HAL_PWR_MNGR_RegisterVoter.
+  *        The structure is owned by the module that registers it and must remain
+  *        valid until it is unregistered.
+  */
+typedef struct PowerSaveVoterS {
+  const char *Name;                                 /*!< Name of the voter, for debug */
+  uint8_t Priority;                                 /*!< Voters with higher priority are called first */
+  PowerSaveLevels (*Check)(PowerSaveLevels level);  /*!< Returns the deepest power save level allowed by the module.
+                                                         It is called with interrupts disabled. */
+  uint32_t VetoCount;                               /*!< Managed internally: number of times the voter has limited
+                                                         the level below the requested one */
+  struct PowerSaveVoterS *next;                     /*!< Managed internally */
+} PowerSaveVoter_TypeDef;
+
+/** 
+ * @brief This function adds a voter to the power save level negotiation.
+ *
+ * The voters are called by @ref HAL_PWR_MNGR_Request after the radio stack, application,
+ * HAL Virtual Timer and PKA checks, in order of priority. The negotiated level is the
+ * lowest level returned. Once a voter returns POWER_SAVE_LEVEL_RUNNING, the following
+ * voters are not called.
+ * 
+ * @param voter Voter to add, with the Name, Priority and Check fields set
+ * 
+ * @retval SUCCESS, or ERROR if the voter has no Check function or is already registered
+ */
+uint8_t HAL_PWR_MNGR_RegisterVoter(PowerSaveVoter_TypeDef *voter);
+
+/** 
+ * @brief This function removes a voter from the power save level negotiation.
+ * 
+ * @param voter Voter previously registered with @ref HAL_PWR_MNGR_RegisterVoter
+ * 
+ * @retval SUCCESS, or ERROR if the voter is not registered
+ */
+uint8_t HAL_PWR_MNGR_UnregisterVoter(PowerSaveVoter_TypeDef *voter);
+
+/** @brief Built-in voters of the power save level negotiation done by @ref HAL_PWR_MNGR_Request */
+typedef enum {
+  POWER_SAVE_VOTER_RADIO_STACK = 0,   /*!< RADIO_STACK_SleepCheck() */
+  POWER_SAVE_VOTER_APP         = 1,   /*!< App_PowerSaveLevel_Check() */
+  POWER_SAVE_VOTER_VTIMER      = 2,   /*!< HAL_VTIMER_PowerSaveLevelCheck() */
+  POWER_SAVE_VOTER_PKA         = 3,   /*!< PKAMGR_PowerSaveLevelCheck() */
+  POWER_SAVE_VOTER_NUM
+} PowerSaveVoters;
+
+/**
+  * @brief Power save telemetry, updated by @ref HAL_PWR_MNGR_Request.
+  *        Times are in system time units (see HAL_VTIMER_GetCurrentSysTime()).
+  */
+typedef struct {
+  uint32_t Requests;                          /*!< Number of calls to HAL_PWR_MNGR_Request() */
+  uint32_t LevelCount[4];                     /*!< Number of times each level (PowerSaveLevels) has been negotiated */
+  uint32_t Skipped;                           /*!< Number of times a STOP level has been negotiated but not entered
+                                                   (i.e. wakeup source already active) */
+  uint32_t StopNoTimerEntered;                /*!< Number of times POWER_SAVE_LEVEL_STOP_NOTIMER has been entered.
+                                                   The time spent in it is not measured. */
+  uint32_t VetoCount[POWER_SAVE_VOTER_NUM];   /*!< Number of times each built-in voter has limited the level below the
+                                                   requested one. More voters can limit the same request.
+                                                   See PowerSaveVoter_TypeDef for the registered voters. */
+  uint64_t LevelTime[4];                      /*!< Time spent in each level. The time in POWER_SAVE_LEVEL_RUNNING is the
+                                                   rest of the time since the telemetry reset. The time in
+                                                   POWER_SAVE_LEVEL_STOP_NOTIMER is not measured, since the timer
+                                                   clock is off. */
+  uint32_t WakeLatencyLast;                   /*!< Time from the CPU wakeup to the end of the context restore, */
+  uint32_t WakeLatencyMax;                    /*!< for POWER_SAVE_LEVEL_STOP_WITH_TIMER. */
+  uint32_t WakeupCount[32];                   /*!< Number of wakeups from STOP levels for each bit of the wakeup
+                                                   sources (see HAL_PWR_MNGR_WakeupSource()) */
+#if defined(CONFIG_DEVICE_SPIRIT3)
+  uint32_t InternalWakeupCount[32];           /*!< Same as WakeupCount for the internal wakeup sources */
+#endif
+} PowerSaveTelemetry_TypeDef;
+
+/** 
+ * @brief This function returns the power save telemetry: negotiated levels, voters that
+ *        limited the power save level, time spent in the power save levels, wakeup sources
+ *        and wake latency.
+ * 
+ * @param[out] telemetry Telemetry since the power up or the last call to @ref HAL_PWR_MNGR_ResetTelemetry
+ * 
+ * @retval None 
+ *
+ * @note The times are measured with HAL_VTIMER_GetCurrentSysTime(): the HAL Virtual Timer
+ *       must be initialized.
+ */
+void HAL_PWR_MNGR_GetTelemetry(PowerSaveTelemetry_TypeDef *telemetry);
+
+/** 
+ * @brief This function clears the power save telemetry.
+ * 
+ * @param None
+ * 
+ * @retval None 
+ */
+void HAL_PWR_MNGR_ResetTelemetry(void);
+
+/** @brief Value returned by @ref HAL_PWR_MNGR_EstimateCurrent when the estimate is not valid */
+#define POWER_SAVE_ESTIMATE_INVALID   0xFFFFFFFFU
+
+/**
+  * @brief Current model used to estimate the energy consumption from the telemetry.
+  *        The figures can be taken from the datasheet or measured on the board:
+  *        they should include the peripherals used by the application and, for
+  *        POWER_SAVE_LEVEL_RUNNING and POWER_SAVE_LEVEL_CPU_HALT, the average radio activity.
+  */
+typedef struct {
+  uint32_t Current[4];                        /*!< Current in nA in each level (PowerSaveLevels) */
+} PowerSaveCurrentModel_TypeDef;
+
+/** 
+ * @brief This function estimates the average current of the device since the last
+ *        telemetry reset, weighting the current of each level with the time spent in it.
+ * 
+ * @param model Current in each power save level
+ * 
+ * @retval Average current in nA, 0 if no time has been measured, POWER_SAVE_ESTIMATE_INVALID
+ *         if POWER_SAVE_LEVEL_STOP_NOTIMER has been entered since the last telemetry reset
+ *
+ * @note The time spent in POWER_SAVE_LEVEL_STOP_NOTIMER is not measured, since the timer
+ *       clock is off, and the system time does not advance: once that level is entered
+ *       the times of the telemetry no longer cover the whole period.
+ */
+uint32_t HAL_PWR_MNGR_EstimateCurrent(const PowerSaveCurrentModel_TypeDef *model);
+
+/** 
+ * @brief This function estimates the battery life from the average current returned by
+ *        @ref HAL_PWR_MNGR_EstimateCurrent.
+ * 
+ * @param model Current in each power save level
+ * @param capacity Battery capacity in mAh
+ * 
+ * @retval Battery life in hours, 0xFFFFFFFF if the average current is 0, 0 if the
+ *         estimate of the average current is not valid (POWER_SAVE_ESTIMATE_INVALID)
+ */
+uint32_t HAL_PWR_MNGR_EstimateBatteryLife(const PowerSaveCurrentModel_TypeDef *model, uint32_t capacity);
+
 #endif /* __HAL_POWER_MANAGER_H__ */
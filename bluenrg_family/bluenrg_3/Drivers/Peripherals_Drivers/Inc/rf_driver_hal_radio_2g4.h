@@ -53,4 +53,96 @@ uint8_t HAL_RADIO_SetNetworkID(uint32_t ID);
 
 uint8_t HAL_RADIO_CarrierSense(uint8_t channel, int8_t *rssi);
 
+/* Packet queue ------------------------------------------------------------- */
+
+/* Number of packets that can be queued. Each queued packet uses its own state
+   machine (from STATE_MACHINE_1), so it cannot be more than 7.
+   STATE_MACHINE_0 is left to the single packet APIs above. */
+#ifndef HAL_RADIO_QUEUE_SIZE
+#define HAL_RADIO_QUEUE_SIZE    4
+#endif
+
+typedef struct HAL_RADIO_Packet HAL_RADIO_Packet;
+
+struct HAL_RADIO_Packet
+{
+  uint8_t channel;              /* Frequency channel between 0 to 39. */
+  uint8_t tx;                   /* 1: the data are sent, 0: the data are received. */
+  uint8_t receive_length;       /* RX only: number of bytes that the link layer accepts in reception. */
+  uint32_t wakeup_time;         /* Time in us of the packet:
+                                 * - if the radio is idle, relative to now (minimum 230 us);
+                                 * - otherwise relative to the end of the previous packet.
+                                 *   0 means the back-to-back time (default 150 us). */
+  uint32_t receive_timeout;     /* RX only: time of RX window used to wait for the packet in us. */
+  uint8_t *data;                /* TX or RX buffer. Second byte of this buffer is the length of the data. */
+  void (*Callback)(HAL_RADIO_Packet *packet);   /* Called from the radio ISR when the packet has been
+                                                 * sent or received (or on RX timeout). It can be NULL. */
+  /* Filled when the packet has been completed */
+  uint32_t status;              /* ActionPacket status: BLUE_INTERRUPT1REG_RCVOK, ...RCVTIMEOUT, ...RCVCRCERR */
+  uint32_t timestamp_receive;   /* RX only */
+  int32_t rssi;                 /* RX only */
+};
+
+uint8_t HAL_RADIO_QueuePacket(HAL_RADIO_Packet *packet);
+
+uint8_t HAL_RADIO_QueuePending(void);
+
+uint8_t HAL_RADIO_QueueAbort(void);
+
+/* Frequency hopping with listen before talk -------------------------------- */
+
+/* Maximum length of the hop sequence */
+#ifndef HAL_RADIO_HOP_MAX_SEQUENCE
+#define HAL_RADIO_HOP_MAX_SEQUENCE    40
+#endif
+
+/* Result of a packet sent with HAL_RADIO_HopSend() */
+#define HAL_RADIO_HOP_SENT            0x00  /* Sent, no acknowledge requested */
+#define HAL_RADIO_HOP_ACKED           0x01  /* Sent and acknowledged */
+#define HAL_RADIO_HOP_NO_ACK          0x02  /* Sent, acknowledge not received */
+#define HAL_RADIO_HOP_CHANNEL_BUSY    0x03  /* Not sent: channel busy for max_attempts slots */
+
+typedef struct
+{
+  uint8_t sequence[HAL_RADIO_HOP_MAX_SEQUENCE]; /* Channels (0 to 39) used in turn, one per slot */
+  uint8_t sequence_length;      /* Number of channels in sequence. */
+  int8_t busy_threshold;        /* A channel is busy if its RSSI (dBm) is greater or equal (127, not available, is not busy). */
+  uint8_t max_attempts;         /* Number of slots (channels) tried before dropping a packet. */
+  uint32_t backoff_min;         /* Random delay in us before the next slot when the channel is busy: */
+  uint32_t backoff_max;         /* between backoff_min and backoff_max. */
+  uint32_t receive_timeout;     /* RX window in us for the acknowledge. */
+} HAL_RADIO_HopConfig;
+
+typedef struct
+{
+  uint16_t cca_count;           /* Carrier sense done on the channel */
+  uint16_t busy_count;          /* Channel found busy */
+  uint16_t tx_count;            /* Packets sent on the channel */
+  uint16_t ack_count;           /* Acknowledges received on the channel */
+} HAL_RADIO_HopChannelStats;
+
+typedef struct
+{
+  uint32_t packets;             /* Packets completed */
+  uint32_t acked;               /* Packets acknowledged (or sent if no acknowledge is requested) */
+  uint32_t dropped;             /* Packets not sent because of busy channels */
+  uint32_t latency_total;       /* Sum of the latencies (us) of the sent packets, from HAL_RADIO_HopSend() */
+  uint32_t latency_max;         /* Maximum latency (us) */
+} HAL_RADIO_HopStats;
+
+uint8_t HAL_RADIO_HopInit(const HAL_RADIO_HopConfig *config);
+
+uint8_t HAL_RADIO_HopSend(uint8_t *txBuffer, 
+                          uint8_t *rxBuffer, 
+                          uint8_t receive_length, 
+                          void (*Callback)(uint8_t result));
+
+uint8_t HAL_RADIO_HopPending(void);
+
+void HAL_RADIO_HopTick(void);
+
+void HAL_RADIO_HopGetStats(HAL_RADIO_HopStats *stats, HAL_RADIO_HopChannelStats *channel_stats);
+
+void HAL_RADIO_HopResetStats(void);
+
 #endif /* RF_DRIVER_HAL_RADIO_H */
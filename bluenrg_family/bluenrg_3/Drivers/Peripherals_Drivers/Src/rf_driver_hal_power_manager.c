@@ -24,11 +24,17 @@
 #include "rf_driver_ll_rcc.h"
 #include "rf_driver_ll_system.h"
 #include "rf_driver_hal_power_manager.h"
+#if defined(CONFIG_DEVICE_SPIRIT3)
+#include "rf_driver_hal_vtimer_subghz.h"
+#else
+#include "rf_driver_hal_vtimer.h"
+#endif
 #include "osal.h"
 #include "rf_driver_ll_lpuart.h"
 
 /**** Private function prototype ***********************************************/
 static uint8_t PowerSave_Setup(PowerSaveLevels ps_level, WakeupSourceConfig_TypeDef wsConfig);
+static void PowerSave_Telemetry(PowerSaveLevels ps_level, uint64_t sleepTime);
 static void SystemDeepSleepCmd(uint8_t NewState);
 #if defined(AHBUPCONV)
 static void AHBUPCONV_ConfigRestore(void);
@@ -199,6 +205,11 @@ WEAK_FUNCTION(uint8_t PKAMGR_PowerSaveLevelCheck(uint8_t level))
   return POWER_SAVE_LEVEL_STOP_NOTIMER;
 }
 
+WEAK_FUNCTION(uint8_t RNGMGR_PowerSaveLevelCheck(uint8_t level))
+{
+  return POWER_SAVE_LEVEL_STOP_NOTIMER;
+}
+
 WEAK_FUNCTION(PowerSaveLevels RADIO_STACK_SleepCheck(void))
 {
   return POWER_SAVE_LEVEL_STOP_NOTIMER;
@@ -221,6 +232,15 @@ static volatile uint32_t IOwakeupSources_VR;
 static volatile uint32_t InternalWakeupSources_VR;
 static volatile uint8_t deepstop_wdg_state=ENABLE;
 
+/* Registered voters, sorted by decreasing priority */
+static PowerSaveVoter_TypeDef *PowerSaveVoters_List = NULL;
+
+static PowerSaveTelemetry_TypeDef PowerSaveTelemetry;
+/* System time at the CPU wakeup from POWER_SAVE_LEVEL_STOP_WITH_TIMER */
+static uint64_t WakeupTime;
+/* System time at the telemetry reset */
+static uint64_t TelemetryStartTime;
+
 /**** Private function definition **********************************************/
 static uint8_t IO_IRQ_Enabled(uint32_t wkSource, uint8_t *IRQA_enabled, uint8_t *IRQB_enabled)
 {
@@ -669,6 +689,11 @@ static uint8_t PowerSave_Setup(PowerSaveLevels ps_level, WakeupSourceConfig_Type
      context restore. Now induce a context save. */
   void CS_contextSave(void);
   CS_contextSave();
+  
+  /* The timer clock is running only in POWER_SAVE_LEVEL_STOP_WITH_TIMER */
+  if (RAM_VR.WakeupFromSleepFlag && (ps_level == POWER_SAVE_LEVEL_STOP_WITH_TIMER)) {
+    WakeupTime = HAL_VTIMER_GetCurrentSysTime();
+  }
     
   /* Disable deep sleep, because if no reset occours for an interrrupt pending,
      the register value remain set and if a simple CPU_HALT command is called from the
@@ -1048,12 +1073,46 @@ static uint8_t PowerSave_Setup(PowerSaveLevels ps_level, WakeupSourceConfig_Type
   return ret_val;
 }
 
+static void PowerSave_Telemetry(PowerSaveLevels ps_level, uint64_t sleepTime)
+{
+  uint32_t latency;
+  uint8_t i;
+  
+  if (RAM_VR.WakeupFromSleepFlag == 0) {
+    PowerSaveTelemetry.Skipped++;
+    return;
+  }
+  
+  if (ps_level == POWER_SAVE_LEVEL_STOP_NOTIMER)
+    PowerSaveTelemetry.StopNoTimerEntered++;
+  
+  if (ps_level == POWER_SAVE_LEVEL_STOP_WITH_TIMER) {
+    PowerSaveTelemetry.LevelTime[ps_level] += WakeupTime - sleepTime;
+    latency = (uint32_t)(HAL_VTIMER_GetCurrentSysTime() - WakeupTime);
+    PowerSaveTelemetry.WakeLatencyLast = latency;
+    if (latency > PowerSaveTelemetry.WakeLatencyMax)
+      PowerSaveTelemetry.WakeLatencyMax = latency;
+  }
+  
+  for (i=0; i<32; i++) {
+    if (IOwakeupSources_VR & (1UL << i))
+      PowerSaveTelemetry.WakeupCount[i]++;
+#if defined(CONFIG_DEVICE_SPIRIT3)
+    if (InternalWakeupSources_VR & (1UL << i))
+      PowerSaveTelemetry.InternalWakeupCount[i]++;
+#endif
+  }
+}
+
 /**** Public function definition **********************************************/
 
 uint8_t HAL_PWR_MNGR_Request(PowerSaveLevels level, WakeupSourceConfig_TypeDef wsConfig, PowerSaveLevels *negotiatedLevel)
 {
   PowerSaveLevels app_powerSave_level, vtimer_powerSave_level, final_level, pka_level;
   uint8_t ret_val=SUCCESS;
+  uint64_t sleepTime;
+  PowerSaveVoter_TypeDef *voter;
+  PowerSaveLevels voter_level;
   uint8_t IRQA_enabled, IRQB_enabled;
   
   /* Mask all the interrupt */
@@ -1061,10 +1120,22 @@ uint8_t HAL_PWR_MNGR_Request(PowerSaveLevels level, WakeupSourceConfig_TypeDef w
   
   /* Flag to signal if a wakeup from standby or sleep occurred */
   RAM_VR.WakeupFromSleepFlag = 0; 
+  
+  PowerSaveTelemetry.Requests++;
+  
+  /* Idle time: refill the RNG entropy pool, the RNG never vetoes the power save */
+  RNGMGR_PowerSaveLevelCheck(level);
 
   /* BLE Stack allows to enable the power save */
-  if (RADIO_STACK_SleepCheck() != POWER_SAVE_LEVEL_RUNNING &&
-      (app_powerSave_level = App_PowerSaveLevel_Check(level)) != POWER_SAVE_LEVEL_RUNNING) {
+  if (RADIO_STACK_SleepCheck() == POWER_SAVE_LEVEL_RUNNING) {
+    if (level != POWER_SAVE_LEVEL_RUNNING)
+      PowerSaveTelemetry.VetoCount[POWER_SAVE_VOTER_RADIO_STACK]++;
+    PowerSaveTelemetry.LevelCount[POWER_SAVE_LEVEL_RUNNING]++;
+  } else if ((app_powerSave_level = App_PowerSaveLevel_Check(level)) == POWER_SAVE_LEVEL_RUNNING) {
+    if (level != POWER_SAVE_LEVEL_RUNNING)
+      PowerSaveTelemetry.VetoCount[POWER_SAVE_VOTER_APP]++;
+    PowerSaveTelemetry.LevelCount[POWER_SAVE_LEVEL_RUNNING]++;
+  } else {
         
     vtimer_powerSave_level = HAL_VTIMER_PowerSaveLevelCheck(level);
     pka_level = (PowerSaveLevels) PKAMGR_PowerSaveLevelCheck(level);
@@ -1072,6 +1143,22 @@ uint8_t HAL_PWR_MNGR_Request(PowerSaveLevels level, WakeupSourceConfig_TypeDef w
     final_level = (PowerSaveLevels)MIN(vtimer_powerSave_level, final_level);
     final_level = (PowerSaveLevels)MIN(pka_level, final_level);
     
+    if (app_powerSave_level < level)
+      PowerSaveTelemetry.VetoCount[POWER_SAVE_VOTER_APP]++;
+    if (vtimer_powerSave_level < level)
+      PowerSaveTelemetry.VetoCount[POWER_SAVE_VOTER_VTIMER]++;
+    if (pka_level < level)
+      PowerSaveTelemetry.VetoCount[POWER_SAVE_VOTER_PKA]++;
+    
+    /* Registered voters, in order of priority */
+    for (voter = PowerSaveVoters_List; voter != NULL && final_level != POWER_SAVE_LEVEL_RUNNING; voter = voter->next) {
+      voter_level = voter->Check(level);
+      if (voter_level < level)
+        voter->VetoCount++;
+      final_level = (PowerSaveLevels)MIN(voter_level, final_level);
+    }
+    PowerSaveTelemetry.LevelCount[final_level]++;
+    
 #if DEBUG_POWER_SAVE_LEVEL
     PowerSaveLevel_selected[final_level]++;
 #endif
@@ -1093,8 +1180,10 @@ uint8_t HAL_PWR_MNGR_Request(PowerSaveLevels level, WakeupSourceConfig_TypeDef w
     }
   
     if (final_level == POWER_SAVE_LEVEL_CPU_HALT) {
+      sleepTime = HAL_VTIMER_GetCurrentSysTime();
       /* Wait for interrupt is called: the core execution is halted until an interrupt occurs. */
       __WFI();
+      PowerSaveTelemetry.LevelTime[POWER_SAVE_LEVEL_CPU_HALT] += HAL_VTIMER_GetCurrentSysTime() - sleepTime;
       *negotiatedLevel = POWER_SAVE_LEVEL_CPU_HALT;
       ATOMIC_SECTION_END();
       return ret_val;
@@ -1178,6 +1267,7 @@ uint8_t HAL_PWR_MNGR_Request(PowerSaveLevels level, WakeupSourceConfig_TypeDef w
 #endif
     
     /* Save all the peripherals register configuration and enable the power save level */
+    sleepTime = HAL_VTIMER_GetCurrentSysTime();
     ret_val = PowerSave_Setup(final_level, wsConfig);
     
     /* Wakeup Sources Virtual Register */
@@ -1205,6 +1295,8 @@ uint8_t HAL_PWR_MNGR_Request(PowerSaveLevels level, WakeupSourceConfig_TypeDef w
       LL_LPUART_DisableInStopMode(LPUART1);
 #endif
     }    
+    
+    PowerSave_Telemetry(final_level, sleepTime);
   }
   
   ATOMIC_SECTION_END();
@@ -1351,3 +1443,120 @@ void HAL_PWR_MNGR_DeepstopWdgState(FunctionalState state)
     deepstop_wdg_state = ENABLE;
   }
 }
+
+uint8_t HAL_PWR_MNGR_RegisterVoter(PowerSaveVoter_TypeDef *voter)
+{
+  PowerSaveVoter_TypeDef **prev;
+  
+  if (voter == NULL || voter->Check == NULL)
+    return ERROR;
+  
+  ATOMIC_SECTION_BEGIN();
+  for (prev = &PowerSaveVoters_List; *prev != NULL; prev = &(*prev)->next) {
+    if (*prev == voter) {
+      ATOMIC_SECTION_END();
+      return ERROR;
+    }
+  }
+  /* Insert after the voters with the same or higher priority */
+  for (prev = &PowerSaveVoters_List; *prev != NULL && (*prev)->Priority >= voter->Priority; prev = &(*prev)->next);
+  voter->VetoCount = 0;
+  voter->next = *prev;
+  *prev = voter;
+  ATOMIC_SECTION_END();
+  
+  return SUCCESS;
+}
+
+uint8_t HAL_PWR_MNGR_UnregisterVoter(PowerSaveVoter_TypeDef *voter)
+{
+  PowerSaveVoter_TypeDef **prev;
+  uint8_t ret_val = ERROR;
+  
+  ATOMIC_SECTION_BEGIN();
+  for (prev = &PowerSaveVoters_List; *prev != NULL; prev = &(*prev)->next) {
+    if (*prev == voter) {
+      *prev = voter->next;
+      voter->next = NULL;
+      ret_val = SUCCESS;
+      break;
+    }
+  }
+  ATOMIC_SECTION_END();
+  
+  return ret_val;
+}
+
+void HAL_PWR_MNGR_GetTelemetry(PowerSaveTelemetry_TypeDef *telemetry)
+{
+  uint64_t sleep_time;
+  uint64_t total_time;
+  
+  ATOMIC_SECTION_BEGIN();
+  *telemetry = PowerSaveTelemetry;
+  total_time = HAL_VTIMER_GetCurrentSysTime() - TelemetryStartTime;
+  ATOMIC_SECTION_END();
+  
+  sleep_time = telemetry->LevelTime[POWER_SAVE_LEVEL_CPU_HALT] + telemetry->LevelTime[POWER_SAVE_LEVEL_STOP_WITH_TIMER];
+  if (total_time > sleep_time)
+    telemetry->LevelTime[POWER_SAVE_LEVEL_RUNNING] = total_time - sleep_time;
+}
+
+void HAL_PWR_MNGR_ResetTelemetry(void)
+{
+  ATOMIC_SECTION_BEGIN();
+  memset(&PowerSaveTelemetry, 0, sizeof(PowerSaveTelemetry));
+  TelemetryStartTime = HAL_VTIMER_GetCurrentSysTime();
+  ATOMIC_SECTION_END();
+}
+
+uint32_t HAL_PWR_MNGR_EstimateCurrent(const PowerSaveCurrentModel_TypeDef *model)
+{
+  PowerSaveTelemetry_TypeDef telemetry;
+  uint64_t time[4], total_time, charge;
+  uint8_t i;
+  
+  HAL_PWR_MNGR_GetTelemetry(&telemetry);
+  
+  /* The time spent in STOP_NOTIMER is unknown */
+  if (telemetry.StopNoTimerEntered != 0)
+    return POWER_SAVE_ESTIMATE_INVALID;
+  
+  for (i=0; i<4; i++)
+    time[i] = telemetry.LevelTime[i];
+  
+  /* Reduce the resolution of the times to avoid overflows: current (< 2^32 nA) x time (< 2^30) x 4 levels */
+  do {
+    total_time = time[0] + time[1] + time[2] + time[3];
+    if (total_time < (1UL << 30))
+      break;
+    for (i=0; i<4; i++)
+      time[i] >>= 1;
+  } while (1);
+  
+  if (total_time == 0)
+    return 0;
+  
+  charge = 0;
+  for (i=0; i<4; i++)
+    charge += (uint64_t)model->Current[i] * time[i];
+  
+  return (uint32_t)(charge / total_time);
+}
+
+uint32_t HAL_PWR_MNGR_EstimateBatteryLife(const PowerSaveCurrentModel_TypeDef *model, uint32_t capacity)
+{
+  uint32_t current = HAL_PWR_MNGR_EstimateCurrent(model);
+  uint64_t hours;
+  
+  if (current == POWER_SAVE_ESTIMATE_INVALID)
+    return 0;
+  
+  if (current == 0)
+    return 0xFFFFFFFF;
+  
+  /* mAh -> nAh */
+  hours = ((uint64_t)capacity * 1000000) / current;
+  
+  return (hours > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)hours;
+}
@@ -24,9 +24,34 @@
 
 #define TIME_DIFF(a, b)       ((int32_t)(a - b))
 
+/* Minimum time in us to program the first packet of a chain */
+#define MIN_WAKEUP_TIME       230
+
+#define ATOMIC_SECTION_BEGIN() uint32_t uwPRIMASK_Bit = __get_PRIMASK(); \
+__disable_irq(); \
+  /* Must be called in the same or in a lower scope of ATOMIC_SECTION_BEGIN */
+#define ATOMIC_SECTION_END() __set_PRIMASK(uwPRIMASK_Bit)
+
+#if (HAL_RADIO_QUEUE_SIZE < 1) || (HAL_RADIO_QUEUE_SIZE > 7)
+#error "HAL_RADIO_QUEUE_SIZE must be between 1 and 7"
+#endif
+
 static ActionPacket aPacket[2]; 
 static uint32_t networkID = 0x88DF88DF;
 
+/* Packet queue: the packet in slot i uses state machine i+1. The packets are
+   executed and completed in the order they have been queued. */
+static ActionPacket queuePacket[HAL_RADIO_QUEUE_SIZE];
+static HAL_RADIO_Packet *queueDesc[HAL_RADIO_QUEUE_SIZE];
+static uint8_t queueHead;
+static volatile uint8_t queueCount;
+/* A chain of queued packets is being executed by the radio */
+static volatile uint8_t queueActive;
+/* Configuration of the state machines, to write it only when it changes */
+static uint8_t queueConfigured;
+static uint8_t queueChannel[HAL_RADIO_QUEUE_SIZE];
+static uint32_t queueNetworkID[HAL_RADIO_QUEUE_SIZE];
+
 static uint8_t CondRoutineTrue(ActionPacket* p)
 {
   return TRUE;
@@ -442,4 +467,477 @@ uint8_t HAL_RADIO_ReceivePacketWithAck(uint8_t channel,
   
   return returnValue; 
 }
+
+static uint8_t QueueCondRoutine(ActionPacket* p)
+{
+  ActionPacket* next = p->next_true;
+  
+  /* The receive timeout is global: set it for the next packet before it starts */
+  if(next != NULL_0 && (next->ActionTag & TXRX) == 0) {
+    RADIO_SetGlobalReceiveTimeout(queueDesc[next->StateMachineNo - 1]->receive_timeout);
+  }
+  return TRUE;
+}
+
+static uint8_t QueueDataRoutine(ActionPacket* p, ActionPacket* next)
+{
+  HAL_RADIO_Packet *packet = queueDesc[queueHead];
+  
+  /* Completion of a packet stopped by HAL_RADIO_QueueAbort() */
+  if(queueCount == 0 || p != &queuePacket[queueHead]) {
+    return TRUE;
+  }
+  
+  packet->status = p->status;
+  packet->timestamp_receive = p->timestamp_receive;
+  packet->rssi = p->rssi;
+  
+  queueHead = (queueHead + 1) % HAL_RADIO_QUEUE_SIZE;
+  queueCount--;
+  if(next == NULL_0) {
+    queueActive = FALSE;
+  }
+  
+  if(packet->Callback != NULL_0) {
+    packet->Callback(packet);
+  }
+  return TRUE;
+}
+
+/* RADIO_SetReservedArea() takes the mode of the next action from next_true:
+   the tail of the queue has no next packet yet */
+static void QueueSetReservedArea(ActionPacket* p)
+{
+  p->next_true = p;
+  RADIO_SetReservedArea(p);
+  p->next_true = NULL_0;
+  p->trans_packet.BYTE5 &= ~TXRXPACK_BYTE5_NEXTTXMODE_Msk;
+}
+
+/* Mode of the next action, once a packet has been linked after p */
+static void QueueSetNextMode(ActionPacket* p)
+{
+  if((p->next_true->ActionTag & TXRX) != 0) {
+    p->trans_packet.BYTE5 |= TXRXPACK_BYTE5_NEXTTXMODE_Msk;
+  }
+  else {
+    p->trans_packet.BYTE5 &= ~TXRXPACK_BYTE5_NEXTTXMODE_Msk;
+  }
+}
+
+/**
+* @brief  This routine queues a packet to be sent or received after the packets
+*         already queued, without waiting for them to be completed.
+*         The packets are chained in the radio ISR (next_true/next_false of the
+*         ActionPackets), so a packet following another one without a gap
+*         (wakeup_time = 0) must be queued before the end of the previous one.
+*         Each packet has its own channel, timing and RX window. The channel
+*         and the network ID are only written to the radio when they change.
+* @param  packet: Packet descriptor. It must be kept valid until its callback
+*         has been called: it is updated with the packet status.
+* @retval uint8_t return value
+*           - 0x00 : Success.
+*           - 0xC0 : Invalid parameter.
+*           - 0xC4 : Radio is busy (queue full or radio used by another API).
+*/
+uint8_t HAL_RADIO_QueuePacket(HAL_RADIO_Packet *packet)
+{
+  uint8_t returnValue = SUCCESS_0;
+  uint8_t slot, prev;
+  uint32_t dummy;
+  ActionPacket *ap;
+  
+  if(packet == NULL_0 || packet->channel > 39) {
+    return INVALID_PARAMETER_C0;
+  }
+  
+  ATOMIC_SECTION_BEGIN();
+  
+  if(queueCount == HAL_RADIO_QUEUE_SIZE) {
+    returnValue = RADIO_BUSY_C4;
+  }
+  else if(!queueActive && RADIO_GetStatus(&dummy) != BLUE_IDLE_0) {
+    returnValue = RADIO_BUSY_C4;
+  }
+  
+  if(returnValue == SUCCESS_0) {
+    slot = (queueHead + queueCount) % HAL_RADIO_QUEUE_SIZE;
+    ap = &queuePacket[slot];
+    
+    /* The state machine of the slot is not used by the radio */
+    if((queueConfigured & (1 << slot)) == 0) {
+      uint8_t map[5]= {0xFF,0xFF,0xFF,0xFF,0xFF};
+      RADIO_SetChannelMap(slot + 1, &map[0]);
+      queueChannel[slot] = 0xFF;
+      queueNetworkID[slot] = ~networkID;
+      queueConfigured |= (1 << slot);
+    }
+    if(queueChannel[slot] != packet->channel) {
+      RADIO_SetChannel(slot + 1, packet->channel, 0);
+      queueChannel[slot] = packet->channel;
+    }
+    if(queueNetworkID[slot] != networkID) {
+      RADIO_SetTxAttributes(slot + 1, networkID, 0x555555);
+      queueNetworkID[slot] = networkID;
+    }
+    
+    ap->StateMachineNo = slot + 1;
+    ap->ActionTag = packet->tx ? TXRX : 0;
+    ap->MaxReceiveLength = packet->tx ? 0 : packet->receive_length;
+    ap->data = packet->data;
+    ap->next_true = NULL_0;
+    ap->next_false = NULL_0;
+    ap->condRoutine = QueueCondRoutine;
+    ap->dataRoutine = QueueDataRoutine;
+    
+    if(queueActive) {
+      /* Executed after the last queued packet: at the back-to-back time or at
+         wakeup_time after its end */
+      if(packet->wakeup_time != 0) {
+        ap->ActionTag |= PLL_TRIG | TIMER_WAKEUP | RELATIVE;
+      }
+      ap->WakeupTime = packet->wakeup_time;
+      QueueSetReservedArea(ap);
+      queueDesc[slot] = packet;
+      queueCount++;
+      
+      prev = (slot + HAL_RADIO_QUEUE_SIZE - 1) % HAL_RADIO_QUEUE_SIZE;
+      queuePacket[prev].next_true = ap;
+      queuePacket[prev].next_false = ap;
+      /* Only the next mode of the reserved area depends on the link: the rest
+         is not rewritten, the radio may be executing the previous packet */
+      QueueSetNextMode(&queuePacket[prev]);
+    }
+    else {
+      /* Start of a new chain */
+      ap->ActionTag |= PLL_TRIG | TIMER_WAKEUP | RELATIVE;
+      ap->WakeupTime = (packet->wakeup_time < MIN_WAKEUP_TIME) ? MIN_WAKEUP_TIME : packet->wakeup_time;
+      QueueSetReservedArea(ap);
+      queueDesc[slot] = packet;
+      
+      if(!packet->tx) {
+        RADIO_SetGlobalReceiveTimeout(packet->receive_timeout);
+      }
+      returnValue = RADIO_MakeActionPacketPending(ap);
+      if(returnValue == SUCCESS_0) {
+        queueCount++;
+        queueActive = TRUE;
+      }
+    }
+  }
+  
+  ATOMIC_SECTION_END();
+  
+  return returnValue;
+}
+
+/**
+* @brief  This routine returns the number of queued packets not yet completed.
+*/
+uint8_t HAL_RADIO_QueuePending(void)
+{
+  return queueCount;
+}
+
+/**
+* @brief  This routine stops the queued packets. Their callbacks are not called,
+*         also if the radio completes the running packet after the stop.
+* @retval Value returned by RADIO_StopActivity(), 0 if the queue is empty.
+*/
+uint8_t HAL_RADIO_QueueAbort(void)
+{
+  uint8_t returnValue = 0;
+  
+  ATOMIC_SECTION_BEGIN();
+  if(queueActive) {
+    returnValue = RADIO_StopActivity();
+    queueActive = FALSE;
+  }
+  queueHead = 0;
+  queueCount = 0;
+  ATOMIC_SECTION_END();
+  
+  return returnValue;
+}
+
+/* Frequency hopping with listen before talk ------------------------------- */
+
+#define HOP_IDLE      0
+#define HOP_WAIT      1   /* Waiting for the next slot */
+#define HOP_RUNNING   2   /* Packet programmed on the radio */
+#define HOP_DONE      3   /* Packet completed, result not yet reported */
+
+/* RSSI reported when the receiver gives no reading */
+#define HOP_RSSI_NOT_AVAILABLE  127
+/* Carrier sense done on a slot when the RSSI is not available */
+#define HOP_RSSI_SAMPLES        2
+
+/* System time units (625/256 us) to us */
+#define STU_TO_US(t)  ((uint32_t)(((uint64_t)(t) * 625) >> 8))
+
+static HAL_RADIO_HopConfig hopConfig;
+static HAL_RADIO_HopStats hopStats;
+static HAL_RADIO_HopChannelStats hopChannelStats[40];
+static volatile uint8_t hopState = HOP_IDLE;
+static uint8_t hopIndex;
+static uint8_t hopAttempts;
+static uint8_t hopChannel;
+static volatile uint8_t hopResult;
+static uint8_t *hopTxBuffer;
+static uint8_t *hopRxBuffer;
+static uint8_t hopReceiveLength;
+static void (*hopCallback)(uint8_t result);
+static uint64_t hopStartTime;
+static volatile uint64_t hopEndTime;
+static uint64_t hopSlotTime;
+static uint32_t hopRandom = 1;
+
+static uint32_t HopBackoff(void)
+{
+  uint32_t range = hopConfig.backoff_max - hopConfig.backoff_min;
+  
+  /* xorshift32 */
+  hopRandom ^= hopRandom << 13;
+  hopRandom ^= hopRandom >> 17;
+  hopRandom ^= hopRandom << 5;
+  
+  if(range == 0) {
+    return hopConfig.backoff_min;
+  }
+  return hopConfig.backoff_min + hopRandom % (range + 1);
+}
+
+static uint8_t HopTxCallback(ActionPacket* p, ActionPacket* next)
+{
+  hopEndTime = TIMER_GetCurrentSysTime();
+  hopResult = HAL_RADIO_HOP_SENT;
+  hopState = HOP_DONE;
+  return TRUE;
+}
+
+static uint8_t HopAckCallback(ActionPacket* p, ActionPacket* next)
+{
+  hopEndTime = TIMER_GetCurrentSysTime();
+  hopResult = (p->status & BLUE_INTERRUPT1REG_RCVOK) ? HAL_RADIO_HOP_ACKED : HAL_RADIO_HOP_NO_ACK;
+  hopState = HOP_DONE;
+  return TRUE;
+}
+
+static void HopComplete(uint8_t result)
+{
+  uint32_t latency;
+  
+  hopStats.packets++;
+  if(result == HAL_RADIO_HOP_CHANNEL_BUSY) {
+    hopStats.dropped++;
+  }
+  else {
+    hopChannelStats[hopChannel].tx_count++;
+    if(result != HAL_RADIO_HOP_NO_ACK) {
+      hopStats.acked++;
+    }
+    if(result == HAL_RADIO_HOP_ACKED) {
+      hopChannelStats[hopChannel].ack_count++;
+    }
+    latency = STU_TO_US(hopEndTime - hopStartTime);
+    hopStats.latency_total += latency;
+    if(latency > hopStats.latency_max) {
+      hopStats.latency_max = latency;
+    }
+  }
+  
+  /* The next packet starts on the next channel of the sequence */
+  hopIndex = (hopIndex + 1) % hopConfig.sequence_length;
+  hopState = HOP_IDLE;
+  
+  if(hopCallback != NULL_0) {
+    hopCallback(result);
+  }
+}
+
+/**
+* @brief  This routine configures the hop sequence and the listen before talk
+*         parameters used by HAL_RADIO_HopSend(), and resets the statistics.
+* @param  config: Configuration (copied).
+* @retval uint8_t return value
+*           - 0x00 : Success.
+*           - 0xC0 : Invalid parameter.
+*           - 0xC4 : A packet is pending.
+*/
+uint8_t HAL_RADIO_HopInit(const HAL_RADIO_HopConfig *config)
+{
+  uint8_t i;
+  
+  if(hopState != HOP_IDLE) {
+    return RADIO_BUSY_C4;
+  }
+  if(config == NULL_0 || config->sequence_length == 0 || config->sequence_length > HAL_RADIO_HOP_MAX_SEQUENCE ||
+     config->max_attempts == 0 || config->backoff_max < config->backoff_min) {
+    return INVALID_PARAMETER_C0;
+  }
+  for(i = 0; i < config->sequence_length; i++) {
+    if(config->sequence[i] > 39) {
+      return INVALID_PARAMETER_C0;
+    }
+  }
+  
+  hopConfig = *config;
+  hopIndex = 0;
+  /* Different devices should not back off in the same way */
+  hopRandom = (uint32_t)TIMER_GetCurrentSysTime() | 1;
+  HAL_RADIO_HopResetStats();
+  
+  return SUCCESS_0;
+}
+
+/**
+* @brief  This routine sends a packet on the next channel of the hop sequence.
+*         The packet is sent by HAL_RADIO_HopTick(): the channel is sensed
+*         with HAL_RADIO_CarrierSense() and, if it is busy, the next channel
+*         of the sequence is tried after a random backoff, up to max_attempts
+*         channels.
+* @note   The radio must not be used by other APIs until the callback has
+*         been called.
+* @param  txBuffer: Pointer to TX data buffer. Second byte of this buffer must be the length of the data.
+* @param  rxBuffer: Pointer to RX data buffer for the acknowledge. NULL if no acknowledge is expected.
+* @param  receive_length: number of bytes that the link layer accepts in reception.
+* @param  Callback: Called by HAL_RADIO_HopTick() with the result (HAL_RADIO_HOP_SENT, ...). It can be NULL.
+* @retval uint8_t return value
+*           - 0x00 : Success.
+*           - 0xC0 : Invalid parameter (or HAL_RADIO_HopInit() not called).
+*           - 0xC4 : A packet is pending.
+*/
+uint8_t HAL_RADIO_HopSend(uint8_t *txBuffer, 
+                          uint8_t *rxBuffer, 
+                          uint8_t receive_length, 
+                          void (*Callback)(uint8_t result))
+{
+  if(txBuffer == NULL_0 || hopConfig.sequence_length == 0) {
+    return INVALID_PARAMETER_C0;
+  }
+  if(hopState != HOP_IDLE) {
+    return RADIO_BUSY_C4;
+  }
+  
+  hopTxBuffer = txBuffer;
+  hopRxBuffer = rxBuffer;
+  hopReceiveLength = receive_length;
+  hopCallback = Callback;
+  hopAttempts = 0;
+  hopStartTime = TIMER_GetCurrentSysTime();
+  hopSlotTime = hopStartTime;
+  hopState = HOP_WAIT;
+  
+  return SUCCESS_0;
+}
+
+/**
+* @brief  This routine returns 1 if a packet sent with HAL_RADIO_HopSend() has
+*         not been completed yet.
+*/
+uint8_t HAL_RADIO_HopPending(void)
+{
+  return (hopState != HOP_IDLE);
+}
+
+/**
+* @brief  Hop scheduler process. It must be called in the application main loop.
+*         The carrier sense is done here (busy wait of about 300 us) and the
+*         result of the packet is reported here.
+*/
+void HAL_RADIO_HopTick(void)
+{
+  int8_t rssi;
+  uint8_t ret, sample;
+  
+  if(hopState == HOP_DONE) {
+    HopComplete(hopResult);
+    return;
+  }
+  if(hopState != HOP_WAIT || TIME_DIFF((uint32_t)hopSlotTime, (uint32_t)TIMER_GetCurrentSysTime()) > 0) {
+    return;
+  }
+  
+  hopChannel = hopConfig.sequence[hopIndex];
+  
+  if(HAL_RADIO_CarrierSense(hopChannel, &rssi) != SUCCESS_0) {
+    /* Radio still busy (e.g. end of the previous packet): retry later */
+    return;
+  }
+  hopChannelStats[hopChannel].cca_count++;
+  
+  /* RSSI not available: the channel is sensed again. If there is still no reading
+     the state of the channel is unknown, and it is not considered busy. */
+  for(sample = 1; rssi == HOP_RSSI_NOT_AVAILABLE && sample < HOP_RSSI_SAMPLES; sample++) {
+    if(HAL_RADIO_CarrierSense(hopChannel, &rssi) != SUCCESS_0) {
+      break;
+    }
+  }
+  
+  if(rssi != HOP_RSSI_NOT_AVAILABLE && rssi >= hopConfig.busy_threshold) {
+    hopChannelStats[hopChannel].busy_count++;
+    if(++hopAttempts >= hopConfig.max_attempts) {
+      HopComplete(HAL_RADIO_HOP_CHANNEL_BUSY);
+      return;
+    }
+    hopIndex = (hopIndex + 1) % hopConfig.sequence_length;
+    hopSlotTime = TIMER_GetCurrentSysTime() + TIMER_UsToSystime(HopBackoff());
+    return;
+  }
+  
+  /* The channel is free: send as soon as possible. The state is set before,
+     since the packet can be completed before the end of this function. */
+  hopState = HOP_RUNNING;
+  if(hopRxBuffer != NULL_0) {
+    ret = HAL_RADIO_SendPacketWithAck(hopChannel, MIN_WAKEUP_TIME, hopTxBuffer, hopRxBuffer,
+                                      hopConfig.receive_timeout, hopReceiveLength, HopAckCallback);
+  }
+  else {
+    ret = HAL_RADIO_SendPacket(hopChannel, MIN_WAKEUP_TIME, hopTxBuffer, HopTxCallback);
+  }
+  if(ret != SUCCESS_0) {
+    /* The slot is sensed again at the next call */
+    hopState = HOP_WAIT;
+  }
+}
+
+/**
+* @brief  This routine returns the statistics of the hop scheduler.
+* @param[out] stats: Global statistics. It can be NULL.
+* @param[out] channel_stats: Array of 40 elements, one per channel. It can be NULL.
+*/
+void HAL_RADIO_HopGetStats(HAL_RADIO_HopStats *stats, HAL_RADIO_HopChannelStats *channel_stats)
+{
+  uint8_t i;
+  
+  if(stats != NULL_0) {
+    *stats = hopStats;
+  }
+  if(channel_stats != NULL_0) {
+    for(i = 0; i < 40; i++) {
+      channel_stats[i] = hopChannelStats[i];
+    }
+  }
+}
+
+/**
+* @brief  This routine resets the statistics of the hop scheduler.
+*/
+void HAL_RADIO_HopResetStats(void)
+{
+  uint8_t i;
+  
+  hopStats.packets = 0;
+  hopStats.acked = 0;
+  hopStats.dropped = 0;
+  hopStats.latency_total = 0;
+  hopStats.latency_max = 0;
+  for(i = 0; i < 40; i++) {
+    hopChannelStats[i].cca_count = 0;
+    hopChannelStats[i].busy_count = 0;
+    hopChannelStats[i].tx_count = 0;
+    hopChannelStats[i].ack_count = 0;
+  }
+}
+
 /******************* (C) COPYRIGHT 2019 STMicroelectronics *****END OF FILE****/
@@ -67,6 +67,8 @@ typedef enum
 /** @defgroup AESMGR_Exported_Constants  Exported Constants
  * @{
  */
+/* Size in bytes of an AES block */
+#define AESMGR_BLOCK_SIZE       16U
 /**
  * @}
  */
@@ -87,6 +89,20 @@ AESMGR_ResultStatus AESMGR_Deinit(void);
 
 AESMGR_ResultStatus AESMGR_Encrypt(const uint32_t *plainTextData, const uint32_t *key, uint32_t *encryptedData, uint8_t isr);
 
+AESMGR_ResultStatus AESMGR_EncryptBlocks(const uint32_t *plainTextData, const uint32_t *key, uint32_t *encryptedData, uint16_t blocks, uint8_t isr);
+
+AESMGR_ResultStatus AESMGR_CTR_Crypt(const uint8_t *key, uint8_t *counter, const uint8_t *input, uint8_t *output, uint32_t length);
+
+AESMGR_ResultStatus AESMGR_CCM_Encrypt(const uint8_t *key, const uint8_t *nonce, uint8_t nonceLength,
+                                       const uint8_t *aData, uint32_t aDataLength,
+                                       const uint8_t *input, uint8_t *output, uint32_t length,
+                                       uint8_t *tag, uint8_t tagLength);
+
+AESMGR_ResultStatus AESMGR_CCM_Decrypt(const uint8_t *key, const uint8_t *nonce, uint8_t nonceLength,
+                                       const uint8_t *aData, uint32_t aDataLength,
+                                       const uint8_t *input, uint8_t *output, uint32_t length,
+                                       const uint8_t *tag, uint8_t tagLength);
+
 /**
   * @}
   */
@@ -35,6 +35,7 @@
 */
 
 /* Includes ------------------------------------------------------------------*/
+#include <string.h>
 #include "aes_manager.h"
 #include "rf_driver_ll_bus.h"
 
@@ -53,6 +54,11 @@
 /** @defgroup AESMGR_Private_Defines Private Defines
 * @{
 */
+/* Number of blocks encrypted with a single call to AESMGR_EncryptBlocks() in CTR mode.
+   Two buffers of AESMGR_BATCH_BLOCKS * 16 bytes are allocated on the stack. */
+#ifndef AESMGR_BATCH_BLOCKS
+#define AESMGR_BATCH_BLOCKS     4U
+#endif
 /**
 * @}
 */
@@ -81,6 +87,214 @@
 /** @defgroup AESMGR_Private_FunctionPrototypes Private Function Prototypes
 * @{
 */
+static void AESMGR_BlocksToHw(const uint8_t *blocks, uint32_t *words, uint16_t numBlocks);
+static void AESMGR_BlocksFromHw(const uint32_t *words, uint8_t *blocks, uint16_t numBlocks);
+static void AESMGR_CounterIncrement(uint8_t *counter, uint8_t size);
+static AESMGR_ResultStatus AESMGR_EncryptBytes(const uint32_t *hwKey, uint8_t *blocks, uint16_t numBlocks);
+static AESMGR_ResultStatus AESMGR_CCM(const uint8_t *key, const uint8_t *nonce, uint8_t nonceLength,
+                                      const uint8_t *aData, uint32_t aDataLength,
+                                      const uint8_t *input, uint8_t *output, uint32_t length,
+                                      uint8_t *tag, uint8_t tagLength, uint8_t decrypt);
+/**
+* @}
+*/
+
+/** @defgroup AESMGR_Private_Functions Private Functions
+* @{
+*/
+
+/* The AES engine works on the byte reversed block (and key): the first byte of
+   the block is the most significant byte of the last word. */
+static void AESMGR_BlocksToHw(const uint8_t *blocks, uint32_t *words, uint16_t numBlocks)
+{
+  uint8_t i;
+  
+  while (numBlocks--)
+  {
+    for (i = 0; i < 4; i++)
+    {
+      words[i] = ((uint32_t)blocks[12 - 4*i] << 24) | ((uint32_t)blocks[13 - 4*i] << 16) |
+                 ((uint32_t)blocks[14 - 4*i] << 8) | (uint32_t)blocks[15 - 4*i];
+    }
+    blocks += AESMGR_BLOCK_SIZE;
+    words += 4;
+  }
+}
+
+static void AESMGR_BlocksFromHw(const uint32_t *words, uint8_t *blocks, uint16_t numBlocks)
+{
+  uint8_t i;
+  
+  while (numBlocks--)
+  {
+    for (i = 0; i < 4; i++)
+    {
+      blocks[12 - 4*i] = (uint8_t)(words[i] >> 24);
+      blocks[13 - 4*i] = (uint8_t)(words[i] >> 16);
+      blocks[14 - 4*i] = (uint8_t)(words[i] >> 8);
+      blocks[15 - 4*i] = (uint8_t)words[i];
+    }
+    blocks += AESMGR_BLOCK_SIZE;
+    words += 4;
+  }
+}
+
+/* Big endian increment of the last size bytes of a counter block */
+static void AESMGR_CounterIncrement(uint8_t *counter, uint8_t size)
+{
+  uint8_t i;
+  
+  for (i = AESMGR_BLOCK_SIZE - 1; size--; i--)
+  {
+    if (++counter[i] != 0)
+      break;
+  }
+}
+
+/* Encrypt in place up to AESMGR_BATCH_BLOCKS blocks */
+static AESMGR_ResultStatus AESMGR_EncryptBytes(const uint32_t *hwKey, uint8_t *blocks, uint16_t numBlocks)
+{
+  uint32_t words[AESMGR_BATCH_BLOCKS * 4];
+  
+  AESMGR_BlocksToHw(blocks, words, numBlocks);
+  if (AESMGR_EncryptBlocks(words, hwKey, words, numBlocks, 0) != AESMGR_SUCCESS)
+    return AESMGR_ERROR;
+  AESMGR_BlocksFromHw(words, blocks, numBlocks);
+  
+  return AESMGR_SUCCESS;
+}
+
+/* CCM as specified in NIST SP800-38C and RFC 3610. The CBC-MAC of a payload
+   block and the key stream of the same block are computed with a single call
+   to AESMGR_EncryptBlocks(). */
+static AESMGR_ResultStatus AESMGR_CCM(const uint8_t *key, const uint8_t *nonce, uint8_t nonceLength,
+                                      const uint8_t *aData, uint32_t aDataLength,
+                                      const uint8_t *input, uint8_t *output, uint32_t length,
+                                      uint8_t *tag, uint8_t tagLength, uint8_t decrypt)
+{
+  uint32_t hwKey[4];
+  /* blocks[0]: CBC-MAC, blocks[1]: key stream, ctr: counter block */
+  uint8_t blocks[2][AESMGR_BLOCK_SIZE], ctr[AESMGR_BLOCK_SIZE], s0[AESMGR_BLOCK_SIZE];
+  uint8_t lengthSize = 15U - nonceLength;
+  uint8_t mac_pending = 0;
+  uint8_t i, n, pos;
+  
+  if (nonceLength < 7U || nonceLength > 13U || tagLength < 4U || tagLength > 16U || (tagLength & 1U))
+    return AESMGR_ERROR;
+  if (lengthSize < 4U && (length >> (8U * lengthSize)) != 0)
+    return AESMGR_ERROR;
+  
+  AESMGR_BlocksToHw(key, hwKey, 1);
+  
+  /* B0 and A0 */
+  blocks[0][0] = (aDataLength ? 0x40U : 0x00U) | (((tagLength - 2U) / 2U) << 3) | (lengthSize - 1U);
+  memcpy(&blocks[0][1], nonce, nonceLength);
+  for (i = 0; i < lengthSize; i++)
+  {
+    blocks[0][15 - i] = (i < 4U) ? (uint8_t)(length >> (8U * i)) : 0U;
+  }
+  memset(ctr, 0, sizeof(ctr));
+  ctr[0] = lengthSize - 1U;
+  memcpy(&ctr[1], nonce, nonceLength);
+  memcpy(blocks[1], ctr, AESMGR_BLOCK_SIZE);
+  if (AESMGR_EncryptBytes(hwKey, blocks[0], 2) != AESMGR_SUCCESS)
+    return AESMGR_ERROR;
+  memcpy(s0, blocks[1], AESMGR_BLOCK_SIZE);
+  
+  /* Additional authenticated data, prefixed by its encoded length */
+  if (aDataLength)
+  {
+    if (aDataLength < 0xFF00U)
+    {
+      blocks[0][0] ^= (uint8_t)(aDataLength >> 8);
+      blocks[0][1] ^= (uint8_t)aDataLength;
+      pos = 2;
+    }
+    else
+    {
+      blocks[0][0] ^= 0xFFU;
+      blocks[0][1] ^= 0xFEU;
+      blocks[0][2] ^= (uint8_t)(aDataLength >> 24);
+      blocks[0][3] ^= (uint8_t)(aDataLength >> 16);
+      blocks[0][4] ^= (uint8_t)(aDataLength >> 8);
+      blocks[0][5] ^= (uint8_t)aDataLength;
+      pos = 6;
+    }
+    while (aDataLength)
+    {
+      blocks[0][pos++] ^= *aData++;
+      aDataLength--;
+      if (pos == AESMGR_BLOCK_SIZE || aDataLength == 0)
+      {
+        if (AESMGR_EncryptBytes(hwKey, blocks[0], 1) != AESMGR_SUCCESS)
+          return AESMGR_ERROR;
+        pos = 0;
+      }
+    }
+  }
+  
+  /* Payload: the plain text is authenticated, so on decryption the CBC-MAC of
+     a block is computed together with the key stream of the next one. */
+  while (length)
+  {
+    n = (length < AESMGR_BLOCK_SIZE) ? (uint8_t)length : AESMGR_BLOCK_SIZE;
+    
+    if (!decrypt)
+    {
+      for (i = 0; i < n; i++)
+        blocks[0][i] ^= input[i];
+      mac_pending = 1;
+    }
+    
+    AESMGR_CounterIncrement(ctr, lengthSize);
+    memcpy(blocks[1], ctr, AESMGR_BLOCK_SIZE);
+    if (mac_pending)
+    {
+      if (AESMGR_EncryptBytes(hwKey, blocks[0], 2) != AESMGR_SUCCESS)
+        return AESMGR_ERROR;
+      mac_pending = 0;
+    }
+    else if (AESMGR_EncryptBytes(hwKey, blocks[1], 1) != AESMGR_SUCCESS)
+    {
+      return AESMGR_ERROR;
+    }
+    
+    for (i = 0; i < n; i++)
+      output[i] = input[i] ^ blocks[1][i];
+    
+    if (decrypt)
+    {
+      for (i = 0; i < n; i++)
+        blocks[0][i] ^= output[i];
+      mac_pending = 1;
+    }
+    
+    input += n;
+    output += n;
+    length -= n;
+  }
+  
+  if (mac_pending)
+  {
+    if (AESMGR_EncryptBytes(hwKey, blocks[0], 1) != AESMGR_SUCCESS)
+      return AESMGR_ERROR;
+  }
+  
+  if (decrypt)
+  {
+    /* Compare without early exit */
+    n = 0;
+    for (i = 0; i < tagLength; i++)
+      n |= tag[i] ^ blocks[0][i] ^ s0[i];
+    return (n == 0) ? AESMGR_SUCCESS : AESMGR_ERROR;
+  }
+  
+  for (i = 0; i < tagLength; i++)
+    tag[i] = blocks[0][i] ^ s0[i];
+  
+  return AESMGR_SUCCESS;
+}
+
 /**
 * @}
 */
@@ -122,6 +336,129 @@ WEAK_FUNCTION(AESMGR_ResultStatus AESMGR_Encrypt(const uint32_t *plainTextData,
   in the dedicated board file */
 }
 
+/**
+ * @brief Perform AES128 encryption on consecutive blocks using the same key.
+ *        A block interrupted by a higher priority encryption is encrypted again.
+ * @param  plainTextData: pointer to the data to be encrypted (blocks * 128 bits)
+ * @param  key: encryption key (128 bits)
+ * @param  blocks: number of 128 bits blocks
+ * @param  isr:
+ *                  1 = The function is being called from  the radio isr context
+ *                  0 = The function is being called from the user context
+ *
+ * @retval encryptedData: pointer to the encrypted data returned (blocks * 128 bits).
+ *                        It can be the same buffer as plainTextData.
+ */
+WEAK_FUNCTION(AESMGR_ResultStatus AESMGR_EncryptBlocks(const uint32_t *plainTextData, const uint32_t *key, uint32_t *encryptedData, uint16_t blocks, uint8_t isr))
+{
+  return AESMGR_SUCCESS;
+  
+  /* NOTE : This function should not be modified, the callback is implemented 
+  in the dedicated board file */
+}
+
+/**
+ * @brief Perform AES128 encryption or decryption in counter mode
+ *        (NIST SP800-38A). Key, counter and data are in standard byte order.
+ * @param  key: encryption key (16 bytes)
+ * @param  counter: initial counter block (16 bytes). It is incremented (big
+ *                  endian) for each block used, so that a stream can be
+ *                  continued with the next call if length is a multiple of 16.
+ * @param  input: data to be encrypted or decrypted
+ * @param  output: result (it can be the same buffer as input)
+ * @param  length: number of bytes
+ *
+ * @retval AESMGR_SUCCESS or AESMGR_ERROR
+ */
+AESMGR_ResultStatus AESMGR_CTR_Crypt(const uint8_t *key, uint8_t *counter, const uint8_t *input, uint8_t *output, uint32_t length)
+{
+  uint32_t hwKey[4];
+  uint8_t keyStream[AESMGR_BATCH_BLOCKS * AESMGR_BLOCK_SIZE];
+  uint16_t numBlocks, i;
+  uint32_t n;
+  
+  AESMGR_BlocksToHw(key, hwKey, 1);
+  
+  while (length)
+  {
+    n = (length < sizeof(keyStream)) ? length : sizeof(keyStream);
+    numBlocks = (uint16_t)((n + AESMGR_BLOCK_SIZE - 1U) / AESMGR_BLOCK_SIZE);
+    
+    for (i = 0; i < numBlocks; i++)
+    {
+      memcpy(&keyStream[i * AESMGR_BLOCK_SIZE], counter, AESMGR_BLOCK_SIZE);
+      AESMGR_CounterIncrement(counter, AESMGR_BLOCK_SIZE);
+    }
+    if (AESMGR_EncryptBytes(hwKey, keyStream, numBlocks) != AESMGR_SUCCESS)
+      return AESMGR_ERROR;
+    
+    for (i = 0; i < n; i++)
+      output[i] = input[i] ^ keyStream[i];
+    
+    input += n;
+    output += n;
+    length -= n;
+  }
+  
+  return AESMGR_SUCCESS;
+}
+
+/**
+ * @brief Perform AES128-CCM authenticated encryption (NIST SP800-38C, RFC 3610).
+ *        Key, nonce and data are in standard byte order.
+ * @param  key: encryption key (16 bytes)
+ * @param  nonce: nonce
+ * @param  nonceLength: nonce length, from 7 to 13 bytes
+ * @param  aData: additional authenticated data (not encrypted)
+ * @param  aDataLength: length of aData
+ * @param  input: plain text
+ * @param  output: cipher text (it can be the same buffer as input)
+ * @param  length: length of the plain text
+ * @param  tag: returned authentication tag
+ * @param  tagLength: tag length: 4, 6, 8, 10, 12, 14 or 16 bytes
+ *
+ * @retval AESMGR_SUCCESS or AESMGR_ERROR if the parameters are not valid
+ */
+AESMGR_ResultStatus AESMGR_CCM_Encrypt(const uint8_t *key, const uint8_t *nonce, uint8_t nonceLength,
+                                       const uint8_t *aData, uint32_t aDataLength,
+                                       const uint8_t *input, uint8_t *output, uint32_t length,
+                                       uint8_t *tag, uint8_t tagLength)
+{
+  return AESMGR_CCM(key, nonce, nonceLength, aData, aDataLength, input, output, length, tag, tagLength, 0);
+}
+
+/**
+ * @brief Perform AES128-CCM authenticated decryption (NIST SP800-38C, RFC 3610).
+ *        Key, nonce and data are in standard byte order.
+ * @param  key: encryption key (16 bytes)
+ * @param  nonce: nonce
+ * @param  nonceLength: nonce length, from 7 to 13 bytes
+ * @param  aData: additional authenticated data
+ * @param  aDataLength: length of aData
+ * @param  input: cipher text
+ * @param  output: plain text (it can be the same buffer as input)
+ * @param  length: length of the cipher text
+ * @param  tag: received authentication tag
+ * @param  tagLength: tag length: 4, 6, 8, 10, 12, 14 or 16 bytes
+ *
+ * @retval AESMGR_SUCCESS or AESMGR_ERROR if the parameters are not valid or
+ *         the tag does not match. On error the output is cleared.
+ */
+AESMGR_ResultStatus AESMGR_CCM_Decrypt(const uint8_t *key, const uint8_t *nonce, uint8_t nonceLength,
+                                       const uint8_t *aData, uint32_t aDataLength,
+                                       const uint8_t *input, uint8_t *output, uint32_t length,
+                                       const uint8_t *tag, uint8_t tagLength)
+{
+  if (AESMGR_CCM(key, nonce, nonceLength, aData, aDataLength, input, output, length, (uint8_t *)tag, tagLength, 1) != AESMGR_SUCCESS)
+  {
+    /* The plain text of a message not authenticated is not released */
+    memset(output, 0, length);
+    return AESMGR_ERROR;
+  }
+  
+  return AESMGR_SUCCESS;
+}
+
 /**
 * @}
 */
@@ -105,40 +105,68 @@ AESMGR_ResultStatus AESMGR_Deinit(void)
 }
 
 AESMGR_ResultStatus AESMGR_Encrypt(const uint32_t *plainTextData, const uint32_t *key, uint32_t *encryptedData, uint8_t isr)
+{
+  return AESMGR_EncryptBlocks(plainTextData, key, encryptedData, 1, isr);
+}
+
+AESMGR_ResultStatus AESMGR_EncryptBlocks(const uint32_t *plainTextData, const uint32_t *key, uint32_t *encryptedData, uint16_t blocks, uint8_t isr)
 {
   /* Counter to signal interruption by a higher priority routine. */
   static volatile uint8_t start_cnt;
   uint8_t priv_start_cnt;
+  uint8_t load_key = 1;
+  uint32_t cipherText[4];
   
   start_cnt++;
-
-  do
+  priv_start_cnt = start_cnt;
+  /* Starting from this point, any call to HW_AES_Encrypt will change start_cnt. */
+  
+  while (blocks != 0)
   {
-    priv_start_cnt = start_cnt;
-    /* Starting from this point, any call to HW_AES_Encrypt will change start_cnt. */
-
-    /* Write the Key in the BLE register */  
-    BLUE->MANAESKEY0REG = key[0];
-    BLUE->MANAESKEY1REG = key[1];
-    BLUE->MANAESKEY2REG = key[2];
-    BLUE->MANAESKEY3REG = key[3];
-
+    if (load_key)
+    {
+      /* Write the Key in the BLE register: it is kept for the next blocks */
+      BLUE->MANAESKEY0REG = key[0];
+      BLUE->MANAESKEY1REG = key[1];
+      BLUE->MANAESKEY2REG = key[2];
+      BLUE->MANAESKEY3REG = key[3];
+      load_key = 0;
+    }
+    
     /* Write the plain text data in the BLE register */
     BLUE->MANAESCLEARTEXT0REG = plainTextData[0];
     BLUE->MANAESCLEARTEXT1REG = plainTextData[1];
     BLUE->MANAESCLEARTEXT2REG = plainTextData[2];
     BLUE->MANAESCLEARTEXT3REG = plainTextData[3];
-
+    
     AESMGR_Start();
-
+    
     /* Read the plain text data in the BLE register */
-    encryptedData[0] = BLUE->MANAESCIPHERTEXT0REG;
-    encryptedData[1] = BLUE->MANAESCIPHERTEXT1REG;
-    encryptedData[2] = BLUE->MANAESCIPHERTEXT2REG;
-    encryptedData[3] = BLUE->MANAESCIPHERTEXT3REG;
-
-  } while (priv_start_cnt != start_cnt);
-
+    cipherText[0] = BLUE->MANAESCIPHERTEXT0REG;
+    cipherText[1] = BLUE->MANAESCIPHERTEXT1REG;
+    cipherText[2] = BLUE->MANAESCIPHERTEXT2REG;
+    cipherText[3] = BLUE->MANAESCIPHERTEXT3REG;
+    
+    if (priv_start_cnt == start_cnt)
+    {
+      /* Stored only now: the encryption can be done in place, and an interrupted block is encrypted again */
+      encryptedData[0] = cipherText[0];
+      encryptedData[1] = cipherText[1];
+      encryptedData[2] = cipherText[2];
+      encryptedData[3] = cipherText[3];
+      plainTextData += 4;
+      encryptedData += 4;
+      blocks--;
+    }
+    else
+    {
+      /* Another encryption ran since the key was written, possibly with another key: the key is loaded again
+         and this block is encrypted again. A routine running between two blocks is detected by the next block. */
+      priv_start_cnt = start_cnt;
+      load_key = 1;
+    }
+  }
+  
   return AESMGR_SUCCESS;
 }
 
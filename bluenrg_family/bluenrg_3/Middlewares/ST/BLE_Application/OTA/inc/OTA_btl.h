@@ -270,13 +270,27 @@ void OTA_Radio_Activity(uint32_t Next_State_SysTime);
 
 /**
  * @brief  It just informs OTA manager of disconnection complete event in order to
- *         jump to new application
+ *         jump to new application. It releases the OTA session of the last OTA
+ *         client: applications with several connections call
+ *         OTA_Disconnection_Complete_CB() instead
  * @retval None
  *
  * @note The API code could be subject to change in future releases.
  */
 void OTA_terminate_connection(void); 
 
+/**
+ * @brief  It releases the OTA session of a connection and it allows the jump to
+ *         the new application once no other session is transferring an image:
+ *         to be called from hci_disconnection_complete_event() for each
+ *         terminated connection
+ * @param  Connection_Handle Handle of the terminated connection
+ * @retval None
+ *
+ * @note The API code could be subject to change in future releases.
+ */
+void OTA_Disconnection_Complete_CB(uint16_t Connection_Handle);
+
 /**
  * @brief  Function to be called when an aci_att_exchange_mtu_resp_event is
  *         received.
@@ -4,8 +4,9 @@
   * @author  AMS - RF Application team
   * @version V1.1.0
   * @date    10-December-2021
-  * @brief   Bluetooth LE Over The Air (OTA) FW upgrade implementation. This
-  *          library assumes that only one connection is present.
+  * @brief   Bluetooth LE Over The Air (OTA) FW upgrade implementation. Up to
+  *          OTA_MAX_LINKS connections can run an OTA session at the same time,
+  *          each one on its own flash pages.
   ******************************************************************************
   * @attention
   *
@@ -28,6 +29,8 @@
 #include "math.h"
 #include "gap_profile.h"
 #include "rf_driver_hal_vtimer.h"
+#include "rf_driver_ll_bus.h"
+#include "crc_manager.h"
 #include "bluenrg_lp_evb_config.h"
 #include "bluenrg_lp_api.h"
 #include <string.h>
@@ -39,13 +42,106 @@
 #define PRINTF(...)
 #endif
 
-#define NUM_LINKS 1 
+/* Max number of concurrent OTA sessions (one per connection) */
+#ifndef OTA_MAX_LINKS
+#define OTA_MAX_LINKS 1 
+#endif
+
+#define OTA_INVALID_CONN_HANDLE (0xFFFF)
+
+/* Max number of connections whose ATT_MTU and data length exchanges are recorded: they take place before
+   the OTA client starts the OTA session of the connection */
+#ifndef OTA_MAX_CONNECTIONS
+#define OTA_MAX_CONNECTIONS 8
+#endif
     
 /* BLE transfer time optimization: No sync with radio activities, no connection interval update */
 //#define OTA_DIRECT_WRITE 1 /* not yet supported on BLE stack v3.0 */
 
 /* BLE OTA Server version */ 
-#define BLE_OTA_SERVER_VERSION  2 /* L2CAP connection update */
+#define BLE_OTA_SERVER_VERSION  6 /* Compressed and delta encoded images */
+
+/* CRC-32 integrity check, requested by the OTA client setting this flag on the first byte of the New Image characteristic:
+   - the New Image characteristic write carries 4 more bytes: the CRC-32 of the whole image (little endian);
+   - the checksum byte of each packet is the byte (sequence number % 4) of the CRC-32 of the window data received
+     so far (it restarts with the first packet of each window), XORed with the 3 header bytes;
+   - the CRC-32 of the image programmed on flash is checked before setting the validity tags.
+   CRC-32 is the CRC-32/MPEG-2: polynomial 0x04C11DB7, initial value 0xFFFFFFFF, no reflection, no final XOR.
+   Without this flag, packets are checked with the legacy 8-bit XOR checksum. */
+#define OTA_CRC32_MODE_FLAG (0x80)
+
+#define OTA_CRC32_INIT (CRCMGR_CRC32_INIT)
+
+/* Uncomment for computing the CRC-32 by software if the CRC peripheral is used by the application */
+//#define OTA_SW_CRC32
+
+/* Adaptive notification window, requested by the OTA client setting this flag on the first byte of the New Image characteristic:
+   - each notification carries a third 16-bit field (little endian): the number of packets of the next window. The OTA client
+     sets the needs ack byte on the last packet of each window (or on the last packet of the image);
+   - the window grows while the windows are received without errors and it is halved on each checksum or sequence number
+     error. It is limited by the ATT_MTU agreed with the OTA client and by the image buffer size (OTA_WINDOW_BUF_SIZE).
+   Without this flag, the window is NOTIFICATION_WINDOW packets. */
+#define OTA_ADAPTIVE_WINDOW_FLAG (0x40)
+
+/* Resumable image transfer, requested by the OTA client setting this flag (together with OTA_CRC32_MODE_FLAG) on the first byte
+   of the New Image characteristic. The progress of each CRC-32 mode session is checkpointed in RAM after each window programmed
+   on flash: the length of the image programmed so far and its running CRC-32. When a client reconnects for the same image
+   (same base, size and CRC-32), the programmed image is checked against the checkpoint digest and the notification sent when
+   notifications are enabled carries the sequence number to resume from (0 if the transfer restarts). The transfer resumes from
+   the last flash page completely programmed: the previous pages are not erased again.
+   The checkpoints are also recorded on the checkpoint flash page (OTA_CHECKPOINT_PAGE_ADDRESS) each time the page to resume
+   from changes, so that a transfer is resumed after a reset too. Without a checkpoint page, this flag is ignored. */
+#define OTA_RESUME_FLAG (0x20)
+
+/* Checkpoint flash page: the page between the higher application and the NVM, left unused by the flash layout */
+#if defined(CONFIG_OTA_LOWER) || defined(CONFIG_OTA_HIGHER)
+#if ((HIGHER_APP_OFFSET + HIGHER_APP_SIZE + FLASH_PAGE_SIZE) <= (_MEMORY_FLASH_SIZE_ - NVM_SIZE))
+#define OTA_CHECKPOINT_PAGE_ADDRESS (APP_HIGHER_ADDRESS_END + 1)
+#endif
+#endif
+
+/* Encoded image transfer, requested by the OTA client setting this flag (together with OTA_CRC32_MODE_FLAG) on the first byte
+   of the New Image characteristic: the New Image characteristic write carries 4 more bytes, the length of the encoded image
+   (little endian). The packets carry the encoded image, which is decoded while it is programmed on flash. The image size and
+   CRC-32 are the ones of the decoded image. The encoded image is a sequence of tokens (T is the token byte):
+   - T = 0x00..0x7F: literal, the next T + 1 bytes are image bytes;
+   - T = 0x80..0xBF: copy of L image bytes already decoded, starting D bytes before the current image byte (D = 1..65535
+     follows the token on 2 bytes);
+   - T = 0xC0..0xFF: copy of L bytes of the running application image (delta update), starting at offset O of the running
+     image (O follows the token on 3 bytes). The OTA validity tag of the running image must not be copied.
+   For copies L = (T & 0x3F) + 4, unless (T & 0x3F) = 0x3F: L = 0x3F + 4 + E, E follows the token on 2 bytes.
+   Multi-byte fields are little endian. Resumable transfer is not supported for encoded images. */
+#define OTA_ENCODED_IMAGE_FLAG (0x10)
+
+/* Uncomment for accepting encoded images */
+//#define OTA_ENCODED_IMAGE
+
+#define OTA_MODE_FLAGS (OTA_CRC32_MODE_FLAG | OTA_ADAPTIVE_WINDOW_FLAG | OTA_RESUME_FLAG | OTA_ENCODED_IMAGE_FLAG)
+
+#ifdef OTA_ENCODED_IMAGE
+/* Encoded image tokens */
+#define OTA_TOKEN_COPY         (0x80)
+#define OTA_TOKEN_BASE_COPY    (0x40)
+#define OTA_TOKEN_LITERAL_MASK (0x7F)
+#define OTA_TOKEN_LENGTH_MASK  (0x3F)
+#define OTA_TOKEN_MIN_COPY     (4)
+
+/* Decoder states */
+#define OTA_DECODER_TOKEN   (0)
+#define OTA_DECODER_LENGTH  (1)
+#define OTA_DECODER_ARG     (2)
+#define OTA_DECODER_LITERAL (3)
+#define OTA_DECODER_COPY    (4)
+
+/* Running application image used as base of the delta encoded images */
+#if defined(CONFIG_OTA_LOWER)
+#define OTA_BASE_IMAGE_ADDRESS (APP_LOWER_ADDRESS)
+#define OTA_BASE_IMAGE_SIZE    (LOWER_APP_SIZE)
+#elif defined(CONFIG_OTA_HIGHER)
+#define OTA_BASE_IMAGE_ADDRESS (APP_HIGHER_ADDRESS)
+#define OTA_BASE_IMAGE_SIZE    (HIGHER_APP_SIZE)
+#endif
+#endif /* OTA_ENCODED_IMAGE */
 
 
 #define OTA_LED BSP_LED3 /* LED turned ON  OTA session is ongoing */
@@ -64,6 +160,10 @@
 #define NOTIFICATION_WINDOW (8) 
 #define NOTIFICATION_INTERVAL(x) (((x) == 1) || ((x) == 3)) ? 1 : (NOTIFICATION_WINDOW) //3: backward compatibility with old OTA client TBR
 
+/* Adaptive notification window limits (packets) */
+#define MIN_NOTIFICATION_WINDOW (2)
+#define MAX_NOTIFICATION_WINDOW (64)
+
 /* The following defines **MUST NOT** be modified for proper operation of the current OTA BTL release */
 #define PAGE_SIZE      (2048)  // Flash page size
 #define BYTE_INCREMENT (16)    // It's equal to max flash size we can write: 16 bytes with Flash Burst Write
@@ -77,9 +177,17 @@
 /* OTA FW image content MAX size related to the max supported OTA_ATT_MTU_SIZE from OTA Server */
 #define IMAGE_CONTENT_SIZE ((BYTE_INCREMENT * MAX_NUM_BLOCKS_X_PACKET) + 4) /* + 4 for (OTA sequence number, check sum needs ack) */ 
 
-/* MAX buffer size to hold only the image file data on received notification/s and to be written on flash:
-   It is related to the max supported OTA_ATT_MTU_SIZE from OTA Server */
-#define BUF_SIZE (((BYTE_INCREMENT * MAX_NUM_BLOCKS_X_PACKET) +4 ) * NOTIFICATION_WINDOW)  //STATIC value tailored for MAX default value for OTA_ATT_MTU_SIZE 
+/* MAX buffer size to hold only the image file data on received notification/s and to be written on flash (two buffers for each
+   OTA session). The default is related to the max supported OTA_ATT_MTU_SIZE from OTA Server, so that NOTIFICATION_WINDOW packets
+   always fit. It can be redefined (multiple of 4 bytes) for trading RAM for the max adaptive notification window: the OTA clients
+   not using the adaptive window are refused if NOTIFICATION_WINDOW packets of the agreed ATT_MTU do not fit. */
+#ifndef OTA_WINDOW_BUF_SIZE
+#define OTA_WINDOW_BUF_SIZE (((BYTE_INCREMENT * MAX_NUM_BLOCKS_X_PACKET) +4 ) * NOTIFICATION_WINDOW)  //STATIC value tailored for MAX default value for OTA_ATT_MTU_SIZE 
+#endif
+#if ((OTA_WINDOW_BUF_SIZE % 4) != 0)
+#error "OTA_WINDOW_BUF_SIZE must be a multiple of 4 bytes"
+#endif
+#define BUF_SIZE (OTA_WINDOW_BUF_SIZE)
 
 /**** OTA macros for defining actual OTA FW transfer paramaters related to actual OTA att mtu size agreed with OTA Client *****************/
 
@@ -91,6 +199,10 @@
 /* Flash burst write guard time for BYTE_INCREMENT (16) * num_block_x_packets(ota_att_mtu_size)  * NOTIFICATION_WINDOW (8 writes) bytes */
 #define OTA_WRITE_GUARD_TIME(ota_att_mtu_size) (((((((((4 + (NUM_BLOCKS_X_PACKET(ota_att_mtu_size) * 16)) * NOTIFICATION_WINDOW)) / NUM_BURST_WRITE_BYTES)) * BURST_WRITE_BYTES_uS_TIME) /(1000))) +1)
 
+/* Bytes that can be programmed with flash burst writes in a radio idle time (ms): a window is programmed in several
+   radio idle times if needed */
+#define OTA_WRITE_LENGTH(idle_time) (((idle_time) > 1) ? (((((idle_time) - 1) * 1000) / BURST_WRITE_BYTES_uS_TIME) * NUM_BURST_WRITE_BYTES) : 0)
+
 #if defined(CONFIG_SW_OTA_DATA_LENGTH_EXT)
 #ifdef OTA_DIRECT_WRITE
 #define OTA_EXT_LE_L2CAP_CONN_INTERVAL(ota_att_mtu_size) (8)  
@@ -101,11 +213,17 @@
 #endif
 
 /* Actual data packet size related to the agreed ota_att_mtu_size */
-#define DATA_PACKET_SIZE(ota_att_mtu_size)  (BYTE_INCREMENT * NUM_BLOCKS_X_PACKET(ota_att_mtu_size))
+#define DATA_PACKET_SIZE(ota_att_mtu_size)  ((uint32_t)BYTE_INCREMENT * NUM_BLOCKS_X_PACKET(ota_att_mtu_size))
+
+/* Actual bufPointer limit related to the agreed ota_att_mtu_size and to the notification window of the OTA session */
+#define BUFPOINTER_LIMIT(link) (DATA_PACKET_SIZE((link)->ota_att_mtu_size) * ((link)->adaptive_window ? (link)->notification_range : NOTIFICATION_WINDOW))
+
 
-/* Actual bufPointer limit related to the agreed ota_att_mtu_size */
-#define BUFPOINTER_LIMIT(ota_att_mtu_size) (DATA_PACKET_SIZE(ota_att_mtu_size) * NOTIFICATION_WINDOW)
+/* Number of image buffers: one window is programmed while the next one is received */
+#define OTA_IMAGE_BUFFERS (2)
 
+/* Flash page erase time (ms): a page that is not blank is erased ahead of time only if the radio is idle for this time */
+#define OTA_PAGE_ERASE_TIME (22 + 1)
 
 /**** End OTA macros ******************************************/
 
@@ -117,6 +235,7 @@
 #define OTA_FLASH_WRITE_ERROR  0x00FF
 #define OTA_SEQUENCE_ERROR     0x00F0
 #define OTA_CHECKSUM_ERROR     0x000F
+#define OTA_IMAGE_CRC_ERROR    0x00C3
 
 /* Check if application is just using the OTA service Manager and not the overall OTA framework */
 #ifndef CONFIG_OTA_USE_SERVICE_MANAGER 
@@ -138,7 +257,7 @@ ExpectedImageTUSeqNumber Characteristic: 2bdc5760-8508-11e3-baa7-0800200c9a66
 #define IMAGE_CONTENT_CHR_UUID 0x66,0x9a,0x0c,0x20,0x00,0x08,0xa7,0xba,0xe3,0x11,0x08,0x85,0x80,0xaa,0x91,0x26
 #define IMAGE_SEQ_NUM_CHR_UUID 0x66,0x9a,0x0c,0x20,0x00,0x08,0xa7,0xba,0xe3,0x11,0x08,0x85,0x60,0x57,0xdc,0x2b
 
-BLE_GATT_SRV_CCCD_DECLARE(sequence_number, NUM_LINKS, BLE_GATT_SRV_CCCD_PERM_DEFAULT,
+BLE_GATT_SRV_CCCD_DECLARE(sequence_number, OTA_MAX_LINKS, BLE_GATT_SRV_CCCD_PERM_DEFAULT,
                      BLE_GATT_SRV_OP_MODIFIED_EVT_ENABLE_FLAG);
 
 
@@ -188,62 +307,195 @@ static const ble_gatt_srv_def_t ota_service = {
    },
 };    
 
-struct
+/* Notification of the next expected sequence number or of an error condition */
+typedef struct
+{
+  uint16_t  replyCounter;
+  uint16_t  errCode;    
+  uint16_t  window;     /* Sent only to the OTA clients using the adaptive notification window */
+} OTA_Notification_t;
+
+/* Notification length: 4 bytes for the OTA clients not using the adaptive notification window */
+#define OTA_NOTIFICATION_LENGTH(link) ((link)->adaptive_window ? sizeof(OTA_Notification_t) : 4)
+
+/* Encoded image decoder */
+typedef struct
+{
+  uint32_t outLength; /* Decoded image bytes */
+  uint32_t arg;       /* Distance or base image offset of the current copy */
+  uint32_t source;    /* Image offset or base image address of the next byte of the current copy */
+  uint32_t count;     /* Bytes left of the current literal or copy */
+  uint32_t block[BYTE_INCREMENT / 4]; /* Decoded bytes not yet programmed */
+  uint8_t  token;
+  uint8_t  state;
+  uint8_t  argBytes;
+  uint8_t  error;     /* The encoded image is not valid */
+} OTA_Decoder_t;
+
+/* Image window waiting to be programmed on flash */
+typedef struct
+{
+  uint32_t address;     /* Flash address of the first byte of the window */
+  uint16_t length;      /* Bytes to be programmed: 0 if the buffer is free */
+  uint16_t startSeqNum; /* Sequence number of the first packet of the window */
+  uint16_t ackSeqNum;   /* Sequence number to be notified when the window is acknowledged */
+  uint16_t programmed;  /* Bytes already programmed: a window can be programmed in several radio idle times */
+  uint8_t  needsAck;    /* Ack to be sent only once the window has been programmed */
+#ifdef OTA_ENCODED_IMAGE
+  OTA_Decoder_t decoder; /* Decoder state at the beginning of the window */
+#endif
+} OTA_ImageWindow_t;
+
+/* OTA session with one OTA client */
+typedef struct
+{
+  uint16_t conn_handle; /* OTA_INVALID_CONN_HANDLE if the context is free */
+  /* 1 if the image has been programmed and tagged: the connection is terminated when no other
+     session is still transferring an image */
+  uint8_t completed;
+  /* 1 if the connection termination has been requested */
+  uint8_t terminated;
+  
+  /* Actual OTA mtu size agreed with OTA client: default is OTA_ATT_MTU_SIZE
+     if OTA CLient doesn't support extended data lenght */
+  uint16_t ota_att_mtu_size;
+  
+  uint8_t imageinfo[9]; //BLE OTA DLE server version 
+  uint8_t imageData[IMAGE_CONTENT_SIZE];
+  OTA_Notification_t notification;
+  uint8_t notification_range;
+  /* 1 if the OTA client follows the notification window sent with each notification */
+  uint8_t adaptive_window;
+  /* The adaptive window is doubled up to this size, then it grows by one packet */
+  uint8_t windowThreshold;
+  
+  uint32_t imageBase;
+  uint32_t imageSize;
+  /* 1 if the OTA client has requested the CRC-32 integrity check; 0 for the legacy XOR checksum */
+  uint8_t crc32_mode;
+  /* CRC-32 of the whole image provided by the OTA client */
+  uint32_t imageCrc;
+  /* Image word at the OTA validity tag location: it is not programmed during the OTA session */
+  uint32_t imageTagWord;
+  /* 1 if the OTA client can resume an interrupted image transfer */
+  uint8_t resume;
+  /* CRC-32 of the image bytes programmed on flash (totalBytesWritten) */
+  uint32_t writtenCrc;
+  /* 1 if the OTA client sends an encoded image */
+  uint8_t encoded;
+  /* Bytes sent by the OTA client: the encoded image length for encoded images, else imageSize */
+  uint32_t streamSize;
+#ifdef OTA_ENCODED_IMAGE
+  OTA_Decoder_t decoder;
+#endif
+  
+  /* Reception */
+  uint8_t detected_error;
+  uint16_t write_counter;
+  /* Sequence number of the last packet of the window in which an error has been detected */
+  uint16_t errorWindowEnd;
+  uint16_t bufPointer;
+  uint8_t checksum;
+  uint32_t windowCrc;
+  uint16_t expectedSeqNum;
+  /* Sequence number of the first packet of the window being received */
+  uint16_t windowStartSeqNum;
+  uint16_t receivedSeqNum;
+  uint32_t totalBytesReceived;
+  
+  /* Ping-pong image buffers: imageBuffer[rxBuffer] is being filled with the received
+     data while imageBuffer[writeBuffer] is waiting to be programmed */
+  uint8_t (*imageBuffer)[BUF_SIZE];
+  OTA_ImageWindow_t imageWindow[OTA_IMAGE_BUFFERS];
+  uint8_t rxBuffer;
+  uint8_t writeBuffer;
+  
+  /* Flash write */
+  uint32_t totalBytesWritten;
+  uint32_t currentWriteAddress;
+  /* Flash from the first image page up to this address is known to be blank */
+  uint32_t erasedAddress;
+} OTA_Link_t;
+
+/* Progress of the image transfer of an OTA session: it is kept after the disconnection for resuming the transfer */
+typedef struct
+{
+  /* Image identification */
+  uint32_t imageBase;
+  uint32_t imageSize;
+  uint32_t imageCrc;
+  /* Image bytes programmed on flash and their CRC-32 */
+  uint32_t writtenLength;
+  uint32_t writtenCrc;
+  uint32_t imageTagWord;
+} OTA_Checkpoint_t;
+
+/* ATT_MTU and data length agreed on a connection: they are used by the OTA session of the connection */
+typedef struct
 {
-    uint16_t  replyCounter;
-    uint16_t  errCode;    
-} notification;
+  uint16_t conn_handle; /* OTA_INVALID_CONN_HANDLE if the record is free */
+  uint16_t ota_att_mtu_size;
+  /* Flag for register if OTA Client has performed DLE and ATT_MTU exchange config */
+  uint8_t client_DLE_ATT_MTU;
+} OTA_Conn_Params_t;
+
+ALIGN(4) static uint8_t imageBuffer[OTA_MAX_LINKS][OTA_IMAGE_BUFFERS][BUF_SIZE];
+static OTA_Link_t ota_link[OTA_MAX_LINKS];
+/* Checkpoint of the last session of each OTA session context */
+static OTA_Checkpoint_t ota_checkpoint[OTA_MAX_LINKS];
+
+#ifdef OTA_CHECKPOINT_PAGE_ADDRESS
+/* Checkpoint record of an OTA session context on the checkpoint page: the records are appended, the last valid one of each
+   context is loaded at the initialization. The second half of a record is programmed first: a record interrupted by a reset
+   has no magic number and it is skipped */
+typedef struct
+{
+  uint32_t magic;       /* OTA_CHECKPOINT_MAGIC + OTA session context index */
+  uint32_t imageBase;
+  uint32_t imageSize;
+  uint32_t check;       /* Complemented XOR of the other words */
+  uint32_t imageCrc;
+  uint32_t writtenLength;
+  uint32_t writtenCrc;
+  uint32_t imageTagWord;
+} OTA_Checkpoint_Record_t;
+
+#define OTA_CHECKPOINT_MAGIC   (0x4F544100)
+#define OTA_CHECKPOINT_RECORDS (FLASH_PAGE_SIZE / sizeof(OTA_Checkpoint_Record_t))
+
+/* Last checkpoint recorded on flash of each OTA session context */
+static OTA_Checkpoint_t ota_checkpoint_flash[OTA_MAX_LINKS];
+/* Index of the first blank record of the checkpoint page */
+static uint16_t ota_checkpoint_next_record;
+#endif
+static OTA_Conn_Params_t ota_conn_params[OTA_MAX_CONNECTIONS];
 
-ALIGN(4) static uint8_t imageBuffer[BUF_SIZE];
+/* Characteristic values read by a connection without OTA session */
+static const uint8_t ota_default_imageinfo[9] = {BLE_OTA_SERVER_VERSION};
+static const uint8_t ota_default_imageData[IMAGE_CONTENT_SIZE];
+static const OTA_Notification_t ota_default_notification;
 
 uint8_t BTLServiceUUID4Scan[18]= {0x11,0x06,0x8a,0x97,0xf7,0xc0,0x85,0x06,0x11,0xe3,0xba,0xa7,0x08,0x00,0x20,0x0c,0x9a,0x66}; 
 
 /* Let the application know whether we are in the middle of a bootloading session through a global status variable */
 //uint8_t bootloadingOngoing = 0;
 
-static uint8_t bootloadingCompleted = 0;
 static uint8_t bootloadingCompleted_end = 0; 
+/* Set when an OTA session has completed a bootable image */
 static uint8_t ota_allow_jump = 0; 
-  
-/* UUIDS */
-static uint32_t imageBase = 0;
 
 static volatile uint8_t ota_service_is_disconnected=0;
 // static uint16_t PageNumber = 0; 
     
-static volatile uint8_t detected_error=0;
-static volatile uint16_t write_counter=0; 
-
-static volatile uint8_t ota_write_data = 0; 
-
-static uint32_t imageSize = 0; 
-static uint16_t bufPointer = 0;
-static uint32_t totalBytesWritten = 0;
-static uint8_t checksum = 0;
-static uint32_t currentWriteAddress = 0;
-static uint16_t expectedSeqNum = 0;
-
-static uint8_t notification_range = NOTIFICATION_WINDOW; 
-static uint16_t last_written_receivedSequence = 0;
-static uint16_t receivedSeqNum;
-    
-static void OTA_Send_Ack(void);
+static void OTA_Send_Ack(OTA_Link_t *link);
 
-static void OTA_Write_Data(void); 
+static void OTA_Write_Data(OTA_Link_t *link, uint32_t max_length); 
 
-static uint16_t conn_handle; 
+#ifdef OTA_CHECKPOINT_PAGE_ADDRESS
+static void OTA_Load_Checkpoints(void);
+#endif
 
-static uint8_t imageinfo[9] = {BLE_OTA_SERVER_VERSION,0,0,0,0,0,0,0,0}; //BLE OTA DLE server version 
 static uint32_t currentImageInfos[2];
-static uint8_t imageData[IMAGE_CONTENT_SIZE];
-
-/* Actual OTA mtu size agreed with OTA client: default is OTA_ATT_MTU_SIZE
-   if OTA CLient doesn't support extended data lenght */
-static uint16_t ota_att_mtu_size =  OTA_ATT_MTU_SIZE_CONF; 
-
-/* Flag for register if OTA Client has performed DLE and ATT_MTU exchange config */
-static volatile uint8_t client_DLE_ATT_MTU = 0; 
-
 
 /**
  * @brief  It jumps to the new upgraded application
@@ -258,9 +510,27 @@ void OTA_Jump_To_New_Application()
   NVIC_SystemReset(); 
 }
   
+/* It checks whether an OTA session is still transferring an image or, if completed is set, whether an OTA session
+   with an image (transferring or completed) is still connected: the jump to the new application waits for all the
+   sessions to complete or to be aborted, and for the connections of the completed sessions to be terminated */
+static uint8_t OTA_Transfer_Ongoing(uint8_t completed)
+{
+  uint8_t i;
+  
+  for (i = 0; i < OTA_MAX_LINKS; i++)
+  {
+    if ((ota_link[i].conn_handle != OTA_INVALID_CONN_HANDLE) && (ota_link[i].imageSize != 0) &&
+        (completed || !ota_link[i].completed))
+      return 1;
+  }
+  return 0;
+}
+
 /**
  * @brief  It just informs OTA manager of disconnection complete event in order to
- *         jump to new application
+ *         jump to new application. It releases the OTA session of the last OTA
+ *         client: applications with several connections call
+ *         OTA_Disconnection_Complete_CB() instead
  * @param  None
  * @retval None
  *
@@ -268,7 +538,43 @@ void OTA_Jump_To_New_Application()
  */  
 void OTA_terminate_connection(void)
 {
-  bootloadingCompleted_end = ota_allow_jump; 
+  OTA_Disconnection_Complete_CB(ota_link[0].conn_handle);
+}
+
+/**
+ * @brief  It releases the OTA session of a connection and it allows the jump to
+ *         the new application once no other session is transferring an image:
+ *         to be called on each disconnection complete event
+ * @param  Connection_Handle Handle of the terminated connection
+ * @retval None
+ *
+ * @note The API code could be subject to change in future releases.
+ */
+void OTA_Disconnection_Complete_CB(uint16_t Connection_Handle)
+{
+  uint8_t i;
+  
+  for (i = 0; i < OTA_MAX_LINKS; i++)
+  {
+    if (ota_link[i].conn_handle == Connection_Handle)
+    {
+      ota_link[i].conn_handle = OTA_INVALID_CONN_HANDLE;
+      ota_link[i].imageSize = 0;
+      ota_link[i].completed = 0;
+    }
+  }
+  for (i = 0; i < OTA_MAX_CONNECTIONS; i++)
+  {
+    if (ota_conn_params[i].conn_handle == Connection_Handle)
+    {
+      ota_conn_params[i].conn_handle = OTA_INVALID_CONN_HANDLE;
+    }
+  }
+  
+  if (!OTA_Transfer_Ongoing(1))
+  {
+    bootloadingCompleted_end = ota_allow_jump; 
+  }
 }
 
 /**
@@ -280,15 +586,24 @@ void OTA_terminate_connection(void)
  */
 uint8_t OTA_Tick()
 {
-  if (bootloadingCompleted) 
+  uint8_t i;
+  
+  /* The connections of the completed sessions are terminated when no other session is transferring an image */
+  if (ota_allow_jump && !OTA_Transfer_Ongoing(0)) 
   { 
-    bootloadingCompleted = 0; 
-    PRINTF("** Over The Air BLE  FW upgrade completed with success! *****************\r\n");
-    PRINTF("** Application is JUMPING to new base address: 0x%08X *********************\r\n",(unsigned int)imageBase);
-    /*  Turn off radio activity mask */
-    aci_hal_set_radio_activity_mask(0x0000);
-    /* Terminate connection with option to performs pending operations on stack queue */
-    aci_gap_terminate(conn_handle, 0x93);
+    for (i = 0; i < OTA_MAX_LINKS; i++)
+    {
+      if ((ota_link[i].conn_handle == OTA_INVALID_CONN_HANDLE) || !ota_link[i].completed || ota_link[i].terminated)
+        continue;
+      
+      ota_link[i].terminated = 1;
+      PRINTF("** Over The Air BLE  FW upgrade completed with success! *****************\r\n");
+      PRINTF("** Application is JUMPING to new base address: 0x%08X *********************\r\n",(unsigned int)ota_link[i].imageBase);
+      /*  Turn off radio activity mask */
+      aci_hal_set_radio_activity_mask(0x0000);
+      /* Terminate connection with option to performs pending operations on stack queue */
+      aci_gap_terminate(ota_link[i].conn_handle, 0x93);
+    }
   }
   
   return (bootloadingCompleted_end);
@@ -302,36 +617,44 @@ static void OTA_Set_Application_Tag_Value(uint32_t address,uint32_t Data)
 /**
  * @brief  It sets the related OTA application
  *         validity tags for handling the proper jumping to the valid application. 
- * @param  None
- * @retval None
+ * @param  link: OTA session which has completed the image upgrade
+ * @retval 1 if the image has been tagged as the valid application; 0 if it is
+ *         not at an application base address
  *
  * @note The API code could be subject to change in future releases.
  */
-static void OTA_Set_Validity_Tags(void) 
+static uint8_t OTA_Set_Validity_Tags(OTA_Link_t *link) 
 {
-  /* Based on the application type, the application validity tag is set */
-  if (OTA_OP_CODE == OTA_APP_SWITCH_OP_CODE_GO_TO_LOWER_APP) // Lower Application OTA done with success  
+  /* Based on the application slot of the new image, the application validity tag is set */
+#if defined(CONFIG_OTA_SERVICE_MANAGER)
+  if (link->imageBase == APP_WITH_OTA_SERVICE_ADDRESS) // OTA Service Manager has upgraded a new application with success  
+  {
+    /* Set valid tag x the new application just successfully upgraded through OTA */
+    OTA_Set_Application_Tag_Value(APP_WITH_OTA_SERVICE_ADDRESS, OTA_VALID_TAG);
+    return 1;
+  }
+#else
+  if (link->imageBase == APP_LOWER_ADDRESS) // Lower Application OTA done with success  
   {
     /* Set valid tag x lower application (the new application just successfully upgraded through OTA) */
     OTA_Set_Application_Tag_Value(APP_LOWER_ADDRESS, OTA_VALID_TAG);
     
     /* Set invalid/old tag for old higher application */
     OTA_Set_Application_Tag_Value(APP_HIGHER_ADDRESS, OTA_INVALID_OLD_TAG); 
+    return 1;
   }
-  else if (OTA_OP_CODE == OTA_APP_SWITCH_OP_CODE_GO_TO_HIGHER_APP) // Higher Application OTA done with success  
+  if (link->imageBase == APP_HIGHER_ADDRESS) // Higher Application OTA done with success  
   {
     /* Set valid tag x higher application (the new application just successfully upgraded through OTA) */
     OTA_Set_Application_Tag_Value(APP_HIGHER_ADDRESS, OTA_VALID_TAG);
     
     /* Set invalid/old tag for old lower application */
     OTA_Set_Application_Tag_Value(APP_LOWER_ADDRESS, OTA_INVALID_OLD_TAG); 
+    return 1;
   }
-  else if (OTA_OP_CODE == OTA_APP_SWITCH_OP_CODE_GO_TO_NEW_APP) // OTA Service Manager has upgraded a new application with success  
-  {
-    /* Set valid tag x the new application just successfully upgraded through OTA */
-    OTA_Set_Application_Tag_Value(APP_WITH_OTA_SERVICE_ADDRESS, OTA_VALID_TAG);
-  }
+#endif
   
+  return 0;
 }
 
 
@@ -361,6 +684,53 @@ static ErrorStatus FLASH_Verify(uint32_t currentWriteAddress,uint32_t * pbuffer,
   }
 }
 
+/**
+ * @brief  Computes the CRC-32 (see OTA_CRC32_MODE_FLAG) of a buffer with the CRC MANAGER.
+ * @param  crc: CRC-32 of the previous data, OTA_CRC32_INIT at the beginning
+ *         pdata: data address
+ *         length: data size in bytes
+ * @retval CRC-32 including the data
+ */
+static uint32_t OTA_Crc32(uint32_t crc, const uint8_t *pdata, uint32_t length)
+{
+#ifndef OTA_SW_CRC32
+  return CRCMGR_Crc32(crc, pdata, length);
+#else
+  return CRCMGR_Crc32Sw(crc, pdata, length);
+#endif
+}
+
+/**
+ * @brief  Computes the CRC-32 of the new image programmed on flash: the OTA
+ *         validity tag location is replaced by the value received from the OTA client.
+ * @param  link: OTA session
+ *         crc: CRC-32 of the image bytes before start (OTA_CRC32_INIT if start is 0)
+ *         start, end: image bytes [start, end) to be processed
+ * @retval CRC-32 of the image bytes up to end
+ */
+static uint32_t OTA_Image_Crc32(OTA_Link_t *link, uint32_t crc, uint32_t start, uint32_t end)
+{
+  const uint32_t tag_start = OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET;
+  const uint32_t tag_end = OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4;
+  
+  if (start < tag_start)
+  {
+    crc = OTA_Crc32(crc, (const uint8_t *)(link->imageBase + start), MIN(end, tag_start) - start);
+    start = MIN(end, tag_start);
+  }
+  if ((start < end) && (start < tag_end))
+  {
+    crc = OTA_Crc32(crc, (const uint8_t *)&link->imageTagWord + (start - tag_start), MIN(end, tag_end) - start);
+    start = MIN(end, tag_end);
+  }
+  if (start < end)
+  {
+    crc = OTA_Crc32(crc, (const uint8_t *)(link->imageBase + start), end - start);
+  }
+  
+  return crc;
+}
+
 /**
  * @brief  Init OTA
  * @param  None.
@@ -370,7 +740,25 @@ static ErrorStatus FLASH_Verify(uint32_t currentWriteAddress,uint32_t * pbuffer,
  */
 static void OTA_Init(void)
 {
+  uint8_t i;
+  
   BSP_LED_Init(OTA_LED); //bootloader is ongoing led
+  
+  ota_allow_jump = 0;
+  bootloadingCompleted_end = 0;
+  for (i = 0; i < OTA_MAX_LINKS; i++)
+  {
+    ota_link[i].conn_handle = OTA_INVALID_CONN_HANDLE;
+  }
+  for (i = 0; i < OTA_MAX_CONNECTIONS; i++)
+  {
+    ota_conn_params[i].conn_handle = OTA_INVALID_CONN_HANDLE;
+  }
+  
+  memset(ota_checkpoint, 0, sizeof(ota_checkpoint));
+#ifdef OTA_CHECKPOINT_PAGE_ADDRESS
+  OTA_Load_Checkpoints();
+#endif
 }
 
 /**
@@ -416,148 +804,888 @@ tBleStatus OTA_Add_Btl_Service(void)
 } /* end OTA_Add_Btl_Service() */
 
 
-static void OTA_Check_Update_Error_Condition(uint8_t notification_range)
+/* Max notification window (packets) fitting the image buffer with the ATT_MTU agreed with the OTA client */
+static uint8_t OTA_Max_Window(OTA_Link_t *link)
+{
+  uint16_t max_window = BUF_SIZE / DATA_PACKET_SIZE(link->ota_att_mtu_size);
+  
+  return (max_window > MAX_NOTIFICATION_WINDOW) ? MAX_NOTIFICATION_WINDOW : (uint8_t)max_window;
+}
+
+/* It sets the adaptive notification window, within the limits allowed by the ATT_MTU and the image buffer */
+static void OTA_Set_Window(OTA_Link_t *link, uint16_t window)
+{
+  uint8_t max_window = OTA_Max_Window(link);
+  
+  if (window > max_window)
+    window = max_window;
+  if (window < MIN_NOTIFICATION_WINDOW)
+    window = MIN_NOTIFICATION_WINDOW;
+  link->notification_range = (uint8_t)window;
+  link->notification.window = window;
+}
+
+/* It updates the adaptive notification window according to the outcome of the window being notified. Packet losses
+   (checksum and sequence number errors) cost the retransmission of the whole window, a clean link the wait for one
+   notification per window: the window is halved on each loss, otherwise it is doubled up to windowThreshold (the half of
+   the window of the last loss) and then it grows by one packet. Flash errors do not depend on the link. */
+static void OTA_Update_Window(OTA_Link_t *link)
+{
+  if (!link->adaptive_window)
+    return;
+  
+  if (link->notification.errCode == OTA_SUCCESS)
+  {
+    if (link->notification_range < link->windowThreshold)
+      OTA_Set_Window(link, 2 * link->notification_range);
+    else
+      OTA_Set_Window(link, link->notification_range + 1);
+  }
+  else if ((link->notification.errCode == OTA_CHECKSUM_ERROR) || (link->notification.errCode == OTA_SEQUENCE_ERROR))
+  {
+    OTA_Set_Window(link, link->notification_range / 2);
+    link->windowThreshold = link->notification_range;
+  }
+}
+
+/* Sequence number of the last packet of the window starting with startSeqNum */
+static uint16_t OTA_Window_End(OTA_Link_t *link, uint16_t startSeqNum)
+{
+  uint16_t lastSeqNum = (link->streamSize - 1) / DATA_PACKET_SIZE(link->ota_att_mtu_size);
+  uint16_t endSeqNum = startSeqNum + link->notification_range - 1;
+  
+  return (endSeqNum < lastSeqNum) ? endSeqNum : lastSeqNum;
+}
+
+static void OTA_Check_Update_Error_Condition(OTA_Link_t *link)
 {
   tBleStatus ret;
   
   /* Check if the notification reporting the error condition can be sent  
      (notification are sent inline with the expected notification window) */
-  if (((write_counter+1) % notification_range) == 0) 
+  if (link->write_counter >= link->errorWindowEnd) 
   {              
-     //ret = aci_gatt_update_char_value_ext(conn_handle, btlExpectedImageTUSeqNumberCharHandle, 1,4, 0, 4,(uint8_t*)&notification);
-     ret = aci_gatt_srv_notify(conn_handle, btlExpectedImageTUSeqNumberCharHandle + 1, 0, 4, (uint8_t *)&notification); 
+     OTA_Update_Window(link);
+     //ret = aci_gatt_update_char_value_ext(link->conn_handle, btlExpectedImageTUSeqNumberCharHandle, 1,4, 0, 4,(uint8_t*)&link->notification);
+     ret = aci_gatt_srv_notify(link->conn_handle, btlExpectedImageTUSeqNumberCharHandle + 1, 0, OTA_NOTIFICATION_LENGTH(link), (uint8_t *)&link->notification); 
      if (ret != BLE_STATUS_SUCCESS)
        PRINTF("Error while updating  characteristic.\n");
     
-     detected_error = 0;
-     write_counter = 0; 
+     link->detected_error = 0;
+     link->write_counter = 0; 
   } 
 }
 
-static void OTA_Set_Error_Flags(uint8_t error_condition, uint16_t expectedSeqNum)
+static void OTA_Set_Error_Flags(OTA_Link_t *link, uint8_t error_condition, uint16_t expectedSeqNum)
 {
   /* Set error flag */
-   detected_error = 1;
+   link->detected_error = 1;
    
    /* Set checksum error with expected sequence number */
-   notification.errCode = error_condition;
-   notification.replyCounter = expectedSeqNum;
+   link->notification.errCode = error_condition;
+   link->notification.replyCounter = expectedSeqNum;
+}
+
+/**
+ * @brief  It checks whether a flash page is blank.
+ * @param  address: page start address
+ * @retval 1 if all the page words are erased; 0 otherwise
+ */
+static uint8_t OTA_Page_Is_Blank(uint32_t address)
+{
+  uint32_t *pword = (uint32_t *)address;
+  uint16_t i;
+  
+  for (i = 0; i < (FLASH_PAGE_SIZE / 4); i++)
+  {
+    if (pword[i] != 0xFFFFFFFF)
+      return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief  It makes the next image page (at erasedAddress) ready for programming:
+ *         the page is erased only if it is not already blank.
+ * @param  link: OTA session
+ *         erase_allowed: 0 if there is no time for a page erase
+ * @retval SUCCESS if the page is blank; ERROR if it still has to be erased.
+ */
+static ErrorStatus OTA_Erase_Next_Page(OTA_Link_t *link, uint8_t erase_allowed)
+{
+  if (!OTA_Page_Is_Blank(link->erasedAddress))
+  {
+    /* Never erase outside of the free flash range reported to the OTA client */
+    if ((!erase_allowed) ||
+        (link->erasedAddress < __REV(OTA_FREE_SPACE_RANGE_START)) ||
+        ((link->erasedAddress + FLASH_PAGE_SIZE - 1) > __REV(OTA_FREE_SPACE_RANGE_END)))
+    {
+      return (ErrorStatus) (ERROR);
+    }
+    LL_FLASH_Erase(FLASH, LL_FLASH_TYPE_ERASE_PAGES, (link->erasedAddress - _MEMORY_FLASH_BEGIN_) / FLASH_PAGE_SIZE, 1);
+  }
+  link->erasedAddress += FLASH_PAGE_SIZE;
+  
+  return (ErrorStatus) (SUCCESS);
+}
+
+/* It restarts the image transfer from the first packet */
+static void OTA_Reset_Image_Transfer(OTA_Link_t *link)
+{
+  link->currentWriteAddress = link->imageBase;
+  link->bufPointer = 0;
+  link->totalBytesReceived = 0;
+  link->totalBytesWritten = 0;
+  link->expectedSeqNum = 0;
+  link->windowStartSeqNum = 0;
+  memset(link->imageWindow, 0, sizeof(link->imageWindow));
+  link->rxBuffer = 0;
+  link->writeBuffer = 0;
+  link->imageTagWord = OTA_IN_PROGRESS_TAG;
+  link->writtenCrc = OTA_CRC32_INIT;
+#ifdef OTA_ENCODED_IMAGE
+  memset(&link->decoder, 0, sizeof(link->decoder));
+#endif
+  /* Pages are checked (and erased if needed) ahead of the flash write, starting from the page holding imageBase */
+  link->erasedAddress = link->imageBase - ((link->imageBase - _MEMORY_FLASH_BEGIN_) % FLASH_PAGE_SIZE);
+}
+
+#ifdef OTA_CHECKPOINT_PAGE_ADDRESS
+static uint32_t OTA_Checkpoint_Check(const OTA_Checkpoint_Record_t *record)
+{
+  return ~(record->magic ^ record->imageBase ^ record->imageSize ^ record->imageCrc ^ record->writtenLength ^
+           record->writtenCrc ^ record->imageTagWord);
+}
+
+/* It programs the checkpoint of an OTA session context on the first blank record of the checkpoint page */
+static void OTA_Program_Checkpoint(uint8_t index)
+{
+  OTA_Checkpoint_t *checkpoint = &ota_checkpoint[index];
+  OTA_Checkpoint_Record_t record;
+  uint32_t address = OTA_CHECKPOINT_PAGE_ADDRESS + ota_checkpoint_next_record * sizeof(OTA_Checkpoint_Record_t);
+  
+  record.magic = OTA_CHECKPOINT_MAGIC + index;
+  record.imageBase = checkpoint->imageBase;
+  record.imageSize = checkpoint->imageSize;
+  record.imageCrc = checkpoint->imageCrc;
+  record.writtenLength = checkpoint->writtenLength;
+  record.writtenCrc = checkpoint->writtenCrc;
+  record.imageTagWord = checkpoint->imageTagWord;
+  record.check = OTA_Checkpoint_Check(&record);
+  
+  LL_FLASH_ProgramBurst(FLASH, address + 16, &record.imageCrc);
+  LL_FLASH_ProgramBurst(FLASH, address, &record.magic);
+  ota_checkpoint_next_record++;
+  ota_checkpoint_flash[index] = *checkpoint;
+}
+
+/* It erases the checkpoint page and it programs again the checkpoints of the transfers which can be resumed */
+static void OTA_Compact_Checkpoints(void)
+{
+  uint8_t i;
+  
+  LL_FLASH_Erase(FLASH, LL_FLASH_TYPE_ERASE_PAGES, (OTA_CHECKPOINT_PAGE_ADDRESS - _MEMORY_FLASH_BEGIN_) / FLASH_PAGE_SIZE, 1);
+  ota_checkpoint_next_record = 0;
+  memset(ota_checkpoint_flash, 0, sizeof(ota_checkpoint_flash));
+  for (i = 0; i < OTA_MAX_LINKS; i++)
+  {
+    if (ota_checkpoint[i].writtenLength != 0)
+      OTA_Program_Checkpoint(i);
+  }
+}
+
+/* It loads the last valid checkpoint of each OTA session context from the checkpoint page */
+static void OTA_Load_Checkpoints(void)
+{
+  const OTA_Checkpoint_Record_t *record = (const OTA_Checkpoint_Record_t *)OTA_CHECKPOINT_PAGE_ADDRESS;
+  const uint32_t *pword;
+  uint32_t index;
+  uint16_t i;
+  uint8_t j;
+  
+  for (i = 0; i < OTA_CHECKPOINT_RECORDS; i++, record++)
+  {
+    /* The records end at the first blank one */
+    pword = (const uint32_t *)record;
+    for (j = 0; (j < (sizeof(OTA_Checkpoint_Record_t) / 4)) && (pword[j] == 0xFFFFFFFF); j++);
+    if (j == (sizeof(OTA_Checkpoint_Record_t) / 4))
+      break;
+    
+    index = record->magic - OTA_CHECKPOINT_MAGIC;
+    if ((index < OTA_MAX_LINKS) && (record->check == OTA_Checkpoint_Check(record)))
+    {
+      ota_checkpoint[index].imageBase = record->imageBase;
+      ota_checkpoint[index].imageSize = record->imageSize;
+      ota_checkpoint[index].imageCrc = record->imageCrc;
+      ota_checkpoint[index].writtenLength = record->writtenLength;
+      ota_checkpoint[index].writtenCrc = record->writtenCrc;
+      ota_checkpoint[index].imageTagWord = record->imageTagWord;
+      ota_checkpoint_flash[index] = ota_checkpoint[index];
+    }
+  }
+  ota_checkpoint_next_record = i;
+}
+
+/* It makes room on the checkpoint page for the records of a new session (one for each image page), so that the page is not
+   erased during the transfer */
+static void OTA_Reserve_Checkpoints(OTA_Link_t *link)
+{
+  if ((ota_checkpoint_next_record + (PAGE_SIZE_ROUND(link->imageSize) / FLASH_PAGE_SIZE) + 1) > OTA_CHECKPOINT_RECORDS)
+    OTA_Compact_Checkpoints();
+}
+#endif
+
+/* It records the checkpoint of an OTA session context on the checkpoint page when the page to resume from changes, or when
+   the checkpoint gets shorter than the recorded one */
+static void OTA_Flash_Checkpoint(uint8_t index)
+{
+#ifdef OTA_CHECKPOINT_PAGE_ADDRESS
+  OTA_Checkpoint_t *checkpoint = &ota_checkpoint[index];
+  OTA_Checkpoint_t *recorded = &ota_checkpoint_flash[index];
+  
+  if ((checkpoint->writtenLength == 0) && (recorded->writtenLength == 0))
+    return;
+  if ((checkpoint->imageBase == recorded->imageBase) && (checkpoint->imageSize == recorded->imageSize) &&
+      (checkpoint->imageCrc == recorded->imageCrc) &&
+      (PAGE_SIZE_TRUNC(checkpoint->imageBase + checkpoint->writtenLength - _MEMORY_FLASH_BEGIN_) ==
+       PAGE_SIZE_TRUNC(recorded->imageBase + recorded->writtenLength - _MEMORY_FLASH_BEGIN_)) &&
+      (checkpoint->writtenLength >= recorded->writtenLength))
+    return;
+  
+  if (ota_checkpoint_next_record < OTA_CHECKPOINT_RECORDS)
+    OTA_Program_Checkpoint(index);
+  else
+    OTA_Compact_Checkpoints();
+#endif
+}
+
+/* It records the progress of the image transfer of a CRC-32 mode session in the checkpoint of its context */
+static void OTA_Save_Checkpoint(OTA_Link_t *link)
+{
+  OTA_Checkpoint_t *checkpoint = &ota_checkpoint[link - ota_link];
+  
+  if (!link->crc32_mode || link->encoded)
+    return;
+  
+  checkpoint->imageBase = link->imageBase;
+  checkpoint->imageSize = link->imageSize;
+  checkpoint->imageCrc = link->imageCrc;
+  checkpoint->writtenLength = link->totalBytesWritten;
+  checkpoint->writtenCrc = link->writtenCrc;
+  checkpoint->imageTagWord = link->imageTagWord;
+  OTA_Flash_Checkpoint(link - ota_link);
+}
+
+/* It resumes the image transfer from the checkpoint left by a previous session for the same image, if any.
+   The transfer resumes from the last page completely programmed, provided that the image programmed so far still
+   matches the checkpoint CRC-32: the page holding the end of the programmed image is erased again.
+   It returns 1 if the transfer is resumed: the checkpoint is then kept until the next window is programmed. */
+static uint8_t OTA_Resume_Image_Transfer(OTA_Link_t *link)
+{
+  OTA_Checkpoint_t *checkpoint = NULL;
+  uint32_t pageAddress, resumeLength, crc;
+  uint8_t i;
+  
+  for (i = 0; i < OTA_MAX_LINKS; i++)
+  {
+    if ((ota_checkpoint[i].writtenLength != 0) && (ota_checkpoint[i].imageBase == link->imageBase) &&
+        (ota_checkpoint[i].imageSize == link->imageSize) && (ota_checkpoint[i].imageCrc == link->imageCrc))
+    {
+      checkpoint = &ota_checkpoint[i];
+      break;
+    }
+  }
+  if (checkpoint == NULL)
+    return 0;
+  
+  pageAddress = PAGE_SIZE_TRUNC(link->imageBase + checkpoint->writtenLength - _MEMORY_FLASH_BEGIN_) + _MEMORY_FLASH_BEGIN_;
+  if (pageAddress <= link->imageBase)
+    return 0;
+  
+  /* The first packet to be sent again is the one holding the first byte of the page */
+  resumeLength = ((pageAddress - link->imageBase) / DATA_PACKET_SIZE(link->ota_att_mtu_size)) * DATA_PACKET_SIZE(link->ota_att_mtu_size);
+  
+  link->imageTagWord = checkpoint->imageTagWord;
+  crc = OTA_Image_Crc32(link, OTA_CRC32_INIT, 0, resumeLength);
+  if (OTA_Image_Crc32(link, crc, resumeLength, checkpoint->writtenLength) != checkpoint->writtenCrc)
+  {
+    /* The image has been modified on flash since the checkpoint: the transfer restarts from the first packet */
+    link->imageTagWord = OTA_IN_PROGRESS_TAG;
+    return 0;
+  }
+  
+  link->totalBytesReceived = resumeLength;
+  link->totalBytesWritten = resumeLength;
+  link->writtenCrc = crc;
+  link->currentWriteAddress = link->imageBase + resumeLength;
+  link->expectedSeqNum = resumeLength / DATA_PACKET_SIZE(link->ota_att_mtu_size);
+  link->windowStartSeqNum = link->expectedSeqNum;
+  /* Image bytes before pageAddress are kept on flash: the bytes sent again are not programmed twice */
+  link->erasedAddress = pageAddress;
+  /* The page holding the end of the programmed image is erased again: the checkpoint now ends at pageAddress */
+  checkpoint->writtenLength = pageAddress - link->imageBase;
+  checkpoint->writtenCrc = OTA_Image_Crc32(link, crc, resumeLength, checkpoint->writtenLength);
+  /* From now on the progress is recorded in the checkpoint of this session */
+  if (checkpoint != &ota_checkpoint[link - ota_link])
+  {
+    ota_checkpoint[link - ota_link] = *checkpoint;
+    checkpoint->writtenLength = 0;
+    OTA_Flash_Checkpoint(checkpoint - ota_checkpoint);
+  }
+  OTA_Flash_Checkpoint(link - ota_link);
+  
+  return 1;
 }
 
 /* it sends the ack to OTA client */ 
-void OTA_Send_Ack(void)
+void OTA_Send_Ack(OTA_Link_t *link)
 {
    tBleStatus ret;
+   uint8_t completed = (link->totalBytesWritten >= link->streamSize);
+   uint8_t decodingError = 0;
+   
+#ifdef OTA_ENCODED_IMAGE
+  /* The encoded image must decode exactly to the image size */
+  decodingError = link->encoded && (link->decoder.error || (link->decoder.outLength != link->imageSize));
+#endif
+  /* Check the CRC-32 of the whole image before declaring it valid */
+  if (completed && link->crc32_mode && (decodingError || (OTA_Image_Crc32(link, OTA_CRC32_INIT, 0, link->imageSize) != link->imageCrc)))
+  {
+  #ifdef ST_OTA_BTL_MINIMAL_ECHO
+    PRINTF("Image CRC-32 failure \r\n");
+  #endif
+    /* The whole image has to be sent again: its pages are erased ahead of the new flash write */
+    completed = 0;
+    OTA_Reset_Image_Transfer(link);
+    OTA_Save_Checkpoint(link);
+    link->notification.errCode = OTA_IMAGE_CRC_ERROR;
+    link->notification.replyCounter = 0;
+  }
    
   /* Depending on outcome of code section above send notification related to: 
   * next sequence number *OR* flash write failure *OR* verify failure 
   */
-  ret = aci_gatt_srv_notify(conn_handle, btlExpectedImageTUSeqNumberCharHandle + 1, 0, 4, (uint8_t *)&notification);  
+  OTA_Update_Window(link);
+  ret = aci_gatt_srv_notify(link->conn_handle, btlExpectedImageTUSeqNumberCharHandle + 1, 0, OTA_NOTIFICATION_LENGTH(link), (uint8_t *)&link->notification);  
   
   if (ret != BLE_STATUS_SUCCESS)
   {
     PRINTF("Error while updating btlExpectedImageTUSeqNumberCharHandle characteristic.\n");
   }
 
-  if (totalBytesWritten >= imageSize)
+  if (completed)
   { 
 
    /* light down led on the BlueNRG-LP platform to advertise beginning of OTA bootloading session */
    BSP_LED_Off(OTA_LED);
 
-   /* Set the validity tags for the new app and old one */
-   OTA_Set_Validity_Tags();
+   /* The transfer cannot be resumed anymore */
+   ota_checkpoint[link - ota_link].writtenLength = 0;
+   OTA_Flash_Checkpoint(link - ota_link);
+   
    /* set flag for ota fw upgrade process completed */
-   bootloadingCompleted = 1;
-   /* jump to new application is allowed */
-   ota_allow_jump = 1; 
+   link->completed = 1;
+   /* Set the validity tags for the new app and old one: jump to new application is allowed */
+   if (OTA_Set_Validity_Tags(link))
+   {
+     ota_allow_jump = 1; 
+   }
   }
 }/* end OTA_Send_Ack() */
 
 
-/* It writes the received data into OTA slave flash */
-void OTA_Write_Data(void)
+/* It hands over the received window to the flash write and switches the reception to the other buffer */
+static void OTA_Queue_Window(OTA_Link_t *link)
 {
-  uint8_t verifyStatus;
- 
-  uint16_t k;
-   
-  ota_write_data = 0; 
+  OTA_ImageWindow_t *window = &link->imageWindow[link->rxBuffer];
+  
+  window->address = link->imageBase + link->totalBytesReceived;
+  window->length = link->bufPointer;
+  window->startSeqNum = link->windowStartSeqNum;
+  window->ackSeqNum = link->expectedSeqNum;
+  
+  link->totalBytesReceived += link->bufPointer;
+  link->windowStartSeqNum = link->expectedSeqNum;
+  link->bufPointer = 0;
+  link->rxBuffer = (link->rxBuffer + 1) % OTA_IMAGE_BUFFERS;
   
-  /* store the potential last sequence number successfully written (if no flash write errors are detected) */
-  last_written_receivedSequence = receivedSeqNum; 
+  /* The window is acknowledged right away, so that the OTA client sends the next one while
+     this one is programmed, unless:
+     - the other buffer is still waiting to be programmed;
+     - it is the last window: its ack completes the OTA session. */
+  if ((link->imageWindow[link->rxBuffer].length == 0) && (link->totalBytesReceived < link->streamSize))
+  {
+    window->needsAck = 0;
+    OTA_Send_Ack(link);
+  }
+  else
+  {
+    window->needsAck = 1;
+  }
+}/* end OTA_Queue_Window() */
 
-  /* drop buffer into flash if it's the right time */
-  currentWriteAddress = imageBase + totalBytesWritten;
-  k=0;
 
-  verifyStatus = SUCCESS;
-  while (k<bufPointer)
+/* It drops the received windows starting from the one failing the flash write: the OTA client
+   is asked to send again the image from the first packet of this window */
+static void OTA_Write_Data_Failure(OTA_Link_t *link, OTA_ImageWindow_t *window)
+{
+  uint8_t client_waiting = window->needsAck || link->imageWindow[(link->writeBuffer + 1) % OTA_IMAGE_BUFFERS].needsAck;
+  uint16_t lastReceivedSeqNum = link->expectedSeqNum - 1;
+  uint16_t windowEnd = OTA_Window_End(link, link->windowStartSeqNum);
+  uint8_t i;
+  
+  link->totalBytesReceived = window->address - link->imageBase;
+  link->expectedSeqNum = window->startSeqNum;
+  link->windowStartSeqNum = window->startSeqNum;
+  link->bufPointer = 0;
+  for (i = 0; i < OTA_IMAGE_BUFFERS; i++)
+  {
+    link->imageWindow[i].length = 0;
+    link->imageWindow[i].needsAck = 0;
+    link->imageWindow[i].programmed = 0;
+  }
+  link->rxBuffer = link->writeBuffer;
+#ifdef OTA_ENCODED_IMAGE
+  /* The window is decoded again from its beginning */
+  link->decoder = window->decoder;
+#endif
+  
+  if (client_waiting)
+  {
+    /* The OTA client is waiting for the ack of a window: notify the error now */
+    link->notification.errCode = OTA_FLASH_VERIFY_ERROR;
+    link->notification.replyCounter = link->expectedSeqNum;
+    OTA_Send_Ack(link);
+  }
+  else
   {
-    /* don't change the OTA validity tag value during OTA upgrade session: it stays to 0xFFFFFFFF */
-    if (currentWriteAddress != (imageBase + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET))
+    /* The OTA client is sending the next window: notify the error at the end of it */
+    if (!link->detected_error)
     {
-       uint8_t  byteIncrement = BYTE_INCREMENT; /* Flash Burst Write: 4 words (16 bytes) */
-        
-       if ((bufPointer - k) >= BYTE_INCREMENT)
-       {
-          LL_FLASH_ProgramBurst(FLASH, currentWriteAddress, (uint32_t *)(&imageBuffer[k]));
-          verifyStatus = FLASH_Verify(currentWriteAddress,(uint32_t *)(&imageBuffer[k]),BYTE_INCREMENT);
-       } 
-       else 
-       {
-         byteIncrement = 4; /* Flash Write: 1 word (4 bytes) */
-         
-         LL_FLASH_Program(FLASH, currentWriteAddress, (((uint32_t)imageBuffer[k+3]<< 24) + ((uint32_t)imageBuffer[k+2]<< 16) + ((uint32_t)imageBuffer[k+1]<< 8) + (uint32_t)imageBuffer[k]));
-         verifyStatus = FLASH_Verify(currentWriteAddress,(uint32_t *)(&imageBuffer[k]),byteIncrement);
-       }
-       
-       if (verifyStatus == SUCCESS)
-       {  
-          k+=byteIncrement;
-          currentWriteAddress += byteIncrement;
-       } 
-       else
-          break;
+      link->write_counter = lastReceivedSeqNum;
+      link->errorWindowEnd = windowEnd;
+    }
+    OTA_Set_Error_Flags(link, OTA_FLASH_VERIFY_ERROR, link->expectedSeqNum);
+  }
+}/* end OTA_Write_Data_Failure() */
+
+
+/* It programs BYTE_INCREMENT image bytes at a flash address multiple of BYTE_INCREMENT */
+static ErrorStatus OTA_Program_Block(OTA_Link_t *link, uint32_t address, uint8_t *data)
+{
+  ErrorStatus verifyStatus = SUCCESS;
+  uint8_t index;
+  
+  /* don't change the OTA validity tag value during OTA upgrade session: it stays to 0xFFFFFFFF */
+  if (address != (link->imageBase + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET))
+  {
+    /* Flash Burst Write: 4 words (16 bytes). Data already on flash (resumed transfer) are not programmed twice */
+    if (memcmp((const void *)address, data, BYTE_INCREMENT) != 0)
+      LL_FLASH_ProgramBurst(FLASH, address, (uint32_t *)data);
+    return (ErrorStatus) FLASH_Verify(address, (uint32_t *)data, BYTE_INCREMENT);
+  }
+  
+  /* keep the image value for the CRC-32 check */
+  memcpy(&link->imageTagWord, data, 4);
+  for (index = 4; index < BYTE_INCREMENT; index += 4) 
+  {
+    /* Flash Write: 1 word (4 bytes) */
+    if (memcmp((const void *)(address + index), &data[index], 4) != 0)
+      LL_FLASH_Program(FLASH, address + index, (((uint32_t)data[index+3]<< 24) + ((uint32_t)data[index+2]<< 16) + ((uint32_t)data[index+1]<< 8) + (uint32_t)data[index]));
+    if (FLASH_Verify(address + index, (uint32_t *)(&data[index]), 4) != SUCCESS)
+      verifyStatus = ERROR;
+  }
+  
+  return verifyStatus;
+}
+
+#ifdef OTA_ENCODED_IMAGE
+/* It returns the next source byte of the current copy */
+static uint8_t OTA_Decoder_Source(OTA_Link_t *link)
+{
+  OTA_Decoder_t *decoder = &link->decoder;
+  uint32_t offset = decoder->source;
+  uint32_t blockOffset = decoder->outLength - (decoder->outLength % BYTE_INCREMENT);
+  
+  if (decoder->token & OTA_TOKEN_BASE_COPY)
+  {
+    /* Base image address */
+    return *(const uint8_t *)offset;
+  }
+  if (offset >= blockOffset)
+  {
+    /* Decoded byte not yet programmed */
+    return ((uint8_t *)decoder->block)[offset - blockOffset];
+  }
+  if ((offset - OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET) < 4)
+  {
+    return ((uint8_t *)&link->imageTagWord)[offset - OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET];
+  }
+  return *(const uint8_t *)(link->imageBase + offset);
+}
+
+/* It starts the copy of the token just received: a copy not fitting the image or the base image is skipped, so that
+   the decoded image is found not valid at the end of the transfer */
+static void OTA_Decoder_Start_Copy(OTA_Link_t *link)
+{
+  OTA_Decoder_t *decoder = &link->decoder;
+  
+  decoder->state = OTA_DECODER_COPY;
+  if (decoder->token & OTA_TOKEN_BASE_COPY)
+  {
+#if defined(OTA_BASE_IMAGE_ADDRESS)
+    decoder->source = OTA_BASE_IMAGE_ADDRESS + decoder->arg;
+    if ((decoder->arg + decoder->count) > OTA_BASE_IMAGE_SIZE)
+#endif
+      decoder->error = 1;
+  }
+  else
+  {
+    decoder->source = decoder->outLength - decoder->arg;
+    if ((decoder->arg == 0) || (decoder->arg > decoder->outLength))
+      decoder->error = 1;
+  }
+  if (decoder->error)
+  {
+    decoder->state = OTA_DECODER_TOKEN;
+  }
+}
+
+/* It decodes the encoded image bytes of the window and programs the decoded image: it returns when the window
+   has been decoded or when max_length bytes have been programmed */
+static ErrorStatus OTA_Decode_Window(OTA_Link_t *link, OTA_ImageWindow_t *window, uint8_t *buffer, uint32_t max_length)
+{
+  OTA_Decoder_t *decoder = &link->decoder;
+  /* The padding of the last packet is not decoded */
+  uint32_t length = MIN(window->length, link->streamSize - (window->address - link->imageBase));
+  uint32_t programmed = 0;
+  uint32_t address;
+  uint8_t data;
+  
+  while (programmed < max_length)
+  {
+    if (decoder->state == OTA_DECODER_COPY)
+    {
+      data = OTA_Decoder_Source(link);
+      decoder->source++;
+      if (--decoder->count == 0)
+        decoder->state = OTA_DECODER_TOKEN;
     }
     else
     {
-      uint8_t  byteIncrement = 4; /* Flash Write: 1 word (4 bytes) */
+      if (window->programmed >= length)
+      {
+        window->programmed = window->length;
+        break;
+      }
+      data = buffer[window->programmed++];
       
-      currentWriteAddress += byteIncrement;
-      for (uint8_t index=k+4; index<k+BYTE_INCREMENT; index+=4) 
+      switch (decoder->state)
       {
-        LL_FLASH_Program(FLASH, currentWriteAddress, (((uint32_t)imageBuffer[index+3]<< 24) + ((uint32_t)imageBuffer[index+2]<< 16) + ((uint32_t)imageBuffer[index+1]<< 8) + (uint32_t)imageBuffer[index]));
-        verifyStatus = FLASH_Verify(currentWriteAddress,(uint32_t *)(&imageBuffer[index]),byteIncrement);
-        if (verifyStatus == SUCCESS)
+      case OTA_DECODER_TOKEN:
+        decoder->token = data;
+        decoder->arg = 0;
+        decoder->argBytes = 0;
+        if ((data & OTA_TOKEN_COPY) == 0)
+        {
+          decoder->count = (data & OTA_TOKEN_LITERAL_MASK) + 1;
+          decoder->state = OTA_DECODER_LITERAL;
+        }
+        else if ((data & OTA_TOKEN_LENGTH_MASK) == OTA_TOKEN_LENGTH_MASK)
         {
-          currentWriteAddress += byteIncrement;
+          decoder->count = OTA_TOKEN_LENGTH_MASK + OTA_TOKEN_MIN_COPY;
+          decoder->state = OTA_DECODER_LENGTH;
         }
+        else
+        {
+          decoder->count = (data & OTA_TOKEN_LENGTH_MASK) + OTA_TOKEN_MIN_COPY;
+          decoder->state = OTA_DECODER_ARG;
+        }
+        continue;
+      case OTA_DECODER_LENGTH:
+        decoder->count += (uint32_t)data << (8 * decoder->argBytes);
+        if (++decoder->argBytes == 2)
+        {
+          decoder->argBytes = 0;
+          decoder->state = OTA_DECODER_ARG;
+        }
+        continue;
+      case OTA_DECODER_ARG:
+        decoder->arg |= (uint32_t)data << (8 * decoder->argBytes);
+        if (++decoder->argBytes == ((decoder->token & OTA_TOKEN_BASE_COPY) ? 3 : 2))
+        {
+          OTA_Decoder_Start_Copy(link);
+        }
+        continue;
+      default: /* OTA_DECODER_LITERAL */
+        if (--decoder->count == 0)
+          decoder->state = OTA_DECODER_TOKEN;
+        break;
       }
-      k+= BYTE_INCREMENT; /* skip bytes write related to OTA validity tag */  
     }
-  }/* end while */
-  /* prepare notification data for next expected block if for both success or notify write/verify failure */
-  if (verifyStatus == SUCCESS) 
-  {
-    totalBytesWritten+=bufPointer;
-    notification.errCode = OTA_SUCCESS;
-    /* reser buffer pointer, everything was successfully written on flash */
-    bufPointer = 0; 
-  } 
-  else 
+    
+    if (decoder->outLength >= link->imageSize)
+    {
+      decoder->error = 1;
+      continue;
+    }
+    ((uint8_t *)decoder->block)[decoder->outLength % BYTE_INCREMENT] = data;
+    decoder->outLength++;
+    if ((decoder->outLength % BYTE_INCREMENT) == 0)
+    {
+      address = link->imageBase + decoder->outLength - BYTE_INCREMENT;
+      /* make sure the page is blank: this is normally already done by the erase ahead */
+      while (link->erasedAddress < (address + BYTE_INCREMENT))
+      {
+        if (OTA_Erase_Next_Page(link, 1) != SUCCESS)
+          break;
+      }
+      if (OTA_Program_Block(link, address, (uint8_t *)decoder->block) != SUCCESS)
+        return (ErrorStatus) (ERROR);
+      programmed += BYTE_INCREMENT;
+    }
+  }
+  
+  /* The last bytes of the image are programmed once the whole encoded image has been decoded */
+  if ((window->programmed >= window->length) && (decoder->state != OTA_DECODER_COPY) &&
+      ((window->address + window->length) >= (link->imageBase + link->streamSize)) && ((decoder->outLength % BYTE_INCREMENT) != 0))
+  {
+    address = link->imageBase + decoder->outLength - (decoder->outLength % BYTE_INCREMENT);
+    memset((uint8_t *)decoder->block + (decoder->outLength % BYTE_INCREMENT), 0xFF, BYTE_INCREMENT - (decoder->outLength % BYTE_INCREMENT));
+    while (link->erasedAddress < (address + BYTE_INCREMENT))
+    {
+      if (OTA_Erase_Next_Page(link, 1) != SUCCESS)
+        break;
+    }
+    return OTA_Program_Block(link, address, (uint8_t *)decoder->block);
+  }
+  
+  return (ErrorStatus) (SUCCESS);
+}
+#endif /* OTA_ENCODED_IMAGE */
+
+/* It writes the oldest received window into OTA slave flash: up to max_length bytes (multiple of BYTE_INCREMENT)
+   are programmed, the rest of the window is programmed on the next call */
+void OTA_Write_Data(OTA_Link_t *link, uint32_t max_length)
+{
+  OTA_ImageWindow_t *window = &link->imageWindow[link->writeBuffer];
+  uint8_t *buffer = link->imageBuffer[link->writeBuffer];
+  uint8_t verifyStatus;
+ 
+  uint32_t k, end;
+  
+#ifdef OTA_ENCODED_IMAGE
+  if (link->encoded)
+  {
+    /* window->programmed counts the encoded image bytes decoded */
+    if (window->programmed == 0)
+    {
+      /* decoder state for decoding the window again after a flash write failure */
+      window->decoder = link->decoder;
+    }
+    verifyStatus = OTA_Decode_Window(link, window, buffer, max_length);
+    k = window->programmed;
+    if ((verifyStatus == SUCCESS) && (link->decoder.state == OTA_DECODER_COPY))
+    {
+      /* the window is released at the end of the copy */
+      return;
+    }
+  }
+  else
+#endif
+  {
+    end = window->length;
+    if ((end - window->programmed) > max_length)
+      end = window->programmed + max_length;
+    
+    /* make sure the pages of the window are blank: this is normally already done by the erase ahead */
+    while (link->erasedAddress < (window->address + end))
+    {
+      if (OTA_Erase_Next_Page(link, 1) != SUCCESS)
+        break;
+    }
+
+    /* drop buffer into flash if it's the right time */
+    link->currentWriteAddress = window->address + window->programmed;
+    k=window->programmed;
+
+    verifyStatus = SUCCESS;
+    while (k<end)
+    {
+      uint8_t  byteIncrement = BYTE_INCREMENT; /* Flash Burst Write: 4 words (16 bytes) */
+      
+      if ((end - k) >= BYTE_INCREMENT)
+      {
+        verifyStatus = OTA_Program_Block(link, link->currentWriteAddress, &buffer[k]);
+      } 
+      else 
+      {
+        byteIncrement = 4; /* Flash Write: 1 word (4 bytes) */
+        
+        if (memcmp((const void *)link->currentWriteAddress, &buffer[k], byteIncrement) != 0)
+          LL_FLASH_Program(FLASH, link->currentWriteAddress, (((uint32_t)buffer[k+3]<< 24) + ((uint32_t)buffer[k+2]<< 16) + ((uint32_t)buffer[k+1]<< 8) + (uint32_t)buffer[k]));
+        verifyStatus = FLASH_Verify(link->currentWriteAddress,(uint32_t *)(&buffer[k]),byteIncrement);
+      }
+      
+      if (verifyStatus == SUCCESS)
+      {  
+        k+=byteIncrement;
+        link->currentWriteAddress += byteIncrement;
+      } 
+      else
+        break;
+    }/* end while */
+  }
+  
+  if (verifyStatus != SUCCESS) 
   {
   #ifdef ST_OTA_BTL_MINIMAL_ECHO
     PRINTF("Flash verify failure \r\n");
   #endif
-    notification.errCode = OTA_FLASH_VERIFY_ERROR;                
+    OTA_Write_Data_Failure(link, window);
+    return;
+  }
+  
+  window->programmed = (uint16_t)k;
+  if (window->programmed < window->length)
+    return;
+  
+  /* everything was successfully written on flash: release the buffer */
+  if (link->crc32_mode && !link->encoded)
+  {
+    link->writtenCrc = OTA_Crc32(link->writtenCrc, buffer, MIN(window->length, link->imageSize - (window->address - link->imageBase)));
+  }
+  link->totalBytesWritten += window->length;
+  OTA_Save_Checkpoint(link);
+  window->length = 0;
+  window->programmed = 0;
+  link->writeBuffer = (link->writeBuffer + 1) % OTA_IMAGE_BUFFERS;
+  
+  if (window->needsAck)
+  {
+    /* The ack has been held until the window was on flash */
+    window->needsAck = 0;
+    link->notification.replyCounter = window->ackSeqNum;
+    link->notification.errCode = OTA_SUCCESS;
+    OTA_Send_Ack(link);
+  }
+  else
+  {
+    /* The next window has been held because this buffer was busy: it can be acknowledged now,
+       unless it is the last one */
+    window = &link->imageWindow[link->writeBuffer];
+    if ((window->length != 0) && window->needsAck && ((window->address + window->length) < (link->imageBase + link->streamSize)))
+    {
+      window->needsAck = 0;
+      link->notification.replyCounter = window->ackSeqNum;
+      link->notification.errCode = OTA_SUCCESS;
+      OTA_Send_Ack(link);
+    }
   }
- 
-  OTA_Send_Ack();
   
 }/* end OTA_Write_Data() */
 
 
+/* It returns the ATT_MTU and data length record of a connection (NULL if none): if assign is set, a record
+   is assigned to a new connection, taking over the records in turn when all of them are used */
+static OTA_Conn_Params_t *OTA_Get_Conn_Params(uint16_t connection_handle, uint8_t assign)
+{
+  static uint8_t next_params = 0;
+  OTA_Conn_Params_t *params = NULL;
+  uint8_t i;
+  
+  for (i = 0; i < OTA_MAX_CONNECTIONS; i++)
+  {
+    if (ota_conn_params[i].conn_handle == connection_handle)
+      return &ota_conn_params[i];
+    if ((params == NULL) && (ota_conn_params[i].conn_handle == OTA_INVALID_CONN_HANDLE))
+      params = &ota_conn_params[i];
+  }
+  if (!assign)
+    return NULL;
+  if (params == NULL)
+  {
+    params = &ota_conn_params[next_params];
+    next_params = (next_params + 1) % OTA_MAX_CONNECTIONS;
+  }
+  params->conn_handle = connection_handle;
+  params->ota_att_mtu_size = OTA_ATT_MTU_SIZE_CONF;
+  params->client_DLE_ATT_MTU = 0;
+  
+  return params;
+}
+
+/* It initializes the OTA session context of a new connection */
+static void OTA_Link_Init(OTA_Link_t *link, uint16_t connection_handle)
+{
+  uint8_t (*buffer)[BUF_SIZE] = imageBuffer[link - ota_link];
+  
+  memset(link, 0, sizeof(OTA_Link_t));
+  link->conn_handle = connection_handle;
+  link->ota_att_mtu_size = OTA_ATT_MTU_SIZE_CONF;
+  link->imageinfo[0] = BLE_OTA_SERVER_VERSION;
+  link->notification_range = NOTIFICATION_WINDOW;
+  link->notification.window = NOTIFICATION_WINDOW;
+  link->windowCrc = OTA_CRC32_INIT;
+  link->imageTagWord = OTA_IN_PROGRESS_TAG;
+  link->imageBuffer = buffer;
+}
+
+/* It returns the OTA session context of a connection, NULL if the connection has not started an OTA session */
+static OTA_Link_t *OTA_Get_Link(uint16_t connection_handle)
+{
+  uint8_t i;
+  
+  for (i = 0; i < OTA_MAX_LINKS; i++)
+  {
+    if (ota_link[i].conn_handle == connection_handle)
+      return &ota_link[i];
+  }
+  return NULL;
+}
+
+/* It assigns an OTA session context to a connection starting a new OTA session: the context of the connection
+   is reused, else a free context is assigned. It returns NULL if no context is free */
+static OTA_Link_t *OTA_New_Link(uint16_t connection_handle)
+{
+  OTA_Link_t *link = OTA_Get_Link(connection_handle);
+  
+#if (OTA_MAX_LINKS == 1)
+  /* Single session: it always follows the last connection, also if the disconnection has not been reported */
+  link = &ota_link[0];
+#else
+  if (link == NULL)
+    link = OTA_Get_Link(OTA_INVALID_CONN_HANDLE);
+#endif
+  if (link != NULL)
+  {
+    OTA_Link_Init(link, connection_handle);
+  }
+  
+  return link;
+}
+
+/* It checks whether the flash pages of an image are used by the image of another OTA session */
+static uint8_t OTA_Image_Overlaps(OTA_Link_t *link)
+{
+  uint32_t start = PAGE_SIZE_TRUNC(link->imageBase - _MEMORY_FLASH_BEGIN_);
+  uint32_t end = PAGE_SIZE_ROUND(link->imageBase + link->imageSize - _MEMORY_FLASH_BEGIN_);
+  uint8_t i;
+  
+  for (i = 0; i < OTA_MAX_LINKS; i++)
+  {
+    OTA_Link_t *other = &ota_link[i];
+    
+    if ((other != link) && (other->conn_handle != OTA_INVALID_CONN_HANDLE) && (other->imageSize != 0) &&
+        (start < PAGE_SIZE_ROUND(other->imageBase + other->imageSize - _MEMORY_FLASH_BEGIN_)) &&
+        (PAGE_SIZE_TRUNC(other->imageBase - _MEMORY_FLASH_BEGIN_) < end))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 /** 
  * @brief This function handles the OTA bootloader updgrade. 
  * It is called on the aci_gatt_srv_attribute_modified_event() callback context for handling the
@@ -579,8 +1707,15 @@ void OTA_Write_Request_CB(uint16_t connection_handle,
 {
     tBleStatus ret;
     uint16_t k;
+    OTA_Conn_Params_t *params;
+    /* The OTA session of a connection is started by the New Image characteristic write */
+    OTA_Link_t *link = (attr_handle == (btlNewImageCharHandle + 1)) ? OTA_New_Link(connection_handle) : OTA_Get_Link(connection_handle);
     
-    conn_handle = connection_handle;
+    if (link == NULL)
+    {
+      PRINTF("No OTA session for connection 0x%04X\r\n", connection_handle);
+      return;
+    }
     
     if (attr_handle == (btlNewImageCharHandle + 1)){
       
@@ -590,18 +1725,52 @@ void OTA_Write_Request_CB(uint16_t connection_handle,
        * of the firmware image it intends to send. 
        * Get base_address and image size + notification range requested from client.
        */
-      imageSize = (uint32_t)(att_data[4] << 24) + (uint32_t)(att_data[3] << 16) + (uint32_t)(att_data[2] << 8) + att_data[1];
-      imageBase = (uint32_t)(att_data[8] << 24) + (uint32_t)(att_data[7] << 16) + (uint32_t)(att_data[6] << 8) + att_data[5];
-      memcpy(&imageinfo[0], &att_data[0], 9); 
+      link->imageSize = (uint32_t)(att_data[4] << 24) + (uint32_t)(att_data[3] << 16) + (uint32_t)(att_data[2] << 8) + att_data[1];
+      link->imageBase = (uint32_t)(att_data[8] << 24) + (uint32_t)(att_data[7] << 16) + (uint32_t)(att_data[6] << 8) + att_data[5];
+      memcpy(&link->imageinfo[0], &att_data[0], 9); 
       
-      notification_range = NOTIFICATION_INTERVAL(att_data[0]); 
+      link->notification_range = NOTIFICATION_INTERVAL(att_data[0] & (~OTA_MODE_FLAGS)); 
+      link->adaptive_window = ((att_data[0] & OTA_ADAPTIVE_WINDOW_FLAG) != 0);
+      link->resume = ((att_data[0] & OTA_RESUME_FLAG) != 0);
+#ifndef OTA_CHECKPOINT_PAGE_ADDRESS
+      /* The checkpoints would not survive a reset */
+      link->resume = 0;
+#endif
 
-      currentWriteAddress = imageBase;
-      bufPointer = 0;
-      totalBytesWritten = 0;
-      expectedSeqNum = 0;
+      /* CRC-32 integrity check requested by the OTA client: the image CRC-32 follows the image base */
+      link->crc32_mode = ((att_data[0] & OTA_CRC32_MODE_FLAG) != 0) && (data_length >= 13);
+      if (link->crc32_mode)
+      {
+        link->imageCrc = (uint32_t)(att_data[12] << 24) + (uint32_t)(att_data[11] << 16) + (uint32_t)(att_data[10] << 8) + att_data[9];
+        LL_AHB_EnableClock(LL_AHB_PERIPH_CRC);
+      }
+      
+      /* Encoded image: its length follows the image CRC-32 */
+      link->encoded = ((att_data[0] & OTA_ENCODED_IMAGE_FLAG) != 0);
+      link->streamSize = link->imageSize;
+#ifdef OTA_ENCODED_IMAGE
+      if (link->encoded && link->crc32_mode && (data_length >= 17))
+      {
+        link->streamSize = (uint32_t)(att_data[16] << 24) + (uint32_t)(att_data[15] << 16) + (uint32_t)(att_data[14] << 8) + att_data[13];
+        link->resume = 0;
+      }
+      else
+#endif
+      if (link->encoded)
+      {
+        /* Encoded images not supported: the session is refused */
+        link->imageSize = 0;
+      }
+      
+      OTA_Reset_Image_Transfer(link);
+      
+      /* Flash pages cannot be shared with the image of another session: the session is refused */
+      if (OTA_Image_Overlaps(link))
+      {
+        link->imageSize = 0;
+      }
 #ifdef ST_OTA_BTL_MINIMAL_ECHO
-      PRINTF("Free Image base = 0x%08X ; Image size = 0x%08X, numPages = %d\r\n",(unsigned int)imageBase,(unsigned int)imageSize,imageSize/PAGE_SIZE+1);
+      PRINTF("Free Image base = 0x%08X ; Image size = 0x%08X, numPages = %d\r\n",(unsigned int)link->imageBase,(unsigned int)link->imageSize,link->imageSize/PAGE_SIZE+1);
 #endif  
       
       
@@ -619,11 +1788,45 @@ void OTA_Write_Request_CB(uint16_t connection_handle,
       * At this point it performs required pages erase according to the previously provided image 
       * size and provide notification
       */
-      expectedSeqNum = 0;
+      link->expectedSeqNum = 0;
+
+      params = OTA_Get_Conn_Params(connection_handle, 0);
+      if (params != NULL)
+      {
+        link->ota_att_mtu_size = params->ota_att_mtu_size;
+      }
+      if ((params == NULL) || (params->client_DLE_ATT_MTU != DLE_ATT_MTU_DONE)) 
+      {
+        /* OTA Client doesn't perform both DLE and ATT_MTU: use DEFAULT_ATT_MTU for OTA transfer */
+        link->ota_att_mtu_size = BLE_STACK_DEFAULT_ATT_MTU; 
+      }
+      
+      if (link->adaptive_window)
+      {
+        /* The first window is the default one: it is then adapted to the link quality */
+        OTA_Set_Window(link, NOTIFICATION_WINDOW);
+        link->windowThreshold = OTA_Max_Window(link);
+      }
+      /* The window has to fit the image buffer with the agreed ATT_MTU */
+      if (BUFPOINTER_LIMIT(link) > BUF_SIZE)
+      {
+        link->imageSize = 0;
+      }
 
-      notification.replyCounter = 0;
-      notification.errCode = 0; 
-      ret = aci_gatt_srv_notify(conn_handle, btlExpectedImageTUSeqNumberCharHandle + 1, 0, 4, (uint8_t *)&notification);
+#ifdef OTA_CHECKPOINT_PAGE_ADDRESS
+      if (link->crc32_mode && !link->encoded)
+      {
+        OTA_Reserve_Checkpoints(link);
+      }
+#endif
+      if (!link->resume || !link->crc32_mode || (link->imageSize == 0) || !OTA_Resume_Image_Transfer(link))
+      {
+        OTA_Save_Checkpoint(link);
+      }
+
+      link->notification.replyCounter = link->expectedSeqNum;
+      link->notification.errCode = (link->imageSize != 0) ? OTA_SUCCESS : OTA_FLASH_WRITE_ERROR; 
+      ret = aci_gatt_srv_notify(link->conn_handle, btlExpectedImageTUSeqNumberCharHandle + 1, 0, OTA_NOTIFICATION_LENGTH(link), (uint8_t *)&link->notification);
       if (ret != BLE_STATUS_SUCCESS) 
       {
         PRINTF("Error while updating btlExpectedImageTUSeqNumberCharHandle characteristic.\n");
@@ -636,76 +1839,83 @@ void OTA_Write_Request_CB(uint16_t connection_handle,
         /* warn beginning of bootloading session through gloabal variable */
         //bootloadingOngoing = 1;
       }
-      
-      if (client_DLE_ATT_MTU != DLE_ATT_MTU_DONE) 
-      {
-        /* OTA Client doesn't perform both DLE and ATT_MTU: use DEFAULT_ATT_MTU for OTA transfer */
-        ota_att_mtu_size = BLE_STACK_DEFAULT_ATT_MTU; 
-      }
-      
    }
     else if (attr_handle == (btlNewImageTUContentCharHandle + 1))
     {
        /* Check if a checksum or sequence number error has been detected */
-       if (detected_error) 
+       if (link->detected_error) 
        {
          /* An error has been detected: just count the coming next write until the end of current
             notification window: all the writes on this window must be repeated */
-         write_counter += 1; 
+         link->write_counter += 1; 
          /* When the next expected notification from OTA client must be sent sent (inline with notification window),
             the detected error code is notified with the sequence number to be used for retrying again all the writes of this block */
-         OTA_Check_Update_Error_Condition(notification_range);
+         OTA_Check_Update_Error_Condition(link);
        }
        /* Here we read updated characteristic content filled by "write with no response command' coming from the master */
-       else if (bufPointer < BUFPOINTER_LIMIT(ota_att_mtu_size)){
+       else if ((link->imageSize != 0) && (link->bufPointer < BUFPOINTER_LIMIT(link)) && (link->imageWindow[link->rxBuffer].length == 0)){
          //else if (bufPointer < bufPointer_limit){
           /* Data will be received by the OTA slave 16 byte wise (due to characteristic image content = 16 bytes image + 4 of headers)
            * Drop new image data into buffer
            */
-          memcpy(&imageData[0], &att_data[0], IMAGE_CONTENT_SIZE);
-          for(k=bufPointer; k<(bufPointer + data_length - 4); k++){ // Store 16 bytes of received notification on imageBuffer 
-             if (k<imageSize)
-               imageBuffer[k] = att_data[(k - bufPointer) + 1];
-             else
-               /* zero pad unutilized residual*/
-               imageBuffer[k] = 0;
- 
-             checksum ^= imageBuffer[k];
+          memcpy(&link->imageData[0], &att_data[0], IMAGE_CONTENT_SIZE);
+          if (link->crc32_mode)
+          {
+             /* CRC-32 of the window data received so far: the packet carries the byte selected by its sequence number */
+             if (link->bufPointer == 0)
+               link->windowCrc = OTA_CRC32_INIT;
+             k = link->bufPointer + data_length - 4;
+             memcpy(&link->imageBuffer[link->rxBuffer][link->bufPointer], &att_data[1], data_length - 4);
+             link->windowCrc = OTA_Crc32(link->windowCrc, &link->imageBuffer[link->rxBuffer][link->bufPointer], data_length - 4);
+             link->checksum = (uint8_t)(link->windowCrc >> (8 * (att_data[data_length - 2] % 4)));
+          }
+          else
+          {
+            for(k=link->bufPointer; k<(link->bufPointer + data_length - 4); k++){ // Store 16 bytes of received notification on imageBuffer 
+               if (k<link->streamSize)
+                 link->imageBuffer[link->rxBuffer][k] = att_data[(k - link->bufPointer) + 1];
+               else
+                 /* zero pad unutilized residual*/
+                 link->imageBuffer[link->rxBuffer][k] = 0;
+   
+               link->checksum ^= link->imageBuffer[link->rxBuffer][k];
+            }
           }
           /* include header data into checksum processing as well */
-          checksum ^= (att_data[data_length - 3] ^ att_data[data_length - 2] ^ att_data[data_length - 1]);          
-          bufPointer = k;
+          link->checksum ^= (att_data[data_length - 3] ^ att_data[data_length - 2] ^ att_data[data_length - 1]);          
+          link->bufPointer = k;
           /* In the section of code below: notify for received packet integrity (cheksum), sequence number correctness
            * and eventually write flash (which will get notified as well)
           */
           
           /* check checksum */ 
-          if (checksum == att_data[0]){
+          if (link->checksum == att_data[0]){
              /* checksum ok */      
              /* sequence number check */
-             receivedSeqNum = ((att_data[DATA_PACKET_SIZE(ota_att_mtu_size) +3]<<8) + att_data[DATA_PACKET_SIZE(ota_att_mtu_size) +2]);
+             link->receivedSeqNum = ((att_data[DATA_PACKET_SIZE(link->ota_att_mtu_size) +3]<<8) + att_data[DATA_PACKET_SIZE(link->ota_att_mtu_size) +2]);
             
-             if (expectedSeqNum == receivedSeqNum) 
+             if (link->expectedSeqNum == link->receivedSeqNum) 
              { 
                /* sequence number check ok, increment expected sequence number and prepare for next block notification */
-               expectedSeqNum++;
+               link->expectedSeqNum++;
               
-               if ((att_data[DATA_PACKET_SIZE(ota_att_mtu_size) +1] == 1) || (((receivedSeqNum+1)*DATA_PACKET_SIZE(ota_att_mtu_size)) >= imageSize)) //TBR ((receivedSeqNum+1) % notification_range) or (att_data[NEEDS_ACK_INDEX] == 1)
+               if ((att_data[DATA_PACKET_SIZE(link->ota_att_mtu_size) +1] == 1) || (((link->receivedSeqNum+1)*DATA_PACKET_SIZE(link->ota_att_mtu_size)) >= link->streamSize)) //TBR ((receivedSeqNum+1) % notification_range) or (att_data[NEEDS_ACK_INDEX] == 1)
                { 
                  /* Here is where we manage notifications related to correct sequence number and write/verify
                   * results if conditions get us through the next nested 'if' section (FLASH write section)
                   */
                  /* replyCounter defaults to expectedSeqNum unless flash write fails */
-                 notification.replyCounter = expectedSeqNum;
-                 notification.errCode = 0x0000;
+                 link->notification.replyCounter = link->expectedSeqNum;
+                 link->notification.errCode = 0x0000;
                 
-                 if (((bufPointer % BUFPOINTER_LIMIT(ota_att_mtu_size)) == 0) || (((imageSize - totalBytesWritten) < BUFPOINTER_LIMIT(ota_att_mtu_size))&& (bufPointer >= (imageSize - totalBytesWritten))))
+                 if (((link->bufPointer % BUFPOINTER_LIMIT(link)) == 0) || (((link->streamSize - link->totalBytesReceived) < BUFPOINTER_LIMIT(link))&& (link->bufPointer >= (link->streamSize - link->totalBytesReceived))))
                  {
-                    ota_write_data = 1;  
+                    /* Window completed: it is programmed on flash while the next one is received */
+                    OTA_Queue_Window(link);
                     
 #ifdef OTA_DIRECT_WRITE 
                    /* Perform Flash write */
-                   OTA_Write_Data();            
+                   OTA_Write_Data(link, BUF_SIZE);            
 #endif 
                  }/* end of BUF write management section*/              
 
@@ -714,48 +1924,50 @@ void OTA_Write_Request_CB(uint16_t connection_handle,
              else 
              { 
                 /* notify sequence number failure */
-                write_counter = expectedSeqNum;
+                link->write_counter = link->expectedSeqNum;
+                link->errorWindowEnd = OTA_Window_End(link, link->windowStartSeqNum);
                 
                 /* set new expected sequence number */
-                expectedSeqNum = (last_written_receivedSequence == 0) ? last_written_receivedSequence: (last_written_receivedSequence+1); 
+                link->expectedSeqNum = link->windowStartSeqNum; 
                  
                 /* Set error flags for sequence number error */
-                OTA_Set_Error_Flags(OTA_SEQUENCE_ERROR,expectedSeqNum); 
+                OTA_Set_Error_Flags(link, OTA_SEQUENCE_ERROR,link->expectedSeqNum); 
                  
                 /* null packet due to seq failure: remove from internal buffer through buffer pointer shift */
-                bufPointer = 0;
+                link->bufPointer = 0;
 #ifdef ST_OTA_BTL_MINIMAL_ECHO
-                PRINTF("Sequence number check failed, expected frame # 0x%02X but 0x%02X was received \r\n", expectedSeqNum,receivedSeqNum);      
+                PRINTF("Sequence number check failed, expected frame # 0x%02X but 0x%02X was received \r\n", link->expectedSeqNum,link->receivedSeqNum);      
 #endif
                 /* An error has been detected just on last write of current notification window: the detected error code can be notified now
                    since OTA client is ready to get the expected notification.
                    Notification is done with the sequence number to be used for retrying again all the writes of this block */
-                OTA_Check_Update_Error_Condition(notification_range);
+                OTA_Check_Update_Error_Condition(link);
              }            
           } /* if check sum */
           else 
           { 
              /* notify checksum failure */
-             write_counter = expectedSeqNum;
+             link->write_counter = link->expectedSeqNum;
+             link->errorWindowEnd = OTA_Window_End(link, link->windowStartSeqNum);
             
              /* set new expected sequence number */
-             expectedSeqNum = (last_written_receivedSequence == 0) ? last_written_receivedSequence: (last_written_receivedSequence+1); 
+             link->expectedSeqNum = link->windowStartSeqNum; 
              
              /* Set error flags for checksum error*/
-             OTA_Set_Error_Flags(OTA_CHECKSUM_ERROR,expectedSeqNum); 
+             OTA_Set_Error_Flags(link, OTA_CHECKSUM_ERROR,link->expectedSeqNum); 
 
              /* null packet due to seq failure: remove from internal buffer through buffer pointer shift */
-             bufPointer = 0; 
+             link->bufPointer = 0; 
             
 #ifdef ST_OTA_BTL_MINIMAL_ECHO
-             PRINTF("CheckSum error on expected frame # 0x%02X\r\n", expectedSeqNum);            
+             PRINTF("CheckSum error on expected frame # 0x%02X\r\n", link->expectedSeqNum);            
 #endif
              /* An error has been detected just on last write of current notification window: the detected error code can be notified now
                 since OTA client is ready to get the expected notification.
                 Notification is done with the sequence number to be used for retrying again all the writes of this block */
-             OTA_Check_Update_Error_Condition(notification_range);
+             OTA_Check_Update_Error_Condition(link);
           }
-          checksum = 0;
+          link->checksum = 0;
        }
     }
 }/* end OTA_Write_Request_CB() */
@@ -770,14 +1982,47 @@ void OTA_Write_Request_CB(uint16_t connection_handle,
  */
 void OTA_Radio_Activity(uint32_t Next_State_SysTime)
 {
-  /* Check if data for flash write are ready: do write only if there is enough time before next radio activity */
-  if (ota_write_data) 
+  static uint8_t next_link = 0;
+  OTA_Link_t *link;
+  uint32_t eraseEnd;
+  uint8_t i;
+  
+  /* Sessions are served in turn, starting from the one after the last served */
+  for (i = 0; i < OTA_MAX_LINKS; i++)
   {
-    /* Data buffer are available for Flash write */
-    if (HAL_VTIMER_DiffSysTimeMs(Next_State_SysTime, HAL_VTIMER_GetCurrentSysTime()) > OTA_WRITE_GUARD_TIME(ota_att_mtu_size)) 
+    link = &ota_link[(next_link + i) % OTA_MAX_LINKS];
+    
+    if (link->conn_handle == OTA_INVALID_CONN_HANDLE)
+      continue;
+    
+    /* Check if data for flash write are ready: write only what can be programmed before next radio activity */
+    if (link->imageWindow[link->writeBuffer].length != 0) 
+    {
+      /* Data buffer are available for Flash write */
+      int64_t idle_time = HAL_VTIMER_DiffSysTimeMs(Next_State_SysTime, HAL_VTIMER_GetCurrentSysTime());
+      
+      if (OTA_WRITE_LENGTH(idle_time) >= BYTE_INCREMENT) 
+      {
+          OTA_Write_Data(link, (idle_time < 1000) ? (uint32_t)OTA_WRITE_LENGTH(idle_time) : (uint32_t)BUF_SIZE); 
+          next_link = (next_link + i + 1) % OTA_MAX_LINKS;
+      }
+    }
+    
+    /* Erase ahead the pages of the window being received, so that they are blank when it is programmed.
+       Blank pages are just checked; a page erase is done only if there is enough time before next radio activity */
+    eraseEnd = link->imageBase + link->totalBytesReceived + BUFPOINTER_LIMIT(link);
+#ifdef OTA_ENCODED_IMAGE
+    if (link->encoded)
     {
-        ota_write_data = 0; 
-        OTA_Write_Data(); 
+      /* The decoded image grows faster than the encoded one: at least one page ahead of the decoded image */
+      eraseEnd = link->imageBase + link->decoder.outLength + ((BUFPOINTER_LIMIT(link) > FLASH_PAGE_SIZE) ? BUFPOINTER_LIMIT(link) : FLASH_PAGE_SIZE);
+    }
+#endif
+    while ((link->imageSize != 0) && (link->erasedAddress < (link->imageBase + link->imageSize)) &&
+           (link->erasedAddress < eraseEnd))
+    {
+      if (OTA_Erase_Next_Page(link, HAL_VTIMER_DiffSysTimeMs(Next_State_SysTime, HAL_VTIMER_GetCurrentSysTime()) > OTA_PAGE_ERASE_TIME) != SUCCESS)
+        break;
     }
   }
   
@@ -787,25 +2032,28 @@ void OTA_att_exchange_mtu_resp_CB(uint16_t Connection_Handle,
                                   uint16_t Att_MTU)
 {
 #if defined(CONFIG_SW_OTA_DATA_LENGTH_EXT)
+  OTA_Conn_Params_t *params = OTA_Get_Conn_Params(Connection_Handle, 1);
   //printf("ATT mtu exchanged with value = 0x%04X\n", Att_MTU);
   
   /* If OTA Client performs an ATT_MTU exchange in order to increase ATT_MTU: 
      set actual ota_att_mtu_size used for OTA transfer and register this event */
-  ota_att_mtu_size = Att_MTU -3; 
+  params->ota_att_mtu_size = Att_MTU -3; 
   
-  client_DLE_ATT_MTU |= ATT_MTU_DONE;
+  params->client_DLE_ATT_MTU |= ATT_MTU_DONE;
 #endif
 }
 
 void OTA_data_length_change_CB(uint16_t Connection_Handle)
 {
 #if defined(CONFIG_SW_OTA_DATA_LENGTH_EXT)
+   OTA_Conn_Params_t *params = OTA_Get_Conn_Params(Connection_Handle, 1);
+   
    /* If OTA Client supports extended data length, this event is raised: set associated flag and increase connection interval
       for allowing OTA transfer with data length extension */
    
-    client_DLE_ATT_MTU |= DLE_DONE; 
+    params->client_DLE_ATT_MTU |= DLE_DONE; 
     /* Increase connection interval for handling BUF_SIZE Flash write operations */
-    aci_l2cap_connection_parameter_update_req(Connection_Handle, (uint16_t) OTA_EXT_LE_L2CAP_CONN_INTERVAL(ota_att_mtu_size), (uint16_t) OTA_EXT_LE_L2CAP_CONN_INTERVAL(ota_att_mtu_size), 0, 100); 
+    aci_l2cap_connection_parameter_update_req(Connection_Handle, (uint16_t) OTA_EXT_LE_L2CAP_CONN_INTERVAL(params->ota_att_mtu_size), (uint16_t) OTA_EXT_LE_L2CAP_CONN_INTERVAL(params->ota_att_mtu_size), 0, 100); 
 #endif
 }
     
@@ -813,10 +2061,12 @@ void OTA_data_length_change_CB(uint16_t Connection_Handle)
 void OTA_Read_Char(uint16_t Connection_Handle, uint16_t Attribute_Handle, uint16_t Data_Offset) 
 {
     uint8_t att_err = BLE_ATT_ERR_NONE;
-
+    /* A connection without OTA session reads the default values */
+    OTA_Link_t *link = OTA_Get_Link(Connection_Handle);
+    
     if(Attribute_Handle == btlNewImageCharHandle + 1) //Read and write 
     { 
-        aci_gatt_srv_resp(Connection_Handle, Attribute_Handle, att_err, sizeof(imageinfo), (uint8_t *)(&imageinfo[0]));
+        aci_gatt_srv_resp(Connection_Handle, Attribute_Handle, att_err, sizeof(ota_default_imageinfo), (uint8_t *)((link != NULL) ? &link->imageinfo[0] : &ota_default_imageinfo[0]));
     }
     else if(Attribute_Handle == btlImageCharHandle + 1) //ONLY Read 
     {
@@ -826,11 +2076,14 @@ void OTA_Read_Char(uint16_t Connection_Handle, uint16_t Attribute_Handle, uint16
     }
     else if(Attribute_Handle == btlNewImageTUContentCharHandle + 1) //Read and write 
     { 
-        aci_gatt_srv_resp(Connection_Handle, Attribute_Handle, att_err, IMAGE_CONTENT_SIZE, (uint8_t *)(&imageData[0]));
+        aci_gatt_srv_resp(Connection_Handle, Attribute_Handle, att_err, IMAGE_CONTENT_SIZE, (uint8_t *)((link != NULL) ? &link->imageData[0] : &ota_default_imageData[0]));
     }
     else if(Attribute_Handle == btlExpectedImageTUSeqNumberCharHandle + 1) //Read and notify 
     { 
-        aci_gatt_srv_resp(Connection_Handle, Attribute_Handle, att_err, 4, (uint8_t *)&notification);
+        if (link != NULL)
+          aci_gatt_srv_resp(Connection_Handle, Attribute_Handle, att_err, OTA_NOTIFICATION_LENGTH(link), (uint8_t *)&link->notification);
+        else
+          aci_gatt_srv_resp(Connection_Handle, Attribute_Handle, att_err, 4, (uint8_t *)&ota_default_notification);
     }
 
 } /* OTA_Read_Char() */
@@ -84,6 +84,7 @@ typedef enum
   BV_RECEIVER_DISABLE = 0x30,               /*!< Receiver mode disabled.*/
   BV_TRANSMITTER_DISABLE = 0x31,            /*!< Transmitter mode disabled.*/
   BV_RX_HANDLE_NOT_AVAILABLE = 0x32,        /*!< The handle isn't recognized.*/
+  BV_LINK_NOT_AVAILABLE = 0x33,             /*!< No BlueVoice link is associated to the connection handle.*/
   BV_OUT_BUF_READY = 0x40,                  /*!< The audio out buffer is ready to be sent.*/
   BV_OUT_BUF_NOT_READY = 0x41,              /*!< The audio out buffer is not ready to be sent.*/
   BV_PCM_SAMPLES_ERR = 0x50,                /*!< The number of PCM samples given as audio input is not correct.*/
@@ -92,6 +93,17 @@ typedef enum
   BV_INSUFFICIENT_RESOURCES = 0x80          /*!< GATT TX Buffer full.*/
 } BV_3_x_Status;
 
+/** 
+* @brief Transmitted audio bitrate.
+*/
+typedef enum
+{
+  BV_BITRATE_4_BIT = 0x00,                  /*!< 4-bit ADPCM codes (default).*/
+  BV_BITRATE_ADAPTIVE = 0x01,               /*!< 4, 3 or 2-bit ADPCM codes, depending on the link congestion.*/
+  BV_BITRATE_2_BIT = 0x02,                  /*!< 2-bit ADPCM codes.*/
+  BV_BITRATE_3_BIT = 0x03                   /*!< 3-bit ADPCM codes.*/
+} BV_Bitrate_t;
+
 /** 
 * @brief BlueVoice working modalities.
 */
@@ -160,6 +172,21 @@ typedef struct
 #define BV_ADPCM_3_x_TIMEOUT_STATUS                 ((uint16_t)500)           /*!< status timeout (in ms), the function "BlueVoice_IncTick" must be 
                                                                                 called every 1 ms. If timeout expires, the device goes from receiving/streaming 
                                                                                 to ready mode.*/
+
+#ifndef BV_ADPCM_3_x_MAX_LINKS
+#define BV_ADPCM_3_x_MAX_LINKS                      (1)                       /*!< Maximum number of simultaneous BlueVoice connections. Each link
+                                                                                has its own codec state and audio buffers (about 230 bytes).*/
+#endif
+
+#define BV_ADPCM_3_x_BITRATE_UP_TIME                ((uint16_t)1000)          /*!< In adaptive bitrate mode, time (in ms) without congestion before
+                                                                                the bitrate is increased.*/
+
+#define BV_ADPCM_3_x_RX_SAMPLES(Len)                ((Len) * 4U)              /*!< Size, in 16-bit PCM samples, of the buffer_out given to
+                                                                                BluevoiceADPCM_3_x_ParseData() for Len received bytes: the peer
+                                                                                may send 2, 3 or 4-bit codes, i.e. up to 4 samples per byte.*/
+
+#define BV_ADPCM_3_x_RX_MAX_SAMPLES                 (255U)                    /*!< Maximum number of samples decoded by a single
+                                                                                BluevoiceADPCM_3_x_ParseData() call.*/
                                                                             
 /**
   * @}
@@ -220,6 +247,14 @@ void BluevoiceADPCM_3_x_SetTxHandle(BV_ADPCM_3_x_ProfileHandle_t *tx_handle);
   */
 void BluevoiceADPCM_3_x_SetRxHandle(BV_ADPCM_3_x_ProfileHandle_t *rx_handle);
 
+/**
+  * @brief  This function is called to set the handles discovered on a given connection.
+  * @param  conn_handle: Connection handle.
+  * @param  rx_handle: Pointer to a BV_ADPCM_3_x_ProfileHandle_t struct in which the handles are stored.
+  * @retval BV_3_x_Status: BV_SUCCESS, BV_LINK_NOT_AVAILABLE if conn_handle is unknown.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_SetLinkRxHandle(uint16_t conn_handle, BV_ADPCM_3_x_ProfileHandle_t *rx_handle);
+
 /**
   * @brief  This function returns the BlueVoice Profile State Machine status.
   * @param  None.
@@ -227,12 +262,53 @@ void BluevoiceADPCM_3_x_SetRxHandle(BV_ADPCM_3_x_ProfileHandle_t *rx_handle);
   */
 BV_Profile_Status BluevoiceADPCM_3_x_GetStatus(void);
 
+/**
+  * @brief  This function returns the BlueVoice Profile State Machine status of a connection.
+  * @param  conn_handle: Connection handle.
+  * @retval BV_Profile_Status: BlueVoice Profile Status, BLUEVOICE_STATUS_UNITIALIZED if conn_handle is unknown.
+  */
+BV_Profile_Status BluevoiceADPCM_3_x_GetLinkStatus(uint16_t conn_handle);
+
 /**
   * @brief  This function returns the current modality.
   * @param  None.
   * @retval BV_Mode: Current working modality: NOT_READY, RECEIVER, TRANSMITTER or HALF_DUPLEX.
   */
 BV_Mode BluevoiceADPCM_3_x_GetMode(void);
+
+/**
+  * @brief  This function returns the current modality of a connection.
+  * @param  conn_handle: Connection handle.
+  * @retval BV_Mode: Current working modality, NOT_READY if conn_handle is unknown.
+  */
+BV_Mode BluevoiceADPCM_3_x_GetLinkMode(uint16_t conn_handle);
+
+/**
+  * @brief  This function is called to set the bitrate of the transmitted audio.
+  *         In adaptive mode the number of bits per ADPCM code (4, 3 or 2) of each connection
+  *         follows the availability of the GATT TX pool, BluevoiceADPCM_3_x_TxPoolAvailable_CB()
+  *         and BluevoiceADPCM_3_x_SetLinkConnInterval() should be called in this case.
+  *         The new bitrate is applied at the next frame, after the side information.
+  * @param  bitrate: BV_BITRATE_4_BIT (default), BV_BITRATE_3_BIT, BV_BITRATE_2_BIT or BV_BITRATE_ADAPTIVE.
+  * @retval BV_3_x_Status: BV_SUCCESS, BV_ERROR if the bitrate is not valid.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_SetBitrate(BV_Bitrate_t bitrate);
+
+/**
+  * @brief  This function returns the number of bits per ADPCM code currently transmitted on a connection.
+  * @param  conn_handle: Connection handle.
+  * @retval uint8_t: 4, 3 or 2, 0 if conn_handle is unknown.
+  */
+uint8_t BluevoiceADPCM_3_x_GetLinkBitrate(uint16_t conn_handle);
+
+/**
+  * @brief  This function is called to set the connection interval, used by the adaptive bitrate.
+  *         It should be called on LE Connection Complete and LE Connection Update Complete events.
+  * @param  conn_handle: Connection handle.
+  * @param  conn_interval: Connection interval, in units of 1.25 ms.
+  * @retval BV_3_x_Status: BV_SUCCESS, BV_LINK_NOT_AVAILABLE if conn_handle is unknown.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_SetLinkConnInterval(uint16_t conn_handle, uint16_t conn_interval);
    
 /**
   * @brief  This function increases the the internal counter, used to switch from Receiving/Streaming to Ready status.
@@ -247,6 +323,13 @@ BV_3_x_Status BluevoiceADPCM_3_x_IncTick(void);
   * @retval BV_3_x_Status: Value indicating success or error code.
   */
 BV_3_x_Status BluevoiceADPCM_3_x_EnableAudioNotification(void);
+
+/**
+  * @brief  This function is called to enable Audio notification on a given connection.
+  * @param  conn_handle: Connection handle.
+  * @retval BV_3_x_Status: Value indicating success or error code.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_EnableLinkAudioNotification(uint16_t conn_handle);
   
 /**
   * @brief  This function is called to enable Sync notifications.
@@ -255,16 +338,28 @@ BV_3_x_Status BluevoiceADPCM_3_x_EnableAudioNotification(void);
   */
 BV_3_x_Status BluevoiceADPCM_3_x_EnableSyncNotification(void);
 
+/**
+  * @brief  This function is called to enable Sync notification on a given connection.
+  * @param  conn_handle: Connection handle.
+  * @retval BV_3_x_Status: Value indicating success or error code.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_EnableLinkSyncNotification(uint16_t conn_handle);
+
 /**
   * @brief  This function is called to fill audio buffer.
+  *         The samples are encoded for every connection in transmitter or half duplex mode.
   * @param  buffer: Audio in PCM buffer.
-  * @param  Nsamples: Number of PCM 16 bit audio samples.
+  * @param  Nsamples: Number of PCM 16 bit audio samples, from 1 to the number of samples in a frame
+  *         (10 ms or 20 ms, depending on the connection interval the library is built for).
   * @retval BV_3_x_Status: Value indicating success or error code.
   */
 BV_3_x_Status BluevoiceADPCM_3_x_AudioIn(uint16_t* buffer, uint8_t Nsamples);
   
 /**
  * @brief  This function is called to send data.
+ *         Connections with a frame ready are served in round robin order: when the
+ *         TX pool is full, the next call resumes from the connection that could not
+ *         be served.
  * @param  None
  * @retval BV_3_x_Status: Value indicating success or error code.
  */
@@ -276,11 +371,29 @@ BV_3_x_Status BluevoiceADPCM_3_x_SendData(void);
   * @param  Len: Dimension in Bytes.
   * @param  attr_handle: Handle of the updated characteristic.
   * @param  buffer_out: 16-bit PCM samples destination buffer.
-  * @param  samples: Number of 16-bit PCM samples in the destination buffer.
-  * @retval BV_3_x_Status: Value indicating success or error code.
+  * @param  samples: Number of 16-bit PCM samples written to the destination buffer.
+  *         buffer_out must hold BV_ADPCM_3_x_RX_SAMPLES(Len) samples: it depends on the
+  *         bitrate chosen by the peer, carried by the side information.
+  * @retval BV_3_x_Status: Value indicating success or error code, BV_PCM_SAMPLES_ERR
+  *         (nothing decoded) if Len bytes would give more than BV_ADPCM_3_x_RX_MAX_SAMPLES samples.
   */
 BV_3_x_Status BluevoiceADPCM_3_x_ParseData(uint8_t* buffer_in, uint32_t Len, uint16_t attr_handle, uint8_t* buffer_out, uint8_t *samples);
 
+/**
+  * @brief  This function is called to parse data received on a given connection.
+  * @param  conn_handle: Connection handle on which the notification has been received.
+  * @param  buffer_in: 8-bit packed ADPCM samples source buffer.
+  * @param  Len: Dimension in Bytes.
+  * @param  attr_handle: Handle of the updated characteristic.
+  * @param  buffer_out: 16-bit PCM samples destination buffer.
+  * @param  samples: Number of 16-bit PCM samples written to the destination buffer.
+  *         buffer_out must hold BV_ADPCM_3_x_RX_SAMPLES(Len) samples: it depends on the
+  *         bitrate chosen by the peer, carried by the side information.
+  * @retval BV_3_x_Status: Value indicating success or error code, BV_PCM_SAMPLES_ERR
+  *         (nothing decoded) if Len bytes would give more than BV_ADPCM_3_x_RX_MAX_SAMPLES samples.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_ParseLinkData(uint16_t conn_handle, uint8_t* buffer_in, uint32_t Len, uint16_t attr_handle, uint8_t* buffer_out, uint8_t *samples);
+
 /**
   * @}
   */ 
@@ -291,6 +404,7 @@ BV_3_x_Status BluevoiceADPCM_3_x_ParseData(uint8_t* buffer_in, uint32_t Len, uin
   
 /**
   * @brief  This function must be called when there is a LE Connection Complete event.
+  *         A free link is associated to the connection, if any.
   * @param  handle: Connection handle.
   * @retval None.
   */
@@ -303,6 +417,14 @@ void BluevoiceADPCM_3_x_ConnectionComplete_CB(uint16_t handle);
   */
 void BluevoiceADPCM_3_x_DisconnectionComplete_CB(void);
 
+/**
+  * @brief  This function must be called when there is a LE disconnection Complete event,
+  *         if more than one connection is used.
+  * @param  handle: Connection handle.
+  * @retval None.
+  */
+void BluevoiceADPCM_3_x_LinkDisconnectionComplete_CB(uint16_t handle);
+
 /**
   * @brief  This function must be called when there is a LE attribut modified event. 
   * @param  attr_handle: Attribute handle.
@@ -312,6 +434,24 @@ void BluevoiceADPCM_3_x_DisconnectionComplete_CB(void);
   */
 void BluevoiceADPCM_3_x_AttributeModified_CB(uint16_t attr_handle, uint8_t attr_len, uint8_t *attr_value);
 
+/**
+  * @brief  This function must be called when there is a LE attribut modified event,
+  *         if more than one connection is used.
+  * @param  conn_handle: Connection handle.
+  * @param  attr_handle: Attribute handle.
+  * @param  attr_len: Attribute length.
+  * @param  attr_value: Attribute value.
+  * @retval None.
+  */
+void BluevoiceADPCM_3_x_LinkAttributeModified_CB(uint16_t conn_handle, uint16_t attr_handle, uint8_t attr_len, uint8_t *attr_value);
+
+/**
+  * @brief  This function must be called when there is a GATT TX pool available event.
+  * @param  conn_handle: Connection handle.
+  * @retval None.
+  */
+void BluevoiceADPCM_3_x_TxPoolAvailable_CB(uint16_t conn_handle);
+
 /**
   * @}
   */
@@ -65,7 +65,6 @@
 #define PRINTF(...)
 #endif
    
-#define NUM_LINKS 1
 /* Audio service UUID */
 #define AUDIO_SERVICE_UUID   0x1b,0xc5,0xd5,0xa5,0x02,0x00,0xb4,0x9a,0xe1,0x11,0x01,0x00,0x00,0x00,0x00,0x00
    
@@ -77,13 +76,13 @@
    
 /* Client Configuration Characteristics Descriptor Definition: audio characteristic */
 BLE_GATT_SRV_CCCD_DECLARE(audio,
-                          NUM_LINKS,
+                          BV_ADPCM_3_x_MAX_LINKS,
                           BLE_GATT_SRV_CCCD_PERM_DEFAULT,
                           BLE_GATT_SRV_OP_MODIFIED_EVT_ENABLE_FLAG);
 
 /* Client Configuration Characteristics Descriptor Definition: audio sync characteristic */
 BLE_GATT_SRV_CCCD_DECLARE(audio_sync,
-                          NUM_LINKS,
+                          BV_ADPCM_3_x_MAX_LINKS,
                           BLE_GATT_SRV_CCCD_PERM_DEFAULT,
                           BLE_GATT_SRV_OP_MODIFIED_EVT_ENABLE_FLAG);
 
@@ -122,61 +121,6 @@ static ble_gatt_srv_def_t audio_service = {
 };
 
 
-/**
- * @brief BV_ADPCM_3_x_Handle structure definition
- */
-typedef struct
-{
-  BV_Profile_Status ProfileState;                       /*!< Specifies the state of the BlueVoice Profile. */
-  
-  uint8_t configured;                                   /*!< Specifies if the BlueVoice Profile is configured or not. */
-  
-  uint8_t connected;                                    /*!< Specifies if the device is connected or not. */
-  
-  BV_Mode mode;                                         /*!< Specifies the current working modality: Not ready, Receiver, Transmitter, or Half Duplex. */
-  
-  uint16_t ConnectionHandle;                            /*!< Connection Handle. */
-
-  uint16_t STATUS_timeutCount;                          /*!< Status timeout counter. */
-  
-  uint16_t STATUS_timeutValue;                          /*!< Status timeut value. */
-  
-  uint8_t AudioNotifEnabled;                            /*!< Audio characteristic enabled. */
-  
-  uint8_t AudioSyncNotifEnabled;                        /*!< Sync characteristic enabled. */
-
-  //BV_ADPCM_3_x_uuid_t BV_uuid;                        /*!< Specifies the uuid for the BlueVoice service and characteristics. */
-  
-  BV_ADPCM_3_x_ProfileHandle_t BV_handle;             /*!< Specifies the handle for the BlueVoice service and characteristics. */
-  
-  BV_ADPCM_3_x_ProfileHandle_t BV_handle_RX;          /*!< Specifies the handle for RX part in Half-Duplex application. */
-  
-  Sampling_fr_t sampling_frequency;                     /*!< Specifies the audio sampling frequency in kHz - can be 16 kHz or 8 kHz. */
-  
-  uint8_t channel_in;                                   /*!< The choosen channel among the available in the input buffer. */
-        
-  uint8_t channel_tot;                                  /*!< Number of audio channels contained in the buffer given as Audio input. */
-  
-  uint8_t ADPCMBuffSize;                                /*!< Size of the ADPCM buffer. */
-    
-  uint8_t ADPCMHalfBuffSize;                            /*!< Half size ADPCM buffer. */
-
-  uint8_t OUTBuffSize;                                  /*!< Size of the Output buffer. */
-    
-  uint16_t ADPCMBuffCnt;                                /*!< ADPCM buffer counter. */
-  
-  uint32_t FrameCounter;                                /*!< Side information frame counter. */
-    
-  uint8_t ADPCMBuffReady;                               /*!< ADPCM Buffer status : 1=half buffer full, 2=complete buffer full. */
-  
-  uint8_t Nb_bytes_audio;                               /*!< Number of audio bytes to be sent. */
-  
-  uint8_t Nb_bytes_sync;                                /*!< Number of sync bytes to be sent. */
-  
-  uint8_t p_out_bytes;                                  /*!< Index of data to be sent. */
- 
-} BV_ADPCM_3_x_HandleTypeDef;
-
 /**
   * @brief ADPCM handle Structure definition
   */
@@ -184,6 +128,7 @@ typedef struct
 {
   int16_t index;                       /* Index */
   int32_t predsample;                  /* PredSample */
+  uint8_t bits;                        /* Bits per ADPCM code: 2, 3 or 4 */
 } BV_ADPCM_CodecHandleTypeDef;
 
 
@@ -203,23 +148,130 @@ typedef struct
 
 #ifdef CONN_INT_10
   #define SIDE_INF_FRAME_INTERVAL                         (16)
+  #define FRAME_DURATION_MS                               (10)
+  #define ADPCM_IN_BUFF_SIZE                              (80)
+  #define ADPCM_OUT_BUFF_SIZE                             (86)
 #endif
 
 #ifdef CONN_INT_20
   #define SIDE_INF_FRAME_INTERVAL                         (8)
+  #define FRAME_DURATION_MS                               (20)
+  #define ADPCM_IN_BUFF_SIZE                              (160)
+  #define ADPCM_OUT_BUFF_SIZE                             (166)
 #endif
 
+/* Frames without congestion before the adaptive bitrate is increased */
+#define BITRATE_UP_FRAMES                               (BV_ADPCM_3_x_BITRATE_UP_TIME / FRAME_DURATION_MS)
+
+#define LINK_INVALID_HANDLE                             (0xFFFF)
 
 /**
  * @}
  */
 
+/**
+ * @brief BlueVoice link structure definition: state of the audio stream with one peer device.
+ */
+typedef struct
+{
+  BV_Profile_Status ProfileState;                       /*!< Specifies the state of the BlueVoice Profile on this link. */
+
+  uint8_t connected;                                    /*!< Specifies if the link is in use or not. */
+
+  BV_Mode mode;                                         /*!< Specifies the current working modality: Not ready, Receiver, Transmitter, or Half Duplex. */
+
+  uint16_t ConnectionHandle;                            /*!< Connection Handle. */
+
+  uint16_t STATUS_timeutCount;                          /*!< Status timeout counter. */
+
+  uint8_t AudioNotifEnabled;                            /*!< Audio characteristic enabled. */
+
+  uint8_t AudioSyncNotifEnabled;                        /*!< Sync characteristic enabled. */
+
+  BV_ADPCM_3_x_ProfileHandle_t BV_handle_RX;          /*!< Specifies the handle for RX part in Half-Duplex application. */
+
+  uint16_t ADPCMBuffCnt;                                /*!< ADPCM buffer counter (bytes of the current frame). */
+
+  uint16_t FrameSampleCnt;                              /*!< PCM samples encoded in the current frame. */
+
+  uint32_t BitAcc;                                      /*!< ADPCM codes not yet written to AudioIN_Buffer. */
+
+  uint8_t BitCnt;                                       /*!< Number of valid bits in BitAcc. */
+
+  uint32_t RxBitAcc;                                    /*!< Received bits not yet decoded. */
+
+  uint8_t RxBitCnt;                                     /*!< Number of valid bits in RxBitAcc. */
+
+  uint8_t NextTxBits;                                   /*!< Bits per code to be used after the next side information. */
+
+  uint16_t CleanFrames;                                 /*!< Frames sent without congestion since the last bitrate change. */
+
+  uint8_t TxStalled;                                    /*!< The GATT TX pool was full and the stack did not notify it is available again. */
+
+  uint32_t StallStart;                                  /*!< Tick at which the TX pool has been found full. */
+
+  uint16_t ConnIntervalMs;                              /*!< Connection interval in ms. */
+
+  uint32_t FrameCounter;                                /*!< Side information frame counter. */
+
+  uint8_t ADPCMBuffReady;                               /*!< ADPCM Buffer status : 1=half buffer full, 2=complete buffer full. */
+
+  uint8_t Nb_bytes_audio;                               /*!< Number of audio bytes to be sent. */
+
+  uint8_t Nb_bytes_sync;                                /*!< Number of sync bytes to be sent. */
+
+  uint8_t p_out_bytes;                                  /*!< Index of data to be sent. */
+
+  BV_ADPCM_CodecHandleTypeDef Encode;                   /*!< ADPCM encoder state. */
+
+  BV_ADPCM_CodecHandleTypeDef Decode;                   /*!< ADPCM decoder state. */
+
+  uint8_t AudioIN_Buffer[ADPCM_IN_BUFF_SIZE];           /*!< Frame being encoded, copied to AudioOUT_Buffer when complete. */
+
+  uint8_t AudioOUT_Buffer[ADPCM_OUT_BUFF_SIZE];         /*!< Buffer being notified (audio + side information). */
+
+} BV_ADPCM_3_x_LinkTypeDef;
+
+/**
+ * @brief BV_ADPCM_3_x_Handle structure definition
+ */
+typedef struct
+{
+  uint8_t configured;                                   /*!< Specifies if the BlueVoice Profile is configured or not. */
+
+  uint16_t STATUS_timeutValue;                          /*!< Status timeut value. */
+
+  //BV_ADPCM_3_x_uuid_t BV_uuid;                        /*!< Specifies the uuid for the BlueVoice service and characteristics. */
+
+  BV_ADPCM_3_x_ProfileHandle_t BV_handle;             /*!< Specifies the handle for the BlueVoice service and characteristics. */
+
+  Sampling_fr_t sampling_frequency;                     /*!< Specifies the audio sampling frequency in kHz - can be 16 kHz or 8 kHz. */
+
+  uint8_t channel_in;                                   /*!< The choosen channel among the available in the input buffer. */
+
+  uint8_t channel_tot;                                  /*!< Number of audio channels contained in the buffer given as Audio input. */
+
+  uint16_t FrameSamples;                                /*!< PCM samples per frame. */
+
+  BV_Bitrate_t Bitrate;                                 /*!< Transmitter bitrate: fixed number of bits per code or adaptive. */
+
+  uint32_t Tick;                                        /*!< Time in ms, increased by BluevoiceADPCM_3_x_IncTick(). */
+
+  uint8_t SendLinkIdx;                                  /*!< First link served by the next BluevoiceADPCM_3_x_SendData() call. */
+
+  BV_ADPCM_3_x_LinkTypeDef link[BV_ADPCM_3_x_MAX_LINKS]; /*!< Per connection state. */
+
+} BV_ADPCM_3_x_HandleTypeDef;
+
 /** @defgroup BV_ADPCM_3_x_Private_Macros
  * @{
  */
 #ifndef MIN
   #define MIN(a,b)            ((a) < (b) )? (a) : (b)
 #endif
+
+/* Link used by the single connection API */
+#define DEFAULT_LINK          (&hBV_ADPCM_3_x.link[0])
 /**
  * @}
  */
@@ -229,58 +281,103 @@ typedef struct
  */
 static BV_ADPCM_3_x_HandleTypeDef hBV_ADPCM_3_x;
 
-
-#ifdef CONN_INT_10
-  uint8_t BV_ADPCM_3_x_AudioIN_Buffer[160];
-  uint8_t BV_ADPCM_3_x_AudioOUT_Buffer[86];
-#endif
-#ifdef CONN_INT_20 
-  uint8_t BV_ADPCM_3_x_AudioIN_Buffer[320];
-  uint8_t BV_ADPCM_3_x_AudioOUT_Buffer[166];
-#endif
-
-BV_ADPCM_CodecHandleTypeDef hBV_ADPCM_Encode, hBV_ADPCM_Decode;
-
-static uint8_t ADPCM_sample[2];
 #ifdef BV_STREAM_COS
   static int16_t cosine[COS_BUFF_SIZE_s16];
 #endif
 /**
  * @}
  */
- 
+
 /** @defgroup BV_ADPCM_3_x_Private_FunctionPrototypes
  * @{
  */
 
 /**
  * @brief  This function is called to encode audio data.
- * @param  buffer_out: 8-bit packed ADPCM samples destination buffer.
+ * @param  pLink: BlueVoice link.
  * @param  buffer_in: 16-bit PCM samples source buffer.
  * @param  Len: in data dimension in Bytes.
  * @retval AudioOUTLen: out data dimension in Bytes;
  */
-static uint8_t BluevoiceADPCM_3_x_PrepareBuffOut(uint8_t* buffer_out, uint8_t* buffer_in, uint32_t Len);
+static uint8_t BluevoiceADPCM_3_x_PrepareBuffOut(BV_ADPCM_3_x_LinkTypeDef *pLink, uint8_t* buffer_in, uint32_t Len);
 
 /**
  * @brief  This function is called to write BV_ADPCM_3_x Profile StateMachine status.
+ * @param  pLink: BlueVoice link.
  * @param  State status to be written.
  * @retval None.
  */
-static void BluevoiceADPCM_3_x_WriteStateMachine(BV_Profile_Status State);
+static void BluevoiceADPCM_3_x_WriteStateMachine(BV_ADPCM_3_x_LinkTypeDef *pLink, BV_Profile_Status State);
+
+/**
+ * @brief  This function is called to get the link associated to a connection handle.
+ * @param  conn_handle: Connection handle.
+ * @retval Pointer to the link, NULL if no link is associated to conn_handle.
+ */
+static BV_ADPCM_3_x_LinkTypeDef *BluevoiceADPCM_3_x_GetLink(uint16_t conn_handle);
+
+/**
+ * @brief  This function is called to reset the streaming state of a link.
+ * @param  pLink: BlueVoice link.
+ * @retval None.
+ */
+static void BluevoiceADPCM_3_x_LinkReset(BV_ADPCM_3_x_LinkTypeDef *pLink);
+
+/**
+ * @brief  This function is called to send the pending data of a link.
+ * @param  pLink: BlueVoice link.
+ * @retval BV_3_x_Status: Value indicating success or error code.
+ */
+static BV_3_x_Status BluevoiceADPCM_3_x_SendLinkData(BV_ADPCM_3_x_LinkTypeDef *pLink);
+
+/**
+ * @brief  This function is called when a notification fails because the GATT TX pool is full.
+ * @param  pLink: BlueVoice link.
+ * @retval BV_INSUFFICIENT_RESOURCES.
+ */
+static BV_3_x_Status BluevoiceADPCM_3_x_TxPoolFull(BV_ADPCM_3_x_LinkTypeDef *pLink);
+
+/**
+ * @brief  This function is called to encode PCM samples in the current frame of a link.
+ * @param  pLink: BlueVoice link.
+ * @param  pcm: first 16-bit PCM sample of the selected channel.
+ * @param  stride: distance, in samples, between two consecutive samples of the selected channel.
+ * @param  Nsamples: number of samples to be encoded.
+ * @retval None.
+ */
+static void BluevoiceADPCM_3_x_EncodeSamples(BV_ADPCM_3_x_LinkTypeDef *pLink, const int16_t *pcm, uint32_t stride, uint32_t Nsamples);
 
 /**
-* @brief  This function is called to Encode 16-bit PCM sample to 4-bit ADPCM sample.
+ * @brief  This function is called, when a frame is complete, to choose the bitrate of the next frames.
+ * @param  pLink: BlueVoice link.
+ * @retval None.
+ */
+static void BluevoiceADPCM_3_x_UpdateBitrate(BV_ADPCM_3_x_LinkTypeDef *pLink);
+
+/**
+* @brief  This function is called to Encode 16-bit PCM sample to 2, 3 or 4-bit ADPCM sample.
 * @param  hBV_ADPCM_3_x_Codec: BlueVoice ADPCM handler.
-* @param  sample: a 16-bit PCM sample
-* @retval a 4-bit ADPCM sample
+* @param  sample: a 16-bit PCM sample.
+* @retval ADPCM code (hBV_ADPCM_3_x_Codec->bits bits).
 */
-static uint8_t BluevoiceADPCM_3_x_Encode(BV_ADPCM_CodecHandleTypeDef *hBV_ADPCM_3_x_Codec, int32_t sample);
+static uint8_t BluevoiceADPCM_3_x_Encode(BV_ADPCM_CodecHandleTypeDef *hBV_ADPCM_3_x_Codec, int16_t sample);
 
 /**
-* @brief  This function is called to Decode 4-bit ADPCM sample to 16-bit PCM sample.
+* @brief  This function is called to Encode a block of 16-bit PCM samples to packed 4-bit ADPCM samples.
 * @param  hBV_ADPCM_3_x_Codec: BlueVoice ADPCM handler.
-* @param  code: a byte containing a 4-bit ADPCM sample.
+* @param  pcm: first 16-bit PCM sample of the selected channel.
+* @param  stride: distance, in samples, between two consecutive samples of the selected channel.
+* @param  adpcm: destination buffer, two ADPCM samples per byte (first sample in the low nibble).
+* @param  Nbytes: number of bytes to produce (2*Nbytes PCM samples are consumed).
+* @retval None
+*/
+static void BluevoiceADPCM_3_x_EncodeBlock(BV_ADPCM_CodecHandleTypeDef *hBV_ADPCM_3_x_Codec, const int16_t *pcm,
+                                           uint32_t stride, uint8_t *adpcm, uint32_t Nbytes);
+
+/**
+* @brief  This function is called to Decode 2, 3 or 4-bit ADPCM sample to 16-bit PCM sample.
+* @param  hBV_ADPCM_3_x_Codec: BlueVoice ADPCM handler.
+* @param  code: a byte containing an ADPCM sample (hBV_ADPCM_3_x_Codec->bits bits).
 * @retval 16-bit ADPCM sample
 */
 static int16_t BluevoiceADPCM_3_x_Decode(BV_ADPCM_CodecHandleTypeDef *hBV_ADPCM_3_x_Codec, uint8_t code);
@@ -325,32 +422,36 @@ void BluevoiceADPCM_3_x_Initialize(void)
 {
   memset(&hBV_ADPCM_3_x, 0, sizeof(hBV_ADPCM_3_x));
 
-  hBV_ADPCM_3_x.ProfileState = BLUEVOICE_STATUS_UNITIALIZED;
-  hBV_ADPCM_3_x.mode = NOT_READY;
+  for(uint8_t i = 0; i < BV_ADPCM_3_x_MAX_LINKS; i++)
+  {
+    hBV_ADPCM_3_x.link[i].ProfileState = BLUEVOICE_STATUS_UNITIALIZED;
+    hBV_ADPCM_3_x.link[i].mode = NOT_READY;
+    hBV_ADPCM_3_x.link[i].ConnectionHandle = LINK_INVALID_HANDLE;
+  }
 }
 
 /**
-  * @brief  This function is called to set the configuration parameters 
+  * @brief  This function is called to set the configuration parameters
   * @param  BV_ADPCM_3_x_Config: It contains the configuration parameters.
   * @retval BV_3_x_Status: BV_SUCCESS if the configuration is ok, BV_ERROR otherwise.
   */
 BV_3_x_Status BluevoiceADPCM_3_x_SetConfig(BV_ADPCM_3_x_Config_t *BV_ADPCM_3_x_Config)
-{ 
-  
+{
+
 #ifdef BV_STREAM_COS
   for(int i = 0; i < COS_BUFF_SIZE_s16; i++)
   {
-    cosine[i] = (int16_t)(cos((2 * 3.14159265 * (1.0 / 16.0) * i)) * 10000.0); 
+    cosine[i] = (int16_t)(cos((2 * 3.14159265 * (1.0 / 16.0) * i)) * 10000.0);
   }
 #endif
-  
-  hBV_ADPCM_3_x.ProfileState = BLUEVOICE_STATUS_UNITIALIZED;
-  hBV_ADPCM_3_x.FrameCounter = SIDE_INF_FRAME_INTERVAL-1;
+
   hBV_ADPCM_3_x.STATUS_timeutValue = BV_ADPCM_3_x_TIMEOUT_STATUS;
-  hBV_ADPCM_3_x.STATUS_timeutCount = 0;
-  hBV_ADPCM_3_x.ADPCMBuffCnt = 0;
-  hBV_ADPCM_3_x.ADPCMBuffReady = 0;
-  
+  for(uint8_t i = 0; i < BV_ADPCM_3_x_MAX_LINKS; i++)
+  {
+    BluevoiceADPCM_3_x_WriteStateMachine(&hBV_ADPCM_3_x.link[i], BLUEVOICE_STATUS_UNITIALIZED);
+    BluevoiceADPCM_3_x_LinkReset(&hBV_ADPCM_3_x.link[i]);
+  }
+
   if(((BV_ADPCM_3_x_Config->channel_in > 0) && (BV_ADPCM_3_x_Config->channel_in <= BV_ADPCM_3_x_Config->channel_tot)) && ((BV_ADPCM_3_x_Config->channel_tot > 0) && (BV_ADPCM_3_x_Config->channel_tot < 9)))
   {
     hBV_ADPCM_3_x.channel_in = BV_ADPCM_3_x_Config->channel_in;
@@ -360,29 +461,24 @@ BV_3_x_Status BluevoiceADPCM_3_x_SetConfig(BV_ADPCM_3_x_Config_t *BV_ADPCM_3_x_C
   {
     return BV_ERROR;
   }
-   
+
   if((BV_ADPCM_3_x_Config->sampling_frequency == FR_8000) || (BV_ADPCM_3_x_Config->sampling_frequency == FR_16000))
   {
     hBV_ADPCM_3_x.sampling_frequency = BV_ADPCM_3_x_Config->sampling_frequency;
 
-#ifdef CONN_INT_10    
-    hBV_ADPCM_3_x.ADPCMBuffSize = (BV_ADPCM_3_x_Config->sampling_frequency/200)*2;  /* (FR/1000*10/4*2)*2 in byte, double buffer */
-#endif    
-
-#ifdef CONN_INT_20        
-    hBV_ADPCM_3_x.ADPCMBuffSize = (BV_ADPCM_3_x_Config->sampling_frequency/100)*2;  /* (FR/1000*20/4*2)*2 in byte, double buffer */    
-#endif
-    hBV_ADPCM_3_x.ADPCMHalfBuffSize = hBV_ADPCM_3_x.ADPCMBuffSize/2;
-    hBV_ADPCM_3_x.OUTBuffSize = hBV_ADPCM_3_x.ADPCMHalfBuffSize + SIDE_INF_SIZE_u8;
+    hBV_ADPCM_3_x.FrameSamples = (BV_ADPCM_3_x_Config->sampling_frequency/1000)*FRAME_DURATION_MS;
   }
   else
   {
     return BV_ERROR;
   }
-  
+
   hBV_ADPCM_3_x.configured = 1;
-  BluevoiceADPCM_3_x_WriteStateMachine(BLUEVOICE_STATUS_INITIALIZED);
-  return BV_SUCCESS; 
+  for(uint8_t i = 0; i < BV_ADPCM_3_x_MAX_LINKS; i++)
+  {
+    BluevoiceADPCM_3_x_WriteStateMachine(&hBV_ADPCM_3_x.link[i], BLUEVOICE_STATUS_INITIALIZED);
+  }
+  return BV_SUCCESS;
 }
 
 /**
@@ -395,7 +491,7 @@ uint8_t BluevoiceADPCM_3_x_IsProfileConfigured(void)
   return hBV_ADPCM_3_x.configured;
 }
 
-/** 
+/**
   * @brief  This function is called to add BlueVoice Service.
   * @param  service_handle: Pointer to a variable in which the service handle will be saved.
   * @retval BV_3_x_Status: Value indicating success or error code.
@@ -415,14 +511,14 @@ BV_3_x_Status BluevoiceADPCM_3_x_AddService(uint16_t *service_handle)
     }
     /* Get HID Service handle */
     hBV_ADPCM_3_x.BV_handle.ServiceHandle = aci_gatt_srv_get_service_handle((ble_gatt_srv_def_t *)&audio_service);
-  
+
     if (ret != BLE_STATUS_SUCCESS)
     {
       return BV_ERROR;
     }
     *service_handle = hBV_ADPCM_3_x.BV_handle.ServiceHandle;
-    return BV_SUCCESS;    
-  } 
+    return BV_SUCCESS;
+  }
   return BV_NOT_CONFIG;
 }
 
@@ -436,35 +532,35 @@ BV_3_x_Status BluevoiceADPCM_3_x_AddService(uint16_t *service_handle)
 BV_3_x_Status BluevoiceADPCM_3_x_AddChar(uint16_t service_handle, BV_ADPCM_3_x_ProfileHandle_t *handle)
 {
   tBleStatus ret;
-  
+
   if (hBV_ADPCM_3_x.configured)
-  {    
+  {
     handle->ServiceHandle = service_handle;
     hBV_ADPCM_3_x.BV_handle.ServiceHandle = service_handle;
-    
+
     /* Add Audio Characteristic */
     ret = aci_gatt_srv_add_char((ble_gatt_chr_def_t *)&audio_char[0], hBV_ADPCM_3_x.BV_handle.ServiceHandle);
     if(ret != BLE_STATUS_SUCCESS)
     {
       return BV_ERROR;
     }
-     
+
     hBV_ADPCM_3_x.BV_handle.CharAudioHandle= aci_gatt_srv_get_char_decl_handle((ble_gatt_chr_def_t *)&audio_char[0]);
-    handle->CharAudioHandle = hBV_ADPCM_3_x.BV_handle.CharAudioHandle;     
-      
+    handle->CharAudioHandle = hBV_ADPCM_3_x.BV_handle.CharAudioHandle;
+
      /* Add Audio Sync Characteristic */
     ret = aci_gatt_srv_add_char((ble_gatt_chr_def_t *)&audio_char[1], hBV_ADPCM_3_x.BV_handle.ServiceHandle);
-                                
+
     if (ret != BLE_STATUS_SUCCESS)
     {
       return BV_ERROR;
     }
-    
+
     hBV_ADPCM_3_x.BV_handle.CharAudioSyncHandle = aci_gatt_srv_get_char_decl_handle((ble_gatt_chr_def_t *)&audio_char[1]);
     handle->CharAudioSyncHandle = hBV_ADPCM_3_x.BV_handle.CharAudioSyncHandle;
-            
+
     return BV_SUCCESS;
-  } 
+  }
   return BV_NOT_CONFIG;
 }
 
@@ -487,9 +583,25 @@ void BluevoiceADPCM_3_x_SetTxHandle(BV_ADPCM_3_x_ProfileHandle_t *tx_handle)
   */
 void BluevoiceADPCM_3_x_SetRxHandle(BV_ADPCM_3_x_ProfileHandle_t *rx_handle)
 {
-  hBV_ADPCM_3_x.BV_handle_RX.ServiceHandle = rx_handle->ServiceHandle;
-  hBV_ADPCM_3_x.BV_handle_RX.CharAudioHandle = rx_handle->CharAudioHandle;
-  hBV_ADPCM_3_x.BV_handle_RX.CharAudioSyncHandle = rx_handle->CharAudioSyncHandle;
+  DEFAULT_LINK->BV_handle_RX = *rx_handle;
+}
+
+/**
+  * @brief  This function is called to set the handles discovered on a given connection.
+  * @param  conn_handle: Connection handle.
+  * @param  rx_handle: Pointer to a BV_ADPCM_3_x_ProfileHandle_t struct in which the handles are stored.
+  * @retval BV_3_x_Status: BV_SUCCESS, BV_LINK_NOT_AVAILABLE if conn_handle is unknown.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_SetLinkRxHandle(uint16_t conn_handle, BV_ADPCM_3_x_ProfileHandle_t *rx_handle)
+{
+  BV_ADPCM_3_x_LinkTypeDef *pLink = BluevoiceADPCM_3_x_GetLink(conn_handle);
+
+  if(pLink == NULL)
+  {
+    return BV_LINK_NOT_AVAILABLE;
+  }
+  pLink->BV_handle_RX = *rx_handle;
+  return BV_SUCCESS;
 }
 
 /**
@@ -499,7 +611,19 @@ void BluevoiceADPCM_3_x_SetRxHandle(BV_ADPCM_3_x_ProfileHandle_t *rx_handle)
   */
 BV_Profile_Status BluevoiceADPCM_3_x_GetStatus(void)
 {
-  return hBV_ADPCM_3_x.ProfileState;
+  return DEFAULT_LINK->ProfileState;
+}
+
+/**
+  * @brief  This function returns the BlueVoice Profile State Machine status of a connection.
+  * @param  conn_handle: Connection handle.
+  * @retval BV_Profile_Status: BlueVoice Profile Status, BLUEVOICE_STATUS_UNITIALIZED if conn_handle is unknown.
+  */
+BV_Profile_Status BluevoiceADPCM_3_x_GetLinkStatus(uint16_t conn_handle)
+{
+  BV_ADPCM_3_x_LinkTypeDef *pLink = BluevoiceADPCM_3_x_GetLink(conn_handle);
+
+  return (pLink != NULL) ? pLink->ProfileState : BLUEVOICE_STATUS_UNITIALIZED;
 }
 
 /**
@@ -509,205 +633,330 @@ BV_Profile_Status BluevoiceADPCM_3_x_GetStatus(void)
   */
 BV_Mode BluevoiceADPCM_3_x_GetMode(void)
 {
-  return hBV_ADPCM_3_x.mode;
+  return DEFAULT_LINK->mode;
 }
 
 /**
-  * @brief  This function increases the the internal counter, used to switch from Receiving/Streaming to Ready status.
-  * @param  None.
-  * @retval BV_3_x_Status: Value indicating success or error code.
+  * @brief  This function returns the current modality of a connection.
+  * @param  conn_handle: Connection handle.
+  * @retval BV_Mode: Current working modality, NOT_READY if conn_handle is unknown.
   */
-BV_3_x_Status BluevoiceADPCM_3_x_IncTick(void)
+BV_Mode BluevoiceADPCM_3_x_GetLinkMode(uint16_t conn_handle)
 {
-  if(hBV_ADPCM_3_x.STATUS_timeutValue == 0)
+  BV_ADPCM_3_x_LinkTypeDef *pLink = BluevoiceADPCM_3_x_GetLink(conn_handle);
+
+  return (pLink != NULL) ? pLink->mode : NOT_READY;
+}
+
+/**
+  * @brief  This function is called to set the bitrate of the transmitted audio.
+  *         In adaptive mode the number of bits per ADPCM code (4, 3 or 2) of each connection
+  *         follows the availability of the GATT TX pool, BluevoiceADPCM_3_x_TxPoolAvailable_CB()
+  *         and BluevoiceADPCM_3_x_SetLinkConnInterval() should be called in this case.
+  *         The new bitrate is applied at the next frame, after the side information.
+  * @param  bitrate: BV_BITRATE_4_BIT (default), BV_BITRATE_3_BIT, BV_BITRATE_2_BIT or BV_BITRATE_ADAPTIVE.
+  * @retval BV_3_x_Status: BV_SUCCESS, BV_ERROR if the bitrate is not valid.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_SetBitrate(BV_Bitrate_t bitrate)
+{
+  if((bitrate != BV_BITRATE_ADAPTIVE) && (bitrate != BV_BITRATE_2_BIT) &&
+     (bitrate != BV_BITRATE_3_BIT) && (bitrate != BV_BITRATE_4_BIT))
   {
     return BV_ERROR;
   }
+  hBV_ADPCM_3_x.Bitrate = bitrate;
 
-  if(hBV_ADPCM_3_x.ProfileState == BLUEVOICE_STATUS_RECEIVING)
-  {
-    hBV_ADPCM_3_x.STATUS_timeutCount++;
-    if(hBV_ADPCM_3_x.STATUS_timeutCount == hBV_ADPCM_3_x.STATUS_timeutValue)
-    {
-      hBV_ADPCM_3_x.STATUS_timeutCount = 0;
-      BluevoiceADPCM_3_x_WriteStateMachine(BLUEVOICE_STATUS_READY);
-    }
-  }
-  else if(hBV_ADPCM_3_x.ProfileState == BLUEVOICE_STATUS_STREAMING)
+  for(uint8_t i = 0; i < BV_ADPCM_3_x_MAX_LINKS; i++)
   {
-    hBV_ADPCM_3_x.STATUS_timeutCount++;
-    if(hBV_ADPCM_3_x.STATUS_timeutCount == hBV_ADPCM_3_x.STATUS_timeutValue)
-    {
-      hBV_ADPCM_3_x.FrameCounter = SIDE_INF_FRAME_INTERVAL-1;
-      hBV_ADPCM_3_x.ADPCMBuffCnt = 0;
-      hBV_ADPCM_3_x.STATUS_timeutCount = 0;
-      BluevoiceADPCM_3_x_Reset(&hBV_ADPCM_Encode);
-      BluevoiceADPCM_3_x_WriteStateMachine(BLUEVOICE_STATUS_READY);
-    }
+    /* Adaptive mode restarts from the current bitrate */
+    hBV_ADPCM_3_x.link[i].CleanFrames = 0;
   }
   return BV_SUCCESS;
 }
 
 /**
-  * @brief  This function is called to enable Audio notification.
-  * @param  None.
-  * @retval BV_3_x_Status: Value indicating success or error code.
+  * @brief  This function returns the number of bits per ADPCM code currently transmitted on a connection.
+  * @param  conn_handle: Connection handle.
+  * @retval uint8_t: 4, 3 or 2, 0 if conn_handle is unknown.
   */
-BV_3_x_Status BluevoiceADPCM_3_x_EnableAudioNotification(void)
+uint8_t BluevoiceADPCM_3_x_GetLinkBitrate(uint16_t conn_handle)
 {
-  uint8_t client_char_conf_data[] = { 0x01, 0x00 }; // Enable notifications
-  
-  if(aci_gatt_clt_write(hBV_ADPCM_3_x.ConnectionHandle,
-                        hBV_ADPCM_3_x.BV_handle_RX.CharAudioHandle + 2, 2,
-                        client_char_conf_data) != 0) 
-  {
-    return BV_ERROR;
-  }
-  
-  if(hBV_ADPCM_3_x.mode == TRANSMITTER)
-  {
-    hBV_ADPCM_3_x.mode = HALF_DUPLEX;
-  }
-  else if(hBV_ADPCM_3_x.mode == NOT_READY)
+  BV_ADPCM_3_x_LinkTypeDef *pLink = BluevoiceADPCM_3_x_GetLink(conn_handle);
+
+  return (pLink != NULL) ? pLink->Encode.bits : 0;
+}
+
+/**
+  * @brief  This function is called to set the connection interval, used by the adaptive bitrate.
+  *         It should be called on LE Connection Complete and LE Connection Update Complete events.
+  * @param  conn_handle: Connection handle.
+  * @param  conn_interval: Connection interval, in units of 1.25 ms.
+  * @retval BV_3_x_Status: BV_SUCCESS, BV_LINK_NOT_AVAILABLE if conn_handle is unknown.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_SetLinkConnInterval(uint16_t conn_handle, uint16_t conn_interval)
+{
+  BV_ADPCM_3_x_LinkTypeDef *pLink = BluevoiceADPCM_3_x_GetLink(conn_handle);
+
+  if(pLink == NULL)
   {
-     hBV_ADPCM_3_x.mode = RECEIVER;
+    return BV_LINK_NOT_AVAILABLE;
   }
-  BluevoiceADPCM_3_x_WriteStateMachine(BLUEVOICE_STATUS_READY);
-
+  pLink->ConnIntervalMs = (uint16_t)((conn_interval * 5U) / 4U);
   return BV_SUCCESS;
 }
 
 /**
-  * @brief  This function is called to enable Sync notification.
+  * @brief  This function increases the the internal counter, used to switch from Receiving/Streaming to Ready status.
   * @param  None.
   * @retval BV_3_x_Status: Value indicating success or error code.
   */
-BV_3_x_Status BluevoiceADPCM_3_x_EnableSyncNotification(void)
+BV_3_x_Status BluevoiceADPCM_3_x_IncTick(void)
 {
-  uint8_t client_char_conf_data[] = { 0x01, 0x00 }; // Enable notifications
-
-  if(aci_gatt_clt_write(hBV_ADPCM_3_x.ConnectionHandle,
-                        hBV_ADPCM_3_x.BV_handle_RX.CharAudioSyncHandle + 2, 2,
-                        client_char_conf_data) != 0)
+  if(hBV_ADPCM_3_x.STATUS_timeutValue == 0)
   {
     return BV_ERROR;
   }
 
-  if(hBV_ADPCM_3_x.mode == TRANSMITTER)
-  {
-    hBV_ADPCM_3_x.mode = HALF_DUPLEX;
-  }
-  else if(hBV_ADPCM_3_x.mode == NOT_READY)
+  hBV_ADPCM_3_x.Tick++;
+
+  for(uint8_t i = 0; i < BV_ADPCM_3_x_MAX_LINKS; i++)
   {
-     hBV_ADPCM_3_x.mode = RECEIVER;
+    BV_ADPCM_3_x_LinkTypeDef *pLink = &hBV_ADPCM_3_x.link[i];
+
+    if(pLink->ProfileState == BLUEVOICE_STATUS_RECEIVING)
+    {
+      pLink->STATUS_timeutCount++;
+      if(pLink->STATUS_timeutCount == hBV_ADPCM_3_x.STATUS_timeutValue)
+      {
+        pLink->STATUS_timeutCount = 0;
+        BluevoiceADPCM_3_x_WriteStateMachine(pLink, BLUEVOICE_STATUS_READY);
+      }
+    }
+    else if(pLink->ProfileState == BLUEVOICE_STATUS_STREAMING)
+    {
+      pLink->STATUS_timeutCount++;
+      if(pLink->STATUS_timeutCount == hBV_ADPCM_3_x.STATUS_timeutValue)
+      {
+        pLink->FrameCounter = SIDE_INF_FRAME_INTERVAL-1;
+        pLink->ADPCMBuffCnt = 0;
+        pLink->FrameSampleCnt = 0;
+        pLink->BitAcc = 0;
+        pLink->BitCnt = 0;
+        pLink->STATUS_timeutCount = 0;
+        BluevoiceADPCM_3_x_Reset(&pLink->Encode);
+        BluevoiceADPCM_3_x_WriteStateMachine(pLink, BLUEVOICE_STATUS_READY);
+      }
+    }
+  }
+  return BV_SUCCESS;
+}
+
+/**
+  * @brief  This function is called to enable Audio notification.
+  * @param  None.
+  * @retval BV_3_x_Status: Value indicating success or error code.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_EnableAudioNotification(void)
+{
+  return BluevoiceADPCM_3_x_EnableLinkAudioNotification(DEFAULT_LINK->ConnectionHandle);
+}
+
+/**
+  * @brief  This function is called to enable Audio notification on a given connection.
+  * @param  conn_handle: Connection handle.
+  * @retval BV_3_x_Status: Value indicating success or error code.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_EnableLinkAudioNotification(uint16_t conn_handle)
+{
+  uint8_t client_char_conf_data[] = { 0x01, 0x00 }; // Enable notifications
+  BV_ADPCM_3_x_LinkTypeDef *pLink = BluevoiceADPCM_3_x_GetLink(conn_handle);
+
+  if(pLink == NULL)
+  {
+    return BV_LINK_NOT_AVAILABLE;
   }
-  BluevoiceADPCM_3_x_WriteStateMachine(BLUEVOICE_STATUS_READY);
+
+  if(aci_gatt_clt_write(pLink->ConnectionHandle,
+                        pLink->BV_handle_RX.CharAudioHandle + 2, 2,
+                        client_char_conf_data) != 0)
+  {
+    return BV_ERROR;
+  }
+
+  if(pLink->mode == TRANSMITTER)
+  {
+    pLink->mode = HALF_DUPLEX;
+  }
+  else if(pLink->mode == NOT_READY)
+  {
+     pLink->mode = RECEIVER;
+  }
+  BluevoiceADPCM_3_x_WriteStateMachine(pLink, BLUEVOICE_STATUS_READY);
+
+  return BV_SUCCESS;
+}
+
+/**
+  * @brief  This function is called to enable Sync notification.
+  * @param  None.
+  * @retval BV_3_x_Status: Value indicating success or error code.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_EnableSyncNotification(void)
+{
+  return BluevoiceADPCM_3_x_EnableLinkSyncNotification(DEFAULT_LINK->ConnectionHandle);
+}
+
+/**
+  * @brief  This function is called to enable Sync notification on a given connection.
+  * @param  conn_handle: Connection handle.
+  * @retval BV_3_x_Status: Value indicating success or error code.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_EnableLinkSyncNotification(uint16_t conn_handle)
+{
+  uint8_t client_char_conf_data[] = { 0x01, 0x00 }; // Enable notifications
+  BV_ADPCM_3_x_LinkTypeDef *pLink = BluevoiceADPCM_3_x_GetLink(conn_handle);
+
+  if(pLink == NULL)
+  {
+    return BV_LINK_NOT_AVAILABLE;
+  }
+
+  if(aci_gatt_clt_write(pLink->ConnectionHandle,
+                        pLink->BV_handle_RX.CharAudioSyncHandle + 2, 2,
+                        client_char_conf_data) != 0)
+  {
+    return BV_ERROR;
+  }
+
+  if(pLink->mode == TRANSMITTER)
+  {
+    pLink->mode = HALF_DUPLEX;
+  }
+  else if(pLink->mode == NOT_READY)
+  {
+     pLink->mode = RECEIVER;
+  }
+  BluevoiceADPCM_3_x_WriteStateMachine(pLink, BLUEVOICE_STATUS_READY);
 
   return BV_SUCCESS;
 }
 
 /**
   * @brief  This function is called to fill audio buffer.
+  *         The samples are encoded for every connection in transmitter or half duplex mode.
   * @param  buffer: Audio in PCM buffer.
-  * @param  Nsamples: Number of PCM 16 bit audio samples.
+  * @param  Nsamples: Number of PCM 16 bit audio samples, from 1 to the number of samples in a frame.
   * @retval BV_3_x_Status: Value indicating success or error code.
   */
 BV_3_x_Status BluevoiceADPCM_3_x_AudioIn(uint16_t* buffer, uint8_t Nsamples)
-{  
+{
 #ifdef BV_STREAM_COS
   static uint32_t cos_cnt = 0;
 #endif
-  
+  BV_3_x_Status ret = BV_OUT_BUF_NOT_READY;
+  uint8_t connected = 0;
+  uint8_t transmitting = 0;
+
   if(!hBV_ADPCM_3_x.configured)
   {
     return BV_NOT_CONFIG;
   }
-  
-  if(!hBV_ADPCM_3_x.connected)
+
+  for(uint8_t i = 0; i < BV_ADPCM_3_x_MAX_LINKS; i++)
+  {
+    BV_ADPCM_3_x_LinkTypeDef *pLink = &hBV_ADPCM_3_x.link[i];
+
+    connected |= pLink->connected;
+    if(pLink->connected && ((pLink->mode == HALF_DUPLEX) || (pLink->mode == TRANSMITTER)))
+    {
+      transmitting = 1;
+    }
+  }
+
+  if(!connected)
   {
     return BV_DISCONNETED;
   }
-  
-  if((hBV_ADPCM_3_x.mode != HALF_DUPLEX) && (hBV_ADPCM_3_x.mode != TRANSMITTER))
+
+  if(!transmitting)
   {
     return BV_TRANSMITTER_DISABLE;
   }
-   
-  if(hBV_ADPCM_3_x.sampling_frequency == FR_16000)
+
+  /* The samples can be given in chunks of any size, up to one frame */
+  if((Nsamples == 0) || (Nsamples > hBV_ADPCM_3_x.FrameSamples))
   {
-    if((Nsamples!=16)&&(Nsamples!=32)&&(Nsamples!=80)&&(Nsamples!=160))
-    {
-      return BV_PCM_SAMPLES_ERR;
-    }
+    return BV_PCM_SAMPLES_ERR;
   }
-  else if(hBV_ADPCM_3_x.sampling_frequency == FR_8000)
+
+  for(uint8_t i = 0; i < BV_ADPCM_3_x_MAX_LINKS; i++)
   {
-#ifdef CONN_INT_10  
-    if((Nsamples!=8)&&(Nsamples!=16)&&(Nsamples!=40)&&(Nsamples!=80))
-#endif
-#ifdef CONN_INT_20     
-    if((Nsamples!=8)&&(Nsamples!=16)&&(Nsamples!=40)&&(Nsamples!=80)&&(Nsamples!=160))
-#endif      
+    BV_ADPCM_3_x_LinkTypeDef *pLink = &hBV_ADPCM_3_x.link[i];
+    uint32_t done = 0;
+
+    if(!pLink->connected || ((pLink->mode != HALF_DUPLEX) && (pLink->mode != TRANSMITTER)))
     {
-      return BV_PCM_SAMPLES_ERR;
+      continue;
     }
-  }
-  else
-  {
-    return BV_ERROR;
-  }
-  
-  /*-----------------------------------------compression---------------------------------------------------------*/
-  
-  for (uint32_t i = 0; i < Nsamples*hBV_ADPCM_3_x.channel_tot; i = i + 2 * hBV_ADPCM_3_x.channel_tot)
-  {
-  
+
+    while(done < Nsamples)
+    {
+      /* Encode up to the end of the current frame */
+      uint32_t n = MIN(Nsamples - done, (uint32_t)(hBV_ADPCM_3_x.FrameSamples - pLink->FrameSampleCnt));
+
+      /*-----------------------------------------compression---------------------------------------------------------*/
+
 #ifndef BV_STREAM_COS
-    /* ADPCM_Encode voice */
-    ADPCM_sample[0] = BluevoiceADPCM_3_x_Encode(&hBV_ADPCM_Encode, ((int16_t *) (buffer))[i + (hBV_ADPCM_3_x.channel_in-1)]);
-    ADPCM_sample[1] = BluevoiceADPCM_3_x_Encode(&hBV_ADPCM_Encode, ((int16_t *) (buffer))[i + (hBV_ADPCM_3_x.channel_in-1) + hBV_ADPCM_3_x.channel_tot]);
+      /* ADPCM_Encode voice */
+      BluevoiceADPCM_3_x_EncodeSamples(pLink,
+                                       ((int16_t *) (buffer)) + (hBV_ADPCM_3_x.channel_in-1) + done*hBV_ADPCM_3_x.channel_tot,
+                                       hBV_ADPCM_3_x.channel_tot,
+                                       n);
 #else
-    ADPCM_sample[0] = BluevoiceADPCM_3_x_Encode(&hBV_ADPCM_Encode, (int16_t)cosine[cos_cnt]); // ADPCM_Encode cos
-    cos_cnt++;
-    cos_cnt %= COS_BUFF_SIZE_s16;
-    ADPCM_sample[1] = BluevoiceADPCM_3_x_Encode(&hBV_ADPCM_Encode, (int16_t)cosine[cos_cnt]); // ADPCM_Encode cos
-    cos_cnt++;
-    cos_cnt %= COS_BUFF_SIZE_s16;
+      /* ADPCM_Encode cos, wrapping around the end of the cosine table */
+      {
+        uint32_t pos = (cos_cnt + done) % COS_BUFF_SIZE_s16;
+        uint32_t n1 = MIN(n, COS_BUFF_SIZE_s16 - pos);
+
+        BluevoiceADPCM_3_x_EncodeSamples(pLink, &cosine[pos], 1, n1);
+        BluevoiceADPCM_3_x_EncodeSamples(pLink, &cosine[0], 1, n - n1);
+      }
 #endif
-                         
-    ((uint8_t *) (BV_ADPCM_3_x_AudioIN_Buffer))[hBV_ADPCM_3_x.ADPCMBuffCnt] = ADPCM_sample[0] & 0x0F;
-    ((uint8_t *) (BV_ADPCM_3_x_AudioIN_Buffer))[hBV_ADPCM_3_x.ADPCMBuffCnt] |= (ADPCM_sample[1] << 4) & 0xF0;
-    hBV_ADPCM_3_x.ADPCMBuffCnt++;
-  }
-  
-  /*---------------------------------------------------------------------------------------------------------------*/
-  
-  if (hBV_ADPCM_3_x.ADPCMBuffCnt == hBV_ADPCM_3_x.ADPCMHalfBuffSize)
-  {
-    hBV_ADPCM_3_x.ADPCMBuffReady = 1;
-    BluevoiceADPCM_3_x_PrepareBuffOut(BV_ADPCM_3_x_AudioOUT_Buffer,
-                                   (uint8_t *) & (BV_ADPCM_3_x_AudioIN_Buffer[0]),
-                                   hBV_ADPCM_3_x.ADPCMHalfBuffSize);
-    
-    hBV_ADPCM_3_x.STATUS_timeutCount = 0;
-    
-    BluevoiceADPCM_3_x_WriteStateMachine(BLUEVOICE_STATUS_STREAMING);
-    return BV_OUT_BUF_READY;
-  }
-  if (hBV_ADPCM_3_x.ADPCMBuffCnt == hBV_ADPCM_3_x.ADPCMBuffSize)
-  {
-    hBV_ADPCM_3_x.ADPCMBuffCnt = 0;
-    hBV_ADPCM_3_x.ADPCMBuffReady = 2;
-    BluevoiceADPCM_3_x_PrepareBuffOut(BV_ADPCM_3_x_AudioOUT_Buffer,
-                         (uint8_t *) & (BV_ADPCM_3_x_AudioIN_Buffer[hBV_ADPCM_3_x.ADPCMHalfBuffSize]),
-                          hBV_ADPCM_3_x.ADPCMHalfBuffSize);
-    
-    hBV_ADPCM_3_x.STATUS_timeutCount = 0;
-   
-    BluevoiceADPCM_3_x_WriteStateMachine(BLUEVOICE_STATUS_STREAMING);
-    return BV_OUT_BUF_READY;
+      done += n;
+      pLink->FrameSampleCnt += n;
+
+      /*---------------------------------------------------------------------------------------------------------------*/
+
+      if (pLink->FrameSampleCnt == hBV_ADPCM_3_x.FrameSamples)
+      {
+        if (pLink->BitCnt > 0)
+        {
+          pLink->AudioIN_Buffer[pLink->ADPCMBuffCnt++] = (uint8_t)pLink->BitAcc;
+          pLink->BitAcc = 0;
+          pLink->BitCnt = 0;
+        }
+
+        BluevoiceADPCM_3_x_UpdateBitrate(pLink);
+
+        pLink->ADPCMBuffReady = 1;
+        BluevoiceADPCM_3_x_PrepareBuffOut(pLink,
+                                          (uint8_t *) & (pLink->AudioIN_Buffer[0]),
+                                          pLink->ADPCMBuffCnt);
+        pLink->ADPCMBuffCnt = 0;
+        pLink->FrameSampleCnt = 0;
+
+        pLink->STATUS_timeutCount = 0;
+
+        BluevoiceADPCM_3_x_WriteStateMachine(pLink, BLUEVOICE_STATUS_STREAMING);
+        ret = BV_OUT_BUF_READY;
+      }
+    }
   }
-  return BV_OUT_BUF_NOT_READY;
+#ifdef BV_STREAM_COS
+  cos_cnt = (cos_cnt + Nsamples) % COS_BUFF_SIZE_s16;
+#endif
+
+  return ret;
 }
 
 /**
@@ -716,31 +965,77 @@ BV_3_x_Status BluevoiceADPCM_3_x_AudioIn(uint16_t* buffer, uint8_t Nsamples)
   * @param  Len: Dimension in Bytes.
   * @param  attr_handle: Handle of the updated characteristic.
   * @param  buffer_out: 16-bit PCM samples destination buffer.
-  * @param  samples: Number of 16-bit PCM samples in the destination buffer.
-  * @retval BV_3_x_Status: Value indicating success or error code.
+  * @param  samples: Number of 16-bit PCM samples written to the destination buffer.
+  *         buffer_out must hold BV_ADPCM_3_x_RX_SAMPLES(Len) samples: it depends on the
+  *         bitrate chosen by the peer, carried by the side information.
+  * @retval BV_3_x_Status: Value indicating success or error code, BV_PCM_SAMPLES_ERR
+  *         (nothing decoded) if Len bytes would give more than BV_ADPCM_3_x_RX_MAX_SAMPLES samples.
   */
 BV_3_x_Status BluevoiceADPCM_3_x_ParseData(uint8_t* buffer_in, uint32_t Len, uint16_t attr_handle, uint8_t* buffer_out, uint8_t *samples)
 {
+  return BluevoiceADPCM_3_x_ParseLinkData(DEFAULT_LINK->ConnectionHandle, buffer_in, Len, attr_handle, buffer_out, samples);
+}
+
+/**
+  * @brief  This function is called to parse data received on a given connection.
+  * @param  conn_handle: Connection handle on which the notification has been received.
+  * @param  buffer_in: 8-bit packed ADPCM samples source buffer.
+  * @param  Len: Dimension in Bytes.
+  * @param  attr_handle: Handle of the updated characteristic.
+  * @param  buffer_out: 16-bit PCM samples destination buffer.
+  * @param  samples: Number of 16-bit PCM samples written to the destination buffer.
+  *         buffer_out must hold BV_ADPCM_3_x_RX_SAMPLES(Len) samples: it depends on the
+  *         bitrate chosen by the peer, carried by the side information.
+  * @retval BV_3_x_Status: Value indicating success or error code, BV_PCM_SAMPLES_ERR
+  *         (nothing decoded) if Len bytes would give more than BV_ADPCM_3_x_RX_MAX_SAMPLES samples.
+  */
+BV_3_x_Status BluevoiceADPCM_3_x_ParseLinkData(uint16_t conn_handle, uint8_t* buffer_in, uint32_t Len, uint16_t attr_handle, uint8_t* buffer_out, uint8_t *samples)
+{
+  BV_ADPCM_3_x_LinkTypeDef *pLink = BluevoiceADPCM_3_x_GetLink(conn_handle);
+  uint32_t n = 0;
+
   *samples = 0;
-  
-  if((hBV_ADPCM_3_x.mode == HALF_DUPLEX) || (hBV_ADPCM_3_x.mode == RECEIVER))
+
+  if(pLink == NULL)
+  {
+    return BV_LINK_NOT_AVAILABLE;
+  }
+
+  if((pLink->mode == HALF_DUPLEX) || (pLink->mode == RECEIVER))
   {
-    if (attr_handle == hBV_ADPCM_3_x.BV_handle_RX.CharAudioHandle + 1)
+    if (attr_handle == pLink->BV_handle_RX.CharAudioHandle + 1)
     {
-      hBV_ADPCM_3_x.STATUS_timeutCount = 0;   
-      BluevoiceADPCM_3_x_WriteStateMachine(BLUEVOICE_STATUS_RECEIVING);
-        
-      for (uint8_t i = 0; i < Len; i++)
+      /* The number of decoded samples is returned on 8 bits */
+      if ((Len > BV_ADPCM_3_x_RX_MAX_SAMPLES) ||
+          (((pLink->RxBitCnt + 8 * Len) / pLink->Decode.bits) > BV_ADPCM_3_x_RX_MAX_SAMPLES))
+      {
+        return BV_PCM_SAMPLES_ERR;
+      }
+
+      pLink->STATUS_timeutCount = 0;
+      BluevoiceADPCM_3_x_WriteStateMachine(pLink, BLUEVOICE_STATUS_RECEIVING);
+
+      for (uint32_t i = 0; i < Len; i++)
       {
-        ((int16_t *) (buffer_out))[2 * i] = (int16_t) BluevoiceADPCM_3_x_Decode(&hBV_ADPCM_Decode, (uint8_t) (buffer_in[i] & 0x0F));
-        ((int16_t *) (buffer_out))[2 * i + 1] = (int16_t) BluevoiceADPCM_3_x_Decode(&hBV_ADPCM_Decode, (uint8_t) (buffer_in[i] >> 4) & 0x0F);
+        /* Codes are packed starting from the least significant bit and can span two bytes */
+        pLink->RxBitAcc |= (uint32_t)buffer_in[i] << pLink->RxBitCnt;
+        pLink->RxBitCnt += 8;
+        while (pLink->RxBitCnt >= pLink->Decode.bits)
+        {
+          ((int16_t *) (buffer_out))[n++] = (int16_t) BluevoiceADPCM_3_x_Decode(&pLink->Decode,
+                                                                              (uint8_t) (pLink->RxBitAcc & ((1U << pLink->Decode.bits) - 1)));
+          pLink->RxBitAcc >>= pLink->Decode.bits;
+          pLink->RxBitCnt -= pLink->Decode.bits;
+        }
       }
-      *samples = Len * 4 / 2;
+      *samples = (uint8_t)n;
       return BV_SUCCESS;
     }
-    else if (attr_handle == hBV_ADPCM_3_x.BV_handle_RX.CharAudioSyncHandle + 1)
+    else if (attr_handle == pLink->BV_handle_RX.CharAudioSyncHandle + 1)
     {
-      BluevoiceADPCM_3_x_SyncIn(&hBV_ADPCM_Decode, (uint8_t*) buffer_in);
+      BluevoiceADPCM_3_x_SyncIn(&pLink->Decode, (uint8_t*) buffer_in);
+      pLink->RxBitAcc = 0;
+      pLink->RxBitCnt = 0;
       return BV_SUCCESS;
     }
     else
@@ -753,115 +1048,307 @@ BV_3_x_Status BluevoiceADPCM_3_x_ParseData(uint8_t* buffer_in, uint32_t Len, uin
     return BV_RECEIVER_DISABLE;
   }
 }
+
 /**
  * @brief  This function is called to send data.
+ *         Connections with a frame ready are served in round robin order: when the
+ *         TX pool is full, the next call resumes from the connection that could not
+ *         be served, then the first connection served is rotated at each call.
  * @param  None
  * @retval BV_3_x_Status: Value indicating success or error code.
  */
 BV_3_x_Status BluevoiceADPCM_3_x_SendData(void)
 {
-  //uint8_t ret = 0; 
-  
-  
-  if(hBV_ADPCM_3_x.AudioNotifEnabled && hBV_ADPCM_3_x.AudioSyncNotifEnabled)
+  BV_3_x_Status ret = BV_NOTIF_DISABLE;
+
+  for(uint8_t n = 0; n < BV_ADPCM_3_x_MAX_LINKS; n++)
   {
-    uint32_t len = 0;
-    
-    hBV_ADPCM_3_x.STATUS_timeutCount = 0;
-    
-    BluevoiceADPCM_3_x_WriteStateMachine(BLUEVOICE_STATUS_STREAMING);
-  
-    
-#if defined(EXT_DATA_PCK)
-    
-    if (aci_gatt_srv_notify(hBV_ADPCM_3_x.ConnectionHandle, hBV_ADPCM_3_x.BV_handle.CharAudioHandle+1,0, hBV_ADPCM_3_x.Nb_bytes_audio, (uint8_t *) BV_ADPCM_3_x_AudioOUT_Buffer)==BLE_STATUS_INSUFFICIENT_RESOURCES)
+    uint8_t idx = (hBV_ADPCM_3_x.SendLinkIdx + n) % BV_ADPCM_3_x_MAX_LINKS;
+    BV_ADPCM_3_x_LinkTypeDef *pLink = &hBV_ADPCM_3_x.link[idx];
+
+    if(!pLink->connected || !pLink->AudioNotifEnabled || !pLink->AudioSyncNotifEnabled)
+    {
+      continue;
+    }
+
+    if(BluevoiceADPCM_3_x_SendLinkData(pLink) == BV_INSUFFICIENT_RESOURCES)
     {
+      hBV_ADPCM_3_x.SendLinkIdx = idx;
       return BV_INSUFFICIENT_RESOURCES;
     }
-    hBV_ADPCM_3_x.p_out_bytes += hBV_ADPCM_3_x.Nb_bytes_audio;
-    
-#else
-    while (hBV_ADPCM_3_x.p_out_bytes < hBV_ADPCM_3_x.Nb_bytes_audio)
+    ret = BV_SUCCESS;
+  }
+
+  hBV_ADPCM_3_x.SendLinkIdx = (hBV_ADPCM_3_x.SendLinkIdx + 1) % BV_ADPCM_3_x_MAX_LINKS;
+
+  return ret;
+}
+
+/**
+ * @}
+ */
+
+/** @defgroup BV_ADPCM_3_x_Private_Functions
+ * @{
+ */
+
+/**
+ * @brief  This function is called to write BLUEVOICE Profile StateMachine status.
+ * @param  pLink: BlueVoice link.
+ * @param  State status to be written.
+ * @retval None.
+ */
+static void BluevoiceADPCM_3_x_WriteStateMachine(BV_ADPCM_3_x_LinkTypeDef *pLink, BV_Profile_Status State)
+{
+  pLink->ProfileState = State;
+}
+
+/**
+ * @brief  This function is called to get the link associated to a connection handle.
+ * @param  conn_handle: Connection handle.
+ * @retval Pointer to the link, NULL if no link is associated to conn_handle.
+ */
+static BV_ADPCM_3_x_LinkTypeDef *BluevoiceADPCM_3_x_GetLink(uint16_t conn_handle)
+{
+  for(uint8_t i = 0; i < BV_ADPCM_3_x_MAX_LINKS; i++)
+  {
+    if(hBV_ADPCM_3_x.link[i].connected && (hBV_ADPCM_3_x.link[i].ConnectionHandle == conn_handle))
     {
-      len = MIN(20, hBV_ADPCM_3_x.Nb_bytes_audio - hBV_ADPCM_3_x.p_out_bytes);
-   
-      if(aci_gatt_srv_notify(hBV_ADPCM_3_x.ConnectionHandle, hBV_ADPCM_3_x.BV_handle.CharAudioHandle+1 , 0,
-                                    len, (uint8_t *) BV_ADPCM_3_x_AudioOUT_Buffer + hBV_ADPCM_3_x.p_out_bytes)==BLE_STATUS_INSUFFICIENT_RESOURCES)
+      return &hBV_ADPCM_3_x.link[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief  This function is called to reset the streaming state of a link.
+ * @param  pLink: BlueVoice link.
+ * @retval None.
+ */
+static void BluevoiceADPCM_3_x_LinkReset(BV_ADPCM_3_x_LinkTypeDef *pLink)
+{
+  pLink->ADPCMBuffCnt = 0;
+  pLink->FrameSampleCnt = 0;
+  pLink->BitAcc = 0;
+  pLink->BitCnt = 0;
+  pLink->RxBitAcc = 0;
+  pLink->RxBitCnt = 0;
+  pLink->FrameCounter = SIDE_INF_FRAME_INTERVAL-1;
+  pLink->ADPCMBuffReady = 0;
+  pLink->STATUS_timeutCount = 0;
+  pLink->CleanFrames = 0;
+  pLink->TxStalled = 0;
+  pLink->ConnIntervalMs = FRAME_DURATION_MS;
+  BluevoiceADPCM_3_x_Reset(&pLink->Encode);
+  BluevoiceADPCM_3_x_Reset(&pLink->Decode);
+  /* Both ends start with 4-bit codes, any other bitrate is signalled in the side information */
+  pLink->Encode.bits = 4;
+  pLink->Decode.bits = 4;
+  pLink->NextTxBits = 4;
+}
+
+/**
+ * @brief  This function is called to encode PCM samples in the current frame of a link.
+ * @param  pLink: BlueVoice link.
+ * @param  pcm: first 16-bit PCM sample of the selected channel.
+ * @param  stride: distance, in samples, between two consecutive samples of the selected channel.
+ * @param  Nsamples: number of samples to be encoded.
+ * @retval None.
+ */
+static void BluevoiceADPCM_3_x_EncodeSamples(BV_ADPCM_3_x_LinkTypeDef *pLink, const int16_t *pcm, uint32_t stride, uint32_t Nsamples)
+{
+  uint8_t *adpcm = &pLink->AudioIN_Buffer[pLink->ADPCMBuffCnt];
+  uint8_t bits = pLink->Encode.bits;
+
+  if ((bits == 4) && (pLink->BitCnt == 0))
+  {
+    /* Byte aligned 4-bit codes: the sample pairs go through the block encoder */
+    uint32_t Nbytes = Nsamples / 2;
+
+    BluevoiceADPCM_3_x_EncodeBlock(&pLink->Encode, pcm, stride, adpcm, Nbytes);
+    adpcm += Nbytes;
+    pcm += 2 * Nbytes * stride;
+    Nsamples -= 2 * Nbytes;
+  }
+
+  /* Codes are packed starting from the least significant bit and can span two bytes */
+  for (; Nsamples > 0; Nsamples--)
+  {
+    pLink->BitAcc |= (uint32_t)BluevoiceADPCM_3_x_Encode(&pLink->Encode, *pcm) << pLink->BitCnt;
+    pLink->BitCnt += bits;
+    pcm += stride;
+    if (pLink->BitCnt >= 8)
+    {
+      *adpcm++ = (uint8_t)pLink->BitAcc;
+      pLink->BitAcc >>= 8;
+      pLink->BitCnt -= 8;
+    }
+  }
+
+  pLink->ADPCMBuffCnt = (uint16_t)(adpcm - pLink->AudioIN_Buffer);
+}
+
+/**
+ * @brief  This function is called, when a frame is complete, to choose the bitrate of the next frames.
+ *         In adaptive mode the bitrate is decreased when the previous frame has not been sent yet or
+ *         when the GATT TX pool has been full for more than a connection interval, i.e. the stack could
+ *         not send the pending notifications at the last connection event. It is increased again after
+ *         BV_ADPCM_3_x_BITRATE_UP_TIME ms without congestion.
+ *         A new bitrate is applied after the side information of the current frame, that carries it.
+ * @param  pLink: BlueVoice link.
+ * @retval None.
+ */
+static void BluevoiceADPCM_3_x_UpdateBitrate(BV_ADPCM_3_x_LinkTypeDef *pLink)
+{
+  uint8_t overrun = (pLink->ADPCMBuffReady != 0);
+  uint8_t congested;
+
+  if (overrun)
+  {
+    /* The peer decoder misses (part of) the dropped frame: resynchronize it with this frame */
+    pLink->FrameCounter = SIDE_INF_FRAME_INTERVAL-1;
+  }
+
+  if (hBV_ADPCM_3_x.Bitrate != BV_BITRATE_ADAPTIVE)
+  {
+    pLink->NextTxBits = (hBV_ADPCM_3_x.Bitrate == BV_BITRATE_4_BIT) ? 4 : (uint8_t)hBV_ADPCM_3_x.Bitrate;
+  }
+  else if (pLink->NextTxBits == pLink->Encode.bits)
+  {
+    congested = overrun || (pLink->TxStalled && ((hBV_ADPCM_3_x.Tick - pLink->StallStart) >= pLink->ConnIntervalMs));
+
+    if (congested)
+    {
+      pLink->CleanFrames = 0;
+      if (pLink->NextTxBits > 2)
       {
-        return BV_INSUFFICIENT_RESOURCES;
-       
+        pLink->NextTxBits--;
       }
- 
-      hBV_ADPCM_3_x.p_out_bytes += len;
     }
-#endif  
-    
-    if(hBV_ADPCM_3_x.Nb_bytes_sync>0)
+    else if (++pLink->CleanFrames >= BITRATE_UP_FRAMES)
     {
-      if(aci_gatt_srv_notify(hBV_ADPCM_3_x.ConnectionHandle, hBV_ADPCM_3_x.BV_handle.CharAudioSyncHandle+1, 0, 6, (uint8_t *) BV_ADPCM_3_x_AudioOUT_Buffer + hBV_ADPCM_3_x.p_out_bytes)==BLE_STATUS_INSUFFICIENT_RESOURCES)
+      pLink->CleanFrames = 0;
+      if (pLink->NextTxBits < 4)
       {
-        return BV_INSUFFICIENT_RESOURCES;
+        pLink->NextTxBits++;
       }
-    }   
-    
-    hBV_ADPCM_3_x.ADPCMBuffReady = 0;
-    
-    return BV_SUCCESS;
+    }
   }
-  else
+
+  if (pLink->NextTxBits != pLink->Encode.bits)
   {
-    return BV_NOTIF_DISABLE; 
+    /* Send the side information with this frame */
+    pLink->FrameCounter = SIDE_INF_FRAME_INTERVAL-1;
   }
 }
 
 /**
- * @}
+ * @brief  This function is called to send the pending data of a link.
+ * @param  pLink: BlueVoice link.
+ * @retval BV_3_x_Status: Value indicating success or error code.
  */
+static BV_3_x_Status BluevoiceADPCM_3_x_SendLinkData(BV_ADPCM_3_x_LinkTypeDef *pLink)
+{
+  uint32_t len = 0;
 
-/** @defgroup BV_ADPCM_3_x_Private_Functions
- * @{
- */
+  if(pLink->ADPCMBuffReady == 0)
+  {
+    return BV_SUCCESS;
+  }
+
+  pLink->STATUS_timeutCount = 0;
+
+  BluevoiceADPCM_3_x_WriteStateMachine(pLink, BLUEVOICE_STATUS_STREAMING);
+
+#if defined(EXT_DATA_PCK)
+
+  if(pLink->p_out_bytes < pLink->Nb_bytes_audio)
+  {
+    if (aci_gatt_srv_notify(pLink->ConnectionHandle, hBV_ADPCM_3_x.BV_handle.CharAudioHandle+1,0, pLink->Nb_bytes_audio, (uint8_t *) pLink->AudioOUT_Buffer)==BLE_STATUS_INSUFFICIENT_RESOURCES)
+    {
+      return BluevoiceADPCM_3_x_TxPoolFull(pLink);
+    }
+    pLink->p_out_bytes += pLink->Nb_bytes_audio;
+  }
+
+#else
+  while (pLink->p_out_bytes < pLink->Nb_bytes_audio)
+  {
+    len = MIN(20, pLink->Nb_bytes_audio - pLink->p_out_bytes);
+
+    if(aci_gatt_srv_notify(pLink->ConnectionHandle, hBV_ADPCM_3_x.BV_handle.CharAudioHandle+1 , 0,
+                           len, (uint8_t *) pLink->AudioOUT_Buffer + pLink->p_out_bytes)==BLE_STATUS_INSUFFICIENT_RESOURCES)
+    {
+      return BluevoiceADPCM_3_x_TxPoolFull(pLink);
+    }
+
+    pLink->p_out_bytes += len;
+  }
+#endif
+
+  if(pLink->Nb_bytes_sync>0)
+  {
+    if(aci_gatt_srv_notify(pLink->ConnectionHandle, hBV_ADPCM_3_x.BV_handle.CharAudioSyncHandle+1, 0, 6, (uint8_t *) pLink->AudioOUT_Buffer + pLink->p_out_bytes)==BLE_STATUS_INSUFFICIENT_RESOURCES)
+    {
+      return BluevoiceADPCM_3_x_TxPoolFull(pLink);
+    }
+  }
+
+  pLink->ADPCMBuffReady = 0;
+  pLink->TxStalled = 0;
+
+  return BV_SUCCESS;
+}
 
 /**
- * @brief  This function is called to write BLUEVOICE Profile StateMachine status.
- * @param  State status to be written.
- * @retval None.
+ * @brief  This function is called when a notification fails because the GATT TX pool is full.
+ * @param  pLink: BlueVoice link.
+ * @retval BV_INSUFFICIENT_RESOURCES.
  */
-static void BluevoiceADPCM_3_x_WriteStateMachine(BV_Profile_Status State) 
+static BV_3_x_Status BluevoiceADPCM_3_x_TxPoolFull(BV_ADPCM_3_x_LinkTypeDef *pLink)
 {
-  hBV_ADPCM_3_x.ProfileState = State;
+  if(!pLink->TxStalled)
+  {
+    pLink->TxStalled = 1;
+    pLink->StallStart = hBV_ADPCM_3_x.Tick;
+  }
+  return BV_INSUFFICIENT_RESOURCES;
 }
 
 /**
  * @brief  This function is called to encode audio data.
- * @param  buffer_out: 8-bit packed ADPCM samples destination buffer.
+ * @param  pLink: BlueVoice link.
  * @param  buffer_in: 16-bit PCM samples source buffer.
  * @param  Len: dimension in Bytes.
  * @retval buffer out size.
  */
-static uint8_t BluevoiceADPCM_3_x_PrepareBuffOut(uint8_t* buffer_out, uint8_t* buffer_in, uint32_t Len)
-{ 
+static uint8_t BluevoiceADPCM_3_x_PrepareBuffOut(BV_ADPCM_3_x_LinkTypeDef *pLink, uint8_t* buffer_in, uint32_t Len)
+{
+  uint8_t* buffer_out = pLink->AudioOUT_Buffer;
+
   memcpy((uint8_t *) buffer_out, (uint8_t *) buffer_in, Len);
-   
-  hBV_ADPCM_3_x.FrameCounter++;
-  
-  if (hBV_ADPCM_3_x.FrameCounter == SIDE_INF_FRAME_INTERVAL)
+
+  pLink->FrameCounter++;
+
+  if (pLink->FrameCounter == SIDE_INF_FRAME_INTERVAL)
   {
-    hBV_ADPCM_3_x.FrameCounter = 0;
-    BluevoiceADPCM_3_x_SyncOut(&hBV_ADPCM_Encode,
+    pLink->FrameCounter = 0;
+    /* The next frames are encoded with the bitrate carried by the side information */
+    pLink->Encode.bits = pLink->NextTxBits;
+    BluevoiceADPCM_3_x_SyncOut(&pLink->Encode,
                             (uint8_t *) &buffer_out[Len]);
-    hBV_ADPCM_3_x.Nb_bytes_audio = hBV_ADPCM_3_x.OUTBuffSize - SIDE_INF_SIZE_u8;
-    hBV_ADPCM_3_x.Nb_bytes_sync = SIDE_INF_SIZE_u8;
-    hBV_ADPCM_3_x.p_out_bytes = 0;
-    return  hBV_ADPCM_3_x.OUTBuffSize;
+    pLink->Nb_bytes_audio = Len;
+    pLink->Nb_bytes_sync = SIDE_INF_SIZE_u8;
+    pLink->p_out_bytes = 0;
+    return  Len + SIDE_INF_SIZE_u8;
   }
   else
   {
     memset((uint8_t *) &buffer_out[Len], 0, SIDE_INF_SIZE_u8);
-    hBV_ADPCM_3_x.Nb_bytes_audio = hBV_ADPCM_3_x.OUTBuffSize - SIDE_INF_SIZE_u8;
-    hBV_ADPCM_3_x.Nb_bytes_sync = 0;
-    hBV_ADPCM_3_x.p_out_bytes = 0;
-    return ( hBV_ADPCM_3_x.OUTBuffSize - SIDE_INF_SIZE_u8);
+    pLink->Nb_bytes_audio = Len;
+    pLink->Nb_bytes_sync = 0;
+    pLink->p_out_bytes = 0;
+    return Len;
   }
 }
 
@@ -875,37 +1362,63 @@ static uint8_t BluevoiceADPCM_3_x_PrepareBuffOut(uint8_t* buffer_out, uint8_t* b
 
 /**
   * @brief  This function must be called when there is a LE Connection Complete event.
+  *         A free link is associated to the connection, if any.
   * @param  handle: Connection handle.
   * @retval None.
   */
 void BluevoiceADPCM_3_x_ConnectionComplete_CB(uint16_t handle)
 {
-  hBV_ADPCM_3_x.ConnectionHandle = handle;
-  hBV_ADPCM_3_x.connected = 1;
+  for(uint8_t i = 0; i < BV_ADPCM_3_x_MAX_LINKS; i++)
+  {
+    BV_ADPCM_3_x_LinkTypeDef *pLink = &hBV_ADPCM_3_x.link[i];
+
+    if(!pLink->connected)
+    {
+      pLink->ConnectionHandle = handle;
+      pLink->connected = 1;
+      return;
+    }
+  }
+  PRINTF("No BlueVoice link available\n");
 }
 
 /**
-  * @brief  This function must be called when there is a LE disconnection Complete event. 
+  * @brief  This function must be called when there is a LE disconnection Complete event.
   * @param  None.
   * @retval None.
   */
 void BluevoiceADPCM_3_x_DisconnectionComplete_CB(void)
 {
-  BluevoiceADPCM_3_x_WriteStateMachine(BLUEVOICE_STATUS_INITIALIZED);
-
-  hBV_ADPCM_3_x.connected = 0;
-  hBV_ADPCM_3_x.AudioNotifEnabled = 0;
-  hBV_ADPCM_3_x.AudioSyncNotifEnabled = 0;
-  hBV_ADPCM_3_x.ConnectionHandle = 0;
-  hBV_ADPCM_3_x.ADPCMBuffCnt = 0;        
-  hBV_ADPCM_3_x.FrameCounter = SIDE_INF_FRAME_INTERVAL-1; 
-  hBV_ADPCM_3_x.ADPCMBuffReady = 0;
-  hBV_ADPCM_3_x.STATUS_timeutCount = 0;
-  hBV_ADPCM_3_x.mode = NOT_READY;
+  BluevoiceADPCM_3_x_LinkDisconnectionComplete_CB(DEFAULT_LINK->ConnectionHandle);
+}
+
+/**
+  * @brief  This function must be called when there is a LE disconnection Complete event,
+  *         if more than one connection is used.
+  * @param  handle: Connection handle.
+  * @retval None.
+  */
+void BluevoiceADPCM_3_x_LinkDisconnectionComplete_CB(uint16_t handle)
+{
+  BV_ADPCM_3_x_LinkTypeDef *pLink = BluevoiceADPCM_3_x_GetLink(handle);
+
+  if(pLink == NULL)
+  {
+    return;
+  }
+
+  BluevoiceADPCM_3_x_WriteStateMachine(pLink, BLUEVOICE_STATUS_INITIALIZED);
+
+  pLink->connected = 0;
+  pLink->AudioNotifEnabled = 0;
+  pLink->AudioSyncNotifEnabled = 0;
+  pLink->ConnectionHandle = LINK_INVALID_HANDLE;
+  BluevoiceADPCM_3_x_LinkReset(pLink);
+  pLink->mode = NOT_READY;
 }
 
 /**
-  * @brief  This function must be called when there is a LE attribut modified event. 
+  * @brief  This function must be called when there is a LE attribut modified event.
   * @param  attr_handle: Attribute handle.
   * @param  attr_len: Attribute length.
   * @param  attr_value: Attribute value.
@@ -913,65 +1426,101 @@ void BluevoiceADPCM_3_x_DisconnectionComplete_CB(void)
   */
 void BluevoiceADPCM_3_x_AttributeModified_CB(uint16_t attr_handle, uint8_t attr_len, uint8_t *attr_value)
 {
+  BluevoiceADPCM_3_x_LinkAttributeModified_CB(DEFAULT_LINK->ConnectionHandle, attr_handle, attr_len, attr_value);
+}
+
+/**
+  * @brief  This function must be called when there is a LE attribut modified event,
+  *         if more than one connection is used.
+  * @param  conn_handle: Connection handle.
+  * @param  attr_handle: Attribute handle.
+  * @param  attr_len: Attribute length.
+  * @param  attr_value: Attribute value.
+  * @retval None.
+  */
+void BluevoiceADPCM_3_x_LinkAttributeModified_CB(uint16_t conn_handle, uint16_t attr_handle, uint8_t attr_len, uint8_t *attr_value)
+{
+  BV_ADPCM_3_x_LinkTypeDef *pLink = BluevoiceADPCM_3_x_GetLink(conn_handle);
+
+  if(pLink == NULL)
+  {
+    return;
+  }
+
   if (attr_handle == hBV_ADPCM_3_x.BV_handle.CharAudioHandle + 2)
   {
     if (attr_value[0] == 0x01)
     {
-      hBV_ADPCM_3_x.AudioNotifEnabled = 1;
-      if(hBV_ADPCM_3_x.AudioSyncNotifEnabled)
+      pLink->AudioNotifEnabled = 1;
+      if(pLink->AudioSyncNotifEnabled)
       {
-        if(hBV_ADPCM_3_x.mode == NOT_READY)
+        if(pLink->mode == NOT_READY)
         {
-          hBV_ADPCM_3_x.mode = TRANSMITTER;
+          pLink->mode = TRANSMITTER;
         }
-        else if(hBV_ADPCM_3_x.mode == RECEIVER)
+        else if(pLink->mode == RECEIVER)
         {
-          hBV_ADPCM_3_x.mode = HALF_DUPLEX;
+          pLink->mode = HALF_DUPLEX;
         }
-        BluevoiceADPCM_3_x_WriteStateMachine(BLUEVOICE_STATUS_READY);   
+        BluevoiceADPCM_3_x_WriteStateMachine(pLink, BLUEVOICE_STATUS_READY);
       }
     }
     else if(attr_value[0] == 0x00)
     {
-      if(hBV_ADPCM_3_x.mode == TRANSMITTER)
+      if(pLink->mode == TRANSMITTER)
       {
-        hBV_ADPCM_3_x.mode = NOT_READY;
+        pLink->mode = NOT_READY;
       }
-      else if(hBV_ADPCM_3_x.mode == HALF_DUPLEX)
+      else if(pLink->mode == HALF_DUPLEX)
       {
-        hBV_ADPCM_3_x.mode = RECEIVER;
+        pLink->mode = RECEIVER;
       }
-    }  
+    }
   }
   else if (attr_handle == hBV_ADPCM_3_x.BV_handle.CharAudioSyncHandle + 2)
   {
     if (attr_value[0] == 0x01)
     {
-      hBV_ADPCM_3_x.AudioSyncNotifEnabled = 1;
-      if(hBV_ADPCM_3_x.AudioNotifEnabled)
+      pLink->AudioSyncNotifEnabled = 1;
+      if(pLink->AudioNotifEnabled)
       {
-        if(hBV_ADPCM_3_x.mode == NOT_READY)
+        if(pLink->mode == NOT_READY)
         {
-          hBV_ADPCM_3_x.mode = TRANSMITTER;
+          pLink->mode = TRANSMITTER;
         }
-        else if(hBV_ADPCM_3_x.mode == RECEIVER)
+        else if(pLink->mode == RECEIVER)
         {
-          hBV_ADPCM_3_x.mode = HALF_DUPLEX;
+          pLink->mode = HALF_DUPLEX;
         }
-        BluevoiceADPCM_3_x_WriteStateMachine(BLUEVOICE_STATUS_READY);
+        BluevoiceADPCM_3_x_WriteStateMachine(pLink, BLUEVOICE_STATUS_READY);
       }
     }
     else if(attr_value[0] == 0x00)
     {
-      if(hBV_ADPCM_3_x.mode == TRANSMITTER)
+      if(pLink->mode == TRANSMITTER)
       {
-        hBV_ADPCM_3_x.mode = NOT_READY;
+        pLink->mode = NOT_READY;
       }
-      else if(hBV_ADPCM_3_x.mode == HALF_DUPLEX)
+      else if(pLink->mode == HALF_DUPLEX)
       {
-        hBV_ADPCM_3_x.mode = RECEIVER;
+        pLink->mode = RECEIVER;
       }
-    }     
+    }
+  }
+}
+
+/**
+  * @brief  This function must be called when there is a GATT TX pool available event.
+  * @param  conn_handle: Connection handle.
+  * @retval None.
+  */
+void BluevoiceADPCM_3_x_TxPoolAvailable_CB(uint16_t conn_handle)
+{
+  BV_ADPCM_3_x_LinkTypeDef *pLink = BluevoiceADPCM_3_x_GetLink(conn_handle);
+
+  if(pLink != NULL)
+  {
+    pLink->TxStalled = 0;
   }
 }
 
@@ -997,97 +1546,329 @@ static const uint16_t StepSizeTable[89] = {7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
                                           };
 /* Table of index changes */
 static const int8_t IndexTable[16] = {0xff, 0xff, 0xff, 0xff, 2, 4, 6, 8, 0xff, 0xff, 0xff, 0xff, 2, 4, 6, 8};
+/* Table of index changes for 3-bit codes */
+static const int8_t IndexTable_3bit[8] = {0xff, 0xff, 2, 4, 0xff, 0xff, 2, 4};
+/* Table of index changes for 2-bit codes */
+static const int8_t IndexTable_2bit[4] = {0xff, 2, 0xff, 2};
+
+/* Tables used by the block encoder, derived from StepSizeTable and IndexTable:
+   they replace the inverse quantization and the index update (with its
+   saturation) by a single lookup each. */
+/* Inverse quantized difference for each step index and 3-bit magnitude code */
+static const uint16_t DiffqTable[89][8] = {
+  {    0,     1,     3,     4,     7,     8,    10,    11},
+  {    1,     3,     5,     7,     9,    11,    13,    15},
+  {    1,     3,     5,     7,    10,    12,    14,    16},
+  {    1,     3,     6,     8,    11,    13,    16,    18},
+  {    1,     3,     6,     8,    12,    14,    17,    19},
+  {    1,     4,     7,    10,    13,    16,    19,    22},
+  {    1,     4,     7,    10,    14,    17,    20,    23},
+  {    1,     4,     8,    11,    15,    18,    22,    25},
+  {    2,     6,    10,    14,    18,    22,    26,    30},
+  {    2,     6,    10,    14,    19,    23,    27,    31},
+  {    2,     6,    11,    15,    21,    25,    30,    34},
+  {    2,     7,    12,    17,    23,    28,    33,    38},
+  {    2,     7,    13,    18,    25,    30,    36,    41},
+  {    3,     9,    15,    21,    28,    34,    40,    46},
+  {    3,    10,    17,    24,    31,    38,    45,    52},
+  {    3,    10,    18,    25,    34,    41,    49,    56},
+  {    4,    12,    21,    29,    38,    46,    55,    63},
+  {    4,    13,    22,    31,    41,    50,    59,    68},
+  {    5,    15,    25,    35,    46,    56,    66,    76},
+  {    5,    16,    27,    38,    50,    61,    72,    83},
+  {    6,    18,    31,    43,    56,    68,    81,    93},
+  {    6,    19,    33,    46,    61,    74,    88,   101},
+  {    7,    22,    37,    52,    67,    82,    97,   112},
+  {    8,    24,    41,    57,    74,    90,   107,   123},
+  {    9,    27,    45,    63,    82,   100,   118,   136},
+  {   10,    30,    50,    70,    90,   110,   130,   150},
+  {   11,    33,    55,    77,    99,   121,   143,   165},
+  {   12,    36,    60,    84,   109,   133,   157,   181},
+  {   13,    39,    66,    92,   120,   146,   173,   199},
+  {   14,    43,    73,   102,   132,   161,   191,   220},
+  {   16,    48,    81,   113,   146,   178,   211,   243},
+  {   17,    52,    88,   123,   160,   195,   231,   266},
+  {   19,    58,    97,   136,   176,   215,   254,   293},
+  {   21,    64,   107,   150,   194,   237,   280,   323},
+  {   23,    70,   118,   165,   213,   260,   308,   355},
+  {   26,    78,   130,   182,   235,   287,   339,   391},
+  {   28,    85,   143,   200,   258,   315,   373,   430},
+  {   31,    94,   157,   220,   284,   347,   410,   473},
+  {   34,   103,   173,   242,   313,   382,   452,   521},
+  {   38,   114,   191,   267,   345,   421,   498,   574},
+  {   42,   126,   210,   294,   379,   463,   547,   631},
+  {   46,   138,   231,   323,   417,   509,   602,   694},
+  {   51,   153,   255,   357,   459,   561,   663,   765},
+  {   56,   168,   280,   392,   505,   617,   729,   841},
+  {   61,   184,   308,   431,   555,   678,   802,   925},
+  {   68,   204,   340,   476,   612,   748,   884,  1020},
+  {   74,   223,   373,   522,   672,   821,   971,  1120},
+  {   82,   246,   411,   575,   740,   904,  1069,  1233},
+  {   90,   271,   452,   633,   814,   995,  1176,  1357},
+  {   99,   298,   497,   696,   895,  1094,  1293,  1492},
+  {  109,   328,   547,   766,   985,  1204,  1423,  1642},
+  {  120,   360,   601,   841,  1083,  1323,  1564,  1804},
+  {  132,   397,   662,   927,  1192,  1457,  1722,  1987},
+  {  145,   436,   728,  1019,  1311,  1602,  1894,  2185},
+  {  160,   480,   801,  1121,  1442,  1762,  2083,  2403},
+  {  176,   528,   881,  1233,  1587,  1939,  2292,  2644},
+  {  194,   582,   970,  1358,  1746,  2134,  2522,  2910},
+  {  213,   639,  1066,  1492,  1920,  2346,  2773,  3199},
+  {  234,   703,  1173,  1642,  2112,  2581,  3051,  3520},
+  {  258,   774,  1291,  1807,  2324,  2840,  3357,  3873},
+  {  284,   852,  1420,  1988,  2556,  3124,  3692,  4260},
+  {  312,   936,  1561,  2185,  2811,  3435,  4060,  4684},
+  {  343,  1030,  1717,  2404,  3092,  3779,  4466,  5153},
+  {  378,  1134,  1890,  2646,  3402,  4158,  4914,  5670},
+  {  415,  1246,  2078,  2909,  3742,  4573,  5405,  6236},
+  {  457,  1372,  2287,  3202,  4117,  5032,  5947,  6862},
+  {  503,  1509,  2516,  3522,  4529,  5535,  6542,  7548},
+  {  553,  1660,  2767,  3874,  4981,  6088,  7195,  8302},
+  {  608,  1825,  3043,  4260,  5479,  6696,  7914,  9131},
+  {  669,  2008,  3348,  4687,  6027,  7366,  8706, 10045},
+  {  736,  2209,  3683,  5156,  6630,  8103,  9577, 11050},
+  {  810,  2431,  4052,  5673,  7294,  8915, 10536, 12157},
+  {  891,  2674,  4457,  6240,  8023,  9806, 11589, 13372},
+  {  980,  2941,  4902,  6863,  8825, 10786, 12747, 14708},
+  { 1078,  3235,  5393,  7550,  9708, 11865, 14023, 16180},
+  { 1186,  3559,  5932,  8305, 10679, 13052, 15425, 17798},
+  { 1305,  3915,  6526,  9136, 11747, 14357, 16968, 19578},
+  { 1435,  4306,  7178, 10049, 12922, 15793, 18665, 21536},
+  { 1579,  4737,  7896, 11054, 14214, 17372, 20531, 23689},
+  { 1737,  5211,  8686, 12160, 15636, 19110, 22585, 26059},
+  { 1911,  5733,  9555, 13377, 17200, 21022, 24844, 28666},
+  { 2102,  6306, 10511, 14715, 18920, 23124, 27329, 31533},
+  { 2312,  6937, 11562, 16187, 20812, 25437, 30062, 34687},
+  { 2543,  7630, 12718, 17805, 22893, 27980, 33068, 38155},
+  { 2798,  8394, 13990, 19586, 25183, 30779, 36375, 41971},
+  { 3077,  9232, 15388, 21543, 27700, 33855, 40011, 46166},
+  { 3385, 10156, 16928, 23699, 30471, 37242, 44014, 50785},
+  { 3724, 11172, 18621, 26069, 33518, 40966, 48415, 55863},
+  { 4095, 12286, 20478, 28669, 36862, 45053, 53245, 61436}
+};
+/* Next step index for each step index and 3-bit magnitude code */
+static const uint8_t NextIndexTable[89][8] = {
+  { 0,  0,  0,  0,  2,  4,  6,  8},
+  { 0,  0,  0,  0,  3,  5,  7,  9},
+  { 1,  1,  1,  1,  4,  6,  8, 10},
+  { 2,  2,  2,  2,  5,  7,  9, 11},
+  { 3,  3,  3,  3,  6,  8, 10, 12},
+  { 4,  4,  4,  4,  7,  9, 11, 13},
+  { 5,  5,  5,  5,  8, 10, 12, 14},
+  { 6,  6,  6,  6,  9, 11, 13, 15},
+  { 7,  7,  7,  7, 10, 12, 14, 16},
+  { 8,  8,  8,  8, 11, 13, 15, 17},
+  { 9,  9,  9,  9, 12, 14, 16, 18},
+  {10, 10, 10, 10, 13, 15, 17, 19},
+  {11, 11, 11, 11, 14, 16, 18, 20},
+  {12, 12, 12, 12, 15, 17, 19, 21},
+  {13, 13, 13, 13, 16, 18, 20, 22},
+  {14, 14, 14, 14, 17, 19, 21, 23},
+  {15, 15, 15, 15, 18, 20, 22, 24},
+  {16, 16, 16, 16, 19, 21, 23, 25},
+  {17, 17, 17, 17, 20, 22, 24, 26},
+  {18, 18, 18, 18, 21, 23, 25, 27},
+  {19, 19, 19, 19, 22, 24, 26, 28},
+  {20, 20, 20, 20, 23, 25, 27, 29},
+  {21, 21, 21, 21, 24, 26, 28, 30},
+  {22, 22, 22, 22, 25, 27, 29, 31},
+  {23, 23, 23, 23, 26, 28, 30, 32},
+  {24, 24, 24, 24, 27, 29, 31, 33},
+  {25, 25, 25, 25, 28, 30, 32, 34},
+  {26, 26, 26, 26, 29, 31, 33, 35},
+  {27, 27, 27, 27, 30, 32, 34, 36},
+  {28, 28, 28, 28, 31, 33, 35, 37},
+  {29, 29, 29, 29, 32, 34, 36, 38},
+  {30, 30, 30, 30, 33, 35, 37, 39},
+  {31, 31, 31, 31, 34, 36, 38, 40},
+  {32, 32, 32, 32, 35, 37, 39, 41},
+  {33, 33, 33, 33, 36, 38, 40, 42},
+  {34, 34, 34, 34, 37, 39, 41, 43},
+  {35, 35, 35, 35, 38, 40, 42, 44},
+  {36, 36, 36, 36, 39, 41, 43, 45},
+  {37, 37, 37, 37, 40, 42, 44, 46},
+  {38, 38, 38, 38, 41, 43, 45, 47},
+  {39, 39, 39, 39, 42, 44, 46, 48},
+  {40, 40, 40, 40, 43, 45, 47, 49},
+  {41, 41, 41, 41, 44, 46, 48, 50},
+  {42, 42, 42, 42, 45, 47, 49, 51},
+  {43, 43, 43, 43, 46, 48, 50, 52},
+  {44, 44, 44, 44, 47, 49, 51, 53},
+  {45, 45, 45, 45, 48, 50, 52, 54},
+  {46, 46, 46, 46, 49, 51, 53, 55},
+  {47, 47, 47, 47, 50, 52, 54, 56},
+  {48, 48, 48, 48, 51, 53, 55, 57},
+  {49, 49, 49, 49, 52, 54, 56, 58},
+  {50, 50, 50, 50, 53, 55, 57, 59},
+  {51, 51, 51, 51, 54, 56, 58, 60},
+  {52, 52, 52, 52, 55, 57, 59, 61},
+  {53, 53, 53, 53, 56, 58, 60, 62},
+  {54, 54, 54, 54, 57, 59, 61, 63},
+  {55, 55, 55, 55, 58, 60, 62, 64},
+  {56, 56, 56, 56, 59, 61, 63, 65},
+  {57, 57, 57, 57, 60, 62, 64, 66},
+  {58, 58, 58, 58, 61, 63, 65, 67},
+  {59, 59, 59, 59, 62, 64, 66, 68},
+  {60, 60, 60, 60, 63, 65, 67, 69},
+  {61, 61, 61, 61, 64, 66, 68, 70},
+  {62, 62, 62, 62, 65, 67, 69, 71},
+  {63, 63, 63, 63, 66, 68, 70, 72},
+  {64, 64, 64, 64, 67, 69, 71, 73},
+  {65, 65, 65, 65, 68, 70, 72, 74},
+  {66, 66, 66, 66, 69, 71, 73, 75},
+  {67, 67, 67, 67, 70, 72, 74, 76},
+  {68, 68, 68, 68, 71, 73, 75, 77},
+  {69, 69, 69, 69, 72, 74, 76, 78},
+  {70, 70, 70, 70, 73, 75, 77, 79},
+  {71, 71, 71, 71, 74, 76, 78, 80},
+  {72, 72, 72, 72, 75, 77, 79, 81},
+  {73, 73, 73, 73, 76, 78, 80, 82},
+  {74, 74, 74, 74, 77, 79, 81, 83},
+  {75, 75, 75, 75, 78, 80, 82, 84},
+  {76, 76, 76, 76, 79, 81, 83, 85},
+  {77, 77, 77, 77, 80, 82, 84, 86},
+  {78, 78, 78, 78, 81, 83, 85, 87},
+  {79, 79, 79, 79, 82, 84, 86, 88},
+  {80, 80, 80, 80, 83, 85, 87, 88},
+  {81, 81, 81, 81, 84, 86, 88, 88},
+  {82, 82, 82, 82, 85, 87, 88, 88},
+  {83, 83, 83, 83, 86, 88, 88, 88},
+  {84, 84, 84, 84, 87, 88, 88, 88},
+  {85, 85, 85, 85, 88, 88, 88, 88},
+  {86, 86, 86, 86, 88, 88, 88, 88},
+  {87, 87, 87, 87, 88, 88, 88, 88}
+};
 
 /**
-* @brief  This function is called to Encode 16-bit PCM sample to 4-bit ADPCM sample.
+* @brief  This function is called to Encode 16-bit PCM sample to 2, 3 or 4-bit ADPCM sample.
+*         The code is made of a sign bit (MSB) and bits-1 magnitude bits: the 3 and 2-bit
+*         quantizers keep the most significant magnitude bits of the 4-bit one.
 * @param  hBV_ADPCM_3_x_Codec: BLUEVOICE ADPCM handler.
-* @param  sample: a 16-bit PCM sample
-* @retval a 4-bit ADPCM sample
+* @param  sample: a 16-bit PCM sample.
+* @retval ADPCM code (hBV_ADPCM_3_x_Codec->bits bits).
 */
-static uint8_t BluevoiceADPCM_3_x_Encode(BV_ADPCM_CodecHandleTypeDef *hBV_ADPCM_3_x_Codec, int32_t sample)
+static uint8_t BluevoiceADPCM_3_x_Encode(BV_ADPCM_CodecHandleTypeDef *hBV_ADPCM_3_x_Codec, int16_t sample)
 {
+  uint8_t bits = hBV_ADPCM_3_x_Codec->bits;
+  const int8_t *index_table = (bits == 4) ? IndexTable : ((bits == 3) ? IndexTable_3bit : IndexTable_2bit);
+  int32_t step = StepSizeTable[hBV_ADPCM_3_x_Codec->index];
+  int32_t diff = (int32_t)sample - hBV_ADPCM_3_x_Codec->predsample;
+  int32_t diffq = step >> (bits - 1);
   uint8_t code = 0;
-  uint16_t tmpstep = 0;
-  int32_t diff = 0;
-  int32_t diffq = 0;
-  uint16_t step = 0;
+  uint8_t mask;
   
-  step = StepSizeTable[hBV_ADPCM_3_x_Codec->index];
-  
-  /* 1. compute diff and record sign and absolut value */
-  diff = sample - hBV_ADPCM_3_x_Codec->predsample;
+  /* 1. compute the sign and the absolute value of the difference */
   if (diff < 0)
   {
-    code = 8;
+    code = 1U << (bits - 1);
     diff = -diff;
   }
   
-  /* 2. quantize the diff into ADPCM code */
-  /* 3. inverse quantize the code into a predicted diff */
-  tmpstep = step;
-  diffq = (step >> 3);
-  
-  
-  if (diff >= tmpstep)
-  {
-    code |= 0x04;
-    diff -= tmpstep;
-    diffq += step;
-  }
-  
-  tmpstep = tmpstep >> 1;
-  
-  
-  if (diff >= tmpstep)
-  {
-    code |= 0x02;
-    diff -= tmpstep;
-    diffq += (step >> 1);
-  }
-  
-  tmpstep = tmpstep >> 1;
-  
-  if (diff >= tmpstep)
+  /* 2. quantize the diff and inverse quantize it */
+  for (mask = 1U << (bits - 2); mask != 0; mask >>= 1)
   {
-    code |= 0x01;
-    diffq += (step >> 2);
+    if (diff >= step)
+    {
+      code |= mask;
+      diff -= step;
+      diffq += step;
+    }
+    step >>= 1;
   }
   
-  /* 4. fixed predictor to get new predicted sample*/
-  if (code & 8)
-  {
+  /* 3. update the predicted sample */
+  if (code & (1U << (bits - 1)))
     hBV_ADPCM_3_x_Codec->predsample -= diffq;
-  }
   else
-  {
     hBV_ADPCM_3_x_Codec->predsample += diffq;
-  }
-  
   
   /* check for overflow*/
   if (hBV_ADPCM_3_x_Codec->predsample > 32767)
-  {
     hBV_ADPCM_3_x_Codec->predsample = 32767;
-  }
   else if (hBV_ADPCM_3_x_Codec->predsample < -32768)
-  {
     hBV_ADPCM_3_x_Codec->predsample = -32768;
-  }
   
-  /* 5. find new stepsize hBV_ADPCM_3_x_Codec->index */
-  hBV_ADPCM_3_x_Codec->index += IndexTable[code];
+  /* 4. find new quantizer step size */
+  hBV_ADPCM_3_x_Codec->index += index_table[code];
   /* check for overflow*/
   if (hBV_ADPCM_3_x_Codec->index < 0)
-  {
     hBV_ADPCM_3_x_Codec->index = 0;
-  }
-  else if (hBV_ADPCM_3_x_Codec->index > 88)
-  {
+  if (hBV_ADPCM_3_x_Codec->index > 88)
     hBV_ADPCM_3_x_Codec->index = 88;
+  
+  return code;
+}
+
+/**
+* @brief  This function is called to Encode a block of 16-bit PCM samples to packed 4-bit ADPCM samples.
+*         The quantization is done without data dependent branches and the inverse
+*         quantization and index update use precomputed tables.
+* @param  hBV_ADPCM_3_x_Codec: BLUEVOICE ADPCM handler.
+* @param  pcm: first 16-bit PCM sample of the selected channel.
+* @param  stride: distance, in samples, between two consecutive samples of the selected channel.
+* @param  adpcm: destination buffer, two ADPCM samples per byte (first sample in the low nibble).
+* @param  Nbytes: number of bytes to produce (2*Nbytes PCM samples are consumed).
+* @retval None
+*/
+static void BluevoiceADPCM_3_x_EncodeBlock(BV_ADPCM_CodecHandleTypeDef *hBV_ADPCM_3_x_Codec, const int16_t *pcm,
+                                           uint32_t stride, uint8_t *adpcm, uint32_t Nbytes)
+{
+  int32_t predsample = hBV_ADPCM_3_x_Codec->predsample;
+  uint32_t index = (uint32_t)hBV_ADPCM_3_x_Codec->index;
+  uint8_t out = 0;
+  
+  for (uint32_t n = 0; n < 2 * Nbytes; n++)
+  {
+    int32_t diff = (int32_t)*pcm - predsample;
+    int32_t sign = -(int32_t)(diff < 0);        /* 0 or -1 */
+    uint32_t step = StepSizeTable[index];
+    uint32_t mag;
+    int32_t mask;
+    int32_t diffq;
+    
+    pcm += stride;
+    
+    /* 1. absolute value of the difference */
+    diff = (diff ^ sign) - sign;
+    
+    /* 2. quantize the diff into a 3-bit magnitude */
+    mask = -(int32_t)(diff >= (int32_t)step);
+    mag = (uint32_t)mask & 4;
+    diff -= mask & (int32_t)step;
+    mask = -(int32_t)(diff >= (int32_t)(step >> 1));
+    mag |= (uint32_t)mask & 2;
+    diff -= mask & (int32_t)(step >> 1);
+    mag |= (uint32_t)(diff >= (int32_t)(step >> 2));
+    
+    /* 3. inverse quantize and update the predicted sample */
+    diffq = DiffqTable[index][mag];
+    predsample += (diffq ^ sign) - sign;
+    if (predsample > 32767)
+    {
+      predsample = 32767;
+    }
+    else if (predsample < -32768)
+    {
+      predsample = -32768;
+    }
+    
+    /* 4. find new stepsize index */
+    index = NextIndexTable[index][mag];
+    
+    /* 5. pack the ADPCM code, first sample in the low nibble */
+    mag |= (uint32_t)sign & 8;
+    if (n & 1)
+    {
+      *adpcm++ = out | (uint8_t)(mag << 4);
+    }
+    else
+    {
+      out = (uint8_t)mag;
+    }
   }
   
-   /* 6. return new ADPCM code*/
-  return (code & 0x0f);
+  hBV_ADPCM_3_x_Codec->predsample = predsample;
+  hBV_ADPCM_3_x_Codec->index = (int16_t)index;
 }
 
 /**
@@ -1098,30 +1879,25 @@ static uint8_t BluevoiceADPCM_3_x_Encode(BV_ADPCM_CodecHandleTypeDef *hBV_ADPCM_
 */
 static int16_t BluevoiceADPCM_3_x_Decode(BV_ADPCM_CodecHandleTypeDef *hBV_ADPCM_3_x_Codec, uint8_t code)
 {
+  uint8_t bits = hBV_ADPCM_3_x_Codec->bits;
+  const int8_t *index_table = (bits == 4) ? IndexTable : ((bits == 3) ? IndexTable_3bit : IndexTable_2bit);
   uint16_t step = 0;
   int32_t diffq = 0;
+  uint8_t mask;
   
   step = StepSizeTable[hBV_ADPCM_3_x_Codec->index];
   
   /* 1. inverse code into diff */
-  diffq = step >> 3;
-  if (code & 4)
-  {
-    diffq += step;
-  }
-  
-  if (code & 2)
-  {
-    diffq += step >> 1;
-  }
-  
-  if (code & 1)
+  diffq = step >> (bits - 1);
+  for (mask = 1U << (bits - 2); mask != 0; mask >>= 1)
   {
-    diffq += step >> 2;
+    if (code & mask)
+      diffq += step;
+    step >>= 1;
   }
   
   /* 2. add diff to predicted sample*/
-  if (code & 8)
+  if (code & (1U << (bits - 1)))
   {
     hBV_ADPCM_3_x_Codec->predsample -= diffq;
   }
@@ -1141,7 +1917,7 @@ static int16_t BluevoiceADPCM_3_x_Decode(BV_ADPCM_CodecHandleTypeDef *hBV_ADPCM_
   }
   
   /* 3. find new quantizer step size */
-  hBV_ADPCM_3_x_Codec->index += IndexTable [code];
+  hBV_ADPCM_3_x_Codec->index += index_table[code];
   /* check for overflow*/
   if (hBV_ADPCM_3_x_Codec->index < 0)
   {
@@ -1165,7 +1941,10 @@ static int16_t BluevoiceADPCM_3_x_Decode(BV_ADPCM_CodecHandleTypeDef *hBV_ADPCM_
 static void  BluevoiceADPCM_3_x_SyncIn(BV_ADPCM_CodecHandleTypeDef *hBV_ADPCM_3_x_Codec, uint8_t* buffer)
 {
   hBV_ADPCM_3_x_Codec->index = ((int16_t)buffer[0]) & 0x00FF;
-  hBV_ADPCM_3_x_Codec->index |= ((int16_t)buffer[1] << 8) & 0xFF00;
+  /* Bits per code of the next frames, 0 for the 4-bit codes (index high byte of the previous versions) */
+  hBV_ADPCM_3_x_Codec->bits = ((buffer[1] == 2) || (buffer[1] == 3)) ? buffer[1] : 4;
+  if (hBV_ADPCM_3_x_Codec->index > 88)
+    hBV_ADPCM_3_x_Codec->index = 88;
   hBV_ADPCM_3_x_Codec->predsample = ((int32_t)buffer[2]) & 0x000000FF;
   hBV_ADPCM_3_x_Codec->predsample |= ((int32_t)buffer[3] << 8) & 0x0000FF00;
   hBV_ADPCM_3_x_Codec->predsample |= ((int32_t)buffer[4] << 16) & 0x00FF0000;
@@ -1182,7 +1961,7 @@ static void BluevoiceADPCM_3_x_SyncOut(BV_ADPCM_CodecHandleTypeDef *hBV_ADPCM_3_
 {
   /*-------------------side information---------------------------------------*/
   buffer[0] = (hBV_ADPCM_3_x_Codec->index & 0x00FF);
-  buffer[1] = (hBV_ADPCM_3_x_Codec->index >> 8) & 0x00FF;
+  buffer[1] = (hBV_ADPCM_3_x_Codec->bits == 4) ? 0 : hBV_ADPCM_3_x_Codec->bits;
   buffer[2] = (hBV_ADPCM_3_x_Codec->predsample & 0x000000FF);
   buffer[3] = (hBV_ADPCM_3_x_Codec->predsample >> 8) & 0x000000FF;
   buffer[4] = (hBV_ADPCM_3_x_Codec->predsample >> 16) & 0x000000FF;
@@ -0,0 +1,156 @@
+/**
+ ******************************************************************************
+ * @file    crc_manager.h
+ * @author  AMS - RF Application Team
+ * @brief   This file contains all the functions prototypes for the CRC MANAGER.
+ *
+ ******************************************************************************
+ * @attention
+ *
+ * <h2><center>&copy; COPYRIGHT(c) 2019 STMicroelectronics</center></h2>
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *   1. Redistributions of source code must retain the above copyright notice,
+ *      this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright notice,
+ *      this list of conditions and the following disclaimer in the documentation
+ *      and/or other materials provided with the distribution.
+ *   3. Neither the name of STMicroelectronics nor the names of its contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ******************************************************************************
+ */
+
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef CRCMGR_H
+#define CRCMGR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stdint.h"
+  
+/** @addtogroup CRCMGR_Peripheral  CRC MANAGER
+ * @{
+ */
+
+/** @defgroup CRCMGR_Exported_Types Exported Types
+ * @{
+ */
+	
+/* Enumerated values used to report the CRC result status after a process */
+typedef enum
+{
+  CRCMGR_SUCCESS     =  0,
+  CRCMGR_ERROR,
+  CRCMGR_ERROR_BUSY
+} CRCMGR_ResultStatus;
+
+typedef struct CRCMGR_Context CRCMGR_Context;
+
+/* Streaming context: CRC-32 of data provided in several parts, with CRCMGR_Update()
+   or CRCMGR_UpdateAsync(). The fields are read only for the application. */
+struct CRCMGR_Context
+{
+  uint32_t crc;                 /* CRC-32 of the data processed so far */
+  uint32_t length;              /* Number of bytes processed so far */
+  const uint8_t *data;          /* Asynchronous update: next byte to be processed */
+  volatile uint32_t remaining;  /* Asynchronous update: bytes still to be processed, 0 when completed */
+  void (*Callback)(CRCMGR_Context *ctx); /* Asynchronous update: called when completed */
+};
+
+/**
+ * @}
+ */
+
+/** @defgroup CRCMGR_Exported_Constants  Exported Constants
+ * @{
+ */
+/* CRC-32 computed by the CRC MANAGER: CRC-32/MPEG-2, i.e. the reset configuration
+   of the CRC peripheral. Polynomial 0x04C11DB7, initial value 0xFFFFFFFF,
+   no reflection, no final XOR. */
+#define CRCMGR_CRC32_POLY (0x04C11DB7U)
+#define CRCMGR_CRC32_INIT (0xFFFFFFFFU)
+
+/* Minimum size in bytes of the data fed by DMA in CRCMGR_UpdateAsync():
+   smaller data are processed before returning */
+#ifndef CRCMGR_DMA_THRESHOLD
+#define CRCMGR_DMA_THRESHOLD (256U)
+#endif
+
+/* State of the DMA transfer, returned by CRCMGR_PrivateDmaDone() of the board file */
+#define CRCMGR_DMA_PENDING (0U)
+#define CRCMGR_DMA_DONE    (1U)
+#define CRCMGR_DMA_ERROR   (2U)
+/**
+ * @}
+ */
+
+/** @defgroup CRCMGR_Exported_Macros           Exported Macros
+ * @{
+ */
+/**
+ * @}
+ */
+
+/** @defgroup CRCMGR_Exported_Functions        Exported Functions
+ * @{
+ */
+CRCMGR_ResultStatus CRCMGR_Init(void);
+
+CRCMGR_ResultStatus CRCMGR_Deinit(void);
+
+uint32_t CRCMGR_Crc32(uint32_t crc, const void *data, uint32_t size);
+
+uint32_t CRCMGR_Crc32Sw(uint32_t crc, const void *data, uint32_t size);
+
+void CRCMGR_Start(CRCMGR_Context *ctx);
+
+CRCMGR_ResultStatus CRCMGR_Update(CRCMGR_Context *ctx, const void *data, uint32_t size);
+
+CRCMGR_ResultStatus CRCMGR_UpdateAsync(CRCMGR_Context *ctx, const void *data, uint32_t size,
+                                       void (*Callback)(CRCMGR_Context *ctx));
+
+uint8_t CRCMGR_IsPending(CRCMGR_Context *ctx);
+
+CRCMGR_ResultStatus CRCMGR_Finish(CRCMGR_Context *ctx, uint32_t *crc);
+
+void CRCMGR_Abort(void);
+
+void CRCMGR_DMA_IRQHandler(void);
+
+
+/**
+  * @}
+  */
+
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRCMGR_H */
@@ -0,0 +1,455 @@
+/**
+******************************************************************************
+* @file    crc_manager.c
+* @author  AMS - RF Application Team
+* @brief   This file provides the software CRC-32, the streaming contexts and
+*          weak functions for CRC Manager
+*
+******************************************************************************
+* @attention
+*
+* <h2><center>&copy; COPYRIGHT(c) 2019 STMicroelectronics</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*   1. Redistributions of source code must retain the above copyright notice,
+*      this list of conditions and the following disclaimer.
+*   2. Redistributions in binary form must reproduce the above copyright notice,
+*      this list of conditions and the following disclaimer in the documentation
+*      and/or other materials provided with the distribution.
+*   3. Neither the name of STMicroelectronics nor the names of its contributors
+*      may be used to endorse or promote products derived from this software
+*      without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+
+/* Includes ------------------------------------------------------------------*/
+#include "crc_manager.h"
+#include "compiler.h"
+#include "bluenrg_lpx.h"
+#include <stddef.h>
+
+/** @defgroup CRC_Manager  CRC MANAGER
+* @{
+*/
+
+/** @defgroup CRCMGR_TypesDefinitions Private Type Definitions
+* @{
+*/
+/**
+* @}
+*/
+
+/** @defgroup CRCMGR_Private_Defines Private Defines
+* @{
+*/
+#define ATOMIC_SECTION_BEGIN() uint32_t uwPRIMASK_Bit = __get_PRIMASK(); \
+__disable_irq(); \
+  /* Must be called in the same or in a lower scope of ATOMIC_SECTION_BEGIN */
+#define ATOMIC_SECTION_END() __set_PRIMASK(uwPRIMASK_Bit)
+/**
+* @}
+*/
+
+/** @defgroup CRCMGR_Private_Macros Private Macros
+* @{
+*/
+/**
+* @}
+*/
+
+/** @defgroup CRCMGR_Private_Variables Private Variables
+* @{
+*/
+/* CRC-32/MPEG-2 of each byte value, MSB first */
+static const uint32_t crcTable[256] = {
+  0x00000000, 0x04C11DB7, 0x09823B6E, 0x0D4326D9, 0x130476DC, 0x17C56B6B, 0x1A864DB2, 0x1E475005,
+  0x2608EDB8, 0x22C9F00F, 0x2F8AD6D6, 0x2B4BCB61, 0x350C9B64, 0x31CD86D3, 0x3C8EA00A, 0x384FBDBD,
+  0x4C11DB70, 0x48D0C6C7, 0x4593E01E, 0x4152FDA9, 0x5F15ADAC, 0x5BD4B01B, 0x569796C2, 0x52568B75,
+  0x6A1936C8, 0x6ED82B7F, 0x639B0DA6, 0x675A1011, 0x791D4014, 0x7DDC5DA3, 0x709F7B7A, 0x745E66CD,
+  0x9823B6E0, 0x9CE2AB57, 0x91A18D8E, 0x95609039, 0x8B27C03C, 0x8FE6DD8B, 0x82A5FB52, 0x8664E6E5,
+  0xBE2B5B58, 0xBAEA46EF, 0xB7A96036, 0xB3687D81, 0xAD2F2D84, 0xA9EE3033, 0xA4AD16EA, 0xA06C0B5D,
+  0xD4326D90, 0xD0F37027, 0xDDB056FE, 0xD9714B49, 0xC7361B4C, 0xC3F706FB, 0xCEB42022, 0xCA753D95,
+  0xF23A8028, 0xF6FB9D9F, 0xFBB8BB46, 0xFF79A6F1, 0xE13EF6F4, 0xE5FFEB43, 0xE8BCCD9A, 0xEC7DD02D,
+  0x34867077, 0x30476DC0, 0x3D044B19, 0x39C556AE, 0x278206AB, 0x23431B1C, 0x2E003DC5, 0x2AC12072,
+  0x128E9DCF, 0x164F8078, 0x1B0CA6A1, 0x1FCDBB16, 0x018AEB13, 0x054BF6A4, 0x0808D07D, 0x0CC9CDCA,
+  0x7897AB07, 0x7C56B6B0, 0x71159069, 0x75D48DDE, 0x6B93DDDB, 0x6F52C06C, 0x6211E6B5, 0x66D0FB02,
+  0x5E9F46BF, 0x5A5E5B08, 0x571D7DD1, 0x53DC6066, 0x4D9B3063, 0x495A2DD4, 0x44190B0D, 0x40D816BA,
+  0xACA5C697, 0xA864DB20, 0xA527FDF9, 0xA1E6E04E, 0xBFA1B04B, 0xBB60ADFC, 0xB6238B25, 0xB2E29692,
+  0x8AAD2B2F, 0x8E6C3698, 0x832F1041, 0x87EE0DF6, 0x99A95DF3, 0x9D684044, 0x902B669D, 0x94EA7B2A,
+  0xE0B41DE7, 0xE4750050, 0xE9362689, 0xEDF73B3E, 0xF3B06B3B, 0xF771768C, 0xFA325055, 0xFEF34DE2,
+  0xC6BCF05F, 0xC27DEDE8, 0xCF3ECB31, 0xCBFFD686, 0xD5B88683, 0xD1799B34, 0xDC3ABDED, 0xD8FBA05A,
+  0x690CE0EE, 0x6DCDFD59, 0x608EDB80, 0x644FC637, 0x7A089632, 0x7EC98B85, 0x738AAD5C, 0x774BB0EB,
+  0x4F040D56, 0x4BC510E1, 0x46863638, 0x42472B8F, 0x5C007B8A, 0x58C1663D, 0x558240E4, 0x51435D53,
+  0x251D3B9E, 0x21DC2629, 0x2C9F00F0, 0x285E1D47, 0x36194D42, 0x32D850F5, 0x3F9B762C, 0x3B5A6B9B,
+  0x0315D626, 0x07D4CB91, 0x0A97ED48, 0x0E56F0FF, 0x1011A0FA, 0x14D0BD4D, 0x19939B94, 0x1D528623,
+  0xF12F560E, 0xF5EE4BB9, 0xF8AD6D60, 0xFC6C70D7, 0xE22B20D2, 0xE6EA3D65, 0xEBA91BBC, 0xEF68060B,
+  0xD727BBB6, 0xD3E6A601, 0xDEA580D8, 0xDA649D6F, 0xC423CD6A, 0xC0E2D0DD, 0xCDA1F604, 0xC960EBB3,
+  0xBD3E8D7E, 0xB9FF90C9, 0xB4BCB610, 0xB07DABA7, 0xAE3AFBA2, 0xAAFBE615, 0xA7B8C0CC, 0xA379DD7B,
+  0x9B3660C6, 0x9FF77D71, 0x92B45BA8, 0x9675461F, 0x8832161A, 0x8CF30BAD, 0x81B02D74, 0x857130C3,
+  0x5D8A9099, 0x594B8D2E, 0x5408ABF7, 0x50C9B640, 0x4E8EE645, 0x4A4FFBF2, 0x470CDD2B, 0x43CDC09C,
+  0x7B827D21, 0x7F436096, 0x7200464F, 0x76C15BF8, 0x68860BFD, 0x6C47164A, 0x61043093, 0x65C52D24,
+  0x119B4BE9, 0x155A565E, 0x18197087, 0x1CD86D30, 0x029F3D35, 0x065E2082, 0x0B1D065B, 0x0FDC1BEC,
+  0x3793A651, 0x3352BBE6, 0x3E119D3F, 0x3AD08088, 0x2497D08D, 0x2056CD3A, 0x2D15EBE3, 0x29D4F654,
+  0xC5A92679, 0xC1683BCE, 0xCC2B1D17, 0xC8EA00A0, 0xD6AD50A5, 0xD26C4D12, 0xDF2F6BCB, 0xDBEE767C,
+  0xE3A1CBC1, 0xE760D676, 0xEA23F0AF, 0xEEE2ED18, 0xF0A5BD1D, 0xF464A0AA, 0xF9278673, 0xFDE69BC4,
+  0x89B8FD09, 0x8D79E0BE, 0x803AC667, 0x84FBDBD0, 0x9ABC8BD5, 0x9E7D9662, 0x933EB0BB, 0x97FFAD0C,
+  0xAFB010B1, 0xAB710D06, 0xA6322BDF, 0xA2F33668, 0xBCB4666D, 0xB8757BDA, 0xB5365D03, 0xB1F740B4
+};
+
+static volatile uint8_t hwBusy;                     /* CRC peripheral in use */
+static CRCMGR_Context * volatile dmaContext;        /* Context of the asynchronous update in progress */
+static uint32_t dmaSize;                            /* Bytes fed by the DMA transfer in progress */
+/**
+* @}
+*/
+
+/** @defgroup CRCMGR_External_Variables External Variables
+* @{
+*/
+/**
+* @}
+*/
+
+/** @defgroup CRCMGR_Private_FunctionPrototypes Private Function Prototypes
+* @{
+*/
+uint8_t CRCMGR_PrivateCompute(uint32_t *crc, const uint8_t *data, uint32_t size);
+uint32_t CRCMGR_PrivateDmaStart(uint32_t crc, const uint8_t *data, uint32_t size);
+uint8_t CRCMGR_PrivateDmaDone(uint32_t *crc);
+void CRCMGR_PrivateDmaStop(void);
+/**
+* @}
+*/
+
+/** @defgroup CRCMGR_Private_Functions Private Functions
+* @{
+*/
+/* It takes the CRC peripheral: the caller computes the CRC by software if it is already in use */
+static uint8_t CRCMGR_Lock(void)
+{
+  uint8_t locked;
+  
+  ATOMIC_SECTION_BEGIN();
+  locked = !hwBusy;
+  hwBusy = 1;
+  ATOMIC_SECTION_END();
+  
+  return locked;
+}
+
+/* It starts the DMA transfer of the next part of the asynchronous update */
+static uint8_t CRCMGR_DmaNext(CRCMGR_Context *ctx)
+{
+  dmaSize = CRCMGR_PrivateDmaStart(ctx->crc, ctx->data, ctx->remaining);
+  
+  return (dmaSize != 0);
+}
+/**
+* @}
+*/
+
+/** @defgroup CRCMGR_Public_Functions Public Functions
+* @{
+*/
+WEAK_FUNCTION(CRCMGR_ResultStatus CRCMGR_Init(void))
+{
+  return CRCMGR_SUCCESS;
+  
+  /* NOTE : This function should not be modified, the callback is implemented 
+  in the dedicated board file */
+}
+
+WEAK_FUNCTION(CRCMGR_ResultStatus CRCMGR_Deinit(void))
+{
+  return CRCMGR_SUCCESS;
+  
+  /* NOTE : This function should not be modified, the callback is implemented 
+  in the dedicated board file */
+}
+
+/**
+ * @brief Compute the CRC-32 of a buffer with the CRC peripheral. If the CRC
+ *        peripheral is not available or it is already in use (e.g. the function
+ *        is called from an interrupt), the CRC-32 is computed by software.
+ * @param crc: CRC-32 of the previous data, CRCMGR_CRC32_INIT at the beginning
+ * @param data: data address
+ * @param size: data size in bytes
+ * @return CRC-32 including the data
+ */
+uint32_t CRCMGR_Crc32(uint32_t crc, const void *data, uint32_t size)
+{
+  uint8_t done = 0;
+  
+  if (CRCMGR_Lock())
+  {
+    done = CRCMGR_PrivateCompute(&crc, (const uint8_t *)data, size);
+    hwBusy = 0;
+  }
+  if (!done)
+  {
+    crc = CRCMGR_Crc32Sw(crc, data, size);
+  }
+  
+  return crc;
+}
+
+/**
+ * @brief Compute the CRC-32 of a buffer by software (table driven), with the
+ *        same result as CRCMGR_Crc32(). It does not use any peripheral.
+ * @param crc: CRC-32 of the previous data, CRCMGR_CRC32_INIT at the beginning
+ * @param data: data address
+ * @param size: data size in bytes
+ * @return CRC-32 including the data
+ */
+uint32_t CRCMGR_Crc32Sw(uint32_t crc, const void *data, uint32_t size)
+{
+  const uint8_t *pdata = (const uint8_t *)data;
+  
+  for (; size > 0; size--)
+  {
+    crc = (crc << 8) ^ crcTable[(crc >> 24) ^ *pdata++];
+  }
+  
+  return crc;
+}
+
+/**
+ * @brief Initialize a streaming context
+ * @param ctx: context
+ * @return None
+ */
+void CRCMGR_Start(CRCMGR_Context *ctx)
+{
+  ctx->crc = CRCMGR_CRC32_INIT;
+  ctx->length = 0;
+  ctx->data = NULL;
+  ctx->remaining = 0;
+  ctx->Callback = NULL;
+}
+
+/**
+ * @brief Add data to the CRC-32 of a streaming context, see CRCMGR_Crc32()
+ * @param ctx: context
+ * @param data: data address
+ * @param size: data size in bytes
+ * @return CRCMGR_ERROR_BUSY if an asynchronous update of the context is in progress
+ */
+CRCMGR_ResultStatus CRCMGR_Update(CRCMGR_Context *ctx, const void *data, uint32_t size)
+{
+  if (ctx->remaining != 0)
+    return CRCMGR_ERROR_BUSY;
+  
+  ctx->crc = CRCMGR_Crc32(ctx->crc, data, size);
+  ctx->length += size;
+  
+  return CRCMGR_SUCCESS;
+}
+
+/**
+ * @brief Add data to the CRC-32 of a streaming context without waiting: the data
+ *        are fed to the CRC peripheral by DMA (see CRCMGR_DMA_IRQHandler()).
+ *        The data must not be modified until the update is completed.
+ *        Data smaller than CRCMGR_DMA_THRESHOLD, or all the data if the DMA is
+ *        not available, are processed before returning (the callback is
+ *        called before returning).
+ * @param ctx: context
+ * @param data: data address
+ * @param size: data size in bytes
+ * @param Callback: called (from the DMA interrupt) when the update is completed. It can be NULL:
+ *                  CRCMGR_IsPending() tells when the update is completed.
+ * @return CRCMGR_ERROR_BUSY if an asynchronous update of the context is in progress or
+ *         if the CRC peripheral is in use
+ */
+CRCMGR_ResultStatus CRCMGR_UpdateAsync(CRCMGR_Context *ctx, const void *data, uint32_t size,
+                                       void (*Callback)(CRCMGR_Context *ctx))
+{
+  if (ctx->remaining != 0)
+    return CRCMGR_ERROR_BUSY;
+  
+  if (size >= CRCMGR_DMA_THRESHOLD)
+  {
+    if (!CRCMGR_Lock())
+      return CRCMGR_ERROR_BUSY;
+    
+    ctx->data = (const uint8_t *)data;
+    ctx->Callback = Callback;
+    ctx->remaining = size;
+    dmaContext = ctx;
+    if (CRCMGR_DmaNext(ctx))
+      return CRCMGR_SUCCESS;
+    
+    /* DMA not available */
+    dmaContext = NULL;
+    ctx->remaining = 0;
+    hwBusy = 0;
+  }
+  
+  CRCMGR_Update(ctx, data, size);
+  if (Callback != NULL)
+    Callback(ctx);
+  
+  return CRCMGR_SUCCESS;
+}
+
+/**
+ * @brief Tell if an asynchronous update of a streaming context is in progress
+ * @param ctx: context
+ * @return 1 if the update is in progress, 0 otherwise
+ */
+uint8_t CRCMGR_IsPending(CRCMGR_Context *ctx)
+{
+  return (ctx->remaining != 0);
+}
+
+/**
+ * @brief Provide the CRC-32 of the data added to a streaming context
+ * @param ctx: context
+ * @param crc: pointer to the CRC-32 returned
+ * @return CRCMGR_ERROR_BUSY if an asynchronous update of the context is in progress
+ */
+CRCMGR_ResultStatus CRCMGR_Finish(CRCMGR_Context *ctx, uint32_t *crc)
+{
+  if (ctx->remaining != 0)
+    return CRCMGR_ERROR_BUSY;
+  
+  *crc = ctx->crc;
+  
+  return CRCMGR_SUCCESS;
+}
+
+/**
+ * @brief Stop the asynchronous update in progress, without calling its callback.
+ *        Its context keeps the CRC-32 of the data processed before the DMA
+ *        transfer in progress (see the length field).
+ * @return None
+ */
+void CRCMGR_Abort(void)
+{
+  CRCMGR_Context *ctx = dmaContext;
+  
+  if (ctx == NULL)
+    return;
+  
+  CRCMGR_PrivateDmaStop();
+  dmaContext = NULL;
+  ctx->remaining = 0;
+  hwBusy = 0;
+}
+
+/**
+ * @brief This function handles the DMA channel of the asynchronous updates.
+ *        To be called from the DMA interrupt handler of the application,
+ *        the flags of the other channels are not modified.
+ * @return None
+ */
+void CRCMGR_DMA_IRQHandler(void)
+{
+  CRCMGR_Context *ctx = dmaContext;
+  uint32_t crc;
+  uint8_t result;
+  
+  if (ctx == NULL)
+    return;
+  
+  result = CRCMGR_PrivateDmaDone(&crc);
+  if (result == CRCMGR_DMA_PENDING)
+    return;
+  
+  if (result == CRCMGR_DMA_DONE)
+  {
+    ctx->crc = crc;
+    ctx->length += dmaSize;
+    ctx->data += dmaSize;
+    ctx->remaining -= dmaSize;
+    if ((ctx->remaining != 0) && CRCMGR_DmaNext(ctx))
+      return;
+  }
+  
+  /* Transfer error: the rest of the data is processed by software */
+  if (ctx->remaining != 0)
+  {
+    ctx->crc = CRCMGR_Crc32Sw(ctx->crc, ctx->data, ctx->remaining);
+    ctx->length += ctx->remaining;
+  }
+  
+  dmaContext = NULL;
+  hwBusy = 0;
+  ctx->remaining = 0;
+  if (ctx->Callback != NULL)
+    ctx->Callback(ctx);
+}
+
+/**
+ * @brief Compute the CRC-32 of a buffer with the CRC peripheral
+ * @param crc: CRC-32 of the previous data as input, CRC-32 including the data as output
+ * @param data: data address
+ * @param size: data size in bytes
+ * @return 1 if the CRC-32 has been computed, 0 if there is no CRC peripheral
+ */
+WEAK_FUNCTION(uint8_t CRCMGR_PrivateCompute(uint32_t *crc, const uint8_t *data, uint32_t size))
+{
+  return 0;
+  
+  /* NOTE : This function should not be modified, the callback is implemented 
+  in the dedicated board file */
+}
+
+/**
+ * @brief Start feeding a buffer to the CRC peripheral by DMA
+ * @param crc: CRC-32 of the previous data
+ * @param data: data address
+ * @param size: data size in bytes
+ * @return number of bytes of the DMA transfer started: 0 if there is no DMA
+ */
+WEAK_FUNCTION(uint32_t CRCMGR_PrivateDmaStart(uint32_t crc, const uint8_t *data, uint32_t size))
+{
+  return 0;
+  
+  /* NOTE : This function should not be modified, the callback is implemented 
+  in the dedicated board file */
+}
+
+/**
+ * @brief Check the end of the DMA transfer started with CRCMGR_PrivateDmaStart()
+ * @param crc: pointer to the CRC-32 returned, including the data of the transfer
+ * @return CRCMGR_DMA_PENDING, CRCMGR_DMA_DONE or CRCMGR_DMA_ERROR
+ */
+WEAK_FUNCTION(uint8_t CRCMGR_PrivateDmaDone(uint32_t *crc))
+{
+  return CRCMGR_DMA_ERROR;
+  
+  /* NOTE : This function should not be modified, the callback is implemented 
+  in the dedicated board file */
+}
+
+/**
+ * @brief Stop the DMA transfer started with CRCMGR_PrivateDmaStart()
+ * @return None
+ */
+WEAK_FUNCTION(void CRCMGR_PrivateDmaStop(void))
+{
+  /* NOTE : This function should not be modified, the callback is implemented 
+  in the dedicated board file */
+}
+
+/**
+* @}
+*/
+
+/**
+* @}
+*/
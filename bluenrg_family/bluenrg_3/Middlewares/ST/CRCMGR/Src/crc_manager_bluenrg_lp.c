@@ -0,0 +1,253 @@
+/**
+******************************************************************************
+* @file    crc_manager_bluenrg_lp.c
+* @author  AMS - RF Application Team
+* @brief   This file provides functions implementation for BlueNRG-LP CRC Manager.
+*
+******************************************************************************
+* @attention
+*
+* <h2><center>&copy; COPYRIGHT(c) 2019 STMicroelectronics</center></h2>
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*   1. Redistributions of source code must retain the above copyright notice,
+*      this list of conditions and the following disclaimer.
+*   2. Redistributions in binary form must reproduce the above copyright notice,
+*      this list of conditions and the following disclaimer in the documentation
+*      and/or other materials provided with the distribution.
+*   3. Neither the name of STMicroelectronics nor the names of its contributors
+*      may be used to endorse or promote products derived from this software
+*      without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+******************************************************************************
+*/
+
+
+/* Includes ------------------------------------------------------------------*/
+#include "crc_manager.h"
+#include "rf_driver_ll_crc.h"
+#include "rf_driver_ll_dma.h"
+#include "rf_driver_ll_bus.h"
+#include "bluenrg_lpx.h"
+#include "system_BlueNRG_LP.h"
+
+/** @defgroup CRC_Manager_BlueNRG_LP  CRC Manager
+* @{
+*/
+
+/** @defgroup CRC_Manager_BlueNRG_LP_TypesDefinitions Private Type Definitions
+* @{
+*/
+/**
+* @}
+*/
+
+/** @defgroup CRC_Manager_BlueNRG_LP_Private_Defines Private Defines
+* @{
+*/
+/* DMA channel feeding the CRC peripheral in CRCMGR_UpdateAsync() */
+#ifndef CRCMGR_DMA_CH
+#define CRCMGR_DMA_CH           LL_DMA_CHANNEL_6
+#endif
+
+/* Uncomment for not using the DMA: CRCMGR_UpdateAsync() waits for the CRC-32 */
+//#define CRCMGR_NO_DMA
+
+/* Max number of bytes of a DMA transfer */
+#define CRCMGR_DMA_MAX_SIZE     (0xFFFFU)
+
+/* DMA1 ISR/IFCR have 4 bits per channel, as channel 1 */
+#define CRCMGR_DMA_IS_ACTIVE_FLAG(ch, flag)  ((DMA1->ISR & ((flag) << (((ch) - 1U) * 4U))) != 0U)
+#define CRCMGR_DMA_CLEAR_FLAGS(ch)           WRITE_REG(DMA1->IFCR, DMA_IFCR_CGIF1 << (((ch) - 1U) * 4U))
+/**
+* @}
+*/
+
+/** @defgroup CRC_Manager_BlueNRG_LP_Private_Variables Private Variables
+* @{
+*/
+/**
+* @}
+*/
+
+/** @defgroup CRC_Manager_BlueNRG_LP_External_Variables External Variables
+* @{
+*/
+/**
+* @}
+*/
+
+/** @defgroup CRC_Manager_BlueNRG_LP_Private_Functions Private Functions
+* @{
+*/
+/* It configures the CRC peripheral for CRC-32/MPEG-2, starting from crc */
+static void CRCMGR_Configure(uint32_t crc)
+{
+  LL_CRC_SetPolynomialSize(CRC, LL_CRC_POLYLENGTH_32B);
+  LL_CRC_SetPolynomialCoef(CRC, CRCMGR_CRC32_POLY);
+  LL_CRC_SetInputDataReverseMode(CRC, LL_CRC_INDATA_REVERSE_NONE);
+  LL_CRC_SetOutputDataReverseMode(CRC, LL_CRC_OUTDATA_REVERSE_NONE);
+  LL_CRC_SetInitialData(CRC, crc);
+  LL_CRC_ResetCRCCalculationUnit(CRC);
+}
+/**
+* @}
+*/
+
+/** @defgroup CRC_Manager_BlueNRG_LP_Public_Functions Public Functions
+* @{
+*/
+
+CRCMGR_ResultStatus CRCMGR_Init(void)
+{
+  /* Peripheral clock enable */
+  LL_AHB_EnableClock(LL_AHB_PERIPH_CRC);
+  
+#ifndef CRCMGR_NO_DMA
+  /* Memory to memory transfer: the source (CPAR) is the data, incremented byte
+     by byte, the destination (CMAR) is the CRC data register. Data are fed as
+     bytes since the CRC peripheral takes the words MSB first. */
+  LL_AHB_EnableClock(LL_AHB_PERIPH_DMA);
+  LL_DMA_ConfigTransfer(DMA1, CRCMGR_DMA_CH, LL_DMA_DIRECTION_MEMORY_TO_MEMORY | LL_DMA_MODE_NORMAL |
+                       LL_DMA_PERIPH_INCREMENT | LL_DMA_MEMORY_NOINCREMENT |
+                       LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE | LL_DMA_PRIORITY_LOW);
+  LL_DMA_SetPeriphRequest(DMA1, CRCMGR_DMA_CH, LL_DMAMUX_REQ_MEM2MEM);
+  LL_DMA_SetM2MDstAddress(DMA1, CRCMGR_DMA_CH, (uint32_t)&CRC->DR);
+  
+  NVIC_SetPriority(DMA_IRQn, IRQ_LOW_PRIORITY);
+  NVIC_EnableIRQ(DMA_IRQn);
+#endif
+  
+  return CRCMGR_SUCCESS;
+}
+
+
+CRCMGR_ResultStatus CRCMGR_Deinit(void)
+{
+  CRCMGR_Abort();
+  LL_AHB_DisableClock(LL_AHB_PERIPH_CRC);
+  
+  return CRCMGR_SUCCESS;
+}
+
+
+/**
+ * @brief Compute the CRC-32 of a buffer with the CRC peripheral.
+ *        Word aligned data are processed word-wise.
+ * @param crc: CRC-32 of the previous data as input, CRC-32 including the data as output
+ * @param data: data address
+ * @param size: data size in bytes
+ * @return 1 (the CRC-32 has been computed)
+ */
+uint8_t CRCMGR_PrivateCompute(uint32_t *crc, const uint8_t *data, uint32_t size)
+{
+  CRCMGR_Configure(*crc);
+  
+  if (((uint32_t)data & 3) == 0)
+  {
+    for (; size >= 4; size -= 4, data += 4)
+    {
+      /* Data are fed MSB first: swap bytes to keep the byte order of the buffer */
+      LL_CRC_FeedData32(CRC, __REV(*(const uint32_t *)data));
+    }
+  }
+  for (; size > 0; size--)
+  {
+    LL_CRC_FeedData8(CRC, *data++);
+  }
+  
+  *crc = LL_CRC_ReadData32(CRC);
+  
+  return 1;
+}
+
+
+/**
+ * @brief Start feeding a buffer to the CRC peripheral by DMA (channel CRCMGR_DMA_CH)
+ * @param crc: CRC-32 of the previous data
+ * @param data: data address
+ * @param size: data size in bytes
+ * @return number of bytes of the DMA transfer started: 0 if the DMA is not used
+ */
+uint32_t CRCMGR_PrivateDmaStart(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+#ifndef CRCMGR_NO_DMA
+  if (size > CRCMGR_DMA_MAX_SIZE)
+    size = CRCMGR_DMA_MAX_SIZE;
+  
+  CRCMGR_Configure(crc);
+  
+  LL_DMA_SetM2MSrcAddress(DMA1, CRCMGR_DMA_CH, (uint32_t)data);
+  LL_DMA_SetDataLength(DMA1, CRCMGR_DMA_CH, size);
+  CRCMGR_DMA_CLEAR_FLAGS(CRCMGR_DMA_CH);
+  LL_DMA_EnableIT_TC(DMA1, CRCMGR_DMA_CH);
+  LL_DMA_EnableIT_TE(DMA1, CRCMGR_DMA_CH);
+  LL_DMA_EnableChannel(DMA1, CRCMGR_DMA_CH);
+  
+  return size;
+#else
+  return 0;
+#endif
+}
+
+
+/**
+ * @brief Stop the DMA transfer started with CRCMGR_PrivateDmaStart()
+ * @return None
+ */
+void CRCMGR_PrivateDmaStop(void)
+{
+  LL_DMA_DisableChannel(DMA1, CRCMGR_DMA_CH);
+  LL_DMA_DisableIT_TC(DMA1, CRCMGR_DMA_CH);
+  LL_DMA_DisableIT_TE(DMA1, CRCMGR_DMA_CH);
+  CRCMGR_DMA_CLEAR_FLAGS(CRCMGR_DMA_CH);
+}
+
+
+/**
+ * @brief Check the end of the DMA transfer started with CRCMGR_PrivateDmaStart()
+ * @param crc: pointer to the CRC-32 returned, including the data of the transfer
+ * @return CRCMGR_DMA_PENDING, CRCMGR_DMA_DONE or CRCMGR_DMA_ERROR
+ */
+uint8_t CRCMGR_PrivateDmaDone(uint32_t *crc)
+{
+  uint8_t result;
+  
+  if (CRCMGR_DMA_IS_ACTIVE_FLAG(CRCMGR_DMA_CH, DMA_ISR_TEIF1))
+  {
+    result = CRCMGR_DMA_ERROR;
+  }
+  else if (CRCMGR_DMA_IS_ACTIVE_FLAG(CRCMGR_DMA_CH, DMA_ISR_TCIF1))
+  {
+    *crc = LL_CRC_ReadData32(CRC);
+    result = CRCMGR_DMA_DONE;
+  }
+  else
+  {
+    return CRCMGR_DMA_PENDING;
+  }
+  
+  CRCMGR_PrivateDmaStop();
+  
+  return result;
+}
+
+/**
+* @}
+*/
+
+/**
+* @}
+*/
@@ -25,11 +25,31 @@
 #include "SDK_EVAL_Config.h"
 #include "hci.h"
 #include "hci_const.h"
+#include "hci_framer.h"
 
 /* Added for UART version only */
 #define HCI_PACKET_SIZE         532 // Because of extended ACI commands, size can be bigger than standard HCI commands
-static uint8_t hci_buffer[HCI_PACKET_SIZE];
-static uint16_t hci_pckt_len = 0;
+static uint8_t hci_cmd_buffer[HCI_PACKET_SIZE];
+static uint8_t hci_event_buffer[HCI_PACKET_SIZE];
+
+static void hci_packet_received(void *cb_ctx, uint8_t *packet, uint16_t pckt_len);
+
+/* Commands and events are framed by two independent instances, so that they
+   can be fed from different interrupt contexts. packet_received() copies the
+   packet, hence zero-copy delivery is safe. */
+static hci_framer_t hci_cmd_framer = HCI_FRAMER_INITIALIZER(hci_cmd_buffer, HCI_PACKET_SIZE,
+                                                            HCI_FRAMER_TYPE_CMD | HCI_FRAMER_TYPE_CMD_EXT |
+                                                            HCI_FRAMER_TYPE_ACL | HCI_FRAMER_TYPE_VENDOR,
+                                                            HCI_FRAMER_OPT_ZERO_COPY, hci_packet_received, NULL);
+
+static hci_framer_t hci_event_framer = HCI_FRAMER_INITIALIZER(hci_event_buffer, HCI_PACKET_SIZE,
+                                                              HCI_FRAMER_TYPE_EVT | HCI_FRAMER_TYPE_EVT_EXT,
+                                                              HCI_FRAMER_OPT_ZERO_COPY, hci_packet_received, NULL);
+
+static void hci_packet_received(void *cb_ctx, uint8_t *packet, uint16_t pckt_len)
+{
+  packet_received(packet, pckt_len);
+}
 
 /**
 * @brief Parses ACI commands, ACL and vendor packets
@@ -39,86 +59,7 @@ static uint16_t hci_pckt_len = 0;
 */
 void hci_input_cmd(uint8_t *buff, uint16_t len)
 {
-  static hci_state state = WAITING_TYPE;
-    
-  static uint16_t collected_payload_len = 0;
-  static uint16_t payload_len;
-  static uint16_t header_len;
-  uint8_t byte;
-  uint16_t i = 0;
-  
-  while(hci_pckt_len < HCI_PACKET_SIZE && i++ < len){
-        
-    byte = *buff++;
-
-    if(state == WAITING_TYPE)
-      hci_pckt_len = 0;
-    
-    hci_buffer[hci_pckt_len++] = byte;        
-        
-    if(state == WAITING_TYPE){
-      
-      state = WAITING_HEADER;
-      
-      if(byte == HCI_COMMAND_PKT){
-        header_len = HCI_TYPE_SIZE + HCI_COMMAND_HDR_SIZE;
-      }
-      else if(byte == HCI_COMMAND_EXT_PKT){
-        header_len = HCI_TYPE_SIZE + HCI_COMMAND_EXT_HDR_SIZE;
-      }
-      else if(byte == HCI_ACLDATA_PKT){
-        header_len = HCI_TYPE_SIZE + HCI_ACL_HDR_SIZE;
-      }
-      else if(byte == HCI_VENDOR_PKT){
-        header_len = HCI_TYPE_SIZE + HCI_VENDOR_HDR_SIZE;
-      }
-      else {
-        state = WAITING_TYPE;        
-      }
-    }
-    else if(state == WAITING_HEADER){
-      
-      if(hci_pckt_len == header_len){
-                    
-        // The entire header has been received
-        uint8_t pckt_type = hci_buffer[0];
-        collected_payload_len = 0;
-        payload_len = 0;
-        
-        if(pckt_type == HCI_COMMAND_PKT){
-          hci_cmd_hdr *hdr = (hci_cmd_hdr *)(hci_buffer+HCI_TYPE_SIZE);
-          payload_len = hdr->plen;
-        }
-        else if(pckt_type == HCI_COMMAND_EXT_PKT){
-          hci_cmd_ext_hdr *hdr = (hci_cmd_ext_hdr *)(hci_buffer+HCI_TYPE_SIZE);
-          payload_len = hdr->plen;
-        }
-        else if(pckt_type == HCI_ACLDATA_PKT){
-          hci_acl_hdr *hdr = (hci_acl_hdr *)(hci_buffer+HCI_TYPE_SIZE);
-          payload_len = hdr->dlen;
-        }
-        else if(pckt_type == HCI_VENDOR_PKT){
-          hci_vendor_hdr *hdr = (hci_vendor_hdr *)(hci_buffer+HCI_TYPE_SIZE);
-          payload_len = hdr->plen;
-        }
-        if(payload_len == 0){
-          state = WAITING_TYPE;
-          packet_received(hci_buffer, hci_pckt_len);
-        }
-        else {
-          state = WAITING_PAYLOAD;                      
-        }
-      }      
-    }
-    else if(state == WAITING_PAYLOAD){
-      collected_payload_len++;
-      if(collected_payload_len >= payload_len){
-        state = WAITING_TYPE;
-        packet_received(hci_buffer, hci_pckt_len);
-      }      
-    }
-  }
-  
+  hci_framer_input(&hci_cmd_framer, buff, len);
 }
 
 /**
@@ -129,75 +70,7 @@ void hci_input_cmd(uint8_t *buff, uint16_t len)
 */
 void hci_input_event(uint8_t *buff, uint16_t len)
 {
-  static hci_state state = WAITING_TYPE;
-    
-  static uint16_t collected_payload_len = 0;
-  static uint16_t payload_len;
-  static uint16_t header_len;
-  uint8_t byte;
-  uint16_t i = 0;
-        
-  if(state == WAITING_TYPE)
-    hci_pckt_len = 0;
-    
-  while(hci_pckt_len < HCI_PACKET_SIZE && i++ < len){
-        
-    byte = *buff++;
-
-    if(state == WAITING_TYPE)
-      hci_pckt_len = 0;
-    
-    hci_buffer[hci_pckt_len++] = byte;        
-        
-    if(state == WAITING_TYPE){
-      /* Only events are accepted. ACL packets not used. */
-      
-      state = WAITING_HEADER;
-      
-      if(byte == HCI_EVENT_PKT){
-        header_len = HCI_TYPE_SIZE + HCI_EVENT_HDR_SIZE;
-      }
-      else if(byte == HCI_EVENT_EXT_PKT){
-        header_len = HCI_TYPE_SIZE + HCI_EVENT_EXT_HDR_SIZE;
-      }
-      else {
-        state = WAITING_TYPE;        
-      }
-    }
-    else if(state == WAITING_HEADER){
-      
-      if(hci_pckt_len == header_len){
-                    
-        // The entire header has been received
-        uint8_t pckt_type = hci_buffer[0];
-        collected_payload_len = 0;
-        payload_len = 0;
-        
-        if(pckt_type == HCI_EVENT_PKT){
-          hci_event_hdr *hdr = (hci_event_hdr *)(hci_buffer+HCI_TYPE_SIZE);
-          payload_len = hdr->plen;
-        }
-        else if(pckt_type == HCI_EVENT_EXT_PKT){
-          hci_event_ext_hdr *hdr = (hci_event_ext_hdr *)(hci_buffer+HCI_TYPE_SIZE);
-          payload_len = hdr->plen;
-        }
-        if(payload_len == 0){
-          state = WAITING_TYPE;
-          packet_received(hci_buffer, hci_pckt_len);
-        }
-        else {
-          state = WAITING_PAYLOAD;                      
-        }
-      }      
-    }
-    else if(state == WAITING_PAYLOAD){
-      collected_payload_len++;
-      if(collected_payload_len >= payload_len){
-        state = WAITING_TYPE;
-        packet_received(hci_buffer, hci_pckt_len);
-      }
-    }
-  }
+  hci_framer_input(&hci_event_framer, buff, len);
 }
 
 
@@ -24,6 +24,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include <stdint.h>
 #include "SDK_EVAL_Config.h"
+#include "hci_framer.h"
 /* Exported macro ------------------------------------------------------------*/
 
 /* DTM mode codes */
@@ -45,9 +46,10 @@
 /* Exported types ------------------------------------------------------------*/
 
 typedef enum {
-  WAITING_TYPE,
-  WAITING_HEADER,
-  WAITING_PAYLOAD
+  WAITING_TYPE = HCI_FRAMER_WAITING_TYPE,
+  WAITING_HEADER = HCI_FRAMER_WAITING_HEADER,
+  WAITING_PAYLOAD = HCI_FRAMER_WAITING_PAYLOAD,
+  DISCARDING_PAYLOAD = HCI_FRAMER_DISCARDING_PAYLOAD
 }hci_state;
 
 /* Exported functions ------------------------------------------------------- */
@@ -0,0 +1,160 @@
+/**
+  ******************************************************************************
+  * @file    hci_framer.h
+  * @author  AMS - RF Application Team
+  * @brief   Reentrant HCI packet framer shared by the DTM and the
+  *          external micro HCI parsers.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2024 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef HCI_FRAMER_H
+#define HCI_FRAMER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/** @addtogroup HCI_FRAMER HCI FRAMER
+ * @{
+ */
+
+/** @defgroup HCI_FRAMER_Exported_Constants Exported Constants
+ * @{
+ */
+
+/* Packet types accepted by a framer instance (bitmask for type_mask) */
+#define HCI_FRAMER_TYPE_CMD             0x0001U /* 0x01 HCI command */
+#define HCI_FRAMER_TYPE_ACL             0x0002U /* 0x02 ACL data */
+#define HCI_FRAMER_TYPE_SCO             0x0004U /* 0x03 SCO data */
+#define HCI_FRAMER_TYPE_EVT             0x0008U /* 0x04 HCI event */
+#define HCI_FRAMER_TYPE_ISO             0x0010U /* 0x05 ISO data */
+#define HCI_FRAMER_TYPE_CMD_EXT         0x0020U /* 0x81 extended ACI command */
+#define HCI_FRAMER_TYPE_EVT_EXT         0x0040U /* 0x82 extended ACI event */
+#define HCI_FRAMER_TYPE_VENDOR          0x0080U /* 0xFF vendor packet */
+
+/* Options */
+/* Deliver packets fully contained in the input buffer without copying them
+   into the framer buffer. Only allowed if the input buffer is not modified
+   while the packet callback is running. */
+#define HCI_FRAMER_OPT_ZERO_COPY        0x01U
+
+/* Largest header handled by the framer (packet type included) */
+#define HCI_FRAMER_MAX_HEADER_LEN       5U
+
+/**
+ * @}
+ */
+
+/** @defgroup HCI_FRAMER_Exported_Types Exported Types
+ * @{
+ */
+
+typedef enum {
+  HCI_FRAMER_WAITING_TYPE,
+  HCI_FRAMER_WAITING_HEADER,
+  HCI_FRAMER_WAITING_PAYLOAD,
+  HCI_FRAMER_DISCARDING_PAYLOAD
+} hci_framer_state_t;
+
+/* Called each time a complete packet (type byte included) has been framed.
+   The packet pointer is only valid for the duration of the call. */
+typedef void (*hci_framer_packet_cb_t)(void *cb_ctx, uint8_t *packet, uint16_t pckt_len);
+
+typedef struct hci_framer_s {
+  /* Configuration */
+  uint8_t *buffer;                  /* Buffer holding the packet being framed */
+  uint16_t buffer_size;             /* Maximum packet size (header included) */
+  uint16_t type_mask;               /* Bitmask of HCI_FRAMER_TYPE_x accepted */
+  uint8_t options;                  /* Bitmask of HCI_FRAMER_OPT_x */
+  hci_framer_packet_cb_t packet_cb;
+  void *cb_ctx;
+  /* Parser state */
+  uint8_t state;
+  uint8_t desc_idx;                 /* Header descriptor of the current packet */
+  uint16_t pckt_len;                /* Bytes already stored in buffer */
+  uint16_t remaining_len;           /* Payload bytes still to be received */
+  /* Statistics */
+  uint16_t unknown_type_count;      /* Type bytes not accepted by type_mask */
+  uint16_t oversize_count;          /* Packets discarded for exceeding buffer_size */
+} hci_framer_t;
+
+/**
+ * @}
+ */
+
+/** @defgroup HCI_FRAMER_Exported_Macros Exported Macros
+ * @{
+ */
+
+/* Static initializer, equivalent to a call to hci_framer_init() */
+#define HCI_FRAMER_INITIALIZER(buff, size, mask, opt, cb, ctx) \
+  { (buff), (size), (mask), (opt), (cb), (ctx), HCI_FRAMER_WAITING_TYPE, 0, 0, 0, 0, 0 }
+
+/**
+ * @}
+ */
+
+/** @defgroup HCI_FRAMER_Exported_Functions Exported Functions
+ * @{
+ */
+
+/**
+ * @brief  Initialize a framer instance.
+ * @param  framer      Framer instance
+ * @param  buffer      Buffer used to reassemble packets split across calls
+ * @param  buffer_size Size of buffer, it must be at least HCI_FRAMER_MAX_HEADER_LEN.
+ *                     Longer packets are discarded.
+ * @param  type_mask   Bitmask of the accepted HCI_FRAMER_TYPE_x packet types
+ * @param  options     Bitmask of HCI_FRAMER_OPT_x
+ * @param  packet_cb   Callback invoked for each complete packet
+ * @param  cb_ctx      Opaque pointer passed back to packet_cb
+ * @retval None
+ */
+void hci_framer_init(hci_framer_t *framer, uint8_t *buffer, uint16_t buffer_size,
+                     uint16_t type_mask, uint8_t options,
+                     hci_framer_packet_cb_t packet_cb, void *cb_ctx);
+
+/**
+ * @brief  Drop any partially received packet.
+ * @param  framer Framer instance
+ * @retval None
+ */
+void hci_framer_reset(hci_framer_t *framer);
+
+/**
+ * @brief  Feed received bytes to the framer.
+ *         packet_cb is called for each packet completed by these bytes.
+ * @param  framer Framer instance
+ * @param  buff   Received bytes
+ * @param  len    Number of received bytes
+ * @retval State of the framer after the bytes have been consumed
+ */
+hci_framer_state_t hci_framer_input(hci_framer_t *framer, uint8_t *buff, uint16_t len);
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HCI_FRAMER_H */
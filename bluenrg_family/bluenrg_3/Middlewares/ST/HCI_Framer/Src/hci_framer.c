@@ -0,0 +1,209 @@
+/**
+  ******************************************************************************
+  * @file    hci_framer.c
+  * @author  AMS - RF Application Team
+  * @brief   Reentrant HCI packet framer.
+  *          All the state is kept in the hci_framer_t instance, so that
+  *          several transports can be parsed at the same time. The module
+  *          has no hardware dependency.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2024 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "hci_framer.h"
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Describes where the payload length is located in the header of a packet */
+typedef struct {
+  uint8_t  pckt_type;
+  uint8_t  header_len;  /* Packet type included */
+  uint8_t  len_offset;  /* Offset of the length field from the packet type */
+  uint8_t  len_size;    /* 1 or 2 bytes, little endian */
+  uint16_t len_mask;
+  uint16_t type_bit;
+} hci_framer_hdr_desc_t;
+
+/* Private define ------------------------------------------------------------*/
+#define HCI_FRAMER_NO_DESC      0xFFU
+
+/* Private macro -------------------------------------------------------------*/
+#define MIN(a,b)                (((a) < (b)) ? (a) : (b))
+
+/* Private variables ---------------------------------------------------------*/
+static const hci_framer_hdr_desc_t hdr_desc[] = {
+  /* type, hdr, off, size, mask,  type bit */
+  {  0x01, 4, 3, 1, 0x00FF, HCI_FRAMER_TYPE_CMD     },
+  {  0x02, 5, 3, 2, 0xFFFF, HCI_FRAMER_TYPE_ACL     },
+  {  0x03, 4, 3, 1, 0x00FF, HCI_FRAMER_TYPE_SCO     },
+  {  0x04, 3, 2, 1, 0x00FF, HCI_FRAMER_TYPE_EVT     },
+  {  0x05, 5, 3, 2, 0x3FFF, HCI_FRAMER_TYPE_ISO     }, /* 2 MSbs are reserved */
+  {  0x81, 5, 3, 2, 0xFFFF, HCI_FRAMER_TYPE_CMD_EXT },
+  {  0x82, 4, 2, 2, 0xFFFF, HCI_FRAMER_TYPE_EVT_EXT },
+  {  0xFF, 4, 2, 2, 0xFFFF, HCI_FRAMER_TYPE_VENDOR  },
+};
+
+#define HDR_DESC_NUM            (sizeof(hdr_desc)/sizeof(hdr_desc[0]))
+
+/* Private functions ---------------------------------------------------------*/
+
+static uint8_t hdr_desc_lookup(uint8_t pckt_type, uint16_t type_mask)
+{
+  uint8_t i;
+
+  for(i = 0; i < HDR_DESC_NUM; i++){
+    if(hdr_desc[i].pckt_type == pckt_type){
+      if(hdr_desc[i].type_bit & type_mask)
+        return i;
+      break;
+    }
+  }
+  return HCI_FRAMER_NO_DESC;
+}
+
+static uint16_t hdr_payload_len(const hci_framer_hdr_desc_t *desc, const uint8_t *header)
+{
+  uint16_t len = header[desc->len_offset];
+
+  if(desc->len_size == 2)
+    len |= (uint16_t)header[desc->len_offset + 1] << 8;
+
+  return len & desc->len_mask;
+}
+
+/* Header is complete: decide what to do with the payload. */
+static void header_received(hci_framer_t *framer)
+{
+  const hci_framer_hdr_desc_t *desc = &hdr_desc[framer->desc_idx];
+  uint16_t payload_len = hdr_payload_len(desc, framer->buffer);
+
+  framer->remaining_len = payload_len;
+
+  if((uint32_t)desc->header_len + payload_len > framer->buffer_size){
+    framer->oversize_count++;
+    framer->state = (payload_len == 0) ? HCI_FRAMER_WAITING_TYPE : HCI_FRAMER_DISCARDING_PAYLOAD;
+  }
+  else if(payload_len == 0){
+    framer->state = HCI_FRAMER_WAITING_TYPE;
+    framer->packet_cb(framer->cb_ctx, framer->buffer, framer->pckt_len);
+  }
+  else {
+    framer->state = HCI_FRAMER_WAITING_PAYLOAD;
+  }
+}
+
+/* Public functions ----------------------------------------------------------*/
+
+void hci_framer_init(hci_framer_t *framer, uint8_t *buffer, uint16_t buffer_size,
+                     uint16_t type_mask, uint8_t options,
+                     hci_framer_packet_cb_t packet_cb, void *cb_ctx)
+{
+  framer->buffer = buffer;
+  framer->buffer_size = buffer_size;
+  framer->type_mask = type_mask;
+  framer->options = options;
+  framer->packet_cb = packet_cb;
+  framer->cb_ctx = cb_ctx;
+  framer->unknown_type_count = 0;
+  framer->oversize_count = 0;
+  hci_framer_reset(framer);
+}
+
+void hci_framer_reset(hci_framer_t *framer)
+{
+  framer->state = HCI_FRAMER_WAITING_TYPE;
+  framer->desc_idx = HCI_FRAMER_NO_DESC;
+  framer->pckt_len = 0;
+  framer->remaining_len = 0;
+}
+
+hci_framer_state_t hci_framer_input(hci_framer_t *framer, uint8_t *buff, uint16_t len)
+{
+  const hci_framer_hdr_desc_t *desc;
+  uint16_t chunk;
+
+  while(len > 0){
+
+    switch(framer->state){
+
+    case HCI_FRAMER_WAITING_TYPE:
+      framer->desc_idx = hdr_desc_lookup(buff[0], framer->type_mask);
+      if(framer->desc_idx == HCI_FRAMER_NO_DESC){
+        /* Skip the byte and try to resynchronize on the next one. */
+        framer->unknown_type_count++;
+        buff++;
+        len--;
+        break;
+      }
+      desc = &hdr_desc[framer->desc_idx];
+      framer->pckt_len = 0;
+      framer->state = HCI_FRAMER_WAITING_HEADER;
+
+      if((framer->options & HCI_FRAMER_OPT_ZERO_COPY) && len >= desc->header_len){
+        uint16_t payload_len = hdr_payload_len(desc, buff);
+        uint32_t total_len = (uint32_t)desc->header_len + payload_len;
+
+        if(total_len <= len && total_len <= framer->buffer_size){
+          /* Whole packet available in the input buffer: no copy needed. */
+          framer->state = HCI_FRAMER_WAITING_TYPE;
+          framer->packet_cb(framer->cb_ctx, buff, (uint16_t)total_len);
+          buff += total_len;
+          len -= (uint16_t)total_len;
+        }
+      }
+      break;
+
+    case HCI_FRAMER_WAITING_HEADER:
+      desc = &hdr_desc[framer->desc_idx];
+      chunk = MIN(len, desc->header_len - framer->pckt_len);
+      memcpy(&framer->buffer[framer->pckt_len], buff, chunk);
+      framer->pckt_len += chunk;
+      buff += chunk;
+      len -= chunk;
+      if(framer->pckt_len == desc->header_len){
+        header_received(framer);
+      }
+      break;
+
+    case HCI_FRAMER_WAITING_PAYLOAD:
+      chunk = MIN(len, framer->remaining_len);
+      memcpy(&framer->buffer[framer->pckt_len], buff, chunk);
+      framer->pckt_len += chunk;
+      framer->remaining_len -= chunk;
+      buff += chunk;
+      len -= chunk;
+      if(framer->remaining_len == 0){
+        framer->state = HCI_FRAMER_WAITING_TYPE;
+        framer->packet_cb(framer->cb_ctx, framer->buffer, framer->pckt_len);
+      }
+      break;
+
+    case HCI_FRAMER_DISCARDING_PAYLOAD:
+      chunk = MIN(len, framer->remaining_len);
+      framer->remaining_len -= chunk;
+      buff += chunk;
+      len -= chunk;
+      if(framer->remaining_len == 0){
+        framer->state = HCI_FRAMER_WAITING_TYPE;
+      }
+      break;
+
+    default:
+      hci_framer_reset(framer);
+      break;
+    }
+  }
+
+  return (hci_framer_state_t)framer->state;
+}
@@ -62,6 +62,46 @@ typedef enum
   PKAMGR_ERR_PARAM   = -3,
   PKAMGR_ERR_PROCESS = -4
 } PKAMGR_ResultStatus;
+
+/* Priority of a PKA job: the queued jobs with the highest priority are served
+   first, the jobs with the same priority in the order they were requested. */
+typedef enum
+{
+  PKAMGR_PRIORITY_APPLICATION = 0,
+  PKAMGR_PRIORITY_STACK
+} PKAMGR_Priority;
+/**
+ * @}
+ */
+
+/** @defgroup PKA_Manager_Exported_Constants  Exported Constants
+ * @{
+ */
+/* Maximum number of PKA jobs waiting or running. Each job takes 104 bytes of RAM. */
+#ifndef PKAMGR_QUEUE_SIZE
+#define PKAMGR_QUEUE_SIZE       4U
+#endif
+
+/* Job identifier never assigned to a job */
+#define PKAMGR_INVALID_JOB      0U
+
+/* Uncomment to keep a pool of precomputed P-256 key pairs. The pool is filled
+   while the PKA is idle, once a PKA job has been completed, and
+   PKAMGR_StartP256PublicKeyGeneration() reports a key pair of the pool, if any,
+   from the PKA interrupt (pended by the request).
+   After a key pair has been used, the pool is filled again only when the next
+   PKA job has been completed (or when the pool is empty), not to delay the DHKey. */
+//#define PKAMGR_KEY_CACHE
+
+/* Number of key pairs in the pool. Each key pair takes 101 bytes of RAM. */
+#ifndef PKAMGR_KEY_CACHE_SIZE
+#define PKAMGR_KEY_CACHE_SIZE   2U
+#endif
+
+/* Number of times a key pair of the pool is used before being discarded */
+#ifndef PKAMGR_KEY_CACHE_REUSE
+#define PKAMGR_KEY_CACHE_REUSE  1U
+#endif
 /**
  * @}
  */
@@ -124,7 +164,23 @@ PKAMGR_ResultStatus PKAMGR_Deinit(void);
 
 //PKAMGR_ResultStatus PKAMGR_Isr(void);
 
-//PKAMGR_ResultStatus PKAMGR_Tick(void);
+/**
+ * @brief  Start the next queued PKA job when the PKA is free.
+ *         The queued jobs are started when the running job is completed
+ *         (or when a direct user of PKAMGR_Lock() releases the PKA), from the
+ *         PKA interrupt. On BlueNRG-LPS and BlueNRG-LPF a DHKey computation
+ *         cannot be started there: it is started by this function, which must
+ *         then be called from thread context, after PKAMGR_TickRequest().
+ */
+PKAMGR_ResultStatus PKAMGR_Tick(void);
+
+/**
+ * @brief  Request a call of PKAMGR_Tick() from thread context, e.g. from a
+ *         work item. It is called from the PKA interrupt when the next job
+ *         cannot be started there. The default implementation does nothing:
+ *         PKAMGR_Tick() is then called from the application main loop.
+ */
+void PKAMGR_TickRequest(void);
 
 PKAMGR_ResultStatus PKAMGR_SleepCheck(void);
 
@@ -147,8 +203,9 @@ PKAMGR_ResultStatus PKAMGR_Unlock(void);
  *
  * @return Status of the PKA peripheral w.r.t. the requested operation
  *         - SUCCESS in case the PKA peripheral is available and ready to execute the operation.
- *         - ERROR_BUSY in case the PKA peripheral is BUSY with another operation that could
- *         have been requested by the BLEPS Library or by the End-User Application.
+ *           The operation is queued with PKAMGR_PRIORITY_STACK if the PKA peripheral is BUSY
+ *           with another operation.
+ *         - ERROR_BUSY in case the job queue is full.
  *
  * @note   Called by BLEPS Library function: <c>hci_le_read_local_p256_publicKey<\c>.
  *
@@ -173,8 +230,12 @@ PKAMGR_ResultStatus PKAMGR_StartP256PublicKeyGeneration(const uint32_t *private_
  *          made beofre to configure the PKA for DHKey computation.
  *         - SUCCESS in case the PKA peripheral is available and ready to execute the operation
  *           and the input parameters are correct!
- *         - ERROR_BUSY in case the PKA peripheral is BUSY with another operation that could
- *           have been requested by the BLEPS Library or by the End-User Application. 
+ *           The operation is queued with PKAMGR_PRIORITY_STACK if the PKA peripheral is BUSY
+ *           with another operation: the input parameters are then checked when the
+ *           operation is started, and an error is reported to funcCB.
+ *         - ERROR_BUSY in case the job queue is full. On BlueNRG-LPS and BlueNRG-LPF
+ *           the start of a queued DHKey computation waits for the PKA interrupt:
+ *           it is started by PKAMGR_Tick(), see PKAMGR_TickRequest().
  *         - ERROR_PARAMETERS in case the input parameters are invalid; either the Secret key or the 
  *           remote P256 public key may be wrong (when the peer remote public key is not a valid ECC point)
  *
@@ -187,6 +248,68 @@ PKAMGR_ResultStatus PKAMGR_StartP256DHkeyGeneration(const uint32_t *secretKey,
                                                     const uint32_t *publicKey, 
                                                     PKAMGR_funcCB funcCB);
 
+/**
+ * @brief   Queue the generation of a P256 Public Key, as PKAMGR_StartP256PublicKeyGeneration()
+ *          with the given priority.
+ *
+ * @param   private_key - the Secret Key (LE format). It is copied: the buffer can be reused on return.
+ * @param   funcCB - callback function called when the operation has been completed.
+ * @param   priority - priority of the job.
+ * @param   jobId - returned identifier of the job, to be used with PKAMGR_Cancel(). It can be NULL.
+ *
+ * @return  Same as PKAMGR_StartP256DHkeyGeneration().
+ */
+PKAMGR_ResultStatus PKAMGR_QueueP256PublicKeyGeneration(const uint32_t *private_key,
+                                                        PKAMGR_funcCB funcCB,
+                                                        PKAMGR_Priority priority,
+                                                        uint16_t *jobId);
+
+/**
+ * @brief   Queue the computation of a DHKey, as PKAMGR_StartP256DHkeyGeneration()
+ *          with the given priority.
+ *
+ * @param   secretKey - the Secret Key of the Local device (LE format).
+ * @param   publicKey - the Public Key of the peer remote device (LE format).
+ *          The keys are copied: the buffers can be reused on return.
+ * @param   funcCB - callback function called when the operation has been completed.
+ * @param   priority - priority of the job.
+ * @param   jobId - returned identifier of the job, to be used with PKAMGR_Cancel(). It can be NULL.
+ *
+ * @return  Same as PKAMGR_StartP256DHkeyGeneration().
+ */
+PKAMGR_ResultStatus PKAMGR_QueueP256DHkeyGeneration(const uint32_t *secretKey,
+                                                    const uint32_t *publicKey,
+                                                    PKAMGR_funcCB funcCB,
+                                                    PKAMGR_Priority priority,
+                                                    uint16_t *jobId);
+
+/**
+ * @brief   Cancel a PKA job. The callback of the job is not called.
+ *          A running job is completed by the PKA but its result is discarded.
+ *
+ * @param   jobId - identifier returned when the job has been queued.
+ *
+ * @return  SUCCESS, or ERROR_PARAMETERS if the job has already been completed.
+ */
+PKAMGR_ResultStatus PKAMGR_Cancel(uint16_t jobId);
+
+/**
+ * @brief   Discard all the key pairs of the pool (PKAMGR_KEY_CACHE), e.g. after
+ *          a pairing failure when the key pairs are reused.
+ */
+void PKAMGR_KeyCacheFlush(void);
+
+/**
+ * @brief   Number of key pairs ready in the pool (always 0 without PKAMGR_KEY_CACHE).
+ */
+uint8_t PKAMGR_KeyCacheLevel(void);
+
+/**
+ * @brief   Report the key pairs of the pool reserved by PKAMGR_StartP256PublicKeyGeneration().
+ *          Called at the end of the PKA interrupt handler.
+ */
+void PKAMGR_KeyCacheServe(void);
+
 /**
  * @}
  */
@@ -35,6 +35,7 @@
 */
 
 /* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
 #include "pka_manager.h"
 #include "rng_manager.h"
 #include "rf_driver_ll_bus.h"
@@ -67,6 +68,25 @@ typedef enum
   PKAMGR_STATE_BUSY
 } PKAMGR_State;
 
+/* State of a job */
+typedef enum
+{
+  PKAMGR_JOB_FREE     =  0,
+  PKAMGR_JOB_QUEUED,
+  PKAMGR_JOB_RUNNING,
+  PKAMGR_JOB_CANCELLED
+} PKAMGR_JobState;
+
+typedef struct
+{
+  uint32_t keys[24];            /* | Secret Key | Public Key X-coord | Public Key Y-coord | */
+  PKAMGR_funcCB funcCB;
+  uint16_t id;                  /* Also gives the request order */
+  uint8_t state;
+  uint8_t priority;
+  uint8_t isrStart;             /* The job can be started from the PKA interrupt */
+} PKAMGR_Job;
+
 /**
 * @}
 */
@@ -78,6 +98,19 @@ typedef enum
 __disable_irq(); \
   /* Must be called in the same or in a lower scope of ATOMIC_SECTION_BEGIN */
 #define ATOMIC_SECTION_END() __set_PRIMASK(uwPRIMASK_Bit)
+
+#define NO_JOB  0xFFU
+
+/* On BlueNRG-LPS and BlueNRG-LPF the start of a DHKey computation waits for the
+   PKA interrupt (checks of the public key): it cannot be started from the PKA interrupt,
+   it is started by PKAMGR_Tick() */
+#ifndef PKAMGR_DHKEY_START_WAITS
+#if defined(CONFIG_DEVICE_BLUENRG_LPS) || defined(CONFIG_DEVICE_BLUENRG_LPF)
+#define PKAMGR_DHKEY_START_WAITS  1
+#else
+#define PKAMGR_DHKEY_START_WAITS  0
+#endif
+#endif
 /**
 * @}
 */
@@ -87,6 +120,25 @@ __disable_irq(); \
 * @{
 */
 static volatile uint32_t internalState = PKAMGR_STATE_RESET;
+
+static PKAMGR_Job jobs[PKAMGR_QUEUE_SIZE];
+static volatile uint8_t runningJob = NO_JOB;
+static volatile uint8_t queuedJobs;
+static uint16_t lastJobId;
+
+#ifdef PKAMGR_KEY_CACHE
+/* Pool of key pairs: | Secret Key | Public Key X-coord | Public Key Y-coord | */
+static uint32_t keyCache[PKAMGR_KEY_CACHE_SIZE][24];
+/* Remaining uses of each key pair, 0 if not valid */
+static volatile uint8_t keyCacheUses[PKAMGR_KEY_CACHE_SIZE];
+/* Request served with each key pair, reported by PKAMGR_KeyCacheServe() */
+static PKAMGR_funcCB volatile keyCacheClient[PKAMGR_KEY_CACHE_SIZE];
+/* A key pair is being generated for the pool */
+static volatile uint8_t keyCacheFilling;
+/* A key pair has been used: the pool is not filled until the next PKA job
+   (usually the DHKey of the same pairing) has been completed */
+static volatile uint8_t keyCacheHold;
+#endif
 /**
 * @}
 */
@@ -100,6 +152,260 @@ PKAMGR_ResultStatus PKAMGR_PrivateInit(void);
 PKAMGR_ResultStatus PKAMGR_PrivateDeinit(void);
 
 PKAMGR_ResultStatus PKAMGR_Status(void);
+
+PKAMGR_ResultStatus PKAMGR_PrivateStartP256DHkeyGeneration(const uint32_t *secretKey, const uint32_t *publicKey, PKAMGR_funcCB funcCB);
+
+void PKAMGR_TickRequest(void);
+
+static uint8_t PKAMGR_AllocJob(void);
+
+static uint8_t PKAMGR_PickNext(uint8_t fromIsr);
+
+static PKAMGR_ResultStatus PKAMGR_RunNext(uint8_t caller, uint8_t fromIsr);
+
+static void PKAMGR_JobDone(PKAMGR_ResultStatus errorCode, void *args);
+
+#ifdef PKAMGR_KEY_CACHE
+static uint8_t PKAMGR_KeyCacheClaim(PKAMGR_funcCB funcCB);
+
+static void PKAMGR_KeyCacheStore(PKAMGR_ResultStatus errorCode, void *args);
+
+static void PKAMGR_KeyCacheFill(uint8_t fromIsr);
+#endif
+/**
+* @}
+*/
+
+/** @defgroup PKA_Manager_Private_Functions Private Functions
+* @{
+*/
+
+/* Reserve a free job, to be filled outside of the atomic section */
+static uint8_t PKAMGR_AllocJob(void)
+{
+  uint8_t i, slot = NO_JOB;
+  
+  ATOMIC_SECTION_BEGIN();
+  for(i = 0; i < PKAMGR_QUEUE_SIZE; i++)
+  {
+    if(jobs[i].state == PKAMGR_JOB_FREE)
+    {
+      slot = i;
+      jobs[slot].state = PKAMGR_JOB_CANCELLED;
+      break;
+    }
+  }
+  ATOMIC_SECTION_END();
+  
+  return slot;
+}
+
+/* Mark as running the queued job with the highest priority, if the PKA is free.
+   If that job cannot be started from the PKA interrupt, it is left queued for
+   PKAMGR_Tick(), requested with PKAMGR_TickRequest(): the other jobs wait for it. */
+static uint8_t PKAMGR_PickNext(uint8_t fromIsr)
+{
+  uint8_t i, next = NO_JOB, deferred = 0;
+  
+  ATOMIC_SECTION_BEGIN();
+  if(runningJob == NO_JOB)
+  {
+    for(i = 0; i < PKAMGR_QUEUE_SIZE; i++)
+    {
+      if(jobs[i].state == PKAMGR_JOB_QUEUED &&
+         (next == NO_JOB || jobs[i].priority > jobs[next].priority ||
+          (jobs[i].priority == jobs[next].priority && (int16_t)(jobs[i].id - jobs[next].id) < 0)))
+      {
+        next = i;
+      }
+    }
+    if(next != NO_JOB && fromIsr && !jobs[next].isrStart)
+    {
+      next = NO_JOB;
+      deferred = 1;
+    }
+    if(next != NO_JOB)
+    {
+      jobs[next].state = PKAMGR_JOB_RUNNING;
+      runningJob = next;
+      queuedJobs--;
+    }
+  }
+  ATOMIC_SECTION_END();
+  
+  if(deferred)
+    PKAMGR_TickRequest();
+  
+  return next;
+}
+
+/* Start the queued job with the highest priority, if the PKA is free.
+   If the job given by caller cannot be started, its error is returned and
+   the job is released. The other jobs report the error to their callback. */
+static PKAMGR_ResultStatus PKAMGR_RunNext(uint8_t caller, uint8_t fromIsr)
+{
+  PKAMGR_ResultStatus status;
+  PKAMGR_funcCB funcCB;
+  uint8_t next;
+  
+  while(1)
+  {
+    next = PKAMGR_PickNext(fromIsr);
+    if(next == NO_JOB)
+      return PKAMGR_SUCCESS;
+    
+    status = PKAMGR_PrivateStartP256DHkeyGeneration(&jobs[next].keys[0], &jobs[next].keys[8], PKAMGR_JobDone);
+    if(status == PKAMGR_SUCCESS)
+      return PKAMGR_SUCCESS;
+    
+    ATOMIC_SECTION_BEGIN();
+    runningJob = NO_JOB;
+    funcCB = NULL;
+    if(status == PKAMGR_ERR_BUSY && jobs[next].state == PKAMGR_JOB_RUNNING)
+    {
+      /* PKA locked by a direct user of PKAMGR_Lock(): retried by PKAMGR_Unlock() */
+      jobs[next].state = PKAMGR_JOB_QUEUED;
+      queuedJobs++;
+    }
+    else
+    {
+      if(jobs[next].state == PKAMGR_JOB_RUNNING && next != caller)
+        funcCB = jobs[next].funcCB;
+      /* Kept reserved until the callback returns: the keys are passed as args */
+      jobs[next].state = PKAMGR_JOB_CANCELLED;
+    }
+    ATOMIC_SECTION_END();
+    
+    if(status == PKAMGR_ERR_BUSY)
+      return PKAMGR_SUCCESS;
+    if(funcCB != NULL)
+      funcCB(status, jobs[next].keys);
+    jobs[next].state = PKAMGR_JOB_FREE;
+    if(next == caller)
+      return status;
+  }
+}
+
+/* Completion of the running job, called from the PKA interrupt */
+static void PKAMGR_JobDone(PKAMGR_ResultStatus errorCode, void *args)
+{
+  PKAMGR_funcCB funcCB = NULL;
+  
+  ATOMIC_SECTION_BEGIN();
+  if(runningJob != NO_JOB)
+  {
+#ifdef PKAMGR_KEY_CACHE
+    if(jobs[runningJob].funcCB != PKAMGR_KeyCacheStore)
+      keyCacheHold = 0;
+#endif
+    if(jobs[runningJob].state == PKAMGR_JOB_RUNNING)
+      funcCB = jobs[runningJob].funcCB;
+    jobs[runningJob].state = PKAMGR_JOB_FREE;
+    runningJob = NO_JOB;
+  }
+  ATOMIC_SECTION_END();
+  
+  if(funcCB != NULL)
+    funcCB(errorCode, args);
+  
+  /* The args are no longer used: the PKA can be given to the next job */
+  if(queuedJobs != 0)
+    PKAMGR_RunNext(NO_JOB, 1);
+#ifdef PKAMGR_KEY_CACHE
+  else
+    PKAMGR_KeyCacheFill(1);
+#endif
+}
+
+#ifdef PKAMGR_KEY_CACHE
+/* Reserve a key pair of the pool for funcCB, if any. It is reported from the
+   PKA interrupt, like a key pair generated by the PKA. */
+static uint8_t PKAMGR_KeyCacheClaim(PKAMGR_funcCB funcCB)
+{
+  uint8_t i, found = 0;
+  
+  ATOMIC_SECTION_BEGIN();
+  for(i = 0; i < PKAMGR_KEY_CACHE_SIZE; i++)
+  {
+    if(keyCacheUses[i] != 0 && keyCacheClient[i] == NULL)
+    {
+      keyCacheClient[i] = funcCB;
+      found = 1;
+      break;
+    }
+  }
+  ATOMIC_SECTION_END();
+  
+  if(found)
+    NVIC_SetPendingIRQ(PKA_IRQn);
+  
+  return found;
+}
+
+/* Completion of a key pair generation for the pool, called from the PKA interrupt */
+static void PKAMGR_KeyCacheStore(PKAMGR_ResultStatus errorCode, void *args)
+{
+  uint8_t i, j;
+  
+  if(errorCode == PKAMGR_SUCCESS)
+  {
+    for(i = 0; i < PKAMGR_KEY_CACHE_SIZE; i++)
+    {
+      if(keyCacheUses[i] == 0 && keyCacheClient[i] == NULL)
+      {
+        for(j = 0; j < 24; j++)
+          keyCache[i][j] = ((uint32_t *)args)[j];
+        keyCacheUses[i] = PKAMGR_KEY_CACHE_REUSE;
+        break;
+      }
+    }
+  }
+  keyCacheFilling = 0;
+}
+
+/* Generate a key pair for the pool when the PKA has nothing else to do.
+   From an interrupt the secret key is taken only if the RNG pool holds it, since
+   RNGMGR_GetRandomBytes() waits for the RNG otherwise: the fill is then left to
+   PKAMGR_Tick(), requested with PKAMGR_TickRequest(). */
+static void PKAMGR_KeyCacheFill(uint8_t fromIsr)
+{
+  uint32_t secretKey[8];
+  uint8_t i, start, deferred;
+  
+  if(keyCacheHold && PKAMGR_KeyCacheLevel() != 0)
+    return;
+  
+  for(i = 0; i < PKAMGR_KEY_CACHE_SIZE; i++)
+  {
+    if(keyCacheUses[i] == 0 && keyCacheClient[i] == NULL)
+      break;
+  }
+  if(i == PKAMGR_KEY_CACHE_SIZE)
+    return;
+  
+  /* Called from the PKA interrupt and from PKAMGR_Tick() */
+  ATOMIC_SECTION_BEGIN();
+  start = (!keyCacheFilling && internalState == PKAMGR_STATE_IDLE && queuedJobs == 0);
+  deferred = (start && fromIsr && RNGMGR_PoolLevel() < sizeof(secretKey) / 2U);
+  if(deferred)
+    start = 0;
+  if(start)
+    keyCacheFilling = 1;
+  ATOMIC_SECTION_END();
+  if(deferred)
+    PKAMGR_TickRequest();
+  if(!start)
+    return;
+  
+  if(RNGMGR_GetRandomBytes((uint8_t *)secretKey, sizeof(secretKey)) != RNGMGR_SUCCESS ||
+     PKAMGR_QueueP256PublicKeyGeneration(secretKey, PKAMGR_KeyCacheStore, PKAMGR_PRIORITY_APPLICATION, NULL) != PKAMGR_SUCCESS)
+    keyCacheFilling = 0;
+  
+  for(i = 0; i < 8; i++)
+    secretKey[i] = 0;
+}
+#endif
+
 /**
 * @}
 */
@@ -129,6 +435,11 @@ PKAMGR_ResultStatus PKAMGR_Deinit(void)
   {
     ATOMIC_SECTION_BEGIN();
     internalState = PKAMGR_STATE_RESET;
+    /* Pending jobs are dropped */
+    for(uint8_t i = 0; i < PKAMGR_QUEUE_SIZE; i++)
+      jobs[i].state = PKAMGR_JOB_FREE;
+    runningJob = NO_JOB;
+    queuedJobs = 0;
     ATOMIC_SECTION_END();
     return_value = PKAMGR_SUCCESS;
   }
@@ -140,8 +451,15 @@ PKAMGR_ResultStatus PKAMGR_SleepCheck(void)
 {
   PKAMGR_ResultStatus return_value = PKAMGR_ERR_BUSY;
 
-  if(internalState == PKAMGR_STATE_IDLE)
+  if(internalState == PKAMGR_STATE_IDLE && queuedJobs == 0)
     return_value = PKAMGR_SUCCESS;
+#ifdef PKAMGR_KEY_CACHE
+  for(uint8_t i = 0; i < PKAMGR_KEY_CACHE_SIZE; i++)
+  {
+    if(keyCacheClient[i] != NULL)
+      return_value = PKAMGR_ERR_BUSY;
+  }
+#endif
 
   return return_value;
 }
@@ -169,6 +487,7 @@ PKAMGR_ResultStatus PKAMGR_Lock()
 PKAMGR_ResultStatus PKAMGR_Unlock()
 {
   PKAMGR_ResultStatus return_value = PKAMGR_SUCCESS;
+  uint8_t startNext;
 
   /* Only one consumer (Application layer or Stack) can use the PKA at the time */
   ATOMIC_SECTION_BEGIN();
@@ -181,19 +500,187 @@ PKAMGR_ResultStatus PKAMGR_Unlock()
     /* Unlock mechanism to access concurrently at the PKA resource */
     internalState = PKAMGR_STATE_IDLE;
   }
+  /* Released by a direct user of PKAMGR_Lock(): the queued jobs were waiting for it.
+     A job of the queue is completed by PKAMGR_JobDone(). */
+  startNext = (return_value == PKAMGR_SUCCESS && runningJob == NO_JOB && queuedJobs != 0);
   ATOMIC_SECTION_END();
   
+  if(startNext)
+    PKAMGR_RunNext(NO_JOB, 1);
+  
   return return_value;
 }
 
 
+PKAMGR_ResultStatus PKAMGR_Tick(void)
+{
+#ifdef PKAMGR_KEY_CACHE
+  PKAMGR_KeyCacheServe();
+  PKAMGR_KeyCacheFill(0);
+#endif
+  
+  if(queuedJobs == 0 || runningJob != NO_JOB)
+    return PKAMGR_SUCCESS;
+  
+  return PKAMGR_RunNext(NO_JOB, 0);
+}
+
 PKAMGR_ResultStatus PKAMGR_StartP256PublicKeyGeneration(const uint32_t *private_key, PKAMGR_funcCB funcCB)
 {  
+#ifdef PKAMGR_KEY_CACHE
+  /* The secret key of the pool is used instead of private_key: it is reported
+     in the callback args, like the one generated by the PKA. */
+  if(PKAMGR_KeyCacheClaim(funcCB))
+    return PKAMGR_SUCCESS;
+#endif
+  
   return PKAMGR_StartP256DHkeyGeneration(private_key, (uint32_t *)&PKAStartPoint[0], funcCB);
 }  
 
+PKAMGR_ResultStatus PKAMGR_StartP256DHkeyGeneration(const uint32_t *secretKey, const uint32_t *publicKey, PKAMGR_funcCB funcCB)
+{
+  return PKAMGR_QueueP256DHkeyGeneration(secretKey, publicKey, funcCB, PKAMGR_PRIORITY_STACK, NULL);
+}
+
+PKAMGR_ResultStatus PKAMGR_QueueP256PublicKeyGeneration(const uint32_t *private_key, PKAMGR_funcCB funcCB,
+                                                        PKAMGR_Priority priority, uint16_t *jobId)
+{
+  return PKAMGR_QueueP256DHkeyGeneration(private_key, (uint32_t *)&PKAStartPoint[0], funcCB, priority, jobId);
+}
 
-WEAK_FUNCTION(PKAMGR_ResultStatus PKAMGR_StartP256DHkeyGeneration(const uint32_t *secretKey, const uint32_t *publicKey, PKAMGR_funcCB funcCB))
+PKAMGR_ResultStatus PKAMGR_QueueP256DHkeyGeneration(const uint32_t *secretKey, const uint32_t *publicKey, PKAMGR_funcCB funcCB,
+                                                    PKAMGR_Priority priority, uint16_t *jobId)
+{
+  uint8_t i, slot = PKAMGR_AllocJob();
+  
+  if(slot == NO_JOB)
+    return PKAMGR_ERR_BUSY;
+  
+  for(i = 0; i < 8; i++)
+    jobs[slot].keys[i] = secretKey[i];
+  for(i = 0; i < 16; i++)
+    jobs[slot].keys[8 + i] = publicKey[i];
+  jobs[slot].funcCB = funcCB;
+  jobs[slot].priority = (uint8_t)priority;
+  jobs[slot].isrStart = 1;
+  for(i = 0; i < 16 && PKAMGR_DHKEY_START_WAITS; i++)
+  {
+    if(publicKey[i] != PKAStartPoint[i])
+    {
+      jobs[slot].isrStart = 0;
+      break;
+    }
+  }
+  
+  ATOMIC_SECTION_BEGIN();
+  if(++lastJobId == PKAMGR_INVALID_JOB)
+    lastJobId++;
+  jobs[slot].id = lastJobId;
+  jobs[slot].state = PKAMGR_JOB_QUEUED;
+  queuedJobs++;
+  ATOMIC_SECTION_END();
+  
+  if(jobId != NULL)
+    *jobId = jobs[slot].id;
+  
+  /* Started now if the PKA is free, as an unqueued request */
+  return PKAMGR_RunNext(slot, 0);
+}
+
+PKAMGR_ResultStatus PKAMGR_Cancel(uint16_t jobId)
+{
+  PKAMGR_ResultStatus return_value = PKAMGR_ERR_PARAM;
+  
+  ATOMIC_SECTION_BEGIN();
+  for(uint8_t i = 0; i < PKAMGR_QUEUE_SIZE; i++)
+  {
+    if(jobId != PKAMGR_INVALID_JOB && jobs[i].id == jobId)
+    {
+      if(jobs[i].state == PKAMGR_JOB_QUEUED)
+      {
+        jobs[i].state = PKAMGR_JOB_FREE;
+        queuedJobs--;
+        return_value = PKAMGR_SUCCESS;
+      }
+      else if(jobs[i].state == PKAMGR_JOB_RUNNING)
+      {
+        /* The result is discarded by PKAMGR_JobDone() */
+        jobs[i].state = PKAMGR_JOB_CANCELLED;
+        return_value = PKAMGR_SUCCESS;
+      }
+      break;
+    }
+  }
+  ATOMIC_SECTION_END();
+  
+  return return_value;
+}
+
+void PKAMGR_KeyCacheFlush(void)
+{
+#ifdef PKAMGR_KEY_CACHE
+  uint8_t i, j;
+  
+  ATOMIC_SECTION_BEGIN();
+  for(i = 0; i < PKAMGR_KEY_CACHE_SIZE; i++)
+  {
+    /* The key pairs already reserved are still reported */
+    if(keyCacheClient[i] != NULL)
+      continue;
+    keyCacheUses[i] = 0;
+    for(j = 0; j < 8; j++)
+      keyCache[i][j] = 0;
+  }
+  ATOMIC_SECTION_END();
+#endif
+}
+
+uint8_t PKAMGR_KeyCacheLevel(void)
+{
+  uint8_t level = 0;
+#ifdef PKAMGR_KEY_CACHE
+  uint8_t i;
+  
+  for(i = 0; i < PKAMGR_KEY_CACHE_SIZE; i++)
+  {
+    if(keyCacheUses[i] != 0 && keyCacheClient[i] == NULL)
+      level++;
+  }
+#endif
+  
+  return level;
+}
+
+void PKAMGR_KeyCacheServe(void)
+{
+#ifdef PKAMGR_KEY_CACHE
+  PKAMGR_funcCB funcCB;
+  uint8_t i, j;
+  
+  for(i = 0; i < PKAMGR_KEY_CACHE_SIZE; i++)
+  {
+    funcCB = keyCacheClient[i];
+    if(funcCB == NULL)
+      continue;
+    
+    funcCB(PKAMGR_SUCCESS, keyCache[i]);
+    
+    keyCacheHold = 1;
+    keyCacheClient[i] = NULL;
+    if(--keyCacheUses[i] == 0)
+    {
+      /* Do not keep the secret key once the key pair is discarded */
+      for(j = 0; j < 8; j++)
+        keyCache[i][j] = 0;
+    }
+  }
+  
+  /* Only if the pool is empty: see keyCacheHold. Called at the end of the PKA interrupt handler. */
+  PKAMGR_KeyCacheFill(1);
+#endif
+}
+
+WEAK_FUNCTION(PKAMGR_ResultStatus PKAMGR_PrivateStartP256DHkeyGeneration(const uint32_t *secretKey, const uint32_t *publicKey, PKAMGR_funcCB funcCB))
 {
   (void) secretKey;                                 /* To avoid gcc/g++ warnings */
   (void) publicKey;                                 /* To avoid gcc/g++ warnings */
@@ -204,6 +691,12 @@ WEAK_FUNCTION(PKAMGR_ResultStatus PKAMGR_StartP256DHkeyGeneration(const uint32_t
   in the dedicated board file */
 }
 
+WEAK_FUNCTION(void PKAMGR_TickRequest(void))
+{
+  /* NOTE : This function should not be modified: without a port file implementing it,
+  PKAMGR_Tick() must be called from the application main loop */
+}
+
 WEAK_FUNCTION(PKAMGR_ResultStatus PKAMGR_PrivateInit(void))
 {
   return PKAMGR_SUCCESS;
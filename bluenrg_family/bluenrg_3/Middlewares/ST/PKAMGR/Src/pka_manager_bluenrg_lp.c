@@ -57,6 +57,7 @@ static uint32_t ret[24] = {0};
 */
 PKAMGR_ResultStatus PKAMGR_PrivateInit(void);
 PKAMGR_ResultStatus PKAMGR_PrivateDeinit(void);
+PKAMGR_ResultStatus PKAMGR_PrivateStartP256DHkeyGeneration(const uint32_t* secretKey, const uint32_t* publicKey, PKAMGR_funcCB funcCB);
 void (*PKAMGR_funcCB_LP)(PKAMGR_ResultStatus errorCode, void *args);
 /**
 * @}
@@ -107,7 +108,7 @@ uint8_t PKAMGR_PowerSaveLevelCheck(uint8_t x){
   }
 }
 
-PKAMGR_ResultStatus PKAMGR_StartP256DHkeyGeneration(const uint32_t* secretKey, const uint32_t* publicKey, PKAMGR_funcCB funcCB)
+PKAMGR_ResultStatus PKAMGR_PrivateStartP256DHkeyGeneration(const uint32_t* secretKey, const uint32_t* publicKey, PKAMGR_funcCB funcCB)
 {
   /* Set the PKA internal state to busy */
   if(PKAMGR_Lock()!=PKAMGR_SUCCESS)
@@ -195,6 +196,9 @@ void PKAMGR_IRQHandler(void)
       PKAMGR_funcCB_LP(PKAMGR_SUCCESS, ret);
     }
   }   
+  
+  /* Key pairs of the pool reserved by PKAMGR_StartP256PublicKeyGeneration() */
+  PKAMGR_KeyCacheServe();
 }
 /**
 * @}
@@ -185,6 +185,7 @@ static const uint32_t PKAMGR_P256_b[8] =
 */
 PKAMGR_ResultStatus PKAMGR_PrivateInit(void);
 PKAMGR_ResultStatus PKAMGR_PrivateDeinit(void);
+PKAMGR_ResultStatus PKAMGR_PrivateStartP256DHkeyGeneration(const uint32_t* secretKey, const uint32_t* publicKey, PKAMGR_funcCB funcCB);
 void (*PKAMGR_funcCB_LP)(PKAMGR_ResultStatus error_code, void *args_p);
 void PKAMGR_ExitWithError(uint32_t errorCode);
 void PKAMGR_ProcEnd_StateMachine(void);
@@ -264,7 +265,7 @@ uint8_t PKAMGR_PowerSaveLevelCheck(uint8_t x){
   * @param  
   * 
   */
-PKAMGR_ResultStatus PKAMGR_StartP256DHkeyGeneration(const uint32_t* secretKey, const uint32_t* publicKey, PKAMGR_funcCB funcCB)
+PKAMGR_ResultStatus PKAMGR_PrivateStartP256DHkeyGeneration(const uint32_t* secretKey, const uint32_t* publicKey, PKAMGR_funcCB funcCB)
 {  
   /* Set the PKA internal state to busy */
   if(PKAMGR_Lock()!=PKAMGR_SUCCESS)
@@ -590,6 +591,9 @@ void PKAMGR_IRQHandler(void)
     LL_PKA_ClearFlag_PROCEND(PKA);
     PKAMGR_ProcEnd_StateMachine();
   }
+  
+  /* Key pairs of the pool reserved by PKAMGR_StartP256PublicKeyGeneration() */
+  PKAMGR_KeyCacheServe();
 }
 
 /** 
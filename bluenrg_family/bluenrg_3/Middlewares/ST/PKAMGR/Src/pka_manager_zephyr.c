@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2023 STMicroelectronics
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * PKA Manager jobs started from thread context on Zephyr: the PKA interrupt
+ * submits this work item when it cannot start the next job itself, i.e. a
+ * DHKey computation on BlueNRG-LPS and BlueNRG-LPF, or a key pool fill while
+ * the RNG pool does not hold a secret key.
+ */
+
+#include <zephyr/kernel.h>
+#include "pka_manager.h"
+
+static void pkamgr_tick_handler(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	PKAMGR_Tick();
+}
+
+static K_WORK_DEFINE(pkamgr_tick_work, pkamgr_tick_handler);
+
+void PKAMGR_TickRequest(void)
+{
+	k_work_submit(&pkamgr_tick_work);
+}
@@ -68,6 +68,14 @@ typedef enum
 /** @defgroup RNGMGR_Exported_Constants  Exported Constants
  * @{
  */
+/* Size of the entropy pool (16-bit random numbers) */
+#ifndef RNGMGR_POOL_SIZE
+#define RNGMGR_POOL_SIZE (32U)
+#endif
+/* Pool level below which a request asks for a background refill (RNGMGR_RefillRequest()) */
+#ifndef RNGMGR_POOL_REFILL_LEVEL
+#define RNGMGR_POOL_REFILL_LEVEL (RNGMGR_POOL_SIZE / 2U)
+#endif
 /**
  * @}
  */
@@ -90,6 +98,16 @@ RNGMGR_ResultStatus RNGMGR_GetRandom16(uint32_t* buffer, uint8_t isr);
 
 RNGMGR_ResultStatus RNGMGR_GetRandom32(uint32_t* buffer);
 
+RNGMGR_ResultStatus RNGMGR_GetRandomBytes(uint8_t* buffer, uint16_t size);
+
+void RNGMGR_Tick(void);
+
+uint16_t RNGMGR_PoolLevel(void);
+
+uint8_t RNGMGR_PowerSaveLevelCheck(uint8_t level);
+
+void RNGMGR_RefillRequest(void);
+
 
 /**
   * @}
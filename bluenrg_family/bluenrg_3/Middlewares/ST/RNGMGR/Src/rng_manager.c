@@ -2,7 +2,7 @@
 ******************************************************************************
 * @file    rng_manager.c
 * @author  AMS - RF Application Team
-* @brief   This file provides weak functions for RNG Manager
+* @brief   This file provides the entropy pool and weak functions for RNG Manager
 *
 ******************************************************************************
 * @attention
@@ -37,6 +37,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "rng_manager.h"
 #include "compiler.h"
+#include "bluenrg_lpx.h"
 
 /** @defgroup RNG_Manager  RNG MANAGER
 * @{
@@ -52,6 +53,10 @@
 /** @defgroup RNGMGR_Private_Defines Private Defines
 * @{
 */
+#define ATOMIC_SECTION_BEGIN() uint32_t uwPRIMASK_Bit = __get_PRIMASK(); \
+__disable_irq(); \
+  /* Must be called in the same or in a lower scope of ATOMIC_SECTION_BEGIN */
+#define ATOMIC_SECTION_END() __set_PRIMASK(uwPRIMASK_Bit)
 /**
 * @}
 */
@@ -66,6 +71,10 @@
 /** @defgroup RNGMGR_Private_Variables Private Variables
 * @{
 */  
+/* Entropy pool: ring buffer of 16-bit random numbers, refilled in background by RNGMGR_Tick() */
+static uint16_t pool[RNGMGR_POOL_SIZE];
+static volatile uint16_t poolHead;  /* Next random number to be read */
+static volatile uint16_t poolCount; /* Random numbers available */
 /**
 * @}
 */
@@ -80,6 +89,66 @@
 /** @defgroup RNGMGR_Private_FunctionPrototypes Private Function Prototypes
 * @{
 */
+uint8_t RNGMGR_PrivateRead(uint32_t* buffer);
+void RNGMGR_RefillRequest(void);
+/**
+* @}
+*/
+
+/** @defgroup RNGMGR_Private_Functions Private Functions
+* @{
+*/
+/* It reads the random number generated by the RNG, if any, and it adds its 16-bit halves to the pool as long as there
+   is room. It must be called in an atomic section: the RNG read and the pool update are done together, so that the
+   same random number is never read by the main loop and by an interrupt handler.
+   It returns the number of random bytes read from the RNG. */
+static uint8_t RNGMGR_PoolRead(void)
+{
+  uint32_t random = 0;
+  uint8_t size = RNGMGR_PrivateRead(&random);
+  uint8_t read = size;
+  
+  for (; (size >= 2) && (poolCount < RNGMGR_POOL_SIZE); size -= 2)
+  {
+    pool[(poolHead + poolCount) % RNGMGR_POOL_SIZE] = (uint16_t)random;
+    poolCount++;
+    random >>= 16;
+  }
+  
+  return read;
+}
+
+/* It takes a 16-bit random number from the pool: it waits for the RNG only when the pool is empty.
+   The pool is not refilled here, to keep the request latency low: when its level drops below
+   RNGMGR_POOL_REFILL_LEVEL, the background refill is requested through RNGMGR_RefillRequest(). */
+static void RNGMGR_PoolGet(uint16_t* value)
+{
+  uint8_t available = 0;
+  uint16_t level = 0;
+  
+  while (!available)
+  {
+    ATOMIC_SECTION_BEGIN();
+    if (poolCount == 0)
+    {
+      RNGMGR_PoolRead();
+    }
+    available = (poolCount != 0);
+    if (available)
+    {
+      *value = pool[poolHead];
+      poolHead = (poolHead + 1) % RNGMGR_POOL_SIZE;
+      poolCount--;
+      level = poolCount;
+    }
+    ATOMIC_SECTION_END();
+  }
+  
+  if (level < RNGMGR_POOL_REFILL_LEVEL)
+  {
+    RNGMGR_RefillRequest();
+  }
+}
 /**
 * @}
 */
@@ -103,6 +172,136 @@ WEAK_FUNCTION(RNGMGR_ResultStatus RNGMGR_Deinit(void))
   in the dedicated board file */
 }
 
+/**
+ * @brief Provide a 16-bit true random number 
+ * @param buffer: pointer to the random value returned
+ * @param isr: 1 = The function is being called from  the radio isr context
+ *             0 = The function is being called from the user context
+ * @return error status: 0 = No error
+ */
+RNGMGR_ResultStatus RNGMGR_GetRandom16(uint32_t* buffer, uint8_t isr)
+{
+  uint16_t value = 0;
+  
+  RNGMGR_PoolGet(&value);
+  buffer[0] = value;
+  
+  return RNGMGR_SUCCESS;
+}
+
+/**
+ * @brief Provide a 32-bit true random number
+ * @param buffer: pointer to the random value returned
+ *
+ * @return error status: 0 = No error
+ */
+RNGMGR_ResultStatus RNGMGR_GetRandom32(uint32_t* buffer)
+{
+  uint16_t *buffer_16 = (uint16_t *) buffer;
+  
+  RNGMGR_PoolGet(&buffer_16[0]);
+  RNGMGR_PoolGet(&buffer_16[1]);
+  
+  return RNGMGR_SUCCESS;
+}
+
+/**
+ * @brief Provide size true random bytes
+ * @param buffer: pointer to the random bytes returned
+ * @param size: number of random bytes
+ *
+ * @return error status: 0 = No error
+ */
+RNGMGR_ResultStatus RNGMGR_GetRandomBytes(uint8_t* buffer, uint16_t size)
+{
+  uint16_t value = 0;
+  
+  while (size != 0)
+  {
+    RNGMGR_PoolGet(&value);
+    buffer[0] = (uint8_t)value;
+    if (size > 1)
+    {
+      buffer[1] = (uint8_t)(value >> 8);
+      buffer += 2;
+      size -= 2;
+    }
+    else
+    {
+      size = 0;
+    }
+  }
+  
+  return RNGMGR_SUCCESS;
+}
+
+/**
+ * @brief Refill the entropy pool with the random numbers already generated by the RNG, without waiting.
+ *        The requests do not refill the pool: this function is called in background, from the
+ *        application main loop, from the power manager idle path (RNGMGR_PowerSaveLevelCheck())
+ *        or from the work item started by RNGMGR_RefillRequest().
+ * @return None
+ */
+void RNGMGR_Tick(void)
+{
+  uint8_t read = 1;
+  
+  while (read != 0)
+  {
+    ATOMIC_SECTION_BEGIN();
+    read = (poolCount < RNGMGR_POOL_SIZE) ? RNGMGR_PoolRead() : 0;
+    ATOMIC_SECTION_END();
+  }
+}
+
+/**
+ * @brief Power manager hook, called by HAL_PWR_MNGR_Request() each time the application is idle:
+ *        the entropy pool is refilled before the power save negotiation.
+ *        The RNG does not prevent the power save.
+ * @param level: power save level requested
+ * @return The power save level requested
+ */
+uint8_t RNGMGR_PowerSaveLevelCheck(uint8_t level)
+{
+  RNGMGR_Tick();
+  
+  return level;
+}
+
+/**
+ * @brief Provide the random numbers available in the entropy pool
+ * @return Number of 16-bit random numbers in the pool
+ */
+uint16_t RNGMGR_PoolLevel(void)
+{
+  return poolCount;
+}
+
+/**
+ * @brief Read a random number generated by the RNG, without waiting
+ * @param buffer: pointer to the random value returned
+ * @return number of random bytes read: 0 if no random number is ready
+ */
+WEAK_FUNCTION(uint8_t RNGMGR_PrivateRead(uint32_t* buffer))
+{
+  return 0;
+  
+  /* NOTE : This function should not be modified, the callback is implemented 
+  in the dedicated board file */
+}
+
+/**
+ * @brief Request a background refill of the entropy pool, which must call RNGMGR_Tick().
+ *        It is called, from any context, by the requests leaving less than RNGMGR_POOL_REFILL_LEVEL
+ *        random numbers in the pool.
+ * @return None
+ */
+WEAK_FUNCTION(void RNGMGR_RefillRequest(void))
+{
+  /* NOTE : This function should not be modified, the callback is implemented 
+  in the dedicated port file */
+}
+
 /**
 * @}
 */
@@ -108,43 +108,18 @@ RNGMGR_ResultStatus RNGMGR_Deinit(void)
 
 
 /**
- * @brief Provide a 16-bit true random number 
+ * @brief Read the 16-bit random number generated by the RNG, without waiting
  * @param buffer: pointer to the random value returned
- * @param isr: 1 = The function is being called from  the radio isr context
- *             0 = The function is being called from the user context
- * @return error status: 0 = No error
+ * @return number of random bytes read: 0 if no random number is ready
  */
-RNGMGR_ResultStatus RNGMGR_GetRandom16(uint32_t* buffer, uint8_t isr)
+uint8_t RNGMGR_PrivateRead(uint32_t* buffer)
 {
-  /* Wait for RNGRDY signal */
-  while (!LL_RNG_IsActiveFlag_RNGRDY(RNG));
+  if (!LL_RNG_IsActiveFlag_RNGRDY(RNG))
+    return 0;
   
   buffer[0] = (uint32_t)LL_RNG_ReadRandData16(RNG);
   
-  return RNGMGR_SUCCESS;
-}
-
-/**
- * @brief Provide a 32-bit true random number
- * @param buffer: pointer to the random value returned
- *
- * @return error status: 0 = No error
- */
-RNGMGR_ResultStatus RNGMGR_GetRandom32(uint32_t* buffer)
-{
-  uint16_t *buffer_16 = (uint16_t *) buffer;
-
-  /* Wait for RNGRDY signal */
-  while (!LL_RNG_IsActiveFlag_RNGRDY(RNG));
-
-  buffer_16[0] = (uint16_t)LL_RNG_ReadRandData16(RNG);
-
-/* Wait for RNGRDY signal */
-  while (!LL_RNG_IsActiveFlag_RNGRDY(RNG));
-
-  buffer_16[1] = (uint16_t)LL_RNG_ReadRandData16(RNG);
-
-  return RNGMGR_SUCCESS;
+  return 2;
 }
 
 /**
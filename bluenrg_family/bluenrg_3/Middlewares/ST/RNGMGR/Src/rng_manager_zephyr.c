@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2023 STMicroelectronics
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Background refill of the RNG Manager entropy pool on Zephyr: the requests
+ * that drain the pool submit a work item, which reads the RNG and reschedules
+ * itself until the pool is full. The RNG holds one random number at a time,
+ * so the pool is refilled at the RNG generation rate.
+ */
+
+#include <zephyr/kernel.h>
+#include "rng_manager.h"
+
+static void rngmgr_refill_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+
+	RNGMGR_Tick();
+
+	if (RNGMGR_PoolLevel() < RNGMGR_POOL_SIZE) {
+		k_work_schedule(dwork, K_USEC(CONFIG_BLUENRG_RNGMGR_REFILL_PERIOD_US));
+	}
+}
+
+static K_WORK_DELAYABLE_DEFINE(rngmgr_refill_work, rngmgr_refill_handler);
+
+/* Called from the radio ISR too: k_work_schedule() does not block and does
+ * nothing when the refill is already scheduled.
+ */
+void RNGMGR_RefillRequest(void)
+{
+	k_work_schedule(&rngmgr_refill_work, K_NO_WAIT);
+}
@@ -25,6 +25,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include <stdint.h>
 #include "compiler.h"
+#include "hci_framer.h"
 /* Exported macro ------------------------------------------------------------*/
 
 /* HCI Packet types */
@@ -46,9 +47,10 @@
 /* Exported types ------------------------------------------------------------*/
 
 typedef enum {
-  WAITING_TYPE,
-  WAITING_HEADER,
-  WAITING_PAYLOAD
+  WAITING_TYPE = HCI_FRAMER_WAITING_TYPE,
+  WAITING_HEADER = HCI_FRAMER_WAITING_HEADER,
+  WAITING_PAYLOAD = HCI_FRAMER_WAITING_PAYLOAD,
+  DISCARDING_PAYLOAD = HCI_FRAMER_DISCARDING_PAYLOAD
 }hci_state;
 
 typedef PACKED(struct) _hci_cmd_hdr{
@@ -85,6 +87,10 @@ typedef PACKED(struct) _hci_vendor_hdr{
 
 /* HCI library functions. */
 extern hci_state hci_input(uint8_t *buff, uint16_t len);
+extern void hci_input_drop(void);
+
+/* Packets dropped by hci_input_drop() on transport errors */
+extern uint16_t hci_input_error_count;
 
 extern uint8_t buffer_out[];
 extern uint16_t buffer_out_len;
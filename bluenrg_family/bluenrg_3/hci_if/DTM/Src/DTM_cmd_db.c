@@ -29,7 +29,7 @@
 #include "aci_adv_nwk.h"
 #include "aci_l2cap_nwk.h"
 #include "DTM_cmd_db.h"
-#include "DTM_cmd_en.h"
+#include "dtm_cmd_en.h"
 
 #define HCI_MAX_PAYLOAD_SIZE 256
 #include <stdint.h>
@@ -33,6 +33,8 @@
 #include "bleplat.h"
 #include "rf_driver_hal_vtimer.h"
 #include "nvm_db.h"
+#include "rng_manager.h"
+#include "pka_manager.h"
 #include "DTM_burst.h"
 #include "aci_l2cap_nwk.h"
 #include "aci_gatt_nwk.h"
@@ -190,6 +192,8 @@ int main(void)
     
     HAL_VTIMER_Tick();
     BLE_STACK_Tick();
+    /* Start the queued P-256 operations */
+    PKAMGR_Tick();
     
 #if (BLESTACK_CONTROLLER_ONLY == 0) && (CONNECTION_ENABLED == 1)
     /* NVM and burst commands not needed without Host or connection support. */
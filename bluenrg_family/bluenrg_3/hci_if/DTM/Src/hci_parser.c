@@ -30,10 +30,11 @@
 #include "cmd.h"
 #include "transport_layer.h"
 #include "osal.h"
-#include "DTM_cmd_en.h"
+#include "dtm_cmd_en.h"
 #include "adv_buff_alloc.h"
 #include "pawr_buff_alloc.h"
 #include "adv_buff_alloc_tiny.h"
+#include "hci_framer.h"
 
 
 /* Private macro -------------------------------------------------------------*/
@@ -51,108 +52,47 @@
 
 /* Private variables ---------------------------------------------------------*/
 static uint8_t hci_buffer[HCI_PACKET_SIZE];
-static volatile uint16_t hci_pckt_len = 0;
 
 uint8_t buffer_out[HCI_PACKET_SIZE];
 uint16_t buffer_out_len=0;
 
+uint16_t hci_input_error_count = 0;
+
 /* Private function prototypes -----------------------------------------------*/
-void packet_received(void);
+static void packet_received(void *cb_ctx, uint8_t *packet, uint16_t pckt_len);
+
+#ifdef SPI_INTERFACE
+/* SPI frames are not overwritten before the command has been processed */
+#define HCI_FRAMER_OPTIONS HCI_FRAMER_OPT_ZERO_COPY
+#else
+#define HCI_FRAMER_OPTIONS 0
+#endif
+
+static hci_framer_t hci_framer = HCI_FRAMER_INITIALIZER(hci_buffer, HCI_PACKET_SIZE,
+                                                        HCI_FRAMER_TYPE_CMD | HCI_FRAMER_TYPE_CMD_EXT |
+                                                        HCI_FRAMER_TYPE_ACL | HCI_FRAMER_TYPE_ISO |
+                                                        HCI_FRAMER_TYPE_VENDOR,
+                                                        HCI_FRAMER_OPTIONS, packet_received, NULL);
 
 hci_state hci_input(uint8_t *buff, uint16_t len)
 {
-	static hci_state state = WAITING_TYPE;
-	
-	static uint16_t collected_payload_len = 0;
-	static uint16_t payload_len;
-	static uint16_t header_len;
-	uint8_t byte;
-	uint16_t i = 0;
-	
-	while(hci_pckt_len < HCI_PACKET_SIZE && i++ < len){
-		
-	byte = *buff++;
+	return (hci_state)hci_framer_input(&hci_framer, buff, len);
+}
 
-	if(state == WAITING_TYPE)
-		hci_pckt_len = 0;
-	
-	hci_buffer[hci_pckt_len++] = byte;		
-		
-	if(state == WAITING_TYPE){
-		
-		state = WAITING_HEADER;
-		
-		if(byte == HCI_COMMAND_PKT){
-		header_len = 4;
-		}
-		else if(byte == HCI_COMMAND_EXT_PKT){
-		header_len = 5;
-		}
-		else if(byte == HCI_ACLDATA_PKT || byte == HCI_ISO_DATA_PKT){
-		header_len = 5;
-		}
-		else if(byte == HCI_VENDOR_PKT){
-		header_len = 4;
-		}
-		else {
-		state = WAITING_TYPE;		
-		}
-	}
-	else if(state == WAITING_HEADER){
-		
-		if(hci_pckt_len == header_len){
-					
-		// The entire header has been received
-		uint8_t pckt_type = hci_buffer[0];
-		collected_payload_len = 0;
-		payload_len = 0;
-		
-		if(pckt_type == HCI_COMMAND_PKT){
-			hci_cmd_hdr *hdr = (hci_cmd_hdr *)hci_buffer;
-			payload_len = hdr->param_len;
-		}
-		else if(pckt_type == HCI_COMMAND_EXT_PKT){
-			hci_cmd_ext_hdr *hdr = (hci_cmd_ext_hdr *)hci_buffer;
-			payload_len = hdr->param_len;
-		}
-		else if(pckt_type == HCI_ACLDATA_PKT){
-			hci_acl_hdr *hdr = (hci_acl_hdr *)hci_buffer;
-			payload_len = hdr->dlen;
-		}
-		else if(pckt_type == HCI_ISO_DATA_PKT){
-			hci_iso_data_hdr *hdr = (hci_iso_data_hdr *)hci_buffer;
-			payload_len = hdr->dlen & 0x3FFF;
-		}
-		else if(pckt_type == HCI_VENDOR_PKT){
-			hci_vendor_hdr *hdr = (hci_vendor_hdr *)hci_buffer;
-			payload_len = hdr->param_len;
-		}
-		if(payload_len == 0){
-			state = WAITING_TYPE;
-			packet_received();
-		}
-		else {
-			state = WAITING_PAYLOAD;						
-		}
-		}		
-	}
-	else if(state == WAITING_PAYLOAD){
-		collected_payload_len++;
-		if(collected_payload_len >= payload_len){
-		state = WAITING_TYPE;
-		packet_received();
-		}		
-	}
-	}
-	
-	return state;
+/* Called by the transport when received bytes have been lost (e.g. UART overrun)
+   or when a transfer ends in the middle of a packet: the packet being received is
+   dropped and the parser waits for the type of the next packet. */
+void hci_input_drop(void)
+{
+	hci_framer_reset(&hci_framer);
+	hci_input_error_count++;
 }
 
-void packet_received(void)
+static void packet_received(void *cb_ctx, uint8_t *packet, uint16_t pckt_len)
 { 
-	switch(hci_buffer[HCI_TYPE_OFFSET]) {
+	switch(packet[HCI_TYPE_OFFSET]) {
 	case HCI_VENDOR_PKT: /* In SPI mode never gets HCI_VENDOR_PKT */
-	buffer_out_len = parse_cmd(hci_buffer, hci_pckt_len, buffer_out);
+	buffer_out_len = parse_cmd(packet, pckt_len, buffer_out);
 	send_event(buffer_out, buffer_out_len, 1);
 	break;
 	case HCI_ACLDATA_PKT:
@@ -163,11 +103,11 @@ void packet_received(void)
 		uint8_t	pb_flag;
 		uint8_t	bc_flag;
 		
-		connHandle = ((hci_buffer[2] & 0x0F) << 8) + hci_buffer[1];
-		dataLen = (hci_buffer[4] << 8) + hci_buffer[3];
-		pduData = hci_buffer+5;
-		pb_flag = (hci_buffer[2] >> 4) & 0x3;
-		bc_flag = (hci_buffer[2] >> 6) & 0x3;
+		connHandle = ((packet[2] & 0x0F) << 8) + packet[1];
+		dataLen = (packet[4] << 8) + packet[3];
+		pduData = packet+5;
+		pb_flag = (packet[2] >> 4) & 0x3;
+		bc_flag = (packet[2] >> 6) & 0x3;
 		hci_tx_acl_data(connHandle, pb_flag, bc_flag, dataLen, pduData);
 	}
 	break;
@@ -180,18 +120,18 @@ void packet_received(void)
 		uint8_t	pb_flag;
 		uint8_t	ts_flag;
 		
-		connection_hanlde = LE_TO_HOST_16(hci_buffer+1) & 0x0FFF;
-		iso_data_load_len = LE_TO_HOST_16(hci_buffer+3) & 0x3FFF;
-		pb_flag = (hci_buffer[2] >> 4) & 0x3;
-		ts_flag = (hci_buffer[2] >> 6) & 0x1;
-		iso_data_load = &hci_buffer[5];
+		connection_hanlde = LE_TO_HOST_16(packet+1) & 0x0FFF;
+		iso_data_load_len = LE_TO_HOST_16(packet+3) & 0x3FFF;
+		pb_flag = (packet[2] >> 4) & 0x3;
+		ts_flag = (packet[2] >> 6) & 0x1;
+		iso_data_load = &packet[5];
 		hci_tx_iso_data(connection_hanlde, pb_flag, ts_flag, iso_data_load_len, iso_data_load);
 	}
 	break;
 #endif
 	case HCI_COMMAND_PKT:
 	case HCI_COMMAND_EXT_PKT:
-	send_command(hci_buffer, hci_pckt_len);
+	send_command(packet, pckt_len);
 	break;
 	default:
 	// Error case not allowed TBR
@@ -123,6 +123,8 @@ void USART1_IRQHandler(void)
       dbg_overrun_error_flag_usart++;
       LL_USART_RequestRxDataFlush(BSP_UART);
       LL_USART_ClearFlag_ORE(BSP_UART);
+      /* Bytes lost: resynchronize on the next packet */
+      hci_input_drop();
     }
   }
 #endif
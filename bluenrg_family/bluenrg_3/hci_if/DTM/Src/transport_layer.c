@@ -415,6 +415,12 @@ static void transport_layer_DMA_RX_Data(void)
   volatile int16_t bytes_received;
   volatile uint16_t dma_rx_data_length_reg;
   
+  if (LL_USART_IsActiveFlag_ORE(BSP_UART)) {
+    /* Bytes lost before the ones in the DMA buffer: drop the packet being received */
+    LL_USART_ClearFlag_ORE(BSP_UART);
+    hci_input_drop();
+  }
+  
   dma_rx_data_length_reg = LL_DMA_GetDataLength(DMA1, DMA_CH_UART_RX);
   bytes_received = nmb_bytes_free - dma_rx_data_length_reg;
   if (bytes_received < 0) {
@@ -704,7 +710,10 @@ void advance_spi_dma(uint16_t rx_buffer_len)
 #else
       uint16_t real_len = rx_buffer_len - 5;
 #endif
-      hci_input(&command_fifo_buffer_tmp[5], real_len);
+      if(hci_input(&command_fifo_buffer_tmp[5], real_len) != WAITING_TYPE) {
+        /* Each SPI write carries whole packets: drop the truncated one */
+        hci_input_drop();
+      }
       command_fifo_buffer_tmp[5] = 0;
       command_fifo_buffer_tmp[0] = 0;
     }
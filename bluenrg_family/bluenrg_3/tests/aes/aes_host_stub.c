@@ -0,0 +1,174 @@
+/**
+  ******************************************************************************
+  * @file    aes_host_stub.c
+  * @brief   AES engine of the BLE peripheral, computed by a software AES-128.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "aes_host_stub.h"
+
+/* Written in the key registers after each load: a key equal to this pattern
+   is not seen as loaded again */
+#define KEY_LATCHED     (0xA5C3E187U)
+
+BLUE_TypeDef stub_blue;
+uint32_t stub_aes_runs;
+uint32_t stub_key_loads;
+uint32_t stub_preempt_at;
+void (*stub_preempt)(void);
+
+static uint8_t engine_key[16];
+
+static const uint8_t sbox[256] = {
+  0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+  0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+  0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+  0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+  0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+  0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+  0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+  0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+  0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+  0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+  0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+  0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+  0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+  0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+  0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+  0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static uint8_t xtime(uint8_t x)
+{
+  return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+void stub_aes128_encrypt(const uint8_t key[16], const uint8_t in[16], uint8_t out[16])
+{
+  uint8_t rk[16], s[16], t[16];
+  uint8_t rcon = 1;
+  uint8_t round, i, c;
+
+  memcpy(rk, key, 16);
+  for (i = 0; i < 16; i++)
+    s[i] = in[i] ^ rk[i];
+
+  for (round = 1; round <= 10; round++)
+  {
+    /* Round key */
+    rk[0] ^= sbox[rk[13]] ^ rcon;
+    rk[1] ^= sbox[rk[14]];
+    rk[2] ^= sbox[rk[15]];
+    rk[3] ^= sbox[rk[12]];
+    for (i = 4; i < 16; i++)
+      rk[i] ^= rk[i - 4];
+    rcon = xtime(rcon);
+
+    /* SubBytes and ShiftRows */
+    for (i = 0; i < 16; i++)
+      t[i] = sbox[s[(i + 4 * (i % 4)) % 16]];
+
+    /* MixColumns, except in the last round, and AddRoundKey */
+    for (c = 0; c < 16; c += 4)
+    {
+      if (round < 10)
+      {
+        uint8_t a = t[c] ^ t[c + 1] ^ t[c + 2] ^ t[c + 3];
+        uint8_t t0 = t[c];
+
+        s[c] = t[c] ^ a ^ xtime(t[c] ^ t[c + 1]);
+        s[c + 1] = t[c + 1] ^ a ^ xtime(t[c + 1] ^ t[c + 2]);
+        s[c + 2] = t[c + 2] ^ a ^ xtime(t[c + 2] ^ t[c + 3]);
+        s[c + 3] = t[c + 3] ^ a ^ xtime(t[c + 3] ^ t0);
+      }
+      else
+      {
+        memcpy(&s[c], &t[c], 4);
+      }
+      for (i = c; i < c + 4; i++)
+        s[i] ^= rk[i];
+    }
+  }
+  memcpy(out, s, 16);
+}
+
+void stub_reset(void)
+{
+  memset(&stub_blue, 0, sizeof(stub_blue));
+  memset(engine_key, 0, sizeof(engine_key));
+  stub_blue.MANAESKEY0REG = KEY_LATCHED;
+  stub_blue.MANAESKEY1REG = KEY_LATCHED;
+  stub_blue.MANAESKEY2REG = KEY_LATCHED;
+  stub_blue.MANAESKEY3REG = KEY_LATCHED;
+  stub_aes_runs = 0;
+  stub_key_loads = 0;
+  stub_preempt_at = 0;
+  stub_preempt = NULL;
+}
+
+/* The engine works on the byte reversed block: the first byte is the most
+   significant byte of the last register */
+static void words_to_bytes(volatile uint32_t *w0, volatile uint32_t *w1, volatile uint32_t *w2,
+                           volatile uint32_t *w3, uint8_t *bytes)
+{
+  volatile uint32_t *w[4] = { w0, w1, w2, w3 };
+  uint8_t i;
+
+  for (i = 0; i < 4; i++)
+  {
+    bytes[12 - 4 * i] = (uint8_t)(*w[i] >> 24);
+    bytes[13 - 4 * i] = (uint8_t)(*w[i] >> 16);
+    bytes[14 - 4 * i] = (uint8_t)(*w[i] >> 8);
+    bytes[15 - 4 * i] = (uint8_t)*w[i];
+  }
+}
+
+static uint32_t bytes_to_word(const uint8_t *bytes, uint8_t i)
+{
+  return ((uint32_t)bytes[12 - 4 * i] << 24) | ((uint32_t)bytes[13 - 4 * i] << 16) |
+         ((uint32_t)bytes[14 - 4 * i] << 8) | (uint32_t)bytes[15 - 4 * i];
+}
+
+static void engine_run(void)
+{
+  uint8_t clear[16], cipher[16];
+  void (*preempt)(void);
+
+  if ((stub_blue.MANAESKEY0REG != KEY_LATCHED) || (stub_blue.MANAESKEY1REG != KEY_LATCHED) ||
+      (stub_blue.MANAESKEY2REG != KEY_LATCHED) || (stub_blue.MANAESKEY3REG != KEY_LATCHED))
+  {
+    words_to_bytes(&stub_blue.MANAESKEY0REG, &stub_blue.MANAESKEY1REG,
+                   &stub_blue.MANAESKEY2REG, &stub_blue.MANAESKEY3REG, engine_key);
+    stub_blue.MANAESKEY0REG = KEY_LATCHED;
+    stub_blue.MANAESKEY1REG = KEY_LATCHED;
+    stub_blue.MANAESKEY2REG = KEY_LATCHED;
+    stub_blue.MANAESKEY3REG = KEY_LATCHED;
+    stub_key_loads++;
+  }
+  words_to_bytes(&stub_blue.MANAESCLEARTEXT0REG, &stub_blue.MANAESCLEARTEXT1REG,
+                 &stub_blue.MANAESCLEARTEXT2REG, &stub_blue.MANAESCLEARTEXT3REG, clear);
+  stub_aes128_encrypt(engine_key, clear, cipher);
+  *(volatile uint32_t *)&stub_blue.MANAESCIPHERTEXT0REG = bytes_to_word(cipher, 0);
+  *(volatile uint32_t *)&stub_blue.MANAESCIPHERTEXT1REG = bytes_to_word(cipher, 1);
+  *(volatile uint32_t *)&stub_blue.MANAESCIPHERTEXT2REG = bytes_to_word(cipher, 2);
+  *(volatile uint32_t *)&stub_blue.MANAESCIPHERTEXT3REG = bytes_to_word(cipher, 3);
+  stub_aes_runs++;
+
+  if ((stub_preempt != NULL) && (stub_aes_runs == stub_preempt_at))
+  {
+    preempt = stub_preempt;
+    stub_preempt = NULL;
+    preempt();
+  }
+}
+
+uint32_t stub_aes_read_bit(const volatile uint32_t *reg, uint32_t bit)
+{
+  if ((reg == &stub_blue.MANAESSTATREG) && (stub_blue.MANAESCMDREG & BLUE_MANAESCMDREG_START))
+  {
+    stub_blue.MANAESCMDREG &= ~BLUE_MANAESCMDREG_START;
+    engine_run();
+  }
+  return *reg & bit;
+}
@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file    aes_host_stub.h
+  * @brief   AES engine of the BLE peripheral, computed by a software AES-128
+  *          when the busy flag is polled. The engine latches the key
+  *          registers when they are written, so that the key loads can be
+  *          counted, and it can be preempted by a routine of the test.
+  ******************************************************************************
+  */
+
+#ifndef AES_HOST_STUB_H
+#define AES_HOST_STUB_H
+
+#include <stdint.h>
+#include "bluenrg_lpx.h"
+
+/* Registers of the BLE peripheral */
+extern BLUE_TypeDef stub_blue;
+
+/* Encryptions done by the engine and keys loaded in the engine */
+extern uint32_t stub_aes_runs;
+extern uint32_t stub_key_loads;
+
+/* Called once, after the encryption number stub_preempt_at (1 is the first),
+   before the cipher text is read: as an interrupt using the AES engine */
+extern uint32_t stub_preempt_at;
+extern void (*stub_preempt)(void);
+
+void stub_reset(void);
+
+/* Reference AES-128 (FIPS-197), standard byte order */
+void stub_aes128_encrypt(const uint8_t key[16], const uint8_t in[16], uint8_t out[16]);
+
+/* READ_BIT() of aes_manager_bluenrg_lp.c: the encryption is done when the
+   busy flag is read after a start */
+uint32_t stub_aes_read_bit(const volatile uint32_t *reg, uint32_t bit);
+
+#endif /* AES_HOST_STUB_H */
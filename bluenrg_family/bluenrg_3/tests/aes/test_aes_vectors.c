@@ -0,0 +1,331 @@
+/**
+  ******************************************************************************
+  * @file    test_aes_vectors.c
+  * @brief   AES manager: CTR and CCM known answer tests (SP800-38A F.5.1,
+  *          RFC 3610 packet vector #1, SP800-38C C.1 to C.3), output cleared
+  *          on tag failure, key loads and preemption of the AES engine, and
+  *          throughput of the CTR mode.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include <time.h>
+#include "test_assert.h"
+#include "aes_host_stub.h"
+
+/* The BLUE registers are in host memory and the busy flag starts the engine */
+#undef BLUE
+#define BLUE (&stub_blue)
+#undef READ_BIT
+#define READ_BIT(REG, BIT) stub_aes_read_bit(&(REG), (BIT))
+#include "aes_manager_bluenrg_lp.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define THROUGHPUT_SIZE (1024 * 1024)
+/* AESMGR_BATCH_BLOCKS of aes_manager.c */
+#define BATCH_BLOCKS    (4)
+
+static uint8_t big_buffer[THROUGHPUT_SIZE];
+
+static const uint8_t ctr_key[16] = {
+  0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+static const uint8_t ctr_counter[16] = {
+  0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff,
+};
+static const uint8_t ctr_plain[64] = {
+  0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+  0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+  0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+  0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10,
+};
+static const uint8_t ctr_cipher[64] = {
+  0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+  0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+  0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+  0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee,
+};
+
+typedef struct
+{
+  const char *name;
+  uint8_t key[16];
+  uint8_t nonce[13];
+  uint8_t nonce_length;
+  uint8_t adata[20];
+  uint8_t adata_length;
+  uint8_t plain[24];
+  uint8_t length;
+  uint8_t cipher[24];
+  uint8_t tag[16];
+  uint8_t tag_length;
+} ccm_vector_t;
+
+static const ccm_vector_t ccm_vectors[] = {
+  {
+    "RFC 3610 #1",
+    { 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf },
+    { 0x00, 0x00, 0x00, 0x03, 0x02, 0x01, 0x00, 0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5 }, 13,
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07 }, 8,
+    { 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13,
+      0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e }, 23,
+    { 0x58, 0x8c, 0x97, 0x9a, 0x61, 0xc6, 0x63, 0xd2, 0xf0, 0x66, 0xd0, 0xc2,
+      0xc0, 0xf9, 0x89, 0x80, 0x6d, 0x5f, 0x6b, 0x61, 0xda, 0xc3, 0x84 },
+    { 0x17, 0xe8, 0xd1, 0x2c, 0xfd, 0xf9, 0x26, 0xe0 }, 8,
+  },
+  {
+    "SP800-38C C.1",
+    { 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x4b, 0x4c, 0x4d, 0x4e, 0x4f },
+    { 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16 }, 7,
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07 }, 8,
+    { 0x20, 0x21, 0x22, 0x23 }, 4,
+    { 0x71, 0x62, 0x01, 0x5b },
+    { 0x4d, 0xac, 0x25, 0x5d }, 4,
+  },
+  {
+    "SP800-38C C.2",
+    { 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x4b, 0x4c, 0x4d, 0x4e, 0x4f },
+    { 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17 }, 8,
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f }, 16,
+    { 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f }, 16,
+    { 0xd2, 0xa1, 0xf0, 0xe0, 0x51, 0xea, 0x5f, 0x62, 0x08, 0x1a, 0x77, 0x92, 0x07, 0x3d, 0x59, 0x3d },
+    { 0x1f, 0xc6, 0x4f, 0xbf, 0xac, 0xcd }, 6,
+  },
+  {
+    "SP800-38C C.3",
+    { 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x4b, 0x4c, 0x4d, 0x4e, 0x4f },
+    { 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b }, 12,
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+      0x10, 0x11, 0x12, 0x13 }, 20,
+    { 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b,
+      0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37 }, 24,
+    { 0xe3, 0xb2, 0x01, 0xa9, 0xf5, 0xb7, 0x1a, 0x7a, 0x9b, 0x1c, 0xea, 0xec,
+      0xcd, 0x97, 0xe7, 0x0b, 0x61, 0x76, 0xaa, 0xd9, 0xa4, 0x42, 0x8a, 0xa5 },
+    { 0x48, 0x43, 0x92, 0xfb, 0xc1, 0xb0, 0x99, 0x51 }, 8,
+  },
+};
+
+/* FIPS-197 C.1, encrypted by the preempting routine */
+static const uint8_t fips_key[16] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+};
+static const uint8_t fips_plain[16] = {
+  0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff,
+};
+static const uint8_t fips_cipher[16] = {
+  0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a,
+};
+
+static uint32_t preempt_count;
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Byte reversed block of the AES engine */
+static void to_hw(const uint8_t *block, uint32_t *words)
+{
+  uint8_t i;
+
+  for (i = 0; i < 4; i++)
+  {
+    words[i] = ((uint32_t)block[12 - 4 * i] << 24) | ((uint32_t)block[13 - 4 * i] << 16) |
+               ((uint32_t)block[14 - 4 * i] << 8) | (uint32_t)block[15 - 4 * i];
+  }
+}
+
+/* Interrupt encrypting a block with its own key */
+static void preempt_encrypt(void)
+{
+  uint32_t key[4], plain[4], cipher[4], expected[4];
+
+  to_hw(fips_key, key);
+  to_hw(fips_plain, plain);
+  to_hw(fips_cipher, expected);
+  TEST_CHECK_EQUAL(AESMGR_Encrypt(plain, key, cipher, 1), AESMGR_SUCCESS);
+  TEST_CHECK(memcmp(cipher, expected, sizeof(cipher)) == 0);
+  preempt_count++;
+}
+
+static void test_reference(void)
+{
+  uint8_t out[16];
+
+  stub_aes128_encrypt(fips_key, fips_plain, out);
+  TEST_CHECK(memcmp(out, fips_cipher, 16) == 0);
+}
+
+/* SP800-38A F.5.1 and F.5.2, whole and split at block boundaries */
+static void test_ctr(void)
+{
+  uint8_t counter[16], out[64];
+  uint32_t split;
+
+  stub_reset();
+  memcpy(counter, ctr_counter, 16);
+  TEST_CHECK_EQUAL(AESMGR_CTR_Crypt(ctr_key, counter, ctr_plain, out, sizeof(out)), AESMGR_SUCCESS);
+  TEST_CHECK(memcmp(out, ctr_cipher, sizeof(out)) == 0);
+  /* The counter is incremented with carry over the whole block */
+  TEST_CHECK_EQUAL(counter[15], 0x03);
+  TEST_CHECK_EQUAL(counter[14], 0xff);
+  TEST_CHECK_EQUAL(counter[13], 0xfd);
+  /* 4 blocks in one batch: the key is loaded once */
+  TEST_CHECK_EQUAL(stub_aes_runs, 4);
+  TEST_CHECK_EQUAL(stub_key_loads, 1);
+
+  for (split = 16; split < sizeof(out); split += 16)
+  {
+    memcpy(counter, ctr_counter, 16);
+    memcpy(out, ctr_cipher, sizeof(out));
+    AESMGR_CTR_Crypt(ctr_key, counter, out, out, split);
+    AESMGR_CTR_Crypt(ctr_key, counter, out + split, out + split, sizeof(out) - split);
+    TEST_CHECK(memcmp(out, ctr_plain, sizeof(out)) == 0);
+  }
+
+  /* Partial last block */
+  memcpy(counter, ctr_counter, 16);
+  AESMGR_CTR_Crypt(ctr_key, counter, ctr_plain, out, 37);
+  TEST_CHECK(memcmp(out, ctr_cipher, 37) == 0);
+}
+
+static void test_ccm(void)
+{
+  const ccm_vector_t *v;
+  uint8_t out[24], tag[16], plain[24];
+  uint32_t i;
+
+  for (i = 0; i < sizeof(ccm_vectors) / sizeof(ccm_vectors[0]); i++)
+  {
+    v = &ccm_vectors[i];
+    stub_reset();
+    memset(tag, 0, sizeof(tag));
+    TEST_CHECK_EQUAL(AESMGR_CCM_Encrypt(v->key, v->nonce, v->nonce_length, v->adata, v->adata_length,
+                                        v->plain, out, v->length, tag, v->tag_length), AESMGR_SUCCESS);
+    if (memcmp(out, v->cipher, v->length) != 0 || memcmp(tag, v->tag, v->tag_length) != 0)
+    {
+      printf("%s: wrong cipher text or tag\n", v->name);
+      test_failures++;
+    }
+
+    TEST_CHECK_EQUAL(AESMGR_CCM_Decrypt(v->key, v->nonce, v->nonce_length, v->adata, v->adata_length,
+                                        v->cipher, plain, v->length, v->tag, v->tag_length), AESMGR_SUCCESS);
+    TEST_CHECK(memcmp(plain, v->plain, v->length) == 0);
+  }
+}
+
+/* A message failing authentication gives no plain text */
+static void test_tag_failure(void)
+{
+  const ccm_vector_t *v = &ccm_vectors[0];
+  uint8_t cipher[24], tag[16], plain[24];
+  uint8_t zero[24] = { 0 };
+  uint32_t i;
+
+  for (i = 0; i < (uint32_t)(v->length + v->tag_length + v->adata_length); i++)
+  {
+    memcpy(cipher, v->cipher, v->length);
+    memcpy(tag, v->tag, v->tag_length);
+    memcpy(plain, v->plain, v->length);
+    if (i < v->length)
+      cipher[i] ^= 0x01;
+    else if (i < (uint32_t)(v->length + v->tag_length))
+      tag[i - v->length] ^= 0x80;
+
+    if (i < (uint32_t)(v->length + v->tag_length))
+    {
+      TEST_CHECK_EQUAL(AESMGR_CCM_Decrypt(v->key, v->nonce, v->nonce_length, v->adata, v->adata_length,
+                                          cipher, plain, v->length, tag, v->tag_length), AESMGR_ERROR);
+    }
+    else
+    {
+      uint8_t adata[20];
+
+      memcpy(adata, v->adata, v->adata_length);
+      adata[i - v->length - v->tag_length] ^= 0x10;
+      TEST_CHECK_EQUAL(AESMGR_CCM_Decrypt(v->key, v->nonce, v->nonce_length, adata, v->adata_length,
+                                          cipher, plain, v->length, tag, v->tag_length), AESMGR_ERROR);
+    }
+    TEST_CHECK(memcmp(plain, zero, v->length) == 0);
+  }
+
+  /* In place */
+  memcpy(plain, v->cipher, v->length);
+  memcpy(tag, v->tag, v->tag_length);
+  tag[0] ^= 1;
+  TEST_CHECK_EQUAL(AESMGR_CCM_Decrypt(v->key, v->nonce, v->nonce_length, v->adata, v->adata_length,
+                                      plain, plain, v->length, tag, v->tag_length), AESMGR_ERROR);
+  TEST_CHECK(memcmp(plain, zero, v->length) == 0);
+
+  /* Invalid parameters */
+  TEST_CHECK_EQUAL(AESMGR_CCM_Decrypt(v->key, v->nonce, 6, v->adata, v->adata_length,
+                                      v->cipher, plain, v->length, v->tag, v->tag_length), AESMGR_ERROR);
+  TEST_CHECK_EQUAL(AESMGR_CCM_Decrypt(v->key, v->nonce, v->nonce_length, v->adata, v->adata_length,
+                                      v->cipher, plain, v->length, v->tag, 5), AESMGR_ERROR);
+}
+
+/* Another user of the AES engine runs in the middle of each block of a batch:
+   the key is loaded again and the block is encrypted again */
+static void test_preemption(void)
+{
+  uint8_t counter[16], out[64];
+  uint32_t at;
+
+  for (at = 1; at <= 4; at++)
+  {
+    stub_reset();
+    preempt_count = 0;
+    stub_preempt_at = at;
+    stub_preempt = preempt_encrypt;
+
+    memcpy(counter, ctr_counter, 16);
+    memcpy(out, ctr_plain, sizeof(out));
+    TEST_CHECK_EQUAL(AESMGR_CTR_Crypt(ctr_key, counter, out, out, sizeof(out)), AESMGR_SUCCESS);
+    TEST_CHECK(memcmp(out, ctr_cipher, sizeof(out)) == 0);
+    TEST_CHECK_EQUAL(preempt_count, 1);
+    /* Batch key, interrupt key and batch key again */
+    TEST_CHECK_EQUAL(stub_key_loads, 3);
+    /* 4 blocks, the interrupted one twice, and the interrupt block */
+    TEST_CHECK_EQUAL(stub_aes_runs, 6);
+  }
+}
+
+static void test_throughput(void)
+{
+  uint8_t counter[16];
+  uint64_t start, elapsed;
+  uint32_t blocks = THROUGHPUT_SIZE / AESMGR_BLOCK_SIZE;
+
+  memset(big_buffer, 0x5A, sizeof(big_buffer));
+  memcpy(counter, ctr_counter, 16);
+  stub_reset();
+
+  start = now_ns();
+  TEST_CHECK_EQUAL(AESMGR_CTR_Crypt(ctr_key, counter, big_buffer, big_buffer, sizeof(big_buffer)), AESMGR_SUCCESS);
+  elapsed = now_ns() - start;
+
+  printf("CTR %u blocks in %llu us (%.1f MB/s with the software engine), %u key loads\n",
+         blocks, (unsigned long long)(elapsed / 1000), (double)sizeof(big_buffer) * 1000.0 / (double)elapsed,
+         stub_key_loads);
+
+  TEST_CHECK_EQUAL(stub_aes_runs, blocks);
+  /* One key load per batch */
+  TEST_CHECK_EQUAL(stub_key_loads, (blocks + BATCH_BLOCKS - 1) / BATCH_BLOCKS);
+  TEST_CHECK(elapsed > 0);
+}
+
+int main(void)
+{
+  test_reference();
+  test_ctr();
+  test_ccm();
+  test_tag_failure();
+  test_preemption();
+  test_throughput();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,77 @@
+/**
+  ******************************************************************************
+  * @file    ble_stack_stub.c
+  * @brief   GATT functions used by the BlueVoice library, recording the
+  *          notifications sent instead of sending them.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "ble_const.h"
+#include "bluenrg_lp_api.h"
+#include "ble_stack_stub.h"
+
+stub_notification_t stub_notifications[STUB_MAX_NOTIFICATIONS];
+uint32_t stub_notification_count;
+uint8_t stub_tx_pool_full;
+int32_t stub_tx_pool_credits = -1;
+
+static uint8_t char_count;
+
+void stub_reset(void)
+{
+  stub_notification_count = 0;
+  stub_tx_pool_full = 0;
+  stub_tx_pool_credits = -1;
+  char_count = 0;
+}
+
+tBleStatus aci_gatt_srv_add_service(ble_gatt_srv_def_t *Service_p)
+{
+  return BLE_STATUS_SUCCESS;
+}
+
+uint16_t aci_gatt_srv_get_service_handle(ble_gatt_srv_def_t *Serv_p)
+{
+  return 0x000C;
+}
+
+tBleStatus aci_gatt_srv_add_char(ble_gatt_chr_def_t *Char_p, uint16_t Service_Handle)
+{
+  char_count++;
+  return BLE_STATUS_SUCCESS;
+}
+
+uint16_t aci_gatt_srv_get_char_decl_handle(ble_gatt_chr_def_t *Char_p)
+{
+  return (char_count == 1) ? STUB_AUDIO_HANDLE : STUB_AUDIO_SYNC_HANDLE;
+}
+
+tBleStatus aci_gatt_clt_write(uint16_t Connection_Handle, uint16_t Attr_Handle,
+                              uint16_t Attribute_Val_Length, uint8_t Attribute_Val[])
+{
+  return BLE_STATUS_SUCCESS;
+}
+
+tBleStatus aci_gatt_srv_notify(uint16_t Connection_Handle, uint16_t Attr_Handle, uint8_t Flags,
+                               uint16_t Val_Length, uint8_t Val[])
+{
+  stub_notification_t *n;
+
+  if(stub_tx_pool_full || (stub_tx_pool_credits == 0) || (stub_notification_count == STUB_MAX_NOTIFICATIONS))
+  {
+    return BLE_STATUS_INSUFFICIENT_RESOURCES;
+  }
+  if(stub_tx_pool_credits > 0)
+  {
+    stub_tx_pool_credits--;
+  }
+
+  n = &stub_notifications[stub_notification_count++];
+  n->conn_handle = Connection_Handle;
+  n->attr_handle = Attr_Handle;
+  n->len = Val_Length;
+  memcpy(n->data, Val, Val_Length);
+
+  return BLE_STATUS_SUCCESS;
+}
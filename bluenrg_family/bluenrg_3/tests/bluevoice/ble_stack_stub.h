@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file    ble_stack_stub.h
+  * @brief   GATT functions used by the BlueVoice library, recording the
+  *          notifications sent instead of sending them.
+  ******************************************************************************
+  */
+
+#ifndef BLE_STACK_STUB_H
+#define BLE_STACK_STUB_H
+
+#include <stdint.h>
+
+#define STUB_AUDIO_HANDLE       (0x0010)
+#define STUB_AUDIO_SYNC_HANDLE  (0x0020)
+
+#define STUB_MAX_NOTIFICATIONS  (64)
+
+typedef struct
+{
+  uint16_t conn_handle;
+  uint16_t attr_handle;
+  uint16_t len;
+  uint8_t data[244];
+} stub_notification_t;
+
+extern stub_notification_t stub_notifications[STUB_MAX_NOTIFICATIONS];
+extern uint32_t stub_notification_count;
+
+/* aci_gatt_srv_notify() fails with BLE_STATUS_INSUFFICIENT_RESOURCES while set */
+extern uint8_t stub_tx_pool_full;
+
+/* Notifications accepted before the TX pool is full, negative for no limit */
+extern int32_t stub_tx_pool_credits;
+
+void stub_reset(void);
+
+#endif /* BLE_STACK_STUB_H */
@@ -0,0 +1,221 @@
+/**
+  ******************************************************************************
+  * @file    test_adpcm_bitrate.c
+  * @brief   BlueVoice 2, 3 and 4-bit codes: the notifications of a transmitter
+  *          link are decoded by a receiver link, across bitrate changes, and
+  *          the adaptive bitrate follows the TX pool congestion.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include "test_assert.h"
+#include "ble_stack_stub.h"
+#include "bluevoice_adpcm_3_x.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define TX_CONN         (0x0801)
+#define RX_CONN         (0x0802)
+#define FRAME_SAMPLES   (16 * FRAME_DURATION_MS)
+
+static BV_ADPCM_CodecHandleTypeDef ref_codec;
+
+static void start_loopback(void)
+{
+  BV_ADPCM_3_x_Config_t config = { FR_16000, 1, 1 };
+  BV_ADPCM_3_x_ProfileHandle_t tx;
+  uint8_t enable[2] = { 0x01, 0x00 };
+  uint16_t service;
+
+  stub_reset();
+  BluevoiceADPCM_3_x_Initialize();
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SetConfig(&config), BV_SUCCESS);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_AddService(&service), BV_SUCCESS);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_AddChar(service, &tx), BV_SUCCESS);
+
+  BluevoiceADPCM_3_x_ConnectionComplete_CB(TX_CONN);
+  BluevoiceADPCM_3_x_LinkAttributeModified_CB(TX_CONN, STUB_AUDIO_HANDLE + 2, 2, enable);
+  BluevoiceADPCM_3_x_LinkAttributeModified_CB(TX_CONN, STUB_AUDIO_SYNC_HANDLE + 2, 2, enable);
+
+  /* The receiver link uses the handles of the local server */
+  BluevoiceADPCM_3_x_ConnectionComplete_CB(RX_CONN);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SetLinkRxHandle(RX_CONN, &tx), BV_SUCCESS);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_EnableLinkAudioNotification(RX_CONN), BV_SUCCESS);
+
+  ref_codec.index = 0;
+  ref_codec.predsample = 0;
+}
+
+static void fill_frame(int16_t *pcm, uint32_t frame)
+{
+  for (uint32_t i = 0; i < FRAME_SAMPLES; i++)
+  {
+    uint32_t t = frame * FRAME_SAMPLES + i;
+
+    pcm[i] = (int16_t)((int32_t)(t * 397 % 3000) - 1500 + (int32_t)((t / 40) % 2) * 4000);
+  }
+}
+
+/* Decodes the recorded notifications on the receiver link, the reference encoder
+   state is taken from the side information */
+static uint32_t deliver(int16_t *out)
+{
+  uint32_t n = 0;
+
+  for (uint32_t i = 0; i < stub_notification_count; i++)
+  {
+    stub_notification_t *notif = &stub_notifications[i];
+    uint8_t samples;
+
+    TEST_CHECK_EQUAL(notif->conn_handle, TX_CONN);
+    TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_ParseLinkData(RX_CONN, notif->data, notif->len, notif->attr_handle,
+                                                      (uint8_t *)&out[n], &samples), BV_SUCCESS);
+    n += samples;
+
+    if (notif->attr_handle == STUB_AUDIO_SYNC_HANDLE + 1)
+    {
+      ref_codec.index = notif->data[0];
+      ref_codec.predsample = (int32_t)(notif->data[2] | (notif->data[3] << 8) | (notif->data[4] << 16) | ((uint32_t)notif->data[5] << 24));
+    }
+  }
+  stub_notification_count = 0;
+
+  return n;
+}
+
+/* Encodes a frame on the transmitter link and decodes its notifications on the receiver
+   link. The decoded samples must be the predicted samples of the encoder, bit exact. */
+static void loopback_frame(uint32_t frame, uint32_t *abs_error)
+{
+  int16_t pcm[FRAME_SAMPLES];
+  int16_t expected[FRAME_SAMPLES];
+  int16_t out[BV_ADPCM_3_x_RX_SAMPLES(ADPCM_OUT_BUFF_SIZE)];
+  uint32_t n;
+
+  /* The frame is encoded with the bitrate in use at its start */
+  ref_codec.bits = BluevoiceADPCM_3_x_GetLinkBitrate(TX_CONN);
+  fill_frame(pcm, frame);
+  for (uint32_t i = 0; i < FRAME_SAMPLES; i++)
+  {
+    BluevoiceADPCM_3_x_Encode(&ref_codec, pcm[i]);
+    expected[i] = (int16_t)ref_codec.predsample;
+  }
+
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_AudioIn((uint16_t *)pcm, FRAME_SAMPLES), BV_OUT_BUF_READY);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SendData(), BV_SUCCESS);
+
+  n = deliver(out);
+  TEST_CHECK_EQUAL(n, FRAME_SAMPLES);
+
+  for (uint32_t i = 0; (i < n) && (i < FRAME_SAMPLES); i++)
+  {
+    TEST_CHECK_EQUAL(out[i], expected[i]);
+    *abs_error += (uint32_t)abs(out[i] - pcm[i]);
+  }
+}
+
+/* Fixed bitrates, changed during the stream */
+static void test_round_trip(void)
+{
+  static const BV_Bitrate_t bitrate[3] = { BV_BITRATE_4_BIT, BV_BITRATE_3_BIT, BV_BITRATE_2_BIT };
+  static const uint8_t bits[3] = { 4, 3, 2 };
+  uint32_t abs_error[3] = { 0 };
+  uint32_t frame = 0;
+
+  start_loopback();
+
+  for (uint32_t b = 0; b < 3; b++)
+  {
+    TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SetBitrate(bitrate[b]), BV_SUCCESS);
+
+    /* The new bitrate is sent in the side information of the next frame */
+    loopback_frame(frame++, &abs_error[b]);
+    TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_GetLinkBitrate(TX_CONN), bits[b]);
+    abs_error[b] = 0;
+
+    for (uint32_t i = 0; i < 2 * SIDE_INF_FRAME_INTERVAL; i++)
+    {
+      loopback_frame(frame++, &abs_error[b]);
+    }
+  }
+
+  /* Fewer bits, larger quantization error */
+  TEST_CHECK(abs_error[0] < abs_error[1]);
+  TEST_CHECK(abs_error[1] < abs_error[2]);
+}
+
+/* A frame that cannot be sent for a connection interval, then the next frame overruns it */
+static void congested_frames(uint32_t frame)
+{
+  int16_t pcm[FRAME_SAMPLES];
+  int16_t out[BV_ADPCM_3_x_RX_SAMPLES(ADPCM_OUT_BUFF_SIZE)];
+
+  fill_frame(pcm, frame);
+  stub_tx_pool_full = 1;
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_AudioIn((uint16_t *)pcm, FRAME_SAMPLES), BV_OUT_BUF_READY);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SendData(), BV_INSUFFICIENT_RESOURCES);
+  for (uint32_t t = 0; t < FRAME_DURATION_MS; t++)
+  {
+    BluevoiceADPCM_3_x_IncTick();
+  }
+
+  fill_frame(pcm, frame + 1);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_AudioIn((uint16_t *)pcm, FRAME_SAMPLES), BV_OUT_BUF_READY);
+  stub_tx_pool_full = 0;
+  BluevoiceADPCM_3_x_TxPoolAvailable_CB(TX_CONN);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SendData(), BV_SUCCESS);
+
+  /* The receiver resynchronizes on the side information sent with the late frame */
+  TEST_CHECK_EQUAL(stub_notifications[stub_notification_count - 1].attr_handle, STUB_AUDIO_SYNC_HANDLE + 1);
+  deliver(out);
+}
+
+/* The TX pool full for more than a connection interval lowers the bitrate, frames sent
+   without congestion for BV_ADPCM_3_x_BITRATE_UP_TIME raise it again */
+static void test_adaptive_bitrate(void)
+{
+  uint32_t abs_error = 0;
+  uint32_t frame = 0;
+
+  start_loopback();
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SetBitrate(BV_BITRATE_ADAPTIVE), BV_SUCCESS);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SetLinkConnInterval(TX_CONN, 8), BV_SUCCESS);
+  loopback_frame(frame++, &abs_error);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_GetLinkBitrate(TX_CONN), 4);
+
+  congested_frames(frame);
+  frame += 2;
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_GetLinkBitrate(TX_CONN), 3);
+  congested_frames(frame);
+  frame += 2;
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_GetLinkBitrate(TX_CONN), 2);
+
+  /* Never below 2 bits */
+  congested_frames(frame);
+  frame += 2;
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_GetLinkBitrate(TX_CONN), 2);
+
+  for (uint8_t bits = 3; bits <= 4; bits++)
+  {
+    uint32_t clean = 0;
+
+    while ((BluevoiceADPCM_3_x_GetLinkBitrate(TX_CONN) < bits) && (clean <= BITRATE_UP_FRAMES))
+    {
+      loopback_frame(frame++, &abs_error);
+      clean++;
+    }
+    TEST_CHECK_EQUAL(clean, BITRATE_UP_FRAMES);
+    TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_GetLinkBitrate(TX_CONN), bits);
+  }
+
+  /* The stream is decoded bit exact after the bitrate increases */
+  loopback_frame(frame++, &abs_error);
+}
+
+int main(void)
+{
+  test_round_trip();
+  test_adaptive_bitrate();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,275 @@
+/**
+  ******************************************************************************
+  * @file    test_adpcm_encode.c
+  * @brief   Bit exactness of the BlueVoice 4-bit encoders against the IMA ADPCM
+  *          reference encoder of the previous library versions, and output
+  *          contract of BluevoiceADPCM_3_x_ParseData().
+  ******************************************************************************
+  */
+
+#include "test_assert.h"
+#include "ble_stack_stub.h"
+#include "bluevoice_adpcm_3_x.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define CONN_HANDLE     (0x0801)
+#define FRAME_SAMPLES   (16 * FRAME_DURATION_MS)
+
+/* Per sample 4-bit IMA ADPCM encoder, as in the library before the block encoder */
+static uint8_t ref_encode(BV_ADPCM_CodecHandleTypeDef *codec, int32_t sample)
+{
+  uint16_t step = StepSizeTable[codec->index];
+  uint16_t tmpstep = step;
+  int32_t diff = sample - codec->predsample;
+  int32_t diffq = step >> 3;
+  uint8_t code = 0;
+
+  if (diff < 0)
+  {
+    code = 8;
+    diff = -diff;
+  }
+  if (diff >= tmpstep)
+  {
+    code |= 0x04;
+    diff -= tmpstep;
+    diffq += step;
+  }
+  tmpstep >>= 1;
+  if (diff >= tmpstep)
+  {
+    code |= 0x02;
+    diff -= tmpstep;
+    diffq += (step >> 1);
+  }
+  tmpstep >>= 1;
+  if (diff >= tmpstep)
+  {
+    code |= 0x01;
+    diffq += (step >> 2);
+  }
+
+  if (code & 8)
+    codec->predsample -= diffq;
+  else
+    codec->predsample += diffq;
+  if (codec->predsample > 32767)
+    codec->predsample = 32767;
+  else if (codec->predsample < -32768)
+    codec->predsample = -32768;
+
+  codec->index += IndexTable[code];
+  if (codec->index < 0)
+    codec->index = 0;
+  if (codec->index > 88)
+    codec->index = 88;
+
+  return code;
+}
+
+/* Packs the reference codes two per byte, first sample in the low nibble */
+static void ref_encode_bytes(BV_ADPCM_CodecHandleTypeDef *codec, const int16_t *pcm, uint32_t stride,
+                             uint8_t *adpcm, uint32_t Nbytes)
+{
+  for (uint32_t i = 0; i < Nbytes; i++)
+  {
+    uint8_t lo = ref_encode(codec, pcm[(2 * i) * stride]);
+    uint8_t hi = ref_encode(codec, pcm[(2 * i + 1) * stride]);
+    adpcm[i] = lo | (uint8_t)(hi << 4);
+  }
+}
+
+static uint32_t lcg_state = 12345;
+
+static int16_t lcg_sample(void)
+{
+  lcg_state = lcg_state * 1664525 + 1013904223;
+  return (int16_t)(lcg_state >> 16);
+}
+
+/* Speech like signal mixed with noise, full scale steps and silence */
+static void fill_signal(int16_t *pcm, uint32_t n, uint32_t kind)
+{
+  for (uint32_t i = 0; i < n; i++)
+  {
+    switch (kind)
+    {
+    case 0:
+      pcm[i] = lcg_sample();
+      break;
+    case 1:
+      pcm[i] = ((i / 7) & 1) ? 32767 : -32768;
+      break;
+    case 2:
+      pcm[i] = (int16_t)((int32_t)(i * 613 % 4000) - 2000 + (lcg_sample() >> 6));
+      break;
+    default:
+      pcm[i] = 0;
+      break;
+    }
+  }
+}
+
+static void test_block_encoder(void)
+{
+  static const int32_t start_pred[] = { -32768, -1000, 0, 2047, 32767 };
+  int16_t pcm[2 * 256];
+  uint8_t out[128];
+  uint8_t ref[128];
+
+  for (uint32_t kind = 0; kind < 4; kind++)
+  {
+    for (int16_t index = 0; index <= 88; index++)
+    {
+      for (uint32_t p = 0; p < sizeof(start_pred) / sizeof(start_pred[0]); p++)
+      {
+        for (uint32_t stride = 1; stride <= 2; stride++)
+        {
+          BV_ADPCM_CodecHandleTypeDef codec = { index, start_pred[p], 4 };
+          BV_ADPCM_CodecHandleTypeDef ref_codec = codec;
+
+          fill_signal(pcm, 2 * 256, kind);
+          BluevoiceADPCM_3_x_EncodeBlock(&codec, pcm, stride, out, sizeof(out));
+          ref_encode_bytes(&ref_codec, pcm, stride, ref, sizeof(ref));
+
+          TEST_CHECK(memcmp(out, ref, sizeof(out)) == 0);
+          TEST_CHECK_EQUAL(codec.index, ref_codec.index);
+          TEST_CHECK_EQUAL(codec.predsample, ref_codec.predsample);
+        }
+      }
+    }
+  }
+}
+
+static void test_sample_encoder(void)
+{
+  int16_t pcm[1024];
+  BV_ADPCM_CodecHandleTypeDef codec = { 0, 0, 4 };
+  BV_ADPCM_CodecHandleTypeDef ref_codec = codec;
+
+  for (uint32_t kind = 0; kind < 4; kind++)
+  {
+    fill_signal(pcm, 1024, kind);
+    for (uint32_t i = 0; i < 1024; i++)
+    {
+      TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_Encode(&codec, pcm[i]), ref_encode(&ref_codec, pcm[i]));
+      TEST_CHECK_EQUAL(codec.index, ref_codec.index);
+      TEST_CHECK_EQUAL(codec.predsample, ref_codec.predsample);
+    }
+  }
+}
+
+static void start_link(void)
+{
+  BV_ADPCM_3_x_Config_t config = { FR_16000, 1, 1 };
+  BV_ADPCM_3_x_ProfileHandle_t tx;
+  uint16_t service;
+
+  stub_reset();
+  BluevoiceADPCM_3_x_Initialize();
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SetConfig(&config), BV_SUCCESS);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_AddService(&service), BV_SUCCESS);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_AddChar(service, &tx), BV_SUCCESS);
+  BluevoiceADPCM_3_x_ConnectionComplete_CB(CONN_HANDLE);
+}
+
+/* A frame given in odd sized chunks goes through both the block and the per sample paths */
+static void test_audio_in_frame(void)
+{
+  uint8_t enable[2] = { 0x01, 0x00 };
+  int16_t pcm[FRAME_SAMPLES];
+  uint8_t ref[FRAME_SAMPLES / 2];
+  BV_ADPCM_CodecHandleTypeDef ref_codec = { 0, 0, 4 };
+  BV_3_x_Status status = BV_OUT_BUF_NOT_READY;
+  uint32_t done = 0;
+  uint32_t sent = 0;
+
+  start_link();
+  BluevoiceADPCM_3_x_LinkAttributeModified_CB(CONN_HANDLE, STUB_AUDIO_HANDLE + 2, 2, enable);
+  BluevoiceADPCM_3_x_LinkAttributeModified_CB(CONN_HANDLE, STUB_AUDIO_SYNC_HANDLE + 2, 2, enable);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_GetLinkMode(CONN_HANDLE), TRANSMITTER);
+
+  fill_signal(pcm, FRAME_SAMPLES, 2);
+  ref_encode_bytes(&ref_codec, pcm, 1, ref, sizeof(ref));
+
+  while (done < FRAME_SAMPLES)
+  {
+    uint32_t n = MIN(7U, FRAME_SAMPLES - done);
+
+    status = BluevoiceADPCM_3_x_AudioIn((uint16_t *)&pcm[done], (uint8_t)n);
+    done += n;
+  }
+  TEST_CHECK_EQUAL(status, BV_OUT_BUF_READY);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SendData(), BV_SUCCESS);
+
+  /* Audio notifications, then the side information of the first frame */
+  TEST_CHECK(stub_notification_count >= 2);
+  for (uint32_t i = 0; i + 1 < stub_notification_count; i++)
+  {
+    TEST_CHECK_EQUAL(stub_notifications[i].attr_handle, STUB_AUDIO_HANDLE + 1);
+    TEST_CHECK(memcmp(stub_notifications[i].data, &ref[sent], stub_notifications[i].len) == 0);
+    sent += stub_notifications[i].len;
+  }
+  TEST_CHECK_EQUAL(sent, sizeof(ref));
+
+  stub_notification_t *sync = &stub_notifications[stub_notification_count - 1];
+  TEST_CHECK_EQUAL(sync->attr_handle, STUB_AUDIO_SYNC_HANDLE + 1);
+  TEST_CHECK_EQUAL(sync->len, SIDE_INF_SIZE_u8);
+  TEST_CHECK_EQUAL(sync->data[0], ref_codec.index);
+  TEST_CHECK_EQUAL(sync->data[1], 0);
+  TEST_CHECK_EQUAL((int16_t)(sync->data[2] | (sync->data[3] << 8)), ref_codec.predsample);
+}
+
+static void test_parse_data_samples(void)
+{
+  BV_ADPCM_3_x_ProfileHandle_t rx = { 0x0030, 0x0040, 0x0050 };
+  uint8_t sync_2bit[SIDE_INF_SIZE_u8] = { 0, 2, 0, 0, 0, 0 };
+  uint8_t sync_3bit[SIDE_INF_SIZE_u8] = { 0, 3, 0, 0, 0, 0 };
+  uint8_t in[128];
+  int16_t out[BV_ADPCM_3_x_RX_SAMPLES(sizeof(in))];
+  uint8_t samples;
+
+  start_link();
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SetLinkRxHandle(CONN_HANDLE, &rx), BV_SUCCESS);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_EnableLinkAudioNotification(CONN_HANDLE), BV_SUCCESS);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_GetLinkMode(CONN_HANDLE), RECEIVER);
+
+  for (uint32_t i = 0; i < sizeof(in); i++)
+  {
+    in[i] = (uint8_t)lcg_sample();
+  }
+
+  /* 4-bit codes: two samples per byte */
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_ParseLinkData(CONN_HANDLE, in, 20, rx.CharAudioHandle + 1, (uint8_t *)out, &samples), BV_SUCCESS);
+  TEST_CHECK_EQUAL(samples, 40);
+
+  /* 2-bit codes: four samples per byte, up to 255 samples per call */
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_ParseLinkData(CONN_HANDLE, sync_2bit, SIDE_INF_SIZE_u8, rx.CharAudioSyncHandle + 1, NULL, &samples), BV_SUCCESS);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_ParseLinkData(CONN_HANDLE, in, 63, rx.CharAudioHandle + 1, (uint8_t *)out, &samples), BV_SUCCESS);
+  TEST_CHECK_EQUAL(samples, 252);
+
+  /* 256 samples do not fit in the returned count: nothing is decoded */
+  memset(out, 0x5A, sizeof(out));
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_ParseLinkData(CONN_HANDLE, in, 64, rx.CharAudioHandle + 1, (uint8_t *)out, &samples), BV_PCM_SAMPLES_ERR);
+  TEST_CHECK_EQUAL(samples, 0);
+  TEST_CHECK_EQUAL((uint16_t)out[0], 0x5A5A);
+
+  /* 3-bit codes: the bits left from the previous packet are counted */
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_ParseLinkData(CONN_HANDLE, sync_3bit, SIDE_INF_SIZE_u8, rx.CharAudioSyncHandle + 1, NULL, &samples), BV_SUCCESS);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_ParseLinkData(CONN_HANDLE, in, 1, rx.CharAudioHandle + 1, (uint8_t *)out, &samples), BV_SUCCESS);
+  TEST_CHECK_EQUAL(samples, 2);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_ParseLinkData(CONN_HANDLE, in, 96, rx.CharAudioHandle + 1, (uint8_t *)out, &samples), BV_PCM_SAMPLES_ERR);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_ParseLinkData(CONN_HANDLE, in, 95, rx.CharAudioHandle + 1, (uint8_t *)out, &samples), BV_SUCCESS);
+  TEST_CHECK_EQUAL(samples, 254);
+}
+
+int main(void)
+{
+  test_block_encoder();
+  test_sample_encoder();
+  test_audio_in_frame();
+  test_parse_data_samples();
+
+  return TEST_RESULT();
+}
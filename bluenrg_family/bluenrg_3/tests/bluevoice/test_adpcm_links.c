@@ -0,0 +1,188 @@
+/**
+  ******************************************************************************
+  * @file    test_adpcm_links.c
+  * @brief   BlueVoice with several connections: each link has its own codec
+  *          state and buffers, and SendData() serves the links in turn.
+  ******************************************************************************
+  */
+
+#include "test_assert.h"
+#include "ble_stack_stub.h"
+#include "bluevoice_adpcm_3_x.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define FRAME_SAMPLES   (16 * FRAME_DURATION_MS)
+#define FRAME_BYTES     (FRAME_SAMPLES / 2)
+
+static const uint16_t conn[BV_ADPCM_3_x_MAX_LINKS] = { 0x0801, 0x0802, 0x0803 };
+
+static void start_profile(void)
+{
+  BV_ADPCM_3_x_Config_t config = { FR_16000, 1, 1 };
+  BV_ADPCM_3_x_ProfileHandle_t tx;
+  uint16_t service;
+
+  stub_reset();
+  BluevoiceADPCM_3_x_Initialize();
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SetConfig(&config), BV_SUCCESS);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_AddService(&service), BV_SUCCESS);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_AddChar(service, &tx), BV_SUCCESS);
+}
+
+static void connect_transmitter(uint16_t handle)
+{
+  uint8_t enable[2] = { 0x01, 0x00 };
+
+  BluevoiceADPCM_3_x_ConnectionComplete_CB(handle);
+  BluevoiceADPCM_3_x_LinkAttributeModified_CB(handle, STUB_AUDIO_HANDLE + 2, 2, enable);
+  BluevoiceADPCM_3_x_LinkAttributeModified_CB(handle, STUB_AUDIO_SYNC_HANDLE + 2, 2, enable);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_GetLinkMode(handle), TRANSMITTER);
+}
+
+static void fill_frame(int16_t *pcm, uint32_t seed)
+{
+  for (uint32_t i = 0; i < FRAME_SAMPLES; i++)
+  {
+    pcm[i] = (int16_t)(((i + seed) * 911 % 6000) - 3000);
+  }
+}
+
+/* Audio bytes notified to a connection, from the first recorded notification */
+static uint32_t notified_audio(uint16_t handle, uint8_t *audio, uint32_t max)
+{
+  uint32_t len = 0;
+
+  for (uint32_t i = 0; i < stub_notification_count; i++)
+  {
+    stub_notification_t *n = &stub_notifications[i];
+
+    if ((n->conn_handle == handle) && (n->attr_handle == STUB_AUDIO_HANDLE + 1) && (len + n->len <= max))
+    {
+      memcpy(&audio[len], n->data, n->len);
+      len += n->len;
+    }
+  }
+  return len;
+}
+
+/* A link connected while the others are streaming starts from a reset encoder */
+static void test_link_codec_state(void)
+{
+  int16_t pcm[2][FRAME_SAMPLES];
+  uint8_t ref[2][FRAME_BYTES];
+  uint8_t audio[2 * FRAME_BYTES];
+  BV_ADPCM_CodecHandleTypeDef codec = { 0, 0, 4 };
+  BV_ADPCM_CodecHandleTypeDef late = { 0, 0, 4 };
+
+  fill_frame(pcm[0], 0);
+  fill_frame(pcm[1], 37);
+  BluevoiceADPCM_3_x_EncodeBlock(&codec, pcm[0], 1, ref[0], FRAME_BYTES);
+  BluevoiceADPCM_3_x_EncodeBlock(&codec, pcm[1], 1, ref[1], FRAME_BYTES);
+
+  start_profile();
+  connect_transmitter(conn[0]);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_AudioIn((uint16_t *)pcm[0], FRAME_SAMPLES), BV_OUT_BUF_READY);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SendData(), BV_SUCCESS);
+
+  connect_transmitter(conn[1]);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_AudioIn((uint16_t *)pcm[1], FRAME_SAMPLES), BV_OUT_BUF_READY);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SendData(), BV_SUCCESS);
+
+  /* The first link goes on with its encoder state */
+  TEST_CHECK_EQUAL(notified_audio(conn[0], audio, sizeof(audio)), 2 * FRAME_BYTES);
+  TEST_CHECK(memcmp(audio, ref, 2 * FRAME_BYTES) == 0);
+
+  /* The second one only has the second frame, encoded from the reset state */
+  BluevoiceADPCM_3_x_EncodeBlock(&late, pcm[1], 1, ref[0], FRAME_BYTES);
+  TEST_CHECK_EQUAL(notified_audio(conn[1], audio, sizeof(audio)), FRAME_BYTES);
+  TEST_CHECK(memcmp(audio, ref[0], FRAME_BYTES) == 0);
+}
+
+/* With a TX pool that holds one frame per connection event, the links are served
+   one after the other even if new frames keep arriving */
+static void test_send_data_round_robin(void)
+{
+  int16_t pcm[FRAME_SAMPLES];
+
+  start_profile();
+  for (uint32_t i = 0; i < BV_ADPCM_3_x_MAX_LINKS; i++)
+  {
+    connect_transmitter(conn[i]);
+  }
+  fill_frame(pcm, 0);
+
+  for (uint32_t i = 0; i < 2 * BV_ADPCM_3_x_MAX_LINKS; i++)
+  {
+    stub_notification_count = 0;
+    TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_AudioIn((uint16_t *)pcm, FRAME_SAMPLES), BV_OUT_BUF_READY);
+
+    /* Audio and side information notifications of one frame */
+    stub_tx_pool_credits = (int32_t)(FRAME_BYTES + 19) / 20 + 1;
+    TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SendData(), BV_INSUFFICIENT_RESOURCES);
+
+    /* The link that could not be served at the previous call goes first */
+    TEST_CHECK(stub_notification_count > 0);
+    TEST_CHECK_EQUAL(stub_notifications[0].conn_handle, conn[i % BV_ADPCM_3_x_MAX_LINKS]);
+  }
+}
+
+/* The side information received on a link only changes the decoder of that link */
+static void test_link_decoder_state(void)
+{
+  BV_ADPCM_3_x_ProfileHandle_t rx = { 0x0030, 0x0040, 0x0050 };
+  uint8_t sync_2bit[SIDE_INF_SIZE_u8] = { 0, 2, 0, 0, 0, 0 };
+  uint8_t in[10] = { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0, 0x0F, 0xED };
+  int16_t out[BV_ADPCM_3_x_RX_SAMPLES(sizeof(in))];
+  uint8_t samples;
+
+  start_profile();
+  for (uint32_t i = 0; i < 2; i++)
+  {
+    BluevoiceADPCM_3_x_ConnectionComplete_CB(conn[i]);
+    TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_SetLinkRxHandle(conn[i], &rx), BV_SUCCESS);
+    TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_EnableLinkAudioNotification(conn[i]), BV_SUCCESS);
+  }
+
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_ParseLinkData(conn[1], sync_2bit, SIDE_INF_SIZE_u8, rx.CharAudioSyncHandle + 1, NULL, &samples), BV_SUCCESS);
+
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_ParseLinkData(conn[0], in, sizeof(in), rx.CharAudioHandle + 1, (uint8_t *)out, &samples), BV_SUCCESS);
+  TEST_CHECK_EQUAL(samples, 2 * sizeof(in));
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_ParseLinkData(conn[1], in, sizeof(in), rx.CharAudioHandle + 1, (uint8_t *)out, &samples), BV_SUCCESS);
+  TEST_CHECK_EQUAL(samples, 4 * sizeof(in));
+}
+
+/* A disconnected link is given to the next connection, no link is shared */
+static void test_link_allocation(void)
+{
+  uint8_t in[4] = { 0 };
+  int16_t out[BV_ADPCM_3_x_RX_SAMPLES(sizeof(in))];
+  uint8_t samples;
+
+  start_profile();
+  for (uint32_t i = 0; i < BV_ADPCM_3_x_MAX_LINKS; i++)
+  {
+    connect_transmitter(conn[i]);
+  }
+
+  BluevoiceADPCM_3_x_ConnectionComplete_CB(0x0804);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_ParseLinkData(0x0804, in, sizeof(in), 0, (uint8_t *)out, &samples), BV_LINK_NOT_AVAILABLE);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_GetLinkStatus(0x0804), BLUEVOICE_STATUS_UNITIALIZED);
+
+  BluevoiceADPCM_3_x_LinkDisconnectionComplete_CB(conn[1]);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_GetLinkMode(conn[1]), NOT_READY);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_GetLinkMode(conn[0]), TRANSMITTER);
+  TEST_CHECK_EQUAL(BluevoiceADPCM_3_x_GetLinkMode(conn[2]), TRANSMITTER);
+
+  connect_transmitter(0x0804);
+}
+
+int main(void)
+{
+  test_link_codec_state();
+  test_send_data_round_robin();
+  test_link_decoder_state();
+  test_link_allocation();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,100 @@
+/**
+  ******************************************************************************
+  * @file    test_adpcm_throughput.c
+  * @brief   Throughput of the BlueVoice 4-bit block encoder against the per
+  *          sample encoder it replaces, on mono and interleaved stereo input.
+  *          The outputs of both encoders must be identical.
+  ******************************************************************************
+  */
+
+#include <time.h>
+#include "test_assert.h"
+#include "ble_stack_stub.h"
+#include "bluevoice_adpcm_3_x.c"
+
+TEST_MAIN_DEFINITIONS;
+
+/* 16 kHz audio: 10 s of samples per run */
+#define BENCH_SAMPLES   (160000)
+#define BENCH_RUNS      (10)
+/* Samples given to the encoder at once, as in a 10 ms frame */
+#define BENCH_CHUNK     (160)
+
+static int16_t pcm[2 * BENCH_SAMPLES];
+static uint8_t out_block[BENCH_SAMPLES / 2];
+static uint8_t out_sample[BENCH_SAMPLES / 2];
+
+static double now_s(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Per sample path: one call and a bit accumulator per sample */
+static void encode_per_sample(BV_ADPCM_CodecHandleTypeDef *codec, const int16_t *in, uint32_t stride,
+                              uint8_t *adpcm, uint32_t Nsamples)
+{
+  uint32_t acc = 0;
+  uint32_t cnt = 0;
+
+  for (uint32_t i = 0; i < Nsamples; i++)
+  {
+    acc |= (uint32_t)BluevoiceADPCM_3_x_Encode(codec, in[i * stride]) << cnt;
+    cnt += 4;
+    if (cnt >= 8)
+    {
+      *adpcm++ = (uint8_t)acc;
+      acc >>= 8;
+      cnt -= 8;
+    }
+  }
+}
+
+static double bench(uint32_t block, uint32_t stride, uint8_t *out)
+{
+  double start = now_s();
+
+  for (uint32_t run = 0; run < BENCH_RUNS; run++)
+  {
+    BV_ADPCM_CodecHandleTypeDef codec = { 0, 0, 4 };
+
+    for (uint32_t done = 0; done < BENCH_SAMPLES; done += BENCH_CHUNK)
+    {
+      if (block)
+      {
+        BluevoiceADPCM_3_x_EncodeBlock(&codec, &pcm[done * stride], stride, &out[done / 2], BENCH_CHUNK / 2);
+      }
+      else
+      {
+        encode_per_sample(&codec, &pcm[done * stride], stride, &out[done / 2], BENCH_CHUNK);
+      }
+    }
+  }
+  return (double)BENCH_SAMPLES * BENCH_RUNS / (now_s() - start);
+}
+
+int main(void)
+{
+  uint32_t state = 1;
+
+  /* Tone with noise */
+  for (uint32_t i = 0; i < 2 * BENCH_SAMPLES; i++)
+  {
+    state = state * 1664525 + 1013904223;
+    pcm[i] = (int16_t)((int32_t)(i * 613 % 8000) - 4000 + ((int16_t)(state >> 16) >> 4));
+  }
+
+  for (uint32_t stride = 1; stride <= 2; stride++)
+  {
+    double per_sample = bench(0, stride, out_sample);
+    double block = bench(1, stride, out_block);
+
+    TEST_CHECK(memcmp(out_block, out_sample, sizeof(out_block)) == 0);
+    printf("%s: per sample %6.1f Msamples/s, block %6.1f Msamples/s, x%.2f\n",
+           (stride == 1) ? "mono  " : "stereo", per_sample / 1e6, block / 1e6, block / per_sample);
+  }
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,255 @@
+/**
+  ******************************************************************************
+  * @file    bsp_host_stub.c
+  * @brief   Simulated LSM6DSOX on the BSP SPI: register map, FIFO in stream
+  *          mode with watermark on INT1 and overrun, and asynchronous reads
+  *          completed when the test runs the DMA interrupt.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "bluenrg_lpx.h"
+#include "bluenrg_lp_evb_config.h"
+#include "bluenrg_lp_evb_motion.h"
+#include "bsp_host_stub.h"
+
+#define FIFO_WORD_SIZE          (7)
+
+uint8_t stub_regs[256];
+uint32_t stub_spi_reads;
+uint16_t stub_spi_words;
+
+/* Embedded functions and sensor hub banks */
+static uint8_t stub_bank_regs[256];
+static uint8_t stub_fifo[STUB_FIFO_WORDS][FIFO_WORD_SIZE];
+static uint16_t stub_fifo_head;
+static uint16_t stub_fifo_count;
+static uint8_t stub_overrun;
+static uint8_t stub_int1_level;
+static void (*stub_spi_callback)(int32_t status);
+static uint8_t stub_spi_ongoing;
+
+static void *stub_map(uint32_t base)
+{
+  void *page = mmap((void *)(uintptr_t)base, 0x1000, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (page == MAP_FAILED)
+  {
+    abort();
+  }
+  return page;
+}
+
+/* INT1 follows the FIFO threshold; its rising edge is latched by the EXTI if enabled */
+static void stub_update_int1(void)
+{
+  uint16_t watermark = stub_regs[LSM6DSOX_FIFO_CTRL1] | ((uint16_t)(stub_regs[LSM6DSOX_FIFO_CTRL2] & 0x01) << 8);
+  uint8_t level = (stub_regs[LSM6DSOX_INT1_CTRL] & 0x08) && (watermark != 0) && (stub_fifo_count >= watermark);
+
+  if (level && !stub_int1_level && (SYSCFG->IO_IER & BSP_SENSOR1_INT_EXTI_LINE))
+  {
+    SYSCFG->IO_ISCR |= BSP_SENSOR1_INT_EXTI_LINE;
+  }
+  stub_int1_level = level;
+  /* IDR is read-only for the driver */
+  if (level)
+  {
+    *(volatile uint32_t *)&BSP_SENSOR1_INT_GPIO_PORT->IDR |= BSP_SENSOR1_INT_PIN;
+  }
+  else
+  {
+    *(volatile uint32_t *)&BSP_SENSOR1_INT_GPIO_PORT->IDR &= ~BSP_SENSOR1_INT_PIN;
+  }
+}
+
+static void stub_fifo_pop(uint8_t *word)
+{
+  if (stub_fifo_count == 0)
+  {
+    memset(word, 0, FIFO_WORD_SIZE);
+    return;
+  }
+  memcpy(word, stub_fifo[stub_fifo_head], FIFO_WORD_SIZE);
+  stub_fifo_head = (stub_fifo_head + 1) % STUB_FIFO_WORDS;
+  stub_fifo_count--;
+}
+
+static uint8_t *stub_reg(uint8_t reg)
+{
+  if ((reg != LSM6DSOX_FUNC_CFG_ACCESS) && ((stub_regs[LSM6DSOX_FUNC_CFG_ACCESS] & 0xC0) != 0))
+  {
+    return &stub_bank_regs[reg];
+  }
+  return &stub_regs[reg];
+}
+
+void stub_reset(void)
+{
+  static void *gpio, *syscfg;
+
+  if (gpio == NULL)
+  {
+    gpio = stub_map(GPIOB_BASE);
+    syscfg = stub_map(SYSCFG_BASE);
+  }
+  memset(gpio, 0, 0x1000);
+  memset(syscfg, 0, 0x1000);
+  memset(stub_regs, 0, sizeof(stub_regs));
+  memset(stub_bank_regs, 0, sizeof(stub_bank_regs));
+  stub_regs[LSM6DSOX_WHO_AM_I] = LSM6DSOX_ID;
+  stub_fifo_head = 0;
+  stub_fifo_count = 0;
+  stub_overrun = 0;
+  stub_int1_level = 0;
+  stub_spi_callback = NULL;
+  stub_spi_ongoing = 0;
+  stub_spi_reads = 0;
+  stub_spi_words = 0;
+}
+
+void stub_fifo_push(uint8_t tag, const int16_t data[3])
+{
+  uint8_t *word;
+
+  /* Bypass mode: FIFO disabled */
+  if ((stub_regs[LSM6DSOX_FIFO_CTRL4] & 0x07) != LSM6DSOX_STREAM_MODE)
+  {
+    return;
+  }
+  if (stub_fifo_count == STUB_FIFO_WORDS)
+  {
+    stub_fifo_head = (stub_fifo_head + 1) % STUB_FIFO_WORDS;
+    stub_fifo_count--;
+    stub_overrun = 1;
+  }
+  word = stub_fifo[(stub_fifo_head + stub_fifo_count) % STUB_FIFO_WORDS];
+  word[0] = (uint8_t)(tag << 3);
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    word[1 + 2 * i] = (uint8_t)data[i];
+    word[2 + 2 * i] = (uint8_t)((uint16_t)data[i] >> 8);
+  }
+  stub_fifo_count++;
+  stub_update_int1();
+}
+
+uint16_t stub_fifo_level(void)
+{
+  return stub_fifo_count;
+}
+
+uint8_t stub_int1(void)
+{
+  return stub_int1_level;
+}
+
+uint8_t stub_exti_irq(void)
+{
+  if ((SYSCFG->IO_ISCR & BSP_SENSOR1_INT_EXTI_LINE) == 0)
+  {
+    return 0;
+  }
+  BSP_MOTION_IRQHandler();
+  /* IO_ISCR is cleared by writing 1 */
+  SYSCFG->IO_ISCR &= ~BSP_SENSOR1_INT_EXTI_LINE;
+  return 1;
+}
+
+uint8_t stub_spi_busy(void)
+{
+  return stub_spi_ongoing;
+}
+
+void stub_spi_complete(int32_t status)
+{
+  void (*callback)(int32_t status) = stub_spi_callback;
+
+  stub_spi_ongoing = 0;
+  stub_spi_callback = NULL;
+  if (callback != NULL)
+  {
+    callback(status);
+  }
+}
+
+/* Register auto-increment; the FIFO output registers pop a word */
+int32_t BSP_SPI_Read(void *handle, uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize)
+{
+  if (Reg == LSM6DSOX_FIFO_DATA_OUT_TAG)
+  {
+    for (uint16_t i = 0; i + FIFO_WORD_SIZE <= nBuffSize; i += FIFO_WORD_SIZE)
+    {
+      stub_fifo_pop(&pBuff[i]);
+    }
+    stub_update_int1();
+    return BSP_ERROR_NONE;
+  }
+  for (uint16_t i = 0; i < nBuffSize; i++)
+  {
+    uint8_t reg = (uint8_t)(Reg + i);
+
+    if (reg == LSM6DSOX_FIFO_STATUS1)
+    {
+      pBuff[i] = (uint8_t)stub_fifo_count;
+    }
+    else if (reg == LSM6DSOX_FIFO_STATUS2)
+    {
+      /* Overrun latched, cleared by the read */
+      pBuff[i] = (uint8_t)((stub_fifo_count >> 8) & 0x03) | (stub_overrun << 3) | (stub_int1_level << 7);
+      stub_overrun = 0;
+    }
+    else
+    {
+      pBuff[i] = *stub_reg(reg);
+    }
+  }
+  return BSP_ERROR_NONE;
+}
+
+int32_t BSP_SPI_Write(void *handle, uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize)
+{
+  for (uint16_t i = 0; i < nBuffSize; i++)
+  {
+    uint8_t reg = (uint8_t)(Reg + i);
+
+    *stub_reg(reg) = pBuff[i];
+    /* Bypass mode empties the FIFO */
+    if ((reg == LSM6DSOX_FIFO_CTRL4) && (stub_reg(reg) == &stub_regs[reg]) && ((pBuff[i] & 0x07) == LSM6DSOX_BYPASS_MODE))
+    {
+      stub_fifo_head = 0;
+      stub_fifo_count = 0;
+      stub_overrun = 0;
+    }
+  }
+  stub_update_int1();
+  return BSP_ERROR_NONE;
+}
+
+/* The words are taken from the FIFO at once, the end is reported by stub_spi_complete() */
+int32_t BSP_SPI_ReadAsync(uint8_t Reg, uint8_t *pBuff, uint16_t nBuffSize, void (*Callback)(int32_t status))
+{
+  if (stub_spi_ongoing)
+  {
+    return BSP_ERROR_BUSY;
+  }
+  BSP_SPI_Read(NULL, Reg, pBuff, nBuffSize);
+  stub_spi_ongoing = 1;
+  stub_spi_callback = Callback;
+  stub_spi_reads++;
+  stub_spi_words = nBuffSize / FIFO_WORD_SIZE;
+  return BSP_ERROR_NONE;
+}
+
+void BSP_SPI_Abort(void)
+{
+  stub_spi_ongoing = 0;
+  stub_spi_callback = NULL;
+}
+
+void BSP_SPI_GpioInt_Init(void)
+{
+  SYSCFG->IO_IER |= BSP_SENSOR1_INT_EXTI_LINE;
+  stub_update_int1();
+}
@@ -0,0 +1,45 @@
+/**
+  ******************************************************************************
+  * @file    bsp_host_stub.h
+  * @brief   Simulated LSM6DSOX on the BSP SPI: register map, FIFO in stream
+  *          mode with watermark on INT1 and overrun, and asynchronous reads
+  *          completed when the test runs the DMA interrupt.
+  ******************************************************************************
+  */
+
+#ifndef BSP_HOST_STUB_H
+#define BSP_HOST_STUB_H
+
+#include <stdint.h>
+
+/* FIFO size of the simulated sensor, in words */
+#define STUB_FIFO_WORDS         (512)
+
+/* User bank registers of the sensor */
+extern uint8_t stub_regs[256];
+/* Asynchronous SPI reads started */
+extern uint32_t stub_spi_reads;
+/* Words read by the last asynchronous read */
+extern uint16_t stub_spi_words;
+
+void stub_reset(void);
+
+/* The sensor batches a word in its FIFO. In stream mode the oldest word is
+   lost when the FIFO is full. */
+void stub_fifo_push(uint8_t tag, const int16_t data[3]);
+uint16_t stub_fifo_level(void);
+
+/* INT1 level */
+uint8_t stub_int1(void);
+
+/* EXTI interrupt of INT1: BSP_MOTION_IRQHandler() is called if an edge is
+   pending. Returns 0 if there was nothing to do. */
+uint8_t stub_exti_irq(void);
+
+/* An asynchronous SPI read is ongoing */
+uint8_t stub_spi_busy(void);
+
+/* DMA interrupt: the ongoing asynchronous read ends with the given status */
+void stub_spi_complete(int32_t status);
+
+#endif /* BSP_HOST_STUB_H */
@@ -0,0 +1,460 @@
+/**
+  ******************************************************************************
+  * @file    bus_host_stub.c
+  * @brief   Register level fake of the BSP sensor buses: I2C1 with a register
+  *          file slave, SPI1 and its DMA channels with a register file slave
+  *          selected by CS, and the injected faults.
+  ******************************************************************************
+  */
+
+#define BUS_HOST_STUB_C
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "bus_host_stub.h"
+#include "bluenrg_lp_evb_config.h"
+
+/* Flags of the DMA channel ch in DMA1 ISR/IFCR */
+#define DMA_FLAGS(ch, flags)    ((uint32_t)(flags) << (((ch) - 1U) * 4U))
+#define DMA_CHANNEL(ch)         ((DMA_Channel_TypeDef *)(DMA1_Channel1_BASE + ((ch) - 1U) * 0x14U))
+/* Read-only registers for the drivers */
+#define REG(reg)                (*(volatile uint32_t *)&(reg))
+
+#define I2C_IRQ_MAX_CALLS       (1000)
+#define SPI_RX_FIFO_SIZE        (4)
+
+typedef enum
+{
+  I2C_IDLE,
+  I2C_TX,
+  I2C_RX,
+  I2C_RESTART,      /* Transfer complete in software end mode */
+  I2C_HALTED,       /* Fault: no more flags until the peripheral reset */
+} i2c_phase_t;
+
+stub_fault_t stub_fault;
+int32_t stub_fault_byte;
+uint8_t stub_i2c_regs[256];
+uint8_t stub_spi_regs[256];
+int32_t stub_bus_bytes;
+uint32_t stub_i2c_resets;
+uint8_t stub_spi_cs;
+
+static i2c_phase_t i2c_phase;
+static uint32_t i2c_left;
+static uint8_t i2c_autoend;
+static uint8_t i2c_ptr;
+static uint8_t i2c_rxdr;
+
+static uint8_t spi_read;
+static uint8_t spi_ptr;
+static uint8_t spi_stuck;
+static uint8_t spi_rx_fifo[SPI_RX_FIFO_SIZE];
+static uint8_t spi_rx_count;
+
+static void stub_map(uint32_t base)
+{
+  void *page = mmap((void *)(uintptr_t)base, 0x1000, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (page == MAP_FAILED)
+  {
+    abort();
+  }
+  memset(page, 0, 0x1000);
+}
+
+void stub_reset(void)
+{
+  stub_map(I2C1_BASE);
+  stub_map(SPI1_BASE);
+  stub_map(GPIOA_BASE);
+  stub_map(GPIOB_BASE);
+  stub_map(RCC_BASE);
+  stub_map(DMA1_BASE);
+  stub_map(SCS_BASE);
+
+  REG(I2C1->ISR) = I2C_ISR_TXE;
+  REG(I2C1->CR1) = I2C_CR1_PE;
+  REG(SPI1->SR) = SPI_SR_TXE;
+
+  stub_fault = STUB_FAULT_NONE;
+  stub_fault_byte = 0;
+  memset(stub_i2c_regs, 0, sizeof(stub_i2c_regs));
+  memset(stub_spi_regs, 0, sizeof(stub_spi_regs));
+  stub_bus_bytes = 0;
+  stub_i2c_resets = 0;
+  stub_spi_cs = 1;
+
+  i2c_phase = I2C_IDLE;
+  i2c_left = 0;
+  spi_stuck = 0;
+  spi_rx_count = 0;
+}
+
+/* The injected fault, if it is at the current byte. It is applied once. */
+static stub_fault_t stub_fault_take(void)
+{
+  stub_fault_t fault = stub_fault;
+
+  if ((fault == STUB_FAULT_NONE) || (stub_fault_byte != stub_bus_bytes))
+  {
+    return STUB_FAULT_NONE;
+  }
+  stub_fault = STUB_FAULT_NONE;
+  return fault;
+}
+
+/**** I2C ********************************************************************/
+
+static uint8_t i2c_fault(void)
+{
+  stub_fault_t fault = stub_fault_take();
+
+  switch (fault)
+  {
+  case STUB_FAULT_NACK:
+    /* In master mode a STOP is sent after the NACK */
+    REG(I2C1->ISR) |= I2C_ISR_NACKF | I2C_ISR_STOPF;
+    i2c_phase = I2C_IDLE;
+    return 1;
+  case STUB_FAULT_BERR:
+    REG(I2C1->ISR) |= I2C_ISR_BERR;
+    i2c_phase = I2C_HALTED;
+    return 1;
+  case STUB_FAULT_ARLO:
+    REG(I2C1->ISR) |= I2C_ISR_ARLO;
+    i2c_phase = I2C_HALTED;
+    return 1;
+  case STUB_FAULT_STUCK:
+    /* SCL held low by the slave */
+    i2c_phase = I2C_HALTED;
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static void i2c_next_rx(void)
+{
+  if (!i2c_fault())
+  {
+    i2c_rxdr = stub_i2c_regs[i2c_ptr++];
+    REG(I2C1->ISR) |= I2C_ISR_RXNE;
+  }
+}
+
+static void i2c_byte_done(void)
+{
+  stub_bus_bytes++;
+  if (--i2c_left != 0)
+  {
+    if (i2c_phase == I2C_TX)
+    {
+      REG(I2C1->ISR) |= I2C_ISR_TXIS;
+    }
+    else
+    {
+      i2c_next_rx();
+    }
+  }
+  else if (i2c_autoend)
+  {
+    REG(I2C1->ISR) |= I2C_ISR_STOPF;
+    i2c_phase = I2C_IDLE;
+  }
+  else
+  {
+    REG(I2C1->ISR) |= I2C_ISR_TC;
+    i2c_phase = I2C_RESTART;
+  }
+}
+
+void stub_LL_I2C_HandleTransfer(I2C_TypeDef *I2Cx, uint32_t SlaveAddr, uint32_t SlaveAddrSize,
+                                uint32_t TransferSize, uint32_t EndMode, uint32_t Request)
+{
+  LL_I2C_HandleTransfer(I2Cx, SlaveAddr, SlaveAddrSize, TransferSize, EndMode, Request);
+
+  if (((Request & I2C_CR2_START) == 0) || ((I2Cx->CR1 & I2C_CR1_PE) == 0) || (i2c_phase == I2C_HALTED))
+  {
+    return;
+  }
+  REG(I2Cx->ISR) &= ~I2C_ISR_TC;
+  if (i2c_phase == I2C_IDLE)
+  {
+    /* START: the slave address is the first byte on the bus */
+    stub_bus_bytes = STUB_BYTE_ADDRESS;
+    if (i2c_fault())
+    {
+      return;
+    }
+    stub_bus_bytes = 0;
+  }
+  i2c_left = TransferSize;
+  i2c_autoend = (EndMode == LL_I2C_MODE_AUTOEND);
+  if (Request & I2C_CR2_RD_WRN)
+  {
+    i2c_phase = I2C_RX;
+    i2c_next_rx();
+  }
+  else
+  {
+    i2c_phase = I2C_TX;
+    REG(I2Cx->ISR) |= I2C_ISR_TXIS;
+  }
+}
+
+void stub_LL_I2C_TransmitData8(I2C_TypeDef *I2Cx, uint8_t Data)
+{
+  if (i2c_phase != I2C_TX)
+  {
+    return;
+  }
+  REG(I2Cx->ISR) &= ~I2C_ISR_TXIS;
+  if (i2c_fault())
+  {
+    return;
+  }
+  /* Register address, auto-increment bit ignored, then the data */
+  if (stub_bus_bytes == 0)
+  {
+    i2c_ptr = Data & 0x7F;
+  }
+  else
+  {
+    stub_i2c_regs[i2c_ptr++] = Data;
+  }
+  i2c_byte_done();
+}
+
+uint8_t stub_LL_I2C_ReceiveData8(I2C_TypeDef *I2Cx)
+{
+  uint8_t data = i2c_rxdr;
+
+  if ((i2c_phase != I2C_RX) || ((I2Cx->ISR & I2C_ISR_RXNE) == 0))
+  {
+    return data;
+  }
+  REG(I2Cx->ISR) &= ~I2C_ISR_RXNE;
+  i2c_byte_done();
+  return data;
+}
+
+void stub_LL_I2C_ClearFlag_NACK(I2C_TypeDef *I2Cx)
+{
+  REG(I2Cx->ISR) &= ~I2C_ISR_NACKF;
+}
+
+void stub_LL_I2C_ClearFlag_STOP(I2C_TypeDef *I2Cx)
+{
+  REG(I2Cx->ISR) &= ~I2C_ISR_STOPF;
+}
+
+void stub_LL_I2C_ClearFlag_BERR(I2C_TypeDef *I2Cx)
+{
+  REG(I2Cx->ISR) &= ~I2C_ISR_BERR;
+}
+
+void stub_LL_I2C_ClearFlag_ARLO(I2C_TypeDef *I2Cx)
+{
+  REG(I2Cx->ISR) &= ~I2C_ISR_ARLO;
+}
+
+void stub_LL_I2C_ClearFlag_OVR(I2C_TypeDef *I2Cx)
+{
+  REG(I2Cx->ISR) &= ~I2C_ISR_OVR;
+}
+
+/* PE cleared: the bus is released and the flags are cleared */
+void stub_LL_I2C_Disable(I2C_TypeDef *I2Cx)
+{
+  LL_I2C_Disable(I2Cx);
+  REG(I2Cx->ISR) = I2C_ISR_TXE;
+  i2c_phase = I2C_IDLE;
+  stub_i2c_resets++;
+}
+
+uint32_t stub_i2c_flags(void)
+{
+  return I2C1->ISR & ~I2C_ISR_TXE;
+}
+
+static uint8_t i2c_irq_pending(void)
+{
+  uint32_t cr1 = I2C1->CR1, isr = I2C1->ISR;
+
+  return ((cr1 & I2C_CR1_TXIE) && (isr & I2C_ISR_TXIS)) ||
+         ((cr1 & I2C_CR1_RXIE) && (isr & I2C_ISR_RXNE)) ||
+         ((cr1 & I2C_CR1_TCIE) && (isr & I2C_ISR_TC)) ||
+         ((cr1 & I2C_CR1_NACKIE) && (isr & I2C_ISR_NACKF)) ||
+         ((cr1 & I2C_CR1_STOPIE) && (isr & I2C_ISR_STOPF)) ||
+         ((cr1 & I2C_CR1_ERRIE) && (isr & (I2C_ISR_BERR | I2C_ISR_ARLO | I2C_ISR_OVR)));
+}
+
+uint32_t stub_i2c_irq(void)
+{
+  uint32_t calls = 0;
+
+  while (i2c_irq_pending() && (calls < I2C_IRQ_MAX_CALLS))
+  {
+    BSP_I2C_IRQHandler();
+    calls++;
+  }
+  return calls;
+}
+
+/**** SPI ********************************************************************/
+
+/* Full duplex byte with the slave: register address with the read bit, then the data */
+static uint8_t spi_exchange(uint8_t tx)
+{
+  uint8_t rx = 0;
+
+  if (stub_spi_cs)
+  {
+    return 0xFF;
+  }
+  if (stub_bus_bytes == 0)
+  {
+    spi_read = tx & 0x80;
+    spi_ptr = tx & 0x7F;
+  }
+  else if (spi_read)
+  {
+    rx = stub_spi_regs[spi_ptr++];
+  }
+  else
+  {
+    stub_spi_regs[spi_ptr++] = tx;
+  }
+  stub_bus_bytes++;
+  return rx;
+}
+
+void stub_LL_SPI_TransmitData8(SPI_TypeDef *SPIx, uint8_t TxData)
+{
+  if (spi_stuck || ((stub_fault == STUB_FAULT_STUCK) && (stub_fault_take() == STUB_FAULT_STUCK)))
+  {
+    /* SCK stopped: the TX FIFO is not emptied */
+    spi_stuck = 1;
+    REG(SPIx->SR) &= ~SPI_SR_TXE;
+    return;
+  }
+  if (spi_rx_count < SPI_RX_FIFO_SIZE)
+  {
+    spi_rx_fifo[spi_rx_count++] = spi_exchange(TxData);
+  }
+  REG(SPIx->SR) |= SPI_SR_RXNE;
+}
+
+uint8_t stub_LL_SPI_ReceiveData8(SPI_TypeDef *SPIx)
+{
+  uint8_t data;
+
+  if (spi_rx_count == 0)
+  {
+    return 0;
+  }
+  data = spi_rx_fifo[0];
+  memmove(spi_rx_fifo, spi_rx_fifo + 1, --spi_rx_count);
+  if (spi_rx_count == 0)
+  {
+    REG(SPIx->SR) &= ~SPI_SR_RXNE;
+  }
+  return data;
+}
+
+/* IFCR is write-1-to-clear in the device */
+static void dma_clear_flags(void)
+{
+  uint32_t ifcr = DMA1->IFCR;
+
+  for (uint32_t ch = 1; ch <= 8; ch++)
+  {
+    if (ifcr & DMA_FLAGS(ch, DMA_IFCR_CGIF1))
+    {
+      ifcr |= DMA_FLAGS(ch, 0xF);
+    }
+  }
+  REG(DMA1->ISR) &= ~ifcr;
+  REG(DMA1->IFCR) = 0;
+}
+
+/* The TX request starts the DMA transfer: it runs at once */
+void stub_LL_SPI_EnableDMAReq_TX(SPI_TypeDef *SPIx)
+{
+  DMA_Channel_TypeDef *tx = DMA_CHANNEL(BSP_SPI_TX_DMA_CH), *rx = DMA_CHANNEL(BSP_SPI_RX_DMA_CH);
+  uint8_t *tx_mem, *rx_mem;
+  stub_fault_t fault;
+
+  LL_SPI_EnableDMAReq_TX(SPIx);
+  dma_clear_flags();
+  if (((tx->CCR & DMA_CCR_EN) == 0) || ((rx->CCR & DMA_CCR_EN) == 0))
+  {
+    return;
+  }
+  tx_mem = (uint8_t *)(uintptr_t)tx->CMAR;
+  rx_mem = (uint8_t *)(uintptr_t)rx->CMAR;
+  while (tx->CNDTR != 0)
+  {
+    fault = stub_fault_take();
+    if (fault == STUB_FAULT_DMA_TE)
+    {
+      REG(DMA1->ISR) |= DMA_FLAGS(BSP_SPI_TX_DMA_CH, DMA_ISR_TEIF1 | DMA_ISR_GIF1);
+      return;
+    }
+    if (fault == STUB_FAULT_STUCK)
+    {
+      spi_stuck = 1;
+      return;
+    }
+    *rx_mem = spi_exchange(*tx_mem);
+    if (tx->CCR & DMA_CCR_MINC)
+    {
+      tx_mem++;
+    }
+    if (rx->CCR & DMA_CCR_MINC)
+    {
+      rx_mem++;
+    }
+    tx->CNDTR--;
+    rx->CNDTR--;
+  }
+  REG(DMA1->ISR) |= DMA_FLAGS(BSP_SPI_TX_DMA_CH, DMA_ISR_TCIF1 | DMA_ISR_GIF1) |
+                    DMA_FLAGS(BSP_SPI_RX_DMA_CH, DMA_ISR_TCIF1 | DMA_ISR_GIF1);
+}
+
+uint8_t stub_dma_irq(void)
+{
+  dma_clear_flags();
+  if ((DMA1->ISR & (DMA_FLAGS(BSP_SPI_TX_DMA_CH, 0xF) | DMA_FLAGS(BSP_SPI_RX_DMA_CH, 0xF))) == 0)
+  {
+    return 0;
+  }
+  BSP_SPI_DMA_IRQHandler();
+  dma_clear_flags();
+  return 1;
+}
+
+/* CS of the SPI slave */
+void stub_LL_GPIO_SetOutputPin(GPIO_TypeDef *GPIOx, uint32_t PinMask)
+{
+  LL_GPIO_SetOutputPin(GPIOx, PinMask);
+  if ((GPIOx == BSP_SPI_CS_SENSOR1_GPIO_PORT) && (PinMask & BSP_SPI_CS_SENSOR1_PIN))
+  {
+    stub_spi_cs = 1;
+    /* The bus recovers with the end of the transfer */
+    spi_stuck = 0;
+    REG(SPI1->SR) |= SPI_SR_TXE;
+  }
+}
+
+void stub_LL_GPIO_ResetOutputPin(GPIO_TypeDef *GPIOx, uint32_t PinMask)
+{
+  LL_GPIO_ResetOutputPin(GPIOx, PinMask);
+  if ((GPIOx == BSP_SPI_CS_SENSOR1_GPIO_PORT) && (PinMask & BSP_SPI_CS_SENSOR1_PIN))
+  {
+    stub_spi_cs = 0;
+    stub_bus_bytes = 0;
+  }
+}
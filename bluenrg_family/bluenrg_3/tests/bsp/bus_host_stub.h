@@ -0,0 +1,103 @@
+/**
+  ******************************************************************************
+  * @file    bus_host_stub.h
+  * @brief   Register level fake of the BSP sensor buses: I2C1 with a register
+  *          file slave, SPI1 and its DMA channels with a register file slave
+  *          selected by CS. Faults are injected at a given byte: NACK, bus
+  *          error, arbitration lost, DMA transfer error, or a stuck bus.
+  *
+  *          The registers are mapped at their device address and hold the
+  *          flags, so the LL functions only reading them are the device ones.
+  *          The LL functions with a side effect on the bus are redirected to
+  *          the fake by the macros at the end of this file, which must be
+  *          included before the BSP sources.
+  ******************************************************************************
+  */
+
+#ifndef BUS_HOST_STUB_H
+#define BUS_HOST_STUB_H
+
+#include <stdint.h>
+#include "bluenrg_lpx.h"
+#include "rf_driver_ll_gpio.h"
+#include "rf_driver_ll_i2c.h"
+#include "rf_driver_ll_spi.h"
+#include "rf_driver_ll_dma.h"
+
+/* Fault injected by the slaves */
+typedef enum
+{
+  STUB_FAULT_NONE,
+  STUB_FAULT_NACK,        /* I2C: the byte is not acknowledged, STOP follows */
+  STUB_FAULT_BERR,        /* I2C: misplaced START or STOP, no STOP follows */
+  STUB_FAULT_ARLO,        /* I2C: arbitration lost, no STOP follows */
+  STUB_FAULT_DMA_TE,      /* SPI: DMA transfer error on the TX channel */
+  STUB_FAULT_STUCK,       /* The byte is never transferred */
+} stub_fault_t;
+
+/* Byte of the fault: STUB_BYTE_ADDRESS for the I2C slave address, then 0 for
+   the register address and 1 for the first data byte */
+#define STUB_BYTE_ADDRESS       (-1)
+
+extern stub_fault_t stub_fault;
+extern int32_t stub_fault_byte;
+
+/* Register files of the slaves */
+extern uint8_t stub_i2c_regs[256];
+extern uint8_t stub_spi_regs[256];
+
+/* Bytes transferred in the current or last transfer, register address included */
+extern int32_t stub_bus_bytes;
+/* I2C peripheral resets (PE cleared) */
+extern uint32_t stub_i2c_resets;
+/* SPI CS: 1 when released (high) */
+extern uint8_t stub_spi_cs;
+
+void stub_reset(void);
+
+/* I2C1 interrupt: BSP_I2C_IRQHandler() is called while an enabled flag is
+   set. Returns the number of calls. */
+uint32_t stub_i2c_irq(void);
+
+/* DMA interrupt: BSP_SPI_DMA_IRQHandler() is called if a flag of the SPI
+   channels is set. Returns 0 if there was nothing to do. */
+uint8_t stub_dma_irq(void);
+
+/* The I2C peripheral flags still set */
+uint32_t stub_i2c_flags(void);
+
+/* LL functions with a side effect on the bus */
+void stub_LL_I2C_HandleTransfer(I2C_TypeDef *I2Cx, uint32_t SlaveAddr, uint32_t SlaveAddrSize,
+                                uint32_t TransferSize, uint32_t EndMode, uint32_t Request);
+void stub_LL_I2C_TransmitData8(I2C_TypeDef *I2Cx, uint8_t Data);
+uint8_t stub_LL_I2C_ReceiveData8(I2C_TypeDef *I2Cx);
+void stub_LL_I2C_ClearFlag_NACK(I2C_TypeDef *I2Cx);
+void stub_LL_I2C_ClearFlag_STOP(I2C_TypeDef *I2Cx);
+void stub_LL_I2C_ClearFlag_BERR(I2C_TypeDef *I2Cx);
+void stub_LL_I2C_ClearFlag_ARLO(I2C_TypeDef *I2Cx);
+void stub_LL_I2C_ClearFlag_OVR(I2C_TypeDef *I2Cx);
+void stub_LL_I2C_Disable(I2C_TypeDef *I2Cx);
+void stub_LL_SPI_TransmitData8(SPI_TypeDef *SPIx, uint8_t TxData);
+uint8_t stub_LL_SPI_ReceiveData8(SPI_TypeDef *SPIx);
+void stub_LL_SPI_EnableDMAReq_TX(SPI_TypeDef *SPIx);
+void stub_LL_GPIO_SetOutputPin(GPIO_TypeDef *GPIOx, uint32_t PinMask);
+void stub_LL_GPIO_ResetOutputPin(GPIO_TypeDef *GPIOx, uint32_t PinMask);
+
+#ifndef BUS_HOST_STUB_C
+#define LL_I2C_HandleTransfer       stub_LL_I2C_HandleTransfer
+#define LL_I2C_TransmitData8        stub_LL_I2C_TransmitData8
+#define LL_I2C_ReceiveData8         stub_LL_I2C_ReceiveData8
+#define LL_I2C_ClearFlag_NACK       stub_LL_I2C_ClearFlag_NACK
+#define LL_I2C_ClearFlag_STOP       stub_LL_I2C_ClearFlag_STOP
+#define LL_I2C_ClearFlag_BERR       stub_LL_I2C_ClearFlag_BERR
+#define LL_I2C_ClearFlag_ARLO       stub_LL_I2C_ClearFlag_ARLO
+#define LL_I2C_ClearFlag_OVR        stub_LL_I2C_ClearFlag_OVR
+#define LL_I2C_Disable              stub_LL_I2C_Disable
+#define LL_SPI_TransmitData8        stub_LL_SPI_TransmitData8
+#define LL_SPI_ReceiveData8         stub_LL_SPI_ReceiveData8
+#define LL_SPI_EnableDMAReq_TX      stub_LL_SPI_EnableDMAReq_TX
+#define LL_GPIO_SetOutputPin        stub_LL_GPIO_SetOutputPin
+#define LL_GPIO_ResetOutputPin      stub_LL_GPIO_ResetOutputPin
+#endif
+
+#endif /* BUS_HOST_STUB_H */
@@ -0,0 +1,155 @@
+/**
+  ******************************************************************************
+  * @file    com_host_stub.c
+  * @brief   Register level fake of the BSP COM UART (USART1) with a simulated
+  *          clock and UART interrupt.
+  ******************************************************************************
+  */
+
+#define COM_HOST_STUB_C
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "com_host_stub.h"
+#include "bluenrg_lp_evb_com.h"
+
+/* TX FIFO threshold of BSP_COM_Init(): LL_USART_FIFOTHRESHOLD_1_8 */
+#define TX_FIFO_THRESHOLD       (STUB_TX_FIFO_SIZE / 8)
+/* Granularity of stub_idle() */
+#define IDLE_STEP_NS            (1000U)
+
+uint64_t stub_time_ns;
+uint8_t stub_tx_data[8192];
+uint32_t stub_tx_count;
+uint32_t stub_tx_overruns;
+uint32_t stub_irq_count;
+
+/* Time at which the bytes in the FIFO and in the shift register are sent */
+static uint64_t tx_end[STUB_TX_FIFO_SIZE + 1];
+static uint32_t tx_pending;
+static uint8_t in_irq;
+
+static void stub_map(uint32_t base)
+{
+  void *page = mmap((void *)(uintptr_t)base, 0x1000, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (page == MAP_FAILED)
+  {
+    abort();
+  }
+  memset(page, 0, 0x1000);
+}
+
+void stub_reset(void)
+{
+  stub_map(USART1_BASE);
+  stub_map(GPIOA_BASE);
+  stub_map(GPIOB_BASE);
+  stub_map(RCC_BASE);
+  stub_map(PWR_BASE);
+  stub_map(SCS_BASE);
+
+  stub_time_ns = 0;
+  stub_tx_count = 0;
+  stub_tx_overruns = 0;
+  stub_irq_count = 0;
+  tx_pending = 0;
+  in_irq = 0;
+}
+
+/* Bytes sent by the current time are removed, returns the bytes in the FIFO */
+static uint32_t tx_fifo_level(void)
+{
+  uint32_t sent = 0;
+
+  while ((sent < tx_pending) && (tx_end[sent] <= stub_time_ns))
+  {
+    sent++;
+  }
+  memmove(tx_end, &tx_end[sent], (tx_pending - sent) * sizeof(tx_end[0]));
+  tx_pending -= sent;
+
+  /* The oldest byte is in the shift register */
+  return (tx_pending > 0) ? tx_pending - 1 : 0;
+}
+
+static uint8_t txft_pending(void)
+{
+  return LL_USART_IsEnabledIT_TXFT(USART1) && (tx_fifo_level() <= TX_FIFO_THRESHOLD);
+}
+
+/* UART interrupt, if enabled and pending and PRIMASK is cleared */
+static void uart_irq(void)
+{
+  if ((host_primask == 0) && !in_irq && txft_pending())
+  {
+    in_irq = 1;
+    stub_irq_count++;
+    BSP_COM_IRQHandler();
+    in_irq = 0;
+  }
+}
+
+/* Time of a flag poll, the interrupt can be taken meanwhile */
+static uint32_t tx_poll(void)
+{
+  stub_time_ns += STUB_POLL_NS;
+  uart_irq();
+  return tx_fifo_level();
+}
+
+void stub_idle(uint64_t ns)
+{
+  uint64_t end = stub_time_ns + ns;
+
+  while (stub_time_ns < end)
+  {
+    stub_time_ns += IDLE_STEP_NS;
+    uart_irq();
+  }
+}
+
+void stub_LL_USART_TransmitData8(USART_TypeDef *USARTx, uint8_t Value)
+{
+  uint64_t start;
+
+  (void)USARTx;
+  if (tx_fifo_level() >= STUB_TX_FIFO_SIZE)
+  {
+    stub_tx_overruns++;
+    return;
+  }
+  start = (tx_pending > 0) ? tx_end[tx_pending - 1] : stub_time_ns;
+  tx_end[tx_pending++] = start + STUB_BYTE_NS;
+  if (stub_tx_count < sizeof(stub_tx_data))
+  {
+    stub_tx_data[stub_tx_count] = Value;
+  }
+  stub_tx_count++;
+}
+
+uint32_t stub_LL_USART_IsActiveFlag_TXE_TXFNF(USART_TypeDef *USARTx)
+{
+  (void)USARTx;
+  return tx_poll() < STUB_TX_FIFO_SIZE;
+}
+
+uint32_t stub_LL_USART_IsActiveFlag_TXFT(USART_TypeDef *USARTx)
+{
+  (void)USARTx;
+  return tx_poll() <= TX_FIFO_THRESHOLD;
+}
+
+uint32_t stub_LL_USART_IsActiveFlag_TXFE(USART_TypeDef *USARTx)
+{
+  (void)USARTx;
+  return tx_poll() == 0;
+}
+
+uint32_t stub_LL_USART_IsActiveFlag_TC(USART_TypeDef *USARTx)
+{
+  (void)USARTx;
+  tx_poll();
+  return tx_pending == 0;
+}
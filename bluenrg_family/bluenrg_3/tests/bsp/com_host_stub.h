@@ -0,0 +1,64 @@
+/**
+  ******************************************************************************
+  * @file    com_host_stub.h
+  * @brief   Register level fake of the BSP COM UART (USART1) with a simulated
+  *          clock: the TX FIFO sends a byte per character time at the BSP
+  *          baudrate and each poll of a TX flag costs STUB_POLL_NS, so the
+  *          time spent in a call is the time it waited for the UART.
+  *
+  *          The UART interrupt is simulated: BSP_COM_IRQHandler() is called
+  *          at a flag poll, or while stub_idle() runs, if the TX FIFO
+  *          threshold interrupt is enabled and pending with PRIMASK cleared.
+  *          As for bus_host_stub.h, the LL functions with a side effect are
+  *          redirected to the fake by the macros at the end of this file.
+  ******************************************************************************
+  */
+
+#ifndef COM_HOST_STUB_H
+#define COM_HOST_STUB_H
+
+#include <stdint.h>
+#include "bluenrg_lpx.h"
+#include "rf_driver_ll_usart.h"
+
+/* Depth of the UART TX FIFO */
+#define STUB_TX_FIFO_SIZE       (8)
+/* Time of a character: start bit, 8 data bits and stop bit at 115200 baud */
+#define STUB_BYTE_NS            (10ULL * 1000000000ULL / 115200U)
+/* Time of a poll of a UART flag */
+#define STUB_POLL_NS            (100U)
+
+/* Simulated time */
+extern uint64_t stub_time_ns;
+
+/* Bytes written to the TX FIFO, in order */
+extern uint8_t stub_tx_data[8192];
+extern uint32_t stub_tx_count;
+/* Bytes written with the TX FIFO full (lost) */
+extern uint32_t stub_tx_overruns;
+/* Calls of BSP_COM_IRQHandler() */
+extern uint32_t stub_irq_count;
+
+void stub_reset(void);
+
+/* The application runs without the UART for ns: the UART interrupt is served */
+void stub_idle(uint64_t ns);
+
+/* LL functions with a side effect on the UART or the simulated time */
+void stub_LL_USART_TransmitData8(USART_TypeDef *USARTx, uint8_t Value);
+uint32_t stub_LL_USART_IsActiveFlag_TXE_TXFNF(USART_TypeDef *USARTx);
+uint32_t stub_LL_USART_IsActiveFlag_TXFT(USART_TypeDef *USARTx);
+uint32_t stub_LL_USART_IsActiveFlag_TXFE(USART_TypeDef *USARTx);
+uint32_t stub_LL_USART_IsActiveFlag_TC(USART_TypeDef *USARTx);
+
+#ifndef COM_HOST_STUB_C
+#undef LL_USART_IsActiveFlag_TXE
+#define LL_USART_IsActiveFlag_TXE       stub_LL_USART_IsActiveFlag_TXE_TXFNF
+#define LL_USART_TransmitData8          stub_LL_USART_TransmitData8
+#define LL_USART_IsActiveFlag_TXE_TXFNF stub_LL_USART_IsActiveFlag_TXE_TXFNF
+#define LL_USART_IsActiveFlag_TXFT      stub_LL_USART_IsActiveFlag_TXFT
+#define LL_USART_IsActiveFlag_TXFE      stub_LL_USART_IsActiveFlag_TXFE
+#define LL_USART_IsActiveFlag_TC        stub_LL_USART_IsActiveFlag_TC
+#endif
+
+#endif /* COM_HOST_STUB_H */
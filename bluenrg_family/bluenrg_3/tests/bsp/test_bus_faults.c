@@ -0,0 +1,272 @@
+/**
+  ******************************************************************************
+  * @file    test_bus_faults.c
+  * @brief   Faults on the BSP sensor buses: the blocking I2C and SPI transfers
+  *          and the asynchronous ones (I2C interrupt, SPI DMA) end with an
+  *          error on NACK, bus error, arbitration lost, DMA transfer error or
+  *          a stuck bus, and leave the bus released for the next transfer.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "test_assert.h"
+#include "bus_host_stub.h"
+#include "bluenrg_lp_evb_i2c.c"
+#include "bluenrg_lp_evb_spi.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define REG_ADDR        (0x10)
+
+/* The DMA addresses are 32 bits: static buffers of a non PIE executable */
+static uint8_t tx_data[8] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 };
+static uint8_t rx_data[8];
+
+static int32_t callback_status;
+static uint32_t callback_count;
+
+static void on_done(int32_t status)
+{
+  callback_status = status;
+  callback_count++;
+}
+
+static void reset(void)
+{
+  stub_reset();
+  memset(rx_data, 0, sizeof(rx_data));
+  callback_status = BSP_ERROR_BUSY;
+  callback_count = 0;
+}
+
+static void inject(stub_fault_t fault, int32_t byte)
+{
+  stub_fault = fault;
+  stub_fault_byte = byte;
+}
+
+/* The last transfer left the I2C idle, with no flag set */
+static void check_i2c_released(void)
+{
+  TEST_CHECK(!BSP_I2C_IsBusy());
+  TEST_CHECK_EQUAL(stub_i2c_flags(), 0);
+}
+
+static void check_spi_released(void)
+{
+  TEST_CHECK(!BSP_SPI_IsBusy());
+  TEST_CHECK_EQUAL(stub_spi_cs, 1);
+}
+
+static void test_i2c_blocking(void)
+{
+  reset();
+  TEST_CHECK_EQUAL(BSP_I2C_Write(NULL, REG_ADDR, tx_data, 4), BSP_ERROR_NONE);
+  TEST_CHECK_EQUAL(stub_bus_bytes, 5);
+  TEST_CHECK(memcmp(&stub_i2c_regs[REG_ADDR], tx_data, 4) == 0);
+  check_i2c_released();
+
+  TEST_CHECK_EQUAL(BSP_I2C_Read(NULL, REG_ADDR + 1, rx_data, 3), BSP_ERROR_NONE);
+  TEST_CHECK(memcmp(rx_data, &tx_data[1], 3) == 0);
+  check_i2c_released();
+  TEST_CHECK_EQUAL(stub_i2c_resets, 0);
+
+  TEST_CHECK_EQUAL(BSP_I2C_Read(NULL, REG_ADDR, rx_data, 0), BSP_ERROR_WRONG_PARAM);
+  TEST_CHECK_EQUAL(BSP_I2C_Write(NULL, REG_ADDR, tx_data, 255), BSP_ERROR_WRONG_PARAM);
+}
+
+/* A fault ends the transfer with the peripheral reset; the next one works */
+static void check_i2c_fault(stub_fault_t fault, int32_t byte, uint8_t read, int32_t expected)
+{
+  int32_t ret;
+
+  reset();
+  inject(fault, byte);
+  ret = read ? BSP_I2C_Read(NULL, REG_ADDR, rx_data, 4) : BSP_I2C_Write(NULL, REG_ADDR, tx_data, 4);
+  TEST_CHECK_EQUAL(ret, expected);
+  TEST_CHECK_EQUAL(stub_i2c_resets, 1);
+  TEST_CHECK_EQUAL(stub_fault, STUB_FAULT_NONE);
+  check_i2c_released();
+
+  TEST_CHECK_EQUAL(BSP_I2C_Write(NULL, REG_ADDR, tx_data, 4), BSP_ERROR_NONE);
+  TEST_CHECK_EQUAL(BSP_I2C_Read(NULL, REG_ADDR, rx_data, 4), BSP_ERROR_NONE);
+  TEST_CHECK(memcmp(rx_data, tx_data, 4) == 0);
+  TEST_CHECK_EQUAL(stub_i2c_resets, 1);
+}
+
+static void test_i2c_blocking_faults(void)
+{
+  /* No slave at the address */
+  check_i2c_fault(STUB_FAULT_NACK, STUB_BYTE_ADDRESS, 0, BSP_ERROR_BUS_FAILURE);
+  check_i2c_fault(STUB_FAULT_NACK, STUB_BYTE_ADDRESS, 1, BSP_ERROR_BUS_FAILURE);
+  /* Register address and data byte not acknowledged */
+  check_i2c_fault(STUB_FAULT_NACK, 0, 1, BSP_ERROR_BUS_FAILURE);
+  check_i2c_fault(STUB_FAULT_NACK, 3, 0, BSP_ERROR_BUS_FAILURE);
+  check_i2c_fault(STUB_FAULT_BERR, 2, 0, BSP_ERROR_BUS_FAILURE);
+  check_i2c_fault(STUB_FAULT_BERR, 2, 1, BSP_ERROR_BUS_FAILURE);
+  check_i2c_fault(STUB_FAULT_ARLO, 0, 0, BSP_ERROR_BUS_FAILURE);
+  check_i2c_fault(STUB_FAULT_ARLO, 4, 1, BSP_ERROR_BUS_FAILURE);
+  /* SCL held low: each byte times out after BSP_BUS_TIMEOUT loops */
+  check_i2c_fault(STUB_FAULT_STUCK, 1, 0, BSP_ERROR_TIMEOUT);
+  check_i2c_fault(STUB_FAULT_STUCK, 3, 1, BSP_ERROR_TIMEOUT);
+}
+
+static void test_i2c_async(void)
+{
+  reset();
+  TEST_CHECK_EQUAL(BSP_I2C_WriteAsync(REG_ADDR, tx_data, 4, on_done), BSP_ERROR_NONE);
+  TEST_CHECK(BSP_I2C_IsBusy());
+  /* The blocking transfers do not share the bus with the asynchronous one */
+  TEST_CHECK_EQUAL(BSP_I2C_Read(NULL, REG_ADDR, rx_data, 4), BSP_ERROR_BUSY);
+  TEST_CHECK_EQUAL(BSP_I2C_ReadAsync(REG_ADDR, rx_data, 4, on_done), BSP_ERROR_BUSY);
+  TEST_CHECK(stub_i2c_irq() != 0);
+  TEST_CHECK_EQUAL(callback_count, 1);
+  TEST_CHECK_EQUAL(callback_status, BSP_ERROR_NONE);
+  TEST_CHECK(memcmp(&stub_i2c_regs[REG_ADDR], tx_data, 4) == 0);
+  check_i2c_released();
+
+  TEST_CHECK_EQUAL(BSP_I2C_ReadAsync(REG_ADDR, rx_data, 4, on_done), BSP_ERROR_NONE);
+  TEST_CHECK(stub_i2c_irq() != 0);
+  TEST_CHECK_EQUAL(callback_count, 2);
+  TEST_CHECK_EQUAL(callback_status, BSP_ERROR_NONE);
+  TEST_CHECK(memcmp(rx_data, tx_data, 4) == 0);
+  check_i2c_released();
+  TEST_CHECK_EQUAL(stub_i2c_resets, 0);
+}
+
+static void check_i2c_async_fault(stub_fault_t fault, int32_t byte, uint8_t read, uint32_t resets)
+{
+  reset();
+  inject(fault, byte);
+  TEST_CHECK_EQUAL(read ? BSP_I2C_ReadAsync(REG_ADDR, rx_data, 4, on_done) :
+                          BSP_I2C_WriteAsync(REG_ADDR, tx_data, 4, on_done), BSP_ERROR_NONE);
+  stub_i2c_irq();
+  TEST_CHECK_EQUAL(callback_count, 1);
+  TEST_CHECK_EQUAL(callback_status, BSP_ERROR_BUS_FAILURE);
+  TEST_CHECK_EQUAL(stub_i2c_resets, resets);
+  check_i2c_released();
+
+  TEST_CHECK_EQUAL(BSP_I2C_ReadAsync(REG_ADDR, rx_data, 4, on_done), BSP_ERROR_NONE);
+  stub_i2c_irq();
+  TEST_CHECK_EQUAL(callback_count, 2);
+  TEST_CHECK_EQUAL(callback_status, BSP_ERROR_NONE);
+}
+
+static void test_i2c_async_faults(void)
+{
+  /* NACK: the STOP ends the transfer */
+  check_i2c_async_fault(STUB_FAULT_NACK, STUB_BYTE_ADDRESS, 0, 0);
+  check_i2c_async_fault(STUB_FAULT_NACK, 2, 0, 0);
+  check_i2c_async_fault(STUB_FAULT_NACK, 0, 1, 0);
+  /* No STOP follows: the peripheral is reset */
+  check_i2c_async_fault(STUB_FAULT_BERR, 1, 0, 1);
+  check_i2c_async_fault(STUB_FAULT_BERR, 3, 1, 1);
+  check_i2c_async_fault(STUB_FAULT_ARLO, 0, 1, 1);
+  check_i2c_async_fault(STUB_FAULT_ARLO, 4, 0, 1);
+
+  /* Stuck bus: no interrupt, the application aborts the transfer */
+  reset();
+  inject(STUB_FAULT_STUCK, 2);
+  TEST_CHECK_EQUAL(BSP_I2C_ReadAsync(REG_ADDR, rx_data, 4, on_done), BSP_ERROR_NONE);
+  stub_i2c_irq();
+  TEST_CHECK(BSP_I2C_IsBusy());
+  TEST_CHECK_EQUAL(stub_i2c_irq(), 0);
+  BSP_I2C_Abort();
+  TEST_CHECK_EQUAL(callback_count, 0);
+  TEST_CHECK_EQUAL(stub_i2c_resets, 1);
+  check_i2c_released();
+  TEST_CHECK_EQUAL(BSP_I2C_Write(NULL, REG_ADDR, tx_data, 4), BSP_ERROR_NONE);
+}
+
+static void test_spi_blocking(void)
+{
+  reset();
+  TEST_CHECK_EQUAL(BSP_SPI_Write(NULL, REG_ADDR, tx_data, 4), BSP_ERROR_NONE);
+  TEST_CHECK_EQUAL(stub_bus_bytes, 5);
+  TEST_CHECK(memcmp(&stub_spi_regs[REG_ADDR], tx_data, 4) == 0);
+  check_spi_released();
+  TEST_CHECK_EQUAL(BSP_SPI_Read(NULL, REG_ADDR + 2, rx_data, 2), BSP_ERROR_NONE);
+  TEST_CHECK(memcmp(rx_data, &tx_data[2], 2) == 0);
+  check_spi_released();
+
+  /* SCK stopped at the register address, then at a data byte */
+  inject(STUB_FAULT_STUCK, 0);
+  TEST_CHECK_EQUAL(BSP_SPI_Read(NULL, REG_ADDR, rx_data, 4), BSP_ERROR_TIMEOUT);
+  check_spi_released();
+  inject(STUB_FAULT_STUCK, 3);
+  TEST_CHECK_EQUAL(BSP_SPI_Write(NULL, REG_ADDR, tx_data, 4), BSP_ERROR_TIMEOUT);
+  TEST_CHECK_EQUAL(stub_bus_bytes, 3);
+  check_spi_released();
+
+  memset(rx_data, 0, sizeof(rx_data));
+  TEST_CHECK_EQUAL(BSP_SPI_Read(NULL, REG_ADDR, rx_data, 4), BSP_ERROR_NONE);
+  TEST_CHECK(memcmp(rx_data, tx_data, 4) == 0);
+}
+
+static void test_spi_dma(void)
+{
+  reset();
+  TEST_CHECK_EQUAL(BSP_SPI_WriteAsync(REG_ADDR, tx_data, 8, on_done), BSP_ERROR_NONE);
+  TEST_CHECK(BSP_SPI_IsBusy());
+  TEST_CHECK_EQUAL(BSP_SPI_Read(NULL, REG_ADDR, rx_data, 4), BSP_ERROR_BUSY);
+  TEST_CHECK_EQUAL(stub_dma_irq(), 1);
+  TEST_CHECK_EQUAL(callback_count, 1);
+  TEST_CHECK_EQUAL(callback_status, BSP_ERROR_NONE);
+  TEST_CHECK(memcmp(&stub_spi_regs[REG_ADDR], tx_data, 8) == 0);
+  check_spi_released();
+
+  TEST_CHECK_EQUAL(BSP_SPI_ReadAsync(REG_ADDR, rx_data, 8, on_done), BSP_ERROR_NONE);
+  TEST_CHECK_EQUAL(stub_dma_irq(), 1);
+  TEST_CHECK_EQUAL(callback_count, 2);
+  TEST_CHECK_EQUAL(callback_status, BSP_ERROR_NONE);
+  TEST_CHECK(memcmp(rx_data, tx_data, 8) == 0);
+  check_spi_released();
+  /* Flags cleared: nothing more to do */
+  TEST_CHECK_EQUAL(stub_dma_irq(), 0);
+}
+
+static void test_spi_dma_faults(void)
+{
+  /* DMA transfer error in the middle of the data */
+  reset();
+  inject(STUB_FAULT_DMA_TE, 3);
+  TEST_CHECK_EQUAL(BSP_SPI_ReadAsync(REG_ADDR, rx_data, 8, on_done), BSP_ERROR_NONE);
+  TEST_CHECK_EQUAL(stub_dma_irq(), 1);
+  TEST_CHECK_EQUAL(callback_count, 1);
+  TEST_CHECK_EQUAL(callback_status, BSP_ERROR_BUS_FAILURE);
+  check_spi_released();
+  TEST_CHECK_EQUAL(stub_dma_irq(), 0);
+
+  /* Register address not sent: the transfer is not started */
+  inject(STUB_FAULT_STUCK, 0);
+  TEST_CHECK_EQUAL(BSP_SPI_WriteAsync(REG_ADDR, tx_data, 8, on_done), BSP_ERROR_TIMEOUT);
+  TEST_CHECK_EQUAL(callback_count, 1);
+  check_spi_released();
+
+  /* Stuck during the DMA transfer: no interrupt, the application aborts it */
+  inject(STUB_FAULT_STUCK, 5);
+  TEST_CHECK_EQUAL(BSP_SPI_ReadAsync(REG_ADDR, rx_data, 8, on_done), BSP_ERROR_NONE);
+  TEST_CHECK_EQUAL(stub_dma_irq(), 0);
+  TEST_CHECK(BSP_SPI_IsBusy());
+  BSP_SPI_Abort();
+  TEST_CHECK_EQUAL(callback_count, 1);
+  check_spi_released();
+
+  TEST_CHECK_EQUAL(BSP_SPI_WriteAsync(REG_ADDR, tx_data, 8, on_done), BSP_ERROR_NONE);
+  TEST_CHECK_EQUAL(stub_dma_irq(), 1);
+  TEST_CHECK_EQUAL(callback_count, 2);
+  TEST_CHECK_EQUAL(callback_status, BSP_ERROR_NONE);
+}
+
+int main(void)
+{
+  test_i2c_blocking();
+  test_i2c_blocking_faults();
+  test_i2c_async();
+  test_i2c_async_faults();
+  test_spi_blocking();
+  test_spi_dma();
+  test_spi_dma_faults();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,193 @@
+/**
+  ******************************************************************************
+  * @file    test_com_write.c
+  * @brief   Time BSP_COM_Write() waits for the UART, on the simulated clock of
+  *          com_host_stub.c: without the UART IRQ the caller waits for each
+  *          byte, with the TX buffer it does not wait until the buffer is full.
+  *          Then it waits for the UART to make room, or the bytes are dropped
+  *          and counted if BSP_COM_TX_DROP_ON_OVERFLOW is defined (built as
+  *          test_com_write_drop).
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "test_assert.h"
+#include "com_host_stub.h"
+#include "bluenrg_lp_evb_com.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define LINE_SIZE       (64)
+#define LINE_COUNT      (20)
+#define LINE_PERIOD_NS  (10000000ULL)
+#define BURST_SIZE      (200)
+#define BURST_COUNT     (4)
+/* Bytes taken without waiting: the TX buffer, the TX FIFO and the shift register */
+#define TX_CAPACITY     ((WRITE_DATA_SIZE - 1) + STUB_TX_FIFO_SIZE + 1)
+
+typedef struct
+{
+  uint32_t calls;
+  uint64_t max_ns;
+  uint64_t total_ns;
+} blocking_t;
+
+static uint8_t data[BURST_SIZE * BURST_COUNT];
+
+static void on_rx(uint8_t *pRxDataBuff, uint16_t nDataSize)
+{
+  (void)pRxDataBuff;
+  (void)nDataSize;
+}
+
+static void reset(BSP_COM_RxDataCb_t pRxDataCb)
+{
+  stub_reset();
+  BSP_COM_Init(pRxDataCb);
+  for (uint32_t i = 0; i < sizeof(data); i++)
+  {
+    data[i] = (uint8_t)(i * 7 + 1);
+  }
+}
+
+/* Time waited in BSP_COM_Write() */
+static uint64_t timed_write(blocking_t *b, uint8_t *pBuff, uint8_t nBuffSize)
+{
+  uint64_t start = stub_time_ns, ns;
+
+  BSP_COM_Write(pBuff, nBuffSize);
+  ns = stub_time_ns - start;
+  b->calls++;
+  b->total_ns += ns;
+  if (ns > b->max_ns)
+  {
+    b->max_ns = ns;
+  }
+  return ns;
+}
+
+static void report(const char *name, const blocking_t *b)
+{
+  printf("%-36s %3u calls, max %9.1f us, mean %9.1f us\n", name, b->calls, b->max_ns / 1000.0,
+         b->calls ? b->total_ns / 1000.0 / b->calls : 0.0);
+}
+
+/* Log lines sent every LINE_PERIOD_NS */
+static void write_lines(blocking_t *b)
+{
+  for (uint32_t i = 0; i < LINE_COUNT; i++)
+  {
+    timed_write(b, &data[(i * LINE_SIZE) % (sizeof(data) - LINE_SIZE)], LINE_SIZE);
+    stub_idle(LINE_PERIOD_NS);
+  }
+}
+
+static void check_lines_sent(void)
+{
+  TEST_CHECK_EQUAL(stub_tx_count, LINE_COUNT * LINE_SIZE);
+  TEST_CHECK_EQUAL(stub_tx_overruns, 0);
+  for (uint32_t i = 0; i < LINE_COUNT; i++)
+  {
+    TEST_CHECK(memcmp(&stub_tx_data[i * LINE_SIZE], &data[(i * LINE_SIZE) % (sizeof(data) - LINE_SIZE)],
+                      LINE_SIZE) == 0);
+  }
+}
+
+/* Without the UART IRQ, the caller waits for the bytes beyond the TX FIFO */
+static void test_write_unbuffered(void)
+{
+  blocking_t b = { 0 };
+
+  reset(NULL);
+  write_lines(&b);
+  report("unbuffered, 64 byte lines", &b);
+
+  TEST_CHECK(b.max_ns >= (LINE_SIZE - STUB_TX_FIFO_SIZE - 1) * STUB_BYTE_NS);
+  TEST_CHECK(b.max_ns <= (LINE_SIZE - STUB_TX_FIFO_SIZE) * STUB_BYTE_NS);
+  check_lines_sent();
+}
+
+/* With the TX buffer, the lines are copied and sent by the UART IRQ */
+static void test_write_buffered(void)
+{
+  blocking_t b = { 0 };
+
+  reset(on_rx);
+  write_lines(&b);
+  report("buffered, 64 byte lines", &b);
+
+  TEST_CHECK(b.max_ns < STUB_BYTE_NS);
+  TEST_CHECK(stub_irq_count > 0);
+  TEST_CHECK(WRITE_BUFFER_IS_EMPTY());
+  TEST_CHECK_EQUAL(BSP_COM_GetTxDropped(), 0);
+  check_lines_sent();
+}
+
+#ifndef BSP_COM_TX_DROP_ON_OVERFLOW
+/* A burst larger than the TX buffer: the caller waits for the UART to send
+   the bytes beyond the buffer, none is lost */
+static void test_write_burst_blocks(void)
+{
+  blocking_t b = { 0 };
+  uint64_t first;
+
+  reset(on_rx);
+  first = timed_write(&b, data, BURST_SIZE);
+  for (uint32_t i = 1; i < BURST_COUNT; i++)
+  {
+    timed_write(&b, &data[i * BURST_SIZE], BURST_SIZE);
+  }
+  report("buffered, burst, block on full", &b);
+
+  TEST_CHECK(first < STUB_BYTE_NS);
+  TEST_CHECK(b.total_ns >= (sizeof(data) - TX_CAPACITY) * STUB_BYTE_NS);
+  TEST_CHECK(b.total_ns <= (sizeof(data) - TX_CAPACITY + 1) * STUB_BYTE_NS);
+
+  BSP_COM_Flush();
+  TEST_CHECK_EQUAL(BSP_COM_GetTxDropped(), 0);
+  TEST_CHECK_EQUAL(stub_tx_count, sizeof(data));
+  TEST_CHECK_EQUAL(stub_tx_overruns, 0);
+  TEST_CHECK(memcmp(stub_tx_data, data, sizeof(data)) == 0);
+}
+#else
+/* A burst larger than the TX buffer: the caller does not wait, the bytes
+   beyond the buffer are dropped and counted */
+static void test_write_burst_drops(void)
+{
+  blocking_t b = { 0 };
+
+  reset(on_rx);
+  for (uint32_t i = 0; i < BURST_COUNT; i++)
+  {
+    timed_write(&b, &data[i * BURST_SIZE], BURST_SIZE);
+  }
+  report("buffered, burst, drop on overflow", &b);
+
+  TEST_CHECK(b.max_ns < STUB_BYTE_NS);
+  TEST_CHECK_EQUAL(BSP_COM_GetTxDropped(), sizeof(data) - TX_CAPACITY);
+
+  /* The bytes taken are sent in order */
+  BSP_COM_Flush();
+  TEST_CHECK_EQUAL(stub_tx_count, TX_CAPACITY);
+  TEST_CHECK_EQUAL(stub_tx_overruns, 0);
+  TEST_CHECK(memcmp(stub_tx_data, data, TX_CAPACITY) == 0);
+
+  /* The count restarts at BSP_COM_Init() */
+  BSP_COM_Init(on_rx);
+  TEST_CHECK_EQUAL(BSP_COM_GetTxDropped(), 0);
+}
+#endif
+
+int main(void)
+{
+  /* BSP_COM_Init(NULL) keeps the TX buffer once enabled: unbuffered first */
+  test_write_unbuffered();
+  test_write_buffered();
+#ifndef BSP_COM_TX_DROP_ON_OVERFLOW
+  test_write_burst_blocks();
+#else
+  test_write_burst_drops();
+#endif
+
+  return TEST_RESULT();
+}
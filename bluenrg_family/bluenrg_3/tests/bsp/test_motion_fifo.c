@@ -0,0 +1,304 @@
+/**
+  ******************************************************************************
+  * @file    test_motion_fifo.c
+  * @brief   LSM6DSOX FIFO streaming: the FIFO is read in bursts on watermark
+  *          until it is empty, the samples are stamped with the last
+  *          timestamp word, and the overruns and SPI errors are counted.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "test_assert.h"
+#include "bsp_host_stub.h"
+#include "bluenrg_lp_evb_motion.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define WATERMARK       (30)
+#define MAX_SAMPLES     (2 * STUB_FIFO_WORDS)
+
+static BSP_MOTION_Sample_t samples[MAX_SAMPLES];
+static uint32_t sample_count;
+static uint32_t batches;
+
+/* Timestamp and sequence number of the next set of samples pushed */
+static uint32_t next_timestamp;
+static int16_t next_seq;
+
+static void on_batch(const BSP_MOTION_Sample_t *pSamples, uint16_t nSamples)
+{
+  for (uint16_t i = 0; (i < nSamples) && (sample_count < MAX_SAMPLES); i++)
+  {
+    samples[sample_count++] = pSamples[i];
+  }
+  batches++;
+}
+
+/* Timestamp word, accelerometer and gyroscope samples: 3 words per set */
+static void push_sets(uint32_t sets)
+{
+  for (uint32_t i = 0; i < sets; i++)
+  {
+    int16_t timestamp[3] = { (int16_t)(next_timestamp & 0xFFFF), (int16_t)(next_timestamp >> 16), 0 };
+    int16_t acc[3] = { next_seq, (int16_t)-next_seq, BSP_MOTION_ACC };
+    int16_t gyro[3] = { next_seq, (int16_t)-next_seq, BSP_MOTION_GYRO };
+
+    stub_fifo_push(LSM6DSOX_TIMESTAMP_TAG, timestamp);
+    stub_fifo_push(LSM6DSOX_XL_NC_TAG, acc);
+    stub_fifo_push(LSM6DSOX_GYRO_NC_TAG, gyro);
+    next_timestamp += 385;
+    next_seq++;
+  }
+}
+
+/* Main loop, EXTI and DMA interrupts until the streaming is idle */
+static void run(void)
+{
+  for (uint32_t i = 0; i < 1000; i++)
+  {
+    stub_exti_irq();
+    BSP_MOTION_Tick();
+    if (stub_spi_busy())
+    {
+      stub_spi_complete(BSP_ERROR_NONE);
+    }
+    else if (!BSP_MOTION_IsBusy())
+    {
+      return;
+    }
+  }
+  TEST_CHECK(0);
+}
+
+/* Samples pushed with the sequence numbers first..first+count-1 */
+static void check_samples(uint32_t from, int16_t first, uint32_t sets)
+{
+  TEST_CHECK(from + 2 * sets <= sample_count);
+  for (uint32_t i = 0; i < 2 * sets; i++)
+  {
+    const BSP_MOTION_Sample_t *s = &samples[from + i];
+    int16_t seq = (int16_t)(first + i / 2);
+
+    TEST_CHECK_EQUAL(s->sensor, (i % 2) ? BSP_MOTION_GYRO : BSP_MOTION_ACC);
+    TEST_CHECK_EQUAL(s->data[0], seq);
+    TEST_CHECK_EQUAL(s->data[1], -seq);
+    TEST_CHECK_EQUAL(s->data[2], s->sensor);
+    TEST_CHECK_EQUAL(s->timestamp, (uint32_t)seq * 385);
+  }
+}
+
+static int32_t start(void)
+{
+  BSP_MOTION_Config_t config = {
+    LSM6DSOX_XL_ODR_104Hz, LSM6DSOX_XL_BATCHED_AT_104Hz,
+    LSM6DSOX_GY_ODR_104Hz, LSM6DSOX_GY_BATCHED_AT_104Hz,
+    WATERMARK, on_batch
+  };
+
+  return BSP_MOTION_Start(&config);
+}
+
+static void reset(void)
+{
+  BSP_MOTION_Stop();
+  stub_reset();
+  memset(&motionStats, 0, sizeof(motionStats));
+  sample_count = 0;
+  batches = 0;
+  next_timestamp = 0;
+  next_seq = 0;
+  TEST_CHECK_EQUAL(start(), BSP_ERROR_NONE);
+}
+
+/* Stream mode, watermark routed to INT1 */
+static void test_start(void)
+{
+  BSP_MOTION_Config_t config = { LSM6DSOX_XL_ODR_104Hz, LSM6DSOX_XL_BATCHED_AT_104Hz,
+                                 LSM6DSOX_GY_ODR_104Hz, LSM6DSOX_GY_BATCHED_AT_104Hz, 0, on_batch };
+
+  reset();
+  TEST_CHECK_EQUAL(stub_regs[LSM6DSOX_FIFO_CTRL1], WATERMARK);
+  TEST_CHECK_EQUAL(stub_regs[LSM6DSOX_FIFO_CTRL2] & 0x01, 0);
+  TEST_CHECK_EQUAL(stub_regs[LSM6DSOX_FIFO_CTRL4] & 0x07, LSM6DSOX_STREAM_MODE);
+  TEST_CHECK(stub_regs[LSM6DSOX_INT1_CTRL] & 0x08);
+  TEST_CHECK(SYSCFG->IO_IER & BSP_SENSOR1_INT_EXTI_LINE);
+  TEST_CHECK_EQUAL(start(), BSP_ERROR_BUSY);
+
+  TEST_CHECK_EQUAL(BSP_MOTION_Stop(), BSP_ERROR_NONE);
+  TEST_CHECK_EQUAL(stub_regs[LSM6DSOX_INT1_CTRL] & 0x08, 0);
+  TEST_CHECK_EQUAL(stub_regs[LSM6DSOX_FIFO_CTRL4] & 0x07, LSM6DSOX_BYPASS_MODE);
+  TEST_CHECK_EQUAL(SYSCFG->IO_IER & BSP_SENSOR1_INT_EXTI_LINE, 0);
+
+  TEST_CHECK_EQUAL(BSP_MOTION_Start(&config), BSP_ERROR_WRONG_PARAM);
+  config.watermark = 512;
+  TEST_CHECK_EQUAL(BSP_MOTION_Start(&config), BSP_ERROR_WRONG_PARAM);
+  stub_regs[LSM6DSOX_WHO_AM_I] = 0;
+  TEST_CHECK_EQUAL(start(), BSP_ERROR_COMPONENT_FAILURE);
+  TEST_CHECK(!BSP_MOTION_IsBusy());
+}
+
+/* Nothing is read below the watermark; at the watermark the FIFO is read in a single burst */
+static void test_watermark(void)
+{
+  BSP_MOTION_Stats_t stats;
+
+  reset();
+  push_sets(WATERMARK / 3 - 1);
+  TEST_CHECK(!stub_int1());
+  TEST_CHECK(!stub_exti_irq());
+  TEST_CHECK(!BSP_MOTION_IsBusy());
+  BSP_MOTION_Tick();
+  TEST_CHECK_EQUAL(stub_spi_reads, 0);
+
+  push_sets(1);
+  TEST_CHECK(stub_int1());
+  TEST_CHECK(stub_exti_irq());
+  TEST_CHECK(BSP_MOTION_IsBusy());
+
+  BSP_MOTION_Tick();
+  TEST_CHECK_EQUAL(stub_spi_reads, 1);
+  TEST_CHECK_EQUAL(stub_spi_words, WATERMARK);
+  TEST_CHECK_EQUAL(stub_fifo_level(), 0);
+  TEST_CHECK(!stub_int1());
+  /* Busy until the burst is decoded */
+  stub_spi_complete(BSP_ERROR_NONE);
+  TEST_CHECK(BSP_MOTION_IsBusy());
+  TEST_CHECK_EQUAL(sample_count, 0);
+  BSP_MOTION_Tick();
+  TEST_CHECK(!BSP_MOTION_IsBusy());
+
+  TEST_CHECK_EQUAL(batches, 1);
+  TEST_CHECK_EQUAL(sample_count, 2 * WATERMARK / 3);
+  check_samples(0, 0, WATERMARK / 3);
+  BSP_MOTION_GetStats(&stats);
+  TEST_CHECK_EQUAL(stats.samples, 2 * WATERMARK / 3);
+  TEST_CHECK_EQUAL(stats.bursts, 1);
+  TEST_CHECK_EQUAL(stats.overruns, 0);
+  TEST_CHECK_EQUAL(stats.errors, 0);
+
+  /* The FIFO is empty: the next watermark raises a new edge */
+  push_sets(WATERMARK / 3);
+  TEST_CHECK(stub_exti_irq());
+  run();
+  TEST_CHECK_EQUAL(sample_count, 4 * WATERMARK / 3);
+  check_samples(0, 0, 2 * WATERMARK / 3);
+}
+
+/* More words than a burst: the FIFO is drained by consecutive bursts after a single edge */
+static void test_drain(void)
+{
+  uint32_t sets = (3 * BSP_MOTION_BURST_WORDS + 10) / 3;
+
+  reset();
+  push_sets(sets);
+  run();
+  TEST_CHECK_EQUAL(stub_fifo_level(), 0);
+  TEST_CHECK(!stub_int1());
+  TEST_CHECK_EQUAL(stub_spi_reads, (3 * sets + BSP_MOTION_BURST_WORDS - 1) / BSP_MOTION_BURST_WORDS);
+  TEST_CHECK_EQUAL(sample_count, 2 * sets);
+  check_samples(0, 0, sets);
+
+  /* Words batched while a burst is ongoing: below the watermark they wait for the next edge */
+  push_sets(WATERMARK / 3);
+  TEST_CHECK(stub_exti_irq());
+  BSP_MOTION_Tick();
+  TEST_CHECK(stub_spi_busy());
+  push_sets(WATERMARK / 3 - 1);
+  stub_spi_complete(BSP_ERROR_NONE);
+  run();
+  TEST_CHECK_EQUAL(stub_fifo_level(), WATERMARK - 3);
+  TEST_CHECK_EQUAL(sample_count, 2 * (sets + WATERMARK / 3));
+
+  push_sets(1);
+  TEST_CHECK(stub_exti_irq());
+  run();
+  TEST_CHECK_EQUAL(stub_fifo_level(), 0);
+  TEST_CHECK_EQUAL(sample_count, 2 * (sets + 2 * (WATERMARK / 3)));
+  check_samples(0, 0, sets + 2 * (WATERMARK / 3));
+}
+
+/* FIFO overrun: the oldest words are lost, the overrun is counted once */
+static void test_overrun(void)
+{
+  BSP_MOTION_Stats_t stats;
+  uint32_t full_sets = STUB_FIFO_WORDS / 3;
+  uint32_t sets = full_sets + 20;
+
+  reset();
+  push_sets(sets);
+  TEST_CHECK_EQUAL(stub_fifo_level(), STUB_FIFO_WORDS);
+  run();
+
+  BSP_MOTION_GetStats(&stats);
+  TEST_CHECK_EQUAL(stats.overruns, 1);
+  TEST_CHECK_EQUAL(stats.errors, 0);
+  TEST_CHECK_EQUAL(stats.samples, sample_count);
+  /* The FIFO holds the newest words: the end of a set whose timestamp is lost, then whole sets */
+  TEST_CHECK_EQUAL(sample_count, 2 * full_sets + (STUB_FIFO_WORDS % 3));
+  TEST_CHECK_EQUAL(samples[0].data[0], (int16_t)(sets - full_sets - 1));
+  check_samples(sample_count - 2 * full_sets, (int16_t)(sets - full_sets), full_sets);
+
+  /* Latched flag cleared by the read: no more overruns */
+  sample_count = 0;
+  push_sets(WATERMARK / 3);
+  run();
+  BSP_MOTION_GetStats(&stats);
+  TEST_CHECK_EQUAL(stats.overruns, 1);
+  TEST_CHECK_EQUAL(sample_count, 2 * WATERMARK / 3);
+  check_samples(0, (int16_t)sets, WATERMARK / 3);
+}
+
+/* A failed burst is counted and its words are dropped; the streaming goes on */
+static void test_spi_error(void)
+{
+  BSP_MOTION_Stats_t stats;
+
+  reset();
+  push_sets(WATERMARK / 3);
+  TEST_CHECK(stub_exti_irq());
+  BSP_MOTION_Tick();
+  stub_spi_complete(BSP_ERROR_BUS_FAILURE);
+  BSP_MOTION_Tick();
+  TEST_CHECK(!BSP_MOTION_IsBusy());
+  TEST_CHECK_EQUAL(batches, 0);
+  BSP_MOTION_GetStats(&stats);
+  TEST_CHECK_EQUAL(stats.errors, 1);
+  TEST_CHECK_EQUAL(stats.bursts, 0);
+
+  push_sets(WATERMARK / 3);
+  run();
+  TEST_CHECK_EQUAL(sample_count, 2 * WATERMARK / 3);
+  check_samples(0, WATERMARK / 3, WATERMARK / 3);
+}
+
+/* Stopped during a burst: the transfer is aborted and the watermark is ignored */
+static void test_stop(void)
+{
+  reset();
+  push_sets(WATERMARK / 3);
+  TEST_CHECK(stub_exti_irq());
+  BSP_MOTION_Tick();
+  TEST_CHECK(stub_spi_busy());
+
+  TEST_CHECK_EQUAL(BSP_MOTION_Stop(), BSP_ERROR_NONE);
+  TEST_CHECK(!stub_spi_busy());
+  TEST_CHECK(!BSP_MOTION_IsBusy());
+  push_sets(WATERMARK / 3);
+  TEST_CHECK_EQUAL(stub_fifo_level(), 0);
+  TEST_CHECK(!stub_exti_irq());
+  BSP_MOTION_Tick();
+  TEST_CHECK_EQUAL(stub_spi_reads, 1);
+  TEST_CHECK_EQUAL(batches, 0);
+}
+
+int main(void)
+{
+  test_start();
+  test_watermark();
+  test_drain();
+  test_overrun();
+  test_spi_error();
+  test_stop();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,45 @@
+/**
+  ******************************************************************************
+  * @file    cmsis_host.h
+  * @brief   Host replacement of the CMSIS compiler intrinsics, force included
+  *          in the host tests so that the device headers can be used.
+  ******************************************************************************
+  */
+
+#ifndef CMSIS_HOST_H
+#define CMSIS_HOST_H
+
+/* Prevent the inclusion of the Cortex-M intrinsics */
+#define __CMSIS_GCC_H
+
+#include <stdint.h>
+
+#define __ASM                   __asm
+#define __INLINE                inline
+#define __STATIC_INLINE         static inline
+#define __STATIC_FORCEINLINE    static inline
+#define __NO_RETURN             __attribute__((__noreturn__))
+#define __USED                  __attribute__((used))
+#define __WEAK                  __attribute__((weak))
+#define __PACKED                __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT         struct __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)            __attribute__((aligned(x)))
+#define __RESTRICT              __restrict
+#define __COMPILER_BARRIER()    __asm volatile("":::"memory")
+
+#define __NOP()                 do {} while(0)
+#define __WFI()                 do {} while(0)
+
+static inline void __DSB(void) {}
+static inline void __ISB(void) {}
+static inline void __DMB(void) {}
+static inline uint32_t __REV(uint32_t value) { return __builtin_bswap32(value); }
+
+/* The interrupt mask is only recorded: the tests are single threaded */
+extern uint32_t host_primask;
+static inline uint32_t __get_PRIMASK(void) { return host_primask; }
+static inline void __set_PRIMASK(uint32_t priMask) { host_primask = priMask; }
+static inline void __disable_irq(void) { host_primask = 1; }
+static inline void __enable_irq(void) { host_primask = 0; }
+
+#endif /* CMSIS_HOST_H */
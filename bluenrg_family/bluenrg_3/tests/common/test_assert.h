@@ -0,0 +1,42 @@
+/**
+  ******************************************************************************
+  * @file    test_assert.h
+  * @brief   Minimal checks shared by the host tests: a failed check is printed
+  *          and makes the test return a non zero status.
+  ******************************************************************************
+  */
+
+#ifndef TEST_ASSERT_H
+#define TEST_ASSERT_H
+
+#include <stdio.h>
+
+extern unsigned int test_failures;
+
+#define TEST_CHECK(cond)                                                        \
+  do {                                                                          \
+    if(!(cond)) {                                                               \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);          \
+      test_failures++;                                                          \
+    }                                                                           \
+  } while(0)
+
+#define TEST_CHECK_EQUAL(actual, expected)                                      \
+  do {                                                                          \
+    long long _a = (long long)(actual), _e = (long long)(expected);             \
+    if(_a != _e) {                                                              \
+      printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__,          \
+             #actual, _a, _e);                                                  \
+      test_failures++;                                                          \
+    }                                                                           \
+  } while(0)
+
+/* Defines the failure counter and the primask used by cmsis_host.h */
+#define TEST_MAIN_DEFINITIONS                                                   \
+  unsigned int test_failures;                                                   \
+  uint32_t host_primask
+
+#define TEST_RESULT()                                                           \
+  (printf("%s: %u failure(s)\n", __FILE__, test_failures), test_failures != 0)
+
+#endif /* TEST_ASSERT_H */
@@ -0,0 +1,96 @@
+/**
+  ******************************************************************************
+  * @file    crc_host_stub.c
+  * @brief   Strong definitions of the private functions of the CRC manager,
+  *          replacing the CRC peripheral and its DMA channel.
+  ******************************************************************************
+  */
+
+#include "crc_host_stub.h"
+#include "crc_manager.h"
+
+uint8_t stub_crc_hw;
+uint32_t stub_dma_chunk;
+uint32_t stub_dma_error_after;
+uint8_t stub_dma_spurious;
+uint32_t stub_hw_computes;
+uint32_t stub_dma_starts;
+uint32_t stub_dma_stops;
+uint8_t stub_dma_busy;
+
+static uint32_t dma_crc;
+static uint32_t dma_done;
+
+void stub_reset(void)
+{
+  stub_crc_hw = 1;
+  stub_dma_chunk = 0;
+  stub_dma_error_after = 0xFFFFFFFFU;
+  stub_dma_spurious = 0;
+  stub_hw_computes = 0;
+  stub_dma_starts = 0;
+  stub_dma_stops = 0;
+  stub_dma_busy = 0;
+  dma_done = 0;
+}
+
+uint32_t stub_crc32_bitwise(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+  for (uint32_t i = 0; i < size; i++)
+  {
+    crc ^= (uint32_t)data[i] << 24;
+    for (uint32_t bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x80000000U) ? ((crc << 1) ^ CRCMGR_CRC32_POLY) : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+uint8_t CRCMGR_PrivateCompute(uint32_t *crc, const uint8_t *data, uint32_t size)
+{
+  if (!stub_crc_hw)
+    return 0;
+
+  stub_hw_computes++;
+  *crc = stub_crc32_bitwise(*crc, data, size);
+  return 1;
+}
+
+uint32_t CRCMGR_PrivateDmaStart(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+  if (!stub_crc_hw || (stub_dma_chunk == 0))
+    return 0;
+
+  if (size > stub_dma_chunk)
+  {
+    size = stub_dma_chunk;
+  }
+  dma_crc = stub_crc32_bitwise(crc, data, size);
+  stub_dma_starts++;
+  stub_dma_busy = 1;
+  return size;
+}
+
+uint8_t CRCMGR_PrivateDmaDone(uint32_t *crc)
+{
+  if (stub_dma_spurious)
+  {
+    stub_dma_spurious = 0;
+    return CRCMGR_DMA_PENDING;
+  }
+
+  stub_dma_busy = 0;
+  if (dma_done == stub_dma_error_after)
+    return CRCMGR_DMA_ERROR;
+
+  dma_done++;
+  *crc = dma_crc;
+  return CRCMGR_DMA_DONE;
+}
+
+void CRCMGR_PrivateDmaStop(void)
+{
+  stub_dma_stops++;
+  stub_dma_busy = 0;
+}
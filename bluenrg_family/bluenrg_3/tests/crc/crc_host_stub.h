@@ -0,0 +1,35 @@
+/**
+  ******************************************************************************
+  * @file    crc_host_stub.h
+  * @brief   CRC peripheral and DMA channel used by the CRC manager: the CRC-32
+  *          is computed bit by bit, the DMA transfers are completed by the
+  *          test calling CRCMGR_DMA_IRQHandler().
+  ******************************************************************************
+  */
+
+#ifndef CRC_HOST_STUB_H
+#define CRC_HOST_STUB_H
+
+#include <stdint.h>
+
+/* CRC peripheral available */
+extern uint8_t stub_crc_hw;
+/* Bytes fed by each DMA transfer, 0 if there is no DMA */
+extern uint32_t stub_dma_chunk;
+/* Transfers completed before a transfer error */
+extern uint32_t stub_dma_error_after;
+/* The next DMA interrupt does not complete the transfer */
+extern uint8_t stub_dma_spurious;
+
+/* Calls of the private functions */
+extern uint32_t stub_hw_computes;
+extern uint32_t stub_dma_starts;
+extern uint32_t stub_dma_stops;
+extern uint8_t stub_dma_busy;
+
+void stub_reset(void);
+
+/* Reference CRC-32/MPEG-2, one bit at a time */
+uint32_t stub_crc32_bitwise(uint32_t crc, const uint8_t *data, uint32_t size);
+
+#endif /* CRC_HOST_STUB_H */
@@ -0,0 +1,318 @@
+/**
+  ******************************************************************************
+  * @file    test_crc_vectors.c
+  * @brief   CRC manager: CRC-32/MPEG-2 check vectors, software table against a
+  *          bitwise reference, streaming contexts split at random points and
+  *          asynchronous updates completed by DMA, with transfer errors and
+  *          aborts, and the throughput of the table against the bitwise loop.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "test_assert.h"
+#include "crc_host_stub.h"
+#include "crc_manager.h"
+
+TEST_MAIN_DEFINITIONS;
+
+#define BUFFER_SIZE     (4096)
+#define THROUGHPUT_RUNS (64)
+
+static uint8_t buffer[BUFFER_SIZE + 4];
+static uint32_t callbacks;
+static CRCMGR_Context *callback_ctx;
+
+static void on_done(CRCMGR_Context *ctx)
+{
+  callbacks++;
+  callback_ctx = ctx;
+}
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Runs the DMA interrupt until the update is completed */
+static uint32_t run_irqs(CRCMGR_Context *ctx)
+{
+  uint32_t irqs = 0;
+
+  while (CRCMGR_IsPending(ctx) && (irqs < 1000))
+  {
+    CRCMGR_DMA_IRQHandler();
+    irqs++;
+  }
+  return irqs;
+}
+
+/* Published check values of CRC-32/MPEG-2 */
+static void test_vectors(void)
+{
+  static const struct
+  {
+    const char *data;
+    uint32_t crc;
+  } vectors[] = {
+    { "", 0xFFFFFFFFU },
+    { "a", 0xE66C6494U },
+    { "abc", 0x9B73448CU },
+    { "123456789", 0x0376E6E7U },
+    { "The quick brown fox jumps over the lazy dog", 0xBA62119EU },
+  };
+  uint8_t data[256];
+
+  stub_reset();
+  for (uint32_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+  {
+    uint32_t size = (uint32_t)strlen(vectors[i].data);
+
+    TEST_CHECK_EQUAL(CRCMGR_Crc32Sw(CRCMGR_CRC32_INIT, vectors[i].data, size), vectors[i].crc);
+    TEST_CHECK_EQUAL(stub_crc32_bitwise(CRCMGR_CRC32_INIT, (const uint8_t *)vectors[i].data, size), vectors[i].crc);
+  }
+
+  memset(data, 0x00, 32);
+  TEST_CHECK_EQUAL(CRCMGR_Crc32Sw(CRCMGR_CRC32_INIT, data, 32), 0x4A55AF67U);
+  memset(data, 0xFF, 32);
+  TEST_CHECK_EQUAL(CRCMGR_Crc32Sw(CRCMGR_CRC32_INIT, data, 32), 0x2F2AC900U);
+  for (uint32_t i = 0; i < sizeof(data); i++)
+  {
+    data[i] = (uint8_t)i;
+  }
+  TEST_CHECK_EQUAL(CRCMGR_Crc32Sw(CRCMGR_CRC32_INIT, data, sizeof(data)), 0x494A116AU);
+
+  /* Same result with and without the CRC peripheral */
+  TEST_CHECK_EQUAL(CRCMGR_Crc32(CRCMGR_CRC32_INIT, "123456789", 9), 0x0376E6E7U);
+  TEST_CHECK_EQUAL(stub_hw_computes, 1);
+  stub_crc_hw = 0;
+  TEST_CHECK_EQUAL(CRCMGR_Crc32(CRCMGR_CRC32_INIT, "123456789", 9), 0x0376E6E7U);
+  TEST_CHECK_EQUAL(stub_hw_computes, 1);
+}
+
+/* The table driven CRC-32 matches the bitwise reference at any length and
+   alignment, and it can be chained */
+static void test_random(void)
+{
+  stub_reset();
+  for (uint32_t n = 0; n < 500; n++)
+  {
+    uint32_t offset = rand() % 4;
+    uint32_t size = rand() % 1024;
+    uint32_t split = size ? rand() % size : 0;
+    const uint8_t *data = &buffer[offset];
+    uint32_t crc = stub_crc32_bitwise(CRCMGR_CRC32_INIT, data, size);
+
+    TEST_CHECK_EQUAL(CRCMGR_Crc32Sw(CRCMGR_CRC32_INIT, data, size), crc);
+    TEST_CHECK_EQUAL(CRCMGR_Crc32Sw(CRCMGR_Crc32Sw(CRCMGR_CRC32_INIT, data, split), data + split, size - split), crc);
+    TEST_CHECK_EQUAL(CRCMGR_Crc32(CRCMGR_CRC32_INIT, data, size), crc);
+  }
+}
+
+/* A streaming context split at random points gives the CRC-32 of the whole buffer */
+static void test_stream(void)
+{
+  CRCMGR_Context ctx;
+  uint32_t crc = 0;
+
+  stub_reset();
+  for (uint32_t n = 0; n < 50; n++)
+  {
+    uint32_t done = 0;
+
+    CRCMGR_Start(&ctx);
+    TEST_CHECK(!CRCMGR_IsPending(&ctx));
+    while (done < BUFFER_SIZE)
+    {
+      uint32_t size = rand() % 300;
+
+      if (size > BUFFER_SIZE - done)
+      {
+        size = BUFFER_SIZE - done;
+      }
+      TEST_CHECK_EQUAL(CRCMGR_Update(&ctx, &buffer[done], size), CRCMGR_SUCCESS);
+      done += size;
+    }
+    TEST_CHECK_EQUAL(CRCMGR_Finish(&ctx, &crc), CRCMGR_SUCCESS);
+    TEST_CHECK_EQUAL(crc, stub_crc32_bitwise(CRCMGR_CRC32_INIT, buffer, BUFFER_SIZE));
+    TEST_CHECK_EQUAL(ctx.length, BUFFER_SIZE);
+  }
+
+  /* Empty context */
+  CRCMGR_Start(&ctx);
+  TEST_CHECK_EQUAL(CRCMGR_Finish(&ctx, &crc), CRCMGR_SUCCESS);
+  TEST_CHECK_EQUAL(crc, CRCMGR_CRC32_INIT);
+}
+
+/* Asynchronous updates: fed by DMA from the threshold, processed before returning otherwise */
+static void test_async(void)
+{
+  CRCMGR_Context ctx, other;
+  uint32_t crc = 0;
+  uint32_t expected;
+
+  stub_reset();
+  stub_dma_chunk = 1000;
+  callbacks = 0;
+
+  /* Below the threshold: no DMA, the callback is called before returning */
+  CRCMGR_Start(&ctx);
+  TEST_CHECK_EQUAL(CRCMGR_UpdateAsync(&ctx, buffer, CRCMGR_DMA_THRESHOLD - 1, on_done), CRCMGR_SUCCESS);
+  TEST_CHECK_EQUAL(stub_dma_starts, 0);
+  TEST_CHECK_EQUAL(callbacks, 1);
+  TEST_CHECK(!CRCMGR_IsPending(&ctx));
+
+  /* Then 4 DMA transfers */
+  TEST_CHECK_EQUAL(CRCMGR_UpdateAsync(&ctx, &buffer[CRCMGR_DMA_THRESHOLD - 1], 3500, on_done), CRCMGR_SUCCESS);
+  TEST_CHECK_EQUAL(stub_dma_starts, 1);
+  TEST_CHECK(CRCMGR_IsPending(&ctx));
+  TEST_CHECK_EQUAL(callbacks, 1);
+
+  /* The context and the CRC peripheral are in use */
+  TEST_CHECK_EQUAL(CRCMGR_Update(&ctx, buffer, 1), CRCMGR_ERROR_BUSY);
+  TEST_CHECK_EQUAL(CRCMGR_UpdateAsync(&ctx, buffer, 1, on_done), CRCMGR_ERROR_BUSY);
+  TEST_CHECK_EQUAL(CRCMGR_Finish(&ctx, &crc), CRCMGR_ERROR_BUSY);
+  CRCMGR_Start(&other);
+  TEST_CHECK_EQUAL(CRCMGR_UpdateAsync(&other, buffer, CRCMGR_DMA_THRESHOLD, NULL), CRCMGR_ERROR_BUSY);
+  TEST_CHECK_EQUAL(CRCMGR_UpdateAsync(&other, buffer, 100, NULL), CRCMGR_SUCCESS);
+  TEST_CHECK_EQUAL(CRCMGR_Crc32(CRCMGR_CRC32_INIT, buffer, 100), stub_crc32_bitwise(CRCMGR_CRC32_INIT, buffer, 100));
+  TEST_CHECK_EQUAL(stub_hw_computes, 1);
+  TEST_CHECK_EQUAL(other.crc, stub_crc32_bitwise(CRCMGR_CRC32_INIT, buffer, 100));
+
+  /* An interrupt of another DMA channel does not complete the transfer */
+  stub_dma_spurious = 1;
+  CRCMGR_DMA_IRQHandler();
+  TEST_CHECK(CRCMGR_IsPending(&ctx));
+  TEST_CHECK_EQUAL(stub_dma_starts, 1);
+
+  TEST_CHECK_EQUAL(run_irqs(&ctx), 4);
+  TEST_CHECK_EQUAL(stub_dma_starts, 4);
+  TEST_CHECK_EQUAL(callbacks, 2);
+  TEST_CHECK(callback_ctx == &ctx);
+  TEST_CHECK_EQUAL(CRCMGR_Finish(&ctx, &crc), CRCMGR_SUCCESS);
+  expected = stub_crc32_bitwise(CRCMGR_CRC32_INIT, buffer, CRCMGR_DMA_THRESHOLD - 1 + 3500);
+  TEST_CHECK_EQUAL(crc, expected);
+  TEST_CHECK_EQUAL(ctx.length, CRCMGR_DMA_THRESHOLD - 1 + 3500);
+
+  /* CRC peripheral released */
+  TEST_CHECK_EQUAL(CRCMGR_Crc32(CRCMGR_CRC32_INIT, buffer, 100), stub_crc32_bitwise(CRCMGR_CRC32_INIT, buffer, 100));
+  TEST_CHECK_EQUAL(stub_hw_computes, 2);
+
+  /* No DMA: all the data are processed before returning */
+  stub_dma_chunk = 0;
+  CRCMGR_Start(&ctx);
+  TEST_CHECK_EQUAL(CRCMGR_UpdateAsync(&ctx, buffer, BUFFER_SIZE, NULL), CRCMGR_SUCCESS);
+  TEST_CHECK(!CRCMGR_IsPending(&ctx));
+  TEST_CHECK_EQUAL(CRCMGR_Finish(&ctx, &crc), CRCMGR_SUCCESS);
+  TEST_CHECK_EQUAL(crc, stub_crc32_bitwise(CRCMGR_CRC32_INIT, buffer, BUFFER_SIZE));
+}
+
+/* A transfer error: the rest of the data is processed by software */
+static void test_dma_error(void)
+{
+  CRCMGR_Context ctx;
+  uint32_t crc = 0;
+
+  stub_reset();
+  stub_dma_chunk = 512;
+  stub_dma_error_after = 2;
+  callbacks = 0;
+
+  CRCMGR_Start(&ctx);
+  TEST_CHECK_EQUAL(CRCMGR_UpdateAsync(&ctx, buffer, BUFFER_SIZE, on_done), CRCMGR_SUCCESS);
+  TEST_CHECK_EQUAL(run_irqs(&ctx), 3);
+  TEST_CHECK_EQUAL(stub_dma_starts, 3);
+  TEST_CHECK_EQUAL(callbacks, 1);
+  TEST_CHECK_EQUAL(CRCMGR_Finish(&ctx, &crc), CRCMGR_SUCCESS);
+  TEST_CHECK_EQUAL(crc, stub_crc32_bitwise(CRCMGR_CRC32_INIT, buffer, BUFFER_SIZE));
+  TEST_CHECK_EQUAL(ctx.length, BUFFER_SIZE);
+  TEST_CHECK(!stub_dma_busy);
+}
+
+/* An abort keeps the CRC-32 of the transfers completed before it */
+static void test_abort(void)
+{
+  CRCMGR_Context ctx;
+  uint32_t crc = 0;
+
+  stub_reset();
+  stub_dma_chunk = 1024;
+  callbacks = 0;
+
+  /* Nothing to abort */
+  CRCMGR_Abort();
+  TEST_CHECK_EQUAL(stub_dma_stops, 0);
+
+  CRCMGR_Start(&ctx);
+  TEST_CHECK_EQUAL(CRCMGR_UpdateAsync(&ctx, buffer, BUFFER_SIZE, on_done), CRCMGR_SUCCESS);
+  CRCMGR_DMA_IRQHandler();
+  TEST_CHECK(CRCMGR_IsPending(&ctx));
+  CRCMGR_Abort();
+  TEST_CHECK_EQUAL(stub_dma_stops, 1);
+  TEST_CHECK(!stub_dma_busy);
+  TEST_CHECK(!CRCMGR_IsPending(&ctx));
+  TEST_CHECK_EQUAL(callbacks, 0);
+  TEST_CHECK_EQUAL(ctx.length, 1024);
+  TEST_CHECK_EQUAL(CRCMGR_Finish(&ctx, &crc), CRCMGR_SUCCESS);
+  TEST_CHECK_EQUAL(crc, stub_crc32_bitwise(CRCMGR_CRC32_INIT, buffer, 1024));
+
+  /* A late interrupt is ignored, the context goes on from the abort */
+  CRCMGR_DMA_IRQHandler();
+  TEST_CHECK_EQUAL(ctx.length, 1024);
+  TEST_CHECK_EQUAL(CRCMGR_Update(&ctx, &buffer[1024], BUFFER_SIZE - 1024), CRCMGR_SUCCESS);
+  TEST_CHECK_EQUAL(stub_hw_computes, 1);
+  TEST_CHECK_EQUAL(CRCMGR_Finish(&ctx, &crc), CRCMGR_SUCCESS);
+  TEST_CHECK_EQUAL(crc, stub_crc32_bitwise(CRCMGR_CRC32_INIT, buffer, BUFFER_SIZE));
+}
+
+/* The table driven CRCMGR_Crc32Sw() against the bitwise loop on the same data */
+static void test_throughput(void)
+{
+  uint32_t table_crc = CRCMGR_CRC32_INIT, bitwise_crc = CRCMGR_CRC32_INIT;
+  uint64_t start, table_ns, bitwise_ns;
+  double size = (double)BUFFER_SIZE * THROUGHPUT_RUNS;
+
+  start = now_ns();
+  for (uint32_t i = 0; i < THROUGHPUT_RUNS; i++)
+  {
+    table_crc = CRCMGR_Crc32Sw(table_crc, buffer, BUFFER_SIZE);
+  }
+  table_ns = now_ns() - start;
+
+  start = now_ns();
+  for (uint32_t i = 0; i < THROUGHPUT_RUNS; i++)
+  {
+    bitwise_crc = stub_crc32_bitwise(bitwise_crc, buffer, BUFFER_SIZE);
+  }
+  bitwise_ns = now_ns() - start;
+
+  printf("CRC-32 of %u KB: table %.1f MB/s, bitwise %.1f MB/s (x%.1f)\n", (BUFFER_SIZE * THROUGHPUT_RUNS) / 1024U,
+         size * 1000.0 / (double)table_ns, size * 1000.0 / (double)bitwise_ns, (double)bitwise_ns / (double)table_ns);
+
+  TEST_CHECK_EQUAL(table_crc, bitwise_crc);
+  /* A table lookup per byte against eight shifts per byte */
+  TEST_CHECK(table_ns < bitwise_ns);
+}
+
+int main(void)
+{
+  srand(5);
+  for (uint32_t i = 0; i < sizeof(buffer); i++)
+  {
+    buffer[i] = (uint8_t)rand();
+  }
+
+  test_vectors();
+  test_random();
+  test_stream();
+  test_async();
+  test_dma_error();
+  test_abort();
+  test_throughput();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,546 @@
+/**
+  ******************************************************************************
+  * @file    dtm_host_stub.c
+  * @brief   Scripted BLE stack and host transport of the DTM HCI glue. The
+  *          commands framed by hci_parser.c are run at once, as the command
+  *          FIFO of transport_layer.c does from its tick, and the events are
+  *          recorded and optionally written to a file descriptor.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include <unistd.h>
+#include "ble_const.h"
+#include "bluenrg_lp_api.h"
+#include "bluenrg_lp_events.h"
+#include "hci_parser.h"
+#include "cmd.h"
+#include "osal.h"
+#include "miscutil.h"
+#include "DTM_cmd_db.h"
+#include "aci_adv_nwk.h"
+#include "adv_buff_alloc_tiny.h"
+#include "dtm_host_stub.h"
+
+stub_event_t stub_events[STUB_MAX_EVENTS];
+uint32_t stub_event_count;
+uint64_t stub_event_bytes;
+int stub_event_fd = -1;
+
+tBleStatus stub_stack_status;
+uint32_t stub_stack_calls;
+
+stub_acl_t stub_acl;
+
+uint8_t stub_adv_data_len;
+uint8_t stub_adv_data[31];
+uint8_t stub_encrypt_key[16];
+
+uint32_t stub_vendor_count;
+uint32_t stub_adv_buff_freed;
+
+static uint8_t rand_counter;
+
+void stub_reset(void)
+{
+  stub_event_count = 0;
+  stub_event_bytes = 0;
+  stub_event_fd = -1;
+  stub_stack_status = BLE_STATUS_SUCCESS;
+  stub_stack_calls = 0;
+  memset(&stub_acl, 0, sizeof(stub_acl));
+  stub_adv_data_len = 0;
+  stub_vendor_count = 0;
+  stub_adv_buff_freed = 0;
+  rand_counter = 0;
+}
+
+const stub_event_t *stub_get_event(uint32_t n)
+{
+  return &stub_events[n % STUB_MAX_EVENTS];
+}
+
+static tBleStatus stub_call(void)
+{
+  stub_stack_calls++;
+  return stub_stack_status;
+}
+
+/* Transport ------------------------------------------------------------------*/
+
+void Osal_MemCpy(void *dest, const void *src, unsigned int size)
+{
+  memcpy(dest, src, size);
+}
+
+void send_event(uint8_t *buffer_out, uint16_t buffer_out_length, int8_t overflow_index)
+{
+  stub_event_t *e = &stub_events[stub_event_count % STUB_MAX_EVENTS];
+
+  if(buffer_out_length == 0)
+  {
+    return;
+  }
+  e->len = buffer_out_length;
+  e->overflow_index = overflow_index;
+  memcpy(e->data, buffer_out, (buffer_out_length < STUB_EVENT_SIZE) ? buffer_out_length : STUB_EVENT_SIZE);
+  stub_event_count++;
+  stub_event_bytes += buffer_out_length;
+  if(stub_event_fd >= 0)
+  {
+    (void)write(stub_event_fd, buffer_out, buffer_out_length);
+  }
+}
+
+void send_event_2buffers(uint8_t *buffer_out1, uint16_t buffer_out_length1, uint8_t *buffer_out2, uint16_t buffer_out_length2, int8_t overflow_index)
+{
+  uint8_t buffer[STUB_EVENT_SIZE];
+
+  memcpy(buffer, buffer_out1, buffer_out_length1);
+  memcpy(buffer + buffer_out_length1, buffer_out2, buffer_out_length2);
+  send_event(buffer, buffer_out_length1 + buffer_out_length2, overflow_index);
+}
+
+/* Same lookup as process_command() in transport_layer.c, without the HCI
+   reset and the legacy/extended advertising check */
+void send_command(uint8_t *cmd, uint16_t len)
+{
+  uint8_t buffer_out[STUB_EVENT_SIZE];
+  uint16_t opcode;
+  uint16_t offset;
+  uint16_t out_len = 7;
+  uint32_t i;
+
+  opcode = LE_TO_HOST_16(cmd + 1);
+  offset = (cmd[0] == HCI_COMMAND_PKT) ? sizeof(hci_cmd_hdr) : sizeof(hci_cmd_ext_hdr);
+
+  for(i = 0; hci_command_table[i].opcode != 0; i++)
+  {
+    if(opcode == hci_command_table[i].opcode)
+    {
+      out_len = hci_command_table[i].execute(cmd + offset, len - offset, buffer_out, sizeof(buffer_out));
+      break;
+    }
+  }
+  if(hci_command_table[i].opcode == 0)
+  {
+    /* Command status: unknown command */
+    buffer_out[0] = 0x04;
+    buffer_out[1] = 0x0F;
+    buffer_out[2] = 0x04;
+    buffer_out[3] = 0x01;
+    buffer_out[4] = 0x01;
+    HOST_TO_LE_16(buffer_out + 5, opcode);
+  }
+  send_event(buffer_out, out_len, 1);
+}
+
+uint16_t parse_cmd(uint8_t *hci_buffer, uint16_t hci_pckt_len, uint8_t *buffer_out)
+{
+  stub_vendor_count++;
+  buffer_out[0] = HCI_VENDOR_PKT;
+  buffer_out[1] = 1;
+  buffer_out[2] = 2;
+  buffer_out[3] = 0;
+  buffer_out[4] = hci_buffer[HCI_VENDOR_CMDCODE_OFFSET];
+  buffer_out[5] = 0;
+  return 6;
+}
+
+tBleStatus hci_tx_acl_data(uint16_t Connection_Handle, uint8_t PB_Flag, uint8_t BC_Flag,
+                           uint16_t Data_Length, uint8_t *PDU_Data)
+{
+  stub_acl.count++;
+  stub_acl.conn_handle = Connection_Handle;
+  stub_acl.pb_flag = PB_Flag;
+  stub_acl.bc_flag = BC_Flag;
+  stub_acl.len = Data_Length;
+  memcpy(stub_acl.data, PDU_Data, (Data_Length < STUB_EVENT_SIZE) ? Data_Length : STUB_EVENT_SIZE);
+  return stub_call();
+}
+
+void adv_tiny_buff_free(void *p)
+{
+  stub_adv_buff_freed++;
+}
+
+/* Preprocessing of the other DTM modules: the events are forwarded ------------*/
+
+int hci_disconnection_complete_event_preprocess(uint8_t Status, uint16_t Connection_Handle, uint8_t Reason)
+{
+  return 0;
+}
+
+int aci_l2cap_disconnection_complete_event_preprocess(uint16_t Connection_Handle, uint16_t CID)
+{
+  return 0;
+}
+
+int aci_l2cap_cos_connection_event_preprocess(uint16_t Connection_Handle, uint8_t Event_Type, uint8_t Identifier,
+                                              uint16_t SPSM, uint16_t Peer_MTU, uint16_t Peer_MPS,
+                                              uint16_t Initial_Credits, uint16_t Result, uint8_t CID_Count,
+                                              conn_cid_t conn_cid[])
+{
+  return 0;
+}
+
+int aci_gatt_srv_attribute_modified_event_preprocess(uint16_t Connection_Handle, uint16_t Attr_Handle,
+                                                     uint16_t Attr_Data_Length, uint8_t Attr_Data[])
+{
+  return 0;
+}
+
+int aci_gatt_clt_notification_event_preprocess(uint16_t Connection_Handle, uint16_t Attribute_Handle,
+                                               uint16_t Attribute_Value_Length, uint8_t Attribute_Value[])
+{
+  return 0;
+}
+
+int aci_gatt_clt_proc_complete_event_preprocess(uint16_t Connection_Handle, uint8_t Error_Code)
+{
+  return 0;
+}
+
+int aci_gatt_eatt_clt_proc_complete_event_preprocess(uint16_t Connection_Handle, uint16_t CID, uint8_t Error_Code)
+{
+  return 0;
+}
+
+int aci_gatt_tx_pool_available_event_preprocess(uint16_t Connection_Handle, uint16_t Available_Buffers)
+{
+  return 0;
+}
+
+tBleStatus aci_hal_set_tx_power_level_preprocess(uint8_t En_High_Power, uint8_t PA_Level)
+{
+  return stub_call();
+}
+
+tBleStatus aci_gap_set_advertising_enable_preprocess(uint8_t Enable, uint8_t Number_of_Sets,
+                                                     Advertising_Set_Parameters_t Advertising_Set_Parameters[])
+{
+  return stub_call();
+}
+
+/* Stack ---------------------------------------------------------------------*/
+
+tBleStatus hci_read_local_version_information(uint8_t *HCI_Version, uint16_t *HCI_Revision, uint8_t *LMP_PAL_Version,
+                                              uint16_t *Manufacturer_Name, uint16_t *LMP_PAL_Subversion)
+{
+  *HCI_Version = STUB_HCI_VERSION;
+  *HCI_Revision = STUB_HCI_REVISION;
+  *LMP_PAL_Version = STUB_HCI_VERSION;
+  *Manufacturer_Name = STUB_MANUFACTURER;
+  *LMP_PAL_Subversion = STUB_HCI_REVISION;
+  return stub_call();
+}
+
+tBleStatus hci_le_rand(uint8_t Random_Number[8])
+{
+  for(uint32_t i = 0; i < 8; i++)
+  {
+    Random_Number[i] = rand_counter++;
+  }
+  return stub_call();
+}
+
+/* Not AES: the plaintext XOR the key */
+tBleStatus hci_le_encrypt(uint8_t Key[16], uint8_t Plaintext_Data[16], uint8_t Encrypted_Data[16])
+{
+  memcpy(stub_encrypt_key, Key, 16);
+  for(uint32_t i = 0; i < 16; i++)
+  {
+    Encrypted_Data[i] = Plaintext_Data[i] ^ Key[i];
+  }
+  return stub_call();
+}
+
+tBleStatus hci_le_set_advertising_data(uint8_t Advertising_Data_Length, uint8_t Advertising_Data[31])
+{
+  stub_adv_data_len = Advertising_Data_Length;
+  memcpy(stub_adv_data, Advertising_Data, (Advertising_Data_Length < 31) ? Advertising_Data_Length : 31);
+  return stub_call();
+}
+
+tBleStatus aci_gap_add_devices_to_white_and_resolving_list(uint8_t Lists, uint8_t Clear_Lists, uint8_t Num_of_List_Entries,
+                                                           List_Entry_t List_Entry[])
+{
+  return stub_call();
+}
+
+tBleStatus aci_gap_configure_white_and_resolving_list(uint8_t Lists)
+{
+  return stub_call();
+}
+
+tBleStatus aci_gap_init(uint8_t Role, uint8_t Privacy_Type, uint8_t Device_Name_Char_Len, uint8_t Identity_Address_Type,
+                        uint16_t *Service_Handle, uint16_t *Dev_Name_Char_Handle, uint16_t *Appearance_Char_Handle)
+{
+  return stub_call();
+}
+
+tBleStatus aci_gap_resolve_private_addr(uint8_t Address[6], uint8_t Actual_Address[6])
+{
+  return stub_call();
+}
+
+tBleStatus aci_gap_set_advertising_configuration(uint8_t Advertising_Handle, uint8_t Discoverable_Mode,
+                                                 uint16_t Advertising_Event_Properties,
+                                                 uint32_t Primary_Advertising_Interval_Min,
+                                                 uint32_t Primary_Advertising_Interval_Max,
+                                                 uint8_t Primary_Advertising_Channel_Map, uint8_t Peer_Address_Type,
+                                                 uint8_t Peer_Address[6], uint8_t Advertising_Filter_Policy,
+                                                 int8_t Advertising_Tx_Power, uint8_t Primary_Advertising_PHY,
+                                                 uint8_t Secondary_Advertising_Max_Skip, uint8_t Secondary_Advertising_PHY,
+                                                 uint8_t Advertising_SID, uint8_t Scan_Request_Notification_Enable)
+{
+  return stub_call();
+}
+
+tBleStatus aci_gap_set_advertising_data_nwk(uint8_t Advertising_Handle, uint8_t Operation,
+                                            uint8_t Advertising_Data_Length, uint8_t *Advertising_Data)
+{
+  return stub_call();
+}
+
+tBleStatus aci_gap_set_advertising_enable(uint8_t Enable, uint8_t Number_of_Sets,
+                                          Advertising_Set_Parameters_t Advertising_Set_Parameters[])
+{
+  return stub_call();
+}
+
+tBleStatus aci_gap_set_event_mask(uint16_t GAP_Evt_Mask)
+{
+  return stub_call();
+}
+
+tBleStatus aci_gap_set_periodic_advertising_data_nwk(uint8_t Advertising_Handle, uint8_t Operation,
+                                                     uint8_t Advertising_Data_Length, uint8_t *Advertising_Data)
+{
+  return stub_call();
+}
+
+tBleStatus aci_gap_set_scan_response_data_nwk(uint8_t Advertising_Handle, uint8_t Operation,
+                                              uint8_t Scan_Response_Data_Length, uint8_t *Scan_Response_Data)
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_get_evt_fifo_max_level(uint16_t *ISR0_FIFO_Max_Level, uint16_t *ISR1_FIFO_Max_Level,
+                                          uint16_t *User_FIFO_Max_Level)
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_get_firmware_details(uint8_t *DTM_version_major, uint8_t *DTM_version_minor,
+                                        uint8_t *DTM_version_patch, uint8_t *DTM_variant, uint16_t *DTM_Build_Number,
+                                        uint8_t *BTLE_Stack_version_major, uint8_t *BTLE_Stack_version_minor,
+                                        uint8_t *BTLE_Stack_version_patch, uint8_t *BTLE_Stack_development,
+                                        uint16_t *BTLE_Stack_variant, uint16_t *BTLE_Stack_Build_Number)
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_get_firmware_details_v2(uint8_t *DTM_version_major, uint8_t *DTM_version_minor,
+                                           uint8_t *DTM_version_patch, uint8_t *DTM_variant, uint16_t *DTM_Build_Number,
+                                           uint8_t *BTLE_Stack_version_major, uint8_t *BTLE_Stack_version_minor,
+                                           uint8_t *BTLE_Stack_version_patch, uint8_t *BTLE_Stack_development,
+                                           uint32_t *BTLE_Stack_variant, uint16_t *BTLE_Stack_Build_Number)
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_get_fw_build_number(uint16_t *Build_Number)
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_get_link_status(uint8_t Bank_index, uint8_t Link_Status[8], uint16_t Link_Connection_Handle[16 / 2])
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_le_tx_test_packet_number(uint32_t *Number_Of_Packets)
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_read_config_data(uint8_t Offset, uint8_t *Data_Length, uint8_t Data[])
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_read_radio_reg(uint32_t Start_Address, uint8_t Num_Bytes, uint8_t *Data_Length, uint8_t Data[])
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_set_antenna_switch_parameters(uint8_t Antenna_IDs, uint8_t Antenna_ID_Shift,
+                                                 uint8_t Default_Antenna_ID, uint8_t RF_Activity_Enable)
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_set_radio_activity_mask(uint16_t Radio_Activity_Mask)
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_set_tx_power_level(uint8_t En_High_Power, uint8_t PA_Level)
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_tone_start(uint8_t RF_Channel, uint8_t Offset)
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_tone_stop(void)
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_transmitter_test_packets(uint8_t TX_Frequency, uint8_t Length_Of_Test_Data, uint8_t Packet_Payload,
+                                            uint16_t Number_Of_Packets, uint8_t PHY)
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_updater_start(void)
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_write_config_data(uint8_t Offset, uint8_t Length, uint8_t Value[])
+{
+  return stub_call();
+}
+
+tBleStatus aci_hal_write_radio_reg(uint32_t Start_Address, uint8_t Num_Bytes, uint8_t Data[])
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_add_device_to_filter_accept_list(uint8_t Address_Type, uint8_t Address[6])
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_clear_filter_accept_list(void)
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_read_advertising_physical_channel_tx_power(int8_t *Transmit_Power_Level)
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_read_buffer_size(uint16_t *HC_LE_ACL_Data_Packet_Length, uint8_t *HC_Total_Num_LE_ACL_Data_Packets)
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_read_filter_accept_list_size(uint8_t *White_List_Size)
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_read_local_supported_features(uint8_t LE_Features[8])
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_read_rf_path_compensation(int16_t *RF_TX_Path_Compensation_Value, int16_t *RF_RX_Path_Compensation_Value)
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_read_supported_states(uint8_t LE_States[8])
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_read_transmit_power(int8_t *Min_Tx_Power, int8_t *Max_Tx_Power)
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_receiver_test(uint8_t RX_Frequency)
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_remove_device_from_filter_accept_list(uint8_t Address_Type, uint8_t Address[6])
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_set_advertising_enable(uint8_t Advertising_Enable)
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_set_advertising_parameters(uint16_t Advertising_Interval_Min, uint16_t Advertising_Interval_Max,
+                                             uint8_t Advertising_Type, uint8_t Own_Address_Type,
+                                             uint8_t Peer_Address_Type, uint8_t Peer_Address[6],
+                                             uint8_t Advertising_Channel_Map, uint8_t Advertising_Filter_Policy)
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_set_event_mask(uint8_t LE_Event_Mask[8])
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_set_random_address(uint8_t Random_Address[6])
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_set_scan_response_data(uint8_t Scan_Response_Data_Length, uint8_t Scan_Response_Data[31])
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_test_end(uint16_t *Number_Of_Packets)
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_transmitter_test(uint8_t TX_Frequency, uint8_t Length_Of_Test_Data, uint8_t Packet_Payload)
+{
+  return stub_call();
+}
+
+tBleStatus hci_le_write_rf_path_compensation(int16_t RF_TX_Path_Compensation_Value, int16_t RF_RX_Path_Compensation_Value)
+{
+  return stub_call();
+}
+
+tBleStatus hci_read_bd_addr(uint8_t BD_ADDR[6])
+{
+  return stub_call();
+}
+
+tBleStatus hci_read_local_supported_commands(uint8_t Supported_Commands[64])
+{
+  return stub_call();
+}
+
+tBleStatus hci_read_local_supported_features(uint8_t LMP_Features[8])
+{
+  return stub_call();
+}
+
+tBleStatus hci_set_event_mask(uint8_t Event_Mask[8])
+{
+  return stub_call();
+}
+
+tBleStatus hci_set_event_mask_page_2(uint8_t Event_Mask_Page_2[8])
+{
+  return stub_call();
+}
@@ -0,0 +1,71 @@
+/**
+  ******************************************************************************
+  * @file    dtm_host_stub.h
+  * @brief   Scripted BLE stack and host transport of the DTM HCI glue: the
+  *          stack functions return a scripted status, the commands are run
+  *          as soon as they are framed and the events are recorded.
+  ******************************************************************************
+  */
+
+#ifndef DTM_HOST_STUB_H
+#define DTM_HOST_STUB_H
+
+#include <stdint.h>
+#include "ble_status.h"
+
+/* Events are recorded by (index % STUB_MAX_EVENTS) */
+#define STUB_MAX_EVENTS         (64)
+#define STUB_EVENT_SIZE         (540)
+
+/* Values reported by hci_read_local_version_information() */
+#define STUB_HCI_VERSION        (0x0D)
+#define STUB_HCI_REVISION       (0x1234)
+#define STUB_MANUFACTURER       (0x0030)
+
+typedef struct
+{
+  uint16_t len;
+  int8_t overflow_index;
+  uint8_t data[STUB_EVENT_SIZE];
+} stub_event_t;
+
+typedef struct
+{
+  uint32_t count;
+  uint16_t conn_handle;
+  uint8_t pb_flag;
+  uint8_t bc_flag;
+  uint16_t len;
+  uint8_t data[STUB_EVENT_SIZE];
+} stub_acl_t;
+
+extern stub_event_t stub_events[STUB_MAX_EVENTS];
+extern uint32_t stub_event_count;
+extern uint64_t stub_event_bytes;
+
+/* When not negative, the events are also written to this file descriptor */
+extern int stub_event_fd;
+
+/* Returned by all the stack functions */
+extern tBleStatus stub_stack_status;
+extern uint32_t stub_stack_calls;
+
+extern stub_acl_t stub_acl;
+
+/* Last parameters of hci_le_set_advertising_data() and hci_le_encrypt() */
+extern uint8_t stub_adv_data_len;
+extern uint8_t stub_adv_data[31];
+extern uint8_t stub_encrypt_key[16];
+
+/* Vendor packets given to parse_cmd() */
+extern uint32_t stub_vendor_count;
+
+/* Buffers given back by the advertising data update event */
+extern uint32_t stub_adv_buff_freed;
+
+void stub_reset(void);
+
+/* Event n (0 is the first event after stub_reset()) */
+const stub_event_t *stub_get_event(uint32_t n);
+
+#endif /* DTM_HOST_STUB_H */
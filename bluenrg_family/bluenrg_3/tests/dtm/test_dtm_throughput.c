@@ -0,0 +1,408 @@
+/**
+  ******************************************************************************
+  * @file    test_dtm_throughput.c
+  * @brief   DTM HCI glue (hci_parser.c, DTM_cmd_db.c) on a scripted stack:
+  *          command and event packing, ACL and vendor packets, then command
+  *          and event throughput and latency, in process and through a pty.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "test_assert.h"
+#include "ble_const.h"
+#include "system_util.h"
+#include "bluenrg_lp_events.h"
+#include "bluenrg_lp_stack.h"
+#include "hci_parser.h"
+#include "dtm_host_stub.h"
+
+TEST_MAIN_DEFINITIONS;
+
+#define BENCH_COMMANDS      (200000)
+#define BENCH_EVENTS        (200000)
+#define PTY_COMMANDS        (2000)
+
+#define OPCODE_READ_LOCAL_VERSION   (0x1001)
+#define OPCODE_LE_SET_ADV_DATA      (0x2008)
+#define OPCODE_LE_ENCRYPT           (0x2017)
+#define OPCODE_LE_RAND              (0x2018)
+#define OPCODE_UNKNOWN              (0xFFFF)
+
+static double now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+/* Writes an HCI command packet, returns its length */
+static uint16_t make_command(uint8_t *p, uint16_t opcode, const uint8_t *params, uint8_t len)
+{
+  p[0] = HCI_COMMAND_PKT;
+  HOST_TO_LE_16(p + 1, opcode);
+  p[3] = len;
+  memcpy(p + 4, params, len);
+  return 4 + len;
+}
+
+/* Writes one of 4 commands, with the parameters seeded by n */
+static uint16_t make_bench_command(uint8_t *p, uint32_t n)
+{
+  uint8_t params[32];
+
+  for(uint32_t i = 0; i < sizeof(params); i++)
+  {
+    params[i] = (uint8_t)(n + i);
+  }
+  switch(n % 4)
+  {
+  case 0:
+    return make_command(p, OPCODE_READ_LOCAL_VERSION, NULL, 0);
+  case 1:
+    return make_command(p, OPCODE_LE_RAND, NULL, 0);
+  case 2:
+    return make_command(p, OPCODE_LE_ENCRYPT, params, 32);
+  default:
+    params[0] = 31;
+    return make_command(p, OPCODE_LE_SET_ADV_DATA, params, 32);
+  }
+}
+
+/* Checks that event n is the command complete of opcode with the given status */
+static void check_command_complete(uint32_t n, uint16_t opcode, uint8_t status)
+{
+  const stub_event_t *e = stub_get_event(n);
+
+  TEST_CHECK_EQUAL(e->data[0], HCI_EVENT_PKT);
+  TEST_CHECK_EQUAL(e->data[1], 0x0E);
+  TEST_CHECK_EQUAL(e->len, e->data[2] + 3);
+  TEST_CHECK_EQUAL(LE_TO_HOST_16(e->data + 4), opcode);
+  TEST_CHECK_EQUAL(e->data[6], status);
+}
+
+/* Parameters packed in the commands and in the command complete events */
+static void test_commands(void)
+{
+  uint8_t stream[512];
+  uint8_t params[32];
+  uint16_t len = 0;
+  const stub_event_t *e;
+
+  for(uint32_t i = 0; i < sizeof(params); i++)
+  {
+    params[i] = (uint8_t)(0xA0 + i);
+  }
+
+  stub_reset();
+  len += make_command(&stream[len], OPCODE_READ_LOCAL_VERSION, NULL, 0);
+  len += make_command(&stream[len], OPCODE_LE_RAND, NULL, 0);
+  len += make_command(&stream[len], OPCODE_LE_RAND, NULL, 0);
+  len += make_command(&stream[len], OPCODE_LE_ENCRYPT, params, 32);
+  params[0] = 5;
+  len += make_command(&stream[len], OPCODE_LE_SET_ADV_DATA, params, 32);
+  /* Wrong parameter length: the stack is not called */
+  len += make_command(&stream[len], OPCODE_LE_ENCRYPT, params, 31);
+  len += make_command(&stream[len], OPCODE_UNKNOWN, params, 3);
+
+  /* Byte by byte */
+  for(uint16_t i = 0; i < len; i++)
+  {
+    hci_input(&stream[i], 1);
+  }
+  TEST_CHECK_EQUAL(stub_event_count, 7);
+  TEST_CHECK_EQUAL(stub_stack_calls, 5);
+
+  check_command_complete(0, OPCODE_READ_LOCAL_VERSION, BLE_STATUS_SUCCESS);
+  e = stub_get_event(0);
+  TEST_CHECK_EQUAL(e->len, 15);
+  TEST_CHECK_EQUAL(e->data[7], STUB_HCI_VERSION);
+  TEST_CHECK_EQUAL(LE_TO_HOST_16(e->data + 8), STUB_HCI_REVISION);
+  TEST_CHECK_EQUAL(LE_TO_HOST_16(e->data + 11), STUB_MANUFACTURER);
+
+  check_command_complete(1, OPCODE_LE_RAND, BLE_STATUS_SUCCESS);
+  check_command_complete(2, OPCODE_LE_RAND, BLE_STATUS_SUCCESS);
+  TEST_CHECK(memcmp(stub_get_event(1)->data + 7, stub_get_event(2)->data + 7, 8) != 0);
+
+  check_command_complete(3, OPCODE_LE_ENCRYPT, BLE_STATUS_SUCCESS);
+  e = stub_get_event(3);
+  TEST_CHECK_EQUAL(e->len, 23);
+  for(uint32_t i = 0; i < 16; i++)
+  {
+    TEST_CHECK_EQUAL(stub_encrypt_key[i], (uint8_t)(0xA0 + i));
+    TEST_CHECK_EQUAL(e->data[7 + i], (uint8_t)((0xA0 + i) ^ (0xA0 + 16 + i)));
+  }
+
+  check_command_complete(4, OPCODE_LE_SET_ADV_DATA, BLE_STATUS_SUCCESS);
+  TEST_CHECK_EQUAL(stub_adv_data_len, 5);
+  TEST_CHECK(memcmp(stub_adv_data, &params[1], 5) == 0);
+
+  check_command_complete(5, OPCODE_LE_ENCRYPT, BLE_ERROR_INVALID_HCI_CMD_PARAMS);
+
+  /* Command status: unknown command */
+  e = stub_get_event(6);
+  TEST_CHECK_EQUAL(e->data[1], 0x0F);
+  TEST_CHECK_EQUAL(e->data[3], 0x01);
+  TEST_CHECK_EQUAL(LE_TO_HOST_16(e->data + 5), OPCODE_UNKNOWN);
+
+  /* Status returned by the stack */
+  stub_stack_status = BLE_ERROR_COMMAND_DISALLOWED;
+  len = make_command(stream, OPCODE_LE_RAND, NULL, 0);
+  hci_input(stream, len);
+  check_command_complete(7, OPCODE_LE_RAND, BLE_ERROR_COMMAND_DISALLOWED);
+}
+
+/* ACL data and vendor packets, transport error in the middle of a command */
+static void test_packets(void)
+{
+  uint8_t acl[5 + 27] = { HCI_ACLDATA_PKT, 0x34, 0x02 | (2 << 4), 27, 0 };
+  uint8_t vendor[6] = { HCI_VENDOR_PKT, 0x05, 2, 0, 0xAA, 0xBB };
+  uint8_t cmd[8];
+  uint16_t len = make_command(cmd, OPCODE_LE_RAND, NULL, 0);
+  uint16_t errors = hci_input_error_count;
+
+  for(uint32_t i = 5; i < sizeof(acl); i++)
+  {
+    acl[i] = (uint8_t)i;
+  }
+
+  stub_reset();
+  TEST_CHECK_EQUAL(hci_input(acl, sizeof(acl)), WAITING_TYPE);
+  TEST_CHECK_EQUAL(stub_acl.count, 1);
+  TEST_CHECK_EQUAL(stub_acl.conn_handle, 0x0234);
+  TEST_CHECK_EQUAL(stub_acl.pb_flag, 2);
+  TEST_CHECK_EQUAL(stub_acl.bc_flag, 0);
+  TEST_CHECK_EQUAL(stub_acl.len, 27);
+  TEST_CHECK(memcmp(stub_acl.data, &acl[5], 27) == 0);
+  TEST_CHECK_EQUAL(stub_event_count, 0);
+
+  hci_input(vendor, sizeof(vendor));
+  TEST_CHECK_EQUAL(stub_vendor_count, 1);
+  TEST_CHECK_EQUAL(stub_event_count, 1);
+  TEST_CHECK_EQUAL(stub_get_event(0)->data[0], HCI_VENDOR_PKT);
+  TEST_CHECK_EQUAL(stub_get_event(0)->data[4], 0x05);
+
+  /* The partial command is dropped, the next one is run */
+  TEST_CHECK_EQUAL(hci_input(cmd, 2), WAITING_HEADER);
+  hci_input_drop();
+  TEST_CHECK_EQUAL(hci_input_error_count, (uint16_t)(errors + 1));
+  hci_input(cmd, len);
+  TEST_CHECK_EQUAL(stub_event_count, 2);
+  check_command_complete(1, OPCODE_LE_RAND, BLE_STATUS_SUCCESS);
+}
+
+/* Events packed by DTM_cmd_db.c and forwarded or consumed by BLE_STACK_Event() */
+static void test_events(void)
+{
+  uint8_t value[20];
+  uint8_t event[3 + 2 + 2 * sizeof(void *)] = { HCI_EVENT_PKT, HCI_VENDOR_PKT, 2 + 2 * sizeof(void *), 0x10, 0x00 };
+  void *old_pointer = &value[0], *new_pointer = &value[1];
+  uint8_t le_event[6] = { HCI_EVENT_PKT, 0x3E, 3, 0x01, 0x02, 0x03 };
+  const stub_event_t *e;
+
+  memset(value, 0x5A, sizeof(value));
+  memcpy(&event[5], &old_pointer, sizeof(void *));
+  memcpy(&event[5 + sizeof(void *)], &new_pointer, sizeof(void *));
+
+  stub_reset();
+  hci_disconnection_complete_event(0x00, 0x0801, 0x13);
+  e = stub_get_event(0);
+  TEST_CHECK_EQUAL(e->len, 7);
+  TEST_CHECK(memcmp(e->data, "\x04\x05\x04\x00\x01\x08\x13", 7) == 0);
+  TEST_CHECK_EQUAL(e->overflow_index, 0);
+
+  aci_gatt_clt_notification_event(0x0801, 0x0010, sizeof(value), value);
+  e = stub_get_event(1);
+  TEST_CHECK_EQUAL(e->len, 6 + 6 + sizeof(value));
+  TEST_CHECK_EQUAL(e->data[0], HCI_EVENT_EXT_PKT);
+  TEST_CHECK_EQUAL(LE_TO_HOST_16(e->data + 2), 6 + sizeof(value) + 2);
+  TEST_CHECK(memcmp(e->data + 12, value, sizeof(value)) == 0);
+
+  /* Forwarded as it is */
+  BLE_STACK_Event(le_event, sizeof(le_event));
+  TEST_CHECK_EQUAL(stub_event_count, 3);
+  TEST_CHECK(memcmp(stub_get_event(2)->data, le_event, sizeof(le_event)) == 0);
+
+  /* Advertising data update: the old buffer is freed, the event is not sent */
+  BLE_STACK_Event(event, sizeof(event));
+  TEST_CHECK_EQUAL(stub_event_count, 3);
+  TEST_CHECK_EQUAL(stub_adv_buff_freed, 1);
+}
+
+/* Commands streamed in chunks, then one command per hci_input() call */
+static void bench_commands(void)
+{
+  static uint8_t stream[BENCH_COMMANDS * 36];
+  static double latency[BENCH_COMMANDS];
+  uint32_t len = 0;
+  uint32_t done = 0;
+  double start, elapsed, mean = 0;
+
+  for(uint32_t n = 0; n < BENCH_COMMANDS; n++)
+  {
+    len += make_bench_command(&stream[len], n);
+  }
+
+  stub_reset();
+  start = now_us();
+  while(done < len)
+  {
+    uint16_t chunk = (len - done < 256) ? (uint16_t)(len - done) : 256;
+
+    hci_input(&stream[done], chunk);
+    done += chunk;
+  }
+  elapsed = now_us() - start;
+  TEST_CHECK_EQUAL(stub_event_count, BENCH_COMMANDS);
+  TEST_CHECK_EQUAL(stub_stack_calls, BENCH_COMMANDS);
+  printf("commands, 256-byte chunks: %8.0f commands/s, %6.1f MB/s in, %6.1f MB/s out\n",
+         BENCH_COMMANDS / elapsed * 1e6, len / elapsed, stub_event_bytes / elapsed);
+
+  stub_reset();
+  done = 0;
+  for(uint32_t n = 0; n < BENCH_COMMANDS; n++)
+  {
+    uint8_t cmd_len = stream[done + 3] + 4;
+
+    start = now_us();
+    hci_input(&stream[done], cmd_len);
+    latency[n] = now_us() - start;
+    mean += latency[n];
+    done += cmd_len;
+  }
+  TEST_CHECK_EQUAL(stub_event_count, BENCH_COMMANDS);
+  qsort(latency, BENCH_COMMANDS, sizeof(double), compare_double);
+  printf("command to event latency: mean %.3f us, p99 %.3f us, max %.3f us\n",
+         mean / BENCH_COMMANDS, latency[BENCH_COMMANDS * 99 / 100], latency[BENCH_COMMANDS - 1]);
+}
+
+/* Events packed by DTM_cmd_db.c: short events and 244-byte notifications */
+static void bench_events(void)
+{
+  uint8_t value[244];
+  double start, elapsed;
+
+  memset(value, 0x5A, sizeof(value));
+  stub_reset();
+  start = now_us();
+  for(uint32_t n = 0; n < BENCH_EVENTS; n++)
+  {
+    if(n & 1)
+    {
+      aci_gatt_clt_notification_event(0x0801, 0x0010, sizeof(value), value);
+    }
+    else
+    {
+      hci_disconnection_complete_event(0x00, (uint16_t)n & 0x0EFF, 0x13);
+    }
+  }
+  elapsed = now_us() - start;
+  TEST_CHECK_EQUAL(stub_event_count, BENCH_EVENTS);
+  printf("events: %8.0f events/s, %6.1f MB/s\n", BENCH_EVENTS / elapsed * 1e6, stub_event_bytes / elapsed);
+}
+
+/* Reads exactly len bytes */
+static int read_all(int fd, uint8_t *buff, uint16_t len)
+{
+  while(len > 0)
+  {
+    ssize_t n = read(fd, buff, len);
+
+    if(n <= 0)
+    {
+      return -1;
+    }
+    buff += n;
+    len -= (uint16_t)n;
+  }
+  return 0;
+}
+
+/* Round trip of the commands through a pty in raw mode: the host side writes
+   the command and reads the event, the DTM side reads the bytes available
+   and feeds them to hci_input() */
+static void bench_pty(void)
+{
+  static double latency[PTY_COMMANDS];
+  struct termios tio;
+  uint8_t cmd[40], rx[64], evt[300];
+  double mean = 0;
+  int host_fd, dtm_fd;
+
+  host_fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if((host_fd < 0) || (grantpt(host_fd) != 0) || (unlockpt(host_fd) != 0) ||
+     ((dtm_fd = open(ptsname(host_fd), O_RDWR | O_NOCTTY)) < 0))
+  {
+    printf("pty: not available, skipped\n");
+    if(host_fd >= 0)
+    {
+      close(host_fd);
+    }
+    return;
+  }
+  tcgetattr(dtm_fd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(dtm_fd, TCSANOW, &tio);
+
+  stub_reset();
+  stub_event_fd = dtm_fd;
+  for(uint32_t n = 0; n < PTY_COMMANDS; n++)
+  {
+    uint16_t len = make_bench_command(cmd, n);
+    uint32_t events = stub_event_count;
+    double start = now_us();
+
+    TEST_CHECK_EQUAL(write(host_fd, cmd, len), len);
+    while(stub_event_count == events)
+    {
+      ssize_t got = read(dtm_fd, rx, sizeof(rx));
+
+      if(got <= 0)
+      {
+        TEST_CHECK(got > 0);
+        break;
+      }
+      hci_input(rx, (uint16_t)got);
+    }
+    if((read_all(host_fd, evt, 3) != 0) || (read_all(host_fd, evt + 3, evt[2]) != 0))
+    {
+      TEST_CHECK(0);
+      break;
+    }
+    latency[n] = now_us() - start;
+    mean += latency[n];
+    TEST_CHECK_EQUAL(LE_TO_HOST_16(evt + 4), LE_TO_HOST_16(cmd + 1));
+  }
+  stub_event_fd = -1;
+  close(dtm_fd);
+  close(host_fd);
+
+  qsort(latency, PTY_COMMANDS, sizeof(double), compare_double);
+  printf("pty round trip: mean %.1f us, p99 %.1f us, max %.1f us\n",
+         mean / PTY_COMMANDS, latency[PTY_COMMANDS * 99 / 100], latency[PTY_COMMANDS - 1]);
+}
+
+int main(void)
+{
+  test_commands();
+  test_packets();
+  test_events();
+
+  bench_commands();
+  bench_events();
+  bench_pty();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,146 @@
+/**
+  ******************************************************************************
+  * @file    fuzz_hci_framer.c
+  * @brief   libFuzzer entry point of the HCI framer. The input is framed as a
+  *          whole, byte by byte, in chunks chosen by the input and with the
+  *          zero-copy option: all must report the same packets, each with a
+  *          complete header, the length given by the header and within the
+  *          framer buffer.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_assert.h"
+#include "hci_framer.h"
+
+TEST_MAIN_DEFINITIONS;
+
+/* Small buffer, so that the oversize path is reached */
+#define FUZZ_BUFFER_SIZE    (64)
+#define FUZZ_MAX_INPUT      (4096)
+#define FUZZ_RUNS           (4)
+
+typedef struct
+{
+  uint32_t count;
+  uint32_t size;
+  uint32_t hash;
+  uint8_t *last_input;
+  uint32_t in_place;
+} fuzz_record_t;
+
+static uint16_t header_len(uint8_t type)
+{
+  switch (type)
+  {
+  case 0x01: case 0x03: case 0xFF: case 0x82:
+    return 4;
+  case 0x04:
+    return 3;
+  default:
+    return 5;
+  }
+}
+
+static uint16_t payload_len(const uint8_t *p)
+{
+  switch (p[0])
+  {
+  case 0x01: case 0x03:
+    return p[3];
+  case 0x04:
+    return p[2];
+  case 0x05:
+    return (uint16_t)(p[3] | ((p[4] & 0x3F) << 8));
+  case 0x02: case 0x81:
+    return (uint16_t)(p[3] | (p[4] << 8));
+  default:
+    return (uint16_t)(p[2] | (p[3] << 8));
+  }
+}
+
+static void on_packet(void *cb_ctx, uint8_t *packet, uint16_t pckt_len)
+{
+  fuzz_record_t *r = cb_ctx;
+
+  if ((pckt_len > FUZZ_BUFFER_SIZE) || (pckt_len < header_len(packet[0])) ||
+      (pckt_len != header_len(packet[0]) + payload_len(packet)))
+  {
+    abort();
+  }
+  r->count++;
+  r->size += pckt_len;
+  for (uint16_t i = 0; i < pckt_len; i++)
+  {
+    r->hash = (r->hash ^ packet[i]) * 16777619U;
+  }
+}
+
+static void run(fuzz_record_t *r, hci_framer_t *framer, uint8_t *data, uint16_t size, const uint8_t *chunks)
+{
+  uint16_t done = 0;
+  uint16_t n = 0;
+
+  memset(r, 0, sizeof(*r));
+  r->hash = 2166136261U;
+  while (done < size)
+  {
+    uint16_t chunk = (chunks == NULL) ? size : (uint16_t)(1 + chunks[n++ % 16] % 97);
+
+    if (chunk > size - done)
+    {
+      chunk = size - done;
+    }
+    hci_framer_input(framer, &data[done], chunk);
+    done += chunk;
+  }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  static uint8_t input[FUZZ_MAX_INPUT];
+  static uint8_t buffer[FUZZ_BUFFER_SIZE];
+  static const uint8_t bytewise[16] = { 0 };
+  fuzz_record_t r[FUZZ_RUNS];
+  hci_framer_t framer[FUZZ_RUNS];
+  uint16_t type_mask;
+  uint16_t len;
+
+  if (size < 17)
+  {
+    return 0;
+  }
+  /* First byte: accepted types, next 16 bytes: chunk sizes, then the stream */
+  type_mask = data[0] | ((data[0] & 1) ? 0 : HCI_FRAMER_TYPE_EVT);
+  len = (uint16_t)((size - 17 < FUZZ_MAX_INPUT) ? size - 17 : FUZZ_MAX_INPUT);
+  memcpy(input, &data[17], len);
+
+  for (uint32_t i = 0; i < FUZZ_RUNS; i++)
+  {
+    hci_framer_init(&framer[i], buffer, FUZZ_BUFFER_SIZE, type_mask,
+                    (i == FUZZ_RUNS - 1) ? HCI_FRAMER_OPT_ZERO_COPY : 0, on_packet, &r[i]);
+  }
+  run(&r[0], &framer[0], input, len, NULL);
+  run(&r[1], &framer[1], input, len, bytewise);
+  run(&r[2], &framer[2], input, len, &data[1]);
+  run(&r[3], &framer[3], input, len, &data[1]);
+
+  for (uint32_t i = 1; i < FUZZ_RUNS; i++)
+  {
+    if ((r[i].count != r[0].count) || (r[i].size != r[0].size) || (r[i].hash != r[0].hash) ||
+        (framer[i].state != framer[0].state) ||
+        (framer[i].unknown_type_count != framer[0].unknown_type_count) ||
+        (framer[i].oversize_count != framer[0].oversize_count))
+    {
+      abort();
+    }
+  }
+  /* The input is not modified */
+  if (memcmp(input, &data[17], len) != 0)
+  {
+    abort();
+  }
+
+  return 0;
+}
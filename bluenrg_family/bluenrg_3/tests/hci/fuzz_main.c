@@ -0,0 +1,71 @@
+/**
+  ******************************************************************************
+  * @file    fuzz_main.c
+  * @brief   Replays a libFuzzer entry point without libFuzzer: on the files
+  *          given on the command line, or else on generated inputs made of
+  *          valid HCI packets mixed with random bytes.
+  ******************************************************************************
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define REPLAY_RUNS         (20000)
+#define REPLAY_MAX_INPUT    (1024)
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static const uint8_t replay_types[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x81, 0x82, 0xFF };
+
+static size_t generate(uint8_t *data)
+{
+  size_t size = 17 + rand() % (REPLAY_MAX_INPUT - 17);
+
+  for (size_t i = 0; i < size; i++)
+  {
+    data[i] = (uint8_t)rand();
+  }
+  /* Mostly packet types at the packet starts, with short lengths */
+  for (size_t i = 17; i + 5 < size; i += 5 + rand() % 40)
+  {
+    data[i] = replay_types[rand() % sizeof(replay_types)];
+    data[i + 2] &= 0x1F;
+    data[i + 3] &= 0x1F;
+    data[i + 4] &= 0x1F;
+  }
+  return size;
+}
+
+int main(int argc, char **argv)
+{
+  static uint8_t data[1 << 16];
+
+  if (argc > 1)
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      FILE *f = fopen(argv[i], "rb");
+      size_t size;
+
+      if (f == NULL)
+      {
+        perror(argv[i]);
+        return 1;
+      }
+      size = fread(data, 1, sizeof(data), f);
+      fclose(f);
+      LLVMFuzzerTestOneInput(data, size);
+    }
+    printf("%d input(s) replayed\n", argc - 1);
+    return 0;
+  }
+
+  srand(1);
+  for (uint32_t run = 0; run < REPLAY_RUNS; run++)
+  {
+    LLVMFuzzerTestOneInput(data, generate(data));
+  }
+  printf("%u generated input(s) replayed\n", REPLAY_RUNS);
+  return 0;
+}
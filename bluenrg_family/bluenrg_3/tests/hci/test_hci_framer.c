@@ -0,0 +1,339 @@
+/**
+  ******************************************************************************
+  * @file    test_hci_framer.c
+  * @brief   HCI framer: every packet type, input split at any point, unknown
+  *          types and oversize packets skipped and counted, zero-copy
+  *          delivery and reset of a partial packet.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_assert.h"
+#include "hci_framer.h"
+
+TEST_MAIN_DEFINITIONS;
+
+#define BUFFER_SIZE     (300)
+#define STREAM_SIZE     (32768)
+#define MAX_PACKETS     (256)
+
+#define TYPE_MASK_ALL   (0x00FFU)
+
+typedef struct
+{
+  uint8_t type;
+  uint16_t header_len;
+  uint16_t type_bit;
+} packet_type_t;
+
+static const packet_type_t types[] = {
+  { 0x01, 4, HCI_FRAMER_TYPE_CMD },
+  { 0x02, 5, HCI_FRAMER_TYPE_ACL },
+  { 0x03, 4, HCI_FRAMER_TYPE_SCO },
+  { 0x04, 3, HCI_FRAMER_TYPE_EVT },
+  { 0x05, 5, HCI_FRAMER_TYPE_ISO },
+  { 0x81, 5, HCI_FRAMER_TYPE_CMD_EXT },
+  { 0x82, 4, HCI_FRAMER_TYPE_EVT_EXT },
+  { 0xFF, 4, HCI_FRAMER_TYPE_VENDOR },
+};
+
+#define TYPES           (sizeof(types) / sizeof(types[0]))
+
+static uint8_t framer_buffer[BUFFER_SIZE];
+static uint8_t stream[STREAM_SIZE];
+
+/* Packets reported by the framer */
+static uint32_t packets;
+static uint8_t *packet_ptr[MAX_PACKETS];
+static uint16_t packet_len[MAX_PACKETS];
+static uint8_t packet_data[MAX_PACKETS][BUFFER_SIZE];
+
+/* Packets written in the stream */
+static uint32_t sent;
+static uint32_t sent_offset[MAX_PACKETS];
+static uint16_t sent_len[MAX_PACKETS];
+
+static void on_packet(void *cb_ctx, uint8_t *packet, uint16_t pckt_len)
+{
+  (*(uint32_t *)cb_ctx)++;
+  if (packets < MAX_PACKETS)
+  {
+    packet_ptr[packets] = packet;
+    packet_len[packets] = pckt_len;
+    memcpy(packet_data[packets], packet, (pckt_len < BUFFER_SIZE) ? pckt_len : BUFFER_SIZE);
+  }
+  packets++;
+}
+
+/* Writes a packet of the given type and payload length, returns its length */
+static uint16_t make_packet(uint8_t *p, const packet_type_t *t, uint16_t payload_len)
+{
+  p[0] = t->type;
+  for (uint16_t i = 1; i < t->header_len + payload_len; i++)
+  {
+    p[i] = (uint8_t)rand();
+  }
+  switch (t->type)
+  {
+  case 0x01:
+  case 0x03:
+    p[3] = (uint8_t)payload_len;
+    break;
+  case 0x04:
+    p[2] = (uint8_t)payload_len;
+    break;
+  case 0x05:
+    /* The 2 reserved bits are set: they are not part of the length */
+    p[3] = (uint8_t)payload_len;
+    p[4] = (uint8_t)(payload_len >> 8) | 0xC0;
+    break;
+  case 0x02:
+  case 0x81:
+    p[3] = (uint8_t)payload_len;
+    p[4] = (uint8_t)(payload_len >> 8);
+    break;
+  default:
+    p[2] = (uint8_t)payload_len;
+    p[3] = (uint8_t)(payload_len >> 8);
+    break;
+  }
+  return t->header_len + payload_len;
+}
+
+/* Stream of random packets of all the types, returns its length */
+static uint32_t make_stream(uint32_t count)
+{
+  uint32_t len = 0;
+
+  sent = 0;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    const packet_type_t *t = &types[rand() % TYPES];
+    uint16_t payload_len = (uint16_t)(rand() % (BUFFER_SIZE - t->header_len + 1));
+
+    /* Command, SCO and event lengths are on 8 bits */
+    if ((t->type == 0x01) || (t->type == 0x03) || (t->type == 0x04))
+    {
+      payload_len &= 0xFF;
+    }
+    sent_offset[sent] = len;
+    sent_len[sent] = make_packet(&stream[len], t, payload_len);
+    len += sent_len[sent];
+    sent++;
+  }
+  return len;
+}
+
+static void check_stream_packets(void)
+{
+  TEST_CHECK_EQUAL(packets, sent);
+  for (uint32_t i = 0; (i < packets) && (i < sent); i++)
+  {
+    TEST_CHECK_EQUAL(packet_len[i], sent_len[i]);
+    TEST_CHECK(memcmp(packet_data[i], &stream[sent_offset[i]], sent_len[i]) == 0);
+  }
+}
+
+/* Each packet type, alone and with an empty payload */
+static void test_types(void)
+{
+  hci_framer_t framer;
+  uint32_t calls = 0;
+  uint8_t p[BUFFER_SIZE];
+
+  for (uint32_t i = 0; i < TYPES; i++)
+  {
+    for (uint16_t payload_len = 0; payload_len <= 40; payload_len += 40)
+    {
+      uint16_t len = make_packet(p, &types[i], payload_len);
+
+      hci_framer_init(&framer, framer_buffer, BUFFER_SIZE, TYPE_MASK_ALL, 0, on_packet, &calls);
+      packets = 0;
+      TEST_CHECK_EQUAL(hci_framer_input(&framer, p, len), HCI_FRAMER_WAITING_TYPE);
+      TEST_CHECK_EQUAL(packets, 1);
+      TEST_CHECK_EQUAL(packet_len[0], len);
+      TEST_CHECK(memcmp(packet_data[0], p, len) == 0);
+      /* Copied in the framer buffer */
+      TEST_CHECK(packet_ptr[0] == framer_buffer);
+    }
+
+    /* Not accepted: the type byte is skipped */
+    hci_framer_init(&framer, framer_buffer, BUFFER_SIZE, TYPE_MASK_ALL & ~types[i].type_bit, 0, on_packet, &calls);
+    packets = 0;
+    p[0] = types[i].type;
+    hci_framer_input(&framer, p, 1);
+    TEST_CHECK_EQUAL(packets, 0);
+    TEST_CHECK_EQUAL(framer.unknown_type_count, 1);
+    TEST_CHECK_EQUAL(framer.state, HCI_FRAMER_WAITING_TYPE);
+  }
+  TEST_CHECK_EQUAL(calls, 2 * TYPES);
+}
+
+/* The same packets whatever the split of the input */
+static void test_split(void)
+{
+  hci_framer_t framer;
+  uint32_t calls = 0;
+  uint32_t len = make_stream(60);
+
+  TEST_CHECK(len <= STREAM_SIZE);
+
+  /* Whole stream */
+  hci_framer_init(&framer, framer_buffer, BUFFER_SIZE, TYPE_MASK_ALL, 0, on_packet, &calls);
+  packets = 0;
+  TEST_CHECK_EQUAL(hci_framer_input(&framer, stream, (uint16_t)len), HCI_FRAMER_WAITING_TYPE);
+  check_stream_packets();
+
+  /* Byte by byte */
+  hci_framer_init(&framer, framer_buffer, BUFFER_SIZE, TYPE_MASK_ALL, 0, on_packet, &calls);
+  packets = 0;
+  for (uint32_t i = 0; i < len; i++)
+  {
+    hci_framer_state_t state = hci_framer_input(&framer, &stream[i], 1);
+    uint32_t boundary = (packets < sent) ? sent_offset[packets] : len;
+
+    /* Waiting for a type exactly at the packet boundaries */
+    TEST_CHECK((state == HCI_FRAMER_WAITING_TYPE) == (i + 1 == boundary));
+  }
+  check_stream_packets();
+
+  /* Random splits */
+  for (uint32_t n = 0; n < 20; n++)
+  {
+    uint32_t done = 0;
+
+    hci_framer_init(&framer, framer_buffer, BUFFER_SIZE, TYPE_MASK_ALL, 0, on_packet, &calls);
+    packets = 0;
+    while (done < len)
+    {
+      uint32_t chunk = 1 + rand() % 700;
+
+      if (chunk > len - done)
+      {
+        chunk = len - done;
+      }
+      hci_framer_input(&framer, &stream[done], (uint16_t)chunk);
+      done += chunk;
+    }
+    check_stream_packets();
+  }
+}
+
+/* Unknown type bytes are skipped one by one and counted, the framer
+   resynchronizes on the next accepted type */
+static void test_unknown(void)
+{
+  hci_framer_t framer;
+  uint32_t calls = 0;
+  uint8_t p[16] = { 0x00, 0x06, 0x7F, 0x80 };
+  uint16_t len = make_packet(&p[4], &types[3], 5);
+
+  hci_framer_init(&framer, framer_buffer, BUFFER_SIZE, TYPE_MASK_ALL, 0, on_packet, &calls);
+  packets = 0;
+  TEST_CHECK_EQUAL(hci_framer_input(&framer, p, 4 + len), HCI_FRAMER_WAITING_TYPE);
+  TEST_CHECK_EQUAL(framer.unknown_type_count, 4);
+  TEST_CHECK_EQUAL(packets, 1);
+  TEST_CHECK_EQUAL(packet_len[0], len);
+  TEST_CHECK(memcmp(packet_data[0], &p[4], len) == 0);
+}
+
+/* A packet longer than the buffer is discarded and counted, byte by byte or
+   not, and the next packet is received */
+static void test_oversize(void)
+{
+  static uint8_t p[2 * BUFFER_SIZE];
+  hci_framer_t framer;
+  uint32_t calls = 0;
+  uint16_t big = make_packet(p, &types[1], BUFFER_SIZE - 4);
+  uint16_t fit = make_packet(&p[big], &types[1], BUFFER_SIZE - 5);
+
+  for (uint32_t bytewise = 0; bytewise < 2; bytewise++)
+  {
+    for (uint8_t options = 0; options <= HCI_FRAMER_OPT_ZERO_COPY; options++)
+    {
+      hci_framer_init(&framer, framer_buffer, BUFFER_SIZE, TYPE_MASK_ALL, options, on_packet, &calls);
+      packets = 0;
+      if (bytewise)
+      {
+        for (uint32_t i = 0; i < big; i++)
+        {
+          TEST_CHECK_EQUAL(hci_framer_input(&framer, &p[i], 1),
+                           (i + 1 < 5) ? HCI_FRAMER_WAITING_HEADER :
+                           (i + 1 < big) ? HCI_FRAMER_DISCARDING_PAYLOAD : HCI_FRAMER_WAITING_TYPE);
+        }
+        hci_framer_input(&framer, &p[big], fit);
+      }
+      else
+      {
+        hci_framer_input(&framer, p, big + fit);
+      }
+      TEST_CHECK_EQUAL(framer.oversize_count, 1);
+      TEST_CHECK_EQUAL(framer.unknown_type_count, 0);
+      TEST_CHECK_EQUAL(packets, 1);
+      TEST_CHECK_EQUAL(packet_len[0], fit);
+      TEST_CHECK(memcmp(packet_data[0], &p[big], fit) == 0);
+    }
+  }
+}
+
+/* Zero-copy: the packets fully in the input are reported in place, the
+   others are reassembled in the framer buffer */
+static void test_zero_copy(void)
+{
+  hci_framer_t framer;
+  uint32_t calls = 0;
+  uint32_t len = make_stream(40);
+  uint32_t split = sent_offset[10] + sent_len[10] / 2;
+
+  hci_framer_init(&framer, framer_buffer, BUFFER_SIZE, TYPE_MASK_ALL, HCI_FRAMER_OPT_ZERO_COPY, on_packet, &calls);
+  packets = 0;
+  hci_framer_input(&framer, stream, (uint16_t)split);
+  hci_framer_input(&framer, &stream[split], (uint16_t)(len - split));
+  check_stream_packets();
+  for (uint32_t i = 0; i < packets; i++)
+  {
+    if (i == 10)
+    {
+      TEST_CHECK(packet_ptr[i] == framer_buffer);
+    }
+    else
+    {
+      TEST_CHECK(packet_ptr[i] == &stream[sent_offset[i]]);
+    }
+  }
+}
+
+/* A reset drops the packet being received */
+static void test_reset(void)
+{
+  hci_framer_t framer = HCI_FRAMER_INITIALIZER(framer_buffer, BUFFER_SIZE, TYPE_MASK_ALL, 0, on_packet, NULL);
+  uint32_t calls = 0;
+  uint8_t p[64];
+  uint16_t len = make_packet(p, &types[0], 20);
+
+  framer.cb_ctx = &calls;
+  packets = 0;
+  TEST_CHECK_EQUAL(hci_framer_input(&framer, p, 2), HCI_FRAMER_WAITING_HEADER);
+  hci_framer_reset(&framer);
+  TEST_CHECK_EQUAL(hci_framer_input(&framer, p, 10), HCI_FRAMER_WAITING_PAYLOAD);
+  hci_framer_reset(&framer);
+  TEST_CHECK_EQUAL(hci_framer_input(&framer, p, len), HCI_FRAMER_WAITING_TYPE);
+  TEST_CHECK_EQUAL(packets, 1);
+  TEST_CHECK_EQUAL(packet_len[0], len);
+  TEST_CHECK_EQUAL(framer.unknown_type_count, 0);
+}
+
+int main(void)
+{
+  srand(3);
+
+  test_types();
+  test_split();
+  test_unknown();
+  test_oversize();
+  test_zero_copy();
+  test_reset();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,181 @@
+/**
+  ******************************************************************************
+  * @file    ota_client.c
+  * @brief   OTA client model: it sends an image to the OTA server through the
+  *          OTA characteristic callbacks, one connection event at a time.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "crc_manager.h"
+#include "OTA_btl.h"
+#include "ota_host_stub.h"
+#include "ota_client.h"
+
+#define DEFAULT_WINDOW  (8)
+
+uint32_t ota_client_crc32(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+  return CRCMGR_Crc32Sw(crc, data, size);
+}
+
+static void put_le32(uint8_t *p, uint32_t value)
+{
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  p[2] = (uint8_t)(value >> 16);
+  p[3] = (uint8_t)(value >> 24);
+}
+
+void ota_client_start(ota_client_t *c)
+{
+  stub_conn_t *conn = stub_get_conn(c->conn_handle);
+  uint8_t write[17];
+  uint8_t length = 9;
+  uint8_t cccd[2] = { 0x01, 0x00 };
+
+  if (c->att_mtu == 0)
+  {
+    c->att_mtu = 23;
+  }
+  if (c->att_mtu > 23)
+  {
+    OTA_att_exchange_mtu_resp_CB(c->conn_handle, c->att_mtu);
+    OTA_data_length_change_CB(c->conn_handle);
+    c->packet_size = (uint16_t)(16 * ((c->att_mtu - 3 - 4) / 16));
+  }
+  else
+  {
+    c->packet_size = 16;
+  }
+  if (c->stream == NULL)
+  {
+    c->stream = c->image;
+    c->stream_size = c->size;
+  }
+  c->packets = (uint16_t)((c->stream_size + c->packet_size - 1) / c->packet_size);
+
+  write[0] = 0x02 | c->mode;
+  put_le32(&write[1], c->size);
+  put_le32(&write[5], c->base);
+  if (c->mode & CLIENT_CRC32)
+  {
+    put_le32(&write[9], ota_client_crc32(0xFFFFFFFF, c->image, c->size) ^ c->image_crc_error);
+    length = 13;
+  }
+  if (c->mode & CLIENT_ENCODED)
+  {
+    put_le32(&write[13], c->stream_size);
+    length = 17;
+  }
+  OTA_Write_Request_CB(c->conn_handle, STUB_NEW_IMAGE_HANDLE + 1, length, write);
+
+  conn->pending = 0;
+  OTA_Write_Request_CB(c->conn_handle, STUB_SEQ_NUM_HANDLE + 2, sizeof(cccd), cccd);
+
+  c->done = 0;
+  c->waiting = 0;
+  c->refused = !conn->pending || (conn->errCode != CLIENT_SUCCESS);
+  c->resumed_from = conn->replyCounter;
+  c->seq = conn->replyCounter;
+  c->window_start = c->seq;
+  c->window = conn->window;
+  conn->pending = 0;
+}
+
+static void send_packet(ota_client_t *c)
+{
+  uint8_t packet[4 + 256];
+  uint8_t *data = &packet[1];
+  uint16_t n = c->packet_size;
+  uint8_t last = (c->seq == (uint16_t)(c->window_start + c->window - 1)) || (c->seq == c->packets - 1);
+  uint8_t checksum = 0;
+
+  for (uint16_t i = 0; i < n; i++)
+  {
+    uint32_t offset = (uint32_t)c->seq * n + i;
+
+    data[i] = (offset < c->stream_size) ? c->stream[offset] : 0;
+  }
+  packet[n + 1] = last;
+  packet[n + 2] = (uint8_t)c->seq;
+  packet[n + 3] = (uint8_t)(c->seq >> 8);
+
+  if (c->mode & CLIENT_CRC32)
+  {
+    if (c->seq == c->window_start)
+    {
+      c->window_crc = 0xFFFFFFFF;
+    }
+    c->window_crc = ota_client_crc32(c->window_crc, data, n);
+    checksum = (uint8_t)(c->window_crc >> (8 * (c->seq % 4)));
+  }
+  else
+  {
+    for (uint16_t i = 0; i < n; i++)
+    {
+      checksum ^= data[i];
+    }
+  }
+  packet[0] = checksum ^ packet[n + 1] ^ packet[n + 2] ^ packet[n + 3];
+
+  if (c->corrupt != NULL)
+  {
+    c->corrupt(c, packet, (uint8_t)(n + 4));
+  }
+
+  c->sent++;
+  c->seq++;
+  if (last)
+  {
+    c->waiting = 1;
+  }
+  OTA_Write_Request_CB(c->conn_handle, STUB_CONTENT_HANDLE + 1, (uint8_t)(n + 4), packet);
+}
+
+uint32_t ota_client_event(ota_client_t *c, uint32_t max_packets)
+{
+  stub_conn_t *conn = stub_get_conn(c->conn_handle);
+  uint32_t sent = 0;
+
+  c->events++;
+  if (conn->pending)
+  {
+    conn->pending = 0;
+    c->waiting = 0;
+    if (conn->errCode != CLIENT_SUCCESS)
+    {
+      c->errors[conn->errCode & 0xFF]++;
+    }
+    else if (conn->replyCounter >= c->packets)
+    {
+      c->done = 1;
+    }
+    c->seq = conn->replyCounter;
+    c->window_start = c->seq;
+    c->window = (c->mode & CLIENT_ADAPTIVE) ? conn->window : DEFAULT_WINDOW;
+    c->window_sum += c->window;
+  }
+  if (c->done || c->refused)
+  {
+    return 0;
+  }
+  if (c->waiting)
+  {
+    c->idle_events++;
+    return 0;
+  }
+
+  while ((sent < max_packets) && !c->waiting && (c->seq < c->packets))
+  {
+    send_packet(c);
+    sent++;
+  }
+  return sent;
+}
+
+void ota_client_disconnect(ota_client_t *c)
+{
+  OTA_Disconnection_Complete_CB(c->conn_handle);
+  stub_get_conn(c->conn_handle)->pending = 0;
+}
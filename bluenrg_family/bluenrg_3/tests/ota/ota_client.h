@@ -0,0 +1,78 @@
+/**
+  ******************************************************************************
+  * @file    ota_client.h
+  * @brief   OTA client model: it sends an image to the OTA server through the
+  *          OTA characteristic callbacks, one connection event at a time.
+  ******************************************************************************
+  */
+
+#ifndef OTA_CLIENT_H
+#define OTA_CLIENT_H
+
+#include <stdint.h>
+
+/* Modes of the first byte of the New Image characteristic */
+#define CLIENT_CRC32     (0x80)
+#define CLIENT_ADAPTIVE  (0x40)
+#define CLIENT_RESUME    (0x20)
+#define CLIENT_ENCODED   (0x10)
+
+/* Notification error codes */
+#define CLIENT_SUCCESS            (0x0000)
+#define CLIENT_FLASH_VERIFY_ERROR (0x003C)
+#define CLIENT_FLASH_WRITE_ERROR  (0x00FF)
+#define CLIENT_SEQUENCE_ERROR     (0x00F0)
+#define CLIENT_CHECKSUM_ERROR     (0x000F)
+#define CLIENT_IMAGE_CRC_ERROR    (0x00C3)
+
+typedef struct ota_client_s ota_client_t;
+
+struct ota_client_s
+{
+  /* Set before ota_client_start() */
+  uint16_t conn_handle;
+  uint16_t att_mtu;          /* 23 if no ATT_MTU exchange and DLE */
+  uint8_t mode;              /* CLIENT_xxx flags */
+  uint32_t base;
+  uint32_t size;
+  const uint8_t *image;
+  const uint8_t *stream;     /* Encoded image for CLIENT_ENCODED, else NULL */
+  uint32_t stream_size;
+  uint32_t image_crc_error;  /* XORed to the image CRC-32 sent to the server */
+  /* Called on each packet before it is sent: it can corrupt the packet */
+  void (*corrupt)(ota_client_t *c, uint8_t *packet, uint8_t length);
+
+  /* Session */
+  uint16_t packet_size;      /* Image bytes per packet */
+  uint16_t packets;          /* Packets of the image */
+  uint16_t seq;              /* Next packet to be sent */
+  uint16_t window_start;
+  uint16_t window;
+  uint32_t window_crc;
+  uint8_t waiting;           /* Waiting for the notification of the window */
+  uint8_t done;
+  uint8_t refused;
+  uint16_t resumed_from;     /* Sequence number notified when notifications are enabled */
+
+  /* Statistics */
+  uint32_t sent;
+  uint32_t events;
+  uint32_t idle_events;      /* Connection events spent waiting for a notification */
+  uint32_t errors[256];      /* Notified errors by code (low byte) */
+  uint32_t window_sum;
+};
+
+/* CRC-32/MPEG-2 as used by the OTA CRC-32 mode */
+uint32_t ota_client_crc32(uint32_t crc, const uint8_t *data, uint32_t size);
+
+/* Connection: ATT_MTU exchange and DLE if att_mtu > 23, New Image write, notifications enabled */
+void ota_client_start(ota_client_t *c);
+
+/* Connection event: the notification of the previous connection event is received, then up to
+   max_packets packets are sent. It returns the packets sent. */
+uint32_t ota_client_event(ota_client_t *c, uint32_t max_packets);
+
+/* Connection lost: the session context is released */
+void ota_client_disconnect(ota_client_t *c);
+
+#endif /* OTA_CLIENT_H */
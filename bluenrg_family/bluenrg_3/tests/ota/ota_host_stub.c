@@ -0,0 +1,186 @@
+/**
+  ******************************************************************************
+  * @file    ota_host_stub.c
+  * @brief   Simulated flash, virtual timer, LEDs and BLE stack functions used
+  *          by the OTA server, recording the notifications of each connection.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "bluenrg_lpx.h"
+#include "rf_driver_ll_flash.h"
+#include "rf_driver_hal_vtimer.h"
+#include "bluenrg_lp_evb_config.h"
+#include "bluenrg_lp_api.h"
+#include "ota_host_stub.h"
+
+stub_conn_t stub_conn[STUB_MAX_CONN];
+
+uint8_t *stub_flash;
+uint32_t stub_flash_erases;
+uint32_t stub_flash_words;
+uint32_t stub_flash_reprogrammed;
+double stub_flash_fail_rate;
+
+int64_t stub_radio_idle_ms = 10;
+
+static uint16_t char_count;
+
+static void *map_fixed(uintptr_t address, size_t size)
+{
+  void *p = mmap((void *)address, size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (p == MAP_FAILED)
+  {
+    abort();
+  }
+  return p;
+}
+
+void stub_reset(void)
+{
+  if (stub_flash == NULL)
+  {
+    stub_flash = map_fixed(_MEMORY_FLASH_BEGIN_, _MEMORY_FLASH_SIZE_);
+    /* RCC: clock enables */
+    map_fixed(RCC_BASE, 0x1000);
+  }
+  memset(stub_flash, 0xFF, _MEMORY_FLASH_SIZE_);
+  memset(stub_conn, 0, sizeof(stub_conn));
+  stub_flash_erases = 0;
+  stub_flash_words = 0;
+  stub_flash_reprogrammed = 0;
+  stub_flash_fail_rate = 0;
+  stub_radio_idle_ms = 10;
+  char_count = 0;
+}
+
+void stub_reboot(void)
+{
+  memset(stub_conn, 0, sizeof(stub_conn));
+  char_count = 0;
+}
+
+void stub_flash_dirty(uint32_t address, uint32_t size)
+{
+  for (uint32_t i = 0; i < size; i++)
+  {
+    stub_flash[address - _MEMORY_FLASH_BEGIN_ + i] = (uint8_t)rand();
+  }
+}
+
+stub_conn_t *stub_get_conn(uint16_t conn_handle)
+{
+  return &stub_conn[conn_handle % STUB_MAX_CONN];
+}
+
+/* Flash: programming can only clear bits */
+void LL_FLASH_Program(FLASH_TypeDef *FLASHx, uint32_t Address, uint32_t Data)
+{
+  uint32_t *word = (uint32_t *)(uintptr_t)Address;
+
+  stub_flash_words++;
+  if (*word != 0xFFFFFFFF)
+  {
+    stub_flash_reprogrammed++;
+  }
+  if ((double)rand() / RAND_MAX < stub_flash_fail_rate)
+  {
+    /* A bit is left erased: programming the word again fixes it */
+    Data |= 1U << (rand() % 32);
+  }
+  *word &= Data;
+}
+
+void LL_FLASH_ProgramBurst(FLASH_TypeDef *FLASHx, uint32_t Address, uint32_t *Data)
+{
+  for (uint32_t i = 0; i < 4; i++)
+  {
+    LL_FLASH_Program(FLASHx, Address + 4 * i, Data[i]);
+  }
+}
+
+void LL_FLASH_Erase(FLASH_TypeDef *FLASHx, uint32_t TypeErase, uint32_t Page, uint32_t NbPages)
+{
+  stub_flash_erases += NbPages;
+  memset(&stub_flash[Page * LL_FLASH_PAGE_SIZE], 0xFF, NbPages * LL_FLASH_PAGE_SIZE);
+}
+
+/* Virtual timer: the next radio activity is stub_radio_idle_ms away */
+uint64_t HAL_VTIMER_GetCurrentSysTime(void)
+{
+  return 0;
+}
+
+int64_t HAL_VTIMER_DiffSysTimeMs(uint64_t sysTime1, uint64_t sysTime2)
+{
+  return stub_radio_idle_ms;
+}
+
+void BSP_LED_Init(Led_TypeDef Led)
+{
+}
+
+void BSP_LED_On(Led_TypeDef Led)
+{
+}
+
+void BSP_LED_Off(Led_TypeDef Led)
+{
+}
+
+/* GATT and GAP */
+tBleStatus aci_gatt_srv_add_service(ble_gatt_srv_def_t *Serv_p)
+{
+  return BLE_STATUS_SUCCESS;
+}
+
+uint16_t aci_gatt_srv_get_char_decl_handle(ble_gatt_chr_def_t *Char_p)
+{
+  return (uint16_t)(STUB_IMAGE_HANDLE * ++char_count);
+}
+
+tBleStatus aci_gatt_srv_resp(uint16_t Connection_Handle, uint16_t Attr_Handle, uint8_t Error_Code,
+                             uint16_t Val_Length, uint8_t Val[])
+{
+  return BLE_STATUS_SUCCESS;
+}
+
+tBleStatus aci_gatt_srv_notify(uint16_t Connection_Handle, uint16_t Attr_Handle, uint8_t Flags,
+                               uint16_t Val_Length, uint8_t Val[])
+{
+  stub_conn_t *conn = stub_get_conn(Connection_Handle);
+
+  if (conn->pending)
+  {
+    conn->overwritten++;
+  }
+  conn->pending = 1;
+  conn->count++;
+  conn->replyCounter = (uint16_t)(Val[0] | (Val[1] << 8));
+  conn->errCode = (uint16_t)(Val[2] | (Val[3] << 8));
+  conn->window = (Val_Length >= 6) ? (uint16_t)(Val[4] | (Val[5] << 8)) : 8;
+
+  return BLE_STATUS_SUCCESS;
+}
+
+tBleStatus aci_hal_set_radio_activity_mask(uint16_t Radio_Activity_Mask)
+{
+  return BLE_STATUS_SUCCESS;
+}
+
+tBleStatus aci_gap_terminate(uint16_t Connection_Handle, uint8_t Reason)
+{
+  stub_get_conn(Connection_Handle)->terminated = 1;
+
+  return BLE_STATUS_SUCCESS;
+}
+
+tBleStatus aci_l2cap_connection_parameter_update_req(uint16_t Connection_Handle, uint16_t Conn_Interval_Min,
+                                                     uint16_t Conn_Interval_Max, uint16_t Slave_latency,
+                                                     uint16_t Timeout_Multiplier)
+{
+  return BLE_STATUS_SUCCESS;
+}
@@ -0,0 +1,59 @@
+/**
+  ******************************************************************************
+  * @file    ota_host_stub.h
+  * @brief   Simulated flash, virtual timer, LEDs and BLE stack functions used
+  *          by the OTA server, recording the notifications of each connection.
+  ******************************************************************************
+  */
+
+#ifndef OTA_HOST_STUB_H
+#define OTA_HOST_STUB_H
+
+#include <stdint.h>
+
+/* Characteristic declaration handles given to the OTA service, in order */
+#define STUB_IMAGE_HANDLE       (0x0010)
+#define STUB_NEW_IMAGE_HANDLE   (0x0020)
+#define STUB_CONTENT_HANDLE     (0x0030)
+#define STUB_SEQ_NUM_HANDLE     (0x0040)
+
+/* Connections are recorded by (handle % STUB_MAX_CONN) */
+#define STUB_MAX_CONN           (16)
+
+typedef struct
+{
+  uint8_t  pending;       /* Notification not yet read by the client model */
+  uint16_t replyCounter;
+  uint16_t errCode;
+  uint16_t window;        /* NOTIFICATION_WINDOW if not sent */
+  uint32_t count;
+  uint32_t overwritten;   /* Notifications sent before the previous one was read */
+  uint8_t  terminated;    /* aci_gap_terminate() called */
+} stub_conn_t;
+
+extern stub_conn_t stub_conn[STUB_MAX_CONN];
+
+/* Flash: the device flash range is mapped at its device address */
+extern uint8_t *stub_flash;
+extern uint32_t stub_flash_erases;
+extern uint32_t stub_flash_words;
+/* Words programmed over a word that was not blank */
+extern uint32_t stub_flash_reprogrammed;
+/* Probability of a bit left erased on a programmed word */
+extern double stub_flash_fail_rate;
+
+/* Radio idle time (ms) reported by HAL_VTIMER_DiffSysTimeMs() */
+extern int64_t stub_radio_idle_ms;
+
+/* Maps the flash on the first call, then fills it with 0xFF and resets the recorders */
+void stub_reset(void);
+
+/* Device reset: the recorders are reset, the flash is kept */
+void stub_reboot(void);
+
+/* Fills [address, address + size) with random bytes */
+void stub_flash_dirty(uint32_t address, uint32_t size);
+
+stub_conn_t *stub_get_conn(uint16_t conn_handle);
+
+#endif /* OTA_HOST_STUB_H */
@@ -0,0 +1,270 @@
+/**
+  ******************************************************************************
+  * @file    test_ota_crc.c
+  * @brief   OTA packet and image integrity: bit errors are injected in the
+  *          packets, the detection rate of the legacy XOR checksum and of the
+  *          CRC-32 mode is measured, and the image CRC-32 catches the errors
+  *          that get through.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include "test_assert.h"
+#include "ota_host_stub.h"
+#include "ota_client.h"
+#include "OTA_btl.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define IMAGE_SIZE      (32768)
+#define MAX_EVENTS      (200000)
+
+typedef enum
+{
+  ERROR_SINGLE_BIT,     /* 1 bit */
+  ERROR_SAME_BIT,       /* The same bit of 2 bytes: the XOR checksum is blind to it */
+  ERROR_RANDOM_BITS,    /* 2 to 8 bits anywhere in the packet data */
+  ERROR_BURST,          /* Burst of up to 16 bits */
+  ERROR_PATTERNS
+} error_pattern_t;
+
+static const char *pattern_name[ERROR_PATTERNS] = { "single bit", "same bit of 2 bytes", "2-8 random bits", "burst <= 16 bits" };
+
+static uint8_t image[IMAGE_SIZE];
+
+/* Error injection: at most one corrupted packet per window */
+static error_pattern_t pattern;
+static double corrupt_rate;
+static uint8_t window_corrupted;
+static uint32_t corrupted_windows;
+static uint8_t recompute_checksum;
+
+static void flip(uint8_t *data, uint32_t bit)
+{
+  data[bit / 8] ^= (uint8_t)(1U << (bit % 8));
+}
+
+static void corrupt(ota_client_t *c, uint8_t *packet, uint8_t length)
+{
+  uint8_t *data = &packet[1];
+  uint32_t bits = 8U * c->packet_size;
+
+  if (c->seq == c->window_start)
+  {
+    window_corrupted = 0;
+  }
+  if (window_corrupted || ((double)rand() / RAND_MAX >= corrupt_rate))
+  {
+    return;
+  }
+  window_corrupted = 1;
+  corrupted_windows++;
+
+  switch (pattern)
+  {
+  case ERROR_SINGLE_BIT:
+    flip(data, rand() % bits);
+    break;
+  case ERROR_SAME_BIT:
+    {
+      uint32_t bit = rand() % 8;
+      uint32_t first = rand() % c->packet_size;
+      uint32_t second = (first + 1 + rand() % (c->packet_size - 1)) % c->packet_size;
+
+      data[first] ^= (uint8_t)(1U << bit);
+      data[second] ^= (uint8_t)(1U << bit);
+    }
+    break;
+  case ERROR_RANDOM_BITS:
+    {
+      uint32_t n = 2 + rand() % 7;
+      uint32_t first = rand() % bits;
+
+      /* distinct bits */
+      for (uint32_t i = 0; i < n; i++)
+      {
+        flip(data, (first + i * (1 + rand() % (bits / 8))) % bits);
+      }
+    }
+    break;
+  default:
+    {
+      uint32_t start = rand() % (bits - 16);
+      uint32_t len = 2 + rand() % 15;
+
+      flip(data, start);
+      flip(data, start + len - 1);
+      for (uint32_t i = 1; i < len - 1; i++)
+      {
+        if (rand() & 1)
+        {
+          flip(data, start + i);
+        }
+      }
+    }
+    break;
+  }
+
+  if (recompute_checksum)
+  {
+    /* The data is corrupted before the checksum is computed: the packet is valid */
+    uint8_t checksum = 0;
+
+    c->window_crc = 0xFFFFFFFF;
+    for (uint16_t seq = c->window_start; seq <= c->seq; seq++)
+    {
+      uint8_t block[256];
+
+      memcpy(block, (seq == c->seq) ? data : &image[seq * c->packet_size], c->packet_size);
+      c->window_crc = ota_client_crc32(c->window_crc, block, c->packet_size);
+    }
+    checksum = (uint8_t)(c->window_crc >> (8 * (c->seq % 4)));
+    packet[0] = checksum ^ packet[length - 3] ^ packet[length - 2] ^ packet[length - 1];
+  }
+}
+
+static int image_on_flash(uint32_t base)
+{
+  const uint8_t *flash = &stub_flash[base - _MEMORY_FLASH_BEGIN_];
+
+  return (memcmp(flash, image, OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET) == 0) &&
+         (memcmp(flash + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4, image + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4,
+                 IMAGE_SIZE - OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET - 4) == 0);
+}
+
+static uint32_t tag_word(uint32_t base)
+{
+  uint32_t word;
+
+  memcpy(&word, &stub_flash[base - _MEMORY_FLASH_BEGIN_ + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET], 4);
+  return word;
+}
+
+static void start(ota_client_t *c, uint8_t mode)
+{
+  stub_reset();
+  TEST_CHECK_EQUAL(OTA_Add_Btl_Service(), BLE_STATUS_SUCCESS);
+
+  memset(c, 0, sizeof(*c));
+  c->conn_handle = 0x0801;
+  c->mode = mode;
+  c->base = APP_HIGHER_ADDRESS;
+  c->size = IMAGE_SIZE;
+  c->image = image;
+  c->corrupt = corrupt;
+  ota_client_start(c);
+  TEST_CHECK(!c->refused);
+}
+
+static void transfer(ota_client_t *c, uint16_t stop_on_error)
+{
+  while (!c->done && (c->events < MAX_EVENTS) && ((stop_on_error == 0) || (c->errors[stop_on_error] == 0)))
+  {
+    ota_client_event(c, 6);
+    OTA_Radio_Activity(0);
+  }
+}
+
+/* Share of the corrupted windows notified with a checksum error */
+static double detection_rate(uint8_t mode, error_pattern_t p)
+{
+  static ota_client_t c;
+
+  pattern = p;
+  corrupt_rate = 0.05;
+  corrupted_windows = 0;
+  recompute_checksum = 0;
+  start(&c, mode);
+  transfer(&c, (mode & CLIENT_CRC32) ? (CLIENT_IMAGE_CRC_ERROR & 0xFF) : 0);
+  OTA_Disconnection_Complete_CB(c.conn_handle);
+
+  TEST_CHECK(corrupted_windows > 50);
+  return (double)c.errors[CLIENT_CHECKSUM_ERROR] / corrupted_windows;
+}
+
+static void test_detection_rate(void)
+{
+  for (error_pattern_t p = ERROR_SINGLE_BIT; p < ERROR_PATTERNS; p++)
+  {
+    double xor_rate = detection_rate(0, p);
+    double crc_rate = detection_rate(CLIENT_CRC32, p);
+
+    printf("%-20s XOR checksum %6.2f%%, CRC-32 %6.2f%%\n", pattern_name[p], 100 * xor_rate, 100 * crc_rate);
+    TEST_CHECK(crc_rate >= 0.99);
+    if (p == ERROR_SINGLE_BIT)
+    {
+      TEST_CHECK_EQUAL(xor_rate, 1);
+    }
+    if (p == ERROR_SAME_BIT)
+    {
+      TEST_CHECK_EQUAL(xor_rate, 0);
+    }
+  }
+}
+
+/* The errors missed by the packet checksum are found by the image CRC-32: the image is sent again */
+static void test_image_crc_catches_missed_errors(void)
+{
+  static ota_client_t c;
+
+  pattern = ERROR_RANDOM_BITS;
+  corrupt_rate = 0.01;
+  corrupted_windows = 0;
+  recompute_checksum = 1;
+  start(&c, CLIENT_CRC32);
+  transfer(&c, CLIENT_IMAGE_CRC_ERROR & 0xFF);
+
+  TEST_CHECK(corrupted_windows > 0);
+  TEST_CHECK_EQUAL(c.errors[CLIENT_CHECKSUM_ERROR], 0);
+  TEST_CHECK_EQUAL(c.errors[CLIENT_IMAGE_CRC_ERROR & 0xFF], 1);
+  TEST_CHECK_EQUAL(c.window_start, 0);
+  TEST_CHECK_EQUAL(tag_word(c.base), OTA_IN_PROGRESS_TAG);
+
+  /* Sent again without errors */
+  corrupt_rate = 0;
+  transfer(&c, 0);
+  TEST_CHECK(c.done);
+  TEST_CHECK(image_on_flash(c.base));
+  TEST_CHECK_EQUAL(tag_word(c.base), OTA_VALID_TAG);
+  OTA_Disconnection_Complete_CB(c.conn_handle);
+}
+
+/* An image CRC-32 that does not match the image sent is never tagged as valid */
+static void test_wrong_image_crc(void)
+{
+  static ota_client_t c;
+
+  corrupt_rate = 0;
+  stub_reset();
+  TEST_CHECK_EQUAL(OTA_Add_Btl_Service(), BLE_STATUS_SUCCESS);
+  memset(&c, 0, sizeof(c));
+  c.conn_handle = 0x0801;
+  c.mode = CLIENT_CRC32;
+  c.base = APP_HIGHER_ADDRESS;
+  c.size = IMAGE_SIZE;
+  c.image = image;
+  c.image_crc_error = 0x00010000;
+  ota_client_start(&c);
+  transfer(&c, CLIENT_IMAGE_CRC_ERROR & 0xFF);
+
+  TEST_CHECK(!c.done);
+  TEST_CHECK_EQUAL(c.errors[CLIENT_IMAGE_CRC_ERROR & 0xFF], 1);
+  TEST_CHECK_EQUAL(tag_word(c.base), OTA_IN_PROGRESS_TAG);
+  TEST_CHECK_EQUAL(OTA_Tick(), 0);
+  OTA_Disconnection_Complete_CB(c.conn_handle);
+}
+
+int main(void)
+{
+  srand(3);
+  for (uint32_t i = 0; i < IMAGE_SIZE; i++)
+  {
+    image[i] = (uint8_t)rand();
+  }
+
+  test_detection_rate();
+  test_image_crc_catches_missed_errors();
+  test_wrong_image_crc();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,447 @@
+/**
+  ******************************************************************************
+  * @file    test_ota_encoded.c
+  * @brief   Encoded OTA images: compressed and delta encoded images are decoded
+  *          while they are programmed. It reports the bytes sent and the
+  *          connection events against the raw image, and checks that a stream
+  *          not decoding to the image is never tagged as valid.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include "test_assert.h"
+#include "ota_host_stub.h"
+#include "ota_client.h"
+
+#define OTA_ENCODED_IMAGE
+#include "OTA_btl.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define IMAGE_SIZE      (100000)
+#define MAX_EVENTS      (1000000)
+#define MIN_MATCH       (6)
+#define MAX_COPY        (OTA_TOKEN_LENGTH_MASK + OTA_TOKEN_MIN_COPY + 0xFFFF)
+#define MAX_DISTANCE    (0xFFFF)
+#define MAX_CHAIN       (64)
+#define HASH_SIZE       (1 << 16)
+
+static uint8_t base[IMAGE_SIZE];
+static uint8_t image[IMAGE_SIZE + 512];
+static uint32_t image_size;
+static uint8_t stream[2 * IMAGE_SIZE];
+static uint32_t stream_size;
+static double loss_rate;
+
+/* Greedy encoder: copies from the image already encoded (hash chains) and, for delta images, from the base image */
+static int32_t head[HASH_SIZE], chain[IMAGE_SIZE + 512];
+static int32_t base_head[HASH_SIZE], base_chain[IMAGE_SIZE];
+
+static uint32_t hash(const uint8_t *p)
+{
+  return ((p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24)) * 2654435761U) >> 16;
+}
+
+static uint32_t match_length(const uint8_t *a, const uint8_t *b, uint32_t max)
+{
+  uint32_t n = 0;
+
+  while ((n < max) && (a[n] == b[n]))
+  {
+    n++;
+  }
+  return n;
+}
+
+static void put(uint32_t value, uint32_t bytes)
+{
+  for (uint32_t i = 0; i < bytes; i++)
+  {
+    stream[stream_size++] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static void flush_literals(const uint8_t *data, uint32_t *start, uint32_t end)
+{
+  while (*start < end)
+  {
+    uint32_t n = MIN(end - *start, OTA_TOKEN_LITERAL_MASK + 1);
+
+    put(n - 1, 1);
+    memcpy(&stream[stream_size], &data[*start], n);
+    stream_size += n;
+    *start += n;
+  }
+}
+
+static void put_copy(uint8_t base_copy, uint32_t length, uint32_t arg)
+{
+  uint8_t token = OTA_TOKEN_COPY | (base_copy ? OTA_TOKEN_BASE_COPY : 0);
+
+  if ((length - OTA_TOKEN_MIN_COPY) < OTA_TOKEN_LENGTH_MASK)
+  {
+    put(token | (length - OTA_TOKEN_MIN_COPY), 1);
+  }
+  else
+  {
+    put(token | OTA_TOKEN_LENGTH_MASK, 1);
+    put(length - OTA_TOKEN_LENGTH_MASK - OTA_TOKEN_MIN_COPY, 2);
+  }
+  put(arg, base_copy ? 3 : 2);
+}
+
+static void encode(const uint8_t *data, uint32_t size, const uint8_t *base_image, uint32_t base_size)
+{
+  uint32_t literal = 0;
+  uint32_t i = 0;
+
+  stream_size = 0;
+  memset(head, -1, sizeof(head));
+  memset(base_head, -1, sizeof(base_head));
+  for (uint32_t j = 0; (base_image != NULL) && (j + 4 <= base_size); j++)
+  {
+    base_chain[j] = base_head[hash(&base_image[j])];
+    base_head[hash(&base_image[j])] = (int32_t)j;
+  }
+
+  while (i < size)
+  {
+    uint32_t best = 0, best_arg = 0, h;
+    uint8_t best_base = 0;
+
+    if (i + 4 <= size)
+    {
+      h = hash(&data[i]);
+      for (int32_t j = head[h], k = 0; (j >= 0) && ((i - j) <= MAX_DISTANCE) && (k < MAX_CHAIN); j = chain[j], k++)
+      {
+        uint32_t n = match_length(&data[j], &data[i], MIN(size - i, MAX_COPY));
+
+        if (n > best)
+        {
+          best = n;
+          best_arg = i - j;
+          best_base = 0;
+        }
+      }
+      for (int32_t j = base_head[h], k = 0; (j >= 0) && (k < MAX_CHAIN); j = base_chain[j], k++)
+      {
+        /* The validity tag of the running image is not copied */
+        uint32_t offset = (uint32_t)j;
+        uint32_t max = MIN(size - i, MAX_COPY);
+        uint32_t n;
+
+        if ((offset < OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4) && (offset + max > OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET))
+        {
+          if (offset >= OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET)
+            continue;
+          max = MIN(max, OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET - offset);
+        }
+        max = MIN(max, base_size - offset);
+        n = match_length(&base_image[offset], &data[i], max);
+        /* A base copy argument takes one more byte */
+        if (n > best + 1)
+        {
+          best = n;
+          best_arg = offset;
+          best_base = 1;
+        }
+      }
+    }
+
+    if (best < MIN_MATCH)
+    {
+      best = 1;
+    }
+    else
+    {
+      flush_literals(data, &literal, i);
+      put_copy(best_base, best, best_arg);
+      literal = i + best;
+    }
+    for (uint32_t n = 0; n < best; n++, i++)
+    {
+      if (i + 4 <= size)
+      {
+        h = hash(&data[i]);
+        chain[i] = head[h];
+        head[h] = (int32_t)i;
+      }
+    }
+  }
+  flush_literals(data, &literal, size);
+}
+
+/* Firmware-like image: code snippets picked from a small set, with constants and data between them */
+static void make_base(void)
+{
+  static uint8_t snippets[48][40];
+
+  for (uint32_t s = 0; s < 48; s++)
+  {
+    for (uint32_t j = 0; j < 40; j++)
+    {
+      snippets[s][j] = (uint8_t)rand();
+    }
+  }
+  for (uint32_t i = 0; i < IMAGE_SIZE;)
+  {
+    if (rand() % 3)
+    {
+      uint32_t n = MIN((uint32_t)(8 + rand() % 32), IMAGE_SIZE - i);
+
+      memcpy(&base[i], snippets[rand() % 48], n);
+      i += n;
+    }
+    else
+    {
+      for (uint32_t n = 4 + rand() % 16; (n > 0) && (i < IMAGE_SIZE); n--)
+      {
+        base[i++] = (uint8_t)rand();
+      }
+    }
+  }
+}
+
+/* The base image with a few functions changed and code inserted: the code after it moves */
+static void make_delta_image(void)
+{
+  memcpy(image, base, 30000);
+  for (uint32_t i = 0; i < 300; i++)
+  {
+    image[30000 + i] = (uint8_t)rand();
+  }
+  memcpy(&image[30300], &base[30000], IMAGE_SIZE - 30000);
+  image_size = IMAGE_SIZE + 300;
+  for (uint32_t i = 0; i < 3; i++)
+  {
+    uint32_t offset = 1000 + rand() % (image_size - 2000);
+
+    for (uint32_t j = 0; j < 100; j++)
+    {
+      image[offset + j] = (uint8_t)rand();
+    }
+  }
+  /* Moved code: the literal pool addresses change */
+  for (uint32_t offset = 30300; offset < image_size - 4; offset += 2048)
+  {
+    image[offset] += 1;
+  }
+}
+
+/* A lost packet: the next packet has an unexpected sequence number */
+static void corrupt(ota_client_t *c, uint8_t *packet, uint8_t length)
+{
+  if ((double)rand() / RAND_MAX < loss_rate)
+  {
+    packet[length - 1] ^= 0x80;
+  }
+}
+
+static int image_on_flash(uint32_t address, const uint8_t *data, uint32_t size)
+{
+  const uint8_t *flash = &stub_flash[address - _MEMORY_FLASH_BEGIN_];
+
+  return (memcmp(flash, data, OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET) == 0) &&
+         (memcmp(flash + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4, data + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4,
+                 size - OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET - 4) == 0);
+}
+
+static uint32_t tag_word(uint32_t address)
+{
+  uint32_t word;
+
+  memcpy(&word, &stub_flash[address - _MEMORY_FLASH_BEGIN_ + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET], 4);
+  return word;
+}
+
+/* Device with the base image running */
+static void reset(void)
+{
+  uint32_t tag = OTA_VALID_TAG;
+
+  stub_reset();
+  memcpy(&stub_flash[OTA_BASE_IMAGE_ADDRESS - _MEMORY_FLASH_BEGIN_], base, IMAGE_SIZE);
+  memcpy(&stub_flash[OTA_BASE_IMAGE_ADDRESS - _MEMORY_FLASH_BEGIN_ + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET], &tag, 4);
+  TEST_CHECK_EQUAL(OTA_Add_Btl_Service(), BLE_STATUS_SUCCESS);
+}
+
+static void start(ota_client_t *c, uint16_t att_mtu, uint8_t mode)
+{
+  memset(c, 0, sizeof(*c));
+  c->conn_handle = 0x0801;
+  c->att_mtu = att_mtu;
+  c->mode = CLIENT_CRC32 | mode;
+  c->base = APP_HIGHER_ADDRESS;
+  c->size = image_size;
+  c->image = image;
+  if (mode & CLIENT_ENCODED)
+  {
+    c->stream = stream;
+    c->stream_size = stream_size;
+  }
+  c->corrupt = corrupt;
+  ota_client_start(c);
+  TEST_CHECK(!c->refused);
+}
+
+static void transfer(ota_client_t *c, uint16_t stop_on_error)
+{
+  while (!c->done && (c->events < MAX_EVENTS) && ((stop_on_error == 0) || (c->errors[stop_on_error] == 0)))
+  {
+    ota_client_event(c, (c->att_mtu > 23) ? 4 : 6);
+    OTA_Radio_Activity(0);
+  }
+}
+
+/* Connection events of the transfer */
+static uint32_t run(uint16_t att_mtu, uint8_t mode)
+{
+  static ota_client_t c;
+
+  reset();
+  start(&c, att_mtu, mode);
+  transfer(&c, 0);
+
+  TEST_CHECK(c.done);
+  TEST_CHECK(image_on_flash(c.base, image, image_size));
+  TEST_CHECK_EQUAL(tag_word(c.base), OTA_VALID_TAG);
+  TEST_CHECK_EQUAL(tag_word(OTA_BASE_IMAGE_ADDRESS), OTA_INVALID_OLD_TAG);
+  TEST_CHECK_EQUAL(c.errors[CLIENT_IMAGE_CRC_ERROR & 0xFF], 0);
+  if ((loss_rate == 0) && (stub_flash_fail_rate == 0))
+  {
+    TEST_CHECK_EQUAL(c.sent, c.packets);
+  }
+  OTA_Disconnection_Complete_CB(c.conn_handle);
+
+  return c.events;
+}
+
+static void compare(const char *name, double max_ratio)
+{
+  static const uint16_t att_mtu[] = { 23, 245 };
+
+  printf("%-6s image %6u bytes, sent %6u bytes (%5.1f%%)\n", name, image_size, stream_size, 100.0 * stream_size / image_size);
+  TEST_CHECK(stream_size < max_ratio * image_size);
+  for (uint32_t m = 0; m < 2; m++)
+  {
+    uint32_t raw = run(att_mtu[m], 0);
+    uint32_t encoded = run(att_mtu[m], CLIENT_ENCODED);
+
+    printf("       ATT_MTU %3u: raw %5u connection events, encoded %5u connection events\n", att_mtu[m], raw, encoded);
+    TEST_CHECK(encoded < raw);
+  }
+}
+
+/* Compressed image: copies from the image already decoded only */
+static void test_compressed(void)
+{
+  memcpy(image, base, IMAGE_SIZE);
+  image_size = IMAGE_SIZE;
+  encode(image, image_size, NULL, 0);
+  compare("LZ", 0.8);
+}
+
+/* Delta encoded image: copies from the running image too */
+static void test_delta(void)
+{
+  make_delta_image();
+  encode(image, image_size, base, IMAGE_SIZE);
+  compare("delta", 0.1);
+}
+
+/* Lost packets and flash write failures: the decoder restarts from its state at the beginning of the window */
+static void test_errors(void)
+{
+  make_delta_image();
+  encode(image, image_size, base, IMAGE_SIZE);
+  loss_rate = 0.02;
+  stub_flash_fail_rate = 1e-4;
+  run(23, CLIENT_ENCODED);
+  run(245, CLIENT_ENCODED);
+  loss_rate = 0;
+  stub_flash_fail_rate = 0;
+}
+
+/* Streams not decoding to the image: the image CRC-32 error is notified and the image is never tagged as valid */
+static void test_invalid_stream(void)
+{
+  static const struct
+  {
+    uint8_t length;
+    uint8_t bytes[4];
+  } bad_token[] = {
+    { 3, { OTA_TOKEN_COPY, 0x00, 0x10 } },                             /* Copy before the image start */
+    { 3, { OTA_TOKEN_COPY, 0x00, 0x00 } },                             /* Copy at distance 0 */
+    { 4, { OTA_TOKEN_COPY | OTA_TOKEN_BASE_COPY, 0xFE, 0xFF, 0xFF } }, /* Copy after the base image end */
+  };
+  static ota_client_t c;
+
+  memcpy(image, base, IMAGE_SIZE);
+  image_size = IMAGE_SIZE;
+  for (uint32_t t = 0; t < 4; t++)
+  {
+    encode(image, image_size, NULL, 0);
+    if (t < 3)
+    {
+      /* The bad copy is skipped: the stream then decodes to the image length */
+      memmove(&stream[bad_token[t].length], stream, stream_size);
+      memcpy(stream, bad_token[t].bytes, bad_token[t].length);
+      stream_size += bad_token[t].length;
+    }
+    else
+    {
+      /* Truncated stream */
+      stream_size /= 2;
+    }
+
+    reset();
+    start(&c, 245, CLIENT_ENCODED);
+    transfer(&c, CLIENT_IMAGE_CRC_ERROR & 0xFF);
+    TEST_CHECK(!c.done);
+    TEST_CHECK_EQUAL(c.errors[CLIENT_IMAGE_CRC_ERROR & 0xFF], 1);
+    TEST_CHECK_EQUAL(tag_word(c.base), OTA_IN_PROGRESS_TAG);
+    TEST_CHECK_EQUAL(tag_word(OTA_BASE_IMAGE_ADDRESS), OTA_VALID_TAG);
+    TEST_CHECK_EQUAL(OTA_Tick(), 0);
+    OTA_Disconnection_Complete_CB(c.conn_handle);
+  }
+}
+
+/* Encoded transfers are not resumed */
+static void test_no_resume(void)
+{
+  static ota_client_t c;
+
+  memcpy(image, base, IMAGE_SIZE);
+  image_size = IMAGE_SIZE;
+  encode(image, image_size, NULL, 0);
+  reset();
+  start(&c, 23, CLIENT_ENCODED | CLIENT_RESUME);
+  for (uint32_t event = 0; event < 400; event++)
+  {
+    ota_client_event(&c, 6);
+    OTA_Radio_Activity(0);
+  }
+  TEST_CHECK(!c.done);
+  ota_client_disconnect(&c);
+
+  start(&c, 23, CLIENT_ENCODED | CLIENT_RESUME);
+  TEST_CHECK_EQUAL(c.resumed_from, 0);
+  transfer(&c, 0);
+  TEST_CHECK(c.done);
+  TEST_CHECK(image_on_flash(c.base, image, image_size));
+  OTA_Disconnection_Complete_CB(c.conn_handle);
+}
+
+int main(void)
+{
+  srand(13);
+  make_base();
+
+  test_compressed();
+  test_delta();
+  test_errors();
+  test_invalid_stream();
+  test_no_resume();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,263 @@
+/**
+  ******************************************************************************
+  * @file    test_ota_links.c
+  * @brief   Concurrent OTA sessions: each connection gets its own session when
+  *          it writes the New Image characteristic, the image of each session
+  *          is tagged by its base address, and the connections are terminated
+  *          only when no session is still transferring an image.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include "test_assert.h"
+#include "ota_host_stub.h"
+#include "ota_client.h"
+
+#define OTA_MAX_LINKS 4
+#include "OTA_btl.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define LINKS           (OTA_MAX_LINKS)
+#define IMAGE_SIZE      (24 * 1024)
+#define IMAGE_SPACING   (32 * 1024)
+#define MAX_EVENTS      (100000)
+
+static uint8_t image[LINKS][IMAGE_SIZE];
+static ota_client_t client[LINKS];
+
+static uint16_t conn_handle(uint32_t i)
+{
+  return (uint16_t)(0x0801 + i);
+}
+
+static int image_on_flash(const ota_client_t *c)
+{
+  const uint8_t *flash = &stub_flash[c->base - _MEMORY_FLASH_BEGIN_];
+
+  return (memcmp(flash, c->image, OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET) == 0) &&
+         (memcmp(flash + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4, c->image + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4,
+                 c->size - OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET - 4) == 0);
+}
+
+static uint32_t tag_word(uint32_t base)
+{
+  uint32_t word;
+
+  memcpy(&word, &stub_flash[base - _MEMORY_FLASH_BEGIN_ + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET], 4);
+  return word;
+}
+
+/* Session i: the first one sends the application image, the other ones data images in the free space after it.
+   The sessions with an even index use the ATT_MTU 245 */
+static void start(uint32_t i, uint32_t size)
+{
+  ota_client_t *c = &client[i];
+
+  memset(c, 0, sizeof(*c));
+  c->conn_handle = conn_handle(i);
+  c->att_mtu = (i % 2) ? 23 : 245;
+  c->mode = CLIENT_CRC32;
+  c->base = APP_HIGHER_ADDRESS + i * IMAGE_SPACING;
+  c->size = size;
+  c->image = image[i];
+  ota_client_start(c);
+}
+
+/* Connection events of all the sessions */
+static void run_events(uint32_t count)
+{
+  for (uint32_t event = 0; event < count; event++)
+  {
+    for (uint32_t i = 0; i < LINKS; i++)
+    {
+      if (client[i].conn_handle != 0)
+      {
+        ota_client_event(&client[i], 4);
+      }
+    }
+    OTA_Radio_Activity(0);
+  }
+}
+
+/* Connection events of session i only, until it has completed its image */
+static void run_until_done(uint32_t i)
+{
+  while (!client[i].done && (client[i].events < MAX_EVENTS))
+  {
+    ota_client_event(&client[i], 4);
+    OTA_Radio_Activity(0);
+  }
+  TEST_CHECK(client[i].done);
+}
+
+static void reset(void)
+{
+  stub_reset();
+  memset(client, 0, sizeof(client));
+  TEST_CHECK_EQUAL(OTA_Add_Btl_Service(), BLE_STATUS_SUCCESS);
+}
+
+/* Reads, ATT_MTU and data length exchanges do not take an OTA session: only the New Image write does */
+static void test_session_allocation(void)
+{
+  ota_client_t extra = { 0 };
+
+  reset();
+  for (uint16_t handle = 0x0810; handle < 0x0818; handle++)
+  {
+    OTA_att_exchange_mtu_resp_CB(handle, 245);
+    OTA_data_length_change_CB(handle);
+    OTA_Read_Char(handle, STUB_NEW_IMAGE_HANDLE + 1, 0);
+    OTA_Read_Char(handle, STUB_SEQ_NUM_HANDLE + 1, 0);
+  }
+  for (uint32_t i = 0; i < LINKS; i++)
+  {
+    TEST_CHECK_EQUAL(ota_link[i].conn_handle, OTA_INVALID_CONN_HANDLE);
+  }
+
+  for (uint32_t i = 0; i < LINKS; i++)
+  {
+    start(i, IMAGE_SIZE);
+    TEST_CHECK(!client[i].refused);
+  }
+  /* The ATT_MTU agreed on each connection is used by its session */
+  TEST_CHECK_EQUAL(client[0].packet_size, 224);
+  TEST_CHECK_EQUAL(client[1].packet_size, 16);
+
+  /* No session left */
+  extra.conn_handle = 0x0805;
+  extra.base = APP_HIGHER_ADDRESS + (LINKS - 1) * IMAGE_SPACING;
+  extra.size = IMAGE_SIZE;
+  extra.image = image[0];
+  ota_client_start(&extra);
+  TEST_CHECK(extra.refused);
+
+  /* A session is freed by the disconnection */
+  ota_client_disconnect(&client[3]);
+  client[3].conn_handle = 0;
+  ota_client_start(&extra);
+  TEST_CHECK(!extra.refused);
+
+  for (uint32_t i = 0; i < LINKS - 1; i++)
+  {
+    ota_client_disconnect(&client[i]);
+  }
+  ota_client_disconnect(&extra);
+}
+
+/* All the sessions complete: the application image is tagged, the data images are not, and the connections
+   are terminated only once the last session has completed */
+static void test_concurrent_sessions(void)
+{
+  reset();
+  /* The application image is the shortest one: it completes first */
+  start(0, IMAGE_SIZE / 2);
+  for (uint32_t i = 1; i < LINKS; i++)
+  {
+    start(i, IMAGE_SIZE);
+  }
+
+  /* The sessions are interleaved, then each one completes in turn */
+  run_events(8);
+  for (uint32_t i = 0; i < LINKS; i++)
+  {
+    TEST_CHECK(client[i].sent > 0);
+    TEST_CHECK(!client[i].done);
+  }
+
+  run_until_done(0);
+  TEST_CHECK_EQUAL(tag_word(client[0].base), OTA_VALID_TAG);
+  TEST_CHECK_EQUAL(tag_word(APP_LOWER_ADDRESS), OTA_INVALID_OLD_TAG);
+  TEST_CHECK_EQUAL(OTA_Tick(), 0);
+  TEST_CHECK(!stub_get_conn(client[0].conn_handle)->terminated);
+
+  for (uint32_t i = 1; i < LINKS; i++)
+  {
+    run_until_done(i);
+    if (i < LINKS - 1)
+    {
+      TEST_CHECK_EQUAL(OTA_Tick(), 0);
+      TEST_CHECK(!stub_get_conn(client[0].conn_handle)->terminated);
+    }
+  }
+
+  TEST_CHECK_EQUAL(OTA_Tick(), 0);
+  for (uint32_t i = 0; i < LINKS; i++)
+  {
+    TEST_CHECK(image_on_flash(&client[i]));
+    TEST_CHECK(stub_get_conn(client[i].conn_handle)->terminated);
+    TEST_CHECK_EQUAL(stub_get_conn(client[i].conn_handle)->overwritten, 0);
+    if (i > 0)
+    {
+      /* Not an application base address */
+      TEST_CHECK_EQUAL(tag_word(client[i].base), OTA_IN_PROGRESS_TAG);
+    }
+  }
+
+  for (uint32_t i = 0; i < LINKS; i++)
+  {
+    TEST_CHECK_EQUAL(OTA_Tick(), 0);
+    ota_client_disconnect(&client[i]);
+  }
+  TEST_CHECK_EQUAL(OTA_Tick(), 1);
+}
+
+/* The application image has completed while another session is transferring: the jump waits for it to be aborted */
+static void test_aborted_session(void)
+{
+  reset();
+  start(0, IMAGE_SIZE / 2);
+  start(1, IMAGE_SIZE);
+
+  run_until_done(0);
+  OTA_Tick();
+  TEST_CHECK(!stub_get_conn(client[0].conn_handle)->terminated);
+
+  /* A connection without OTA session is terminated */
+  OTA_Disconnection_Complete_CB(0x0810);
+  TEST_CHECK_EQUAL(OTA_Tick(), 0);
+  TEST_CHECK(!stub_get_conn(client[0].conn_handle)->terminated);
+
+  /* The other session is aborted */
+  ota_client_disconnect(&client[1]);
+  client[1].conn_handle = 0;
+  TEST_CHECK_EQUAL(OTA_Tick(), 0);
+  TEST_CHECK(stub_get_conn(client[0].conn_handle)->terminated);
+
+  ota_client_disconnect(&client[0]);
+  TEST_CHECK_EQUAL(OTA_Tick(), 1);
+  TEST_CHECK_EQUAL(tag_word(client[0].base), OTA_VALID_TAG);
+}
+
+/* A data image alone does not allow the jump */
+static void test_data_image_only(void)
+{
+  reset();
+  start(1, IMAGE_SIZE);
+  run_until_done(1);
+  TEST_CHECK(image_on_flash(&client[1]));
+  TEST_CHECK_EQUAL(OTA_Tick(), 0);
+  TEST_CHECK(!stub_get_conn(client[1].conn_handle)->terminated);
+  ota_client_disconnect(&client[1]);
+  TEST_CHECK_EQUAL(OTA_Tick(), 0);
+}
+
+int main(void)
+{
+  srand(5);
+  for (uint32_t i = 0; i < LINKS; i++)
+  {
+    for (uint32_t j = 0; j < IMAGE_SIZE; j++)
+    {
+      image[i][j] = (uint8_t)rand();
+    }
+  }
+
+  test_session_allocation();
+  test_concurrent_sessions();
+  test_aborted_session();
+  test_data_image_only();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,124 @@
+/**
+  ******************************************************************************
+  * @file    test_ota_pipeline.c
+  * @brief   OTA image pipeline: a window is programmed while the next one is
+  *          received, so the client never waits for the flash. It reports the
+  *          time-to-flash of a 100 KB image with a connection event model.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include "test_assert.h"
+#include "ota_host_stub.h"
+#include "ota_client.h"
+#include "OTA_btl.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define IMAGE_SIZE      (100000)
+#define MAX_EVENTS      (1000000)
+
+static uint8_t image[IMAGE_SIZE];
+
+typedef struct
+{
+  const char *name;
+  uint16_t att_mtu;
+  uint32_t packets_per_event;
+  double interval_ms;       /* Connection interval */
+  double radio_ms;          /* Radio time of the packets of a connection event */
+} link_model_t;
+
+/* The image on flash, but for the OTA validity tag */
+static int image_on_flash(uint32_t base, const uint8_t *data, uint32_t size)
+{
+  const uint8_t *flash = &stub_flash[base - _MEMORY_FLASH_BEGIN_];
+
+  return (memcmp(flash, data, OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET) == 0) &&
+         (memcmp(flash + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4, data + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4,
+                 size - OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET - 4) == 0);
+}
+
+static uint32_t flash_word(uint32_t address)
+{
+  uint32_t word;
+
+  memcpy(&word, &stub_flash[address - _MEMORY_FLASH_BEGIN_], 4);
+  return word;
+}
+
+static void run(const link_model_t *model, uint8_t dirty_flash, double flash_fail_rate)
+{
+  ota_client_t c = { 0 };
+  double seconds;
+
+  stub_reset();
+  if (dirty_flash)
+  {
+    stub_flash_dirty(APP_HIGHER_ADDRESS, IMAGE_SIZE + 2 * FLASH_PAGE_SIZE);
+  }
+  stub_flash_fail_rate = flash_fail_rate;
+  TEST_CHECK_EQUAL(OTA_Add_Btl_Service(), BLE_STATUS_SUCCESS);
+
+  c.conn_handle = 0x0801;
+  c.att_mtu = model->att_mtu;
+  c.base = APP_HIGHER_ADDRESS;
+  c.size = IMAGE_SIZE;
+  c.image = image;
+  ota_client_start(&c);
+  TEST_CHECK(!c.refused);
+
+  while (!c.done && !c.refused && (c.events < MAX_EVENTS))
+  {
+    ota_client_event(&c, model->packets_per_event);
+    stub_radio_idle_ms = (int64_t)(model->interval_ms - model->radio_ms);
+    OTA_Radio_Activity(0);
+  }
+  seconds = c.events * model->interval_ms / 1000.0;
+
+  TEST_CHECK(c.done);
+  TEST_CHECK(image_on_flash(c.base, image, c.size));
+  TEST_CHECK_EQUAL(flash_word(c.base + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET), OTA_VALID_TAG);
+  TEST_CHECK_EQUAL(stub_get_conn(c.conn_handle)->overwritten, 0);
+  if (flash_fail_rate == 0)
+  {
+    /* Each window is acknowledged before it is programmed: only the ack of the last
+       window waits for the whole image on flash */
+    TEST_CHECK(c.idle_events <= 1);
+    TEST_CHECK_EQUAL(c.sent, c.packets);
+  }
+  else
+  {
+    TEST_CHECK(c.errors[CLIENT_FLASH_VERIFY_ERROR] > 0);
+  }
+
+  printf("%-24s %s%s: %6.2f s, %6.0f bytes/s, %u packets, %u idle events, %u erases\n",
+         model->name, dirty_flash ? "dirty flash" : "blank flash", (flash_fail_rate != 0) ? ", flash failures" : "",
+         seconds, IMAGE_SIZE / seconds, c.sent, c.idle_events, stub_flash_erases);
+
+  OTA_Disconnection_Complete_CB(c.conn_handle);
+}
+
+int main(void)
+{
+  static const link_model_t models[] = {
+    { "ATT_MTU 23, CI 7.5 ms",   23,  6,  7.5, 4.2 },
+    { "ATT_MTU 23, CI 15 ms",    23, 12, 15.0, 8.4 },
+    { "ATT_MTU 245, CI 15 ms",  245,  4, 15.0, 4.0 },
+  };
+
+  srand(1);
+  for (uint32_t i = 0; i < IMAGE_SIZE; i++)
+  {
+    image[i] = (uint8_t)rand();
+  }
+
+  for (uint32_t i = 0; i < sizeof(models) / sizeof(models[0]); i++)
+  {
+    run(&models[i], 0, 0);
+    run(&models[i], 1, 0);
+  }
+  run(&models[0], 1, 1e-4);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,255 @@
+/**
+  ******************************************************************************
+  * @file    test_ota_resume.c
+  * @brief   Resumable OTA transfers: the link is killed at random points, by a
+  *          disconnection or by a device reset, and the transfer resumes from
+  *          the checkpoint kept in RAM or on the checkpoint flash page.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include "test_assert.h"
+#include "ota_host_stub.h"
+#include "ota_client.h"
+#include "OTA_btl.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define IMAGE_SIZE      (100000)
+#define MAX_SESSIONS    (200)
+
+static uint8_t image[IMAGE_SIZE];
+static ota_client_t c;
+
+static int image_on_flash(uint32_t base)
+{
+  const uint8_t *flash = &stub_flash[base - _MEMORY_FLASH_BEGIN_];
+
+  return (memcmp(flash, image, OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET) == 0) &&
+         (memcmp(flash + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4, image + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4,
+                 IMAGE_SIZE - OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET - 4) == 0);
+}
+
+static uint32_t tag_word(uint32_t base)
+{
+  uint32_t word;
+
+  memcpy(&word, &stub_flash[base - _MEMORY_FLASH_BEGIN_ + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET], 4);
+  return word;
+}
+
+/* Device reset: RAM is lost, the flash is kept */
+static void reboot(void)
+{
+  memset(ota_link, 0, sizeof(ota_link));
+  memset(ota_checkpoint, 0, sizeof(ota_checkpoint));
+  memset(ota_checkpoint_flash, 0, sizeof(ota_checkpoint_flash));
+  ota_checkpoint_next_record = 0;
+  stub_reboot();
+  TEST_CHECK_EQUAL(OTA_Add_Btl_Service(), BLE_STATUS_SUCCESS);
+}
+
+static void start(uint16_t att_mtu, uint8_t mode)
+{
+  uint32_t sent = c.sent;
+
+  memset(&c, 0, sizeof(c));
+  c.conn_handle = 0x0801;
+  c.att_mtu = att_mtu;
+  c.mode = mode;
+  c.base = APP_HIGHER_ADDRESS;
+  c.size = IMAGE_SIZE;
+  c.image = image;
+  ota_client_start(&c);
+  TEST_CHECK(!c.refused);
+  /* Packets sent by the previous sessions */
+  c.sent = sent;
+}
+
+static void run(uint32_t events)
+{
+  for (uint32_t event = 0; (event < events) && !c.done; event++)
+  {
+    ota_client_event(&c, 6);
+    OTA_Radio_Activity(0);
+  }
+}
+
+/* The link is killed after a random number of connection events, until the image is complete */
+static void test_killed_link(uint16_t att_mtu)
+{
+  uint32_t programmed = 0;
+  uint32_t kills = 0;
+  uint32_t reboots = 0;
+  uint32_t resumed_bytes;
+
+  stub_reset();
+  c.sent = 0;
+  reboot();
+
+  for (uint32_t session = 0; (session < MAX_SESSIONS) && !c.done; session++)
+  {
+    start(att_mtu, CLIENT_CRC32 | CLIENT_RESUME);
+
+    /* The transfer resumes from the page holding the end of the image programmed before the kill */
+    resumed_bytes = (uint32_t)c.resumed_from * c.packet_size;
+    TEST_CHECK(resumed_bytes <= programmed);
+    TEST_CHECK(resumed_bytes + FLASH_PAGE_SIZE + c.packet_size > programmed);
+
+    /* About 7 kills per image */
+    run(1 + rand() % (c.packets / 20));
+    if (c.done)
+      break;
+
+    programmed = ota_link[0].totalBytesWritten;
+    kills++;
+    if (rand() % 2)
+    {
+      ota_client_disconnect(&c);
+    }
+    else
+    {
+      reboot();
+      reboots++;
+    }
+  }
+
+  TEST_CHECK(c.done);
+  TEST_CHECK(reboots > 0);
+  TEST_CHECK(image_on_flash(c.base));
+  TEST_CHECK_EQUAL(tag_word(c.base), OTA_VALID_TAG);
+  /* Each kill costs at most the page being programmed and the windows not yet programmed */
+  TEST_CHECK(c.sent <= c.packets + kills * (FLASH_PAGE_SIZE / c.packet_size + 1 + 3 * NOTIFICATION_WINDOW));
+  printf("ATT_MTU %3u: %u kills (%u resets), %u packets sent for %u image packets\n",
+         att_mtu, kills, reboots, c.sent, c.packets);
+
+  /* The completed transfer is not resumed anymore, also after a reset */
+  ota_client_disconnect(&c);
+  reboot();
+  start(att_mtu, CLIENT_CRC32 | CLIENT_RESUME);
+  TEST_CHECK_EQUAL(c.resumed_from, 0);
+  ota_client_disconnect(&c);
+}
+
+/* A reset while a checkpoint record is programmed: the record is skipped */
+static void test_torn_record(void)
+{
+  uint32_t torn[4] = { 0x12345678, 0x9ABCDEF0, 0x0F0F0F0F, 0xF0F0F0F0 };
+  uint16_t resumed_from;
+
+  stub_reset();
+  reboot();
+  start(23, CLIENT_CRC32 | CLIENT_RESUME);
+  run(400);
+  TEST_CHECK(!c.done);
+  reboot();
+  start(23, CLIENT_CRC32 | CLIENT_RESUME);
+  resumed_from = c.resumed_from;
+  TEST_CHECK(resumed_from > 0);
+
+  /* Second half of the next record programmed, then reset */
+  LL_FLASH_ProgramBurst(FLASH, OTA_CHECKPOINT_PAGE_ADDRESS + ota_checkpoint_next_record * sizeof(OTA_Checkpoint_Record_t) + 16, torn);
+  reboot();
+  start(23, CLIENT_CRC32 | CLIENT_RESUME);
+  TEST_CHECK_EQUAL(c.resumed_from, resumed_from);
+
+  /* The next records follow the torn one */
+  run(400);
+  TEST_CHECK(!c.done);
+  reboot();
+  start(23, CLIENT_CRC32 | CLIENT_RESUME);
+  TEST_CHECK(c.resumed_from > resumed_from);
+  run(1000000);
+  TEST_CHECK(c.done);
+  TEST_CHECK(image_on_flash(c.base));
+  ota_client_disconnect(&c);
+}
+
+/* The image programmed before the reset has been modified: the transfer restarts */
+static void test_modified_image(void)
+{
+  stub_reset();
+  reboot();
+  start(23, CLIENT_CRC32 | CLIENT_RESUME);
+  run(800);
+  TEST_CHECK(!c.done);
+  TEST_CHECK(ota_link[0].totalBytesWritten > 2 * FLASH_PAGE_SIZE);
+  reboot();
+  stub_flash_dirty(APP_HIGHER_ADDRESS + FLASH_PAGE_SIZE, 16);
+
+  start(23, CLIENT_CRC32 | CLIENT_RESUME);
+  TEST_CHECK_EQUAL(c.resumed_from, 0);
+  run(1000000);
+  TEST_CHECK(c.done);
+  TEST_CHECK(image_on_flash(c.base));
+  ota_client_disconnect(&c);
+}
+
+/* The checkpoint page is compacted when a new session does not fit: the checkpoints are kept */
+static void test_compaction(void)
+{
+  uint32_t erases;
+  uint16_t resumed_from;
+
+  stub_reset();
+  reboot();
+  for (uint32_t i = 0; i < 2; i++)
+  {
+    start(245, CLIENT_CRC32 | CLIENT_RESUME);
+    run(1000000);
+    TEST_CHECK(c.done);
+    ota_client_disconnect(&c);
+  }
+  TEST_CHECK(ota_checkpoint_next_record <= OTA_CHECKPOINT_RECORDS);
+
+  start(245, CLIENT_CRC32 | CLIENT_RESUME);
+  run(60);
+  TEST_CHECK(!c.done);
+  reboot();
+  start(245, CLIENT_CRC32 | CLIENT_RESUME);
+  resumed_from = c.resumed_from;
+  TEST_CHECK(resumed_from > 0);
+
+  /* Log full: the session start compacts it */
+  erases = stub_flash_erases;
+  ota_client_disconnect(&c);
+  ota_checkpoint_next_record = OTA_CHECKPOINT_RECORDS - 1;
+  start(245, CLIENT_CRC32 | CLIENT_RESUME);
+  TEST_CHECK_EQUAL(stub_flash_erases, erases + 1);
+  TEST_CHECK_EQUAL(c.resumed_from, resumed_from);
+  reboot();
+  start(245, CLIENT_CRC32 | CLIENT_RESUME);
+  TEST_CHECK_EQUAL(c.resumed_from, resumed_from);
+  ota_client_disconnect(&c);
+}
+
+/* Clients not asking for it never resume */
+static void test_no_resume(void)
+{
+  stub_reset();
+  reboot();
+  start(23, CLIENT_CRC32);
+  run(400);
+  reboot();
+  start(23, CLIENT_CRC32);
+  TEST_CHECK_EQUAL(c.resumed_from, 0);
+  ota_client_disconnect(&c);
+}
+
+int main(void)
+{
+  srand(11);
+  for (uint32_t i = 0; i < IMAGE_SIZE; i++)
+  {
+    image[i] = (uint8_t)rand();
+  }
+
+  test_killed_link(23);
+  test_killed_link(245);
+  test_torn_record();
+  test_modified_image();
+  test_compaction();
+  test_no_resume();
+
+  return TEST_RESULT();
+}
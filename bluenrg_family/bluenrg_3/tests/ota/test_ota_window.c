@@ -0,0 +1,121 @@
+/**
+  ******************************************************************************
+  * @file    test_ota_window.c
+  * @brief   OTA adaptive notification window: throughput of the fixed and of
+  *          the adaptive window against the packet error rate, for the default
+  *          and the extended ATT_MTU.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include "test_assert.h"
+#include "ota_host_stub.h"
+#include "ota_client.h"
+#include "OTA_btl.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define IMAGE_SIZE      (120 * 1024)
+#define MAX_EVENTS      (1000000)
+#define RATES           (4)
+
+static const double packet_error_rate[RATES] = { 0, 1e-3, 1e-2, 5e-2 };
+
+static uint8_t image[IMAGE_SIZE];
+static double error_rate;
+
+/* A lost packet: the OTA server receives the next packet with an unexpected sequence number. The sequence number
+   is corrupted (bit 15, not used by the image packets), so that the loss is always detected */
+static void corrupt(ota_client_t *c, uint8_t *packet, uint8_t length)
+{
+  if ((double)rand() / RAND_MAX < error_rate)
+  {
+    packet[length - 1] ^= 0x80;
+  }
+}
+
+static int image_on_flash(uint32_t base)
+{
+  const uint8_t *flash = &stub_flash[base - _MEMORY_FLASH_BEGIN_];
+
+  return (memcmp(flash, image, OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET) == 0) &&
+         (memcmp(flash + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4, image + OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET + 4,
+                 IMAGE_SIZE - OTA_TAG_VECTOR_TABLE_ENTRY_OFFSET - 4) == 0);
+}
+
+/* Image bytes per connection event */
+static double run(uint16_t att_mtu, uint32_t packets_per_event, uint8_t adaptive, double rate, double *mean_window)
+{
+  static ota_client_t c;
+
+  stub_reset();
+  TEST_CHECK_EQUAL(OTA_Add_Btl_Service(), BLE_STATUS_SUCCESS);
+  error_rate = rate;
+
+  memset(&c, 0, sizeof(c));
+  c.conn_handle = 0x0801;
+  c.att_mtu = att_mtu;
+  c.mode = CLIENT_CRC32 | (adaptive ? CLIENT_ADAPTIVE : 0);
+  c.base = APP_HIGHER_ADDRESS;
+  c.size = IMAGE_SIZE;
+  c.image = image;
+  c.corrupt = corrupt;
+  ota_client_start(&c);
+  TEST_CHECK(!c.refused);
+
+  while (!c.done && (c.events < MAX_EVENTS))
+  {
+    ota_client_event(&c, packets_per_event);
+    OTA_Radio_Activity(0);
+  }
+
+  TEST_CHECK(c.done);
+  TEST_CHECK(image_on_flash(c.base));
+  TEST_CHECK_EQUAL(stub_get_conn(c.conn_handle)->overwritten, 0);
+  if (rate == 0)
+  {
+    TEST_CHECK_EQUAL(c.errors[CLIENT_CHECKSUM_ERROR], 0);
+  }
+  *mean_window = (double)c.window_sum / stub_get_conn(c.conn_handle)->count;
+  OTA_Disconnection_Complete_CB(c.conn_handle);
+
+  return (double)IMAGE_SIZE / c.events;
+}
+
+int main(void)
+{
+  static const struct
+  {
+    uint16_t att_mtu;
+    uint32_t packets_per_event;
+  } links[] = { { 23, 6 }, { 245, 4 } };
+
+  srand(7);
+  for (uint32_t i = 0; i < IMAGE_SIZE; i++)
+  {
+    image[i] = (uint8_t)rand();
+  }
+
+  for (uint32_t l = 0; l < sizeof(links) / sizeof(links[0]); l++)
+  {
+    for (uint32_t r = 0; r < RATES; r++)
+    {
+      double fixed_window, adaptive_window;
+      double fixed = run(links[l].att_mtu, links[l].packets_per_event, 0, packet_error_rate[r], &fixed_window);
+      double adaptive = run(links[l].att_mtu, links[l].packets_per_event, 1, packet_error_rate[r], &adaptive_window);
+
+      printf("ATT_MTU %3u, PER %5.3f: fixed window %6.1f bytes/event, adaptive window %6.1f bytes/event (mean window %4.1f)\n",
+             links[l].att_mtu, packet_error_rate[r], fixed, adaptive, adaptive_window);
+
+      /* The adaptive window grows beyond NOTIFICATION_WINDOW only if the image buffer holds more packets (small ATT_MTU):
+         there it saves notifications up to moderate error rates. Otherwise it can only shrink on errors */
+      if ((links[l].att_mtu == 23) && (packet_error_rate[r] <= 1e-2))
+      {
+        TEST_CHECK(adaptive > 1.1 * fixed);
+      }
+      TEST_CHECK(adaptive >= 0.8 * fixed);
+    }
+  }
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,134 @@
+/**
+  ******************************************************************************
+  * @file    pka_host_stub.c
+  * @brief   Simulated PKA and RNG used by the PKA manager: a PKA operation is
+  *          completed when the test runs the PKA interrupt.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "bluenrg_lpx.h"
+#include "pka_manager.h"
+#include "rng_manager.h"
+#include "pka_host_stub.h"
+
+uint32_t stub_pka_starts;
+uint32_t stub_pka_secret[8];
+uint32_t stub_pka_isr_dhkey_starts;
+uint32_t stub_tick_requests;
+uint16_t stub_rng_level;
+uint32_t stub_rng_isr_waits;
+
+static PKAMGR_funcCB stub_pka_funcCB;
+static uint32_t stub_pka_result[24];
+static uint32_t stub_rng_state;
+static uint8_t stub_in_irq;
+
+void stub_reset(void)
+{
+  static void *scs;
+
+  if (scs == NULL)
+  {
+    /* NVIC: pending interrupts */
+    scs = mmap((void *)SCS_BASE, 0x1000, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (scs == MAP_FAILED)
+    {
+      abort();
+    }
+  }
+  memset(scs, 0, 0x1000);
+  memset(stub_pka_secret, 0, sizeof(stub_pka_secret));
+  stub_pka_funcCB = NULL;
+  stub_pka_starts = 0;
+  stub_pka_isr_dhkey_starts = 0;
+  stub_tick_requests = 0;
+  stub_rng_level = RNGMGR_POOL_SIZE;
+  stub_rng_isr_waits = 0;
+  stub_rng_state = 1;
+  stub_in_irq = 0;
+}
+
+uint8_t stub_pka_busy(void)
+{
+  return stub_pka_funcCB != NULL;
+}
+
+uint8_t stub_pka_pending(void)
+{
+  return (NVIC->ISPR[0] & (1UL << PKA_IRQn)) != 0;
+}
+
+void stub_public_key(const uint32_t *secretKey, uint32_t *publicKey)
+{
+  for (uint32_t i = 0; i < 16; i++)
+  {
+    publicKey[i] = secretKey[i % 8] * 2654435761U + i;
+  }
+}
+
+/* Same sequence as the PKA interrupt handler of the device files */
+uint8_t stub_pka_irq(void)
+{
+  PKAMGR_funcCB funcCB = stub_pka_funcCB;
+  uint8_t active = stub_pka_busy() || stub_pka_pending();
+
+  NVIC->ISPR[0] &= ~(1UL << PKA_IRQn);
+  stub_in_irq = 1;
+  if (funcCB != NULL)
+  {
+    memcpy(&stub_pka_result[0], stub_pka_secret, sizeof(stub_pka_secret));
+    stub_public_key(stub_pka_secret, &stub_pka_result[8]);
+    memset(stub_pka_secret, 0, sizeof(stub_pka_secret));
+    stub_pka_funcCB = NULL;
+    PKAMGR_Unlock();
+    funcCB(PKAMGR_SUCCESS, stub_pka_result);
+  }
+  PKAMGR_KeyCacheServe();
+  stub_in_irq = 0;
+
+  return active;
+}
+
+PKAMGR_ResultStatus PKAMGR_PrivateStartP256DHkeyGeneration(const uint32_t *secretKey, const uint32_t *publicKey, PKAMGR_funcCB funcCB)
+{
+  if (PKAMGR_Lock() != PKAMGR_SUCCESS)
+  {
+    return PKAMGR_ERR_BUSY;
+  }
+  if (stub_in_irq && memcmp(publicKey, PKAStartPoint, sizeof(PKAStartPoint)) != 0)
+  {
+    stub_pka_isr_dhkey_starts++;
+  }
+  memcpy(stub_pka_secret, secretKey, sizeof(stub_pka_secret));
+  stub_pka_funcCB = funcCB;
+  stub_pka_starts++;
+
+  return PKAMGR_SUCCESS;
+}
+
+void PKAMGR_TickRequest(void)
+{
+  stub_tick_requests++;
+}
+
+uint16_t RNGMGR_PoolLevel(void)
+{
+  return stub_rng_level;
+}
+
+RNGMGR_ResultStatus RNGMGR_GetRandomBytes(uint8_t *buffer, uint16_t size)
+{
+  if (stub_in_irq && size > 2U * stub_rng_level)
+  {
+    stub_rng_isr_waits++;
+  }
+  while (size-- != 0)
+  {
+    stub_rng_state = stub_rng_state * 1103515245U + 12345U;
+    *buffer++ = (uint8_t)(stub_rng_state >> 16);
+  }
+  return RNGMGR_SUCCESS;
+}
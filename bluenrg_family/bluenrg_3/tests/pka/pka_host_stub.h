@@ -0,0 +1,42 @@
+/**
+  ******************************************************************************
+  * @file    pka_host_stub.h
+  * @brief   Simulated PKA and RNG used by the PKA manager: a PKA operation is
+  *          completed when the test runs the PKA interrupt.
+  ******************************************************************************
+  */
+
+#ifndef PKA_HOST_STUB_H
+#define PKA_HOST_STUB_H
+
+#include <stdint.h>
+
+/* PKA operations started */
+extern uint32_t stub_pka_starts;
+/* Secret key of the running PKA operation, all zero if the PKA is idle */
+extern uint32_t stub_pka_secret[8];
+/* DHKey computations (public key other than the start point) started from the PKA interrupt */
+extern uint32_t stub_pka_isr_dhkey_starts;
+/* Calls of PKAMGR_TickRequest() */
+extern uint32_t stub_tick_requests;
+/* Random numbers of the RNG pool, returned by RNGMGR_PoolLevel() */
+extern uint16_t stub_rng_level;
+/* Calls of RNGMGR_GetRandomBytes() from the PKA interrupt that would wait for the RNG */
+extern uint32_t stub_rng_isr_waits;
+
+void stub_reset(void);
+
+/* The PKA is running an operation */
+uint8_t stub_pka_busy(void);
+
+/* The PKA interrupt has been pended by software */
+uint8_t stub_pka_pending(void);
+
+/* PKA interrupt: the running operation, if any, is completed. Returns 0 if
+   there was nothing to do. */
+uint8_t stub_pka_irq(void);
+
+/* Public key reported by the simulated PKA for a secret key */
+void stub_public_key(const uint32_t *secretKey, uint32_t *publicKey);
+
+#endif /* PKA_HOST_STUB_H */
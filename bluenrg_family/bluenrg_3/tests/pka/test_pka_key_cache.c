@@ -0,0 +1,232 @@
+/**
+  ******************************************************************************
+  * @file    test_pka_key_cache.c
+  * @brief   PKA key pool without PKAMGR_Tick(): the pool is filled from the
+  *          completion of the PKA jobs and a key pair of the pool is reported
+  *          from the PKA interrupt pended by the request. With the RNG pool
+  *          too low for a secret key, the fill is left to PKAMGR_Tick().
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "test_assert.h"
+#include "pka_host_stub.h"
+#include "pka_manager.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define MAX_REPORTS     (16)
+
+static uint32_t reports;
+static PKAMGR_ResultStatus report_status[MAX_REPORTS];
+static uint32_t report_keys[MAX_REPORTS][24];
+
+static const uint32_t user_secret[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+static void on_key(PKAMGR_ResultStatus errorCode, void *args)
+{
+  if (reports < MAX_REPORTS)
+  {
+    report_status[reports] = errorCode;
+    memcpy(report_keys[reports], args, sizeof(report_keys[0]));
+  }
+  reports++;
+}
+
+/* Public key matching the secret key */
+static int valid_pair(const uint32_t *keys)
+{
+  uint32_t publicKey[16];
+
+  stub_public_key(keys, publicKey);
+  return memcmp(&keys[8], publicKey, sizeof(publicKey)) == 0;
+}
+
+/* Runs the PKA interrupt until there is nothing left to do */
+static uint32_t run_irqs(void)
+{
+  uint32_t irqs = 0;
+
+  while (stub_pka_irq() && (irqs < 100))
+  {
+    irqs++;
+  }
+  return irqs;
+}
+
+static void reset(void)
+{
+  stub_reset();
+  TEST_CHECK_EQUAL(PKAMGR_Deinit(), PKAMGR_SUCCESS);
+  PKAMGR_KeyCacheFlush();
+  keyCacheHold = 0;
+  keyCacheFilling = 0;
+  TEST_CHECK_EQUAL(PKAMGR_Init(), PKAMGR_SUCCESS);
+  reports = 0;
+}
+
+/* The first request is computed by the PKA, then the pool is filled */
+static void test_fill(void)
+{
+  reset();
+  TEST_CHECK_EQUAL(PKAMGR_KeyCacheLevel(), 0);
+
+  TEST_CHECK_EQUAL(PKAMGR_StartP256PublicKeyGeneration(user_secret, on_key), PKAMGR_SUCCESS);
+  TEST_CHECK(stub_pka_busy());
+  TEST_CHECK(memcmp(stub_pka_secret, user_secret, sizeof(user_secret)) == 0);
+
+  /* Request completed, then one key pair for each free entry of the pool */
+  TEST_CHECK_EQUAL(run_irqs(), 1 + PKAMGR_KEY_CACHE_SIZE);
+  TEST_CHECK_EQUAL(reports, 1);
+  TEST_CHECK_EQUAL(report_status[0], PKAMGR_SUCCESS);
+  TEST_CHECK(memcmp(report_keys[0], user_secret, sizeof(user_secret)) == 0);
+  TEST_CHECK(valid_pair(report_keys[0]));
+  TEST_CHECK_EQUAL(stub_pka_starts, 1 + PKAMGR_KEY_CACHE_SIZE);
+  TEST_CHECK_EQUAL(PKAMGR_KeyCacheLevel(), PKAMGR_KEY_CACHE_SIZE);
+  TEST_CHECK(!stub_pka_busy());
+  TEST_CHECK_EQUAL(PKAMGR_SleepCheck(), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(stub_tick_requests, 0);
+  TEST_CHECK_EQUAL(stub_rng_isr_waits, 0);
+}
+
+/* A key pair of the pool is reported from the PKA interrupt, not from the request */
+static void test_serve(void)
+{
+  uint32_t starts;
+
+  reset();
+  PKAMGR_StartP256PublicKeyGeneration(user_secret, on_key);
+  run_irqs();
+  reports = 0;
+  starts = stub_pka_starts;
+
+  TEST_CHECK_EQUAL(PKAMGR_StartP256PublicKeyGeneration(user_secret, on_key), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(reports, 0);
+  TEST_CHECK(stub_pka_pending());
+  TEST_CHECK(!stub_pka_busy());
+  TEST_CHECK_EQUAL(PKAMGR_SleepCheck(), PKAMGR_ERR_BUSY);
+
+  TEST_CHECK_EQUAL(run_irqs(), 1);
+  TEST_CHECK_EQUAL(reports, 1);
+  TEST_CHECK_EQUAL(report_status[0], PKAMGR_SUCCESS);
+  TEST_CHECK(valid_pair(report_keys[0]));
+  /* The secret key comes from the pool */
+  TEST_CHECK(memcmp(report_keys[0], user_secret, sizeof(user_secret)) != 0);
+  TEST_CHECK_EQUAL(stub_pka_starts, starts);
+  TEST_CHECK_EQUAL(PKAMGR_SleepCheck(), PKAMGR_SUCCESS);
+
+  /* The pool is not filled before the DHKey of the pairing */
+  TEST_CHECK_EQUAL(PKAMGR_KeyCacheLevel(), PKAMGR_KEY_CACHE_SIZE - 1);
+  TEST_CHECK(!stub_pka_busy());
+  TEST_CHECK_EQUAL(PKAMGR_StartP256DHkeyGeneration(report_keys[0], &report_keys[0][8], on_key), PKAMGR_SUCCESS);
+  TEST_CHECK(stub_pka_busy());
+  TEST_CHECK(memcmp(stub_pka_secret, report_keys[0], sizeof(user_secret)) == 0);
+  TEST_CHECK_EQUAL(run_irqs(), 2);
+  TEST_CHECK_EQUAL(reports, 2);
+  TEST_CHECK_EQUAL(stub_pka_starts, starts + 2);
+  TEST_CHECK_EQUAL(PKAMGR_KeyCacheLevel(), PKAMGR_KEY_CACHE_SIZE);
+}
+
+/* Once the pool is empty it is filled again at once; the discarded secret keys are wiped */
+static void test_empty(void)
+{
+  uint32_t starts;
+
+  reset();
+  PKAMGR_StartP256PublicKeyGeneration(user_secret, on_key);
+  run_irqs();
+  reports = 0;
+  starts = stub_pka_starts;
+
+  for (uint32_t i = 0; i < PKAMGR_KEY_CACHE_SIZE; i++)
+  {
+    TEST_CHECK_EQUAL(PKAMGR_StartP256PublicKeyGeneration(user_secret, on_key), PKAMGR_SUCCESS);
+  }
+  TEST_CHECK_EQUAL(PKAMGR_KeyCacheLevel(), 0);
+  TEST_CHECK_EQUAL(stub_pka_starts, starts);
+
+  /* Both reported by the same interrupt, then the refill starts */
+  TEST_CHECK(stub_pka_irq());
+  TEST_CHECK_EQUAL(reports, PKAMGR_KEY_CACHE_SIZE);
+  TEST_CHECK(memcmp(report_keys[0], report_keys[1], sizeof(report_keys[0])) != 0);
+  TEST_CHECK(valid_pair(report_keys[0]));
+  TEST_CHECK(valid_pair(report_keys[1]));
+  TEST_CHECK(stub_pka_busy());
+  TEST_CHECK_EQUAL(stub_pka_starts, starts + 1);
+  for (uint32_t i = 0; i < PKAMGR_KEY_CACHE_SIZE; i++)
+  {
+    for (uint32_t j = 0; j < 8; j++)
+    {
+      TEST_CHECK_EQUAL(keyCache[i][j], 0);
+    }
+  }
+
+  /* One key pair, the next ones wait for the DHKey of the pairings */
+  TEST_CHECK_EQUAL(run_irqs(), 1);
+  TEST_CHECK_EQUAL(PKAMGR_KeyCacheLevel(), 1);
+  TEST_CHECK_EQUAL(PKAMGR_StartP256DHkeyGeneration(report_keys[0], &report_keys[1][8], on_key), PKAMGR_SUCCESS);
+  run_irqs();
+  TEST_CHECK_EQUAL(PKAMGR_KeyCacheLevel(), PKAMGR_KEY_CACHE_SIZE);
+
+  /* Flushed: the next request is computed by the PKA */
+  PKAMGR_KeyCacheFlush();
+  TEST_CHECK_EQUAL(PKAMGR_KeyCacheLevel(), 0);
+  for (uint32_t i = 0; i < PKAMGR_KEY_CACHE_SIZE; i++)
+  {
+    for (uint32_t j = 0; j < 8; j++)
+    {
+      TEST_CHECK_EQUAL(keyCache[i][j], 0);
+    }
+  }
+  TEST_CHECK_EQUAL(PKAMGR_StartP256PublicKeyGeneration(user_secret, on_key), PKAMGR_SUCCESS);
+  TEST_CHECK(stub_pka_busy());
+  TEST_CHECK(memcmp(stub_pka_secret, user_secret, sizeof(user_secret)) == 0);
+  run_irqs();
+}
+
+/* The PKA interrupt does not wait for the RNG: the fill is started by PKAMGR_Tick() */
+static void test_rng_low(void)
+{
+  uint32_t ticks;
+
+  reset();
+  stub_rng_level = 15;
+  PKAMGR_StartP256PublicKeyGeneration(user_secret, on_key);
+  TEST_CHECK_EQUAL(run_irqs(), 1);
+  TEST_CHECK_EQUAL(reports, 1);
+  TEST_CHECK_EQUAL(PKAMGR_KeyCacheLevel(), 0);
+  TEST_CHECK(!stub_pka_busy());
+  TEST_CHECK(stub_tick_requests != 0);
+  TEST_CHECK_EQUAL(PKAMGR_SleepCheck(), PKAMGR_SUCCESS);
+
+  /* From thread context the secret key can wait for the RNG */
+  for (ticks = 0; ticks < 10 && PKAMGR_KeyCacheLevel() < PKAMGR_KEY_CACHE_SIZE; ticks++)
+  {
+    PKAMGR_Tick();
+    TEST_CHECK(stub_pka_busy());
+    TEST_CHECK_EQUAL(run_irqs(), 1);
+  }
+  TEST_CHECK_EQUAL(ticks, PKAMGR_KEY_CACHE_SIZE);
+  TEST_CHECK_EQUAL(PKAMGR_KeyCacheLevel(), PKAMGR_KEY_CACHE_SIZE);
+
+  /* RNG pool refilled: the interrupt fills the key pool again */
+  stub_rng_level = 16;
+  stub_tick_requests = 0;
+  reports = 0;
+  PKAMGR_KeyCacheFlush();
+  PKAMGR_StartP256PublicKeyGeneration(user_secret, on_key);
+  TEST_CHECK_EQUAL(run_irqs(), 1 + PKAMGR_KEY_CACHE_SIZE);
+  TEST_CHECK_EQUAL(PKAMGR_KeyCacheLevel(), PKAMGR_KEY_CACHE_SIZE);
+  TEST_CHECK_EQUAL(stub_tick_requests, 0);
+  TEST_CHECK_EQUAL(stub_rng_isr_waits, 0);
+}
+
+int main(void)
+{
+  test_fill();
+  test_serve();
+  test_empty();
+  test_rng_low();
+
+  return TEST_RESULT();
+}
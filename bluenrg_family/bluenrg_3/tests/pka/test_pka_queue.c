@@ -0,0 +1,269 @@
+/**
+  ******************************************************************************
+  * @file    test_pka_queue.c
+  * @brief   PKA job queue without PKAMGR_Tick(): the queued jobs are started
+  *          by priority, then in request order, when the running job is
+  *          completed or when a direct user of the PKA releases it, and they
+  *          can be cancelled. Built again with PKAMGR_DHKEY_START_WAITS, as
+  *          on BlueNRG-LPS and BlueNRG-LPF: the queued DHKey computations are
+  *          then started by PKAMGR_Tick(), requested from the PKA interrupt.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "test_assert.h"
+#include "pka_host_stub.h"
+#include "pka_manager.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define MAX_REPORTS     (16)
+
+static uint32_t reports;
+static PKAMGR_ResultStatus report_status[MAX_REPORTS];
+static uint16_t report_job[MAX_REPORTS];
+
+/* The job is identified by its secret key */
+static void on_job(PKAMGR_ResultStatus errorCode, void *args)
+{
+  if (reports < MAX_REPORTS)
+  {
+    report_status[reports] = errorCode;
+    report_job[reports] = (uint16_t)((uint32_t *)args)[0];
+  }
+  reports++;
+}
+
+/* Runs the PKA interrupt until there is nothing left to do */
+static uint32_t run_irqs(void)
+{
+  uint32_t irqs = 0;
+
+  while (stub_pka_irq() && (irqs < 100))
+  {
+    irqs++;
+  }
+  return irqs;
+}
+
+static void reset(void)
+{
+  stub_reset();
+  TEST_CHECK_EQUAL(PKAMGR_Deinit(), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(PKAMGR_Init(), PKAMGR_SUCCESS);
+  reports = 0;
+}
+
+static PKAMGR_ResultStatus queue(uint32_t job, PKAMGR_Priority priority, uint16_t *jobId)
+{
+  uint32_t secret[8] = { 0 };
+
+  secret[0] = job;
+  return PKAMGR_QueueP256PublicKeyGeneration(secret, on_job, priority, jobId);
+}
+
+/* The queued jobs are started from the completion of the running job, by priority */
+static void test_order(void)
+{
+  uint32_t secret[8] = { 0 };
+
+  reset();
+  TEST_CHECK_EQUAL(queue(1, PKAMGR_PRIORITY_APPLICATION, NULL), PKAMGR_SUCCESS);
+  TEST_CHECK(stub_pka_busy());
+  TEST_CHECK_EQUAL(stub_pka_secret[0], 1);
+  TEST_CHECK_EQUAL(queue(2, PKAMGR_PRIORITY_APPLICATION, NULL), PKAMGR_SUCCESS);
+  secret[0] = 3;
+  TEST_CHECK_EQUAL(PKAMGR_StartP256DHkeyGeneration(secret, PKAStartPoint, on_job), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(queue(4, PKAMGR_PRIORITY_APPLICATION, NULL), PKAMGR_SUCCESS);
+  /* Queue full */
+  TEST_CHECK_EQUAL(queue(5, PKAMGR_PRIORITY_APPLICATION, NULL), PKAMGR_ERR_BUSY);
+  TEST_CHECK_EQUAL(PKAMGR_SleepCheck(), PKAMGR_ERR_BUSY);
+
+  TEST_CHECK_EQUAL(run_irqs(), 4);
+  TEST_CHECK_EQUAL(reports, 4);
+  TEST_CHECK_EQUAL(report_job[0], 1);
+  TEST_CHECK_EQUAL(report_job[1], 3);
+  TEST_CHECK_EQUAL(report_job[2], 2);
+  TEST_CHECK_EQUAL(report_job[3], 4);
+  for (uint32_t i = 0; i < 4; i++)
+  {
+    TEST_CHECK_EQUAL(report_status[i], PKAMGR_SUCCESS);
+  }
+  TEST_CHECK_EQUAL(stub_pka_starts, 4);
+  TEST_CHECK(!stub_pka_busy());
+  TEST_CHECK_EQUAL(PKAMGR_SleepCheck(), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(stub_tick_requests, 0);
+}
+
+/* The jobs of the same priority are served in request order, also when the
+   job ids wrap around */
+static void test_fairness(void)
+{
+  reset();
+  lastJobId = 0xFFFE;
+  TEST_CHECK_EQUAL(queue(1, PKAMGR_PRIORITY_STACK, NULL), PKAMGR_SUCCESS);
+  for (uint32_t job = 2; job <= PKAMGR_QUEUE_SIZE; job++)
+  {
+    TEST_CHECK_EQUAL(queue(job, PKAMGR_PRIORITY_STACK, NULL), PKAMGR_SUCCESS);
+  }
+  TEST_CHECK_EQUAL(run_irqs(), PKAMGR_QUEUE_SIZE);
+  TEST_CHECK_EQUAL(reports, PKAMGR_QUEUE_SIZE);
+  for (uint32_t i = 0; i < PKAMGR_QUEUE_SIZE; i++)
+  {
+    TEST_CHECK_EQUAL(report_job[i], i + 1);
+  }
+
+  /* A job queued while the others run is not overtaken by later ones of the same priority */
+  reset();
+  queue(1, PKAMGR_PRIORITY_APPLICATION, NULL);
+  queue(2, PKAMGR_PRIORITY_APPLICATION, NULL);
+  stub_pka_irq();
+  queue(3, PKAMGR_PRIORITY_APPLICATION, NULL);
+  queue(4, PKAMGR_PRIORITY_STACK, NULL);
+  run_irqs();
+  TEST_CHECK_EQUAL(reports, 4);
+  TEST_CHECK_EQUAL(report_job[0], 1);
+  TEST_CHECK_EQUAL(report_job[1], 2);
+  TEST_CHECK_EQUAL(report_job[2], 4);
+  TEST_CHECK_EQUAL(report_job[3], 3);
+}
+
+/* A cancelled queued job is never started, a cancelled running job is not reported */
+static void test_cancel(void)
+{
+  uint16_t running, queued;
+
+  reset();
+  TEST_CHECK_EQUAL(queue(1, PKAMGR_PRIORITY_APPLICATION, &running), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(queue(2, PKAMGR_PRIORITY_APPLICATION, &queued), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(queue(3, PKAMGR_PRIORITY_APPLICATION, NULL), PKAMGR_SUCCESS);
+  TEST_CHECK(running != PKAMGR_INVALID_JOB);
+
+  TEST_CHECK_EQUAL(PKAMGR_Cancel(queued), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(PKAMGR_Cancel(queued), PKAMGR_ERR_PARAM);
+  TEST_CHECK_EQUAL(PKAMGR_Cancel(running), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(PKAMGR_Cancel(PKAMGR_INVALID_JOB), PKAMGR_ERR_PARAM);
+
+  TEST_CHECK_EQUAL(run_irqs(), 2);
+  TEST_CHECK_EQUAL(reports, 1);
+  TEST_CHECK_EQUAL(report_job[0], 3);
+  TEST_CHECK_EQUAL(stub_pka_starts, 2);
+  TEST_CHECK_EQUAL(PKAMGR_SleepCheck(), PKAMGR_SUCCESS);
+}
+
+/* Released by a direct user of the PKA: the queued job is started */
+static void test_lock(void)
+{
+  reset();
+  TEST_CHECK_EQUAL(PKAMGR_Lock(), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(queue(6, PKAMGR_PRIORITY_APPLICATION, NULL), PKAMGR_SUCCESS);
+  TEST_CHECK(!stub_pka_busy());
+  TEST_CHECK_EQUAL(PKAMGR_SleepCheck(), PKAMGR_ERR_BUSY);
+  TEST_CHECK_EQUAL(PKAMGR_Unlock(), PKAMGR_SUCCESS);
+  TEST_CHECK(stub_pka_busy());
+  TEST_CHECK_EQUAL(run_irqs(), 1);
+  TEST_CHECK_EQUAL(reports, 1);
+  TEST_CHECK_EQUAL(report_job[0], 6);
+}
+
+#if PKAMGR_DHKEY_START_WAITS
+static PKAMGR_ResultStatus queue_dhkey(uint32_t job, PKAMGR_Priority priority)
+{
+  uint32_t secret[8] = { 0 };
+  uint32_t peer[16];
+
+  secret[0] = job;
+  stub_public_key(secret, peer);
+  return PKAMGR_QueueP256DHkeyGeneration(secret, peer, on_job, priority, NULL);
+}
+
+/* A DHKey requested while the PKA is busy is queued, and started by PKAMGR_Tick()
+   once requested by the PKA interrupt */
+static void test_deferred_dhkey(void)
+{
+  uint32_t secret[8] = { 0 };
+  uint32_t peer[16];
+
+  reset();
+  TEST_CHECK_EQUAL(queue(1, PKAMGR_PRIORITY_APPLICATION, NULL), PKAMGR_SUCCESS);
+  secret[0] = 2;
+  stub_public_key(secret, peer);
+  TEST_CHECK_EQUAL(PKAMGR_StartP256DHkeyGeneration(secret, peer, on_job), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(queue(3, PKAMGR_PRIORITY_APPLICATION, NULL), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(stub_pka_starts, 1);
+
+  /* The DHKey has the highest priority: the PKA interrupt starts nothing */
+  TEST_CHECK_EQUAL(stub_pka_irq(), 1);
+  TEST_CHECK_EQUAL(reports, 1);
+  TEST_CHECK_EQUAL(report_job[0], 1);
+  TEST_CHECK(!stub_pka_busy());
+  TEST_CHECK_EQUAL(stub_tick_requests, 1);
+  TEST_CHECK_EQUAL(PKAMGR_SleepCheck(), PKAMGR_ERR_BUSY);
+
+  TEST_CHECK_EQUAL(PKAMGR_Tick(), PKAMGR_SUCCESS);
+  TEST_CHECK(stub_pka_busy());
+  TEST_CHECK_EQUAL(stub_pka_secret[0], 2);
+  /* Nothing to do while the DHKey runs */
+  TEST_CHECK_EQUAL(PKAMGR_Tick(), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(stub_pka_starts, 2);
+
+  /* The public key generation is started from the PKA interrupt */
+  TEST_CHECK_EQUAL(run_irqs(), 2);
+  TEST_CHECK_EQUAL(reports, 3);
+  TEST_CHECK_EQUAL(report_job[1], 2);
+  TEST_CHECK_EQUAL(report_job[2], 3);
+  TEST_CHECK_EQUAL(stub_tick_requests, 1);
+  TEST_CHECK_EQUAL(stub_pka_isr_dhkey_starts, 0);
+  TEST_CHECK_EQUAL(PKAMGR_SleepCheck(), PKAMGR_SUCCESS);
+
+  /* Several DHKey computations, one per tick, none from the interrupt */
+  reset();
+  TEST_CHECK_EQUAL(queue(1, PKAMGR_PRIORITY_STACK, NULL), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(queue_dhkey(2, PKAMGR_PRIORITY_STACK), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(queue_dhkey(3, PKAMGR_PRIORITY_STACK), PKAMGR_SUCCESS);
+  for (uint32_t i = 0; i < 3; i++)
+  {
+    stub_pka_irq();
+    PKAMGR_Tick();
+  }
+  TEST_CHECK_EQUAL(reports, 3);
+  TEST_CHECK_EQUAL(report_job[0], 1);
+  TEST_CHECK_EQUAL(report_job[1], 2);
+  TEST_CHECK_EQUAL(report_job[2], 3);
+  TEST_CHECK_EQUAL(stub_tick_requests, 2);
+  TEST_CHECK_EQUAL(stub_pka_isr_dhkey_starts, 0);
+}
+
+/* A DHKey waiting for a direct user of the PKA is started by PKAMGR_Tick() */
+static void test_deferred_lock(void)
+{
+  reset();
+  TEST_CHECK_EQUAL(PKAMGR_Lock(), PKAMGR_SUCCESS);
+  TEST_CHECK_EQUAL(queue_dhkey(7, PKAMGR_PRIORITY_STACK), PKAMGR_SUCCESS);
+  TEST_CHECK(!stub_pka_busy());
+  /* Released from the interrupt of the direct user */
+  TEST_CHECK_EQUAL(PKAMGR_Unlock(), PKAMGR_SUCCESS);
+  TEST_CHECK(!stub_pka_busy());
+  TEST_CHECK_EQUAL(stub_tick_requests, 1);
+  PKAMGR_Tick();
+  TEST_CHECK(stub_pka_busy());
+  TEST_CHECK_EQUAL(run_irqs(), 1);
+  TEST_CHECK_EQUAL(reports, 1);
+  TEST_CHECK_EQUAL(report_job[0], 7);
+  TEST_CHECK_EQUAL(report_status[0], PKAMGR_SUCCESS);
+}
+#endif
+
+int main(void)
+{
+  test_order();
+  test_fairness();
+  test_cancel();
+  test_lock();
+#if PKAMGR_DHKEY_START_WAITS
+  test_deferred_dhkey();
+  test_deferred_lock();
+#endif
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,96 @@
+/**
+  ******************************************************************************
+  * @file    pwr_host_stub.c
+  * @brief   Device services used by the power manager: the PWR registers are
+  *          mapped in RAM, the CPU halt returns at once and the system time is
+  *          set by the test.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "bluenrg_lpx.h"
+#include "system_BlueNRG_LP.h"
+#include "pwr_host_stub.h"
+
+uint64_t stub_time;
+PowerSaveLevels stub_stack_level;
+PowerSaveLevels stub_app_level;
+PowerSaveLevels stub_vtimer_level;
+PowerSaveLevels stub_pka_level;
+
+RAM_VR_TypeDef RAM_VR;
+uint32_t SystemCoreClock = 64000000;
+const intvec_elem __vector_table[1];
+
+void stub_reset(void)
+{
+  static void *pwr;
+
+  if (pwr == NULL)
+  {
+    pwr = mmap((void *)PWR_BASE, 0x1000, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pwr == MAP_FAILED)
+    {
+      abort();
+    }
+  }
+  memset(pwr, 0, 0x1000);
+  memset(&RAM_VR, 0, sizeof(RAM_VR));
+  stub_time = 0;
+  stub_stack_level = POWER_SAVE_LEVEL_STOP_NOTIMER;
+  stub_app_level = POWER_SAVE_LEVEL_STOP_NOTIMER;
+  stub_vtimer_level = POWER_SAVE_LEVEL_STOP_NOTIMER;
+  stub_pka_level = POWER_SAVE_LEVEL_STOP_NOTIMER;
+}
+
+uint64_t HAL_VTIMER_GetCurrentSysTime(void)
+{
+  return stub_time;
+}
+
+/* Built-in voters, replacing the weak definitions of the power manager */
+PowerSaveLevels BLE_STACK_SleepCheck(void)
+{
+  return stub_stack_level;
+}
+
+PowerSaveLevels App_PowerSaveLevel_Check(PowerSaveLevels level)
+{
+  return stub_app_level;
+}
+
+PowerSaveLevels HAL_VTIMER_PowerSaveLevelCheck(PowerSaveLevels level)
+{
+  return stub_vtimer_level;
+}
+
+uint8_t PKAMGR_PowerSaveLevelCheck(uint8_t level)
+{
+  return stub_pka_level;
+}
+
+/* Only reached by the STOP levels, not entered by the tests */
+void CS_contextSave(void)
+{
+  abort();
+}
+
+void MrBleBiasTrimConfig(uint8_t coldStart)
+{
+}
+
+void Osal_MemCpy4(uint32_t *dest, const uint32_t *src, unsigned int size)
+{
+  memcpy(dest, src, size);
+}
+
+void SystemTimer_TimeoutConfig(uint32_t system_clock_freq, uint32_t timeout, uint8_t enable)
+{
+}
+
+uint8_t SystemTimer_TimeoutExpired(void)
+{
+  return 0;
+}
@@ -0,0 +1,26 @@
+/**
+  ******************************************************************************
+  * @file    pwr_host_stub.h
+  * @brief   Device services used by the power manager: the PWR registers are
+  *          mapped in RAM, the CPU halt returns at once and the system time is
+  *          set by the test.
+  ******************************************************************************
+  */
+
+#ifndef PWR_HOST_STUB_H
+#define PWR_HOST_STUB_H
+
+#include <stdint.h>
+#include "rf_driver_hal_power_manager.h"
+
+/* Returned by HAL_VTIMER_GetCurrentSysTime() */
+extern uint64_t stub_time;
+/* Levels returned by the built-in voters */
+extern PowerSaveLevels stub_stack_level;
+extern PowerSaveLevels stub_app_level;
+extern PowerSaveLevels stub_vtimer_level;
+extern PowerSaveLevels stub_pka_level;
+
+void stub_reset(void);
+
+#endif /* PWR_HOST_STUB_H */
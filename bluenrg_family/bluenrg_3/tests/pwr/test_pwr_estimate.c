@@ -0,0 +1,108 @@
+/**
+  ******************************************************************************
+  * @file    test_pwr_estimate.c
+  * @brief   Average current and battery life estimated from the telemetry: the
+  *          estimate is flagged as not valid once POWER_SAVE_LEVEL_STOP_NOTIMER
+  *          has been entered, since the time spent there is not measured.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "test_assert.h"
+#include "pwr_host_stub.h"
+#include "rf_driver_hal_power_manager.c"
+
+TEST_MAIN_DEFINITIONS;
+
+static const PowerSaveCurrentModel_TypeDef model = { { 1000000, 500000, 2000, 500 } };
+
+/* Same sequence as the end of HAL_PWR_MNGR_Request() for a STOP level */
+static void stop(PowerSaveLevels level, uint64_t sleepTime, uint64_t wakeupTime, uint8_t entered)
+{
+  RAM_VR.WakeupFromSleepFlag = entered;
+  WakeupTime = wakeupTime;
+  stub_time = wakeupTime;
+  PowerSave_Telemetry(level, sleepTime);
+}
+
+static void reset(void)
+{
+  stub_reset();
+  stub_time = 1000;
+  HAL_PWR_MNGR_ResetTelemetry();
+}
+
+/* 200 time units running, 800 in STOP_WITH_TIMER */
+static void test_estimate(void)
+{
+  PowerSaveTelemetry_TypeDef telemetry;
+
+  reset();
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_EstimateCurrent(&model), 0);
+
+  stop(POWER_SAVE_LEVEL_STOP_WITH_TIMER, 1100, 1900, 1);
+  stub_time = 2000;
+  HAL_PWR_MNGR_GetTelemetry(&telemetry);
+  TEST_CHECK_EQUAL(telemetry.LevelTime[POWER_SAVE_LEVEL_RUNNING], 200);
+  TEST_CHECK_EQUAL(telemetry.LevelTime[POWER_SAVE_LEVEL_STOP_WITH_TIMER], 800);
+  TEST_CHECK_EQUAL(telemetry.StopNoTimerEntered, 0);
+
+  /* (1000000 x 200 + 2000 x 800) / 1000 nA */
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_EstimateCurrent(&model), 201600);
+  /* 100 mAh */
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_EstimateBatteryLife(&model, 100), 496);
+
+  /* Skipped: not entered, the estimate is still valid */
+  stop(POWER_SAVE_LEVEL_STOP_NOTIMER, 2000, 2000, 0);
+  HAL_PWR_MNGR_GetTelemetry(&telemetry);
+  TEST_CHECK_EQUAL(telemetry.Skipped, 1);
+  TEST_CHECK_EQUAL(telemetry.StopNoTimerEntered, 0);
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_EstimateCurrent(&model), 201600);
+}
+
+/* Once STOP_NOTIMER is entered, the estimate is not valid until the telemetry is reset */
+static void test_stop_notimer(void)
+{
+  PowerSaveTelemetry_TypeDef telemetry;
+
+  reset();
+  stop(POWER_SAVE_LEVEL_STOP_WITH_TIMER, 1100, 1900, 1);
+  stop(POWER_SAVE_LEVEL_STOP_NOTIMER, 1950, 1950, 1);
+  stub_time = 2000;
+
+  HAL_PWR_MNGR_GetTelemetry(&telemetry);
+  TEST_CHECK_EQUAL(telemetry.StopNoTimerEntered, 1);
+  TEST_CHECK_EQUAL(telemetry.LevelTime[POWER_SAVE_LEVEL_STOP_NOTIMER], 0);
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_EstimateCurrent(&model), POWER_SAVE_ESTIMATE_INVALID);
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_EstimateBatteryLife(&model, 100), 0);
+
+  /* More STOP_WITH_TIMER periods do not make it valid again */
+  stop(POWER_SAVE_LEVEL_STOP_WITH_TIMER, 2000, 5000, 1);
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_EstimateCurrent(&model), POWER_SAVE_ESTIMATE_INVALID);
+
+  HAL_PWR_MNGR_ResetTelemetry();
+  HAL_PWR_MNGR_GetTelemetry(&telemetry);
+  TEST_CHECK_EQUAL(telemetry.StopNoTimerEntered, 0);
+  stub_time += 100;
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_EstimateCurrent(&model), model.Current[POWER_SAVE_LEVEL_RUNNING]);
+}
+
+/* No current: the battery lasts forever */
+static void test_no_current(void)
+{
+  static const PowerSaveCurrentModel_TypeDef no_current = { { 0, 0, 0, 0 } };
+
+  reset();
+  stub_time = 2000;
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_EstimateCurrent(&no_current), 0);
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_EstimateBatteryLife(&no_current, 100), 0xFFFFFFFF);
+}
+
+int main(void)
+{
+  test_estimate();
+  test_stop_notimer();
+  test_no_current();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,292 @@
+/**
+  ******************************************************************************
+  * @file    test_pwr_replay.c
+  * @brief   Replays a recorded trace of power manager outcomes through the
+  *          telemetry and reports the average current and the battery life
+  *          estimated with a current model:
+  *
+  *            test_pwr_replay [<trace file> <model file>]
+  *
+  *          Without arguments, data/pwr_trace_adv.txt is replayed with the
+  *          BlueNRG-LP model and the estimates are checked against the level
+  *          times summed from the trace. The formats are described in data/.
+  ******************************************************************************
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_assert.h"
+#include "pwr_host_stub.h"
+#include "rf_driver_hal_power_manager.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define REPLAY_LINE_SIZE    (256)
+
+static const char *const level_names[4] = { "RUNNING", "CPU_HALT", "STOP_WITH_TIMER", "STOP_NOTIMER" };
+
+typedef struct
+{
+  uint32_t records;
+  uint32_t skipped;
+  uint64_t start;
+  uint64_t end;
+  /* Time in each level summed from the trace, RUNNING is the remainder */
+  uint64_t time[4];
+} replay_t;
+
+static int parse_level(const char *name)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    if (strcmp(name, level_names[i]) == 0)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* Next line with fields, comments and blank lines skipped */
+static int read_line(FILE *f, char *line, uint32_t *line_num)
+{
+  while (fgets(line, REPLAY_LINE_SIZE, f) != NULL)
+  {
+    char *comment = strchr(line, '#');
+
+    (*line_num)++;
+    if (comment != NULL)
+    {
+      *comment = '\0';
+    }
+    if (strspn(line, " \t\r\n") != strlen(line))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int load_model(const char *path, PowerSaveCurrentModel_TypeDef *model, uint32_t *capacity)
+{
+  char line[REPLAY_LINE_SIZE], name[32];
+  uint32_t line_num = 0, found = 0;
+  unsigned long value;
+  FILE *f = fopen(path, "r");
+  int level;
+
+  if (f == NULL)
+  {
+    perror(path);
+    return 0;
+  }
+  while (read_line(f, line, &line_num))
+  {
+    if (sscanf(line, "%31s %lu", name, &value) != 2)
+    {
+      printf("%s:%u: expected <level> <current>\n", path, line_num);
+      fclose(f);
+      return 0;
+    }
+    if (strcmp(name, "CAPACITY") == 0)
+    {
+      *capacity = (uint32_t)value;
+      found |= 1U << 4;
+    }
+    else if ((level = parse_level(name)) >= 0)
+    {
+      model->Current[level] = (uint32_t)value;
+      found |= 1U << level;
+    }
+    else
+    {
+      printf("%s:%u: unknown level %s\n", path, line_num, name);
+      fclose(f);
+      return 0;
+    }
+  }
+  fclose(f);
+  if (found != 0x1F)
+  {
+    printf("%s: the four levels and the capacity are needed\n", path);
+    return 0;
+  }
+  return 1;
+}
+
+/* Same sequences as HAL_PWR_MNGR_Request() once the level is negotiated */
+static void replay_request(PowerSaveLevels level, uint64_t time, uint64_t duration, uint8_t entered)
+{
+  stub_time = time;
+  PowerSaveTelemetry.Requests++;
+  PowerSaveTelemetry.LevelCount[level]++;
+  if (level == POWER_SAVE_LEVEL_CPU_HALT)
+  {
+    stub_time = time + duration;
+    PowerSaveTelemetry.LevelTime[POWER_SAVE_LEVEL_CPU_HALT] += stub_time - time;
+  }
+  else if (level != POWER_SAVE_LEVEL_RUNNING)
+  {
+    RAM_VR.WakeupFromSleepFlag = entered;
+    WakeupTime = time + duration;
+    stub_time = time + duration;
+    PowerSave_Telemetry(level, time);
+  }
+}
+
+static int replay(const char *path, replay_t *r)
+{
+  char line[REPLAY_LINE_SIZE], name[32], flag[32];
+  unsigned long long time, duration;
+  uint32_t line_num = 0;
+  uint64_t now = 0;
+  FILE *f = fopen(path, "r");
+  int fields, level;
+
+  if (f == NULL)
+  {
+    perror(path);
+    return 0;
+  }
+  memset(r, 0, sizeof(*r));
+  while (read_line(f, line, &line_num))
+  {
+    fields = sscanf(line, "%31s %llu", name, &time);
+    if (fields == 2 && strcmp(name, "START") == 0)
+    {
+      stub_time = now = r->start = time;
+      HAL_PWR_MNGR_ResetTelemetry();
+      continue;
+    }
+    if (fields == 2 && strcmp(name, "END") == 0)
+    {
+      r->end = time;
+      break;
+    }
+    flag[0] = '\0';
+    fields = sscanf(line, "%llu %31s %llu %31s", &time, name, &duration, flag);
+    level = (fields >= 3) ? parse_level(name) : -1;
+    if (level < 0 || (fields == 4 && strcmp(flag, "SKIPPED") != 0))
+    {
+      printf("%s:%u: expected <time> <level> <time in level> [SKIPPED]\n", path, line_num);
+      fclose(f);
+      return 0;
+    }
+    if (time < now)
+    {
+      printf("%s:%u: request before the end of the previous one\n", path, line_num);
+      fclose(f);
+      return 0;
+    }
+    replay_request((PowerSaveLevels)level, time, duration, fields != 4);
+    r->records++;
+    if (fields == 4)
+    {
+      r->skipped++;
+    }
+    else
+    {
+      r->time[level] += duration;
+      now = time + duration;
+    }
+  }
+  fclose(f);
+  if (r->end < now)
+  {
+    printf("%s: END missing or before the last request\n", path);
+    return 0;
+  }
+  stub_time = r->end;
+  r->time[POWER_SAVE_LEVEL_RUNNING] = (r->end - r->start) - r->time[POWER_SAVE_LEVEL_CPU_HALT] -
+                                      r->time[POWER_SAVE_LEVEL_STOP_WITH_TIMER] - r->time[POWER_SAVE_LEVEL_STOP_NOTIMER];
+  return 1;
+}
+
+/* Reports the estimates of the trace just replayed */
+static void report(const char *trace, const PowerSaveCurrentModel_TypeDef *model, uint32_t capacity)
+{
+  PowerSaveTelemetry_TypeDef telemetry;
+  uint64_t total;
+  uint32_t current;
+
+  HAL_PWR_MNGR_GetTelemetry(&telemetry);
+  total = stub_time - TelemetryStartTime;
+  printf("%s: %u requests, %u skipped, %llu time units\n", trace, telemetry.Requests, telemetry.Skipped,
+         (unsigned long long)total);
+  for (int i = 0; i < 4; i++)
+  {
+    printf("  %-16s %8u requests %12llu time units (%5.1f%%) %10u nA\n", level_names[i], telemetry.LevelCount[i],
+           (unsigned long long)telemetry.LevelTime[i], total ? 100.0 * telemetry.LevelTime[i] / total : 0.0,
+           model->Current[i]);
+  }
+  current = HAL_PWR_MNGR_EstimateCurrent(model);
+  if (current == POWER_SAVE_ESTIMATE_INVALID)
+  {
+    printf("  average current and battery life not valid: STOP_NOTIMER entered %u time(s)\n",
+           telemetry.StopNoTimerEntered);
+    return;
+  }
+  printf("  average current %u nA, battery life %u h for %u mAh\n", current,
+         HAL_PWR_MNGR_EstimateBatteryLife(model, capacity), capacity);
+}
+
+/* The estimates of the power manager match the level times of the trace */
+static void test_replay(const char *trace, const char *model_path)
+{
+  PowerSaveCurrentModel_TypeDef model;
+  PowerSaveTelemetry_TypeDef telemetry;
+  uint32_t capacity, current;
+  uint64_t charge = 0;
+  replay_t r;
+
+  stub_reset();
+  if (!load_model(model_path, &model, &capacity) || !replay(trace, &r))
+  {
+    test_failures++;
+    return;
+  }
+  report(trace, &model, capacity);
+
+  HAL_PWR_MNGR_GetTelemetry(&telemetry);
+  TEST_CHECK_EQUAL(telemetry.Requests, r.records);
+  TEST_CHECK_EQUAL(telemetry.Skipped, r.skipped);
+  for (int i = 0; i < 3; i++)
+  {
+    TEST_CHECK_EQUAL(telemetry.LevelTime[i], r.time[i]);
+    charge += (uint64_t)model.Current[i] * r.time[i];
+  }
+  TEST_CHECK_EQUAL(r.time[POWER_SAVE_LEVEL_STOP_NOTIMER], 0);
+
+  /* The trace is short enough for the estimate to keep the full time resolution */
+  current = (uint32_t)(charge / (r.end - r.start));
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_EstimateCurrent(&model), current);
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_EstimateBatteryLife(&model, capacity), (uint64_t)capacity * 1000000 / current);
+}
+
+int main(int argc, char **argv)
+{
+  PowerSaveCurrentModel_TypeDef model;
+  uint32_t capacity;
+  replay_t r;
+
+  if (argc == 3)
+  {
+    stub_reset();
+    if (!load_model(argv[2], &model, &capacity) || !replay(argv[1], &r))
+    {
+      return 1;
+    }
+    report(argv[1], &model, capacity);
+    return 0;
+  }
+  if (argc != 1)
+  {
+    printf("usage: %s [<trace file> <model file>]\n", argv[0]);
+    return 1;
+  }
+
+  test_replay(PWR_REPLAY_DATA_DIR "/pwr_trace_adv.txt", PWR_REPLAY_DATA_DIR "/bluenrg_lp_model.txt");
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,230 @@
+/**
+  ******************************************************************************
+  * @file    test_pwr_voters.c
+  * @brief   Power save voters: the registered voters are called after the
+  *          built-in checks in order of priority, until one of them keeps the
+  *          CPU running, and the negotiated level is the lowest level returned.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "test_assert.h"
+#include "pwr_host_stub.h"
+#include "rf_driver_hal_power_manager.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define VOTERS          (3)
+
+static PowerSaveVoter_TypeDef voters[VOTERS];
+static PowerSaveLevels voter_level[VOTERS];
+static PowerSaveLevels voter_request[VOTERS];
+static uint32_t voter_calls[VOTERS];
+static uint32_t calls;
+static uint32_t voter_order[VOTERS];
+
+static PowerSaveLevels check(uint8_t voter, PowerSaveLevels level)
+{
+  voter_request[voter] = level;
+  voter_calls[voter]++;
+  voter_order[voter] = calls++;
+  return voter_level[voter];
+}
+
+static PowerSaveLevels check_0(PowerSaveLevels level)
+{
+  return check(0, level);
+}
+
+static PowerSaveLevels check_1(PowerSaveLevels level)
+{
+  return check(1, level);
+}
+
+static PowerSaveLevels check_2(PowerSaveLevels level)
+{
+  return check(2, level);
+}
+
+static PowerSaveLevels (*const checks[VOTERS])(PowerSaveLevels level) = { check_0, check_1, check_2 };
+
+/* Voters 0, 1 and 2 with priorities 1, 5 and 3: called in the order 1, 2, 0 */
+static void reset(void)
+{
+  static const uint8_t priority[VOTERS] = { 1, 5, 3 };
+
+  stub_reset();
+  PowerSaveVoters_List = NULL;
+  HAL_PWR_MNGR_ResetTelemetry();
+  calls = 0;
+  for (uint8_t i = 0; i < VOTERS; i++)
+  {
+    memset(&voters[i], 0, sizeof(voters[i]));
+    voters[i].Name = "voter";
+    voters[i].Priority = priority[i];
+    voters[i].Check = checks[i];
+    voter_level[i] = POWER_SAVE_LEVEL_STOP_NOTIMER;
+    voter_request[i] = POWER_SAVE_LEVEL_RUNNING;
+    voter_calls[i] = 0;
+    TEST_CHECK_EQUAL(HAL_PWR_MNGR_RegisterVoter(&voters[i]), SUCCESS);
+  }
+}
+
+static PowerSaveLevels request(PowerSaveLevels level)
+{
+  WakeupSourceConfig_TypeDef wsConfig;
+  PowerSaveLevels negotiated = (PowerSaveLevels)0xFF;
+
+  memset(&wsConfig, 0, sizeof(wsConfig));
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_Request(level, wsConfig, &negotiated), SUCCESS);
+  return negotiated;
+}
+
+/* The list is kept sorted by priority; a voter is registered only once */
+static void test_register(void)
+{
+  PowerSaveVoter_TypeDef no_check = { "no check", 2, NULL, 0, NULL };
+
+  reset();
+  TEST_CHECK(PowerSaveVoters_List == &voters[1]);
+  TEST_CHECK(voters[1].next == &voters[2]);
+  TEST_CHECK(voters[2].next == &voters[0]);
+  TEST_CHECK(voters[0].next == NULL);
+
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_RegisterVoter(&voters[2]), ERROR);
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_RegisterVoter(&no_check), ERROR);
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_RegisterVoter(NULL), ERROR);
+  TEST_CHECK(voters[0].next == NULL);
+
+  /* Same priority: after the voters already registered */
+  voters[0].Priority = 5;
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_UnregisterVoter(&voters[0]), SUCCESS);
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_RegisterVoter(&voters[0]), SUCCESS);
+  TEST_CHECK(PowerSaveVoters_List == &voters[1]);
+  TEST_CHECK(voters[1].next == &voters[0]);
+  TEST_CHECK(voters[0].next == &voters[2]);
+}
+
+/* All the voters are called in order of priority with the requested level; the lowest level is negotiated */
+static void test_negotiation(void)
+{
+  PowerSaveTelemetry_TypeDef telemetry;
+
+  reset();
+  voter_level[2] = POWER_SAVE_LEVEL_CPU_HALT;
+  stub_time = 1000;
+
+  TEST_CHECK_EQUAL(request(POWER_SAVE_LEVEL_STOP_WITH_TIMER), POWER_SAVE_LEVEL_CPU_HALT);
+  for (uint8_t i = 0; i < VOTERS; i++)
+  {
+    TEST_CHECK_EQUAL(voter_calls[i], 1);
+    TEST_CHECK_EQUAL(voter_request[i], POWER_SAVE_LEVEL_STOP_WITH_TIMER);
+  }
+  TEST_CHECK_EQUAL(voter_order[1], 0);
+  TEST_CHECK_EQUAL(voter_order[2], 1);
+  TEST_CHECK_EQUAL(voter_order[0], 2);
+
+  /* Only the voter returning a level below the requested one is counted */
+  TEST_CHECK_EQUAL(voters[0].VetoCount, 0);
+  TEST_CHECK_EQUAL(voters[1].VetoCount, 0);
+  TEST_CHECK_EQUAL(voters[2].VetoCount, 1);
+
+  HAL_PWR_MNGR_GetTelemetry(&telemetry);
+  TEST_CHECK_EQUAL(telemetry.Requests, 1);
+  TEST_CHECK_EQUAL(telemetry.LevelCount[POWER_SAVE_LEVEL_CPU_HALT], 1);
+  for (uint8_t i = 0; i < POWER_SAVE_VOTER_NUM; i++)
+  {
+    TEST_CHECK_EQUAL(telemetry.VetoCount[i], 0);
+  }
+
+  /* A level below CPU_HALT returned by a built-in voter: still all called, the lowest level wins */
+  stub_vtimer_level = POWER_SAVE_LEVEL_CPU_HALT;
+  voter_level[2] = POWER_SAVE_LEVEL_RUNNING;
+  TEST_CHECK_EQUAL(request(POWER_SAVE_LEVEL_CPU_HALT), POWER_SAVE_LEVEL_RUNNING);
+  TEST_CHECK_EQUAL(voter_calls[1], 2);
+  TEST_CHECK_EQUAL(voter_calls[2], 2);
+  TEST_CHECK_EQUAL(voters[2].VetoCount, 2);
+  HAL_PWR_MNGR_GetTelemetry(&telemetry);
+  TEST_CHECK_EQUAL(telemetry.VetoCount[POWER_SAVE_VOTER_VTIMER], 0);
+  TEST_CHECK_EQUAL(telemetry.LevelCount[POWER_SAVE_LEVEL_RUNNING], 1);
+}
+
+/* Once a voter keeps the CPU running, the voters with lower priority are not called */
+static void test_running(void)
+{
+  reset();
+  voter_level[2] = POWER_SAVE_LEVEL_RUNNING;
+
+  TEST_CHECK_EQUAL(request(POWER_SAVE_LEVEL_STOP_NOTIMER), POWER_SAVE_LEVEL_RUNNING);
+  TEST_CHECK_EQUAL(voter_calls[1], 1);
+  TEST_CHECK_EQUAL(voter_calls[2], 1);
+  TEST_CHECK_EQUAL(voter_calls[0], 0);
+  TEST_CHECK_EQUAL(voters[2].VetoCount, 1);
+  TEST_CHECK_EQUAL(voters[0].VetoCount, 0);
+
+  /* Running request: nobody vetoes it */
+  voter_level[2] = POWER_SAVE_LEVEL_STOP_NOTIMER;
+  stub_pka_level = POWER_SAVE_LEVEL_RUNNING;
+  TEST_CHECK_EQUAL(request(POWER_SAVE_LEVEL_CPU_HALT), POWER_SAVE_LEVEL_RUNNING);
+  TEST_CHECK_EQUAL(voter_calls[1], 1);
+  TEST_CHECK_EQUAL(voter_calls[2], 1);
+  TEST_CHECK_EQUAL(voter_calls[0], 0);
+}
+
+/* The radio stack and the application checks keep the CPU running before any other voter */
+static void test_builtin_veto(void)
+{
+  PowerSaveTelemetry_TypeDef telemetry;
+
+  reset();
+  stub_stack_level = POWER_SAVE_LEVEL_RUNNING;
+  TEST_CHECK_EQUAL(request(POWER_SAVE_LEVEL_CPU_HALT), POWER_SAVE_LEVEL_RUNNING);
+  stub_stack_level = POWER_SAVE_LEVEL_STOP_NOTIMER;
+  stub_app_level = POWER_SAVE_LEVEL_RUNNING;
+  TEST_CHECK_EQUAL(request(POWER_SAVE_LEVEL_CPU_HALT), POWER_SAVE_LEVEL_RUNNING);
+
+  for (uint8_t i = 0; i < VOTERS; i++)
+  {
+    TEST_CHECK_EQUAL(voter_calls[i], 0);
+  }
+  HAL_PWR_MNGR_GetTelemetry(&telemetry);
+  TEST_CHECK_EQUAL(telemetry.VetoCount[POWER_SAVE_VOTER_RADIO_STACK], 1);
+  TEST_CHECK_EQUAL(telemetry.VetoCount[POWER_SAVE_VOTER_APP], 1);
+  TEST_CHECK_EQUAL(telemetry.LevelCount[POWER_SAVE_LEVEL_RUNNING], 2);
+}
+
+/* An unregistered voter is not called anymore and can be registered again */
+static void test_unregister(void)
+{
+  reset();
+  voter_level[2] = POWER_SAVE_LEVEL_RUNNING;
+
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_UnregisterVoter(&voters[2]), SUCCESS);
+  TEST_CHECK(voters[2].next == NULL);
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_UnregisterVoter(&voters[2]), ERROR);
+  TEST_CHECK_EQUAL(request(POWER_SAVE_LEVEL_CPU_HALT), POWER_SAVE_LEVEL_CPU_HALT);
+  TEST_CHECK_EQUAL(voter_calls[2], 0);
+  TEST_CHECK_EQUAL(voter_calls[0], 1);
+
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_RegisterVoter(&voters[2]), SUCCESS);
+  TEST_CHECK_EQUAL(request(POWER_SAVE_LEVEL_CPU_HALT), POWER_SAVE_LEVEL_RUNNING);
+  TEST_CHECK_EQUAL(voter_calls[2], 1);
+  TEST_CHECK_EQUAL(voter_calls[0], 1);
+
+  /* Last voter of the list */
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_UnregisterVoter(&voters[0]), SUCCESS);
+  TEST_CHECK(voters[2].next == NULL);
+  TEST_CHECK_EQUAL(HAL_PWR_MNGR_UnregisterVoter(&voters[1]), SUCCESS);
+  TEST_CHECK(PowerSaveVoters_List == &voters[2]);
+}
+
+int main(void)
+{
+  test_register();
+  test_negotiation();
+  test_running();
+  test_builtin_veto();
+  test_unregister();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,136 @@
+/**
+  ******************************************************************************
+  * @file    radio_host_stub.c
+  * @brief   Simulated LL radio and system timer used by the radio HAL. The
+  *          packets made pending are completed by the test, as by the radio
+  *          interrupt, or at once with stub_auto_complete.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "rf_driver_ll_radio_2g4.h"
+#include "rf_driver_ll_timer.h"
+#include "radio_host_stub.h"
+
+uint64_t stub_time;
+ActionPacket *stub_current;
+uint8_t stub_auto_complete;
+int8_t (*stub_rssi)(uint8_t channel);
+uint8_t stub_channel[8];
+uint32_t stub_tx_count[40];
+uint32_t stub_sense_count[40];
+uint32_t stub_null_next;
+
+void stub_reset(void)
+{
+  stub_time = 1000;
+  stub_current = NULL;
+  stub_auto_complete = 0;
+  stub_rssi = NULL;
+  memset(stub_channel, 0, sizeof(stub_channel));
+  memset(stub_tx_count, 0, sizeof(stub_tx_count));
+  memset(stub_sense_count, 0, sizeof(stub_sense_count));
+  stub_null_next = 0;
+}
+
+/* Same sequence as RADIO_IRQHandler() */
+void stub_radio_complete(uint32_t status, int8_t rssi)
+{
+  ActionPacket *p = stub_current;
+  ActionPacket *next;
+
+  if (p == NULL)
+  {
+    return;
+  }
+  p->status = status;
+  p->rssi = rssi;
+  next = p->condRoutine(p) ? p->next_true : p->next_false;
+  stub_current = next;
+  p->dataRoutine(p, next);
+}
+
+uint8_t RADIO_GetStatus(uint32_t *time)
+{
+  /* Any value but BLUE_IDLE_0: radio active */
+  return (stub_current == NULL) ? BLUE_IDLE_0 : 1;
+}
+
+void RADIO_SetChannelMap(uint8_t StateMachineNo, uint8_t *chan_remap)
+{
+}
+
+void RADIO_SetChannel(uint8_t StateMachineNo, uint8_t channel, uint8_t channel_increment)
+{
+  stub_channel[StateMachineNo] = channel;
+}
+
+void RADIO_SetTxAttributes(uint8_t StateMachineNo, uint32_t NetworkID, uint32_t crc_init)
+{
+}
+
+void RADIO_SetGlobalReceiveTimeout(uint32_t ReceiveTimeout)
+{
+}
+
+/* The part of the LL setup that depends on the next packet */
+void RADIO_SetReservedArea(ActionPacket *p)
+{
+  memset(&p->trans_packet, 0, sizeof(p->trans_packet));
+  if (p->next_true == NULL)
+  {
+    stub_null_next++;
+    return;
+  }
+  if ((p->next_true->ActionTag & TXRX) != 0)
+  {
+    p->trans_packet.BYTE5 |= TXRXPACK_BYTE5_NEXTTXMODE_Msk;
+  }
+}
+
+uint8_t RADIO_MakeActionPacketPending(ActionPacket *p)
+{
+  if (stub_current != NULL)
+  {
+    return RADIO_BUSY_C4;
+  }
+  stub_current = p;
+
+  while (stub_auto_complete && (stub_current != NULL))
+  {
+    uint8_t channel = stub_channel[stub_current->StateMachineNo];
+
+    if ((stub_current->ActionTag & TXRX) != 0)
+    {
+      stub_tx_count[channel]++;
+      stub_radio_complete(BLUE_INTERRUPT1REG_DONE | BLUE_INTERRUPT1REG_TXOK, 0);
+    }
+    else
+    {
+      stub_sense_count[channel]++;
+      stub_radio_complete(BLUE_INTERRUPT1REG_DONE | BLUE_INTERRUPT1REG_RCVTIMEOUT, stub_rssi(channel));
+    }
+  }
+  return SUCCESS_0;
+}
+
+uint8_t RADIO_StopActivity(void)
+{
+  /* The interrupt of the current packet may already be pending: stub_current is kept */
+  return 0;
+}
+
+int8_t RADIO_ReadRSSI(void)
+{
+  return 127;
+}
+
+uint64_t TIMER_GetCurrentSysTime(void)
+{
+  return stub_time;
+}
+
+uint32_t TIMER_UsToSystime(uint32_t time)
+{
+  return (uint32_t)(((uint64_t)time * 256) / 625);
+}
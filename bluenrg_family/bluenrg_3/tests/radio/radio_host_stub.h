@@ -0,0 +1,41 @@
+/**
+  ******************************************************************************
+  * @file    radio_host_stub.h
+  * @brief   Simulated LL radio and system timer used by the radio HAL. The
+  *          packets made pending are completed by the test, as by the radio
+  *          interrupt, or at once with stub_auto_complete.
+  ******************************************************************************
+  */
+
+#ifndef RADIO_HOST_STUB_H
+#define RADIO_HOST_STUB_H
+
+#include <stdint.h>
+#include "rf_driver_ll_radio_2g4.h"
+
+/* System time, in system time units */
+extern uint64_t stub_time;
+
+/* Packet executed by the radio, NULL if idle */
+extern ActionPacket *stub_current;
+
+/* Completes the packets at once when they are made pending: a TX is sent, a
+   carrier sense (RX of 1 byte) reports stub_rssi() */
+extern uint8_t stub_auto_complete;
+extern int8_t (*stub_rssi)(uint8_t channel);
+
+/* Channel of each state machine */
+extern uint8_t stub_channel[8];
+
+extern uint32_t stub_tx_count[40];
+extern uint32_t stub_sense_count[40];
+
+/* RADIO_SetReservedArea() called with next_true NULL */
+extern uint32_t stub_null_next;
+
+void stub_reset(void);
+
+/* Radio interrupt: end of the current packet with the given status and RSSI */
+void stub_radio_complete(uint32_t status, int8_t rssi);
+
+#endif /* RADIO_HOST_STUB_H */
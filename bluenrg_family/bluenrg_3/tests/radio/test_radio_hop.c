@@ -0,0 +1,174 @@
+/**
+  ******************************************************************************
+  * @file    test_radio_hop.c
+  * @brief   Listen before talk of the hop scheduler: a channel is busy only if
+  *          its RSSI reaches the threshold. An RSSI not available (127) is
+  *          sampled again, then the channel is used.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "test_assert.h"
+#include "radio_host_stub.h"
+#include "rf_driver_hal_radio_2g4.c"
+
+TEST_MAIN_DEFINITIONS;
+
+#define RSSI_NOT_AVAILABLE  (127)
+#define RSSI_FREE           (-95)
+#define RSSI_BUSY           (-40)
+#define THRESHOLD           (-70)
+
+/* RSSI of the successive carrier senses of each channel */
+static int8_t script[40][4];
+static uint8_t script_length[40];
+static uint8_t script_index[40];
+
+static uint8_t results;
+static uint8_t last_result;
+
+static int8_t scripted_rssi(uint8_t channel)
+{
+  uint8_t i = script_index[channel];
+
+  if (script_length[channel] == 0)
+  {
+    return RSSI_FREE;
+  }
+  if (i < script_length[channel] - 1)
+  {
+    script_index[channel]++;
+  }
+  return script[channel][i];
+}
+
+static void on_result(uint8_t result)
+{
+  results++;
+  last_result = result;
+}
+
+static void setup(void)
+{
+  static const uint8_t sequence[] = { 3, 12, 25, 38 };
+  HAL_RADIO_HopConfig config = { 0 };
+
+  stub_reset();
+  stub_auto_complete = 1;
+  stub_rssi = scripted_rssi;
+  memset(script_length, 0, sizeof(script_length));
+  memset(script_index, 0, sizeof(script_index));
+  results = 0;
+
+  memcpy(config.sequence, sequence, sizeof(sequence));
+  config.sequence_length = sizeof(sequence);
+  config.busy_threshold = THRESHOLD;
+  config.max_attempts = 3;
+  config.backoff_min = 100;
+  config.backoff_max = 500;
+  TEST_CHECK_EQUAL(HAL_RADIO_HopInit(&config), SUCCESS_0);
+}
+
+static void send(void)
+{
+  static uint8_t packet[4] = { 0x02, 0x02, 0x55, 0xAA };
+  uint32_t ticks = 0;
+
+  TEST_CHECK_EQUAL(HAL_RADIO_HopSend(packet, NULL, 0, on_result), SUCCESS_0);
+  while (HAL_RADIO_HopPending() && (ticks++ < 10000))
+  {
+    HAL_RADIO_HopTick();
+    stub_time += 10;
+  }
+  TEST_CHECK(!HAL_RADIO_HopPending());
+}
+
+static void set_script(uint8_t channel, int8_t first, int8_t next)
+{
+  script[channel][0] = first;
+  script[channel][1] = next;
+  script_length[channel] = 2;
+}
+
+/* No RSSI reading at all: the packets are sent, not dropped as on busy channels */
+static void test_not_available(void)
+{
+  HAL_RADIO_HopStats stats;
+  HAL_RADIO_HopChannelStats channel_stats[40];
+
+  setup();
+  set_script(3, RSSI_NOT_AVAILABLE, RSSI_NOT_AVAILABLE);
+  set_script(12, RSSI_NOT_AVAILABLE, RSSI_NOT_AVAILABLE);
+
+  send();
+  TEST_CHECK_EQUAL(results, 1);
+  TEST_CHECK_EQUAL(last_result, HAL_RADIO_HOP_SENT);
+  TEST_CHECK_EQUAL(stub_tx_count[3], 1);
+  /* Sampled again before being used */
+  TEST_CHECK_EQUAL(stub_sense_count[3], 2);
+  send();
+  TEST_CHECK_EQUAL(stub_tx_count[12], 1);
+
+  HAL_RADIO_HopGetStats(&stats, channel_stats);
+  TEST_CHECK_EQUAL(stats.packets, 2);
+  TEST_CHECK_EQUAL(stats.dropped, 0);
+  TEST_CHECK_EQUAL(channel_stats[3].busy_count, 0);
+  TEST_CHECK_EQUAL(channel_stats[3].cca_count, 1);
+}
+
+/* The second sample gives the state of the channel */
+static void test_resample(void)
+{
+  HAL_RADIO_HopStats stats;
+  HAL_RADIO_HopChannelStats channel_stats[40];
+
+  setup();
+  set_script(3, RSSI_NOT_AVAILABLE, RSSI_BUSY);
+  set_script(12, RSSI_NOT_AVAILABLE, RSSI_FREE);
+
+  send();
+  TEST_CHECK_EQUAL(results, 1);
+  TEST_CHECK_EQUAL(last_result, HAL_RADIO_HOP_SENT);
+  TEST_CHECK_EQUAL(stub_tx_count[3], 0);
+  TEST_CHECK_EQUAL(stub_tx_count[12], 1);
+  TEST_CHECK_EQUAL(stub_sense_count[3], 2);
+  TEST_CHECK_EQUAL(stub_sense_count[12], 2);
+
+  HAL_RADIO_HopGetStats(&stats, channel_stats);
+  TEST_CHECK_EQUAL(channel_stats[3].busy_count, 1);
+  TEST_CHECK_EQUAL(channel_stats[12].busy_count, 0);
+}
+
+/* Busy channels are skipped, a packet is dropped after max_attempts busy channels */
+static void test_busy(void)
+{
+  HAL_RADIO_HopStats stats;
+
+  setup();
+  set_script(3, RSSI_BUSY, RSSI_BUSY);
+  set_script(12, THRESHOLD, THRESHOLD);
+  set_script(25, RSSI_BUSY, RSSI_BUSY);
+
+  send();
+  TEST_CHECK_EQUAL(last_result, HAL_RADIO_HOP_CHANNEL_BUSY);
+  TEST_CHECK_EQUAL(stub_sense_count[3], 1);
+  TEST_CHECK_EQUAL(stub_sense_count[12], 1);
+  TEST_CHECK_EQUAL(stub_sense_count[25], 1);
+
+  send();
+  TEST_CHECK_EQUAL(last_result, HAL_RADIO_HOP_SENT);
+  TEST_CHECK_EQUAL(stub_tx_count[38], 1);
+
+  HAL_RADIO_HopGetStats(&stats, NULL);
+  TEST_CHECK_EQUAL(stats.packets, 2);
+  TEST_CHECK_EQUAL(stats.dropped, 1);
+}
+
+int main(void)
+{
+  test_not_available();
+  test_resample();
+  test_busy();
+
+  return TEST_RESULT();
+}
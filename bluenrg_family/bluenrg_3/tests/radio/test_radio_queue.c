@@ -0,0 +1,115 @@
+/**
+  ******************************************************************************
+  * @file    test_radio_queue.c
+  * @brief   Packet queue of the radio HAL: reserved area of the chained packets
+  *          and completions received after HAL_RADIO_QueueAbort().
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "test_assert.h"
+#include "radio_host_stub.h"
+#include "rf_driver_hal_radio_2g4.c"
+
+TEST_MAIN_DEFINITIONS;
+
+static uint32_t completed;
+
+static void on_packet(HAL_RADIO_Packet *packet)
+{
+  completed++;
+}
+
+static uint8_t next_tx_mode(uint8_t slot)
+{
+  return (queuePacket[slot].trans_packet.BYTE5 & TXRXPACK_BYTE5_NEXTTXMODE_Msk) != 0;
+}
+
+static void queue(HAL_RADIO_Packet *packet, uint8_t tx, uint8_t channel)
+{
+  static uint8_t data[4] = { 0x02, 0x02, 0x55, 0xAA };
+
+  memset(packet, 0, sizeof(*packet));
+  packet->channel = channel;
+  packet->tx = tx;
+  packet->receive_length = sizeof(data);
+  packet->receive_timeout = 500;
+  packet->data = data;
+  packet->Callback = on_packet;
+  TEST_CHECK_EQUAL(HAL_RADIO_QueuePacket(packet), SUCCESS_0);
+}
+
+/* Each packet gives the mode of the next one, the tail has no next packet */
+static void test_next_mode(void)
+{
+  static HAL_RADIO_Packet packets[4];
+
+  stub_reset();
+  completed = 0;
+
+  queue(&packets[0], 1, 5);
+  TEST_CHECK(!next_tx_mode(0));
+  queue(&packets[1], 0, 6);
+  TEST_CHECK(!next_tx_mode(0));
+  TEST_CHECK(!next_tx_mode(1));
+  queue(&packets[2], 1, 7);
+  TEST_CHECK(next_tx_mode(1));
+  TEST_CHECK(!next_tx_mode(2));
+  TEST_CHECK_EQUAL(stub_null_next, 0);
+  TEST_CHECK_EQUAL(stub_channel[1], 5);
+  TEST_CHECK_EQUAL(stub_channel[2], 6);
+  TEST_CHECK_EQUAL(stub_channel[3], 7);
+  TEST_CHECK_EQUAL(HAL_RADIO_QueuePending(), 3);
+
+  stub_radio_complete(BLUE_INTERRUPT1REG_DONE | BLUE_INTERRUPT1REG_TXOK, 0);
+  stub_radio_complete(BLUE_INTERRUPT1REG_DONE | BLUE_INTERRUPT1REG_RCVOK, -60);
+  TEST_CHECK_EQUAL(completed, 2);
+  TEST_CHECK_EQUAL(packets[1].rssi, -60);
+  TEST_CHECK_EQUAL(HAL_RADIO_QueuePending(), 1);
+
+  /* Queued while the tail is being executed */
+  queue(&packets[3], 0, 8);
+  TEST_CHECK(!next_tx_mode(2));
+  TEST_CHECK(!next_tx_mode(3));
+  stub_radio_complete(BLUE_INTERRUPT1REG_DONE | BLUE_INTERRUPT1REG_TXOK, 0);
+  stub_radio_complete(BLUE_INTERRUPT1REG_DONE | BLUE_INTERRUPT1REG_RCVTIMEOUT, 0);
+  TEST_CHECK_EQUAL(completed, 4);
+  TEST_CHECK_EQUAL(HAL_RADIO_QueuePending(), 0);
+  TEST_CHECK(stub_current == NULL);
+}
+
+/* The interrupt of the running packet is served after the abort */
+static void test_abort(void)
+{
+  static HAL_RADIO_Packet packets[3];
+
+  stub_reset();
+  completed = 0;
+
+  queue(&packets[0], 1, 5);
+  queue(&packets[1], 1, 6);
+  TEST_CHECK_EQUAL(HAL_RADIO_QueuePending(), 2);
+  HAL_RADIO_QueueAbort();
+  TEST_CHECK_EQUAL(HAL_RADIO_QueuePending(), 0);
+
+  stub_radio_complete(BLUE_INTERRUPT1REG_DONE | BLUE_INTERRUPT1REG_TXOK, 0);
+  TEST_CHECK_EQUAL(completed, 0);
+  TEST_CHECK_EQUAL(HAL_RADIO_QueuePending(), 0);
+  stub_radio_complete(BLUE_INTERRUPT1REG_DONE | BLUE_INTERRUPT1REG_TXOK, 0);
+  TEST_CHECK_EQUAL(HAL_RADIO_QueuePending(), 0);
+
+  /* The queue is usable again */
+  queue(&packets[2], 1, 7);
+  TEST_CHECK_EQUAL(HAL_RADIO_QueuePending(), 1);
+  stub_radio_complete(BLUE_INTERRUPT1REG_DONE | BLUE_INTERRUPT1REG_TXOK, 0);
+  TEST_CHECK_EQUAL(completed, 1);
+  TEST_CHECK_EQUAL(HAL_RADIO_QueuePending(), 0);
+}
+
+int main(void)
+{
+  test_next_mode();
+  test_abort();
+
+  return TEST_RESULT();
+}
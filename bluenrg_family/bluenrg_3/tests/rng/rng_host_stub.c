@@ -0,0 +1,48 @@
+/**
+  ******************************************************************************
+  * @file    rng_host_stub.c
+  * @brief   RNG used by the RNG manager: random numbers of a fixed sequence,
+  *          ready stub_rng_period ticks after the previous read.
+  ******************************************************************************
+  */
+
+#include "rng_host_stub.h"
+
+uint32_t stub_rng_period;
+uint64_t stub_rng_time;
+uint32_t stub_rng_values;
+uint32_t stub_refill_requests;
+
+static uint64_t ready_time;
+
+void stub_reset(void)
+{
+  stub_rng_period = 1;
+  stub_rng_time = 0;
+  stub_rng_values = 0;
+  stub_refill_requests = 0;
+  ready_time = 0;
+}
+
+uint16_t stub_rng_value(uint32_t n)
+{
+  uint32_t x = (n + 1) * 2654435761U;
+
+  return (uint16_t)(x ^ (x >> 16));
+}
+
+uint8_t RNGMGR_PrivateRead(uint32_t* buffer)
+{
+  stub_rng_time++;
+  if (stub_rng_time < ready_time)
+    return 0;
+
+  buffer[0] = stub_rng_value(stub_rng_values++);
+  ready_time = stub_rng_time + stub_rng_period;
+  return 2;
+}
+
+void RNGMGR_RefillRequest(void)
+{
+  stub_refill_requests++;
+}
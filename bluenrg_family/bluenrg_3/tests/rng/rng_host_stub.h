@@ -0,0 +1,30 @@
+/**
+  ******************************************************************************
+  * @file    rng_host_stub.h
+  * @brief   RNG used by the RNG manager. The time is counted in RNG polls: each
+  *          read of the RNG takes one tick and the RNG holds one 16-bit random
+  *          number, generated stub_rng_period ticks after the previous read.
+  ******************************************************************************
+  */
+
+#ifndef RNG_HOST_STUB_H
+#define RNG_HOST_STUB_H
+
+#include <stdint.h>
+
+/* Ticks needed by the RNG to generate a random number */
+extern uint32_t stub_rng_period;
+/* Current time, in ticks */
+extern uint64_t stub_rng_time;
+
+/* Random numbers read from the RNG, in order */
+extern uint32_t stub_rng_values;
+/* Calls of RNGMGR_RefillRequest() */
+extern uint32_t stub_refill_requests;
+
+void stub_reset(void);
+
+/* n-th random number generated by the RNG (0 is the first after stub_reset()) */
+uint16_t stub_rng_value(uint32_t n);
+
+#endif /* RNG_HOST_STUB_H */
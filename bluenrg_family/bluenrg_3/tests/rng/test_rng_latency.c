@@ -0,0 +1,173 @@
+/**
+  ******************************************************************************
+  * @file    test_rng_latency.c
+  * @brief   RNG manager: random numbers delivered in order, pool refilled in
+  *          background only, and worst-case latency of the requests of the
+  *          radio ISR with and without the background refill.
+  ******************************************************************************
+  */
+
+#include "test_assert.h"
+#include "rng_host_stub.h"
+#include "rng_manager.c"
+
+TEST_MAIN_DEFINITIONS;
+
+/* Random numbers needed by the P-256 key of the PKA manager */
+#define BURST_SIZE      (16)
+#define BURSTS          (200)
+
+static void pool_reset(void)
+{
+  stub_reset();
+  poolHead = 0;
+  poolCount = 0;
+}
+
+/* Idle time of the application: the power manager is entered after each RNG period */
+static void idle(uint32_t wakeups)
+{
+  while (wakeups-- != 0)
+  {
+    stub_rng_time += stub_rng_period;
+    TEST_CHECK_EQUAL(RNGMGR_PowerSaveLevelCheck(3), 3);
+  }
+}
+
+/* Every random number generated is provided once, in order */
+static void test_sequence(void)
+{
+  uint32_t value[1];
+  uint8_t bytes[7];
+  uint32_t n = 0, i;
+
+  pool_reset();
+
+  for (i = 0; i < 100; i++)
+  {
+    TEST_CHECK_EQUAL(RNGMGR_GetRandom16(value, (uint8_t)(i & 1)), RNGMGR_SUCCESS);
+    TEST_CHECK_EQUAL(value[0], stub_rng_value(n++));
+    if ((i % 7) == 0)
+      RNGMGR_Tick();
+  }
+  for (i = 0; i < 50; i++)
+  {
+    TEST_CHECK_EQUAL(RNGMGR_GetRandom32(value), RNGMGR_SUCCESS);
+    TEST_CHECK_EQUAL(value[0] & 0xFFFF, stub_rng_value(n++));
+    TEST_CHECK_EQUAL(value[0] >> 16, stub_rng_value(n++));
+    idle(i);
+  }
+  TEST_CHECK_EQUAL(RNGMGR_GetRandomBytes(bytes, sizeof(bytes)), RNGMGR_SUCCESS);
+  for (i = 0; i < sizeof(bytes); i += 2, n++)
+  {
+    TEST_CHECK_EQUAL(bytes[i], stub_rng_value(n) & 0xFF);
+    if (i + 1 < sizeof(bytes))
+      TEST_CHECK_EQUAL(bytes[i + 1], stub_rng_value(n) >> 8);
+  }
+  TEST_CHECK_EQUAL(stub_rng_values, n + RNGMGR_PoolLevel());
+}
+
+/* The requests read the RNG only when the pool is empty and ask for a refill below the threshold */
+static void test_refill(void)
+{
+  uint32_t value[1];
+  uint64_t time;
+
+  pool_reset();
+  stub_rng_period = 10;
+
+  idle(RNGMGR_POOL_SIZE);
+  TEST_CHECK_EQUAL(RNGMGR_PoolLevel(), RNGMGR_POOL_SIZE);
+  idle(10);
+  TEST_CHECK_EQUAL(stub_rng_values, RNGMGR_POOL_SIZE);
+
+  time = stub_rng_time;
+  while (RNGMGR_PoolLevel() > RNGMGR_POOL_REFILL_LEVEL)
+  {
+    RNGMGR_GetRandom16(value, 1);
+  }
+  TEST_CHECK_EQUAL(stub_rng_time, time);
+  TEST_CHECK_EQUAL(stub_refill_requests, 0);
+
+  RNGMGR_GetRandom16(value, 1);
+  TEST_CHECK_EQUAL(stub_rng_time, time);
+  TEST_CHECK_EQUAL(stub_refill_requests, 1);
+
+  while (RNGMGR_PoolLevel() > 0)
+  {
+    RNGMGR_GetRandom16(value, 1);
+  }
+  TEST_CHECK_EQUAL(stub_rng_time, time);
+  TEST_CHECK_EQUAL(stub_refill_requests, RNGMGR_POOL_REFILL_LEVEL);
+
+  /* Empty pool: the request waits for the RNG, the pool is not refilled */
+  stub_rng_time += 10;
+  RNGMGR_GetRandom16(value, 1);
+  TEST_CHECK_EQUAL(RNGMGR_PoolLevel(), 0);
+  RNGMGR_GetRandom16(value, 1);
+  TEST_CHECK_EQUAL(stub_rng_time, time + 10 + 1 + 10);
+}
+
+/* Bursts of BURST_SIZE random numbers, separated by gap RNG periods of idle time:
+   it returns the worst-case latency of a burst, in ticks */
+static uint64_t run_bursts(uint32_t period, uint32_t gap, uint8_t background)
+{
+  uint8_t key[2 * BURST_SIZE];
+  uint64_t start, latency, worst = 0;
+  uint32_t i;
+
+  pool_reset();
+  stub_rng_period = period;
+  if (background)
+    idle(RNGMGR_POOL_SIZE);
+
+  for (i = 0; i < BURSTS; i++)
+  {
+    start = stub_rng_time;
+    RNGMGR_GetRandomBytes(key, sizeof(key));
+    latency = stub_rng_time - start;
+    if (latency > worst)
+      worst = latency;
+
+    if (background)
+      idle(gap);
+    else
+      stub_rng_time += (uint64_t)gap * period;
+  }
+  return worst;
+}
+
+static void test_latency(void)
+{
+  static const uint32_t periods[] = { 1, 8, 40 };
+  uint64_t without, with, fast;
+  uint32_t p, period;
+
+  for (p = 0; p < sizeof(periods) / sizeof(periods[0]); p++)
+  {
+    period = periods[p];
+
+    /* Enough idle time between the bursts to generate them */
+    without = run_bursts(period, BURST_SIZE, 0);
+    with = run_bursts(period, BURST_SIZE, 1);
+    /* Bursts twice as fast as the RNG: the pool runs dry */
+    fast = run_bursts(period, BURST_SIZE / 2, 1);
+
+    printf("RNG period %2u ticks: worst-case burst latency %4llu ticks without background refill, "
+           "%4llu with, %4llu with bursts at twice the RNG rate\n",
+           period, (unsigned long long)without, (unsigned long long)with, (unsigned long long)fast);
+
+    TEST_CHECK(without >= (uint64_t)(BURST_SIZE - 1) * period);
+    TEST_CHECK_EQUAL(with, 0);
+    TEST_CHECK(fast <= without);
+  }
+}
+
+int main(void)
+{
+  test_sequence();
+  test_refill();
+  test_latency();
+
+  return TEST_RESULT();
+}